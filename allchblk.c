@@ -37,15 +37,32 @@
 
 # define UNIQUE_THRESHOLD 32
         /* Sizes up to this many HBLKs each have their own free list    */
-# define HUGE_THRESHOLD 256
-        /* Sizes of at least this many heap blocks are mapped to a      */
-        /* single free list.                                            */
+# define LOG_HUGE_THRESHOLD 8
+# define HUGE_THRESHOLD (1 << LOG_HUGE_THRESHOLD)
+        /* Sizes of at least this many heap blocks are segregated by    */
+        /* the power of two.                                            */
 # define FL_COMPRESSION 8
         /* In between sizes map this many distinct sizes to a single    */
         /* bin.                                                         */
-
-# define N_HBLK_FLS ((HUGE_THRESHOLD - UNIQUE_THRESHOLD) / FL_COMPRESSION \
-                     + UNIQUE_THRESHOLD)
+# define LOG_HUGE_SUBLISTS 2
+        /* Each power-of-two range of the huge sizes is split into      */
+        /* 2**LOG_HUGE_SUBLISTS free lists.  Thus a block on any list   */
+        /* following the list of the requested size is large enough.    */
+# define LOG_HUGE_LIMIT 16
+        /* Sizes of at least 2**LOG_HUGE_LIMIT heap blocks are mapped   */
+        /* to a single free list.                                       */
+
+# define HUGE_FL_BASE ((HUGE_THRESHOLD - UNIQUE_THRESHOLD) / FL_COMPRESSION \
+                       + UNIQUE_THRESHOLD)
+# define N_HBLK_FLS (HUGE_FL_BASE \
+                + ((LOG_HUGE_LIMIT - LOG_HUGE_THRESHOLD) << LOG_HUGE_SUBLISTS))
+
+# define FL_MAP_SZ ((N_HBLK_FLS + CPP_WORDSZ) / CPP_WORDSZ)
+
+STATIC word GC_hblk_fl_map[FL_MAP_SZ] = { 0 };
+                                /* Bit i is set if GC_hblkfreelist[i]   */
+                                /* is non-empty.  Lets the allocator    */
+                                /* skip the empty free lists.           */
 
 #ifndef GC_GCJ_SUPPORT
   STATIC
@@ -57,26 +74,64 @@
                                 /* block.  Remains externally visible   */
                                 /* as used by GNU GCJ currently.        */
 
+#ifndef GC_GCJ_SUPPORT
+  STATIC
+#endif
+  word GC_free_bytes[N_HBLK_FLS+1] = { 0 };
+        /* Number of free bytes on each list.  Remains visible to GCJ.  */
+
+#ifdef USE_NUMA
+  /* In NUMA mode, there is a separate set of free lists per node; the  */
+  /* above ones are used for node 0, and a block is put on the lists of */
+  /* the node its memory is bound to.  Adjacent free blocks of          */
+  /* different nodes are not coalesced.                                 */
+  STATIC struct hblk * GC_node_hblkfreelist[MAX_NUMA_NODES-1][N_HBLK_FLS+1];
+  STATIC word GC_node_free_bytes[MAX_NUMA_NODES-1][N_HBLK_FLS+1];
+  STATIC word GC_node_hblk_fl_map[MAX_NUMA_NODES-1][FL_MAP_SZ];
+
+# define HBLK_NODE(hhdr) ((int)(hhdr) -> hb_node)
+# define SET_HBLK_NODE(hhdr, node) (void)((hhdr) -> hb_node = \
+                                          (unsigned char)(node))
+# define N_FL_NODES (GC_numa_nodes > 1 ? GC_numa_nodes : 1)
+# define NODE_HBLKFREELIST(node) ((node) > 0 ? \
+                        GC_node_hblkfreelist[(node)-1] : GC_hblkfreelist)
+# define NODE_FREE_BYTES(node) ((node) > 0 ? \
+                        GC_node_free_bytes[(node)-1] : GC_free_bytes)
+# define NODE_FL_MAP(node) ((node) > 0 ? \
+                        GC_node_hblk_fl_map[(node)-1] : GC_hblk_fl_map)
+#else
+# define HBLK_NODE(hhdr) 0
+# define SET_HBLK_NODE(hhdr, node) (void)0
+# define N_FL_NODES 1
+# define NODE_HBLKFREELIST(node) GC_hblkfreelist
+# define NODE_FREE_BYTES(node) GC_free_bytes
+# define NODE_FL_MAP(node) GC_hblk_fl_map
+#endif /* !USE_NUMA */
+
+#define FL_MAP_BIT(index) ((word)1 << modWORDSZ(index))
+#define FL_IS_NONEMPTY(node, index) \
+        ((NODE_FL_MAP(node)[divWORDSZ(index)] & FL_MAP_BIT(index)) != 0)
+
+/* Check whether two adjacent free blocks may be merged. */
+#define SAME_HBLK_NODE(hhdr1, hhdr2) (HBLK_NODE(hhdr1) == HBLK_NODE(hhdr2))
+
 GC_API void GC_CALL GC_iterate_free_hblks(GC_walk_free_blk_fn fn,
                                           GC_word client_data)
 {
-  int i;
+  int i, node;
 
-  for (i = 0; i <= N_HBLK_FLS; ++i) {
-    struct hblk *h;
+  for (node = 0; node < N_FL_NODES; ++node) {
+    for (i = 0; i <= N_HBLK_FLS; ++i) {
+      struct hblk *h;
 
-    for (h = GC_hblkfreelist[i]; h != NULL; h = HDR(h) -> hb_next) {
-      (*fn)(h, i, client_data);
+      for (h = NODE_HBLKFREELIST(node)[i]; h != NULL;
+           h = HDR(h) -> hb_next) {
+        (*fn)(h, i, client_data);
+      }
     }
   }
 }
 
-#ifndef GC_GCJ_SUPPORT
-  STATIC
-#endif
-  word GC_free_bytes[N_HBLK_FLS+1] = { 0 };
-        /* Number of free bytes on each list.  Remains visible to GCJ.  */
-
 /* Return the largest n such that the number of free bytes on lists     */
 /* n .. N_HBLK_FLS is greater or equal to GC_max_large_allocd_bytes     */
 /* minus GC_large_allocd_bytes.  If there is no such n, return 0.       */
@@ -87,7 +142,10 @@ GC_INLINE int GC_enough_large_bytes_left(void)
 
     GC_ASSERT(GC_max_large_allocd_bytes <= GC_heapsize);
     for (n = N_HBLK_FLS; n >= 0; --n) {
-        bytes += GC_free_bytes[n];
+        int node;
+
+        for (node = 0; node < N_FL_NODES; ++node)
+          bytes += NODE_FREE_BYTES(node)[n];
         if (bytes >= GC_max_large_allocd_bytes) return n;
     }
     return 0;
@@ -96,11 +154,47 @@ GC_INLINE int GC_enough_large_bytes_left(void)
 /* Map a number of blocks to the appropriate large block free list index. */
 STATIC int GC_hblk_fl_from_blocks(word blocks_needed)
 {
+    int lg;
+
     if (blocks_needed <= UNIQUE_THRESHOLD) return (int)blocks_needed;
-    if (blocks_needed >= HUGE_THRESHOLD) return N_HBLK_FLS;
-    return (int)(blocks_needed - UNIQUE_THRESHOLD)/FL_COMPRESSION
+    if (blocks_needed < HUGE_THRESHOLD)
+      return (int)(blocks_needed - UNIQUE_THRESHOLD)/FL_COMPRESSION
                                         + UNIQUE_THRESHOLD;
+    if (blocks_needed >= ((word)1 << LOG_HUGE_LIMIT)) return N_HBLK_FLS;
 
+    /* Find the power of two, then the sublist inside its range.        */
+    for (lg = LOG_HUGE_THRESHOLD; (blocks_needed >> (lg + 1)) != 0; lg++) {
+      /* empty */
+    }
+    return HUGE_FL_BASE + ((lg - LOG_HUGE_THRESHOLD) << LOG_HUGE_SUBLISTS)
+                + (int)((blocks_needed >> (lg - LOG_HUGE_SUBLISTS))
+                        & ((1 << LOG_HUGE_SUBLISTS) - 1));
+}
+
+/* Return the lowest index (not less than n) of a non-empty free list   */
+/* of the given node, or N_HBLK_FLS+1 if there is none.                 */
+STATIC int GC_next_nonempty_fl(int node, int n)
+{
+    const word *map = NODE_FL_MAP(node);
+    size_t i = divWORDSZ(n);
+    word m;
+
+#   ifndef USE_NUMA
+      UNUSED_ARG(node);
+#   endif
+    if (n > N_HBLK_FLS) return N_HBLK_FLS + 1;
+    m = map[i] & ~(FL_MAP_BIT(n) - 1);
+    while (0 == m) {
+      if (++i >= FL_MAP_SZ) return N_HBLK_FLS + 1;
+      m = map[i];
+    }
+    n = (int)(i * CPP_WORDSZ);
+#   if GC_GNUC_PREREQ(3, 4) || defined(__clang__)
+      n += __builtin_ctzll((unsigned long long)m);
+#   else
+      for (; (m & 1) == 0; m >>= 1) n++;
+#   endif
+    return n;
 }
 
 # define PHDR(hhdr) HDR((hhdr) -> hb_prev)
@@ -137,7 +231,7 @@ STATIC int GC_hblk_fl_from_blocks(word blocks_needed)
 
     if (i != *(int *)prev_index_ptr) {
       GC_printf("Free list %d (total size %lu):\n",
-                i, (unsigned long)GC_free_bytes[i]);
+                i, (unsigned long)NODE_FREE_BYTES(HBLK_NODE(hhdr))[i]);
       *(int *)prev_index_ptr = i;
     }
 
@@ -172,7 +266,8 @@ static int free_list_index_of(const hdr *wanted)
       struct hblk * h;
       hdr * hhdr;
 
-      for (h = GC_hblkfreelist[i]; h != 0; h = hhdr -> hb_next) {
+      for (h = NODE_HBLKFREELIST(HBLK_NODE(wanted))[i]; h != 0;
+           h = hhdr -> hb_next) {
         hhdr = HDR(h);
         if (hhdr == wanted) return i;
       }
@@ -247,7 +342,8 @@ static GC_bool setup_header(hdr * hhdr, struct hblk *block, size_t byte_sz,
         flags |= LARGE_BLOCK;
 #   endif
 #   ifdef ENABLE_DISCLAIM
-      if (GC_obj_kinds[kind].ok_disclaim_proc)
+      if (GC_obj_kinds[kind].ok_disclaim_proc
+          || GC_obj_kinds[kind].ok_disclaim_batch_proc)
         flags |= HAS_DISCLAIM;
       if (GC_obj_kinds[kind].ok_mark_unconditionally)
         flags |= MARK_UNCONDITIONALLY;
@@ -257,7 +353,18 @@ static GC_bool setup_header(hdr * hhdr, struct hblk *block, size_t byte_sz,
       hhdr -> hb_sz = byte_sz;
       hhdr -> hb_obj_kind = (unsigned char)kind;
       hhdr -> hb_flags = (unsigned char)flags;
+      hhdr -> hb_rescan = FALSE;
       hhdr -> hb_block = block;
+#   ifdef SIDE_MARK_BITMAP
+      if (GC_side_marks != NULL
+          && (word)block - GC_arena_start < GC_arena_size) {
+        hhdr -> hb_mark_bits = (void *)(GC_side_marks
+                + ((word)block - GC_arena_start) / HBLKSIZE
+                  * SIDE_MARKS_SLOT_SZ);
+      } else {
+        hhdr -> hb_mark_bits = hhdr -> hb_marks;
+      }
+#   endif
       descr = GC_obj_kinds[kind].ok_descriptor;
       if (GC_obj_kinds[kind].ok_relocate_descr) descr += byte_sz;
       hhdr -> hb_descr = descr;
@@ -305,6 +412,9 @@ static GC_bool setup_header(hdr * hhdr, struct hblk *block, size_t byte_sz,
 
     /* Clear mark bits */
     GC_clear_hdr_marks(hhdr);
+#   ifdef ENABLE_DISCLAIM
+      BZERO(hhdr -> hb_disclaim_bits, sizeof(hhdr -> hb_disclaim_bits));
+#   endif
 
     hhdr -> hb_last_reclaimed = (unsigned short)GC_gc_no;
     return TRUE;
@@ -313,18 +423,23 @@ static GC_bool setup_header(hdr * hhdr, struct hblk *block, size_t byte_sz,
 /* Remove hhdr from the free list (it is assumed to specified by index). */
 STATIC void GC_remove_from_fl_at(hdr *hhdr, int index)
 {
+    struct hblk **freelist = NODE_HBLKFREELIST(HBLK_NODE(hhdr));
+    word *free_bytes = NODE_FREE_BYTES(HBLK_NODE(hhdr));
+
     GC_ASSERT(modHBLKSZ(hhdr -> hb_sz) == 0);
     if (hhdr -> hb_prev == 0) {
-        GC_ASSERT(HDR(GC_hblkfreelist[index]) == hhdr);
-        GC_hblkfreelist[index] = hhdr -> hb_next;
+        GC_ASSERT(HDR(freelist[index]) == hhdr);
+        freelist[index] = hhdr -> hb_next;
+        if (NULL == freelist[index])
+          NODE_FL_MAP(HBLK_NODE(hhdr))[divWORDSZ(index)] &= ~FL_MAP_BIT(index);
     } else {
         hdr *phdr;
         GET_HDR(hhdr -> hb_prev, phdr);
         phdr -> hb_next = hhdr -> hb_next;
     }
     /* We always need index to maintain free counts.    */
-    GC_ASSERT(GC_free_bytes[index] >= hhdr -> hb_sz);
-    GC_free_bytes[index] -= hhdr -> hb_sz;
+    GC_ASSERT(free_bytes[index] >= hhdr -> hb_sz);
+    free_bytes[index] -= hhdr -> hb_sz;
     if (0 != hhdr -> hb_next) {
         hdr * nhdr;
         GC_ASSERT(!IS_FORWARDING_ADDR_OR_NIL(NHDR(hhdr)));
@@ -384,7 +499,9 @@ STATIC struct hblk * GC_free_block_ending_at(struct hblk *h)
 STATIC void GC_add_to_fl(struct hblk *h, hdr *hhdr)
 {
     int index = GC_hblk_fl_from_blocks(divHBLKSZ(hhdr -> hb_sz));
-    struct hblk *second = GC_hblkfreelist[index];
+    struct hblk **freelist = NODE_HBLKFREELIST(HBLK_NODE(hhdr));
+    word *free_bytes = NODE_FREE_BYTES(HBLK_NODE(hhdr));
+    struct hblk *second = freelist[index];
 
 #   if defined(GC_ASSERTIONS) && !defined(USE_MUNMAP)
     {
@@ -394,16 +511,19 @@ STATIC void GC_add_to_fl(struct hblk *h, hdr *hhdr)
       hdr * prevhdr = HDR(prev);
 
       GC_ASSERT(nexthdr == 0 || !HBLK_IS_FREE(nexthdr)
+                || !SAME_HBLK_NODE(hhdr, nexthdr)
                 || (GC_heapsize & SIGNB) != 0);
                 /* In the last case, blocks may be too large to merge. */
       GC_ASSERT(NULL == prev || !HBLK_IS_FREE(prevhdr)
+                || !SAME_HBLK_NODE(hhdr, prevhdr)
                 || (GC_heapsize & SIGNB) != 0);
     }
 #   endif
     GC_ASSERT(modHBLKSZ(hhdr -> hb_sz) == 0);
-    GC_hblkfreelist[index] = h;
-    GC_free_bytes[index] += hhdr -> hb_sz;
-    GC_ASSERT(GC_free_bytes[index] <= GC_large_free_bytes);
+    freelist[index] = h;
+    NODE_FL_MAP(HBLK_NODE(hhdr))[divWORDSZ(index)] |= FL_MAP_BIT(index);
+    free_bytes[index] += hhdr -> hb_sz;
+    GC_ASSERT(free_bytes[index] <= GC_large_free_bytes);
     hhdr -> hb_next = second;
     hhdr -> hb_prev = 0;
     if (second /* != NULL */) { /* CPPCHECK */
@@ -477,20 +597,28 @@ GC_INLINE void GC_adjust_num_unmapped(struct hblk *h, hdr *hhdr)
 /* way blocks are ever unmapped.                                        */
 GC_INNER void GC_unmap_old(unsigned threshold)
 {
-    int i;
+    (void)GC_unmap_old_bytes(threshold, GC_WORD_MAX);
+}
+
+GC_INNER word GC_unmap_old_bytes(unsigned threshold, word max_bytes)
+{
+    int i, node;
+    word bytes = 0;
 
+    GC_ASSERT(I_HOLD_LOCK());
 # ifdef COUNT_UNMAPPED_REGIONS
     /* Skip unmapping if we have already exceeded the soft limit.       */
     /* This forgoes any opportunities to merge unmapped regions though. */
     if (GC_num_unmapped_regions >= GC_UNMAPPED_REGIONS_SOFT_LIMIT)
-      return;
+      return 0;
 # endif
 
+    for (node = 0; node < N_FL_NODES; ++node)
     for (i = 0; i <= N_HBLK_FLS; ++i) {
       struct hblk * h;
       hdr * hhdr;
 
-      for (h = GC_hblkfreelist[i]; 0 != h; h = hhdr -> hb_next) {
+      for (h = NODE_HBLKFREELIST(node)[i]; 0 != h; h = hhdr -> hb_next) {
         hhdr = HDR(h);
         if (!IS_MAPPED(hhdr)) continue;
 
@@ -507,15 +635,18 @@ GC_INNER void GC_unmap_old(unsigned threshold)
 
             if (delta >= 0 && regions >= GC_UNMAPPED_REGIONS_SOFT_LIMIT) {
               GC_COND_LOG_PRINTF("Unmapped regions limit reached!\n");
-              return;
+              return bytes;
             }
             GC_num_unmapped_regions = regions;
 #         endif
           GC_unmap((ptr_t)h, (size_t)hhdr->hb_sz);
           hhdr -> hb_flags |= WAS_UNMAPPED;
+          bytes += hhdr -> hb_sz;
+          if (bytes >= max_bytes) return bytes;
         }
       }
     }
+    return bytes;
 }
 
 /* Merge all unmapped blocks that are adjacent to other free            */
@@ -523,10 +654,11 @@ GC_INNER void GC_unmap_old(unsigned threshold)
 /* fully mapped or fully unmapped.                                      */
 GC_INNER void GC_merge_unmapped(void)
 {
-    int i;
+    int i, node;
 
+    for (node = 0; node < N_FL_NODES; ++node)
     for (i = 0; i <= N_HBLK_FLS; ++i) {
-      struct hblk *h = GC_hblkfreelist[i];
+      struct hblk *h = NODE_HBLKFREELIST(node)[i];
 
       while (h != 0) {
         struct hblk *next;
@@ -539,6 +671,7 @@ GC_INNER void GC_merge_unmapped(void)
         GET_HDR(next, nexthdr);
         /* Coalesce with successor, if possible */
           if (0 != nexthdr && HBLK_IS_FREE(nexthdr)
+              && SAME_HBLK_NODE(hhdr, nexthdr)
               && (signed_word) (size + (nextsize = nexthdr->hb_sz)) > 0
                  /* no pot. overflow */) {
             /* Note that we usually try to avoid adjacent free blocks   */
@@ -579,7 +712,7 @@ GC_INNER void GC_merge_unmapped(void)
             GC_remove_header(next);
             GC_add_to_fl(h, hhdr);
             /* Start over at beginning of list */
-            h = GC_hblkfreelist[i];
+            h = NODE_HBLKFREELIST(node)[i];
           } else /* not mergeable with successor */ {
             h = hhdr -> hb_next;
           }
@@ -619,6 +752,7 @@ STATIC struct hblk * GC_get_first_part(struct hblk *h, hdr *hhdr,
     }
     rest_hdr -> hb_sz = total_size - bytes;
     rest_hdr -> hb_flags = 0;
+    SET_HBLK_NODE(rest_hdr, HBLK_NODE(hhdr));
 #   ifdef GC_ASSERTIONS
       /* Mark h not free, to avoid assertion about adjacent free blocks. */
         hhdr -> hb_flags &= ~FREE_BLK;
@@ -654,16 +788,17 @@ STATIC void GC_split_block(struct hblk *h, hdr *hhdr, struct hblk *n,
       nhdr -> hb_next = next;
       nhdr -> hb_sz = total_size - h_size;
       nhdr -> hb_flags = 0;
+      SET_HBLK_NODE(nhdr, HBLK_NODE(hhdr));
       if (prev /* != NULL */) { /* CPPCHECK */
         HDR(prev) -> hb_next = n;
       } else {
-        GC_hblkfreelist[index] = n;
+        NODE_HBLKFREELIST(HBLK_NODE(hhdr))[index] = n;
       }
       if (next /* != NULL */) {
         HDR(next) -> hb_prev = n;
       }
-      GC_ASSERT(GC_free_bytes[index] > h_size);
-      GC_free_bytes[index] -= h_size;
+      GC_ASSERT(NODE_FREE_BYTES(HBLK_NODE(hhdr))[index] > h_size);
+      NODE_FREE_BYTES(HBLK_NODE(hhdr))[index] -= h_size;
 #   ifdef USE_MUNMAP
       hhdr -> hb_last_reclaimed = (unsigned short)GC_gc_no;
 #   endif
@@ -674,7 +809,7 @@ STATIC void GC_split_block(struct hblk *h, hdr *hhdr, struct hblk *n,
 
 STATIC struct hblk *
 GC_allochblk_nth(size_t sz /* bytes */, int kind, unsigned flags, int n,
-                 int may_split);
+                 int may_split, int node);
 #define AVOID_SPLIT_REMAPPED 2
 
 /*
@@ -695,6 +830,7 @@ GC_allochblk(size_t sz, int kind, unsigned flags/* IGNORE_OFF_PAGE or 0 */)
     int may_split;
     int split_limit; /* Highest index of free list whose blocks we      */
                      /* split.                                          */
+    int i, node = 0;
 
     GC_ASSERT(I_HOLD_LOCK());
     GC_ASSERT((sz & (GRANULE_BYTES - 1)) == 0);
@@ -703,10 +839,15 @@ GC_allochblk(size_t sz, int kind, unsigned flags/* IGNORE_OFF_PAGE or 0 */)
       return 0;
     }
     start_list = GC_hblk_fl_from_blocks(blocks);
+#   ifdef USE_NUMA
+      /* Prefer blocks local to the allocating thread.  */
+      if (GC_numa_nodes > 1) node = GC_numa_current_node();
+#   endif
     /* Try for an exact match first. */
-    result = GC_allochblk_nth(sz, kind, flags, start_list, FALSE);
+    result = GC_allochblk_nth(sz, kind, flags, start_list, FALSE, node);
     if (0 != result) return result;
 
+    GC_PROBE2(hblk_alloc_slow_start, sz, kind);
     may_split = TRUE;
     if (GC_use_entire_heap || GC_dont_gc
         || GC_heapsize - GC_large_free_bytes < GC_requested_heapsize
@@ -730,16 +871,29 @@ GC_allochblk(size_t sz, int kind, unsigned flags/* IGNORE_OFF_PAGE or 0 */)
               may_split = AVOID_SPLIT_REMAPPED;
 #         endif
     }
-    if (start_list < UNIQUE_THRESHOLD) {
-      /* No reason to try start_list again, since all blocks are exact  */
-      /* matches.                                                       */
-      ++start_list;
-    }
-    for (; start_list <= split_limit; ++start_list) {
-        result = GC_allochblk_nth(sz, kind, flags, start_list, may_split);
+    for (i = 0; i < N_FL_NODES; ++i) {
+      int n = start_list;
+
+      if (i > 0) {
+        /* Fall back to the free lists of the other nodes.      */
+        node = (node + 1) % N_FL_NODES;
+        result = GC_allochblk_nth(sz, kind, flags, n, FALSE, node);
+        if (0 != result) break;
+      }
+      if (n < UNIQUE_THRESHOLD) {
+        /* No reason to try start_list again, since all blocks are      */
+        /* exact matches.                                               */
+        ++n;
+      }
+      for (n = GC_next_nonempty_fl(node, n); n <= split_limit;
+           n = GC_next_nonempty_fl(node, n + 1)) {
+        result = GC_allochblk_nth(sz, kind, flags, n, may_split, node);
         if (0 != result)
             break;
+      }
+      if (0 != result) break;
     }
+    GC_PROBE2(hblk_alloc_slow_done, sz, result);
     return result;
 }
 
@@ -750,9 +904,11 @@ STATIC long GC_large_alloc_warn_suppressed = 0;
 /* IGNORE_OFF_PAGE or zero.  sz is in bytes.  The may_split flag        */
 /* indicates whether it is OK to split larger blocks (if set to         */
 /* AVOID_SPLIT_REMAPPED then memory remapping followed by splitting     */
-/* should be generally avoided).                                        */
+/* should be generally avoided).  Only the free lists of the given      */
+/* node are searched.                                                   */
 STATIC struct hblk *
-GC_allochblk_nth(size_t sz, int kind, unsigned flags, int n, int may_split)
+GC_allochblk_nth(size_t sz, int kind, unsigned flags, int n, int may_split,
+                 int node)
 {
     struct hblk *hbp;
     hdr * hhdr;                 /* Header corr. to hbp */
@@ -762,8 +918,10 @@ GC_allochblk_nth(size_t sz, int kind, unsigned flags, int n, int may_split)
                                 /* number of bytes in requested objects */
 
     GC_ASSERT(I_HOLD_LOCK());
+    GC_ASSERT(FL_IS_NONEMPTY(node, n)
+              == (NODE_HBLKFREELIST(node)[n] != NULL));
     /* search for a big enough block in free list */
-        for (hbp = GC_hblkfreelist[n];; hbp = hhdr -> hb_next) {
+        for (hbp = NODE_HBLKFREELIST(node)[n];; hbp = hhdr -> hb_next) {
             signed_word size_avail; /* bytes available in this block */
 
             if (hbp /* != NULL */) {
@@ -805,6 +963,7 @@ GC_allochblk_nth(size_t sz, int kind, unsigned flags, int n, int may_split)
                      && (thishbp = GC_is_black_listed(lasthbp,
                                             (word)eff_size_needed)) != 0) {
                 lasthbp = thishbp;
+                GC_black_list_rejects++;
               }
               size_avail -= (ptr_t)lasthbp - (ptr_t)hbp;
               thishbp = lasthbp;
@@ -817,6 +976,7 @@ GC_allochblk_nth(size_t sz, int kind, unsigned flags, int n, int may_split)
 #                 endif
                   thishdr = GC_install_header(thishbp);
                   if (0 != thishdr) {
+                    SET_HBLK_NODE(thishdr, node);
                   /* Make sure it's mapped before we mangle it. */
 #                   ifdef USE_MUNMAP
                       if (!IS_MAPPED(hhdr)) {
@@ -873,6 +1033,7 @@ GC_allochblk_nth(size_t sz, int kind, unsigned flags, int n, int may_split)
                       for (h = hbp; (word)h < (word)limit; h++) {
                         if (h != hbp) {
                           hhdr = GC_install_header(h);
+                          if (hhdr != NULL) SET_HBLK_NODE(hhdr, node);
                         }
                         if (NULL != hhdr) {
                           (void)setup_header(hhdr, h, HBLKSIZE, PTRFREE, 0);
@@ -885,7 +1046,8 @@ GC_allochblk_nth(size_t sz, int kind, unsigned flags, int n, int may_split)
                     /* Restore hbp to point at free block */
                       hbp = prev;
                       if (0 == hbp) {
-                        return GC_allochblk_nth(sz, kind, flags, n, may_split);
+                        return GC_allochblk_nth(sz, kind, flags, n,
+                                                may_split, node);
                       }
                       hhdr = HDR(hbp);
                   }
@@ -938,6 +1100,319 @@ GC_allochblk_nth(size_t sz, int kind, unsigned flags, int n, int may_split)
     return hbp;
 }
 
+#ifdef USE_HEAP_ARENA
+  GC_INNER GC_bool GC_alloc_hblk_at(struct hblk *fb, struct hblk *h,
+                                    size_t sz, int kind, unsigned flags)
+  {
+    hdr *hhdr = HDR(fb);
+    word size_needed = HBLKSIZE * OBJ_SZ_TO_BLOCKS_CHECKED(sz);
+    int index;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    if (NULL == hhdr || !HBLK_IS_FREE(hhdr) || (word)h < (word)fb
+        || hhdr -> hb_sz < size_needed
+        || (word)h - (word)fb > hhdr -> hb_sz - size_needed)
+      return FALSE;
+    index = GC_hblk_fl_from_blocks(divHBLKSZ(hhdr -> hb_sz));
+    if (h != fb) {
+      hdr *nhdr = GC_install_header(h);
+
+      if (NULL == nhdr) return FALSE;
+      /* Leave the part preceding h free; h replaces fb in the list.   */
+      GC_split_block(fb, hhdr, h, nhdr, index);
+      hhdr = nhdr;
+    }
+    if (NULL == GC_get_first_part(h, hhdr, size_needed, index)
+        || !GC_install_counts(h, (size_t)size_needed))
+      return FALSE; /* the block is dropped */
+    if (!setup_header(hhdr, h, sz, kind, flags)) {
+      GC_remove_counts(h, (size_t)size_needed);
+      return FALSE;
+    }
+#   ifndef GC_DISABLE_INCREMENTAL
+      GC_remove_protection(h, divHBLKSZ(size_needed),
+                           (hhdr -> hb_descr == 0) /* pointer-free */);
+#   endif
+    GC_large_free_bytes -= size_needed;
+    return TRUE;
+  }
+#endif /* USE_HEAP_ARENA */
+
+#ifdef USE_LARGE_OBJ_SPACE
+  GC_INNER word GC_los_threshold = 0;
+
+  STATIC struct HeapSect *GC_los_sects = NULL;
+                        /* The regions of the large-object space sorted */
+                        /* by the start address.                        */
+  STATIC size_t GC_n_los_sects = 0;
+  STATIC size_t GC_capacity_los_sects = 0;
+  STATIC word GC_los_bytes = 0;
+                        /* Total size of the regions (it is included    */
+                        /* in GC_heapsize too).                         */
+
+  /* Return the index of the first region which ends after p.   */
+  STATIC size_t GC_los_sect_index(ptr_t p)
+  {
+    size_t lo = 0;
+    size_t hi = GC_n_los_sects;
+
+    while (lo < hi) {
+      size_t mid = (lo + hi) >> 1;
+
+      if ((word)p < (word)(GC_los_sects[mid].hs_start
+                           + GC_los_sects[mid].hs_bytes)) {
+        hi = mid;
+      } else {
+        lo = mid + 1;
+      }
+    }
+    return lo;
+  }
+
+  GC_INNER GC_bool GC_is_los_page(struct hblk *h)
+  {
+    size_t i;
+
+    if (0 == GC_n_los_sects) return FALSE;
+    i = GC_los_sect_index((ptr_t)h);
+    return i < GC_n_los_sects
+           && (word)GC_los_sects[i].hs_start <= (word)h;
+  }
+
+  /* Ensure there is room for one more entry in GC_los_sects.   */
+  STATIC GC_bool GC_los_reserve_sect(void)
+  {
+    size_t new_capacity;
+    struct HeapSect *new_sects;
+
+    if (GC_n_los_sects < GC_capacity_los_sects) return TRUE;
+    new_capacity = GC_capacity_los_sects > 0 ?
+                        GC_capacity_los_sects * 2 : 32;
+    new_sects = (struct HeapSect *)GC_scratch_alloc(new_capacity
+                                                * sizeof(struct HeapSect));
+    if (EXPECT(NULL == new_sects, FALSE)) return FALSE;
+    if (GC_n_los_sects > 0)
+      BCOPY(GC_los_sects, new_sects,
+            GC_n_los_sects * sizeof(struct HeapSect));
+#   ifndef GWW_VDB
+      if (GC_capacity_los_sects > 0)
+        GC_scratch_recycle_no_gww(GC_los_sects,
+                        GC_capacity_los_sects * sizeof(struct HeapSect));
+#   endif
+    GC_los_sects = new_sects;
+    GC_capacity_los_sects = new_capacity;
+    return TRUE;
+  }
+
+  GC_INNER struct hblk *GC_los_alloc(size_t lb, int k, unsigned flags)
+  {
+    size_t bytes, i;
+    word blocks_sz;
+    struct hblk *h;
+    hdr *hhdr;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    GC_ASSERT(GC_page_size != 0);
+    if (GC_page_size % HBLKSIZE != 0) return NULL;
+    lb = ROUNDUP_GRANULE_SIZE(lb);
+    blocks_sz = OBJ_SZ_TO_BLOCKS_CHECKED(lb) * HBLKSIZE;
+    bytes = ROUNDUP_PAGESIZE((size_t)blocks_sz);
+    if (bytes < blocks_sz) return NULL; /* overflow */
+    if (GC_max_heapsize != 0
+        && (GC_max_heapsize < (word)bytes
+            || GC_heapsize > GC_max_heapsize - (word)bytes))
+      return NULL;
+    if (!GC_los_reserve_sect()) return NULL;
+
+    h = (struct hblk *)GC_unix_get_los_mem(bytes);
+    if (EXPECT(NULL == h, FALSE)) return NULL;
+    hhdr = GC_install_header(h);
+    if (EXPECT(NULL == hhdr, FALSE)) {
+      GC_unix_free_los_mem((ptr_t)h, bytes);
+      return NULL;
+    }
+    if (!GC_install_counts(h, blocks_sz)
+        || !setup_header(hhdr, h, lb, k, flags | LOS_BLK)) {
+      /* Note: GC_install_counts() does not set any count on failure.  */
+      GC_remove_counts(h, blocks_sz);
+      GC_remove_header(h);
+      GC_unix_free_los_mem((ptr_t)h, bytes);
+      return NULL;
+    }
+
+    i = GC_los_sect_index((ptr_t)h);
+    if (i < GC_n_los_sects)
+      memmove(&GC_los_sects[i + 1], &GC_los_sects[i],
+              (GC_n_los_sects - i) * sizeof(struct HeapSect));
+    GC_los_sects[i].hs_start = (ptr_t)h;
+    GC_los_sects[i].hs_bytes = bytes;
+    GC_n_los_sects++;
+    GC_los_bytes += bytes;
+    GC_heapsize += bytes;
+    GC_our_mem_bytes += bytes;
+
+    if ((word)h <= (word)GC_least_plausible_heap_addr
+        || NULL == GC_least_plausible_heap_addr)
+      GC_least_plausible_heap_addr = (void *)((ptr_t)h - sizeof(word));
+    if ((word)h + bytes >= (word)GC_greatest_plausible_heap_addr)
+      GC_greatest_plausible_heap_addr = (void *)((ptr_t)h + bytes);
+    return h;
+  }
+
+  /* Unmap the region of the given large-object space block.    */
+  STATIC void GC_los_free(struct hblk *h, hdr *hhdr)
+  {
+    size_t i = GC_los_sect_index((ptr_t)h);
+    size_t bytes;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    if (i >= GC_n_los_sects || GC_los_sects[i].hs_start != (ptr_t)h)
+      ABORT_ARG1("Bad large-object space deallocation", " of %p", (void *)h);
+    bytes = GC_los_sects[i].hs_bytes;
+    GC_remove_counts(h, HBLKSIZE * OBJ_SZ_TO_BLOCKS(hhdr -> hb_sz));
+    GC_remove_header(h);
+    GC_n_los_sects--;
+    if (i < GC_n_los_sects)
+      memmove(&GC_los_sects[i], &GC_los_sects[i + 1],
+              (GC_n_los_sects - i) * sizeof(struct HeapSect));
+    GC_los_bytes -= bytes;
+    GC_heapsize -= bytes;
+    GC_our_mem_bytes -= bytes;
+    GC_unix_free_los_mem((ptr_t)h, bytes);
+  }
+
+  /* Grow the large-object space block to new_blocks_sz bytes by        */
+  /* remapping its region, thus no byte of the object is copied.  The   */
+  /* region is extended in place if possible, otherwise its pages are   */
+  /* moved to a freshly reserved region.  Returns the new block         */
+  /* address or NULL.                                                   */
+  STATIC struct hblk *GC_los_grow(struct hblk *h, hdr *hhdr,
+                                  word new_blocks_sz)
+  {
+    size_t i = GC_los_sect_index((ptr_t)h);
+    word old_blocks_sz = HBLKSIZE * OBJ_SZ_TO_BLOCKS(hhdr -> hb_sz);
+    size_t old_bytes, bytes;
+    struct hblk *new_h;
+    hdr *new_hhdr;
+    int kind = hhdr -> hb_obj_kind;
+    GC_bool marked;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    GC_ASSERT(i < GC_n_los_sects && GC_los_sects[i].hs_start == (ptr_t)h);
+    old_bytes = GC_los_sects[i].hs_bytes;
+    bytes = ROUNDUP_PAGESIZE((size_t)new_blocks_sz);
+    if (bytes < new_blocks_sz) return NULL; /* overflow */
+    if (bytes > old_bytes && GC_max_heapsize != 0
+        && GC_heapsize - old_bytes > GC_max_heapsize - (word)bytes)
+      return NULL;
+
+    new_h = h;
+    new_hhdr = hhdr;
+    if (bytes <= old_bytes) {
+      /* The page rounding slack suffices (it has never been used).     */
+      if (!GC_install_counts(h, new_blocks_sz)) return NULL;
+      bytes = old_bytes;
+    } else if (GC_unix_remap_los_mem((ptr_t)h, old_bytes, bytes, NULL)) {
+      /* The counts are installed only once the region is extended, as  */
+      /* the pages following it might belong to the heap.               */
+      if (!GC_install_counts(h, new_blocks_sz)) {
+        /* Shrinking in place does not fail.    */
+        (void)GC_unix_remap_los_mem((ptr_t)h, bytes, old_bytes, NULL);
+        return NULL;
+      }
+    } else {
+      new_h = (struct hblk *)GC_unix_get_los_mem(bytes);
+      if (EXPECT(NULL == new_h, FALSE)) return NULL;
+      new_hhdr = GC_install_header(new_h);
+      if (EXPECT(NULL == new_hhdr, FALSE)) {
+        GC_unix_free_los_mem((ptr_t)new_h, bytes);
+        return NULL;
+      }
+      VALIDATE_MARKS(hhdr);
+      marked = mark_bit_from_hdr(hhdr, 0) != 0;
+      if (!GC_install_counts(new_h, new_blocks_sz)
+          || !setup_header(new_hhdr, new_h, (size_t)new_blocks_sz, kind,
+                           hhdr -> hb_flags)
+          || !GC_unix_remap_los_mem((ptr_t)h, old_bytes, bytes,
+                                    (ptr_t)new_h)) {
+        GC_remove_counts(new_h, new_blocks_sz);
+        GC_remove_header(new_h);
+        GC_unix_free_los_mem((ptr_t)new_h, bytes);
+        return NULL;
+      }
+      /* Keep the object marked in case of a collection in progress.    */
+      if (marked) {
+        set_mark_bit_from_hdr(new_hhdr, 0);
+        new_hhdr -> hb_n_marks = 1;
+      }
+      GC_remove_counts(h, old_blocks_sz);
+      GC_remove_header(h);
+
+      GC_n_los_sects--;
+      if (i < GC_n_los_sects)
+        memmove(&GC_los_sects[i], &GC_los_sects[i + 1],
+                (GC_n_los_sects - i) * sizeof(struct HeapSect));
+      i = GC_los_sect_index((ptr_t)new_h);
+      if (i < GC_n_los_sects)
+        memmove(&GC_los_sects[i + 1], &GC_los_sects[i],
+                (GC_n_los_sects - i) * sizeof(struct HeapSect));
+      GC_los_sects[i].hs_start = (ptr_t)new_h;
+      GC_n_los_sects++;
+    }
+    GC_los_sects[i].hs_bytes = bytes;
+    GC_los_bytes += bytes - old_bytes;
+    GC_heapsize += bytes - old_bytes;
+    GC_our_mem_bytes += bytes - old_bytes;
+    new_hhdr -> hb_sz = new_blocks_sz;
+    if (GC_obj_kinds[kind].ok_relocate_descr)
+      new_hhdr -> hb_descr = GC_obj_kinds[kind].ok_descriptor
+                                + new_blocks_sz;
+
+    if ((word)new_h <= (word)GC_least_plausible_heap_addr)
+      GC_least_plausible_heap_addr = (void *)((ptr_t)new_h - sizeof(word));
+    if ((word)new_h + bytes >= (word)GC_greatest_plausible_heap_addr)
+      GC_greatest_plausible_heap_addr = (void *)((ptr_t)new_h + bytes);
+    return new_h;
+  }
+#endif /* USE_LARGE_OBJ_SPACE */
+
+GC_API void GC_CALL GC_set_large_object_threshold(size_t value)
+{
+# ifdef USE_LARGE_OBJ_SPACE
+    DCL_LOCK_STATE;
+
+    LOCK();
+    GC_los_threshold = (word)value;
+    UNLOCK();
+# else
+    UNUSED_ARG(value);
+# endif
+}
+
+GC_API size_t GC_CALL GC_get_large_object_threshold(void)
+{
+# ifdef USE_LARGE_OBJ_SPACE
+    return (size_t)GC_los_threshold;
+# else
+    return 0;
+# endif
+}
+
+GC_API size_t GC_CALL GC_get_large_object_space_bytes(void)
+{
+# ifdef USE_LARGE_OBJ_SPACE
+    size_t bytes;
+    DCL_LOCK_STATE;
+
+    LOCK();
+    bytes = (size_t)GC_los_bytes;
+    UNLOCK();
+    return bytes;
+# else
+    return 0;
+# endif
+}
+
 /*
  * Free a heap block.
  *
@@ -952,6 +1427,12 @@ GC_INNER void GC_freehblk(struct hblk *hbp)
     word size;
 
     GET_HDR(hbp, hhdr);
+#   ifdef USE_LARGE_OBJ_SPACE
+      if (IS_LOS_HDR(hhdr)) {
+        GC_los_free(hbp, hhdr);
+        return;
+      }
+#   endif
     size = HBLKSIZE * OBJ_SZ_TO_BLOCKS(hhdr->hb_sz);
     if ((size & SIGNB) != 0)
       ABORT("Deallocating excessively large block.  Too large an allocation?");
@@ -977,6 +1458,7 @@ GC_INNER void GC_freehblk(struct hblk *hbp)
     prev = GC_free_block_ending_at(hbp);
     /* Coalesce with successor, if possible */
       if(0 != nexthdr && HBLK_IS_FREE(nexthdr) && IS_MAPPED(nexthdr)
+         && SAME_HBLK_NODE(hhdr, nexthdr)
          && (signed_word)(hhdr -> hb_sz + nexthdr -> hb_sz) > 0
          /* no overflow */) {
         GC_remove_from_fl(nexthdr);
@@ -986,7 +1468,7 @@ GC_INNER void GC_freehblk(struct hblk *hbp)
     /* Coalesce with predecessor, if possible. */
       if (prev /* != NULL */) { /* CPPCHECK */
         prevhdr = HDR(prev);
-        if (IS_MAPPED(prevhdr)
+        if (IS_MAPPED(prevhdr) && SAME_HBLK_NODE(hhdr, prevhdr)
             && (signed_word)(hhdr -> hb_sz + prevhdr -> hb_sz) > 0) {
           GC_remove_from_fl(prevhdr);
           prevhdr -> hb_sz += hhdr -> hb_sz;
@@ -1005,3 +1487,63 @@ GC_INNER void GC_freehblk(struct hblk *hbp)
     GC_large_free_bytes += size;
     GC_add_to_fl(hbp, hhdr);
 }
+
+GC_INNER struct hblk *GC_grow_hblk(struct hblk *h, size_t lb)
+{
+    hdr *hhdr = HDR(h);
+    word old_blocks_sz = HBLKSIZE * OBJ_SZ_TO_BLOCKS(hhdr -> hb_sz);
+    word new_blocks_sz, extra;
+    struct hblk *next;
+    hdr *nexthdr;
+    int kind = hhdr -> hb_obj_kind;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    GC_ASSERT(hhdr -> hb_sz > MAXOBJBYTES && HBLKPTR(h) == h);
+    new_blocks_sz = HBLKSIZE * OBJ_SZ_TO_BLOCKS_CHECKED(lb);
+    if (new_blocks_sz <= old_blocks_sz) return h;
+    extra = new_blocks_sz - old_blocks_sz;
+
+#   ifdef USE_LARGE_OBJ_SPACE
+      if (IS_LOS_HDR(hhdr)) {
+        struct hblk *new_h = GC_los_grow(h, hhdr, new_blocks_sz);
+
+        if (new_h != NULL) {
+          if (IS_UNCOLLECTABLE(kind)) GC_non_gc_bytes += extra;
+          GC_bytes_allocd += extra;
+        }
+        return new_h;
+      }
+#   endif
+
+    /* Absorb the beginning of the adjacent free block, if large enough */
+    /* and not black-listed; the rest of it remains free.               */
+    next = h + divHBLKSZ(old_blocks_sz);
+    GET_HDR(next, nexthdr);
+    if (NULL == nexthdr || !HBLK_IS_FREE(nexthdr) || !IS_MAPPED(nexthdr)
+        || !SAME_HBLK_NODE(hhdr, nexthdr) || nexthdr -> hb_sz < extra
+        || GC_is_black_listed(next, extra) != NULL)
+      return NULL;
+    if (NULL == GC_get_first_part(next, nexthdr, (size_t)extra,
+                        GC_hblk_fl_from_blocks(divHBLKSZ(nexthdr -> hb_sz))))
+      return NULL; /* the rest is dropped */
+    GC_large_free_bytes -= extra;
+    GC_remove_header(next);
+    if (!GC_install_counts(h, (size_t)new_blocks_sz))
+      return NULL; /* the absorbed part is leaked, as in GC_allochblk_nth */
+#   ifndef GC_DISABLE_INCREMENTAL
+      GC_remove_protection(next, divHBLKSZ(extra),
+                           (hhdr -> hb_descr == 0) /* pointer-free */);
+#   endif
+    if (GC_debugging_started || GC_obj_kinds[kind].ok_init)
+      BZERO(next, extra);
+
+    hhdr -> hb_sz = new_blocks_sz;
+    if (GC_obj_kinds[kind].ok_relocate_descr)
+      hhdr -> hb_descr = GC_obj_kinds[kind].ok_descriptor + new_blocks_sz;
+    GC_large_allocd_bytes += extra;
+    if (GC_large_allocd_bytes > GC_max_large_allocd_bytes)
+      GC_max_large_allocd_bytes = GC_large_allocd_bytes;
+    if (IS_UNCOLLECTABLE(kind)) GC_non_gc_bytes += extra;
+    GC_bytes_allocd += extra;
+    return h;
+}
@@ -70,21 +70,196 @@ word GC_gc_no = 0;
 #ifndef NO_CLOCK
   static unsigned long full_gc_total_time = 0; /* in ms, may wrap */
   static unsigned full_gc_total_ns_frac = 0; /* fraction of 1 ms */
-  static GC_bool measure_performance = FALSE;
-                /* Do performance measurements if set to true (e.g.,    */
-                /* accumulation of the total time of full collections). */
+  GC_INNER GC_bool GC_measure_performance = FALSE;
+  GC_INNER word GC_root_scan_ns = 0;
+
+  STATIC struct GC_pause_stats_s GC_pause_stats;
+                        /* The world-stopped pauses histogram.  Updated */
+                        /* only if GC_measure_performance.              */
+  STATIC struct GC_phase_times_s GC_cur_phase_times;
+                        /* The phase times of the collection being in   */
+                        /* progress.                                    */
+  STATIC struct GC_phase_times_s GC_last_phase_times;
+                        /* The phase times of the last completed        */
+                        /* collection.                                  */
 
   GC_API void GC_CALL GC_start_performance_measurement(void)
   {
-    measure_performance = TRUE;
+    GC_measure_performance = TRUE;
   }
 
   GC_API unsigned long GC_CALL GC_get_full_gc_total_time(void)
   {
     return full_gc_total_time;
   }
+
+  /* Add a world-stopped pause of the given duration to the histogram.  */
+  STATIC void GC_record_pause(word pause_ns)
+  {
+    word us = pause_ns / 1000;
+    unsigned i;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    if (us < 4) {
+      i = (unsigned)us;
+    } else {
+      unsigned log_us = 2; /* floor(log2(us)) */
+
+      while ((us >> (log_us + 1)) != 0)
+        log_us++;
+      /* Four sub-buckets per each power of two.        */
+      i = 4 * (log_us - 1) + (unsigned)((us >> (log_us - 2)) & 3);
+      if (i >= GC_PAUSE_HIST_BUCKETS)
+        i = GC_PAUSE_HIST_BUCKETS - 1;
+    }
+    GC_pause_stats.histogram[i]++;
+    GC_pause_stats.n_pauses++;
+    GC_pause_stats.total_pause_ns += pause_ns;
+    if (pause_ns > GC_pause_stats.max_pause_ns)
+      GC_pause_stats.max_pause_ns = pause_ns;
+  }
+
+  GC_API void GC_CALL GC_get_pause_stats(struct GC_pause_stats_s *pstats,
+                                         int reset)
+  {
+    DCL_LOCK_STATE;
+
+    LOCK();
+    if (pstats != NULL)
+      BCOPY(&GC_pause_stats, pstats, sizeof(GC_pause_stats));
+    if (reset)
+      BZERO(&GC_pause_stats, sizeof(GC_pause_stats));
+    UNLOCK();
+  }
+
+  GC_API void GC_CALL GC_get_last_phase_times(struct GC_phase_times_s *pt)
+  {
+    DCL_LOCK_STATE;
+
+    LOCK();
+    BCOPY(&GC_last_phase_times, pt, sizeof(GC_last_phase_times));
+    UNLOCK();
+  }
+
+# ifdef PERF_COUNTERS
+    STATIC GC_perf_group_t GC_collector_perf = GC_PERF_GROUP_INITIALIZER;
+                        /* The counters of the thread which performs    */
+                        /* the collection (reopened if it changes).     */
+    STATIC struct GC_perf_counts_s GC_perf_mark_start;
+                        /* The counters at the beginning of the current */
+                        /* world-stopped marking.                       */
+    STATIC GC_bool GC_cur_phase_counters_valid = FALSE;
+    STATIC struct GC_phase_counters_s GC_cur_phase_counters;
+    STATIC GC_bool GC_last_phase_counters_valid = FALSE;
+    STATIC struct GC_phase_counters_s GC_last_phase_counters;
+#   ifdef PARALLEL_MARK
+      STATIC GC_bool GC_markers_perf_cycle_started = FALSE;
+      STATIC struct GC_perf_counts_s GC_markers_perf_at_start;
+                        /* GC_markers_perf_counts at the first pause of */
+                        /* the current collection.                      */
+#   endif
+
+    STATIC void GC_perf_mark_begin(void)
+    {
+      GC_ASSERT(I_HOLD_LOCK());
+#     ifdef PARALLEL_MARK
+        if (GC_parallel && !GC_markers_perf_cycle_started) {
+          GC_acquire_mark_lock();
+          GC_markers_perf_at_start = GC_markers_perf_counts;
+          GC_release_mark_lock();
+          GC_markers_perf_cycle_started = TRUE;
+        }
+#     endif
+      if (GC_perf_read(&GC_collector_perf, &GC_perf_mark_start))
+        GC_cur_phase_counters_valid = TRUE;
+    }
+
+    STATIC void GC_perf_mark_end(void)
+    {
+      struct GC_perf_counts_s counts;
+
+      (void)GC_perf_read(&GC_collector_perf, &counts);
+      GC_perf_add_delta(&GC_cur_phase_counters.mark, &GC_perf_mark_start,
+                        &counts);
+    }
+
+    /* Complete the counters of the current collection given the ones   */
+    /* read at the beginning of the finalization and the reclaim phases */
+    /* and after the latter.                                            */
+    STATIC void GC_perf_collection_end(const struct GC_perf_counts_s *fin,
+                                       const struct GC_perf_counts_s *rcl)
+    {
+      struct GC_perf_counts_s counts;
+
+      GC_ASSERT(I_HOLD_LOCK());
+      (void)GC_perf_read(&GC_collector_perf, &counts);
+      GC_perf_add_delta(&GC_cur_phase_counters.finalize, fin, rcl);
+      GC_perf_add_delta(&GC_cur_phase_counters.reclaim, rcl, &counts);
+#     ifdef PARALLEL_MARK
+        if (GC_markers_perf_cycle_started) {
+          GC_acquire_mark_lock();
+          counts = GC_markers_perf_counts;
+          GC_release_mark_lock();
+          GC_perf_add_delta(&GC_cur_phase_counters.markers,
+                            &GC_markers_perf_at_start, &counts);
+          GC_markers_perf_cycle_started = FALSE;
+        }
+#     endif
+      GC_cur_phase_counters.gc_no = GC_gc_no;
+      if (GC_cur_phase_counters_valid) {
+        GC_last_phase_counters = GC_cur_phase_counters;
+      } else {
+        BZERO(&GC_last_phase_counters, sizeof(GC_last_phase_counters));
+      }
+      GC_last_phase_counters_valid = GC_cur_phase_counters_valid;
+      BZERO(&GC_cur_phase_counters, sizeof(GC_cur_phase_counters));
+      GC_cur_phase_counters_valid = FALSE;
+    }
+# endif /* PERF_COUNTERS */
+
+  /* Account a world-stopped marking pause: stop_time is the time when  */
+  /* the world stopping was initiated, marked_time is when the world    */
+  /* restarting was initiated.  Called after the world is restarted.    */
+  STATIC void GC_record_stopped_mark_times(CLOCK_TYPE stop_time,
+                                           CLOCK_TYPE stopped_time,
+                                           CLOCK_TYPE marked_time)
+  {
+    CLOCK_TYPE done_time;
+    word mark_ns = NS_TIME_DIFF(marked_time, stopped_time);
+    word pause_ns;
+
+    GET_TIME(done_time);
+    pause_ns = NS_TIME_DIFF(done_time, stop_time);
+    GC_cur_phase_times.stop_world_ns += NS_TIME_DIFF(stopped_time,
+                                                     stop_time);
+    GC_cur_phase_times.root_scan_ns += GC_root_scan_ns;
+    GC_cur_phase_times.mark_ns += mark_ns > GC_root_scan_ns ?
+                                        mark_ns - GC_root_scan_ns : 0;
+    GC_cur_phase_times.pause_ns += pause_ns;
+    GC_record_pause(pause_ns);
+#   ifdef PERF_COUNTERS
+      GC_perf_mark_end();
+#   endif
+  }
 #endif /* !NO_CLOCK */
 
+GC_API int GC_CALL GC_get_last_phase_counters(struct GC_phase_counters_s *pc)
+{
+# ifdef PERF_COUNTERS
+    int res;
+    DCL_LOCK_STATE;
+
+    LOCK();
+    BCOPY(&GC_last_phase_counters, pc, sizeof(GC_last_phase_counters));
+    res = (int)GC_last_phase_counters_valid;
+    UNLOCK();
+    return res;
+# else
+    BZERO(pc, sizeof(*pc));
+    return 0;
+# endif
+}
+
 #ifndef GC_DISABLE_INCREMENTAL
   GC_INNER GC_bool GC_incremental = FALSE; /* By default, stop the world. */
   STATIC GC_bool GC_should_start_incremental_collection = FALSE;
@@ -110,7 +285,7 @@ GC_API int GC_CALL GC_is_incremental_mode(void)
 STATIC GC_bool GC_need_full_gc = FALSE;
                            /* Need full GC due to heap growth.  */
 
-#ifdef THREAD_LOCAL_ALLOC
+#if defined(THREAD_LOCAL_ALLOC) || defined(SHARDED_FREE_LISTS)
   GC_INNER GC_bool GC_world_stopped = FALSE;
 #endif
 
@@ -292,6 +467,212 @@ GC_API size_t GC_CALL GC_get_min_bytes_allocd(void)
     return min_bytes_allocd_minimum;
 }
 
+static word soft_heap_limit = 0;
+                        /* The soft limit of the mapped heap size,      */
+                        /* zero means no limit.                         */
+
+GC_API void GC_CALL GC_set_soft_heap_limit(GC_word n)
+{
+    soft_heap_limit = n;
+}
+
+GC_API GC_word GC_CALL GC_get_soft_heap_limit(void)
+{
+    return soft_heap_limit;
+}
+
+GC_INNER word GC_external_bytes = 0;
+
+STATIC word GC_external_bytes_at_gc = 0;
+                /* The value of GC_external_bytes at last collection.   */
+
+GC_API void GC_CALL GC_adjust_external_bytes(GC_signed_word delta)
+{
+#   if defined(THREADS) && defined(AO_HAVE_fetch_and_add)
+      /* Lock-free, thus could be called from a disclaim procedure.     */
+      (void)AO_fetch_and_add((volatile AO_t *)&GC_external_bytes,
+                             (AO_t)delta);
+#   else
+      DCL_LOCK_STATE;
+
+      LOCK();
+      GC_external_bytes += (word)delta;
+      UNLOCK();
+#   endif
+}
+
+GC_ATTR_NO_SANITIZE_THREAD
+GC_INNER word GC_get_external_bytes_inner(void)
+{
+    signed_word bytes = (signed_word)GC_external_bytes;
+
+    return bytes > 0 ? (word)bytes : 0; /* more released than reported */
+}
+
+GC_API GC_word GC_CALL GC_get_external_bytes(void)
+{
+    word bytes;
+    DCL_LOCK_STATE;
+
+    LOCK();
+    bytes = GC_get_external_bytes_inner();
+    UNLOCK();
+    return bytes;
+}
+
+/* Would the heap memory backed by the OS (plus the external memory     */
+/* owned by the objects) exceed the soft limit if expanded by the given */
+/* amount of bytes?                                                     */
+STATIC GC_bool GC_over_soft_heap_limit(word bytes)
+{
+    word mapped_bytes = GC_heapsize - GC_unmapped_bytes
+                        + GC_get_external_bytes_inner();
+
+    return soft_heap_limit != 0
+           && (mapped_bytes >= soft_heap_limit
+               || bytes > soft_heap_limit - mapped_bytes);
+}
+
+#ifdef WATCH_MEMORY_PRESSURE
+  GC_INNER GC_bool GC_memory_pressure = FALSE;
+#endif
+
+static unsigned heap_growth_percent = 0;
+                        /* If non-zero, then the heap is allowed to grow */
+                        /* by the given percentage of the live data (and */
+                        /* roots) between collections instead of the     */
+                        /* amount based on GC_free_space_divisor.        */
+
+GC_API void GC_CALL GC_set_heap_growth_percent(unsigned value)
+{
+    heap_growth_percent = value;
+}
+
+GC_API unsigned GC_CALL GC_get_heap_growth_percent(void)
+{
+    return heap_growth_percent;
+}
+
+static word min_hincr_blocks = MINHINCR;
+static word max_hincr_blocks = MAXHINCR;
+                        /* The bounds (in blocks) of a heap expansion   */
+                        /* step unless more is needed to satisfy the    */
+                        /* allocation request.                          */
+
+GC_API void GC_CALL GC_set_min_heap_increment(size_t bytes)
+{
+    word blocks = divHBLKSZ(bytes) + (modHBLKSZ(bytes) != 0 ? 1 : 0);
+
+    min_hincr_blocks = blocks > 0 ? blocks : 1;
+}
+
+GC_API size_t GC_CALL GC_get_min_heap_increment(void)
+{
+    return (size_t)min_hincr_blocks * HBLKSIZE;
+}
+
+GC_API void GC_CALL GC_set_max_heap_increment(size_t bytes)
+{
+    word blocks = divHBLKSZ(bytes);
+
+    max_hincr_blocks = blocks > 0 ? blocks : 1;
+}
+
+GC_API size_t GC_CALL GC_get_max_heap_increment(void)
+{
+    return (size_t)max_hincr_blocks * HBLKSIZE;
+}
+
+static word live_bytes_peak = 0;
+                        /* The peak of the live data size after the     */
+                        /* recent collections; decays by 1/8 on each    */
+                        /* collection.  Zero means no history yet.      */
+
+#ifndef NO_CLOCK
+  static unsigned gc_cpu_percent = 0;
+                        /* The target share of the elapsed time spent   */
+                        /* in the collector; zero means no pacing.      */
+
+# define PACER_SCALE_ONE 256
+# ifndef PACER_SCALE_MAX
+#   define PACER_SCALE_MAX (64 * PACER_SCALE_ONE)
+# endif
+# define PACER_SCALE_MIN (PACER_SCALE_ONE / 16)
+
+  static word pacer_scale = PACER_SCALE_ONE;
+                        /* The multiplier (in 1/PACER_SCALE_ONE units)  */
+                        /* of the amount returned by min_bytes_allocd() */
+                        /* adjusted after each collection to approach   */
+                        /* gc_cpu_percent.                              */
+
+  static word pacer_mark_ns = 0;
+                        /* The time of the incremental marking (with    */
+                        /* the world running) in the current cycle.     */
+
+  static CLOCK_TYPE pacer_last_end_time;
+  static GC_bool pacer_last_end_valid = FALSE;
+
+  GC_API void GC_CALL GC_set_gc_cpu_percent(unsigned value)
+  {
+    GC_ASSERT(value < 100);
+    if (value != 0) {
+      /* The pacer relies on the phase times.   */
+      GC_measure_performance = TRUE;
+    }
+    gc_cpu_percent = value;
+  }
+
+  GC_API unsigned GC_CALL GC_get_gc_cpu_percent(void)
+  {
+    return gc_cpu_percent;
+  }
+
+  /* Adjust pacer_scale at the end of a collection.  gc_ns is the time  */
+  /* spent in the collector during the collection cycle.                */
+  STATIC void GC_pacer_update(word gc_ns, CLOCK_TYPE done_time)
+  {
+    GC_ASSERT(I_HOLD_LOCK());
+    gc_ns += pacer_mark_ns;
+    pacer_mark_ns = 0;
+    if (pacer_last_end_valid) {
+      word elapsed_us = NS_TIME_DIFF(done_time, pacer_last_end_time) / 1000;
+      word gc_us = gc_ns / 1000;
+      word target_us = elapsed_us < GC_WORD_MAX / 100
+                        ? elapsed_us * gc_cpu_percent / 100
+                        : elapsed_us / 100 * gc_cpu_percent;
+      word ratio; /* measured/target share in 1/PACER_SCALE_ONE units */
+      word new_scale;
+
+      if (0 == target_us) target_us = 1;
+      ratio = gc_us < GC_WORD_MAX / PACER_SCALE_ONE
+                ? gc_us * PACER_SCALE_ONE / target_us
+                : gc_us / target_us * PACER_SCALE_ONE;
+      if (ratio > 16 * PACER_SCALE_ONE)
+        ratio = 16 * PACER_SCALE_ONE; /* limit the step */
+
+      /* The collector share is inversely proportional to the amount    */
+      /* allocated between collections (the cost of a collection is     */
+      /* roughly the same), thus scale the latter by the ratio of the   */
+      /* measured share to the target one, smoothing the changes.       */
+      new_scale = pacer_scale * ratio / PACER_SCALE_ONE;
+      pacer_scale = (pacer_scale + new_scale) / 2;
+      if (pacer_scale < PACER_SCALE_MIN) {
+        pacer_scale = PACER_SCALE_MIN;
+      } else if (pacer_scale > PACER_SCALE_MAX) {
+        pacer_scale = PACER_SCALE_MAX;
+      }
+      GC_COND_LOG_PRINTF("GC time share: %lu%% (target %u%%),"
+                         " trigger scale: %lu/%d\n",
+                         elapsed_us > 0 ? (unsigned long)(gc_us < elapsed_us
+                                ? gc_us * 100 / elapsed_us : 100) : 0UL,
+                         gc_cpu_percent, (unsigned long)pacer_scale,
+                         PACER_SCALE_ONE);
+    }
+    pacer_last_end_time = done_time;
+    pacer_last_end_valid = TRUE;
+  }
+#endif /* !NO_CLOCK */
+
 /* Return the minimum number of bytes that must be allocated between    */
 /* collections to amortize the collection cost.  Should be non-zero.    */
 static word min_bytes_allocd(void)
@@ -326,16 +707,62 @@ static word min_bytes_allocd(void)
     }
 
     total_root_size = 2 * stack_size + GC_root_size;
-    scan_size = 2 * GC_composite_in_use + GC_atomic_in_use / 4
-                + total_root_size;
-    result = scan_size / GC_free_space_divisor;
+    if (heap_growth_percent != 0) {
+      result = (GC_composite_in_use + GC_atomic_in_use + total_root_size)
+                / 100 * heap_growth_percent;
+    } else {
+      scan_size = 2 * GC_composite_in_use + GC_atomic_in_use / 4
+                  + total_root_size;
+      result = scan_size / GC_free_space_divisor;
+    }
     if (GC_incremental) {
       result /= 2;
     }
+#   ifndef NO_CLOCK
+      if (gc_cpu_percent != 0) {
+        result /= PACER_SCALE_ONE;
+        result = result < GC_WORD_MAX / pacer_scale
+                    ? result * pacer_scale : GC_WORD_MAX;
+      }
+#   endif
+    if (soft_heap_limit != 0) {
+      word live_bytes = GC_composite_in_use + GC_atomic_in_use
+                        + GC_get_external_bytes_inner();
+      word headroom = soft_heap_limit > live_bytes
+                        ? soft_heap_limit - live_bytes : 0;
+
+      /* Collect more often as the live data approaches the soft limit, */
+      /* leaving a half of the headroom for the fragmentation, but not  */
+      /* more than 4 times as often (to avoid thrashing if the live     */
+      /* data does not fit the limit).                                  */
+      if (result > headroom / 2)
+        result = headroom / 2 > result / 4 ? headroom / 2 : result / 4;
+    }
     return result > min_bytes_allocd_minimum
             ? result : min_bytes_allocd_minimum;
 }
 
+/* Return the heap size expected to be sufficient for the recent peak   */
+/* of the live data plus the allocation between collections.            */
+STATIC word GC_heap_size_target(void)
+{
+    word bytes = live_bytes_peak + min_bytes_allocd();
+
+    return bytes >= live_bytes_peak ? bytes : GC_WORD_MAX;
+}
+
+#ifdef USE_MUNMAP
+  GC_INNER word GC_unmap_excess_bytes(void)
+  {
+    word mapped_bytes = GC_heapsize - GC_unmapped_bytes;
+    word target;
+
+    if (0 == live_bytes_peak) return GC_WORD_MAX;
+    target = GC_heap_size_target();
+    return mapped_bytes > target ? mapped_bytes - target : 0;
+  }
+#endif
+
 STATIC word GC_non_gc_bytes_at_gc = 0;
                 /* Number of explicitly managed bytes of storage        */
                 /* at last collection.                                  */
@@ -348,6 +775,8 @@ STATIC word GC_adj_bytes_allocd(void)
     signed_word result;
     signed_word expl_managed = (signed_word)GC_non_gc_bytes
                                 - (signed_word)GC_non_gc_bytes_at_gc;
+    signed_word external_growth = (signed_word)GC_get_external_bytes_inner()
+                                - (signed_word)GC_external_bytes_at_gc;
 
     /* Don't count what was explicitly freed, or newly allocated for    */
     /* explicit management.  Note that deallocating an explicitly       */
@@ -355,7 +784,7 @@ STATIC word GC_adj_bytes_allocd(void)
     /* is playing by the rules.                                         */
     result = (signed_word)GC_bytes_allocd
              + (signed_word)GC_bytes_dropped
-             - (signed_word)GC_bytes_freed
+             - (signed_word)GC_EXPL_FREED_BYTES()
              + (signed_word)GC_finalizer_bytes_freed
              - expl_managed;
     if (result > (signed_word)GC_bytes_allocd) {
@@ -367,6 +796,12 @@ STATIC word GC_adj_bytes_allocd(void)
         /* had been reallocated this round. Finalization is user        */
         /* visible progress.  And if we don't count this, we have       */
         /* stability problems for programs that finalize all objects.   */
+    if (external_growth > 0) {
+        /* The growth of the external memory owned by the objects is    */
+        /* counted as allocation (the release of it is not, like for    */
+        /* the explicitly freed objects).                               */
+        result += external_growth;
+    }
     if (result < (signed_word)(GC_bytes_allocd >> 3)) {
         /* Always count at least 1/8 of the allocations.  We don't want */
         /* to collect too infrequently, since that would inhibit        */
@@ -425,6 +860,9 @@ GC_INNER GC_bool GC_should_collect(void)
     }
 # endif
     if (GC_disable_automatic_collection) return FALSE;
+#   ifdef WATCH_MEMORY_PRESSURE
+      if (GC_memory_pressure) return TRUE;
+#   endif
 
     if (GC_last_heap_growth_gc_no == GC_gc_no)
       return TRUE; /* avoid expanding past limits used by blacklisting  */
@@ -462,11 +900,21 @@ GC_INLINE void GC_notify_full_gc(void)
     }
 }
 
-STATIC GC_bool GC_is_full_gc = FALSE;
+GC_INNER GC_bool GC_is_full_gc = FALSE;
 
 STATIC GC_bool GC_stopped_mark(GC_stop_func stop_func);
 STATIC void GC_finish_collection(void);
 
+#ifdef CONCURRENT_MARK
+  /* Used to abandon the initial world-stopped marking as soon as the   */
+  /* collection is initiated, the rest is left to the concurrent        */
+  /* marker thread.                                                     */
+  STATIC int GC_CALLBACK GC_always_stop_func(void)
+  {
+    return TRUE;
+  }
+#endif
+
 /* Initiate a garbage collection if appropriate.  Choose judiciously    */
 /* between partial, full, and stop-world collections.                   */
 STATIC void GC_maybe_gc(void)
@@ -486,6 +934,9 @@ STATIC void GC_maybe_gc(void)
 # ifdef PARALLEL_MARK
     if (GC_parallel)
       GC_wait_for_reclaim();
+# endif
+# ifdef THREAD_LOCAL_SWEEP
+    GC_wait_for_sweep_claims();
 # endif
   if (GC_need_full_gc || n_partial_gcs >= GC_full_freq) {
     GC_COND_LOG_PRINTF(
@@ -501,6 +952,16 @@ STATIC void GC_maybe_gc(void)
     n_partial_gcs++;
   }
 
+# ifdef CONCURRENT_MARK
+    if (GC_concurrent_mark) {
+      /* Stop the world only to read the dirty bits (and to push    */
+      /* the rescuers); the marking is done by the marker thread.   */
+      (void)GC_stopped_mark(GC_always_stop_func);
+      GC_notify_concurrent_marker();
+      return;
+    }
+# endif
+
   /* Try to mark with the world stopped.  If we run out of      */
   /* time, this turns into an incremental marking.              */
 # ifndef NO_CLOCK
@@ -552,6 +1013,7 @@ GC_INNER GC_bool GC_try_to_collect_inner(GC_stop_func stop_func)
     GC_ASSERT(I_HOLD_LOCK());
     GC_ASSERT(GC_is_initialized);
     if (GC_dont_gc || (*stop_func)()) return FALSE;
+    GC_PROBE1(gc_start, GC_gc_no + 1);
     if (GC_on_collection_event)
       GC_on_collection_event(GC_EVENT_START);
     if (GC_incremental && GC_collection_in_progress()) {
@@ -561,6 +1023,7 @@ GC_INNER GC_bool GC_try_to_collect_inner(GC_stop_func stop_func)
         while(GC_collection_in_progress()) {
             if ((*stop_func)()) {
               /* TODO: Notify GC_EVENT_ABANDON */
+              GC_PROBE1(gc_abandon, GC_gc_no);
               return FALSE;
             }
             ENTER_GC();
@@ -571,7 +1034,7 @@ GC_INNER GC_bool GC_try_to_collect_inner(GC_stop_func stop_func)
     GC_notify_full_gc();
 #   ifndef NO_CLOCK
       start_time_valid = FALSE;
-      if ((GC_print_stats | (int)measure_performance) != 0) {
+      if ((GC_print_stats | (int)GC_measure_performance) != 0) {
         if (GC_print_stats)
           GC_log_printf("Initiating full world-stop collection!\n");
         start_time_valid = TRUE;
@@ -587,11 +1050,15 @@ GC_INNER GC_bool GC_try_to_collect_inner(GC_stop_func stop_func)
 #       ifdef PARALLEL_MARK
           if (GC_parallel)
             GC_wait_for_reclaim();
+#       endif
+#       ifdef THREAD_LOCAL_SWEEP
+          GC_wait_for_sweep_claims();
 #       endif
         if ((GC_find_leak || stop_func != GC_never_stop_func)
             && !GC_reclaim_all(stop_func, FALSE)) {
             /* Aborted.  So far everything is still consistent. */
             /* TODO: Notify GC_EVENT_ABANDON */
+            GC_PROBE1(gc_abandon, GC_gc_no);
             return FALSE;
         }
     GC_invalidate_mark_state();  /* Flush mark stack.   */
@@ -610,9 +1077,11 @@ GC_INNER GC_bool GC_try_to_collect_inner(GC_stop_func stop_func)
       } /* else we claim the world is already still consistent.  We'll  */
         /* finish incrementally.                                        */
       /* TODO: Notify GC_EVENT_ABANDON */
+      GC_PROBE1(gc_abandon, GC_gc_no);
       return FALSE;
     }
     GC_finish_collection();
+    GC_finish_start_reclaim(); /* not sliced in the world-stop mode */
 #   ifndef NO_CLOCK
       if (start_time_valid) {
         CLOCK_TYPE current_time;
@@ -621,7 +1090,7 @@ GC_INNER GC_bool GC_try_to_collect_inner(GC_stop_func stop_func)
         GET_TIME(current_time);
         time_diff = MS_TIME_DIFF(current_time, start_time);
         ns_frac_diff = NS_FRAC_TIME_DIFF(current_time, start_time);
-        if (measure_performance) {
+        if (GC_measure_performance) {
           full_gc_total_time += time_diff; /* may wrap */
           full_gc_total_ns_frac += (unsigned)ns_frac_diff;
           if (full_gc_total_ns_frac >= 1000000U) {
@@ -635,6 +1104,7 @@ GC_INNER GC_bool GC_try_to_collect_inner(GC_stop_func stop_func)
                         time_diff, ns_frac_diff);
       }
 #   endif
+    GC_PROBE1(gc_done, GC_gc_no);
     if (GC_on_collection_event)
       GC_on_collection_event(GC_EVENT_END);
     return TRUE;
@@ -687,6 +1157,35 @@ GC_API int GC_CALL GC_get_max_prior_attempts(void)
     return max_prior_attempts;
 }
 
+/* Complete the incremental collection once the marking done with the   */
+/* world running is over: mark again from the roots (and the pages      */
+/* dirtied meanwhile) with the world stopped, and then sweep.           */
+STATIC void GC_finish_incremental_mark(void)
+{
+    GC_ASSERT(!GC_collection_in_progress());
+#   ifdef SAVE_CALL_CHAIN
+        GC_save_callers(GC_last_stack);
+#   endif
+#   ifdef PARALLEL_MARK
+        if (GC_parallel)
+            GC_wait_for_reclaim();
+#   endif
+#   ifdef THREAD_LOCAL_SWEEP
+        GC_wait_for_sweep_claims();
+#   endif
+#   ifndef NO_CLOCK
+        if (GC_time_limit != GC_TIME_UNLIMITED
+                && GC_n_attempts < max_prior_attempts)
+            GET_TIME(GC_start_time);
+#   endif
+    if (GC_stopped_mark(GC_n_attempts < max_prior_attempts ?
+                        GC_timeout_stop_func : GC_never_stop_func)) {
+        GC_finish_collection();
+    } else {
+        GC_n_attempts++;
+    }
+}
+
 GC_INNER void GC_collect_a_little_inner(int n)
 {
     IF_CANCEL(int cancel_state;)
@@ -699,6 +1198,12 @@ GC_INNER void GC_collect_a_little_inner(int n)
     if (GC_incremental && GC_collection_in_progress()) {
         int i;
         int max_deficit = GC_rate * n;
+#       ifndef NO_CLOCK
+          CLOCK_TYPE step_start_time = CLOCK_TYPE_INITIALIZER;
+
+          if (gc_cpu_percent != 0)
+            GET_TIME(step_start_time);
+#       endif
 
 #       ifdef PARALLEL_MARK
             if (GC_time_limit != GC_TIME_UNLIMITED)
@@ -711,40 +1216,201 @@ GC_INNER void GC_collect_a_little_inner(int n)
 #       ifdef PARALLEL_MARK
             GC_parallel_mark_disabled = FALSE;
 #       endif
+#       ifndef NO_CLOCK
+          if (gc_cpu_percent != 0) {
+            CLOCK_TYPE step_end_time;
+
+            GET_TIME(step_end_time);
+            pacer_mark_ns += NS_TIME_DIFF(step_end_time, step_start_time);
+          }
+#       endif
 
         if (i < max_deficit) {
-            GC_ASSERT(!GC_collection_in_progress());
             /* Need to follow up with a full collection.        */
-#           ifdef SAVE_CALL_CHAIN
-                GC_save_callers(GC_last_stack);
-#           endif
-#           ifdef PARALLEL_MARK
-                if (GC_parallel)
-                    GC_wait_for_reclaim();
-#           endif
-#           ifndef NO_CLOCK
-                if (GC_time_limit != GC_TIME_UNLIMITED
-                        && GC_n_attempts < max_prior_attempts)
-                    GET_TIME(GC_start_time);
-#           endif
-            if (GC_stopped_mark(GC_n_attempts < max_prior_attempts ?
-                                GC_timeout_stop_func : GC_never_stop_func)) {
-                GC_finish_collection();
-            } else {
-                GC_n_attempts++;
-            }
+            GC_finish_incremental_mark();
         }
         if (GC_deficit > 0) {
             GC_deficit -= max_deficit;
             if (GC_deficit < 0)
                 GC_deficit = 0;
         }
+    } else if (GC_start_reclaim_pending) {
+        /* Examine the next portion of the heap blocks left unswept by  */
+        /* the last collection before starting a new one.               */
+#       ifdef PARALLEL_MARK
+            if (GC_parallel)
+                GC_wait_for_reclaim();
+#       endif
+#       ifdef THREAD_LOCAL_SWEEP
+            GC_wait_for_sweep_claims();
+#       endif
+#       ifndef NO_CLOCK
+            GET_TIME(GC_start_time);
+#       endif
+        (void)GC_continue_start_reclaim(GC_timeout_stop_func);
     } else {
         GC_maybe_gc();
     }
     RESTORE_CANCEL(cancel_state);
 }
 
+#ifdef CONCURRENT_MARK
+# ifndef CONCURRENT_MARK_STEPS
+    /* The maximum number of GC_mark_some calls done by the concurrent  */
+    /* marker before it releases the allocation lock for a while.       */
+#   define CONCURRENT_MARK_STEPS 64
+# endif
+# ifndef CONCURRENT_MARK_SLICE
+    /* The default time (in microseconds) the concurrent marker could   */
+    /* hold the allocation lock for.                                    */
+#   define CONCURRENT_MARK_SLICE 500
+# endif
+
+  STATIC unsigned long GC_concurrent_mark_slice = CONCURRENT_MARK_SLICE;
+                        /* Zero means the slice is bounded only by      */
+                        /* CONCURRENT_MARK_STEPS.                       */
+
+# ifndef NO_CLOCK
+    STATIC unsigned long GC_conc_mark_slices = 0;
+                        /* The number of the slices of the current      */
+                        /* collection cycle.  Used only for logging.    */
+    STATIC unsigned long GC_conc_mark_max_slice_ns = 0;
+                        /* The longest one of them (in nanoseconds).    */
+# endif
+
+  GC_API void GC_CALL GC_set_concurrent_mark_slice(unsigned long value)
+  {
+    GC_concurrent_mark_slice = value;
+  }
+
+  GC_API unsigned long GC_CALL GC_get_concurrent_mark_slice(void)
+  {
+    return GC_concurrent_mark_slice;
+  }
+
+  GC_INNER GC_bool GC_concurrent_mark_some(void)
+  {
+    int i;
+    GC_bool done = FALSE;
+#   ifndef NO_CLOCK
+      CLOCK_TYPE start_time = CLOCK_TYPE_INITIALIZER;
+      CLOCK_TYPE current_time;
+#   endif
+
+    GC_ASSERT(I_HOLD_LOCK());
+    ASSERT_CANCEL_DISABLED();
+    if (GC_dont_gc || !GC_incremental || !GC_collection_in_progress())
+      return FALSE;
+
+#   ifndef NO_CLOCK
+      GET_TIME(start_time);
+#   endif
+    /* The parallel marker is not disabled here, thus the last phase    */
+    /* of marking (once the roots are pushed) is done by all the        */
+    /* marker threads at once, i.e. in a single step which cannot be    */
+    /* interrupted when the slice is over.                              */
+    for (i = 0; i < CONCURRENT_MARK_STEPS; i++) {
+      if (GC_mark_some(NULL)) {
+        done = TRUE;
+        break;
+      }
+#     ifndef NO_CLOCK
+        if (GC_concurrent_mark_slice != 0) {
+          GET_TIME(current_time);
+          if (NS_TIME_DIFF(current_time, start_time) / 1000
+                >= GC_concurrent_mark_slice)
+            break;
+        }
+#     endif
+    }
+#   ifndef NO_CLOCK
+      if (GC_print_stats) {
+        unsigned long slice_ns;
+
+        GET_TIME(current_time);
+        slice_ns = (unsigned long)NS_TIME_DIFF(current_time, start_time);
+        GC_conc_mark_slices++;
+        if (slice_ns > GC_conc_mark_max_slice_ns)
+          GC_conc_mark_max_slice_ns = slice_ns;
+      }
+#   endif
+    if (done)
+      GC_finish_incremental_mark();
+    return GC_collection_in_progress();
+  }
+
+# ifndef NO_CLOCK
+    /* Log the number of the concurrent marker slices and the longest   */
+    /* one for the collection being finished (by any thread).           */
+    STATIC void GC_log_concurrent_mark_slices(void)
+    {
+      if (0 == GC_conc_mark_slices) return;
+      GC_log_printf("Concurrent marking took %lu slices,"
+                    " the longest one is %lu us\n",
+                    GC_conc_mark_slices, GC_conc_mark_max_slice_ns / 1000);
+      GC_conc_mark_slices = 0;
+      GC_conc_mark_max_slice_ns = 0;
+    }
+# endif
+#endif /* CONCURRENT_MARK */
+
+#ifdef BACKGROUND_GC
+# ifndef BACKGROUND_GC_HARD_LIMIT
+    /* The allocating thread does the collection itself once it has     */
+    /* allocated this many times the usual collection trigger amount.   */
+#   define BACKGROUND_GC_HARD_LIMIT 2
+# endif
+# ifndef BACKGROUND_GC_STEPS
+    /* The number of incremental collection steps done by the           */
+    /* background collector before it releases the allocation lock.     */
+#   define BACKGROUND_GC_STEPS 16
+# endif
+
+  GC_INNER GC_bool GC_background_gc_lags(void)
+  {
+    GC_ASSERT(I_HOLD_LOCK());
+    return GC_adj_bytes_allocd()
+            >= BACKGROUND_GC_HARD_LIMIT * min_bytes_allocd();
+  }
+
+  GC_INNER GC_bool GC_background_collect_some(void)
+  {
+    GC_ASSERT(I_HOLD_LOCK());
+    ASSERT_CANCEL_DISABLED();
+    if (GC_dont_gc) return FALSE;
+    if (!GC_incremental) {
+      if (GC_should_collect())
+        (void)GC_try_to_collect_inner(GC_default_stop_func);
+      return FALSE;
+    }
+    /* Initiate the collection (if appropriate) and do some marking.    */
+    GC_collect_a_little_inner(BACKGROUND_GC_STEPS);
+    return GC_collection_in_progress();
+  }
+#endif /* BACKGROUND_GC */
+
+#if defined(CONCURRENT_MARK) || defined(BACKGROUND_GC)
+  GC_INNER void GC_collect_a_little_or_notify(int n)
+  {
+    GC_ASSERT(I_HOLD_LOCK());
+#   ifdef CONCURRENT_MARK
+      if (GC_concurrent_mark && GC_incremental
+          && GC_collection_in_progress()) {
+        /* The marking is done by the dedicated thread.   */
+        GC_notify_concurrent_marker();
+        return;
+      }
+#   endif
+#   ifdef BACKGROUND_GC
+      if (GC_background_gc && GC_incremental && !GC_background_gc_lags()) {
+        GC_notify_background_gc();
+        return;
+      }
+#   endif
+    GC_collect_a_little_inner(n);
+  }
+#endif
+
 GC_INNER void (*GC_check_heap)(void) = 0;
 GC_INNER void (*GC_print_all_smashed)(void) = 0;
 
@@ -756,7 +1422,8 @@ GC_API int GC_CALL GC_collect_a_little(void)
     if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
     LOCK();
     ENTER_GC();
-    GC_collect_a_little_inner(1);
+    /* Do not mark in parallel with the concurrent marker.      */
+    GC_collect_a_little_or_notify(1);
     EXIT_GC();
     result = (int)GC_collection_in_progress();
     UNLOCK();
@@ -764,6 +1431,178 @@ GC_API int GC_CALL GC_collect_a_little(void)
     return result;
 }
 
+#ifndef NO_CLOCK
+  STATIC CLOCK_TYPE GC_idle_start_time = CLOCK_TYPE_INITIALIZER;
+  STATIC unsigned long GC_idle_time_budget_ns = 0;
+                        /* The start time and the time budget of the    */
+                        /* current GC_collect_idle call.                */
+
+  STATIC GC_bool GC_idle_time_over(void)
+  {
+    CLOCK_TYPE current_time;
+
+    GET_TIME(current_time);
+    return NS_TIME_DIFF(current_time, GC_idle_start_time)
+            >= (word)GC_idle_time_budget_ns;
+  }
+
+  STATIC int GC_CALLBACK GC_idle_stop_func(void)
+  {
+    static unsigned count = 0;
+
+    if (GC_default_stop_func())
+      return TRUE;
+    return (count++ & 3) == 0 && GC_idle_time_over();
+  }
+#else
+  /* The time budget is ignored.        */
+# define GC_idle_time_over() FALSE
+# define GC_idle_stop_func GC_default_stop_func
+#endif /* NO_CLOCK */
+
+STATIC void GC_wait_for_pending_sweep(void)
+{
+#   ifdef PARALLEL_MARK
+      if (GC_parallel)
+        GC_wait_for_reclaim();
+#   endif
+#   ifdef THREAD_LOCAL_SWEEP
+      GC_wait_for_sweep_claims();
+#   endif
+}
+
+/* Do as much of the pending collection work as fits the time budget of */
+/* GC_collect_idle: finish the sweep initiation left by the latest      */
+/* collection, start a new collection (if a notable amount has been     */
+/* allocated since the latest one), mark, sweep the rest of the heap    */
+/* and unmap the unneeded free blocks.                                  */
+STATIC void GC_collect_idle_inner(void)
+{
+    GC_ASSERT(I_HOLD_LOCK());
+    ASSERT_CANCEL_DISABLED();
+    if (GC_start_reclaim_pending) {
+      GC_wait_for_pending_sweep();
+      if (!GC_continue_start_reclaim(GC_idle_stop_func)) return;
+    }
+
+    if (!GC_collection_in_progress() && !GC_disable_automatic_collection
+        && GC_adj_bytes_allocd() >= min_bytes_allocd() / 4) {
+      /* Collect earlier than GC_should_collect would suggest, as the  */
+      /* client is idle now.                                            */
+#     ifndef GC_DISABLE_INCREMENTAL
+        if (GC_incremental) {
+          GC_should_start_incremental_collection = TRUE;
+          GC_maybe_gc();
+        } else
+#     endif
+      /* else */ {
+        if (!GC_try_to_collect_inner(GC_idle_stop_func)) return;
+      }
+    }
+
+    if (GC_incremental && GC_collection_in_progress()) {
+#     ifdef PARALLEL_MARK
+        GC_parallel_mark_disabled = TRUE;
+#     endif
+      while (!GC_idle_stop_func()) {
+        if (GC_mark_some(NULL)) {
+#         ifdef PARALLEL_MARK
+            GC_parallel_mark_disabled = FALSE;
+#         endif
+          GC_finish_incremental_mark();
+          break;
+        }
+      }
+#     ifdef PARALLEL_MARK
+        GC_parallel_mark_disabled = FALSE;
+#     endif
+      if (GC_collection_in_progress()) return;
+    }
+
+    if (GC_start_reclaim_pending
+        && !GC_continue_start_reclaim(GC_idle_stop_func)) return;
+    if (GC_idle_time_over()) return;
+    GC_wait_for_pending_sweep();
+    if (!GC_reclaim_all(GC_idle_stop_func, FALSE)) return;
+
+#   ifdef USE_MUNMAP
+      if (GC_unmap_threshold > 0) {
+        word max_bytes = GC_unmap_excess_bytes();
+
+        if (max_bytes > 0
+            && GC_unmap_old_bytes(GC_unmap_threshold, max_bytes) > 0)
+          GC_merge_unmapped();
+      }
+#   endif
+}
+
+GC_API int GC_CALL GC_collect_idle(unsigned long time_budget_ns)
+{
+    int result;
+    GC_bool time_left = FALSE;
+    IF_CANCEL(int cancel_state;)
+    DCL_LOCK_STATE;
+
+    if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+    LOCK();
+#   ifndef NO_CLOCK
+      GET_TIME(GC_idle_start_time);
+      GC_idle_time_budget_ns = time_budget_ns;
+#   else
+      UNUSED_ARG(time_budget_ns);
+#   endif
+    if (!GC_dont_gc) {
+      DISABLE_CANCEL(cancel_state);
+      ENTER_GC();
+      GC_collect_idle_inner();
+      EXIT_GC();
+      RESTORE_CANCEL(cancel_state);
+      time_left = !GC_idle_time_over();
+    }
+    result = (int)(GC_collection_in_progress() || GC_start_reclaim_pending);
+    UNLOCK();
+    if (time_left) GC_INVOKE_FINALIZERS();
+    if (!result && GC_debugging_started) GC_print_all_smashed();
+    return result;
+}
+
+GC_INNER GC_bool GC_collect_and_sweep_inner(void)
+{
+    GC_bool result;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    ENTER_GC();
+    result = GC_try_to_collect_inner(GC_never_stop_func);
+    EXIT_GC();
+    if (result) {
+      GC_wait_for_pending_sweep();
+      if (GC_start_reclaim_pending)
+        (void)GC_continue_start_reclaim(GC_never_stop_func);
+      GC_wait_for_pending_sweep();
+    }
+    return result;
+}
+
+GC_API int GC_CALL GC_freeze_heap(void)
+{
+    GC_bool result = FALSE;
+    IF_CANCEL(int cancel_state;)
+    DCL_LOCK_STATE;
+
+    if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+    LOCK();
+    if (!GC_dont_gc && !GC_find_leak) {
+      DISABLE_CANCEL(cancel_state);
+      /* The blocks should be swept before freezing (the empty ones     */
+      /* are freed), but the free lists are dropped then anyway.        */
+      result = GC_collect_and_sweep_inner();
+      if (result) GC_freeze_heap_blocks();
+      RESTORE_CANCEL(cancel_state);
+    }
+    UNLOCK();
+    return (int)result;
+}
+
 #ifndef NO_CLOCK
   /* Variables for world-stop average delay time statistic computation. */
   /* "divisor" is incremented every world-stop and halved when reached  */
@@ -800,6 +1639,12 @@ STATIC GC_bool GC_stopped_mark(GC_stop_func stop_func)
     ptr_t cold_gc_frame = GC_approx_sp();
 #   ifndef NO_CLOCK
       CLOCK_TYPE start_time = CLOCK_TYPE_INITIALIZER;
+      CLOCK_TYPE stop_time = CLOCK_TYPE_INITIALIZER;
+      CLOCK_TYPE stopped_time = CLOCK_TYPE_INITIALIZER;
+      CLOCK_TYPE marked_time = CLOCK_TYPE_INITIALIZER;
+      GC_bool measure_pause = GC_measure_performance;
+                /* A local copy to be consistent even if the flag is    */
+                /* set while we are in the middle of the marking.       */
 #   endif
 
     GC_ASSERT(I_HOLD_LOCK());
@@ -807,6 +1652,7 @@ STATIC GC_bool GC_stopped_mark(GC_stop_func stop_func)
 #   if !defined(REDIRECT_MALLOC) && defined(USE_WINALLOC)
         GC_add_current_malloc_heap();
 #   endif
+    GC_REGISTER_DEFERRED_ROOTS();
 #   if defined(REGISTER_LIBRARIES_EARLY)
         GC_cond_register_dynamic_libraries();
 #   endif
@@ -822,14 +1668,27 @@ STATIC GC_bool GC_stopped_mark(GC_stop_func stop_func)
 #   ifdef THREADS
       if (GC_on_collection_event)
         GC_on_collection_event(GC_EVENT_PRE_STOP_WORLD);
+#   endif
+#   ifndef NO_CLOCK
+      if (measure_pause)
+        GET_TIME(stop_time);
 #   endif
     STOP_WORLD();
+#   ifndef NO_CLOCK
+      if (measure_pause) {
+        GET_TIME(stopped_time);
+        GC_root_scan_ns = 0;
+#       ifdef PERF_COUNTERS
+          GC_perf_mark_begin();
+#       endif
+      }
+#   endif
 #   ifdef THREADS
       if (GC_on_collection_event)
         GC_on_collection_event(GC_EVENT_POST_STOP_WORLD);
 #   endif
 
-#   ifdef THREAD_LOCAL_ALLOC
+#   if defined(THREAD_LOCAL_ALLOC) || defined(SHARDED_FREE_LISTS)
       GC_world_stopped = TRUE;
 #   endif
         /* Output blank line for convenience here */
@@ -875,7 +1734,7 @@ STATIC GC_bool GC_stopped_mark(GC_stop_func stop_func)
           GC_COND_LOG_PRINTF("Abandoned stopped marking after"
                              " %d iterations\n", i);
           GC_deficit = i;       /* Give the mutator a chance.   */
-#         ifdef THREAD_LOCAL_ALLOC
+#         if defined(THREAD_LOCAL_ALLOC) || defined(SHARDED_FREE_LISTS)
             GC_world_stopped = FALSE;
 #         endif
 
@@ -883,9 +1742,18 @@ STATIC GC_bool GC_stopped_mark(GC_stop_func stop_func)
             if (GC_on_collection_event)
               GC_on_collection_event(GC_EVENT_PRE_START_WORLD);
 #         endif
+#         ifndef NO_CLOCK
+            if (measure_pause)
+              GET_TIME(marked_time);
+#         endif
 
           START_WORLD();
 
+#         ifndef NO_CLOCK
+            if (measure_pause)
+              GC_record_stopped_mark_times(stop_time, stopped_time,
+                                           marked_time);
+#         endif
 #         ifdef THREADS
             if (GC_on_collection_event)
               GC_on_collection_event(GC_EVENT_POST_START_WORLD);
@@ -906,12 +1774,20 @@ STATIC GC_bool GC_stopped_mark(GC_stop_func stop_func)
         GC_on_collection_event(GC_EVENT_PRE_START_WORLD);
 #     endif
     }
-#   ifdef THREAD_LOCAL_ALLOC
+#   if defined(THREAD_LOCAL_ALLOC) || defined(SHARDED_FREE_LISTS)
       GC_world_stopped = FALSE;
 #   endif
+#   ifndef NO_CLOCK
+      if (measure_pause)
+        GET_TIME(marked_time);
+#   endif
 
     START_WORLD();
 
+#   ifndef NO_CLOCK
+      if (measure_pause)
+        GC_record_stopped_mark_times(stop_time, stopped_time, marked_time);
+#   endif
 #   ifdef THREADS
       if (GC_on_collection_event)
         GC_on_collection_event(GC_EVENT_POST_START_WORLD);
@@ -963,6 +1839,7 @@ GC_INNER void GC_set_fl_marks(ptr_t q)
       for (;;) {
         word bit_no = MARK_BIT_NO((ptr_t)q - (ptr_t)h, sz);
 
+        VALIDATE_MARKS(hhdr);
         if (!mark_bit_from_hdr(hhdr, bit_no)) {
           set_mark_bit_from_hdr(hhdr, bit_no);
           ++hhdr -> hb_n_marks;
@@ -1039,6 +1916,7 @@ STATIC void GC_clear_fl_marks(ptr_t q)
       for (;;) {
         word bit_no = MARK_BIT_NO((ptr_t)q - (ptr_t)h, sz);
 
+        VALIDATE_MARKS(hhdr);
         if (mark_bit_from_hdr(hhdr, bit_no)) {
           size_t n_marks = hhdr -> hb_n_marks;
 
@@ -1103,6 +1981,10 @@ STATIC void GC_finish_collection(void)
 #   ifndef NO_CLOCK
       CLOCK_TYPE start_time = CLOCK_TYPE_INITIALIZER;
       CLOCK_TYPE finalize_time = CLOCK_TYPE_INITIALIZER;
+      GC_bool measure_phases = GC_measure_performance;
+#   endif
+#   ifdef PERF_COUNTERS
+      struct GC_perf_counts_s fin_counts, rcl_counts;
 #   endif
 
     GC_ASSERT(I_HOLD_LOCK());
@@ -1112,10 +1994,24 @@ STATIC void GC_finish_collection(void)
         /* TODO: Add more checks. */
         GC_check_tls();
 #   endif
+#   ifdef SHARDED_FREE_LISTS
+      /* The shards were marked, move the objects to the free lists,    */
+      /* so that their mark bits are cleared by GC_clear_fl_marks below */
+      /* and the objects are reclaimed by the sweep.                    */
+      GC_flush_fl_shards();
+#   endif
 
 #   ifndef NO_CLOCK
-      if (GC_print_stats)
+      if ((GC_print_stats | (int)measure_phases) != 0)
         GET_TIME(start_time);
+#   endif
+#   if defined(CONCURRENT_MARK) && !defined(NO_CLOCK)
+      if (GC_print_stats)
+        GC_log_concurrent_mark_slices();
+#   endif
+#   ifdef PERF_COUNTERS
+      if (measure_phases)
+        (void)GC_perf_read(&GC_collector_perf, &fin_counts);
 #   endif
     if (GC_on_collection_event)
       GC_on_collection_event(GC_EVENT_RECLAIM_START);
@@ -1153,9 +2049,13 @@ STATIC void GC_finish_collection(void)
       GC_finalize();
 #   endif
 #   ifndef NO_CLOCK
-      if (GC_print_stats)
+      if ((GC_print_stats | (int)measure_phases) != 0)
         GET_TIME(finalize_time);
 #   endif
+#   ifdef PERF_COUNTERS
+      if (measure_phases)
+        (void)GC_perf_read(&GC_collector_perf, &rcl_counts);
+#   endif
 
     if (GC_print_back_height) {
 #     ifdef MAKE_BACK_GRAPH
@@ -1189,15 +2089,59 @@ STATIC void GC_finish_collection(void)
     GC_VERBOSE_LOG_PRINTF("Bytes recovered before sweep - f.l. count = %ld\n",
                           (long)GC_bytes_found);
 
+#   ifdef HEAP_PROFILE
+      GC_heap_prof_after_mark();
+#   endif
+#   ifdef LIFETIME_SAMPLING
+      GC_lifetime_after_mark();
+#   endif
+
+    /* Update the live data history used for the heap sizing.   */
+    live_bytes_peak -= live_bytes_peak >> 3;
+
+#   if !defined(GC_NO_FINALIZATION) && !defined(GC_MOVABLE_NOT_NEEDED)
+      if (!GC_find_leak) GC_evacuate_movable();
+#   endif
+
     /* Reconstruct free lists to contain everything not marked */
     GC_start_reclaim(FALSE);
+    /* With a pause time limit, the rest of the heap blocks is examined */
+    /* by GC_collect_a_little_inner.                                    */
+    (void)GC_continue_start_reclaim(GC_timeout_stop_func);
+    if (GC_composite_in_use + GC_atomic_in_use > live_bytes_peak)
+      live_bytes_peak = GC_composite_in_use + GC_atomic_in_use;
 
 #   ifdef USE_MUNMAP
       if (GC_unmap_threshold > 0 /* unmapping enabled? */
-          && EXPECT(GC_gc_no != 1, TRUE)) /* do not unmap during GC init */
-        GC_unmap_old(GC_unmap_threshold);
+          && EXPECT(GC_gc_no != 1, TRUE) /* do not unmap during GC init */
+#         ifdef SCAVENGER_THREAD
+            /* Leave it to the scavenger unless unmapping is forced.    */
+            && (0 == GC_scavenger_rate || 1 == GC_unmap_threshold)
+#         endif
+         ) {
+        /* Keep the memory the recent live data is likely to need again */
+        /* mapped (unless unmapping is forced) to avoid the heap        */
+        /* oscillation under a bursty load.                             */
+        word max_bytes = 1 == GC_unmap_threshold ? GC_WORD_MAX
+                            : GC_unmap_excess_bytes();
+
+        if (max_bytes > 0)
+          (void)GC_unmap_old_bytes(GC_unmap_threshold, max_bytes);
+      }
+      if (GC_unmap_threshold > 0
+          && (GC_over_soft_heap_limit(0)
+#             ifdef WATCH_MEMORY_PRESSURE
+                || GC_memory_pressure
+#             endif
+             )) {
+        /* Return all the free blocks to the OS regardless of age.      */
+        GC_unmap_old(0);
+      }
 
       GC_ASSERT(GC_heapsize >= GC_unmapped_bytes);
+#   endif
+#   ifdef WATCH_MEMORY_PRESSURE
+      GC_memory_pressure = FALSE;
 #   endif
     GC_ASSERT(GC_our_mem_bytes >= GC_heapsize);
     GC_DBGLOG_PRINTF("GC #%lu freed %ld bytes, heap %lu KiB ("
@@ -1222,14 +2166,38 @@ STATIC void GC_finish_collection(void)
     GC_is_full_gc = FALSE;
     GC_bytes_allocd_before_gc += GC_bytes_allocd;
     GC_non_gc_bytes_at_gc = GC_non_gc_bytes;
+    GC_external_bytes_at_gc = GC_get_external_bytes_inner();
     GC_bytes_allocd = 0;
     GC_bytes_dropped = 0;
     GC_bytes_freed = 0;
     GC_finalizer_bytes_freed = 0;
+#   ifdef PARALLEL_MARK
+      if (GC_parallel)
+        GC_marker_stats_next_cycle();
+#   endif
 
     if (GC_on_collection_event)
       GC_on_collection_event(GC_EVENT_RECLAIM_END);
 #   ifndef NO_CLOCK
+      if (measure_phases) {
+        CLOCK_TYPE done_time;
+
+        GET_TIME(done_time);
+        GC_cur_phase_times.gc_no = GC_gc_no;
+        GC_cur_phase_times.finalize_ns = NS_TIME_DIFF(finalize_time,
+                                                      start_time);
+        GC_cur_phase_times.reclaim_ns = NS_TIME_DIFF(done_time,
+                                                     finalize_time);
+        if (gc_cpu_percent != 0)
+          GC_pacer_update(GC_cur_phase_times.pause_ns
+                          + GC_cur_phase_times.finalize_ns
+                          + GC_cur_phase_times.reclaim_ns, done_time);
+        GC_last_phase_times = GC_cur_phase_times;
+        BZERO(&GC_cur_phase_times, sizeof(GC_cur_phase_times));
+#       ifdef PERF_COUNTERS
+          GC_perf_collection_end(&fin_counts, &rcl_counts);
+#       endif
+      }
       if (GC_print_stats) {
         CLOCK_TYPE done_time;
 
@@ -1271,6 +2239,7 @@ STATIC GC_bool GC_try_to_collect_general(GC_stop_func stop_func,
       /* Record current heap size to make heap growth more conservative */
       /* afterwards (as if the heap is growing from zero size again).   */
       GC_heapsize_at_forced_unmap = GC_heapsize;
+      live_bytes_peak = 0; /* forget the live data history */
     }
     DISABLE_CANCEL(cancel_state);
 #   ifdef USE_MUNMAP
@@ -1419,6 +2388,16 @@ STATIC void GC_add_to_heap(struct hblk *p, size_t bytes)
     GC_n_heap_sects++;
     phdr -> hb_sz = bytes;
     phdr -> hb_flags = 0;
+#   ifdef USE_NUMA
+      phdr -> hb_node = 0;
+      if (GC_numa_nodes > 0) {
+        /* Place the section on the node of the allocating thread.      */
+        int node = GC_numa_current_node();
+
+        GC_numa_bind((ptr_t)p, bytes, node);
+        phdr -> hb_node = (unsigned char)node;
+      }
+#   endif
     GC_freehblk(p);
     GC_heapsize += bytes;
 
@@ -1475,7 +2454,7 @@ STATIC void GC_add_to_heap(struct hblk *p, size_t bytes)
 void * GC_least_plausible_heap_addr = (void *)GC_WORD_MAX;
 void * GC_greatest_plausible_heap_addr = 0;
 
-STATIC word GC_max_heapsize = 0;
+GC_INNER word GC_max_heapsize = 0;
 
 GC_API void GC_CALL GC_set_max_heap_size(GC_word n)
 {
@@ -1495,6 +2474,13 @@ GC_INNER void GC_scratch_recycle_inner(void *ptr, size_t bytes)
 
   GC_ASSERT(bytes != 0);
   GC_ASSERT(GC_page_size != 0);
+# ifdef COMPRESSED_REFS
+    /* Do not add the memory outside the arena to the heap (as in       */
+    /* GC_expand_hp_inner).                                             */
+    if (GC_arena_size != 0
+        && ((word)ptr < GC_arena_start
+            || (word)ptr - GC_arena_start >= GC_arena_size)) return;
+# endif
   /* TODO: Assert correct memory flags if GWW_VDB */
   page_offset = (word)ptr & (GC_page_size - 1);
   if (page_offset != 0)
@@ -1514,13 +2500,20 @@ GC_INNER GC_bool GC_expand_hp_inner(word n)
 {
     size_t bytes;
     struct hblk * space;
-    word expansion_slop;        /* Number of bytes by which we expect   */
-                                /* the heap to expand soon.             */
 
     GC_ASSERT(I_HOLD_LOCK());
     GC_ASSERT(GC_page_size != 0);
     if (0 == n) n = 1;
     bytes = ROUNDUP_PAGESIZE((size_t)n * HBLKSIZE);
+#   ifdef USE_HUGE_PAGES
+      if (GC_huge_pages) {
+        size_t huge_bytes = (bytes + HUGE_PAGE_SIZE - 1)
+                            & ~(size_t)(HUGE_PAGE_SIZE - 1);
+
+        if (huge_bytes < bytes) return FALSE; /* overflow */
+        bytes = huge_bytes;
+      }
+#   endif
     GC_DBGLOG_PRINT_HEAP_IN_USE();
     if (GC_max_heapsize != 0
         && (GC_max_heapsize < (word)bytes
@@ -1528,16 +2521,48 @@ GC_INNER GC_bool GC_expand_hp_inner(word n)
         /* Exceeded self-imposed limit */
         return FALSE;
     }
-    space = GET_MEM(bytes);
+    space = NULL;
+#   ifdef USE_HEAP_ARENA
+      space = (struct hblk *)GC_arena_get_mem(bytes);
+      if (NULL == space && GC_arena_size != 0) {
+        GC_COND_LOG_PRINTF("Heap arena is exhausted\n");
+#       ifdef COMPRESSED_REFS
+          /* The heap objects outside the arena could not be referenced */
+          /* by the compressed references.                              */
+          return FALSE;
+#       endif
+      }
+#   endif
+    if (NULL == space) {
+#     ifdef USE_HUGE_PAGES
+        if (GC_huge_pages) {
+          space = (struct hblk *)GC_unix_get_huge_mem(bytes);
+        } else
+#     endif
+      /* else */ {
+        space = GET_MEM(bytes);
+      }
+    }
     if (EXPECT(NULL == space, FALSE)) {
         WARN("Failed to expand heap by %" WARN_PRIuPTR " KiB\n", bytes >> 10);
         return FALSE;
     }
-    GC_add_to_our_memory((ptr_t)space, bytes);
-    GC_last_heap_growth_gc_no = GC_gc_no;
     GC_INFOLOG_PRINTF("Grow heap to %lu KiB after %lu bytes allocated\n",
                       TO_KiB_UL(GC_heapsize + bytes),
                       (unsigned long)GC_bytes_allocd);
+    GC_PROBE2(heap_grow, bytes, GC_heapsize + bytes);
+    GC_add_heap_space(space, bytes);
+    return TRUE;
+}
+
+GC_INNER void GC_add_heap_space(struct hblk *space, size_t bytes)
+{
+    word expansion_slop;        /* Number of bytes by which we expect   */
+                                /* the heap to expand soon.             */
+
+    GC_ASSERT(I_HOLD_LOCK());
+    GC_add_to_our_memory((ptr_t)space, bytes);
+    GC_last_heap_growth_gc_no = GC_gc_no;
 
     /* Adjust heap limits generously for blacklisting to work better.   */
     /* GC_add_to_heap performs minimal adjustment needed for            */
@@ -1563,8 +2588,6 @@ GC_INNER GC_bool GC_expand_hp_inner(word n)
     GC_add_to_heap(space, bytes);
     if (GC_on_heap_resize)
         (*GC_on_heap_resize)(GC_heapsize);
-
-    return TRUE;
 }
 
 /* Really returns a bool, but it's externally visible, so that's clumsy. */
@@ -1633,6 +2656,19 @@ GC_INNER GC_bool GC_collect_or_expand(word needed_blocks,
     GC_ASSERT(I_HOLD_LOCK());
     GC_ASSERT(GC_is_initialized);
     DISABLE_CANCEL(cancel_state);
+    if (EXPECT(GC_deferred_heapsize != 0, FALSE)) {
+      /* Do the initial heap expansion postponed by GC_init.    */
+      word initial_sz = GC_deferred_heapsize;
+
+      GC_deferred_heapsize = 0;
+      blocks_to_get = divHBLKSZ(initial_sz);
+      if (blocks_to_get < needed_blocks) blocks_to_get = needed_blocks;
+      if (GC_expand_hp_inner(blocks_to_get)) {
+        GC_requested_heapsize += initial_sz;
+        RESTORE_CANCEL(cancel_state);
+        return TRUE;
+      }
+    }
     if (!GC_incremental && !GC_dont_gc &&
         ((GC_dont_expand && GC_bytes_allocd > 0)
          || (GC_fo_entries > last_fo_entries
@@ -1640,6 +2676,19 @@ GC_INNER GC_bool GC_collect_or_expand(word needed_blocks,
              && (GC_fo_entries - last_fo_entries)
                 * GC_allocd_bytes_per_finalizer > GC_bytes_allocd)
          || GC_should_collect())) {
+#     ifdef BACKGROUND_GC
+        if (GC_background_gc && !GC_dont_expand
+            && !GC_background_gc_lags()) {
+          /* Leave the collection to the background thread, and take   */
+          /* the minimal heap increment meanwhile.                      */
+          GC_notify_background_gc();
+          if (GC_expand_hp_inner(needed_blocks > min_hincr_blocks
+                                    ? needed_blocks : min_hincr_blocks)) {
+            RESTORE_CANCEL(cancel_state);
+            return TRUE;
+          }
+        }
+#     endif
       /* Try to do a full collection using 'default' stop_func (unless  */
       /* nothing has been allocated since the latest collection or heap */
       /* expansion is disabled).                                        */
@@ -1659,27 +2708,36 @@ GC_INNER GC_bool GC_collect_or_expand(word needed_blocks,
     blocks_to_get = (GC_heapsize - GC_heapsize_at_forced_unmap)
                         / (HBLKSIZE * GC_free_space_divisor)
                     + needed_blocks;
-    if (blocks_to_get > MAXHINCR) {
+    if (live_bytes_peak != 0) {
+      /* Grow at once to the size the recent live data needs rather     */
+      /* than by several small steps each preceded by a collection.     */
+      word target = GC_heap_size_target();
+
+      if (target > GC_heapsize && divHBLKSZ(target - GC_heapsize)
+                                    > blocks_to_get)
+        blocks_to_get = divHBLKSZ(target - GC_heapsize);
+    }
+    if (blocks_to_get > max_hincr_blocks) {
       word slop;
 
       /* Get the minimum required to make it likely that we can satisfy */
       /* the current request in the presence of black-listing.          */
-      /* This will probably be more than MAXHINCR.                      */
+      /* This will probably be more than max_hincr_blocks.              */
       if (ignore_off_page) {
         slop = 4;
       } else {
         slop = 2 * divHBLKSZ(BL_LIMIT);
         if (slop > needed_blocks) slop = needed_blocks;
       }
-      if (needed_blocks + slop > MAXHINCR) {
+      if (needed_blocks + slop > max_hincr_blocks) {
         blocks_to_get = needed_blocks + slop;
       } else {
-        blocks_to_get = MAXHINCR;
+        blocks_to_get = max_hincr_blocks;
       }
       if (blocks_to_get > divHBLKSZ(GC_WORD_MAX))
         blocks_to_get = divHBLKSZ(GC_WORD_MAX);
-    } else if (blocks_to_get < MINHINCR) {
-      blocks_to_get = MINHINCR;
+    } else if (blocks_to_get < min_hincr_blocks) {
+      blocks_to_get = min_hincr_blocks;
     }
 
     if (GC_max_heapsize > GC_heapsize) {
@@ -1688,9 +2746,23 @@ GC_INNER GC_bool GC_collect_or_expand(word needed_blocks,
         blocks_to_get = max_get_blocks > needed_blocks
                         ? max_get_blocks : needed_blocks;
     }
+    if (GC_over_soft_heap_limit(blocks_to_get * HBLKSIZE)) {
+      /* Expand the heap by smaller steps near the soft limit.  */
+      word mapped_bytes = GC_heapsize - GC_unmapped_bytes;
+      word soft_get_blocks = soft_heap_limit > mapped_bytes
+                        ? divHBLKSZ(soft_heap_limit - mapped_bytes) : 0;
+
+      if (soft_get_blocks < min_hincr_blocks)
+        soft_get_blocks = min_hincr_blocks;
+      if (blocks_to_get > soft_get_blocks)
+        blocks_to_get = soft_get_blocks > needed_blocks
+                        ? soft_get_blocks : needed_blocks;
+    }
 
 #   ifdef USE_MUNMAP
-      if (GC_unmap_threshold > 1) {
+      if (GC_unmap_threshold > 1
+          || (GC_unmap_threshold > 0
+              && GC_over_soft_heap_limit(blocks_to_get * HBLKSIZE))) {
         /* Return as much memory to the OS as possible before   */
         /* trying to get memory from it.                        */
         GC_unmap_old(0);
@@ -1738,6 +2810,10 @@ GC_INNER ptr_t GC_allocobj(size_t gran, int kind)
     GC_ASSERT(I_HOLD_LOCK());
     GC_ASSERT(GC_is_initialized);
     if (0 == gran) return NULL;
+#   ifdef SHARDED_FREE_LISTS
+      /* Reuse the objects explicitly deallocated recently first.       */
+      GC_flush_fl_shard(kind, gran);
+#   endif
 
     while (NULL == *flh) {
       ENTER_GC();
@@ -1745,7 +2821,7 @@ GC_INNER ptr_t GC_allocobj(size_t gran, int kind)
         if (GC_incremental && GC_time_limit != GC_TIME_UNLIMITED) {
           /* True incremental mode, not just generational.      */
           /* Do our share of marking work.                      */
-          GC_collect_a_little_inner(1);
+          GC_collect_a_little_or_notify(1);
         }
 #     endif
       /* Sweep blocks for objects of this size */
@@ -1764,9 +2840,21 @@ GC_INNER ptr_t GC_allocobj(size_t gran, int kind)
 #       endif
         if (NULL == *flh) {
           ENTER_GC();
-          if (GC_incremental && GC_time_limit == GC_TIME_UNLIMITED
-              && !tried_minor) {
+          if (GC_incremental && !tried_minor
+              && (GC_time_limit == GC_TIME_UNLIMITED
+#                 ifdef CONCURRENT_MARK
+                    || GC_concurrent_mark
+#                 endif
+                  )) {
             GC_collect_a_little_inner(1);
+#           ifdef CONCURRENT_MARK
+              /* The concurrent marker has not kept up with the     */
+              /* allocation, finish the cycle rather than expand    */
+              /* the heap.                                          */
+              while (GC_concurrent_mark && GC_collection_in_progress()
+                     && !GC_dont_gc)
+                GC_collect_a_little_inner(1);
+#           endif
             tried_minor = TRUE;
           } else {
             if (!GC_collect_or_expand(1, FALSE, retry)) {
@@ -16,12 +16,16 @@
 
 /*
  * We maintain several hash tables of hblks that have had false hits.
- * Each contains one bit per hash bucket;  If any page in the bucket
- * has had a false hit, we assume that all of them have.
- * See the definition of page_hash_table in gc_private.h.
+ * Each is a bloom filter: a block is added by setting two bits, one
+ * indexed by the low bits of the block number (as in page_hash_table
+ * defined in gc_priv.h), and one by a multiplicative hash of it.  A block
+ * is considered black listed only if both of its bits are set, thus
+ * a collision of the first indices alone does not reject a good block.
  * False hits from the stack(s) are much more dangerous than false hits
  * from elsewhere, since the former can pin a large object that spans the
  * block, even though it does not start on the dangerous block.
+ * The tables are grown (see GC_promote_black_lists) as the heap grows
+ * to keep the collisions rare.
  */
 
 /* Externally callable routines are:    */
@@ -46,6 +50,38 @@ STATIC word GC_total_stack_black_listed = 0;
 GC_INNER word GC_black_list_spacing = MINHINCR * HBLKSIZE;
                         /* Initial rough guess. */
 
+GC_INNER unsigned GC_log_bl_entries = LOG_PHT_ENTRIES;
+
+GC_INNER word GC_black_list_rejects = 0;
+
+#ifndef MAX_LOG_BL_ENTRIES
+# if CPP_WORDSZ == 32
+#   define MAX_LOG_BL_ENTRIES 24 /* 2 MB per table */
+# else
+#   define MAX_LOG_BL_ENTRIES 28 /* 32 MB per table */
+# endif
+#endif
+
+#ifndef BL_ENTRIES_PER_HBLK
+# define BL_ENTRIES_PER_HBLK 4  /* power of 2 */
+#endif
+
+#define BL_ENTRIES ((word)1 << GC_log_bl_entries)
+#define BL_BYTES ((size_t)(BL_ENTRIES >> 3))
+
+#if CPP_WORDSZ == 32
+# define BL_HASH_MULT 0x9e3779b9UL
+#else
+# define BL_HASH_MULT (((word)0x9e3779b9UL << 32) | 0x7f4a7c15UL)
+#endif
+#define BL_HASH1(addr) (((word)(addr) >> LOG_HBLKSIZE) & (BL_ENTRIES - 1))
+#define BL_HASH2(addr) ((((word)(addr) >> LOG_HBLKSIZE) * BL_HASH_MULT) \
+                        >> (CPP_WORDSZ - GC_log_bl_entries))
+
+#define get_bl_entry(bl, addr) \
+        (get_pht_entry_from_index(bl, BL_HASH1(addr)) \
+         && get_pht_entry_from_index(bl, BL_HASH2(addr)))
+
 STATIC void GC_clear_bl(word *);
 
 GC_INNER void GC_default_print_heap_obj_proc(ptr_t p)
@@ -87,9 +123,8 @@ GC_INNER void GC_bl_init_no_interiors(void)
 {
   GC_ASSERT(I_HOLD_LOCK());
   if (GC_incomplete_normal_bl == 0) {
-    GC_old_normal_bl = (word *)GC_scratch_alloc(sizeof(page_hash_table));
-    GC_incomplete_normal_bl = (word *)GC_scratch_alloc(
-                                                  sizeof(page_hash_table));
+    GC_old_normal_bl = (word *)GC_scratch_alloc(BL_BYTES);
+    GC_incomplete_normal_bl = (word *)GC_scratch_alloc(BL_BYTES);
     if (GC_old_normal_bl == 0 || GC_incomplete_normal_bl == 0) {
       GC_err_printf("Insufficient memory for black list\n");
       EXIT();
@@ -106,8 +141,8 @@ GC_INNER void GC_bl_init(void)
         GC_bl_init_no_interiors();
     }
     GC_ASSERT(NULL == GC_old_stack_bl && NULL == GC_incomplete_stack_bl);
-    GC_old_stack_bl = (word *)GC_scratch_alloc(sizeof(page_hash_table));
-    GC_incomplete_stack_bl = (word *)GC_scratch_alloc(sizeof(page_hash_table));
+    GC_old_stack_bl = (word *)GC_scratch_alloc(BL_BYTES);
+    GC_incomplete_stack_bl = (word *)GC_scratch_alloc(BL_BYTES);
     if (GC_old_stack_bl == 0 || GC_incomplete_stack_bl == 0) {
         GC_err_printf("Insufficient memory for black list\n");
         EXIT();
@@ -118,12 +153,82 @@ GC_INNER void GC_bl_init(void)
 
 STATIC void GC_clear_bl(word *doomed)
 {
-    BZERO(doomed, sizeof(page_hash_table));
+    BZERO(doomed, BL_BYTES);
 }
 
 STATIC void GC_copy_bl(word *old, word *dest)
 {
-    BCOPY(old, dest, sizeof(page_hash_table));
+    BCOPY(old, dest, BL_BYTES);
+}
+
+/* Replace the black list by a bigger one (of 1 << new_log entries).    */
+/* Each bit of the new table is set if any of the old bits mapped to it */
+/* by either hash function is set, thus no black listed block is lost.  */
+STATIC word *GC_grow_bl(word *bl, unsigned new_log)
+{
+    unsigned old_log = GC_log_bl_entries;
+    word old_mask = ((word)1 << old_log) - 1;
+    word n = (word)1 << new_log;
+    word *new_bl = (word *)GC_scratch_alloc((size_t)(n >> 3));
+    word j;
+
+    if (NULL == new_bl) return NULL;
+    BZERO(new_bl, (size_t)(n >> 3));
+    for (j = 0; j < n; j++) {
+      if (get_pht_entry_from_index(bl, j & old_mask)
+          || get_pht_entry_from_index(bl, j >> (new_log - old_log)))
+        set_pht_entry_from_index(new_bl, j);
+    }
+    return new_bl;
+}
+
+/* Grow the black lists so that there are at least BL_ENTRIES_PER_HBLK  */
+/* entries per heap block.                                              */
+STATIC void GC_grow_black_lists(void)
+{
+    unsigned new_log = GC_log_bl_entries;
+    word *bls[4];
+    word *new_bls[4];
+    size_t old_bytes = BL_BYTES;
+    int i, n_bls = 0;
+
+    while (new_log < MAX_LOG_BL_ENTRIES
+           && ((word)1 << new_log) / BL_ENTRIES_PER_HBLK
+                < divHBLKSZ(GC_heapsize))
+      new_log++;
+    if (new_log == GC_log_bl_entries) return;
+
+    if (!GC_all_interior_pointers) {
+      bls[n_bls++] = GC_old_normal_bl;
+      bls[n_bls++] = GC_incomplete_normal_bl;
+    }
+    bls[n_bls++] = GC_old_stack_bl;
+    bls[n_bls++] = GC_incomplete_stack_bl;
+    for (i = 0; i < n_bls; i++) {
+      new_bls[i] = GC_grow_bl(bls[i], new_log);
+      if (NULL == new_bls[i]) {
+        /* Keep the current tables, retry after the next collection.    */
+        WARN("Failed to grow black lists to %" WARN_PRIuPTR " entries\n",
+             (word)1 << new_log);
+        return;
+      }
+    }
+    GC_COND_LOG_PRINTF("Grow black lists to %lu entries\n",
+                       (unsigned long)((word)1 << new_log));
+    i = 0;
+    if (!GC_all_interior_pointers) {
+      GC_old_normal_bl = new_bls[i++];
+      GC_incomplete_normal_bl = new_bls[i++];
+    }
+    GC_old_stack_bl = new_bls[i++];
+    GC_incomplete_stack_bl = new_bls[i];
+    GC_log_bl_entries = new_log;
+#   ifndef GWW_VDB
+      for (i = 0; i < n_bls; i++)
+        GC_scratch_recycle_no_gww(bls[i], old_bytes);
+#   else
+      UNUSED_ARG(old_bytes);
+#   endif
 }
 
 static word total_stack_black_listed(void);
@@ -144,6 +249,9 @@ GC_INNER void GC_promote_black_lists(void)
     GC_clear_bl(very_old_stack_bl);
     GC_incomplete_normal_bl = very_old_normal_bl;
     GC_incomplete_stack_bl = very_old_stack_bl;
+    if (GC_log_bl_entries < MAX_LOG_BL_ENTRIES
+        && BL_ENTRIES / BL_ENTRIES_PER_HBLK < divHBLKSZ(GC_heapsize))
+      GC_grow_black_lists();
     GC_total_stack_black_listed = total_stack_black_listed();
     GC_VERBOSE_LOG_PRINTF(
                 "%lu bytes in heap blacklisted for interior pointers\n",
@@ -196,15 +304,16 @@ GC_INNER void GC_unpromote_black_lists(void)
     GC_ASSERT(I_HOLD_LOCK());
 # endif
   if (GC_modws_valid_offsets[p & (sizeof(word)-1)]) {
-    word index = PHT_HASH((word)p);
-
-    if (HDR(p) == 0 || get_pht_entry_from_index(GC_old_normal_bl, index)) {
+    if (HDR(p) == 0 || get_bl_entry(GC_old_normal_bl, p)) {
 #     ifdef PRINT_BLACK_LIST
-        if (!get_pht_entry_from_index(GC_incomplete_normal_bl, index)) {
+        if (!get_bl_entry(GC_incomplete_normal_bl, p)) {
           GC_print_blacklisted_ptr(p, source, "normal");
         }
 #     endif
-      backlist_set_pht_entry_from_index(GC_incomplete_normal_bl, index);
+      backlist_set_pht_entry_from_index(GC_incomplete_normal_bl,
+                                        BL_HASH1(p));
+      backlist_set_pht_entry_from_index(GC_incomplete_normal_bl,
+                                        BL_HASH2(p));
     } /* else this is probably just an interior pointer to an allocated */
       /* object, and isn't worth black listing.                         */
   }
@@ -217,18 +326,17 @@ GC_INNER void GC_unpromote_black_lists(void)
   GC_INNER void GC_add_to_black_list_stack(word p)
 #endif
 {
-  word index = PHT_HASH((word)p);
-
 # ifndef PARALLEL_MARK
     GC_ASSERT(I_HOLD_LOCK());
 # endif
-  if (HDR(p) == 0 || get_pht_entry_from_index(GC_old_stack_bl, index)) {
+  if (HDR(p) == 0 || get_bl_entry(GC_old_stack_bl, p)) {
 #   ifdef PRINT_BLACK_LIST
-      if (!get_pht_entry_from_index(GC_incomplete_stack_bl, index)) {
+      if (!get_bl_entry(GC_incomplete_stack_bl, p)) {
         GC_print_blacklisted_ptr(p, source, "stack");
       }
 #   endif
-    backlist_set_pht_entry_from_index(GC_incomplete_stack_bl, index);
+    backlist_set_pht_entry_from_index(GC_incomplete_stack_bl, BL_HASH1(p));
+    backlist_set_pht_entry_from_index(GC_incomplete_stack_bl, BL_HASH2(p));
   }
 }
 
@@ -244,13 +352,13 @@ GC_INNER void GC_unpromote_black_lists(void)
 GC_API struct GC_hblk_s *GC_CALL GC_is_black_listed(struct GC_hblk_s *h,
                                                     GC_word len)
 {
-    word index = PHT_HASH((word)h);
+    word index = BL_HASH1(h);
     word i;
     word nblocks;
 
     if (!GC_all_interior_pointers
-        && (get_pht_entry_from_index(GC_old_normal_bl, index)
-            || get_pht_entry_from_index(GC_incomplete_normal_bl, index))) {
+        && (get_bl_entry(GC_old_normal_bl, h)
+            || get_bl_entry(GC_incomplete_normal_bl, h))) {
       return h + 1;
     }
 
@@ -258,17 +366,17 @@ GC_API struct GC_hblk_s *GC_CALL GC_is_black_listed(struct GC_hblk_s *h,
     for (i = 0;;) {
         if (GC_old_stack_bl[divWORDSZ(index)] == 0
             && GC_incomplete_stack_bl[divWORDSZ(index)] == 0) {
-            /* An easy case */
+            /* An easy case (none of the first bits are set).   */
           i += WORDSZ - modWORDSZ(index);
         } else {
-          if (get_pht_entry_from_index(GC_old_stack_bl, index)
-              || get_pht_entry_from_index(GC_incomplete_stack_bl, index)) {
+          if (get_bl_entry(GC_old_stack_bl, h + i)
+              || get_bl_entry(GC_incomplete_stack_bl, h + i)) {
             return h + (i+1);
           }
           i++;
         }
         if (i >= nblocks) break;
-        index = PHT_HASH((word)(h + i));
+        index = BL_HASH1(h + i);
     }
     return NULL;
 }
@@ -283,9 +391,7 @@ STATIC word GC_number_stack_black_listed(struct hblk *start,
     word result = 0;
 
     for (h = start; (word)h < (word)endp1; h++) {
-        word index = PHT_HASH((word)h);
-
-        if (get_pht_entry_from_index(GC_old_stack_bl, index)) result++;
+        if (get_bl_entry(GC_old_stack_bl, h)) result++;
     }
     return result;
 }
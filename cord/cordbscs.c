@@ -79,6 +79,10 @@ typedef struct {
         /* The client_data field is known to point to a substr_args     */
         /* structure, and the function is either CORD_apply_access_fn   */
         /* or CORD_index_access_fn.                                     */
+        /* A plain function node with CORD_index_access_fn is a leaf of */
+        /* directly accessible characters (e.g., a memory-mapped file): */
+        /* its client_data points to a structure starting with the      */
+        /* substr_args fields, but sa_cord is not a cord.               */
 
 /* The following may be applied only to function and concatenation nodes: */
 #define IS_CONCATENATION(s)  (((CordRep *)s)->generic.header == CONCAT_HDR)
@@ -149,6 +153,80 @@ void CORD_dump(CORD x)
     fflush(stdout);
 }
 
+static int balanced_cat = 0;
+
+void CORD_set_balanced_cat(int value)
+{
+    balanced_cat = value;
+}
+
+#define GEN_DEPTH(s) (CORD_IS_STRING(s) ? 0 : DEPTH(s))
+
+/* Create a concatenation node of the given nonempty cords.     */
+static CORD concat_node(CORD x, CORD y)
+{
+    size_t lenx = GEN_LEN(x);
+    int depth = GEN_DEPTH(x) > GEN_DEPTH(y) ? GEN_DEPTH(x) : GEN_DEPTH(y);
+    CordRep *result = GC_NEW(CordRep);
+
+    if (NULL == result) OUT_OF_MEMORY;
+    result -> generic.header = CONCAT_HDR;
+    result -> generic.depth = (char)(depth + 1);
+    if (lenx <= MAX_LEFT_LEN)
+        result -> generic.left_len = (unsigned char)lenx;
+    result -> generic.len = (unsigned long)(lenx + GEN_LEN(y));
+    result -> data.concat.left = x;
+    GC_PTR_STORE_AND_DIRTY((void *)&(result -> data.concat.right), y);
+    GC_reachable_here(x);
+    return (CORD)result;
+}
+
+#define CONC_LEFT(s) (((CordRep *)(s)) -> data.concat.left)
+#define CONC_RIGHT(s) (((CordRep *)(s)) -> data.concat.right)
+
+/* The concatenation of the balanced mode, like the join of AVL trees.  */
+/* Only the nodes along the right spine of x (or the left spine of y)   */
+/* down to the depth of the other argument are reallocated, and the     */
+/* rotations keep the depth of the siblings different by at most one.   */
+static CORD balanced_join(CORD x, CORD y)
+{
+    int dx = GEN_DEPTH(x);
+    int dy = GEN_DEPTH(y);
+    CORD t;
+
+    if (dx > dy + 1 && IS_CONCATENATION(x)) {
+        CORD l = CONC_LEFT(x);
+
+        t = balanced_join(CONC_RIGHT(x), y);
+        if (GEN_DEPTH(t) <= GEN_DEPTH(l) + 1)
+            return concat_node(l, t);
+        /* t is deeper than l by 2, thus it is a concatenation. */
+        if (GEN_DEPTH(CONC_LEFT(t)) > GEN_DEPTH(CONC_RIGHT(t))) {
+            CORD tl = CONC_LEFT(t);
+
+            /* Double rotation. */
+            return concat_node(concat_node(l, CONC_LEFT(tl)),
+                               concat_node(CONC_RIGHT(tl), CONC_RIGHT(t)));
+        }
+        return concat_node(concat_node(l, CONC_LEFT(t)), CONC_RIGHT(t));
+    }
+    if (dy > dx + 1 && IS_CONCATENATION(y)) {
+        CORD r = CONC_RIGHT(y);
+
+        t = balanced_join(x, CONC_LEFT(y));
+        if (GEN_DEPTH(t) <= GEN_DEPTH(r) + 1)
+            return concat_node(t, r);
+        if (GEN_DEPTH(CONC_RIGHT(t)) > GEN_DEPTH(CONC_LEFT(t))) {
+            CORD tr = CONC_RIGHT(t);
+
+            return concat_node(concat_node(CONC_LEFT(t), CONC_LEFT(tr)),
+                               concat_node(CONC_RIGHT(tr), r));
+        }
+        return concat_node(CONC_LEFT(t), concat_node(CONC_RIGHT(t), r));
+    }
+    return concat_node(x, y);
+}
+
 CORD CORD_cat_char_star(CORD x, const char * y, size_t leny)
 {
     size_t result_len;
@@ -219,6 +297,7 @@ CORD CORD_cat_char_star(CORD x, const char * y, size_t leny)
             depth = DEPTH(x) + 1;
         }
         result_len = lenx + leny;
+        if (balanced_cat && depth > 2) return balanced_join(x, y);
     }
     {
       /* The general case; lenx, result_len is known: */
@@ -262,6 +341,12 @@ CORD CORD_cat(CORD x, CORD y)
         if (depthy >= depth) depth = depthy + 1;
     }
     result_len = lenx + LEN(y);
+    if (balanced_cat) {
+        int dx = GEN_DEPTH(x);
+        int dy = DEPTH(y);
+
+        if (dx > dy + 1 || dy > dx + 1) return balanced_join(x, y);
+    }
     {
         CordRep *result = GC_NEW(CordRep);
 
@@ -348,6 +433,30 @@ char CORD_apply_access_fn(size_t i, void * client_data)
     return fn_cord -> fn(i + descr -> sa_index, fn_cord -> client_data);
 }
 
+/* Return the address of the characters of the given function node if   */
+/* they could be accessed directly (i.e. the node is a substring of     */
+/* a flat string or a direct leaf, or a substring of such a leaf), NULL */
+/* otherwise.                                                           */
+static const char * direct_chars(struct Function * f)
+{
+    struct substr_args *descr = (struct substr_args *)(f -> client_data);
+
+    if (f -> fn == CORD_index_access_fn)
+        return (const char *)(descr -> sa_cord) + descr -> sa_index;
+    if (f -> fn == CORD_apply_access_fn) {
+        struct Function * inner = &(descr -> sa_cord -> data.function);
+
+        if (inner -> fn == CORD_index_access_fn) {
+            struct substr_args *inner_descr =
+                                (struct substr_args *)(inner -> client_data);
+
+            return (const char *)(inner_descr -> sa_cord)
+                        + inner_descr -> sa_index + descr -> sa_index;
+        }
+    }
+    return NULL;
+}
+
 /* A version of CORD_substr that simply returns a function node, thus   */
 /* postponing its work. The fourth argument is a function that may      */
 /* be used for efficient access to the ith character.                   */
@@ -498,9 +607,16 @@ int CORD_iter5(CORD x, size_t i, CORD_iter_fn f1,
         return CORD_iter5(conc -> right, 0, f1, f2, client_data);
     } else /* function */ {
         struct Function * f = &(((CordRep *)x) -> data.function);
+        const char * chars = direct_chars(f);
         size_t j;
         size_t lim = (size_t)LEN(x);
 
+        if (chars != NULL) {
+            for (j = i; j < lim; j++) {
+                if (f1(chars[j], client_data)) return 1;
+            }
+            return 0;
+        }
         for (j = i; j < lim; j++) {
             if (f1(f->fn(j, f->client_data), client_data)) {
                 return 1;
@@ -510,6 +626,80 @@ int CORD_iter5(CORD x, size_t i, CORD_iter_fn f1,
     }
 }
 
+# define CHUNK_BUF_SZ 256
+        /* Size of the buffer to materialize function nodes by.         */
+
+# define STABLE_CHUNK_SZ (64 * 1024)
+        /* Size of the strings allocated to materialize function nodes  */
+        /* by if no buffer is given.                                    */
+
+/* If buf is NULL, then the pieces of function nodes are materialized   */
+/* to newly allocated strings instead of buf.                           */
+static int iter_chunks(CORD x, size_t i, CORD_chunk_iter_fn f,
+                       void * client_data, char * buf)
+{
+    if (0 == x) return 0;
+    if (CORD_IS_STRING(x)) {
+        const char *p = x + i;
+
+        if (*p == '\0') ABORT("2nd arg to CORD_iter_chunks too big");
+        return f(p, strlen(p), client_data);
+    } else if (IS_CONCATENATION(x)) {
+        struct Concatenation * conc = &(((CordRep *)x) -> data.concat);
+        size_t left_len = LEFT_LEN(x);
+
+        if (i >= left_len) {
+            return iter_chunks(conc -> right, i - left_len, f, client_data,
+                               buf);
+        }
+        if (iter_chunks(conc -> left, i, f, client_data, buf)) return 1;
+        return iter_chunks(conc -> right, 0, f, client_data, buf);
+    } else /* function */ {
+        struct Function * fn = &(((CordRep *)x) -> data.function);
+        const char * chars = direct_chars(fn);
+        size_t j;
+        size_t lim = (size_t)LEN(x);
+
+        size_t chunk_sz = buf != NULL ? CHUNK_BUF_SZ : STABLE_CHUNK_SZ;
+
+        if (chars != NULL)
+            return f(chars + i, lim - i, client_data);
+        for (j = i; j < lim; ) {
+            size_t n = lim - j < chunk_sz ? lim - j : chunk_sz;
+            char * p = buf;
+            size_t k;
+
+            if (NULL == p) {
+                p = (char *)GC_MALLOC_ATOMIC(n);
+                if (NULL == p) OUT_OF_MEMORY;
+            }
+            for (k = 0; k < n; k++) {
+                p[k] = fn -> fn(j + k, fn -> client_data);
+            }
+            if (f(p, n, client_data)) return 1;
+            j += n;
+        }
+        return 0;
+    }
+}
+
+int CORD_iter_chunks(CORD x, size_t i, CORD_chunk_iter_fn f,
+                     void * client_data)
+{
+    char buf[CHUNK_BUF_SZ];
+
+    return iter_chunks(x, i, f, client_data, buf);
+}
+
+/* Same as CORD_iter_chunks but the spans remain valid after the call,  */
+/* as the function nodes (not accessible directly) are materialized to  */
+/* newly allocated strings.  Used by CORD_to_iovec.                     */
+int CORD__iter_stable_chunks(CORD x, size_t i, CORD_chunk_iter_fn f,
+                             void * client_data)
+{
+    return iter_chunks(x, i, f, client_data, NULL);
+}
+
 #undef CORD_iter
 int CORD_iter(CORD x, CORD_iter_fn f1, void * client_data)
 {
@@ -545,10 +735,12 @@ int CORD_riter4(CORD x, size_t i, CORD_iter_fn f1, void * client_data)
         }
     } else /* function */ {
         struct Function * f = &(((CordRep *)x) -> data.function);
+        const char * chars = direct_chars(f);
         size_t j;
 
         for (j = i; ; j--) {
-            if (f1(f -> fn(j, f -> client_data), client_data)) {
+            if (f1(chars != NULL ? chars[j] : f -> fn(j, f -> client_data),
+                   client_data)) {
                 return 1;
             }
             if (0 == j) break;
@@ -557,6 +749,56 @@ int CORD_riter4(CORD x, size_t i, CORD_iter_fn f1, void * client_data)
     return 0;
 }
 
+static int riter_chunks(CORD x, size_t i, CORD_chunk_iter_fn f,
+                        void * client_data, char * buf)
+{
+    if (0 == x) return 0;
+    if (CORD_IS_STRING(x)) {
+        if (x[i] == '\0') ABORT("2nd arg to CORD__riter_chunks too big");
+        return f(x, i + 1, client_data);
+    } else if (IS_CONCATENATION(x)) {
+        struct Concatenation * conc = &(((CordRep *)x) -> data.concat);
+        size_t left_len = LEFT_LEN(x);
+
+        if (i >= left_len) {
+            if (riter_chunks(conc -> right, i - left_len, f, client_data,
+                             buf))
+                return 1;
+            i = left_len - 1;
+        }
+        return riter_chunks(conc -> left, i, f, client_data, buf);
+    } else /* function */ {
+        struct Function * fn = &(((CordRep *)x) -> data.function);
+        const char * chars = direct_chars(fn);
+        size_t end;
+
+        if (chars != NULL)
+            return f(chars, i + 1, client_data);
+        for (end = i + 1; end > 0; ) {
+            size_t n = end < CHUNK_BUF_SZ ? end : CHUNK_BUF_SZ;
+            size_t k;
+
+            for (k = 0; k < n; k++) {
+                buf[k] = fn -> fn(end - n + k, fn -> client_data);
+            }
+            if (f(buf, n, client_data)) return 1;
+            end -= n;
+        }
+        return 0;
+    }
+}
+
+/* Call f for the spans of x ending at position i (inclusive) from      */
+/* right to left.  The span is passed as the address of its first       */
+/* character and the length; f scans it backwards.  Used by CORD_rchr.  */
+int CORD__riter_chunks(CORD x, size_t i, CORD_chunk_iter_fn f,
+                       void * client_data)
+{
+    char buf[CHUNK_BUF_SZ];
+
+    return riter_chunks(x, i, f, client_data, buf);
+}
+
 int CORD_riter(CORD x, CORD_iter_fn f1, void * client_data)
 {
     size_t len = CORD_len(x);
@@ -564,6 +806,88 @@ int CORD_riter(CORD x, CORD_iter_fn f1, void * client_data)
     return CORD_riter4(x, len - 1, f1, client_data);
 }
 
+struct CORD_index_s {
+    size_t len;             /* Length of the indexed cord.                  */
+    size_t n_leaves;
+    size_t * starts;        /* Positions of the leaves, in ascending order. */
+    const char ** chars;    /* Directly accessible characters of the leaves */
+                            /* (NULL for the other function nodes).         */
+    CORD * leaves;
+};
+
+static size_t count_leaves(CORD x)
+{
+    if (!CORD_IS_STRING(x) && IS_CONCATENATION(x)) {
+        struct Concatenation * conc = &(((CordRep *)x) -> data.concat);
+
+        return count_leaves(conc -> left) + count_leaves(conc -> right);
+    }
+    return 1;
+}
+
+static size_t fill_index(CORD_index ix, CORD x, size_t k, size_t pos)
+{
+    if (!CORD_IS_STRING(x) && IS_CONCATENATION(x)) {
+        struct Concatenation * conc = &(((CordRep *)x) -> data.concat);
+
+        k = fill_index(ix, conc -> left, k, pos);
+        return fill_index(ix, conc -> right, k, pos + LEFT_LEN(x));
+    }
+    ix -> starts[k] = pos;
+    ix -> leaves[k] = x;
+    ix -> chars[k] = CORD_IS_STRING(x) ? x
+                        : direct_chars(&(((CordRep *)x) -> data.function));
+    return k + 1;
+}
+
+CORD_index CORD_index_new(CORD x)
+{
+    CORD_index ix;
+    size_t n;
+
+    if (0 == x) return 0;
+    n = count_leaves(x);
+    ix = GC_NEW(struct CORD_index_s);
+    if (NULL == ix) OUT_OF_MEMORY;
+    ix -> len = CORD_len(x);
+    ix -> n_leaves = n;
+    ix -> starts = (size_t *)GC_MALLOC_ATOMIC(n * sizeof(size_t));
+    if (NULL == ix -> starts) OUT_OF_MEMORY;
+    ix -> chars = (const char **)GC_MALLOC(n * sizeof(const char *));
+    if (NULL == ix -> chars) OUT_OF_MEMORY;
+    ix -> leaves = (CORD *)GC_MALLOC(n * sizeof(CORD));
+    if (NULL == ix -> leaves) OUT_OF_MEMORY;
+    (void)fill_index(ix, x, 0, 0);
+    GC_end_stubborn_change(ix -> chars);
+    GC_end_stubborn_change(ix -> leaves);
+    GC_end_stubborn_change(ix);
+    GC_reachable_here(x);
+    return ix;
+}
+
+char CORD_index_fetch(CORD_index ix, size_t i)
+{
+    size_t lo = 0;
+    size_t hi;
+    struct Function * f;
+
+    if (NULL == ix || i >= ix -> len)
+        ABORT("CORD_index_fetch: index out of range");
+    for (hi = ix -> n_leaves; hi - lo > 1; ) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (ix -> starts[mid] <= i) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    i -= ix -> starts[lo];
+    if (ix -> chars[lo] != NULL) return ix -> chars[lo][i];
+    f = &(((CordRep *)(ix -> leaves[lo])) -> data.function);
+    return f -> fn(i, f -> client_data);
+}
+
 /*
  * The following functions are concerned with balancing cords.
  * Strategy:
@@ -759,7 +1083,16 @@ void CORD__extend_path(CORD_pos p)
          p[0].cur_start = top_pos;
          p[0].cur_end = top_pos + top_len;
        } else {
-         p[0].cur_end = 0;
+         const char * chars = direct_chars(&((CordRep *)top)
+                                                -> data.function);
+
+         if (chars != NULL) {
+           p[0].cur_leaf = chars;
+           p[0].cur_start = top_pos;
+           p[0].cur_end = top_pos + top_len;
+         } else {
+           p[0].cur_end = 0;
+         }
        }
        if (pos >= top_pos + top_len) p[0].path_len = CORD_POS_INVALID;
 }
@@ -806,6 +1139,15 @@ void CORD__next(CORD_pos p)
             size_t limit = FUNCTION_BUF_SZ;
             CORD_fn fn = f -> fn;
             void * client_data = f -> client_data;
+            const char * chars = direct_chars(f);
+
+            if (chars != NULL) {
+                /* No need to cache, the whole leaf is accessible.      */
+                p[0].cur_leaf = chars;
+                p[0].cur_start = start_pos;
+                p[0].cur_end = end_pos;
+                return;
+            }
 
             if (end_pos - cur_pos < FUNCTION_BUF_SZ) {
                 limit = end_pos - cur_pos;
@@ -30,7 +30,6 @@
 #endif
 
 #include "gc/cord.h"
-#include "gc/ec.h"
 
 #include <stdarg.h>
 #include <stdio.h>
@@ -58,9 +57,84 @@
                         abort(); \
                       MACRO_BLKSTMT_END
 
-static int ec_len(CORD_ec x)
+#define OUT_BUF_SZ 512  /* Size of the stack buffer for the output. */
+
+/* The output of CORD_vsprintf: the concatenation of cord (of cord_len  */
+/* characters) with buf[0 ... len-1].  Short outputs are formatted in   */
+/* buf entirely, and then copied to a single leaf.                      */
+typedef struct {
+    CORD cord;
+    size_t cord_len;
+    size_t len;
+    char buf[OUT_BUF_SZ + 1];
+} out_buf;
+
+#define OUT_LEN(o) ((o) -> cord_len + (o) -> len)
+
+#define OUT_ROOM(o) (OUT_BUF_SZ - (o) -> len)
+
+#define OUT_APPEND(o, c) \
+                ((void)((o) -> len == OUT_BUF_SZ ? (out_flush(o), 0) : 0), \
+                 (void)((o) -> buf[(o) -> len++] = (c)))
+
+/* Append the characters of buf to the cord part of the output.        */
+static void out_flush(out_buf * o)
+{
+    size_t len = o -> len;
+    char * s;
+
+    if (0 == len) return;
+    s = (char *)GC_MALLOC_ATOMIC(len + 1);
+    if (NULL == s) OUT_OF_MEMORY;
+    memcpy(s, o -> buf, len);
+    s[len] = '\0';
+    o -> cord = CORD_cat_char_star(o -> cord, s, len);
+    o -> cord_len += len;
+    o -> len = 0;
+}
+
+/* Append a cord of the given length.  Short strings are copied, other */
+/* cords are shared with the output.                                    */
+static void out_append_cord(out_buf * o, CORD x, size_t n)
 {
-    return (int)(CORD_len(x[0].ec_cord) + (x[0].ec_bufptr - x[0].ec_buf));
+    if (0 == n) return;
+    if (CORD_IS_STRING(x) && n <= OUT_ROOM(o)) {
+        memcpy(o -> buf + o -> len, x, n);
+        o -> len += n;
+    } else {
+        out_flush(o);
+        o -> cord = CORD_cat(o -> cord, x);
+        o -> cord_len += n;
+    }
+}
+
+static void out_append_span(out_buf * o, const char * s, size_t n)
+{
+    if (n > OUT_ROOM(o)) {
+        out_flush(o);
+        if (n > OUT_BUF_SZ) {
+            char * leaf = (char *)GC_MALLOC_ATOMIC(n + 1);
+
+            if (NULL == leaf) OUT_OF_MEMORY;
+            memcpy(leaf, s, n);
+            leaf[n] = '\0';
+            out_append_cord(o, leaf, n);
+            return;
+        }
+    }
+    memcpy(o -> buf + o -> len, s, n);
+    o -> len += n;
+}
+
+/* Append n copies of c.        */
+static void out_append_chars(out_buf * o, char c, size_t n)
+{
+    if (n <= OUT_ROOM(o)) {
+        memset(o -> buf + o -> len, c, n);
+        o -> len += n;
+    } else {
+        out_append_cord(o, CORD_chars(c, n), n);
+    }
 }
 
 /* Possible non-numeric precision values.   */
@@ -202,13 +276,15 @@ static int extract_conv_spec(CORD_pos source, char *buf,
 
 int CORD_vsprintf(CORD * out, CORD format, va_list args)
 {
-    CORD_ec result;
+    out_buf result;
     int count;
     char current;
     CORD_pos pos;
     char conv_spec[CONV_SPEC_LEN + 1];
 
-    CORD_ec_init(result);
+    result.cord = CORD_EMPTY;
+    result.cord_len = 0;
+    result.len = 0;
     for (CORD_set_pos(pos, format, 0); CORD_pos_valid(pos); CORD_next(pos)) {
         current = CORD_pos_fetch(pos);
         if (current == '%') {
@@ -216,7 +292,7 @@ int CORD_vsprintf(CORD * out, CORD format, va_list args)
             if (!CORD_pos_valid(pos)) return -1;
             current = CORD_pos_fetch(pos);
             if (current == '%') {
-                CORD_ec_append(result, current);
+                OUT_APPEND(&result, current);
             } else {
                 int width, prec;
                 int left_adj = 0;
@@ -236,18 +312,18 @@ int CORD_vsprintf(CORD * out, CORD format, va_list args)
                         if (long_arg == 0) {
                             int * pos_ptr;
                             pos_ptr = va_arg(args, int *);
-                            *pos_ptr = ec_len(result);
+                            *pos_ptr = (int)OUT_LEN(&result);
                         } else if (long_arg == 2) {
                             size_t * pos_ptr = va_arg(args, size_t *);
-                            *pos_ptr = (size_t)(unsigned)ec_len(result);
+                            *pos_ptr = OUT_LEN(&result);
                         } else if (long_arg > 0) {
                             long * pos_ptr;
                             pos_ptr = va_arg(args, long *);
-                            *pos_ptr = ec_len(result);
+                            *pos_ptr = (long)OUT_LEN(&result);
                         } else {
                             short * pos_ptr;
                             pos_ptr = va_arg(args, short *);
-                            *pos_ptr = (short)ec_len(result);
+                            *pos_ptr = (short)OUT_LEN(&result);
                         }
                         goto done;
                     case 'r':
@@ -262,37 +338,33 @@ int CORD_vsprintf(CORD * out, CORD format, va_list args)
                           len = (unsigned)prec;
                         }
                         if (width != NONE && len < (unsigned)width) {
-                          char * blanks = (char *)GC_MALLOC_ATOMIC(
-                                                (unsigned)width - len + 1);
+                          size_t n_blanks = (unsigned)width - len;
 
-                          if (NULL == blanks) OUT_OF_MEMORY;
-                          memset(blanks, ' ', (unsigned)width - len);
-                          blanks[(unsigned)width - len] = '\0';
                           if (left_adj) {
-                            arg = CORD_cat(arg, blanks);
+                            out_append_cord(&result, arg, len);
+                            out_append_chars(&result, ' ', n_blanks);
                           } else {
-                            arg = CORD_cat(blanks, arg);
+                            out_append_chars(&result, ' ', n_blanks);
+                            out_append_cord(&result, arg, len);
                           }
+                        } else {
+                          out_append_cord(&result, arg, len);
                         }
-                        CORD_ec_append_cord(result, arg);
                         goto done;
                     case 'c':
                         if (width == NONE && prec == NONE) {
                             char c;
 
                             c = (char)va_arg(args, int);
-                            CORD_ec_append(result, c);
+                            OUT_APPEND(&result, c);
                             goto done;
                         }
                         break;
                     case 's':
                         if (width == NONE && prec == NONE) {
                             char * str = va_arg(args, char *);
-                            char c;
 
-                            while ((c = *str++) != '\0') {
-                                CORD_ec_append(result, c);
-                            }
+                            out_append_span(&result, str, strlen(str));
                             goto done;
                         }
                         break;
@@ -321,15 +393,14 @@ int CORD_vsprintf(CORD * out, CORD format, va_list args)
                     if (width != NONE) max_size = width;
                     if (prec != NONE && prec > max_size) max_size = prec;
                     max_size += CONV_RESULT_LEN;
-                    if (max_size >= CORD_BUFSZ) {
+                    if (max_size > OUT_BUF_SZ) {
                         buf = (char *)GC_MALLOC_ATOMIC((unsigned)max_size + 1);
                         if (NULL == buf) OUT_OF_MEMORY;
                     } else {
-                        if (CORD_BUFSZ - (result[0].ec_bufptr-result[0].ec_buf)
-                            < max_size) {
-                            CORD_ec_flush_buf(result);
+                        if (OUT_ROOM(&result) < (unsigned)max_size) {
+                            out_flush(&result);
                         }
-                        buf = result[0].ec_bufptr;
+                        buf = result.buf + result.len;
                     }
                     switch(current) {
                         case 'd':
@@ -375,25 +446,24 @@ int CORD_vsprintf(CORD * out, CORD format, va_list args)
                         len = strlen(buf);
                     } else if (res < 0) {
                         return -1;
+                    } else if (len > (unsigned)max_size) {
+                        len = (unsigned)max_size; /* truncated */
                     }
-                    if (buf != result[0].ec_bufptr) {
-                        char c;
-
-                        while ((c = *buf++) != '\0') {
-                            CORD_ec_append(result, c);
-                        }
+                    if (buf != result.buf + result.len) {
+                        out_append_span(&result, buf, len);
                     } else {
-                        result[0].ec_bufptr = buf + len;
+                        result.len += len;
                     }
                 }
               done:;
             }
         } else {
-            CORD_ec_append(result, current);
+            OUT_APPEND(&result, current);
         }
     }
-    count = ec_len(result);
-    *out = CORD_balance(CORD_ec_to_cord(result));
+    count = (int)OUT_LEN(&result);
+    out_flush(&result);
+    *out = CORD_balance(result.cord);
     return count;
 }
 
@@ -46,6 +46,18 @@
 # define ATOMIC_WRITE(x,y) (x) = (y)
 # define ATOMIC_READ(x) (*(x))
 
+#if !defined(CORD_NO_MMAP) && !defined(CORD_USE_MMAP) \
+    && (defined(__unix__) || defined(__APPLE__) || defined(__CYGWIN__))
+# define CORD_USE_MMAP
+#endif
+#ifdef CORD_USE_MMAP
+# include <sys/mman.h>
+#endif
+#ifdef CORD_IOVEC
+# include <errno.h>
+# include <sys/uio.h>
+#endif
+
 /* The standard says these are in stdio.h, but they aren't always: */
 # ifndef SEEK_SET
 #   define SEEK_SET 0
@@ -261,61 +273,101 @@ char CORD_fetch(CORD x, size_t i)
 }
 
 
-int CORD_put_proc(char c, void * client_data)
-{
-    FILE * f = (FILE *)client_data;
-
-    return putc(c, f) == EOF;
-}
-
-int CORD_batched_put_proc(const char * s, void * client_data)
+static int CORD_chunk_put_proc(const char * s, size_t len,
+                               void * client_data)
 {
     FILE * f = (FILE *)client_data;
 
-    return fputs(s, f) == EOF;
+    return fwrite(s, 1, len, f) != len;
 }
 
-
 int CORD_put(CORD x, FILE * f)
 {
-    if (CORD_iter5(x, 0, CORD_put_proc, CORD_batched_put_proc, f))
+    if (CORD_iter_chunks(x, 0, CORD_chunk_put_proc, f))
         return EOF;
     return 1;
 }
 
-typedef struct {
-    size_t pos;     /* Current position in the cord */
-    char target;    /* Character we're looking for  */
-} chr_data;
+#ifdef CORD_IOVEC
+  int CORD__iter_stable_chunks(CORD x, size_t i, CORD_chunk_iter_fn f,
+                               void * client_data); /* in cordbscs.c */
 
-int CORD_chr_proc(char c, void * client_data)
-{
-    chr_data * d = (chr_data *)client_data;
+  typedef struct {
+      struct iovec * iov;
+      size_t n;     /* Capacity of iov                  */
+      size_t used;  /* Number of filled entries of iov  */
+      size_t pos;   /* Position after the last span     */
+  } iovec_data;
 
-    if (c == d -> target) return 1;
-    (d -> pos)++;
-    return 0;
-}
+  static int CORD_iovec_proc(const char * s, size_t len,
+                             void * client_data)
+  {
+      iovec_data * d = (iovec_data *)client_data;
+
+      if (d -> used == d -> n) return 1;
+      d -> iov[d -> used].iov_base = (void *)s;
+      d -> iov[d -> used].iov_len = len;
+      d -> used++;
+      d -> pos += len;
+      return 0;
+  }
 
-int CORD_rchr_proc(char c, void * client_data)
-{
-    chr_data * d = (chr_data *)client_data;
+  size_t CORD_to_iovec(CORD x, size_t i, struct iovec * iov, size_t n,
+                       size_t * pnext)
+  {
+      iovec_data d;
+
+      d.iov = iov;
+      d.n = n;
+      d.used = 0;
+      d.pos = i;
+      if (n > 0 && i < CORD_len(x))
+          (void)CORD__iter_stable_chunks(x, i, CORD_iovec_proc, &d);
+      *pnext = d.pos;
+      return d.used;
+  }
 
-    if (c == d -> target) return 1;
-    (d -> pos)--;
-    return 0;
-}
+# define WRITEV_IOV_SZ 64
+
+  int CORD_writev(int fd, CORD x)
+  {
+      size_t len = CORD_len(x);
+      size_t pos = 0;
+
+      while (pos < len) {
+          struct iovec iov[WRITEV_IOV_SZ];
+          size_t next;
+          size_t cnt = CORD_to_iovec(x, pos, iov, WRITEV_IOV_SZ, &next);
+          ssize_t res = writev(fd, iov, (int)cnt);
+
+          if (res < 0) {
+              if (EINTR == errno) continue;
+              return EOF;
+          }
+          /* The spans are recomputed after a partial write.    */
+          pos += (size_t)res;
+      }
+      return 1;
+  }
+#endif /* CORD_IOVEC */
+
+typedef struct {
+    size_t pos;     /* Current position in the cord */
+    char target;    /* Character we're looking for  */
+} chr_data;
 
-int CORD_batched_chr_proc(const char *s, void * client_data)
+static int CORD_chunk_chr_proc(const char * s, size_t len,
+                               void * client_data)
 {
     chr_data * d = (chr_data *)client_data;
-    const char * occ = strchr(s, d -> target);
+    const char * occ = (const char *)memchr(s, (unsigned char)(d -> target),
+                                            len);
 
     if (NULL == occ) {
-        d -> pos += strlen(s);
+        d -> pos += len;
         return 0;
     }
-    d -> pos += occ - s;
+    d -> pos += (size_t)(occ - s);
     return 1;
 }
 
@@ -325,80 +377,160 @@ size_t CORD_chr(CORD x, size_t i, int c)
 
     d.pos = i;
     d.target = (char)c;
-    if (CORD_iter5(x, i, CORD_chr_proc, CORD_batched_chr_proc, &d)) {
+    if (CORD_iter_chunks(x, i, CORD_chunk_chr_proc, &d)) {
         return d.pos;
     } else {
         return CORD_NOT_FOUND;
     }
 }
 
+int CORD__riter_chunks(CORD x, size_t i, CORD_chunk_iter_fn f,
+                       void * client_data); /* in cordbscs.c */
+
+static int CORD_chunk_rchr_proc(const char * s, size_t len,
+                                void * client_data)
+{
+    chr_data * d = (chr_data *)client_data;
+    const char * p = s + len;
+
+    while (p != s) {
+        if (*--p == d -> target) {
+            d -> pos -= (size_t)(s + len - 1 - p);
+            return 1;
+        }
+    }
+    d -> pos -= len;
+    return 0;
+}
+
 size_t CORD_rchr(CORD x, size_t i, int c)
 {
     chr_data d;
 
     d.pos = i;
     d.target = (char)c;
-    if (CORD_riter4(x, i, CORD_rchr_proc, &d)) {
+    if (CORD__riter_chunks(x, i, CORD_chunk_rchr_proc, &d)) {
         return d.pos;
     } else {
         return CORD_NOT_FOUND;
     }
 }
 
+/* Return the first occurrence of pat in [s, s+len), or NULL.  The      */
+/* candidates are located by memchr (which is typically vectorized).    */
+static const char * mem_find(const char * s, size_t len,
+                             const char * pat, size_t plen)
+{
+    const char * lim;
+
+    if (len < plen) return NULL;
+    for (lim = s + (len - plen); s <= lim; s++) {
+        s = (const char *)memchr(s, (unsigned char)pat[0],
+                                 (size_t)(lim - s) + 1);
+        if (NULL == s) break;
+        if (memcmp(s + 1, pat + 1, plen - 1) == 0) return s;
+    }
+    return NULL;
+}
+
+#define STR_TAIL_SZ 64
+
+typedef struct {
+    CORD x;
+    CORD s;             /* The pattern (as passed to CORD_str).         */
+    const char * pat;   /* The characters of the pattern.               */
+    size_t plen;
+    size_t pos;         /* Position of the current span in x.           */
+    size_t checked;     /* Candidate matches before it are rejected.    */
+    char * tail;        /* Last characters (at most plen-1) before pos. */
+    size_t tail_len;
+    size_t result;
+} str_data;
+
+static int CORD_chunk_str_proc(const char * s, size_t len,
+                               void * client_data)
+{
+    str_data * d = (str_data *)client_data;
+    size_t plen = d -> plen;
+    size_t tail_len = d -> tail_len;
+    const char * occ;
+
+    /* The matches crossing the span start; these precede the others.   */
+    if (tail_len > 0 && d -> checked < d -> pos) {
+        const char * lim = d -> tail + tail_len;
+
+        occ = d -> tail;
+        if (d -> pos - tail_len < d -> checked)
+            occ += d -> checked - (d -> pos - tail_len);
+        for (; occ < lim; occ++) {
+            size_t n;
+
+            occ = (const char *)memchr(occ, (unsigned char)(d -> pat[0]),
+                                       (size_t)(lim - occ));
+            if (NULL == occ) break;
+            n = (size_t)(lim - occ);
+            if (memcmp(occ, d -> pat, n) == 0
+                && CORD_ncmp(d -> x, d -> pos, d -> s, n, plen - n) == 0) {
+                d -> result = d -> pos - n;
+                return 1;
+            }
+        }
+    }
+
+    /* The matches entirely inside the span.    */
+    occ = mem_find(s, len, d -> pat, plen);
+    if (occ != NULL) {
+        d -> result = d -> pos + (size_t)(occ - s);
+        return 1;
+    }
+    d -> checked = len >= plen ? d -> pos + len - plen + 1 : d -> pos;
+
+    /* Remember the characters of the possible partial match.   */
+    if (len >= plen - 1) {
+        tail_len = plen - 1;
+        memcpy(d -> tail, s + len - tail_len, tail_len);
+    } else {
+        size_t keep = tail_len < plen - 1 - len ? tail_len : plen - 1 - len;
+
+        memmove(d -> tail, d -> tail + tail_len - keep, keep);
+        memcpy(d -> tail + keep, s, len);
+        tail_len = keep + len;
+    }
+    d -> tail_len = tail_len;
+    d -> pos += len;
+    return 0;
+}
+
 /* Find the first occurrence of s in x at position start or later.      */
-/* This uses an asymptotically poor algorithm, which should typically   */
-/* perform acceptably.  We compare the first few characters directly,   */
-/* and call CORD_ncmp whenever there is a partial match.                */
-/* This has the advantage that we allocate very little, or not at all.  */
-/* It's very fast if there are few close misses.                        */
+/* The contiguous spans of x are searched directly (using memchr to     */
+/* locate the candidates); the last plen-1 characters of each span are  */
+/* kept, so that the matches crossing the span boundaries are checked   */
+/* (by CORD_ncmp) before the ones of the next span.                     */
 size_t CORD_str(CORD x, size_t start, CORD s)
 {
-    CORD_pos xpos;
     size_t xlen = CORD_len(x);
     size_t slen;
-    size_t start_len;
-    const char * s_start;
-    unsigned long s_buf = 0;    /* The first few characters of s        */
-    unsigned long x_buf = 0;    /* Start of candidate substring.        */
-                    /* Initialized only to make compilers   */
-                    /* happy.                               */
-    unsigned long mask = 0;
-    size_t i;
-    size_t match_pos;
+    char tail_buf[STR_TAIL_SZ];
+    str_data d;
 
     if (s == CORD_EMPTY) return start;
-    if (CORD_IS_STRING(s)) {
-        s_start = s;
-        slen = strlen(s);
-    } else {
-        s_start = CORD_to_char_star(CORD_substr(s, 0, sizeof(unsigned long)));
-        slen = CORD_len(s);
-    }
+    slen = CORD_len(s);
     if (xlen < start || xlen - start < slen) return CORD_NOT_FOUND;
-    start_len = slen;
-    if (start_len > sizeof(unsigned long)) start_len = sizeof(unsigned long);
-    CORD_set_pos(xpos, x, start);
-    for (i = 0; i < start_len; i++) {
-        mask <<= 8;
-        mask |= 0xff;
-        s_buf <<= 8;
-        s_buf |= (unsigned char)s_start[i];
-        x_buf <<= 8;
-        x_buf |= (unsigned char)CORD_pos_fetch(xpos);
-        CORD_next(xpos);
-    }
-    for (match_pos = start; ; match_pos++) {
-        if ((x_buf & mask) == s_buf
-            && (slen == start_len
-                || CORD_ncmp(x, match_pos + start_len,
-                             s, start_len, slen - start_len) == 0))
-          break;
-        if (match_pos == xlen - slen) return CORD_NOT_FOUND;
-        x_buf <<= 8;
-        x_buf |= (unsigned char)CORD_pos_fetch(xpos);
-        CORD_next(xpos);
+    d.x = x;
+    d.s = s;
+    d.pat = CORD_to_const_char_star(s);
+    d.plen = slen;
+    d.pos = start;
+    d.checked = start;
+    d.tail = tail_buf;
+    if (slen > STR_TAIL_SZ) {
+        d.tail = (char *)GC_MALLOC_ATOMIC(slen - 1);
+        if (NULL == d.tail) OUT_OF_MEMORY;
     }
-    return match_pos;
+    d.tail_len = 0;
+    if (CORD_iter_chunks(x, start, CORD_chunk_str_proc, &d))
+        return d.result;
+    return CORD_NOT_FOUND;
 }
 
 void CORD_ec_flush_buf(CORD_ec x)
@@ -421,6 +553,123 @@ void CORD_ec_append_cord(CORD_ec x, CORD s)
     x[0].ec_cord = CORD_cat(x[0].ec_cord, s);
 }
 
+void CORD_builder_init(CORD_builder b)
+{
+    b[0].cb_buf = NULL;
+    b[0].cb_bufptr = NULL;
+    b[0].cb_buflim = NULL;
+    b[0].cb_bufsz = CORD_BUFSZ;
+    b[0].cb_n = 0;
+}
+
+/* Add a nonempty leaf to the builder.  The cords of the same level are */
+/* concatenated, so that the levels decrease strictly along the stack.  */
+static void CORD_builder_push(CORD_builder b, CORD x)
+{
+    size_t n = b[0].cb_n;
+
+    b[0].cb_stack[n] = x;
+    b[0].cb_levels[n] = 0;
+    for (n++; n >= 2 && b[0].cb_levels[n-1] == b[0].cb_levels[n-2]; n--) {
+        b[0].cb_stack[n-2] = CORD_cat(b[0].cb_stack[n-2], b[0].cb_stack[n-1]);
+        b[0].cb_levels[n-2]++;
+    }
+    b[0].cb_n = n;
+}
+
+/* Turn the contents of the current buffer into a leaf.  A buffer that  */
+/* is at least half full is used as is, otherwise its contents are      */
+/* copied and the buffer is kept.                                       */
+static void CORD_builder_flush_buf(CORD_builder b)
+{
+    size_t len = (size_t)(b[0].cb_bufptr - b[0].cb_buf);
+    char * s;
+
+    if (0 == len) return;
+    if (len * 2 < (size_t)(b[0].cb_buflim - b[0].cb_buf)) {
+        s = (char *)GC_MALLOC_ATOMIC(len + 1);
+        if (NULL == s) OUT_OF_MEMORY;
+        memcpy(s, b[0].cb_buf, len);
+        b[0].cb_bufptr = b[0].cb_buf;
+    } else {
+        s = b[0].cb_buf;
+        b[0].cb_buf = NULL;
+        b[0].cb_bufptr = NULL;
+        b[0].cb_buflim = NULL;
+    }
+    s[len] = '\0';
+    CORD_builder_push(b, s);
+}
+
+void CORD_builder_grow(CORD_builder b)
+{
+    size_t sz = b[0].cb_bufsz;
+    char * buf;
+
+    CORD_builder_flush_buf(b);
+    if (b[0].cb_buf != NULL) return;
+    buf = (char *)GC_MALLOC_ATOMIC(sz + 1);
+    if (NULL == buf) OUT_OF_MEMORY;
+    b[0].cb_buf = buf;
+    b[0].cb_bufptr = buf;
+    b[0].cb_buflim = buf + sz;
+    if (sz < CORD_BUILDER_MAX_BUFSZ) b[0].cb_bufsz = sz * 2;
+}
+
+void CORD_builder_append_span(CORD_builder b, const char * s, size_t len)
+{
+    while (len > 0) {
+        size_t n = (size_t)(b[0].cb_buflim - b[0].cb_bufptr);
+
+        if (len > n && len >= b[0].cb_bufsz) {
+            /* Too long to buffer, make it a separate leaf.     */
+            char * leaf = (char *)GC_MALLOC_ATOMIC(len + 1);
+
+            if (NULL == leaf) OUT_OF_MEMORY;
+            memcpy(leaf, s, len);
+            leaf[len] = '\0';
+            CORD_builder_flush_buf(b);
+            CORD_builder_push(b, leaf);
+            return;
+        }
+        if (0 == n) {
+            CORD_builder_grow(b);
+            continue;
+        }
+        if (n > len) n = len;
+        memcpy(b[0].cb_bufptr, s, n);
+        b[0].cb_bufptr += n;
+        s += n;
+        len -= n;
+    }
+}
+
+void CORD_builder_append_cord(CORD_builder b, CORD x)
+{
+    if (CORD_EMPTY == x) return;
+    CORD_builder_flush_buf(b);
+    CORD_builder_push(b, x);
+}
+
+CORD CORD_builder_finish(CORD_builder b)
+{
+    CORD result;
+    size_t n;
+
+    CORD_builder_flush_buf(b);
+    n = b[0].cb_n;
+    if (0 == n) {
+        result = CORD_EMPTY;
+    } else {
+        /* The shorter cords are at the top, concatenate them first.    */
+        for (result = b[0].cb_stack[--n]; n > 0; ) {
+            result = CORD_cat(b[0].cb_stack[--n], result);
+        }
+    }
+    CORD_builder_init(b);
+    return result;
+}
+
 char CORD_nul_func(size_t i, void * client_data)
 {
     (void)i;
@@ -432,29 +681,55 @@ CORD CORD_chars(char c, size_t i)
     return CORD_from_fn(CORD_nul_func, (void *)(GC_word)(unsigned char)c, i);
 }
 
-CORD CORD_from_file_eager(FILE * f)
+/* Append n characters of block (allocated by GC_MALLOC_ATOMIC with     */
+/* room for the terminating NUL) to b.  Runs of NUL characters become   */
+/* CORD_nul nodes.  The block itself is used as a leaf if it has no NUL */
+/* and is at least half full.                                           */
+static void CORD_append_block(CORD_builder b, char * block, size_t n,
+                              size_t block_sz)
 {
-    CORD_ec ecord;
+    const char * p = block;
+    const char * lim = block + n;
 
-    CORD_ec_init(ecord);
-    for(;;) {
-        int c = getc(f);
+    if (n * 2 >= block_sz && NULL == memchr(block, '\0', n)) {
+        block[n] = '\0';
+        CORD_builder_append_cord(b, block);
+        return;
+    }
+    while (p < lim) {
+        const char * q = (const char *)memchr(p, '\0', (size_t)(lim - p));
+
+        if (NULL == q) q = lim;
+        CORD_builder_append_span(b, p, (size_t)(q - p));
+        for (p = q; p < lim && '\0' == *p; p++) {}
+        /* Note that any string of NULs is represented in 4 words,     */
+        /* independent of its length.                                   */
+        if (p != q) CORD_builder_append_cord(b, CORD_nul((size_t)(p - q)));
+    }
+}
 
-        if (c == 0) {
-          /* Append the right number of NULs                            */
-          /* Note that any string of NULs is represented in 4 words,    */
-          /* independent of its length.                                 */
-            size_t count = 1;
+# define EAGER_MIN_BLOCK_SZ 4096
 
-            CORD_ec_flush_buf(ecord);
-            while ((c = getc(f)) == 0) count++;
-            ecord[0].ec_cord = CORD_cat(ecord[0].ec_cord, CORD_nul(count));
-        }
-        if (c == EOF) break;
-        CORD_ec_append(ecord, (char)c);
+CORD CORD_from_file_eager(FILE * f)
+{
+    CORD_builder b;
+    size_t block_sz = EAGER_MIN_BLOCK_SZ;
+
+    CORD_builder_init(b);
+    for (;;) {
+        /* Read directly to the blocks of growing size that may become  */
+        /* the leaves of the result.                                    */
+        char * block = (char *)GC_MALLOC_ATOMIC(block_sz + 1);
+        size_t n;
+
+        if (NULL == block) OUT_OF_MEMORY;
+        n = fread(block, 1, block_sz, f);
+        if (n > 0) CORD_append_block(b, block, n, block_sz);
+        if (n < block_sz) break;
+        if (block_sz < CORD_BUILDER_MAX_BUFSZ) block_sz *= 2;
     }
     (void) fclose(f);
-    return CORD_balance(CORD_ec_to_cord(ecord));
+    return CORD_builder_finish(b);
 }
 
 /* The state maintained for a lazily read file consists primarily       */
@@ -597,6 +872,65 @@ CORD CORD_from_file_lazy(FILE * f)
     return CORD_from_file_lazy_inner(f, (size_t)len);
 }
 
+#ifdef CORD_USE_MMAP
+  /* The first two fields match those of substr_args (in cordbscs.c),  */
+  /* thus the node is recognized as a leaf of directly accessible      */
+  /* characters by the iteration and position routines.                */
+  typedef struct {
+      const char * mf_base;
+      size_t mf_index; /* always 0 */
+      size_t mf_len;
+      FILE * mf_file;
+  } mf_state;
+
+  char CORD_index_access_fn(size_t i, void * client_data);
+                                        /* defined in cordbscs.c */
+
+# ifndef GC_NO_FINALIZATION
+    static void CORD_mf_close_proc(void * obj, void * client_data)
+    {
+      mf_state * state = (mf_state *)obj;
+
+      (void)client_data;
+      if (munmap((void *)(state -> mf_base), state -> mf_len) != 0
+          || fclose(state -> mf_file) != 0)
+        ABORT("CORD_mf_close_proc: munmap or fclose failed");
+    }
+# endif
+#endif /* CORD_USE_MMAP */
+
+CORD CORD_from_file_mmap(FILE * f)
+{
+    long len;
+
+    if (fseek(f, 0l, SEEK_END) != 0
+        || (len = ftell(f)) < 0
+        || fseek(f, 0l, SEEK_SET) != 0) {
+        ABORT("Bad f argument or I/O failure");
+    }
+#   ifdef CORD_USE_MMAP
+      if (len > 0) {
+        mf_state * state = GC_NEW(mf_state);
+        void * base;
+
+        if (NULL == state) OUT_OF_MEMORY;
+        base = mmap(NULL, (size_t)len, PROT_READ, MAP_SHARED, fileno(f), 0);
+        if (base != MAP_FAILED) {
+          state -> mf_base = (const char *)base;
+          state -> mf_index = 0;
+          state -> mf_len = (size_t)len;
+          state -> mf_file = f;
+#         ifndef GC_NO_FINALIZATION
+            GC_REGISTER_FINALIZER(state, CORD_mf_close_proc, 0, 0, 0);
+#         endif
+          return CORD_from_fn(CORD_index_access_fn, state, (size_t)len);
+        }
+        /* Fall back to the stdio-based reading.        */
+      }
+#   endif
+    return CORD_from_file_lazy_inner(f, (size_t)len);
+}
+
 # define LAZY_THRESHOLD (128*1024 + 1)
 
 CORD CORD_from_file(FILE * f)
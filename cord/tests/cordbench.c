@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2022 Ivan Maidanski
+ *
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose, provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/* A microbenchmark of the cord package.  Each test reports the time    */
+/* per operation and the number of bytes allocated by the collector     */
+/* during the test.  The number of operations per test may be scaled by */
+/* the first argument (a positive integer, 1 by default).               */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <time.h>
+
+#include "gc.h"
+#include "gc/cord.h"
+
+# define ABORT(string) \
+    { fprintf(stderr, "FAILED: %s\n", string); abort(); }
+
+#define FNAME "cordbnch.tmp" /* short name (8+3) for portability */
+
+static clock_t start_clock;
+static GC_word start_bytes;
+
+static void bench_start(void)
+{
+    start_bytes = GC_get_total_bytes();
+    start_clock = clock();
+}
+
+static void bench_end(const char *what, unsigned long n_ops)
+{
+    double ns = (double)(clock() - start_clock) * 1e9 / CLOCKS_PER_SEC;
+    GC_word bytes = GC_get_total_bytes() - start_bytes;
+
+    printf("%-28s %10lu ops %10.1f ns/op %12lu bytes allocated\n",
+           what, n_ops, n_ops > 0 ? ns / (double)n_ops : 0.0,
+           (unsigned long)bytes);
+}
+
+static int count_fn(char c, void *client_data)
+{
+    if (c != '\0') ++*(unsigned long *)client_data;
+    return 0;
+}
+
+static int count_chunk_fn(const char *s, size_t len, void *client_data)
+{
+    (void)s;
+    *(unsigned long *)client_data += len;
+    return 0;
+}
+
+static const char *words[] = {
+    "The quick brown fox jumps over the lazy dog. ",
+    "Lorem ipsum dolor sit amet, consectetur. ",
+    "Pack my box with five dozen liquor jugs! ",
+    "0123456789abcdefghijklmnopqrstuvwxyz "
+};
+
+#define N_WORDS (sizeof(words) / sizeof(words[0]))
+
+int main(int argc, char **argv)
+{
+    unsigned long scale = 1;
+    unsigned long n, i;
+    unsigned long sum = 0;
+    CORD x = CORD_EMPTY;
+    CORD y;
+    size_t len;
+    FILE *f;
+
+    if (argc > 1) {
+        scale = strtoul(argv[1], NULL, 10);
+        if (0 == scale) scale = 1;
+    }
+    GC_INIT();
+    srand(1);
+
+    n = 200000 * scale;
+    bench_start();
+    for (i = 0; i < n; i++) {
+        x = CORD_cat(x, words[i % N_WORDS]);
+    }
+    bench_end("CORD_cat append", n);
+    len = CORD_len(x);
+
+    n = 200000 * scale;
+    bench_start();
+    for (i = 0; i < n; i++) {
+        y = CORD_substr(x, (size_t)rand() % (len - 100), 100);
+        if (CORD_len(y) != 100) ABORT("Bad CORD_substr result");
+    }
+    bench_end("CORD_substr(100 chars)", n);
+
+    n = 1000000 * scale;
+    bench_start();
+    for (i = 0; i < n; i++) {
+        sum += (unsigned char)CORD_fetch(x, (size_t)rand() % len);
+    }
+    bench_end("CORD_fetch random", n);
+
+    {
+        CORD_index ix = CORD_index_new(x);
+
+        bench_start();
+        for (i = 0; i < n; i++) {
+            sum += (unsigned char)CORD_index_fetch(ix, (size_t)rand() % len);
+        }
+        bench_end("CORD_index_fetch random", n);
+    }
+
+    bench_start();
+    sum = 0;
+    (void)CORD_iter(x, count_fn, &sum);
+    if (sum != len) ABORT("Bad CORD_iter count");
+    bench_end("CORD_iter (per char)", sum);
+
+    bench_start();
+    sum = 0;
+    (void)CORD_iter_chunks(x, 0, count_chunk_fn, &sum);
+    if (sum != len) ABORT("Bad CORD_iter_chunks count");
+    bench_end("CORD_iter_chunks (per char)", sum);
+
+    y = CORD_cat(x, "needle in a haystack");
+    n = 10 * scale;
+    bench_start();
+    for (i = 0; i < n; i++) {
+        if (CORD_str(y, (size_t)i, "needle in a") != len)
+            ABORT("Bad CORD_str result");
+    }
+    bench_end("CORD_str (per char)", n * (unsigned long)len);
+
+    /* Lazy file access.        */
+    if ((f = fopen(FNAME, "wb")) == NULL) ABORT("open failed");
+    if (CORD_put(x, f) == EOF) ABORT("CORD_put failed");
+    if (fclose(f) == EOF) ABORT("fclose failed");
+    if ((f = fopen(FNAME, "rb")) == NULL) ABORT("Unable to open " FNAME);
+    bench_start();
+    y = CORD_from_file_lazy(f);
+    n = 1000000 * scale;
+    for (i = 0; i < n; i++) {
+        sum += (unsigned char)CORD_fetch(y, (size_t)rand() % len);
+    }
+    bench_end("lazy file CORD_fetch random", n);
+
+    bench_start();
+    sum = 0;
+    (void)CORD_iter_chunks(y, 0, count_chunk_fn, &sum);
+    if (sum != len) ABORT("Bad lazy file length");
+    bench_end("lazy file scan (per char)", sum);
+
+    /* The file is closed by a finalizer.       */
+    *(CORD volatile *)&y = CORD_EMPTY;
+    GC_gcollect();
+#   ifndef GC_NO_FINALIZATION
+      GC_invoke_finalizers();
+#   endif
+    if (remove(FNAME) != 0) {
+        fprintf(stderr, "WARNING: remove failed: " FNAME "\n");
+    }
+    return 0;
+}
@@ -18,6 +18,13 @@
 
 #include "gc.h"    /* For GC_INIT() only */
 #include "gc/cord.h"
+#include "gc/ec.h"
+
+#ifdef CORD_IOVEC
+# include <fcntl.h>
+# include <sys/uio.h>
+# include <unistd.h>
+#endif
 
 /* This is a very incomplete test of the cord package.  It knows about  */
 /* a few internals of the package (e.g. when C strings are returned)    */
@@ -63,6 +70,19 @@ char id_cord_fn(size_t i, void * client_data)
     return (char)i;
 }
 
+int test_chunk_fn(const char * s, size_t len, void * client_data)
+{
+    size_t *pos = (size_t *)client_data;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        if ((size_t)(unsigned char)s[i] != (*pos + i) % 256)
+            ABORT("CORD_iter_chunks: bad char");
+    }
+    *pos += len;
+    return 0;
+}
+
 void test_basics(void)
 {
     CORD x = CORD_from_char_star("ab");
@@ -137,6 +157,33 @@ void test_basics(void)
         i++;
     }
     if (i != 13) ABORT("Bad apparent length for function node");
+
+    y = CORD_cat(CORD_from_fn(id_cord_fn, 0, 256),
+                 CORD_substr(CORD_from_fn(id_cord_fn, 0, 4096), 256, 3000));
+    i = 0;
+    if (CORD_iter_chunks(y, 0, test_chunk_fn, &i) != 0 || i != 3256)
+        ABORT("CORD_iter_chunks failed");
+
+    CORD_set_balanced_cat(1);
+    x = CORD_EMPTY;
+    for (i = 0; i < 3000; i++) {
+        x = CORD_cat(x, CORD_chars((char)('a' + i % 26), 20));
+        if (i % 10 == 0) x = CORD_cat(CORD_from_fn(id_cord_fn, 0, 40), x);
+    }
+    CORD_set_balanced_cat(0);
+    {
+      CORD_index ix = CORD_index_new(x);
+
+      for (i = 0; i < 3000*20 + 300*40; i += 7) {
+        if (CORD_index_fetch(ix, i) != CORD_fetch(x, i))
+          ABORT("CORD_index_fetch failed");
+      }
+    }
+    if (CORD_len(x) != 3000*20 + 300*40) ABORT("Bad balanced cord length");
+    y = CORD_substr(x, 300*40 - 1, 22);
+    if (CORD_fetch(y, 0) != 39 || CORD_fetch(y, 1) != 'a'
+        || CORD_fetch(y, 21) != 'b')
+        ABORT("Bad balanced cord contents");
 #   if defined(CPPCHECK)
         /* TODO: Actually test these functions. */
         CORD_prev(p);
@@ -152,12 +199,14 @@ void test_extras(void)
 {
 #   define FNAME1 "cordtst1.tmp" /* short name (8+3) for portability */
 #   define FNAME2 "cordtst2.tmp"
+#   define FNAME3 "cordtst3.tmp"
+#   define FNAME4 "cordtst4.tmp"
     int i;
     CORD y = "abcdefghijklmnopqrstuvwxyz0123456789";
     CORD x = "{}";
     CORD u, w, z;
     FILE *f;
-    FILE *f1a, *f1b, *f2;
+    FILE *f1a, *f1b, *f1c, *f2, *f2a;
 
     w = CORD_cat(CORD_cat(y,y),y);
     z = CORD_catn(3,y,y,y);
@@ -184,6 +233,13 @@ void test_extras(void)
     if (!f1b) ABORT("2nd open failed: " FNAME1);
     z = CORD_from_file_lazy(f1b);
     if (CORD_cmp(w,z) != 0) ABORT("File conversions differ");
+    f1c = fopen(FNAME1, "rb");
+    if (!f1c) ABORT("3rd open failed: " FNAME1);
+    u = CORD_from_file_mmap(f1c);
+    if (CORD_cmp(w,u) != 0) ABORT("mmap file conversion differs");
+    if (CORD_fetch(u, 50*36+2) != 'a') ABORT("mmap file fetch wrong");
+    if (CORD_rchr(u, CORD_len(u) - 1, '}') != 1)
+        ABORT("mmap file CORD_rchr failed");
     if (CORD_chr(w, 0, '9') != 37) ABORT("CORD_chr failed 1");
     if (CORD_chr(w, 3, 'a') != 38) ABORT("CORD_chr failed 2");
     if (CORD_rchr(w, CORD_len(w) - 1, '}') != 1) ABORT("CORD_rchr failed");
@@ -216,10 +272,68 @@ void test_extras(void)
     if (CORD_str(x,0,"9abcdefghijx") != CORD_NOT_FOUND)
         ABORT("CORD_str failed 3");
     if (CORD_str(x,0,"9>") != CORD_NOT_FOUND) ABORT("CORD_str failed 4");
-    /* Note: f1a, f1b, f2 handles are closed lazily by CORD library.    */
+    if (CORD_str(x, 0, "9abcdefghijklmnopqrstuvwxyz0123456789abc") != 35)
+        ABORT("CORD_str failed 5");
+    if (CORD_str(x, 0, "9abcdefghijklmnopqrstuvwxyz0123456789abx")
+            != CORD_NOT_FOUND)
+        ABORT("CORD_str failed 6");
+    if (CORD_str(x, 36, CORD_substr(x, 35, 100)) != 71)
+        ABORT("CORD_str failed 7");
+    z = CORD_cat(CORD_chars('a', 1000), "ab");
+    if (CORD_str(z, 0, "aab") != 999) ABORT("CORD_str failed 8");
+    if (CORD_rchr(CORD_cat("xy", z), 1001, 'y') != 1)
+        ABORT("CORD_rchr failed 2");
+    f2a = fopen(FNAME2, "rb");
+    if (!f2a) ABORT("2nd open failed: " FNAME2);
+    w = CORD_from_file_mmap(f2a);
+    if (CORD_cmp(w,x) != 0) ABORT("mmap file comparison wrong");
+    if (CORD_cmp(CORD_substr(w, 1000*36, 36), y) != 0)
+        ABORT("mmap file substr wrong");
+    if (CORD_str(w,1,"9a") != 35) ABORT("CORD_str on mmap file failed");
+#   ifdef CORD_IOVEC
+    {
+      struct iovec iov[4];
+      size_t next;
+      int fd;
+
+      if (CORD_to_iovec(x, 0, iov, 4, &next) != 4 || next != 4 * 36
+          || iov[0].iov_len != 36 || memcmp(iov[0].iov_base, y, 36) != 0)
+        ABORT("CORD_to_iovec failed");
+      u = CORD_cat(x, CORD_substr(CORD_cat(w, y), 10, 1000*36));
+      fd = open(FNAME3, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+      if (fd < 0) ABORT("3rd open failed");
+      if (CORD_writev(fd, u) == EOF) ABORT("CORD_writev failed");
+      if (close(fd) != 0) ABORT("close failed");
+      f = fopen(FNAME3, "rb");
+      if (!f) ABORT("Unable to open " FNAME3);
+      if (CORD_cmp(CORD_from_file(f), u) != 0)
+        ABORT("CORD_writev output differs");
+      u = CORD_EMPTY;
+    }
+#   endif
+    if ((f = fopen(FNAME4, "wb")) == 0) ABORT("4th open failed");
+    if (fwrite("ab\0\0\0cd", 1, 7, f) != 7) ABORT("fwrite failed");
+    for (i = 0; i < 20000; i++) {
+        if (putc(i % 5000 == 0 ? '\0' : 'e', f) == EOF)
+            ABORT("putc failed");
+    }
+    if (fclose(f) == EOF) ABORT("fclose failed");
+    if ((f = fopen(FNAME4, "rb")) == 0) ABORT("Unable to open " FNAME4);
+    u = CORD_from_file_eager(f);
+    if (CORD_len(u) != 20007 || CORD_fetch(u, 2) != '\0'
+        || CORD_fetch(u, 5) != 'c' || CORD_fetch(u, 7) != '\0'
+        || CORD_fetch(u, 8) != 'e' || CORD_fetch(u, 5007) != '\0'
+        || CORD_chr(u, 8, '\0') != 5007 || CORD_fetch(u, 20006) != 'e')
+        ABORT("CORD_from_file_eager failed");
+    if (remove(FNAME4) != 0) {
+        fprintf(stderr, "WARNING: remove failed: " FNAME4 "\n");
+    }
+    /* Note: f1a, f1b, f1c, f2, f2a handles are closed lazily by CORD   */
+    /* library.                                                         */
     /* TODO: Propose and use CORD_fclose. */
     *(CORD volatile *)&w = CORD_EMPTY;
     *(CORD volatile *)&z = CORD_EMPTY;
+    *(CORD volatile *)&u = CORD_EMPTY;
     GC_gcollect();
 #   ifndef GC_NO_FINALIZATION
       GC_invoke_finalizers();
@@ -233,6 +347,11 @@ void test_extras(void)
     if (remove(FNAME2) != 0) {
         fprintf(stderr, "WARNING: remove failed: " FNAME2 "\n");
     }
+#   ifdef CORD_IOVEC
+      if (remove(FNAME3) != 0) {
+        fprintf(stderr, "WARNING: remove failed: " FNAME3 "\n");
+      }
+#   endif
 }
 
 int wrap_vprintf(CORD format, ...)
@@ -274,6 +393,41 @@ int wrap_vfprintf(FILE * f, CORD format, ...)
 
 /* no static */ /* no const */ char *zu_format = (char*)"%zu";
 
+void test_builder(void)
+{
+#   define BUILDER_LEN (200000 + 200*36 + 4*300000)
+    CORD_builder b;
+    CORD x;
+    size_t i;
+    size_t pos = 0;
+    const char *s = "abcdefghijklmnopqrstuvwxyz0123456789";
+    char *expected = (char *)GC_MALLOC_ATOMIC(BUILDER_LEN + 1);
+
+    if (NULL == expected) ABORT("Out of memory");
+    CORD_builder_init(b);
+    for (i = 0; i < 200000; i++) {
+        CORD_builder_append(b, s[i % 36]);
+        expected[pos++] = s[i % 36];
+        if (i % 1000 == 0) {
+            CORD_builder_append_span(b, s, 36);
+            memcpy(expected + pos, s, 36);
+            pos += 36;
+        }
+        if (i % 50000 == 0) {
+            CORD_builder_append_cord(b, CORD_chars('x', 300000));
+            memset(expected + pos, 'x', 300000);
+            pos += 300000;
+        }
+    }
+    expected[pos] = '\0';
+    x = CORD_builder_finish(b);
+    if (CORD_len(x) != BUILDER_LEN) ABORT("CORD_builder length wrong");
+    if (strcmp(CORD_to_char_star(x), expected) != 0)
+        ABORT("CORD_builder contents wrong");
+    if (CORD_builder_finish(b) != CORD_EMPTY)
+        ABORT("CORD_builder not reinitialized");
+}
+
 void test_printf(void)
 {
     CORD result;
@@ -305,6 +459,14 @@ void test_printf(void)
 #   endif
     result2[sizeof(result2) - 1] = '\0';
     if (CORD_cmp(result, result2) != 0) ABORT("CORD_sprintf goofed 5");
+    x = CORD_cat(CORD_chars('a', 1000), "b");
+    if (CORD_sprintf(&result, "[%r|%700r]%d", x, "c", 12) != 1706)
+        ABORT("CORD_sprintf failed 4");
+    if (CORD_fetch(result, 1000) != 'a' || CORD_fetch(result, 1001) != 'b'
+        || CORD_fetch(result, 1002) != '|' || CORD_fetch(result, 1003) != ' '
+        || CORD_fetch(result, 1702) != 'c'
+        || CORD_cmp(CORD_substr(result, 1703, 3), "]12") != 0)
+        ABORT("CORD_sprintf goofed 6");
 
 #   ifdef GC_SNPRINTF
         /* Check whether "%zu" specifier is supported; pass the format  */
@@ -343,6 +505,7 @@ int main(void)
         printf("This test program is not designed for leak detection mode\n");
     test_basics();
     test_extras();
+    test_builder();
     test_printf();
     CORD_fprintf(stdout, "SUCCEEDED\n");
     return 0;
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2023 Ivan Maidanski
+ *
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose, provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+#include "private/gc_pmark.h"
+
+#include "gc/gc_cref.h"
+
+/*
+ * The objects of compressed references (see gc_cref.h).  These are of
+ * a separate kind with a mark procedure decoding each 32-bit slot of
+ * the object.  The heap is not grown outside the arena (see
+ * GC_expand_hp_inner), thus every heap object could be referenced.
+ */
+
+void * GC_cref_base = NULL;
+
+#ifdef COMPRESSED_REFS
+
+#ifndef CREF_MARK_CHUNK
+# define CREF_MARK_CHUNK 32 /* references processed at once */
+#endif
+
+STATIC int GC_cref_kind = 0;
+
+STATIC unsigned GC_cref_mark_proc_index = 0;
+
+/* The environment (env) is the number of the references left to be    */
+/* processed, zero means the whole object starting at addr.            */
+STATIC mse * GC_cref_mark_proc(word * addr, mse * mark_stack_ptr,
+                               mse * mark_stack_limit, word env)
+{
+    GC_cref_t *current_p = (GC_cref_t *)addr;
+    ptr_t base = (ptr_t)GC_cref_base;
+    ptr_t greatest_ha = (ptr_t)GC_greatest_plausible_heap_addr;
+    ptr_t least_ha = (ptr_t)GC_least_plausible_heap_addr;
+    word n = env;
+    word i, lim;
+    DECLARE_HDR_CACHE;
+
+    if (0 == n) {
+      /* addr is the object beginning, thus its header is not a         */
+      /* forwarding one.                                                */
+      n = HDR(addr) -> hb_sz / sizeof(GC_cref_t);
+    }
+    lim = n < CREF_MARK_CHUNK ? n : CREF_MARK_CHUNK;
+    INIT_HDR_CACHE;
+    for (i = 0; i < lim; i++) {
+      GC_cref_t r = current_p[i];
+      ptr_t current;
+
+      if (0 == r) continue;
+      current = base + (word)r * GRANULE_BYTES;
+      if ((word)current >= (word)least_ha
+          && (word)current <= (word)greatest_ha) {
+        PUSH_CONTENTS(current, mark_stack_ptr, mark_stack_limit,
+                      (ptr_t)(current_p + i));
+      }
+    }
+    FLUSH_PENDING_MARKS(hdr_cache);
+    if (n > lim) {
+      /* Push an entry with the rest of the object back onto the stack. */
+      mark_stack_ptr++;
+      if ((word)mark_stack_ptr >= (word)mark_stack_limit) {
+        mark_stack_ptr = GC_signal_mark_stack_overflow(mark_stack_ptr);
+      }
+      mark_stack_ptr -> mse_start = (ptr_t)(current_p + lim);
+      mark_stack_ptr -> mse_descr.w =
+                        GC_MAKE_PROC(GC_cref_mark_proc_index, n - lim);
+    }
+    return mark_stack_ptr;
+}
+
+GC_INNER void GC_init_compressed_refs(void)
+{
+    GC_STATIC_ASSERT(sizeof(GC_cref_t) == 4);
+    GC_STATIC_ASSERT(GRANULE_BYTES == GC_GRANULE_BYTES);
+    /* The last granule of the arena should be encodable.       */
+    GC_STATIC_ASSERT(GC_ARENA_SIZE / GRANULE_BYTES < ((word)1 << 32));
+    if (0 == GC_arena_size) {
+      GC_COND_LOG_PRINTF("Compressed references are not available\n");
+      return;
+    }
+    GC_cref_base = (void *)(GC_arena_start - GRANULE_BYTES);
+    GC_cref_mark_proc_index = GC_new_proc_inner(GC_cref_mark_proc);
+    GC_cref_kind = (int)GC_new_kind_inner(GC_new_free_list_inner(),
+                                GC_MAKE_PROC(GC_cref_mark_proc_index, 0),
+                                FALSE, TRUE);
+}
+
+GC_API int GC_CALL GC_cref_available(void)
+{
+    if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+    return GC_cref_base != NULL;
+}
+
+GC_API GC_ATTR_MALLOC void * GC_CALL GC_cref_malloc(size_t lb)
+{
+    if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+    if (EXPECT(0 == GC_cref_kind, FALSE)) return NULL;
+    return GC_malloc_kind(lb, GC_cref_kind);
+}
+
+#else /* !COMPRESSED_REFS */
+
+GC_API int GC_CALL GC_cref_available(void)
+{
+    return 0;
+}
+
+GC_API GC_ATTR_MALLOC void * GC_CALL GC_cref_malloc(size_t lb)
+{
+    UNUSED_ARG(lb);
+    return NULL;
+}
+
+#endif /* !COMPRESSED_REFS */
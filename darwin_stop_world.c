@@ -135,6 +135,63 @@ GC_API void GC_CALL GC_use_threads_discovery(void)
 # define kCFCoreFoundationVersionNumber_iOS_8_0 1140.1
 #endif
 
+/* Get the registers of the given (suspended) thread.  Returns FALSE    */
+/* on failure.                                                          */
+STATIC GC_bool GC_get_thread_state(thread_act_t thread,
+                                   GC_THREAD_STATE_T *pstate)
+{
+  /* MACHINE_THREAD_STATE_COUNT does not seem to be defined everywhere. */
+  /* Hence we use our own version.  Alternatively, we could use         */
+  /* THREAD_STATE_MAX (but seems to be not optimal).                    */
+  kern_return_t kern_result;
+
+# if defined(ARM32) && defined(ARM_THREAD_STATE32)
+    /* Use ARM_UNIFIED_THREAD_STATE on iOS8+ 32-bit targets and on      */
+    /* 64-bit H/W (iOS7+ 32-bit mode).                                  */
+    size_t size;
+    static cpu_type_t cputype = 0;
+
+    if (cputype == 0) {
+      sysctlbyname("hw.cputype", &cputype, &size, NULL, 0);
+    }
+    if (cputype == CPU_TYPE_ARM64
+        || kCFCoreFoundationVersionNumber
+           >= kCFCoreFoundationVersionNumber_iOS_8_0) {
+      arm_unified_thread_state_t unified_state;
+      mach_msg_type_number_t unified_thread_state_count
+                                        = ARM_UNIFIED_THREAD_STATE_COUNT;
+#     if defined(CPPCHECK)
+#       define GC_ARM_UNIFIED_THREAD_STATE 1
+#     else
+#       define GC_ARM_UNIFIED_THREAD_STATE ARM_UNIFIED_THREAD_STATE
+#     endif
+      kern_result = thread_get_state(thread, GC_ARM_UNIFIED_THREAD_STATE,
+                                     (natural_t *)&unified_state,
+                                     &unified_thread_state_count);
+#     if !defined(CPPCHECK)
+        if (unified_state.ash.flavor != ARM_THREAD_STATE32) {
+          ABORT("unified_state flavor should be ARM_THREAD_STATE32");
+        }
+#     endif
+      *pstate = unified_state;
+    } else
+# endif
+  /* else */ {
+    mach_msg_type_number_t thread_state_count = GC_MACH_THREAD_STATE_COUNT;
+
+    /* Get the thread state (registers, etc.) */
+    do {
+      kern_result = thread_get_state(thread, GC_MACH_THREAD_STATE,
+                                     (natural_t *)pstate,
+                                     &thread_state_count);
+    } while (kern_result == KERN_ABORTED);
+  }
+# ifdef DEBUG_THREADS
+    GC_log_printf("thread_get_state returns %d\n", kern_result);
+# endif
+  return kern_result == KERN_SUCCESS;
+}
+
 /* Evaluates the stack range for a given thread.  Returns the lower     */
 /* bound and sets *phi to the upper one.  Sets *pfound_me to TRUE if    */
 /* this is current thread, otherwise the value is not changed.          */
@@ -158,58 +215,14 @@ STATIC ptr_t GC_stack_range_for(ptr_t *phi, thread_act_t thread, GC_thread p,
 #   endif
 
   } else {
-    /* MACHINE_THREAD_STATE_COUNT does not seem to be defined       */
-    /* everywhere.  Hence we use our own version.  Alternatively,   */
-    /* we could use THREAD_STATE_MAX (but seems to be not optimal). */
-    kern_return_t kern_result;
     GC_THREAD_STATE_T state;
 
-#   if defined(ARM32) && defined(ARM_THREAD_STATE32)
-      /* Use ARM_UNIFIED_THREAD_STATE on iOS8+ 32-bit targets and on    */
-      /* 64-bit H/W (iOS7+ 32-bit mode).                                */
-      size_t size;
-      static cpu_type_t cputype = 0;
-
-      if (cputype == 0) {
-        sysctlbyname("hw.cputype", &cputype, &size, NULL, 0);
-      }
-      if (cputype == CPU_TYPE_ARM64
-          || kCFCoreFoundationVersionNumber
-             >= kCFCoreFoundationVersionNumber_iOS_8_0) {
-        arm_unified_thread_state_t unified_state;
-        mach_msg_type_number_t unified_thread_state_count
-                                        = ARM_UNIFIED_THREAD_STATE_COUNT;
-#       if defined(CPPCHECK)
-#         define GC_ARM_UNIFIED_THREAD_STATE 1
-#       else
-#         define GC_ARM_UNIFIED_THREAD_STATE ARM_UNIFIED_THREAD_STATE
-#       endif
-        kern_result = thread_get_state(thread, GC_ARM_UNIFIED_THREAD_STATE,
-                                       (natural_t *)&unified_state,
-                                       &unified_thread_state_count);
-#       if !defined(CPPCHECK)
-          if (unified_state.ash.flavor != ARM_THREAD_STATE32) {
-            ABORT("unified_state flavor should be ARM_THREAD_STATE32");
-          }
-#       endif
-        state = unified_state;
-      } else
-#   endif
-    /* else */ {
-      mach_msg_type_number_t thread_state_count = GC_MACH_THREAD_STATE_COUNT;
-
-      /* Get the thread state (registers, etc.) */
-      do {
-        kern_result = thread_get_state(thread, GC_MACH_THREAD_STATE,
-                                       (natural_t *)&state,
-                                       &thread_state_count);
-      } while (kern_result == KERN_ABORTED);
-    }
-#   ifdef DEBUG_THREADS
-      GC_log_printf("thread_get_state returns %d\n", kern_result);
-#   endif
-    if (kern_result != KERN_SUCCESS)
+    if (p != NULL && (p -> flags & STATE_SAVED) != 0) {
+      /* Captured by GC_stop_world.     */
+      state = p -> stopped_state;
+    } else if (!GC_get_thread_state(thread, &state)) {
       ABORT("thread_get_state failed");
+    }
 
 #   if defined(I386)
       lo = (ptr_t)state.THREAD_FLD(esp);
@@ -392,7 +405,7 @@ GC_INNER void GC_push_all_stacks(void)
   /* else */ {
     int i;
 
-    for (i = 0; i < THREAD_TABLE_SZ; i++) {
+    for (i = 0; i < GC_thread_table_sz; i++) {
       GC_thread p;
 
       for (p = GC_threads[i]; p != NULL; p = p -> tm.next)
@@ -615,7 +628,7 @@ GC_INNER void GC_stop_world(void)
   } else {
     unsigned i;
 
-    for (i = 0; i < THREAD_TABLE_SZ; i++) {
+    for (i = 0; i < (unsigned)GC_thread_table_sz; i++) {
       GC_thread p;
 
       for (p = GC_threads[i]; p != NULL; p = p -> tm.next) {
@@ -628,6 +641,11 @@ GC_INNER void GC_stop_world(void)
           GC_release_dirty_lock();
           if (kern_result != KERN_SUCCESS)
             ABORT("thread_suspend failed");
+          /* Capture the registers now, while the thread data is likely */
+          /* still hot, so that GC_push_all_stacks does not need to     */
+          /* query the kernel again.                                    */
+          if (GC_get_thread_state(p -> mach_thread, &(p -> stopped_state)))
+            p -> flags |= STATE_SAVED;
           if (GC_on_thread_event)
             GC_on_thread_event(GC_EVENT_THREAD_SUSPENDED,
                                (void *)(word)(p -> mach_thread));
@@ -751,10 +769,11 @@ GC_INNER void GC_start_world(void)
     int i;
     mach_port_t my_thread = mach_thread_self();
 
-    for (i = 0; i < THREAD_TABLE_SZ; i++) {
+    for (i = 0; i < GC_thread_table_sz; i++) {
       GC_thread p;
 
       for (p = GC_threads[i]; p != NULL; p = p -> tm.next) {
+        p -> flags &= ~STATE_SAVED;
         if ((p -> flags & (FINISHED | DO_BLOCKING)) == 0
             && p -> mach_thread != my_thread)
           GC_thread_resume(p -> mach_thread);
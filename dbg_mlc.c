@@ -271,12 +271,13 @@
 # define CROSSES_HBLK(p, sz) \
         (((word)((p) + sizeof(oh) + (sz) - 1) ^ (word)(p)) >= HBLKSIZE)
 
+/* The lock is not required if the object is not visible to the other */
+/* threads yet (see store_debug_info).                                  */
 GC_INNER void *GC_store_debug_info_inner(void *p, word sz,
                                          const char *string, int linenum)
 {
     word * result = (word *)((oh *)p + 1);
 
-    GC_ASSERT(I_HOLD_LOCK());
     GC_ASSERT(GC_size(p) >= sizeof(oh) + sz);
     GC_ASSERT(!(SMALL_OBJ(sz) && CROSSES_HBLK((ptr_t)p, sz)));
 #   ifdef KEEP_BACK_PTRS
@@ -311,6 +312,16 @@ static void *store_debug_info(void *p, size_t lb,
                       fn, (unsigned long)lb, s, i);
         return NULL;
     }
+#   ifndef SAVE_CALL_CHAIN
+      /* The fast path: the header of a new object (not yet visible to  */
+      /* the other threads) is filled in without the lock.  A collection */
+      /* might find the header partially written, but such an object is  */
+      /* not reported as smashed (see GC_print_all_smashed_proc).        */
+      if (EXPECT(GC_debugging_started, TRUE)) {
+        ADD_CALL_CHAIN(p, ra);
+        return GC_store_debug_info_inner(p, (word)lb, s, i);
+      }
+#   endif
     LOCK();
     if (!GC_debugging_started)
         GC_start_debugging_inner();
@@ -951,6 +962,10 @@ GC_API GC_ATTR_MALLOC void * GC_CALL
 STATIC ptr_t GC_smashed[MAX_SMASHED] = {0};
 STATIC unsigned GC_n_smashed = 0;
 
+STATIC unsigned GC_check_heap_period = 1;
+                        /* Check about one in so many heap blocks at    */
+                        /* each collection; zero means no check.        */
+
 STATIC void GC_add_smashed(ptr_t smashed)
 {
     GC_ASSERT(I_HOLD_LOCK());
@@ -966,19 +981,31 @@ STATIC void GC_add_smashed(ptr_t smashed)
 /* Print all objects on the list.  Clear the list.      */
 STATIC void GC_print_all_smashed_proc(void)
 {
-    unsigned i;
+    unsigned i, n_smashed = 0;
 
     GC_ASSERT(I_DONT_HOLD_LOCK());
     if (GC_n_smashed == 0) return;
-    GC_err_printf("GC_check_heap_block: found %u smashed heap objects:\n",
-                  GC_n_smashed);
+    /* The header of an object might be found partially written by the  */
+    /* thread allocating it (see store_debug_info), so the objects are  */
+    /* rechecked; the client is unlikely to repair a smashed one.       */
     for (i = 0; i < GC_n_smashed; ++i) {
         ptr_t base = (ptr_t)GC_base(GC_smashed[i]);
 
 #       ifdef LINT2
           if (!base) ABORT("Invalid GC_smashed element");
 #       endif
-        GC_print_smashed_obj("", base + sizeof(oh), GC_smashed[i]);
+        if (GC_check_annotated_obj((oh *)base) != NULL)
+          GC_smashed[n_smashed++] = GC_smashed[i];
+    }
+    if (n_smashed > 0)
+      GC_err_printf("GC_check_heap_block: found %u smashed heap objects:\n",
+                    n_smashed);
+    for (i = 0; i < GC_n_smashed; ++i) {
+        if (i < n_smashed) {
+          ptr_t base = (ptr_t)GC_base(GC_smashed[i]);
+
+          GC_print_smashed_obj("", base + sizeof(oh), GC_smashed[i]);
+        }
         GC_smashed[i] = 0;
     }
     GC_n_smashed = 0;
@@ -994,6 +1021,7 @@ STATIC void GC_CALLBACK GC_check_heap_block(struct hblk *hbp, GC_word dummy)
     char *p, *plim;
 
     UNUSED_ARG(dummy);
+    VALIDATE_MARKS(hhdr);
     p = hbp->hb_body;
     if (sz > MAXOBJBYTES) {
       plim = p;
@@ -1011,6 +1039,17 @@ STATIC void GC_CALLBACK GC_check_heap_block(struct hblk *hbp, GC_word dummy)
     }
 }
 
+/* Same as GC_check_heap_block but only for about one in               */
+/* GC_check_heap_period blocks, a different subset at each collection. */
+STATIC void GC_CALLBACK GC_check_heap_block_part(struct hblk *hbp,
+                                                 GC_word dummy)
+{
+    word n = (word)GC_check_heap_period;
+
+    if (((word)hbp >> LOG_HBLKSIZE) % n == GC_gc_no % n)
+      GC_check_heap_block(hbp, dummy);
+}
+
 /* This assumes that all accessible objects are marked.         */
 /* Normally called by collector.                                */
 STATIC void GC_check_heap_proc(void)
@@ -1018,7 +1057,11 @@ STATIC void GC_check_heap_proc(void)
   GC_ASSERT(I_HOLD_LOCK());
   GC_STATIC_ASSERT((sizeof(oh) & (GRANULE_BYTES - 1)) == 0);
   /* FIXME: Should we check for twice that alignment?   */
-  GC_apply_to_all_blocks(GC_check_heap_block, 0);
+  if (EXPECT(GC_check_heap_period > 1, FALSE)) {
+    GC_apply_to_all_blocks(GC_check_heap_block_part, 0);
+  } else if (GC_check_heap_period != 0) {
+    GC_apply_to_all_blocks(GC_check_heap_block, 0);
+  }
 }
 
 GC_INNER GC_bool GC_check_leaked(ptr_t base)
@@ -1047,6 +1090,28 @@ GC_INNER GC_bool GC_check_leaked(ptr_t base)
   return FALSE; /* GC_debug_free() has been called */
 }
 
+GC_API void GC_CALL GC_set_debug_check_heap_period(unsigned n)
+{
+  GC_check_heap_period = n;
+}
+
+GC_API unsigned GC_CALL GC_get_debug_check_heap_period(void)
+{
+  return GC_check_heap_period;
+}
+
+#else
+
+GC_API void GC_CALL GC_set_debug_check_heap_period(unsigned n)
+{
+  UNUSED_ARG(n);
+}
+
+GC_API unsigned GC_CALL GC_get_debug_check_heap_period(void)
+{
+  return 0;
+}
+
 #endif /* !SHORT_DBG_HDRS */
 
 #ifndef GC_NO_FINALIZATION
@@ -588,6 +588,31 @@ GC_INNER GC_bool GC_register_main_static_data(void)
 # endif
 }
 
+# ifdef DYNLIB_CACHE
+    STATIC int GC_dynlib_generation_callback(struct dl_phdr_info * info,
+                                             size_t size, void * ptr)
+    {
+      if (size < offsetof(struct dl_phdr_info, dlpi_subs)
+                 + sizeof(info->dlpi_subs))
+        return -1;
+
+      /* Both counters only grow, thus their sum changes whenever an    */
+      /* object is loaded or unloaded.                                  */
+      *(word *)ptr = (word)(info->dlpi_adds + info->dlpi_subs);
+      return 1; /* the counters are the same for all objects */
+    }
+
+    GC_INNER word GC_get_dynlib_generation(void)
+    {
+      word gen = 0;
+
+      if (GC_register_main_static_data()
+          || dl_iterate_phdr(GC_dynlib_generation_callback, &gen) != 1)
+        return 0;
+      return gen;
+    }
+# endif /* DYNLIB_CACHE */
+
 /* Return TRUE if we succeed, FALSE if dl_iterate_phdr wasn't there. */
 STATIC GC_bool GC_register_dynamic_libraries_dl_iterate_phdr(void)
 {
@@ -1581,5 +1606,14 @@ GC_INNER GC_bool GC_register_main_static_data(void)
 GC_API void GC_CALL GC_register_has_static_roots_callback(
                                         GC_has_static_roots_func callback)
 {
-    GC_has_static_roots = callback;
+#   ifdef DYNLIB_CACHE
+      DCL_LOCK_STATE;
+
+      LOCK();
+      GC_has_static_roots = callback;
+      GC_dynlib_generation = 0; /* re-register the libraries */
+      UNLOCK();
+#   else
+      GC_has_static_roots = callback;
+#   endif
 }
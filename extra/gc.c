@@ -40,8 +40,12 @@
 #include "../backgraph.c"
 #include "../blacklst.c"
 #include "../checksums.c"
+#include "../cref_mlc.c"
 #include "../gcj_mlc.c"
 #include "../headers.c"
+#include "../heapprof.c"
+#include "../lifetime.c"
+#include "../heapimg.c"
 #include "../new_hblk.c"
 #include "../obj_map.c"
 #include "../ptr_chck.c"
@@ -35,16 +35,6 @@ struct hash_chain_entry {
     struct hash_chain_entry * next;
 };
 
-struct disappearing_link {
-    struct hash_chain_entry prolog;
-#   define dl_hidden_link prolog.hidden_key
-                                /* Field to be cleared.         */
-#   define dl_next(x) (struct disappearing_link *)((x) -> prolog.next)
-#   define dl_set_next(x, y) \
-                (void)((x)->prolog.next = (struct hash_chain_entry *)(y))
-    word dl_hidden_obj;         /* Pointer to object base       */
-};
-
 struct finalizable_object {
     struct hash_chain_entry prolog;
 #   define fo_hidden_base prolog.hidden_key
@@ -68,16 +58,55 @@ struct finalizable_object {
 # define SET_FINALIZE_NOW(fo) (void)(GC_fnlz_roots.finalize_now = (fo))
 #endif /* !THREADS */
 
+STATIC word GC_fnlz_queue_len = 0;
+                        /* The number of objects on the finalize_now    */
+                        /* list.  Updated with the allocation lock      */
+                        /* held, read without it.                       */
+STATIC word GC_fnlz_queue_max_len = 0;  /* the peak value of the above  */
+
+#define FNLZ_QUEUE_ADD(n) \
+        (void)(GC_fnlz_queue_len += (n), \
+               GC_fnlz_queue_len > GC_fnlz_queue_max_len \
+                ? (GC_fnlz_queue_max_len = GC_fnlz_queue_len) : 0)
+#define FNLZ_QUEUE_SUB(n) (void)(GC_fnlz_queue_len -= (n))
+
+GC_API GC_word GC_CALL GC_get_finalizer_queue_length(void)
+{
+# ifdef AO_HAVE_load
+    return (GC_word)AO_load((volatile AO_t *)&GC_fnlz_queue_len);
+# else
+    return GC_fnlz_queue_len;
+# endif
+}
+
+GC_API GC_word GC_CALL GC_get_finalizer_queue_max_length(void)
+{
+    return GC_fnlz_queue_max_len;
+}
+
+STATIC void GC_push_dl_hashtbl(struct dl_hashtbl_s *dl_hashtbl)
+{
+  int i;
+
+  for (i = 0; i < DL_SHARDS; i++) {
+    GC_ASSERT((word)(&dl_hashtbl->shards[i].s.slots_base) % sizeof(word)
+              == 0);
+    GC_PUSH_ALL_SYM(dl_hashtbl->shards[i].s.slots_base);
+  }
+}
+
 GC_API void GC_CALL GC_push_finalizer_structures(void)
 {
-  GC_ASSERT((word)(&GC_dl_hashtbl.head) % sizeof(word) == 0);
   GC_ASSERT((word)(&GC_fnlz_roots) % sizeof(word) == 0);
 # ifndef GC_LONG_REFS_NOT_NEEDED
-    GC_ASSERT((word)(&GC_ll_hashtbl.head) % sizeof(word) == 0);
-    GC_PUSH_ALL_SYM(GC_ll_hashtbl.head);
+    GC_push_dl_hashtbl(&GC_ll_hashtbl);
+# endif
+# ifndef GC_MOVABLE_NOT_NEEDED
+    GC_push_dl_hashtbl(&GC_mh_hashtbl);
 # endif
-  GC_PUSH_ALL_SYM(GC_dl_hashtbl.head);
+  GC_push_dl_hashtbl(&GC_dl_hashtbl);
   GC_PUSH_ALL_SYM(GC_fnlz_roots);
+  GC_PUSH_ALL_SYM(GC_dl_queue);
   /* GC_toggleref_arr is pushed specially by GC_mark_togglerefs.        */
 }
 
@@ -157,13 +186,304 @@ GC_API int GC_CALL GC_register_disappearing_link(void * * link)
     return GC_general_register_disappearing_link(link, base);
 }
 
+/* The disappearing links tables are split into DL_SHARDS shards by     */
+/* the link address.  Each shard is an open-addressing table of slots   */
+/* grouped into buckets (of the cache line size for the typical one);   */
+/* a link is looked up by linear probing from the first slot of the     */
+/* bucket chosen by the link hash, and deleted by shifting the rest of  */
+/* the probe sequence back (so no tombstones are needed).  Registering  */
+/* and unregistering a link acquire only the lock of its shard (if      */
+/* DL_SHARD_LOCKS), the collector locks all the shards while holding    */
+/* the allocation lock.  A shard grows with both locks held.            */
+#define DL_SLOT_WORDS 2
+#define LOG_DL_BUCKET_SLOTS 2
+#define LOG_DL_MIN_SLOTS (LOG_DL_BUCKET_SLOTS + 2)
+#define DL_NOT_FOUND (~(size_t)0)
+
+#define dl_slot_link(slots, i) (slots)[(i) * DL_SLOT_WORDS]
+#define dl_slot_obj(slots, i) (slots)[(i) * DL_SLOT_WORDS + 1]
+
+/* The objects are granule-aligned, thus the lowest bit of a hidden     */
+/* object pointer is set, unless the link has been registered by        */
+/* GC_register_disappearing_link_notify (then the bit is cleared).      */
+/* Such a link cleared by the collector stays in the table (with zero   */
+/* object) until it is known whether the object holding it is alive.    */
+#define DL_NOTIFY_FLAG ((word)1)
+#define DL_NOTIFY_CLEARED ((word)0)
+#define DL_IS_NOTIFY(hidden_obj) (((hidden_obj) & DL_NOTIFY_FLAG) == 0)
+#define DL_REVEAL_OBJ(hidden_obj) \
+                ((ptr_t)GC_REVEAL_POINTER((hidden_obj) | DL_NOTIFY_FLAG))
+#define DL_SHARD_AT(dl_hashtbl, i) (&(dl_hashtbl) -> shards[i].s)
+
+/* Fibonacci hashing, the high bits of the result are used.     */
+#if CPP_WORDSZ == 64
+# define DL_HASH_MULT ((word)0x9E3779B9UL << 32 | (word)0x7F4A7C15UL)
+#else
+# define DL_HASH_MULT ((word)0x9E3779B9UL)
+#endif
+#define DL_HASH(link) ((word)(link) * DL_HASH_MULT)
+#define DL_SHARD_OF(dl_hashtbl, h) \
+                DL_SHARD_AT(dl_hashtbl, (h) >> (CPP_WORDSZ - LOG_DL_SHARDS))
+#define DL_START_SLOT(h, log_size) \
+        ((size_t)(((h) << LOG_DL_SHARDS) \
+                  >> (CPP_WORDSZ - (log_size) + LOG_DL_BUCKET_SLOTS)) \
+         << LOG_DL_BUCKET_SLOTS)
+
+/* Keep the load factor at most 3/4.    */
+#define DL_HAS_ROOM(sh) ((sh) -> slots != NULL \
+                && (sh) -> entries + 1 <= (((word)3 << (sh) -> log_size) >> 2))
+
+#ifdef DL_SHARD_LOCKS
+# ifdef GC_PTHREADS
+#   include <sched.h>
+# endif
+
+  STATIC void GC_dl_shard_lock_slow(volatile AO_TS_t *plock)
+  {
+    while (AO_test_and_set_acquire(plock) == AO_TS_SET) {
+#     ifdef GC_PTHREADS
+        sched_yield();
+#     else
+        Sleep(0);
+#     endif
+    }
+  }
+
+# define DL_SHARD_LOCK(sh) \
+        (void)(AO_test_and_set_acquire(&(sh) -> lock) == AO_TS_SET \
+               ? (GC_dl_shard_lock_slow(&(sh) -> lock), 0) : 0)
+# define DL_SHARD_UNLOCK(sh) AO_CLEAR(&(sh) -> lock)
+  /* The lock held by a client operation on the shard.  */
+# define DL_CLIENT_LOCK(sh) DL_SHARD_LOCK(sh)
+# define DL_CLIENT_UNLOCK(sh) DL_SHARD_UNLOCK(sh)
+#else
+# define DL_SHARD_LOCK(sh) (void)(sh)
+# define DL_SHARD_UNLOCK(sh) (void)(sh)
+# define DL_CLIENT_LOCK(sh) LOCK()
+# define DL_CLIENT_UNLOCK(sh) UNLOCK()
+#endif /* !DL_SHARD_LOCKS */
+
+STATIC void GC_lock_dl_hashtbl(struct dl_hashtbl_s *dl_hashtbl)
+{
+    int i;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    for (i = 0; i < DL_SHARDS; i++)
+      DL_SHARD_LOCK(DL_SHARD_AT(dl_hashtbl, i));
+}
+
+STATIC void GC_unlock_dl_hashtbl(struct dl_hashtbl_s *dl_hashtbl)
+{
+    int i;
+
+    for (i = 0; i < DL_SHARDS; i++)
+      DL_SHARD_UNLOCK(DL_SHARD_AT(dl_hashtbl, i));
+}
+
+#ifdef DL_SHARD_LOCKS
+  GC_INNER void GC_acquire_dl_shard_locks(void)
+  {
+    GC_lock_dl_hashtbl(&GC_dl_hashtbl);
+#   ifndef GC_LONG_REFS_NOT_NEEDED
+      GC_lock_dl_hashtbl(&GC_ll_hashtbl);
+#   endif
+#   ifndef GC_MOVABLE_NOT_NEEDED
+      GC_lock_dl_hashtbl(&GC_mh_hashtbl);
+#   endif
+  }
+
+  GC_INNER void GC_release_dl_shard_locks(void)
+  {
+#   ifndef GC_MOVABLE_NOT_NEEDED
+      GC_unlock_dl_hashtbl(&GC_mh_hashtbl);
+#   endif
+#   ifndef GC_LONG_REFS_NOT_NEEDED
+      GC_unlock_dl_hashtbl(&GC_ll_hashtbl);
+#   endif
+    GC_unlock_dl_hashtbl(&GC_dl_hashtbl);
+  }
+#endif /* DL_SHARD_LOCKS */
+
+#if !defined(SMALL_CONFIG) || !defined(GC_MOVABLE_NOT_NEEDED) \
+    || defined(PARALLEL_MARK)
+  /* Total number of entries in the table (the value might be stale).   */
+  STATIC word GC_dl_entries(const struct dl_hashtbl_s *dl_hashtbl)
+  {
+    word entries = 0;
+    int i;
+
+    for (i = 0; i < DL_SHARDS; i++)
+      entries += dl_hashtbl -> shards[i].s.entries;
+    return entries;
+  }
+#endif
+
+/* Return the index of the slot holding hidden_link, or DL_NOT_FOUND.   */
+/* h is the hash of the link.                                           */
+STATIC size_t GC_dl_find(const struct dl_shard_s *sh, word h,
+                         word hidden_link)
+{
+    size_t mask, i;
+
+    if (NULL == sh -> slots) return DL_NOT_FOUND;
+    mask = ((size_t)1 << sh -> log_size) - 1;
+    for (i = DL_START_SLOT(h, sh -> log_size);; i = (i + 1) & mask) {
+      word curr_link = dl_slot_link(sh -> slots, i);
+
+      if (curr_link == hidden_link) return i;
+      if (0 == curr_link) return DL_NOT_FOUND;
+    }
+}
+
+/* Put the link (which is not in the table yet) to the first empty      */
+/* slot of its probe sequence.  The shard should have room for it.      */
+STATIC void GC_dl_insert(struct dl_shard_s *sh, word h, word hidden_link,
+                         word hidden_obj)
+{
+    size_t mask = ((size_t)1 << sh -> log_size) - 1;
+    size_t i = DL_START_SLOT(h, sh -> log_size);
+
+    while (dl_slot_link(sh -> slots, i) != 0)
+      i = (i + 1) & mask;
+    dl_slot_link(sh -> slots, i) = hidden_link;
+    dl_slot_obj(sh -> slots, i) = hidden_obj;
+    sh -> entries++;
+    if (DL_IS_NOTIFY(hidden_obj)) sh -> notify_entries++;
+}
+
+/* Delete the entry of the i-th slot.  The following entries of the     */
+/* probe sequence are shifted back to fill the hole, thus the i-th slot */
+/* may contain another entry on return.                                 */
+STATIC void GC_dl_delete_at(struct dl_shard_s *sh, size_t i)
+{
+    word *slots = sh -> slots;
+    size_t mask = ((size_t)1 << sh -> log_size) - 1;
+    size_t j = i;
+
+    if (DL_IS_NOTIFY(dl_slot_obj(slots, i))) sh -> notify_entries--;
+    for (;;) {
+      word curr_link;
+      size_t home;
+
+      j = (j + 1) & mask;
+      curr_link = dl_slot_link(slots, j);
+      if (0 == curr_link) break;
+      home = DL_START_SLOT(DL_HASH(GC_REVEAL_POINTER(curr_link)),
+                           sh -> log_size);
+      /* The entry could be moved to the hole unless its start slot    */
+      /* is (cyclically) in (i, j].                                    */
+      if (((j - home) & mask) >= ((j - i) & mask)) {
+        dl_slot_link(slots, i) = curr_link;
+        dl_slot_obj(slots, i) = dl_slot_obj(slots, j);
+        i = j;
+      }
+    }
+    dl_slot_link(slots, i) = 0;
+    dl_slot_obj(slots, i) = 0;
+    sh -> entries--;
+}
+
+/* Grow the shard to the given number of slots (log) unless it is      */
+/* already as large (or allocate the initial slots).  Called holding    */
+/* the allocation lock but not the shard one.  Returns FALSE if out of  */
+/* memory.                                                              */
+STATIC GC_bool GC_grow_dl_shard_to(struct dl_shard_s *sh,
+                                   unsigned log_new_size,
+                                   const char *tbl_log_name)
+{
+    word *old_slots = sh -> slots;
+    size_t bytes = ((size_t)DL_SLOT_WORDS * sizeof(word)) << log_new_size;
+    ptr_t base;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    if (old_slots != NULL && sh -> log_size >= log_new_size) return TRUE;
+    base = (ptr_t)GC_INTERNAL_MALLOC_IGNORE_OFF_PAGE(bytes + CACHE_LINE_SIZE,
+                                                     PTRFREE);
+    if (EXPECT(base != NULL, TRUE)) {
+      word *new_slots = (word *)(((word)base + CACHE_LINE_SIZE - 1)
+                                 & ~(word)(CACHE_LINE_SIZE - 1));
+
+      BZERO(new_slots, bytes);
+      DL_SHARD_LOCK(sh);
+      if (sh -> slots == old_slots) { /* not grown by another thread */
+        size_t old_size = NULL == old_slots ? 0
+                                : (size_t)1 << sh -> log_size;
+        size_t i;
+
+        sh -> slots = new_slots;
+        sh -> slots_base = base;
+        sh -> log_size = log_new_size;
+        sh -> entries = 0;
+        sh -> notify_entries = 0;
+        for (i = 0; i < old_size; i++) {
+          word hidden_link = dl_slot_link(old_slots, i);
+
+          if (hidden_link != 0)
+            GC_dl_insert(sh, DL_HASH(GC_REVEAL_POINTER(hidden_link)),
+                         hidden_link, dl_slot_obj(old_slots, i));
+        }
+        GC_COND_LOG_PRINTF("Grew %s table shard to %u entries\n",
+                           tbl_log_name, 1U << log_new_size);
+      }
+      DL_SHARD_UNLOCK(sh);
+    }
+    return base != NULL;
+}
+
+/* Double the number of slots of the shard (or allocate the initial     */
+/* ones).  Called holding the client lock of the shard, which might be  */
+/* released temporarily, thus the caller should recheck the shard state */
+/* on return.  Returns FALSE if out of memory.                          */
+STATIC GC_bool GC_grow_dl_shard(struct dl_shard_s *sh,
+                                const char *tbl_log_name)
+{
+    unsigned log_new_size = NULL == sh -> slots ? LOG_DL_MIN_SLOTS
+                                : sh -> log_size + 1;
+    GC_bool res;
+    DCL_LOCK_STATE;
+
+#   ifdef DL_SHARD_LOCKS
+      /* The allocation lock is acquired before the shard one.  */
+      DL_SHARD_UNLOCK(sh);
+      LOCK();
+#   endif
+    res = GC_grow_dl_shard_to(sh, log_new_size, tbl_log_name);
+#   ifdef DL_SHARD_LOCKS
+      UNLOCK();
+      DL_SHARD_LOCK(sh);
+#   endif
+    return res;
+}
+
+/* Register the link in the shard (or update the object of an already   */
+/* registered one).  Called holding the shard client lock.  Returns     */
+/* GC_SUCCESS, GC_DUPLICATE, or GC_NO_MEMORY if the shard should grow.  */
+STATIC int GC_dl_put(struct dl_shard_s *sh, word h, word hidden_link,
+                     word hidden_obj)
+{
+    size_t i = GC_dl_find(sh, h, hidden_link);
+
+    if (i != DL_NOT_FOUND) {
+      if (DL_IS_NOTIFY(dl_slot_obj(sh -> slots, i))) sh -> notify_entries--;
+      if (DL_IS_NOTIFY(hidden_obj)) sh -> notify_entries++;
+      dl_slot_obj(sh -> slots, i) = hidden_obj;
+      return GC_DUPLICATE;
+    }
+    if (EXPECT(!DL_HAS_ROOM(sh), FALSE)) return GC_NO_MEMORY;
+    GC_dl_insert(sh, h, hidden_link, hidden_obj);
+    return GC_SUCCESS;
+}
+
 STATIC int GC_register_disappearing_link_inner(
                         struct dl_hashtbl_s *dl_hashtbl, void **link,
-                        const void *obj, const char *tbl_log_name)
+                        const void *obj, const char *tbl_log_name,
+                        GC_bool notify)
 {
-    struct disappearing_link *curr_dl;
-    size_t index;
-    struct disappearing_link * new_dl;
+    word h = DL_HASH(link);
+    struct dl_shard_s *sh = DL_SHARD_OF(dl_hashtbl, h);
+    word hidden_link = GC_HIDE_POINTER(link);
+    word hidden_obj = GC_HIDE_POINTER(obj) & ~(notify ? DL_NOTIFY_FLAG : 0);
+    int res;
     DCL_LOCK_STATE;
 
     GC_ASSERT(GC_is_initialized);
@@ -171,61 +491,75 @@ STATIC int GC_register_disappearing_link_inner(
 #   ifdef GC_ASSERTIONS
       GC_noop1((word)(*link)); /* check accessibility */
 #   endif
-    LOCK();
     GC_ASSERT(obj != NULL && GC_base_C(obj) == obj);
-    if (EXPECT(NULL == dl_hashtbl -> head, FALSE)
-        || EXPECT(dl_hashtbl -> entries
-                  > ((word)1 << dl_hashtbl -> log_size), FALSE)) {
-        GC_grow_table((struct hash_chain_entry ***)&dl_hashtbl -> head,
-                      &dl_hashtbl -> log_size, &dl_hashtbl -> entries);
-        GC_COND_LOG_PRINTF("Grew %s table to %u entries\n", tbl_log_name,
-                           1U << dl_hashtbl -> log_size);
-    }
-    index = HASH2(link, dl_hashtbl -> log_size);
-    for (curr_dl = dl_hashtbl -> head[index]; curr_dl != 0;
-         curr_dl = dl_next(curr_dl)) {
-        if (curr_dl -> dl_hidden_link == GC_HIDE_POINTER(link)) {
-            curr_dl -> dl_hidden_obj = GC_HIDE_POINTER(obj);
-            UNLOCK();
-            return GC_DUPLICATE;
-        }
+    DL_CLIENT_LOCK(sh);
+    while ((res = GC_dl_put(sh, h, hidden_link, hidden_obj))
+           == GC_NO_MEMORY) {
+      if (EXPECT(!GC_grow_dl_shard(sh, tbl_log_name), FALSE)) break;
     }
-    new_dl = (struct disappearing_link *)
-        GC_INTERNAL_MALLOC(sizeof(struct disappearing_link),NORMAL);
-    if (EXPECT(NULL == new_dl, FALSE)) {
-      GC_oom_func oom_fn = GC_oom_fn;
-      UNLOCK();
-      new_dl = (struct disappearing_link *)
-                (*oom_fn)(sizeof(struct disappearing_link));
-      if (0 == new_dl) {
-        return GC_NO_MEMORY;
-      }
-      /* It's not likely we'll make it here, but ... */
-      LOCK();
-      /* Recalculate index since the table may grow.    */
-      index = HASH2(link, dl_hashtbl -> log_size);
-      /* Check again that our disappearing link not in the table. */
-      for (curr_dl = dl_hashtbl -> head[index]; curr_dl != 0;
-           curr_dl = dl_next(curr_dl)) {
-        if (curr_dl -> dl_hidden_link == GC_HIDE_POINTER(link)) {
-          curr_dl -> dl_hidden_obj = GC_HIDE_POINTER(obj);
-          UNLOCK();
-#         ifndef DBG_HDRS_ALL
-            /* Free unused new_dl returned by GC_oom_fn() */
-            GC_free((void *)new_dl);
-#         endif
-          return GC_DUPLICATE;
-        }
-      }
+    DL_CLIENT_UNLOCK(sh);
+    return res;
+}
+
+/* Register n links at once.  The shards are grown to fit all the new   */
+/* links (at most once per shard) before the links are inserted, then   */
+/* the insertion is done with the table locked just once.  The links    */
+/* which do not fit (e.g. because of concurrent registrations) are      */
+/* registered one by one.                                               */
+STATIC int GC_register_disappearing_links_inner(
+                        struct dl_hashtbl_s *dl_hashtbl, void **const *links,
+                        void *const *objs, size_t n,
+                        const char *tbl_log_name)
+{
+    size_t counts[DL_SHARDS];
+    size_t i;
+    int s;
+    DCL_LOCK_STATE;
+
+    GC_ASSERT(GC_is_initialized);
+    if (EXPECT(GC_find_leak, FALSE)) return GC_UNIMPLEMENTED;
+    BZERO(counts, sizeof(counts));
+    for (i = 0; i < n; i++) {
+      if (((word)links[i] & (ALIGNMENT-1)) != 0 || NULL == links[i])
+        ABORT("Bad arg to GC_register_disappearing_links");
+#     ifdef GC_ASSERTIONS
+        GC_noop1((word)(*links[i])); /* check accessibility */
+#     endif
+      GC_ASSERT(objs[i] != NULL && GC_base_C(objs[i]) == objs[i]);
+      counts[DL_HASH(links[i]) >> (CPP_WORDSZ - LOG_DL_SHARDS)]++;
+    }
+
+    LOCK();
+    for (s = 0; s < DL_SHARDS; s++) {
+      struct dl_shard_s *sh = DL_SHARD_AT(dl_hashtbl, s);
+      word needed = sh -> entries + (word)counts[s];
+      unsigned log_size = NULL == sh -> slots ? LOG_DL_MIN_SLOTS
+                                : sh -> log_size;
+
+      if (0 == counts[s]) continue;
+      while (needed > (((word)3 << log_size) >> 2))
+        log_size++;
+      if (EXPECT(!GC_grow_dl_shard_to(sh, log_size, tbl_log_name), FALSE))
+        break; /* the rest is handled below */
     }
-    new_dl -> dl_hidden_obj = GC_HIDE_POINTER(obj);
-    new_dl -> dl_hidden_link = GC_HIDE_POINTER(link);
-    dl_set_next(new_dl, dl_hashtbl -> head[index]);
-    GC_dirty(new_dl);
-    dl_hashtbl -> head[index] = new_dl;
-    dl_hashtbl -> entries++;
-    GC_dirty(dl_hashtbl->head + index);
+    GC_lock_dl_hashtbl(dl_hashtbl);
+    for (i = 0; i < n; i++) {
+      word h = DL_HASH(links[i]);
+
+      if (GC_dl_put(DL_SHARD_OF(dl_hashtbl, h), h,
+                    GC_HIDE_POINTER(links[i]),
+                    GC_HIDE_POINTER(objs[i])) == GC_NO_MEMORY)
+        break;
+    }
+    GC_unlock_dl_hashtbl(dl_hashtbl);
     UNLOCK();
+
+    for (; i < n; i++) {
+      if (GC_register_disappearing_link_inner(dl_hashtbl, links[i], objs[i],
+                                              tbl_log_name, FALSE)
+          == GC_NO_MEMORY)
+        return GC_NO_MEMORY;
+    }
     return GC_SUCCESS;
 }
 
@@ -235,59 +569,168 @@ GC_API int GC_CALL GC_general_register_disappearing_link(void * * link,
     if (((word)link & (ALIGNMENT-1)) != 0 || !NONNULL_ARG_NOT_NULL(link))
         ABORT("Bad arg to GC_general_register_disappearing_link");
     return GC_register_disappearing_link_inner(&GC_dl_hashtbl, link, obj,
-                                               "dl");
+                                               "dl", FALSE);
+}
+
+GC_API int GC_CALL GC_register_disappearing_links(void **const *links,
+                                                 void *const *objs, size_t n)
+{
+    return GC_register_disappearing_links_inner(&GC_dl_hashtbl, links, objs,
+                                                n, "dl");
+}
+
+/* Unregisters given link, returns 1 if it was registered.      */
+STATIC int GC_unregister_disappearing_link_inner(
+                                struct dl_hashtbl_s *dl_hashtbl, void **link)
+{
+    word h = DL_HASH(link);
+    struct dl_shard_s *sh = DL_SHARD_OF(dl_hashtbl, h);
+    size_t i;
+    DCL_LOCK_STATE;
+
+    if (((word)link & (ALIGNMENT-1)) != 0) return 0; /* Nothing to do. */
+
+    DL_CLIENT_LOCK(sh);
+    i = GC_dl_find(sh, h, GC_HIDE_POINTER(link));
+    if (i != DL_NOT_FOUND)
+      GC_dl_delete_at(sh, i);
+    DL_CLIENT_UNLOCK(sh);
+    return i != DL_NOT_FOUND;
+}
+
+GC_API int GC_CALL GC_unregister_disappearing_link(void * * link)
+{
+    return GC_unregister_disappearing_link_inner(&GC_dl_hashtbl, link);
+}
+
+STATIC size_t GC_unregister_disappearing_links_inner(
+                                struct dl_hashtbl_s *dl_hashtbl,
+                                void **const *links, size_t n)
+{
+    size_t i;
+    size_t cnt = 0;
+    DCL_LOCK_STATE;
+
+    LOCK();
+    GC_lock_dl_hashtbl(dl_hashtbl);
+    for (i = 0; i < n; i++) {
+      word h = DL_HASH(links[i]);
+      struct dl_shard_s *sh = DL_SHARD_OF(dl_hashtbl, h);
+      size_t j;
+
+      if (((word)links[i] & (ALIGNMENT-1)) != 0) continue;
+      j = GC_dl_find(sh, h, GC_HIDE_POINTER(links[i]));
+      if (j != DL_NOT_FOUND) {
+        GC_dl_delete_at(sh, j);
+        cnt++;
+      }
+    }
+    GC_unlock_dl_hashtbl(dl_hashtbl);
+    UNLOCK();
+    return cnt;
+}
+
+GC_API size_t GC_CALL GC_unregister_disappearing_links(void **const *links,
+                                                      size_t n)
+{
+    return GC_unregister_disappearing_links_inner(&GC_dl_hashtbl, links, n);
 }
 
-#ifdef DBG_HDRS_ALL
-# define FREE_DL_ENTRY(curr_dl) dl_set_next(curr_dl, NULL)
+#ifdef AO_HAVE_store
+# define SET_DL_QUEUE_SIZE(n) \
+                AO_store((volatile AO_t *)&GC_dl_queue_size, (AO_t)(n))
 #else
-# define FREE_DL_ENTRY(curr_dl) GC_free(curr_dl)
+# define SET_DL_QUEUE_SIZE(n) (void)(GC_dl_queue_size = (n))
 #endif
 
-/* Unregisters given link and returns the link entry to free.   */
-GC_INLINE struct disappearing_link *GC_unregister_disappearing_link_inner(
-                                struct dl_hashtbl_s *dl_hashtbl, void **link)
+/* Make room in the queue of the cleared links for all the links which */
+/* might be cleared by the next collection.  Failure is not fatal, the  */
+/* cleared links not fitting the queue wait in the table.               */
+STATIC void GC_reserve_dl_queue(void)
 {
-    struct disappearing_link *curr_dl;
-    struct disappearing_link *prev_dl = NULL;
-    size_t index;
+    word needed = GC_dl_queue_size + 1;
+    word new_capacity;
+    word *new_queue;
+    int s;
 
     GC_ASSERT(I_HOLD_LOCK());
-    if (EXPECT(NULL == dl_hashtbl -> head, FALSE)) return NULL;
-
-    index = HASH2(link, dl_hashtbl -> log_size);
-    for (curr_dl = dl_hashtbl -> head[index]; curr_dl;
-         curr_dl = dl_next(curr_dl)) {
-        if (curr_dl -> dl_hidden_link == GC_HIDE_POINTER(link)) {
-            /* Remove found entry from the table. */
-            if (NULL == prev_dl) {
-                dl_hashtbl -> head[index] = dl_next(curr_dl);
-                GC_dirty(dl_hashtbl->head + index);
-            } else {
-                dl_set_next(prev_dl, dl_next(curr_dl));
-                GC_dirty(prev_dl);
-            }
-            dl_hashtbl -> entries--;
-            break;
-        }
-        prev_dl = curr_dl;
-    }
-    return curr_dl;
+    for (s = 0; s < DL_SHARDS; s++)
+      needed += GC_dl_hashtbl.shards[s].s.notify_entries;
+    if (needed <= GC_dl_queue_capacity) return;
+
+    new_capacity = needed < 16 ? 32 : needed * 2;
+    new_queue = (word *)GC_INTERNAL_MALLOC_IGNORE_OFF_PAGE(
+                        (size_t)new_capacity * 2 * sizeof(word), NORMAL);
+    if (EXPECT(NULL == new_queue, FALSE)) return;
+    if (GC_dl_queue_size > 0)
+      BCOPY(GC_dl_queue, new_queue,
+            (size_t)GC_dl_queue_size * 2 * sizeof(word));
+    GC_dl_queue = new_queue;
+    GC_dl_queue_capacity = new_capacity;
+    GC_dirty(new_queue); /* entire object */
 }
 
-GC_API int GC_CALL GC_unregister_disappearing_link(void * * link)
+/* Put the cleared link to the queue.  Called by the collector (maybe   */
+/* by several marker threads at once).  The size of the queue could     */
+/* exceed its capacity temporarily.                                     */
+STATIC GC_bool GC_dl_enqueue(ptr_t base, word hidden_link)
+{
+    word k;
+
+#   ifdef PARALLEL_MARK
+      k = (word)AO_fetch_and_add1((volatile AO_t *)&GC_dl_queue_size);
+#   else
+      k = GC_dl_queue_size++;
+#   endif
+    if (k >= GC_dl_queue_capacity) return FALSE;
+    GC_dl_queue[2 * k] = (word)base;
+    GC_dl_queue[2 * k + 1] = hidden_link;
+    return TRUE;
+}
+
+GC_API int GC_CALL GC_register_disappearing_link_notify(void * * link,
+                                                        const void * obj)
 {
-    struct disappearing_link *curr_dl;
     DCL_LOCK_STATE;
 
-    if (((word)link & (ALIGNMENT-1)) != 0) return 0; /* Nothing to do. */
+    if (((word)link & (ALIGNMENT-1)) != 0 || !NONNULL_ARG_NOT_NULL(link))
+        ABORT("Bad arg to GC_register_disappearing_link_notify");
+    LOCK();
+    GC_reserve_dl_queue();
+    UNLOCK();
+    return GC_register_disappearing_link_inner(&GC_dl_hashtbl, link, obj,
+                                               "dl", TRUE);
+}
 
+GC_API size_t GC_CALL GC_drain_cleared_links(GC_cleared_link_proc fn,
+                                             void *client_data)
+{
+    word *queue;
+    size_t i, n;
+    DCL_LOCK_STATE;
+
+    GC_ASSERT(NONNULL_ARG_NOT_NULL(fn));
+#   ifdef AO_HAVE_load
+      if (0 == AO_load((volatile AO_t *)&GC_dl_queue_size)) return 0;
+#   else
+      if (0 == GC_dl_queue_size) return 0;
+#   endif
     LOCK();
-    curr_dl = GC_unregister_disappearing_link_inner(&GC_dl_hashtbl, link);
+    queue = GC_dl_queue;
+    n = (size_t)GC_dl_queue_size;
+    if (n > 0) {
+      /* Detach the queue (keeping it alive while the links are passed  */
+      /* to fn) and allocate an empty one of the same capacity.         */
+      GC_dl_queue = NULL;
+      GC_dl_queue_capacity = 0;
+      SET_DL_QUEUE_SIZE(0);
+      GC_reserve_dl_queue();
+    }
     UNLOCK();
-    if (NULL == curr_dl) return 0;
-    FREE_DL_ENTRY(curr_dl);
-    return 1;
+    for (i = 0; i < n; i++)
+      fn((void **)GC_REVEAL_POINTER(queue[2 * i + 1]), client_data);
+    GC_reachable_here(queue);
+    return n;
 }
 
 /* Mark from one finalizable object using the specified mark proc.      */
@@ -316,14 +759,95 @@ GC_INLINE void GC_complete_ongoing_collection(void) {
   typedef union toggle_ref_u GCToggleRef;
 
   STATIC GC_toggleref_func GC_toggleref_callback = 0;
+  STATIC GC_toggleref_batch_func GC_toggleref_batch_callback = 0;
 
-  GC_INNER void GC_process_togglerefs(void)
+  STATIC GC_bool GC_toggleref_dirty_only = FALSE;
+                        /* Revisit only the new entries and those       */
+                        /* passed to GC_toggleref_mark_dirty.           */
+
+  STATIC size_t GC_toggleref_processed = 0;
+                        /* The entries below this index have been       */
+                        /* passed to the callback at least once.        */
+
+  STATIC size_t GC_toggleref_holes = 0;
+                        /* The number of the weak entries cleared       */
+                        /* since the last GC_process_togglerefs call.   */
+
+# ifndef TOGGLEREF_BATCH_SIZE
+#   define TOGGLEREF_BATCH_SIZE 256
+# endif
+
+  /* Is obj in the dirty set?  */
+  STATIC GC_bool GC_toggleref_is_dirty(void *obj)
   {
+    size_t size = (size_t)1 << GC_log_toggleref_dirty_set_size;
     size_t i;
+    word hidden_obj = GC_HIDE_POINTER(obj);
+
+    for (i = HASH2(obj, GC_log_toggleref_dirty_set_size);
+         GC_toggleref_dirty_set[i] != 0; i = (i + 1) & (size - 1)) {
+      if (GC_toggleref_dirty_set[i] == hidden_obj)
+        return TRUE;
+    }
+    return FALSE;
+  }
+
+  /* Call the batched callback (or the per-entry one) for n objects of  */
+  /* the entries at the given indices, and store the new states of the  */
+  /* entries.  The dropped entries are set to zero.  Returns the number */
+  /* of the dropped entries.                                            */
+  STATIC size_t GC_toggleref_visit(void **objs, size_t *indices, size_t n,
+                                   GC_bool *needs_barrier)
+  {
+    GC_ToggleRefStatus status[TOGGLEREF_BATCH_SIZE];
+    size_t i;
+    size_t dropped = 0;
+
+    if (GC_toggleref_batch_callback != 0) {
+      GC_toggleref_batch_callback(objs, status, n);
+    } else {
+      for (i = 0; i < n; ++i)
+        status[i] = GC_toggleref_callback(objs[i]);
+    }
+    for (i = 0; i < n; ++i) {
+      GCToggleRef *r = &GC_toggleref_arr[indices[i]];
+
+      switch (status[i]) {
+      case GC_TOGGLE_REF_DROP:
+        r -> weak_ref = 0;
+        dropped++;
+        break;
+      case GC_TOGGLE_REF_STRONG:
+        r -> strong_ref = objs[i];
+        *needs_barrier = TRUE;
+        break;
+      case GC_TOGGLE_REF_WEAK:
+        r -> weak_ref = GC_HIDE_POINTER(objs[i]);
+        break;
+      default:
+        ABORT("Bad toggle-ref status returned by callback");
+      }
+    }
+    return dropped;
+  }
+
+  GC_INNER void GC_process_togglerefs(void)
+  {
+    void *objs[TOGGLEREF_BATCH_SIZE];
+    size_t indices[TOGGLEREF_BATCH_SIZE];
+    size_t i, n = 0;
     size_t new_size = 0;
+    size_t holes = GC_toggleref_holes;
+    GC_bool check_dirty = GC_toggleref_dirty_only
+                          && GC_toggleref_dirty_entries > 0;
     GC_bool needs_barrier = FALSE;
 
     GC_ASSERT(I_HOLD_LOCK());
+    if (GC_toggleref_dirty_only && !check_dirty && 0 == holes
+        && GC_toggleref_processed == GC_toggleref_array_size)
+      return; /* nothing has changed */
+
+    /* Pass the entries to the callback (by batches) in place.  */
     for (i = 0; i < GC_toggleref_array_size; ++i) {
       GCToggleRef r = GC_toggleref_arr[i];
       void *obj = r.strong_ref;
@@ -334,26 +858,41 @@ GC_INLINE void GC_complete_ongoing_collection(void) {
       if (NULL == obj) {
         continue;
       }
-      switch (GC_toggleref_callback(obj)) {
-      case GC_TOGGLE_REF_DROP:
-        break;
-      case GC_TOGGLE_REF_STRONG:
-        GC_toggleref_arr[new_size++].strong_ref = obj;
-        needs_barrier = TRUE;
-        break;
-      case GC_TOGGLE_REF_WEAK:
-        GC_toggleref_arr[new_size++].weak_ref = GC_HIDE_POINTER(obj);
-        break;
-      default:
-        ABORT("Bad toggle-ref status returned by callback");
+      if (GC_toggleref_dirty_only && i < GC_toggleref_processed
+          && (!check_dirty || !GC_toggleref_is_dirty(obj)))
+        continue;
+      objs[n] = obj;
+      indices[n] = i;
+      if (++n == TOGGLEREF_BATCH_SIZE) {
+        holes += GC_toggleref_visit(objs, indices, n, &needs_barrier);
+        n = 0;
       }
     }
-
-    if (new_size < GC_toggleref_array_size) {
+    if (n > 0)
+      holes += GC_toggleref_visit(objs, indices, n, &needs_barrier);
+
+    /* Remove the dropped and cleared entries.  */
+    if (holes > 0) {
+      for (i = 0; i < GC_toggleref_array_size; ++i) {
+        GCToggleRef r = GC_toggleref_arr[i];
+
+        if (0 == r.weak_ref) continue;
+        if (((word)r.strong_ref & 1) == 0)
+          needs_barrier = TRUE;
+        GC_toggleref_arr[new_size++] = r;
+      }
+      GC_ASSERT(GC_toggleref_array_size - new_size <= holes);
       BZERO(&GC_toggleref_arr[new_size],
             (GC_toggleref_array_size - new_size) * sizeof(GCToggleRef));
       GC_toggleref_array_size = new_size;
     }
+    GC_toggleref_processed = GC_toggleref_array_size;
+    GC_toggleref_holes = 0;
+    if (GC_toggleref_dirty_entries > 0) {
+      BZERO(GC_toggleref_dirty_set,
+            sizeof(word) << GC_log_toggleref_dirty_set_size);
+      GC_toggleref_dirty_entries = 0;
+    }
     if (needs_barrier)
       GC_dirty(GC_toggleref_arr); /* entire object */
   }
@@ -369,6 +908,8 @@ GC_INLINE void GC_complete_ongoing_collection(void) {
       return;
 
     GC_set_mark_bit(GC_toggleref_arr);
+    if (GC_toggleref_dirty_set != NULL)
+      GC_set_mark_bit(GC_base(GC_toggleref_dirty_set));
     for (i = 0; i < GC_toggleref_array_size; ++i) {
       void *obj = GC_toggleref_arr[i].strong_ref;
       if (obj != NULL && ((word)obj & 1) == 0) {
@@ -387,6 +928,7 @@ GC_INLINE void GC_complete_ongoing_collection(void) {
       if ((GC_toggleref_arr[i].weak_ref & 1) != 0) {
         if (!GC_is_marked(GC_REVEAL_POINTER(GC_toggleref_arr[i].weak_ref))) {
           GC_toggleref_arr[i].weak_ref = 0;
+          GC_toggleref_holes++;
         } else {
           /* No need to copy, BDWGC is a non-moving collector.    */
         }
@@ -414,6 +956,117 @@ GC_INLINE void GC_complete_ongoing_collection(void) {
     return fn;
   }
 
+  GC_API void GC_CALL GC_set_toggleref_batch_func(GC_toggleref_batch_func fn)
+  {
+    DCL_LOCK_STATE;
+
+    LOCK();
+    GC_toggleref_batch_callback = fn;
+    UNLOCK();
+  }
+
+  GC_API GC_toggleref_batch_func GC_CALL GC_get_toggleref_batch_func(void)
+  {
+    GC_toggleref_batch_func fn;
+    DCL_LOCK_STATE;
+
+    LOCK();
+    fn = GC_toggleref_batch_callback;
+    UNLOCK();
+    return fn;
+  }
+
+  GC_API void GC_CALL GC_set_toggleref_dirty_only(int value)
+  {
+    DCL_LOCK_STATE;
+
+    LOCK();
+    GC_toggleref_dirty_only = (GC_bool)value;
+    UNLOCK();
+  }
+
+  GC_API int GC_CALL GC_get_toggleref_dirty_only(void)
+  {
+    int value;
+    DCL_LOCK_STATE;
+
+    LOCK();
+    value = (int)GC_toggleref_dirty_only;
+    UNLOCK();
+    return value;
+  }
+
+  /* Double the size of the dirty set (or allocate the initial one).    */
+  static GC_bool grow_toggleref_dirty_set(void)
+  {
+    unsigned log_new_size = GC_toggleref_dirty_set != NULL
+                                ? GC_log_toggleref_dirty_set_size + 1
+                                : 6; /* initial size is 64 */
+    size_t new_size = (size_t)1 << log_new_size;
+    word *new_set;
+    size_t i;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    if (log_new_size >= sizeof(size_t) * 8 - 4)
+      return FALSE; /* overflow */
+    new_set = (word *)GC_INTERNAL_MALLOC_IGNORE_OFF_PAGE(
+                                new_size * sizeof(word), PTRFREE);
+    if (NULL == new_set)
+      return FALSE;
+    BZERO(new_set, new_size * sizeof(word));
+    /* The allocation above might collect and empty the old set.        */
+    if (GC_toggleref_dirty_set != NULL) {
+      size_t old_size = (size_t)1 << GC_log_toggleref_dirty_set_size;
+
+      for (i = 0; i < old_size; ++i) {
+        word hidden_obj = GC_toggleref_dirty_set[i];
+        size_t j;
+
+        if (0 == hidden_obj) continue;
+        for (j = HASH2(GC_REVEAL_POINTER(hidden_obj), log_new_size);
+             new_set[j] != 0; j = (j + 1) & (new_size - 1)) {
+          /* empty */
+        }
+        new_set[j] = hidden_obj;
+      }
+      GC_INTERNAL_FREE(GC_toggleref_dirty_set);
+    }
+    GC_toggleref_dirty_set = new_set;
+    GC_log_toggleref_dirty_set_size = log_new_size;
+    return TRUE;
+  }
+
+  GC_API int GC_CALL GC_toggleref_mark_dirty(void *obj)
+  {
+    int res = GC_SUCCESS;
+    word hidden_obj = GC_HIDE_POINTER(obj);
+    DCL_LOCK_STATE;
+
+    GC_ASSERT(NONNULL_ARG_NOT_NULL(obj));
+    LOCK();
+    if ((NULL == GC_toggleref_dirty_set
+         || (GC_toggleref_dirty_entries + 1) * 2
+            > (size_t)1 << GC_log_toggleref_dirty_set_size)
+        && !grow_toggleref_dirty_set()) {
+      res = GC_NO_MEMORY;
+    } else {
+      size_t size = (size_t)1 << GC_log_toggleref_dirty_set_size;
+      size_t i;
+
+      for (i = HASH2(obj, GC_log_toggleref_dirty_set_size);
+           GC_toggleref_dirty_set[i] != hidden_obj;
+           i = (i + 1) & (size - 1)) {
+        if (0 == GC_toggleref_dirty_set[i]) {
+          GC_toggleref_dirty_set[i] = hidden_obj;
+          GC_toggleref_dirty_entries++;
+          break;
+        }
+      }
+    }
+    UNLOCK();
+    return res;
+  }
+
   static GC_bool ensure_toggleref_capacity(size_t capacity_inc)
   {
     GC_ASSERT(I_HOLD_LOCK());
@@ -447,31 +1100,169 @@ GC_INLINE void GC_complete_ongoing_collection(void) {
       GC_INTERNAL_FREE(GC_toggleref_arr);
       GC_toggleref_arr = new_array;
     }
-    return TRUE;
+    return TRUE;
+  }
+
+  GC_API int GC_CALL GC_toggleref_add(void *obj, int is_strong_ref)
+  {
+    int res = GC_SUCCESS;
+    DCL_LOCK_STATE;
+
+    GC_ASSERT(NONNULL_ARG_NOT_NULL(obj));
+    LOCK();
+    if (GC_toggleref_callback != 0 || GC_toggleref_batch_callback != 0) {
+      if (!ensure_toggleref_capacity(1)) {
+        res = GC_NO_MEMORY;
+      } else {
+        GC_toggleref_arr[GC_toggleref_array_size].strong_ref =
+                        is_strong_ref ? obj : (void *)GC_HIDE_POINTER(obj);
+        if (is_strong_ref)
+          GC_dirty(GC_toggleref_arr + GC_toggleref_array_size);
+        GC_toggleref_array_size++;
+      }
+    }
+    UNLOCK();
+    return res;
+  }
+#endif /* !GC_TOGGLE_REFS_NOT_NEEDED */
+
+/* Ephemerons support.  */
+#ifndef GC_EPHEMERONS_NOT_NEEDED
+  /* The ephemeron object is allocated pointer-free, thus the key and   */
+  /* the value are not traced by the marker.                            */
+  struct ephemeron_s {
+    ptr_t key;          /* NULL once the ephemeron is cleared.          */
+    ptr_t value;
+  };
+
+  STATIC void GC_normal_finalize_mark_proc(ptr_t);
+
+  /* Mark the values of the reachable ephemerons with reachable keys    */
+  /* (repeating the pass while it marks anything new, as a value may    */
+  /* make other ephemerons or keys reachable), then clear the           */
+  /* ephemerons with unreachable keys, and forget the unreachable and   */
+  /* cleared ones.                                                      */
+  STATIC void GC_mark_ephemerons(void)
+  {
+    size_t i;
+    size_t new_size = 0;
+    GC_bool changed;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    if (NULL == GC_ephemeron_arr)
+      return;
+
+    GC_set_mark_bit(GC_base(GC_ephemeron_arr));
+    do {
+      changed = FALSE;
+      for (i = 0; i < GC_ephemeron_array_size; ++i) {
+        struct ephemeron_s *eph = (struct ephemeron_s *)
+                                GC_REVEAL_POINTER(GC_ephemeron_arr[i]);
+        ptr_t value = eph -> value;
+
+        if (value != NULL && !GC_is_marked(value) && GC_is_marked(eph)
+            && eph -> key != NULL && GC_is_marked(eph -> key)) {
+          GC_mark_fo(value, GC_normal_finalize_mark_proc);
+          GC_set_mark_bit(value);
+          GC_complete_ongoing_collection();
+          changed = TRUE;
+        }
+      }
+    } while (changed);
+
+    for (i = 0; i < GC_ephemeron_array_size; ++i) {
+      struct ephemeron_s *eph = (struct ephemeron_s *)
+                                GC_REVEAL_POINTER(GC_ephemeron_arr[i]);
+
+      if (!GC_is_marked(eph) || NULL == eph -> key)
+        continue;
+      if (!GC_is_marked(eph -> key)) {
+        eph -> key = NULL;
+        eph -> value = NULL;
+        continue;
+      }
+      GC_ephemeron_arr[new_size++] = GC_ephemeron_arr[i];
+    }
+    GC_ephemeron_array_size = new_size;
+  }
+
+  static GC_bool ensure_ephemeron_capacity(void)
+  {
+    size_t new_capacity;
+    word *new_array;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    if (GC_ephemeron_array_size < GC_ephemeron_array_capacity)
+      return TRUE;
+
+    new_capacity = GC_ephemeron_array_capacity > 0
+                    ? GC_ephemeron_array_capacity * 2
+                    : 32; /* initial capacity */
+    if (new_capacity > GC_SIZE_MAX / sizeof(word))
+      return FALSE; /* overflow */
+    new_array = (word *)GC_INTERNAL_MALLOC_IGNORE_OFF_PAGE(
+                                new_capacity * sizeof(word), PTRFREE);
+    if (NULL == new_array)
+      return FALSE;
+    /* The allocation above might collect and shrink the array. */
+    if (EXPECT(GC_ephemeron_array_size > 0, TRUE))
+      BCOPY(GC_ephemeron_arr, new_array,
+            GC_ephemeron_array_size * sizeof(word));
+    if (GC_ephemeron_arr != NULL)
+      GC_INTERNAL_FREE(GC_ephemeron_arr);
+    GC_ephemeron_arr = new_array;
+    GC_ephemeron_array_capacity = new_capacity;
+    return TRUE;
+  }
+
+  GC_API GC_ATTR_MALLOC void * GC_CALL GC_new_ephemeron(const void *key,
+                                                        const void *value)
+  {
+    struct ephemeron_s *eph;
+    DCL_LOCK_STATE;
+
+    if ((key != NULL && GC_base((void *)key) != key)
+        || (value != NULL && GC_base((void *)value) != value))
+      ABORT("Bad arg to GC_new_ephemeron");
+    eph = (struct ephemeron_s *)GC_malloc_kind(sizeof(struct ephemeron_s),
+                                               PTRFREE);
+    if (NULL == eph)
+      return NULL;
+    eph -> key = (ptr_t)key;
+    eph -> value = (ptr_t)value;
+
+    LOCK();
+    if (!ensure_ephemeron_capacity()) {
+      UNLOCK();
+      return NULL;
+    }
+    GC_ephemeron_arr[GC_ephemeron_array_size++] = GC_HIDE_POINTER(eph);
+    UNLOCK();
+    return eph;
   }
 
-  GC_API int GC_CALL GC_toggleref_add(void *obj, int is_strong_ref)
+  GC_API void * GC_CALL GC_ephemeron_get_key(const void *eph)
   {
-    int res = GC_SUCCESS;
+    void *key;
     DCL_LOCK_STATE;
 
-    GC_ASSERT(NONNULL_ARG_NOT_NULL(obj));
     LOCK();
-    if (GC_toggleref_callback != 0) {
-      if (!ensure_toggleref_capacity(1)) {
-        res = GC_NO_MEMORY;
-      } else {
-        GC_toggleref_arr[GC_toggleref_array_size].strong_ref =
-                        is_strong_ref ? obj : (void *)GC_HIDE_POINTER(obj);
-        if (is_strong_ref)
-          GC_dirty(GC_toggleref_arr + GC_toggleref_array_size);
-        GC_toggleref_array_size++;
-      }
-    }
+    key = ((const struct ephemeron_s *)eph) -> key;
     UNLOCK();
-    return res;
+    return key;
   }
-#endif /* !GC_TOGGLE_REFS_NOT_NEEDED */
+
+  GC_API void * GC_CALL GC_ephemeron_get_value(const void *eph)
+  {
+    void *value;
+    DCL_LOCK_STATE;
+
+    LOCK();
+    value = ((const struct ephemeron_s *)eph) -> value;
+    UNLOCK();
+    return value;
+  }
+#endif /* !GC_EPHEMERONS_NOT_NEEDED */
 
 /* Finalizer callback support. */
 STATIC GC_await_finalize_proc GC_object_finalized_proc = 0;
@@ -502,115 +1293,301 @@ GC_API GC_await_finalize_proc GC_CALL GC_get_await_finalize_proc(void)
     if (((word)link & (ALIGNMENT-1)) != 0 || !NONNULL_ARG_NOT_NULL(link))
         ABORT("Bad arg to GC_register_long_link");
     return GC_register_disappearing_link_inner(&GC_ll_hashtbl, link, obj,
-                                               "long dl");
+                                               "long dl", FALSE);
   }
 
   GC_API int GC_CALL GC_unregister_long_link(void * * link)
   {
-    struct disappearing_link *curr_dl;
-    DCL_LOCK_STATE;
+    return GC_unregister_disappearing_link_inner(&GC_ll_hashtbl, link);
+  }
 
-    if (((word)link & (ALIGNMENT-1)) != 0) return 0; /* Nothing to do. */
+  GC_API int GC_CALL GC_register_long_links(void **const *links,
+                                            void *const *objs, size_t n)
+  {
+    return GC_register_disappearing_links_inner(&GC_ll_hashtbl, links, objs,
+                                                n, "long dl");
+  }
 
-    LOCK();
-    curr_dl = GC_unregister_disappearing_link_inner(&GC_ll_hashtbl, link);
-    UNLOCK();
-    if (NULL == curr_dl) return 0;
-    FREE_DL_ENTRY(curr_dl);
-    return 1;
+  GC_API size_t GC_CALL GC_unregister_long_links(void **const *links,
+                                                 size_t n)
+  {
+    return GC_unregister_disappearing_links_inner(&GC_ll_hashtbl, links, n);
   }
 #endif /* !GC_LONG_REFS_NOT_NEEDED */
 
+#ifndef GC_MOVABLE_NOT_NEEDED
+  STATIC unsigned GC_movable_kind = 0;
+                        /* Valid once GC_movable_kind_initialized.      */
+
+# if defined(AO_HAVE_load_acquire) && defined(AO_HAVE_store_release)
+    STATIC volatile AO_t GC_movable_kind_initialized = FALSE;
+# else
+    STATIC GC_bool GC_movable_kind_initialized = FALSE;
+# endif
+
+  STATIC unsigned GC_evacuation_threshold = 0;
+                        /* In percents of HBLKSIZE; 0 means off.        */
+
+  GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc_movable(size_t lb)
+  {
+    DCL_LOCK_STATE;
+
+    if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+#   if defined(AO_HAVE_load_acquire) && defined(AO_HAVE_store_release)
+      if (!EXPECT(AO_load_acquire(&GC_movable_kind_initialized), TRUE)) {
+        LOCK();
+        if (!GC_movable_kind_initialized) {
+          GC_movable_kind = GC_new_kind_inner(GC_new_free_list_inner(),
+                                    0 | GC_DS_LENGTH, FALSE, FALSE);
+          AO_store_release(&GC_movable_kind_initialized, TRUE);
+        }
+        UNLOCK();
+      }
+#   else
+      LOCK();
+      if (!EXPECT(GC_movable_kind_initialized, TRUE)) {
+        GC_movable_kind = GC_new_kind_inner(GC_new_free_list_inner(),
+                                    0 | GC_DS_LENGTH, FALSE, FALSE);
+        GC_movable_kind_initialized = TRUE;
+      }
+      UNLOCK();
+#   endif
+    return GC_malloc_kind(lb, (int)GC_movable_kind);
+  }
+
+  GC_API int GC_CALL GC_register_movable_handle(void * * handle)
+  {
+    if (((word)handle & (ALIGNMENT-1)) != 0 || !NONNULL_ARG_NOT_NULL(handle)
+        || NULL == *handle)
+        ABORT("Bad arg to GC_register_movable_handle");
+    return GC_register_disappearing_link_inner(&GC_mh_hashtbl, handle,
+                                               *handle, "movable handle",
+                                               FALSE);
+  }
+
+  GC_API int GC_CALL GC_unregister_movable_handle(void * * handle)
+  {
+    return GC_unregister_disappearing_link_inner(&GC_mh_hashtbl, handle);
+  }
+
+  GC_API void GC_CALL GC_set_evacuation_threshold(unsigned percent)
+  {
+    GC_ASSERT(percent <= 100);
+    GC_evacuation_threshold = percent;
+  }
+
+  GC_API unsigned GC_CALL GC_get_evacuation_threshold(void)
+  {
+    return GC_evacuation_threshold;
+  }
+
+  /* The block currently being filled with the evacuated objects (and   */
+  /* the offset of its first unused object) per size in granules.       */
+  /* Cleared at the end of each evacuation pass.                        */
+  STATIC struct hblk *GC_evac_dest[MAXOBJGRANULES + 1];
+  STATIC word GC_evac_dest_ofs[MAXOBJGRANULES + 1];
+
+# ifdef PARALLEL_MARK
+    /* Check whether no object in the block is marked.  Used instead of */
+    /* hb_n_marks which is never decremented to zero by                 */
+    /* GC_clear_mark_bit if the parallel marker is on.                  */
+    STATIC GC_bool GC_block_marks_clear(hdr *hhdr)
+    {
+      word sz = hhdr -> hb_sz;
+      word ofs;
+
+      for (ofs = 0; ofs + sz <= HBLKSIZE; ofs += sz) {
+        if (mark_bit_from_hdr(hhdr, MARK_BIT_NO(ofs, sz))) return FALSE;
+      }
+      return TRUE;
+    }
+# endif
+
+  /* Copy the marked object p (of the movable kind) to the destination  */
+  /* block of the same size, allocating a new block if needed.  The old */
+  /* copy is unmarked and gets the forwarding address in its first      */
+  /* word.  Returns the new address, or NULL if there is no free block. */
+  STATIC ptr_t GC_evacuate_object(ptr_t p, hdr *hhdr)
+  {
+    word sz = hhdr -> hb_sz;
+    size_t granules = (size_t)BYTES_TO_GRANULES(sz);
+    struct hblk *h = GC_evac_dest[granules];
+    ptr_t q;
+
+    if (NULL == h || GC_evac_dest_ofs[granules] + sz > HBLKSIZE) {
+      h = GC_allochblk((size_t)sz, (int)GC_movable_kind, 0 /* flags */);
+      if (NULL == h) return NULL;
+      GC_evac_dest[granules] = h;
+      GC_evac_dest_ofs[granules] = 0;
+    }
+    q = (ptr_t)h + GC_evac_dest_ofs[granules];
+    GC_evac_dest_ofs[granules] += sz;
+    BCOPY(p, q, sz);
+    GC_set_mark_bit(q);
+    GC_clear_mark_bit(p);
+#   ifdef PARALLEL_MARK
+      if (hhdr -> hb_n_marks <= 1 && GC_block_marks_clear(hhdr))
+        hhdr -> hb_n_marks = 0; /* let GC_reclaim_block free it */
+#   endif
+    *(ptr_t *)p = q;
+    return q;
+  }
+
+  GC_INNER void GC_evacuate_movable(void)
+  {
+    int s;
+    word threshold = HBLKSIZE * (word)GC_evacuation_threshold / 100;
+    word moved_bytes = 0;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    if (0 == threshold || 0 == GC_dl_entries(&GC_mh_hashtbl)) return;
+
+    /* Move the objects with the world stopped, so that no mutator      */
+    /* could observe a handle or an object being updated.  The shard    */
+    /* locks are acquired before, as a stopped thread might hold one.   */
+    GC_lock_dl_hashtbl(&GC_mh_hashtbl);
+    STOP_WORLD();
+    for (s = 0; s < DL_SHARDS; s++) {
+      struct dl_shard_s *sh = DL_SHARD_AT(&GC_mh_hashtbl, s);
+      size_t i;
+      size_t dl_size = NULL == sh -> slots ? 0 : (size_t)1 << sh -> log_size;
+
+      for (i = 0; i < dl_size; i++) {
+        word hidden_handle = dl_slot_link(sh -> slots, i);
+        ptr_t p = (ptr_t)GC_REVEAL_POINTER(dl_slot_obj(sh -> slots, i));
+        void **handle = (void **)GC_REVEAL_POINTER(hidden_handle);
+        hdr *hhdr;
+        ptr_t q;
+
+        if (0 == hidden_handle) continue; /* empty slot */
+        hhdr = HDR(p);
+        if (hhdr -> hb_obj_kind != GC_movable_kind
+            || hhdr -> hb_sz > MAXOBJBYTES
+            || (hhdr -> hb_flags & FROZEN_BLK) != 0)
+          continue; /* not movable, or alone in its block anyway */
+        if (GC_is_marked(p)) {
+          if (hhdr -> hb_sz * hhdr -> hb_n_marks >= threshold)
+            continue; /* the block is not sparse */
+          q = GC_evacuate_object(p, hhdr);
+          if (NULL == q) goto out; /* no free blocks to move to */
+          moved_bytes += hhdr -> hb_sz;
+        } else {
+          /* Already moved when processing another handle to it;  all  */
+          /* the objects of the table are marked by GC_finalize.        */
+          q = *(ptr_t *)p;
+        }
+        *handle = q;
+        GC_dirty(handle);
+        dl_slot_obj(sh -> slots, i) = GC_HIDE_POINTER(q);
+      }
+    }
+  out:
+    START_WORLD();
+    GC_unlock_dl_hashtbl(&GC_mh_hashtbl);
+    BZERO(GC_evac_dest, sizeof(GC_evac_dest));
+    if (moved_bytes > 0) {
+      GC_COND_LOG_PRINTF("Evacuated %lu bytes of movable objects\n",
+                         (unsigned long)moved_bytes);
+    }
+  }
+#endif /* !GC_MOVABLE_NOT_NEEDED */
+
 #ifndef GC_MOVE_DISAPPEARING_LINK_NOT_NEEDED
   STATIC int GC_move_disappearing_link_inner(
                                 struct dl_hashtbl_s *dl_hashtbl,
                                 void **link, void **new_link)
   {
-    struct disappearing_link *curr_dl, *new_dl;
-    struct disappearing_link *prev_dl = NULL;
-    size_t curr_index, new_index;
-    word curr_hidden_link, new_hidden_link;
+    word curr_h = DL_HASH(link);
+    word new_h = DL_HASH(new_link);
+    struct dl_shard_s *curr_sh = DL_SHARD_OF(dl_hashtbl, curr_h);
+    struct dl_shard_s *new_sh = DL_SHARD_OF(dl_hashtbl, new_h);
+    word new_hidden_link = GC_HIDE_POINTER(new_link);
+    size_t curr_index;
+    int result;
+    DCL_LOCK_STATE;
 
 #   ifdef GC_ASSERTIONS
       GC_noop1((word)(*new_link));
 #   endif
-    GC_ASSERT(I_HOLD_LOCK());
-    if (EXPECT(NULL == dl_hashtbl -> head, FALSE)) return GC_NOT_FOUND;
-
-    /* Find current link.       */
-    curr_index = HASH2(link, dl_hashtbl -> log_size);
-    curr_hidden_link = GC_HIDE_POINTER(link);
-    for (curr_dl = dl_hashtbl -> head[curr_index]; curr_dl;
-         curr_dl = dl_next(curr_dl)) {
-      if (curr_dl -> dl_hidden_link == curr_hidden_link)
+    for (;;) {
+      /* Lock both shards in the address order.     */
+#     ifdef DL_SHARD_LOCKS
+        if ((word)curr_sh <= (word)new_sh) {
+          DL_SHARD_LOCK(curr_sh);
+          if (new_sh != curr_sh) DL_SHARD_LOCK(new_sh);
+        } else {
+          DL_SHARD_LOCK(new_sh);
+          DL_SHARD_LOCK(curr_sh);
+        }
+#     else
+        LOCK();
+#     endif
+
+      curr_index = GC_dl_find(curr_sh, curr_h, GC_HIDE_POINTER(link));
+      if (EXPECT(DL_NOT_FOUND == curr_index, FALSE)) {
+        result = GC_NOT_FOUND;
+        break;
+      } else if (link == new_link) {
+        result = GC_SUCCESS; /* Nothing to do.      */
         break;
-      prev_dl = curr_dl;
-    }
-    if (EXPECT(NULL == curr_dl, FALSE)) {
-      return GC_NOT_FOUND;
-    } else if (link == new_link) {
-      return GC_SUCCESS; /* Nothing to do.      */
-    }
-
-    /* link found; now check new_link not present.      */
-    new_index = HASH2(new_link, dl_hashtbl -> log_size);
-    new_hidden_link = GC_HIDE_POINTER(new_link);
-    for (new_dl = dl_hashtbl -> head[new_index]; new_dl;
-         new_dl = dl_next(new_dl)) {
-      if (new_dl -> dl_hidden_link == new_hidden_link) {
-        /* Target already registered; bail.     */
-        return GC_DUPLICATE;
       }
+      /* link found; now check new_link not present.  */
+      if (GC_dl_find(new_sh, new_h, new_hidden_link) != DL_NOT_FOUND) {
+        result = GC_DUPLICATE; /* Target already registered; bail. */
+        break;
+      }
+
+      if (EXPECT(new_sh == curr_sh || DL_HAS_ROOM(new_sh), TRUE)) {
+        /* Remove from old, add to new.   */
+        word hidden_obj = dl_slot_obj(curr_sh -> slots, curr_index);
+
+        GC_dl_delete_at(curr_sh, curr_index);
+        GC_dl_insert(new_sh, new_h, new_hidden_link, hidden_obj);
+        result = GC_SUCCESS;
+        break;
+      }
+
+      /* Grow the target shard, and retry.  */
+#     ifdef DL_SHARD_LOCKS
+        DL_SHARD_UNLOCK(curr_sh);
+#     endif
+      if (EXPECT(!GC_grow_dl_shard(new_sh, "moved dl"), FALSE)) {
+        DL_CLIENT_UNLOCK(new_sh);
+        return GC_NO_MEMORY;
+      }
+      DL_CLIENT_UNLOCK(new_sh);
     }
 
-    /* Remove from old, add to new, update link.        */
-    if (NULL == prev_dl) {
-      dl_hashtbl -> head[curr_index] = dl_next(curr_dl);
-    } else {
-      dl_set_next(prev_dl, dl_next(curr_dl));
-      GC_dirty(prev_dl);
-    }
-    curr_dl -> dl_hidden_link = new_hidden_link;
-    dl_set_next(curr_dl, dl_hashtbl -> head[new_index]);
-    dl_hashtbl -> head[new_index] = curr_dl;
-    GC_dirty(curr_dl);
-    GC_dirty(dl_hashtbl->head); /* entire object */
-    return GC_SUCCESS;
+#   ifdef DL_SHARD_LOCKS
+      if (new_sh != curr_sh) DL_SHARD_UNLOCK(new_sh);
+      DL_SHARD_UNLOCK(curr_sh);
+#   else
+      UNLOCK();
+#   endif
+    return result;
   }
 
   GC_API int GC_CALL GC_move_disappearing_link(void **link, void **new_link)
   {
-    int result;
-    DCL_LOCK_STATE;
-
     if (((word)new_link & (ALIGNMENT-1)) != 0
         || !NONNULL_ARG_NOT_NULL(new_link))
       ABORT("Bad new_link arg to GC_move_disappearing_link");
     if (((word)link & (ALIGNMENT-1)) != 0)
       return GC_NOT_FOUND; /* Nothing to do. */
 
-    LOCK();
-    result = GC_move_disappearing_link_inner(&GC_dl_hashtbl, link, new_link);
-    UNLOCK();
-    return result;
+    return GC_move_disappearing_link_inner(&GC_dl_hashtbl, link, new_link);
   }
 
 # ifndef GC_LONG_REFS_NOT_NEEDED
     GC_API int GC_CALL GC_move_long_link(void **link, void **new_link)
     {
-      int result;
-      DCL_LOCK_STATE;
-
       if (((word)new_link & (ALIGNMENT-1)) != 0
           || !NONNULL_ARG_NOT_NULL(new_link))
         ABORT("Bad new_link arg to GC_move_long_link");
       if (((word)link & (ALIGNMENT-1)) != 0)
         return GC_NOT_FOUND; /* Nothing to do. */
 
-      LOCK();
-      result = GC_move_disappearing_link_inner(&GC_ll_hashtbl, link, new_link);
-      UNLOCK();
-      return result;
+      return GC_move_disappearing_link_inner(&GC_ll_hashtbl, link, new_link);
     }
 # endif /* !GC_LONG_REFS_NOT_NEEDED */
 #endif /* !GC_MOVE_DISAPPEARING_LINK_NOT_NEEDED */
@@ -672,6 +1649,40 @@ STATIC void GC_unreachable_finalize_mark_proc(ptr_t p)
     GC_normal_finalize_mark_proc(p);
 }
 
+/* Is the young entries array too small to be trusted?  */
+STATIC GC_bool GC_young_fo_overflow = FALSE;
+
+/* Make room for one more entry in GC_young_fo_arr, if possible.        */
+static void ensure_young_fo_capacity(void)
+{
+    size_t new_capacity;
+    word *new_array;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    if (GC_young_fo_size < GC_young_fo_capacity || GC_young_fo_overflow)
+      return;
+
+    new_capacity = GC_young_fo_capacity > 0 ? GC_young_fo_capacity * 2
+                                            : 64; /* initial capacity */
+    if (new_capacity > GC_SIZE_MAX / sizeof(word)) {
+      GC_young_fo_overflow = TRUE;
+      return;
+    }
+    new_array = (word *)GC_INTERNAL_MALLOC_IGNORE_OFF_PAGE(
+                                new_capacity * sizeof(word), PTRFREE);
+    if (NULL == new_array) {
+      GC_young_fo_overflow = TRUE;
+      return;
+    }
+    /* The allocation above might collect and empty the array.  */
+    if (GC_young_fo_size > 0)
+      BCOPY(GC_young_fo_arr, new_array, GC_young_fo_size * sizeof(word));
+    if (GC_young_fo_arr != NULL)
+      GC_INTERNAL_FREE(GC_young_fo_arr);
+    GC_young_fo_arr = new_array;
+    GC_young_fo_capacity = new_capacity;
+}
+
 /* Register a finalization function.  See gc.h for details.     */
 /* The last parameter is a procedure that determines            */
 /* marking for finalization ordering.  Any objects marked       */
@@ -702,6 +1713,8 @@ STATIC void GC_register_finalizer_inner(void * obj,
         GC_COND_LOG_PRINTF("Grew fo table to %u entries\n",
                            1U << GC_log_fo_table_size);
     }
+    if (fn != 0)
+      ensure_young_fo_capacity();
     for (;;) {
       struct finalizable_object *prev_fo = NULL;
       GC_oom_func oom_fn;
@@ -809,6 +1822,11 @@ STATIC void GC_register_finalizer_inner(void * obj,
     GC_fo_entries++;
     GC_fnlz_roots.fo_head[index] = new_fo;
     GC_dirty(GC_fnlz_roots.fo_head + index);
+    if (GC_young_fo_size < GC_young_fo_capacity) {
+      GC_young_fo_arr[GC_young_fo_size++] = GC_HIDE_POINTER(obj);
+    } else {
+      GC_young_fo_overflow = TRUE;
+    }
     UNLOCK();
 }
 
@@ -850,22 +1868,21 @@ GC_API void GC_CALL GC_register_finalizer_unreachable(void * obj,
 }
 
 #ifndef NO_DEBUGGING
-  STATIC void GC_dump_finalization_links(
-                                const struct dl_hashtbl_s *dl_hashtbl)
+  STATIC void GC_dump_finalization_links(struct dl_hashtbl_s *dl_hashtbl)
   {
-    size_t dl_size = (size_t)1 << dl_hashtbl -> log_size;
-    size_t i;
+    int s;
 
-    if (NULL == dl_hashtbl -> head) return; /* empty table  */
+    for (s = 0; s < DL_SHARDS; s++) {
+      struct dl_shard_s *sh = DL_SHARD_AT(dl_hashtbl, s);
+      size_t dl_size = NULL == sh -> slots ? 0 : (size_t)1 << sh -> log_size;
+      size_t i;
 
-    for (i = 0; i < dl_size; i++) {
-      struct disappearing_link *curr_dl;
-
-      for (curr_dl = dl_hashtbl -> head[i]; curr_dl != 0;
-           curr_dl = dl_next(curr_dl)) {
-        ptr_t real_ptr = (ptr_t)GC_REVEAL_POINTER(curr_dl->dl_hidden_obj);
-        ptr_t real_link = (ptr_t)GC_REVEAL_POINTER(curr_dl->dl_hidden_link);
+      for (i = 0; i < dl_size; i++) {
+        ptr_t real_ptr, real_link;
 
+        if (0 == dl_slot_link(sh -> slots, i)) continue;
+        real_ptr = DL_REVEAL_OBJ(dl_slot_obj(sh -> slots, i));
+        real_link = (ptr_t)GC_REVEAL_POINTER(dl_slot_link(sh -> slots, i));
         GC_printf("Object: %p, link value: %p, link addr: %p\n",
                   (void *)real_ptr, *(void **)real_link, (void *)real_link);
       }
@@ -884,6 +1901,10 @@ GC_API void GC_CALL GC_register_finalizer_unreachable(void * obj,
 #   ifndef GC_LONG_REFS_NOT_NEEDED
       GC_printf("\n***Disappearing long links:\n");
       GC_dump_finalization_links(&GC_ll_hashtbl);
+#   endif
+#   ifndef GC_MOVABLE_NOT_NEEDED
+      GC_printf("\n***Movable object handles:\n");
+      GC_dump_finalization_links(&GC_mh_hashtbl);
 #   endif
     GC_printf("\n***Finalizers:\n");
     for (i = 0; i < fo_size; i++) {
@@ -932,150 +1953,324 @@ GC_API void GC_CALL GC_register_finalizer_unreachable(void * obj,
   }
 #endif /* !THREADS */
 
-GC_INLINE void GC_make_disappearing_links_disappear(
-                                        struct dl_hashtbl_s* dl_hashtbl,
-                                        GC_bool is_remove_dangling)
+/* Clear the links (or remove the dangling ones) of a single shard.     */
+/* The caller holds the shard lock (as part of the whole table).        */
+STATIC void GC_make_shard_links_disappear(struct dl_shard_s *sh,
+                                          GC_bool is_remove_dangling)
 {
-  size_t i;
-  size_t dl_size = (size_t)1 << dl_hashtbl -> log_size;
-  GC_bool needs_barrier = FALSE;
-
-  GC_ASSERT(I_HOLD_LOCK());
-  if (NULL == dl_hashtbl -> head) return; /* empty table  */
+    size_t dl_size = NULL == sh -> slots ? 0 : (size_t)1 << sh -> log_size;
+    size_t i = 0;
 
-  for (i = 0; i < dl_size; i++) {
-    struct disappearing_link *curr_dl, *next_dl;
-    struct disappearing_link *prev_dl = NULL;
+    while (i < dl_size) {
+      word hidden_link = dl_slot_link(sh -> slots, i);
 
-    for (curr_dl = dl_hashtbl->head[i]; curr_dl != NULL; curr_dl = next_dl) {
-      next_dl = dl_next(curr_dl);
+      if (0 == hidden_link) {
+        i++;
+        continue;
+      }
 #     if defined(GC_ASSERTIONS) && !defined(THREAD_SANITIZER)
          /* Check accessibility of the location pointed by link. */
-        GC_noop1(*(word *)GC_REVEAL_POINTER(curr_dl->dl_hidden_link));
+        GC_noop1(*(word *)GC_REVEAL_POINTER(hidden_link));
 #     endif
       if (is_remove_dangling) {
-        ptr_t real_link = (ptr_t)GC_base(GC_REVEAL_POINTER(
-                                                curr_dl->dl_hidden_link));
+        ptr_t real_link = (ptr_t)GC_base(GC_REVEAL_POINTER(hidden_link));
 
         if (NULL == real_link || EXPECT(GC_is_marked(real_link), TRUE)) {
-          prev_dl = curr_dl;
-          continue;
+          /* A live cleared link is deleted once queued.    */
+          if (EXPECT(dl_slot_obj(sh -> slots, i) != DL_NOTIFY_CLEARED,
+                     TRUE)
+              || !GC_dl_enqueue(real_link, hidden_link)) {
+            i++;
+            continue;
+          }
         }
       } else {
-        if (EXPECT(GC_is_marked((ptr_t)GC_REVEAL_POINTER(
-                                        curr_dl->dl_hidden_obj)), TRUE)) {
-          prev_dl = curr_dl;
+        word hidden_obj = dl_slot_obj(sh -> slots, i);
+
+        if (EXPECT(hidden_obj == DL_NOTIFY_CLEARED
+                   || GC_is_marked(DL_REVEAL_OBJ(hidden_obj)), TRUE)) {
+          i++;
+          continue;
+        }
+        *(ptr_t *)GC_REVEAL_POINTER(hidden_link) = NULL;
+        if (DL_IS_NOTIFY(hidden_obj)) {
+          /* Whether to queue the link is decided once the objects      */
+          /* reachable from the finalizable ones are marked.            */
+          dl_slot_obj(sh -> slots, i) = DL_NOTIFY_CLEARED;
+          i++;
           continue;
         }
-        *(ptr_t *)GC_REVEAL_POINTER(curr_dl->dl_hidden_link) = NULL;
       }
 
-      /* Delete curr_dl entry from dl_hashtbl.  */
-      if (NULL == prev_dl) {
-        dl_hashtbl -> head[i] = next_dl;
-        needs_barrier = TRUE;
-      } else {
-        dl_set_next(prev_dl, next_dl);
-        GC_dirty(prev_dl);
-      }
-      GC_clear_mark_bit(curr_dl);
-      dl_hashtbl -> entries--;
+      /* Delete the entry; the slot is examined again as another    */
+      /* entry might be shifted to it.                              */
+      GC_dl_delete_at(sh, i);
+    }
+}
+
+#ifdef PARALLEL_MARK
+  /* The minimum number of entries of a disappearing links table, or    */
+  /* of finalizable objects, to process them using the marker threads.  */
+# ifndef PARALLEL_FINALIZE_MIN_ENTRIES
+#   define PARALLEL_FINALIZE_MIN_ENTRIES 4096
+# endif
+
+  STATIC struct dl_hashtbl_s *GC_par_dl_hashtbl = NULL;
+  STATIC GC_bool GC_par_dl_remove_dangling = FALSE;
+  STATIC unsigned GC_next_dl_shard = 0;
+                        /* Index of the next shard to be processed by   */
+                        /* a helper.  Protected by mark lock.           */
+
+  /* Process the shards of GC_par_dl_hashtbl claimed one by one until   */
+  /* there are none left.  The shards are independent, and the links    */
+  /* of distinct entries are distinct, so no other synchronization is   */
+  /* needed.                                                            */
+  STATIC void GC_make_links_disappear_task(unsigned id, mse *local_mark_stack)
+  {
+    UNUSED_ARG(id);
+    UNUSED_ARG(local_mark_stack);
+    for (;;) {
+      unsigned s;
+
+      GC_acquire_mark_lock();
+      s = GC_next_dl_shard++;
+      GC_release_mark_lock();
+      if (s >= DL_SHARDS) break;
+      GC_make_shard_links_disappear(DL_SHARD_AT(GC_par_dl_hashtbl, s),
+                                    GC_par_dl_remove_dangling);
     }
   }
-  if (needs_barrier)
-    GC_dirty(dl_hashtbl -> head); /* entire object */
+#endif /* PARALLEL_MARK */
+
+GC_INLINE void GC_make_disappearing_links_disappear(
+                                        struct dl_hashtbl_s* dl_hashtbl,
+                                        GC_bool is_remove_dangling)
+{
+  int s;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  GC_lock_dl_hashtbl(dl_hashtbl);
+# ifdef PARALLEL_MARK
+    /* The marker threads cannot handle the write faults, so the links */
+    /* (and the slots) are not updated by them if the heap pages might  */
+    /* be protected.                                                    */
+    if (GC_parallel && (!GC_auto_incremental
+                || GC_incremental_protection_needs() == GC_PROTECTS_NONE)
+        && GC_dl_entries(dl_hashtbl) >= PARALLEL_FINALIZE_MIN_ENTRIES) {
+      GC_par_dl_hashtbl = dl_hashtbl;
+      GC_par_dl_remove_dangling = is_remove_dangling;
+      GC_next_dl_shard = 0;
+      GC_do_parallel_task(GC_make_links_disappear_task);
+      GC_par_dl_hashtbl = NULL;
+      GC_unlock_dl_hashtbl(dl_hashtbl);
+      return;
+    }
+# endif
+  for (s = 0; s < DL_SHARDS; s++) {
+    GC_make_shard_links_disappear(DL_SHARD_AT(dl_hashtbl, s),
+                                  is_remove_dangling);
+  }
+  GC_unlock_dl_hashtbl(dl_hashtbl);
 }
 
+#ifdef PARALLEL_MARK
+  /* Mark from the finalizable objects which are not marked, like the   */
+  /* serial loop of GC_finalize does, but push them all (draining the   */
+  /* mark stack when it gets half full) and let the marker threads      */
+  /* do the marking.  The set of the marked objects is the same, but    */
+  /* the finalization cycles cannot be detected (and reported) this     */
+  /* way.                                                               */
+  STATIC void GC_mark_fo_parallel(size_t fo_size)
+  {
+    size_t i;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    for (i = 0; i < fo_size; i++) {
+      struct finalizable_object *curr_fo;
+
+      for (curr_fo = GC_fnlz_roots.fo_head[i];
+           curr_fo != NULL; curr_fo = fo_next(curr_fo)) {
+        ptr_t real_ptr = (ptr_t)GC_REVEAL_POINTER(curr_fo -> fo_hidden_base);
+
+        if (GC_is_marked(real_ptr)) continue;
+        GC_MARKED_FOR_FINALIZATION(real_ptr);
+        curr_fo -> fo_mark_proc(real_ptr);
+        if ((word)GC_mark_stack_top
+            >= (word)(GC_mark_stack + GC_mark_stack_size / 2))
+          GC_mark_stack_in_parallel();
+      }
+    }
+    GC_mark_stack_in_parallel();
+  }
+#endif /* PARALLEL_MARK */
+
 /* Cause disappearing links to disappear and unreachable objects to be  */
 /* enqueued for finalization.  Called with the world running.           */
+/* Find the entry for the given object in the finalization table,     */
+/* also return its chain index and the previous entry in the chain.    */
+STATIC struct finalizable_object *GC_find_fo(ptr_t real_ptr, size_t *pindex,
+                                        struct finalizable_object **pprev)
+{
+    size_t i = HASH2(real_ptr, GC_log_fo_table_size);
+    struct finalizable_object *prev_fo = NULL;
+    struct finalizable_object *curr_fo;
+
+    for (curr_fo = GC_fnlz_roots.fo_head[i]; curr_fo != NULL;
+         curr_fo = fo_next(curr_fo)) {
+      if (curr_fo -> fo_hidden_base == GC_HIDE_POINTER(real_ptr))
+        break;
+      prev_fo = curr_fo;
+    }
+    *pindex = i;
+    *pprev = prev_fo;
+    return curr_fo;
+}
+
+/* Move the entry of an unreachable object from the finalization table */
+/* (chain i, after prev_fo) to the list of objects awaiting            */
+/* finalization.                                                       */
+STATIC void GC_enqueue_fo(struct finalizable_object *curr_fo,
+                          struct finalizable_object *prev_fo, size_t i,
+                          GC_bool *pneeds_barrier)
+{
+    ptr_t real_ptr = (ptr_t)GC_REVEAL_POINTER(curr_fo -> fo_hidden_base);
+    struct finalizable_object *next_fo = fo_next(curr_fo);
+
+    if (!GC_java_finalization) {
+      GC_set_mark_bit(real_ptr);
+    }
+    /* Delete from hash table */
+      if (NULL == prev_fo) {
+        GC_fnlz_roots.fo_head[i] = next_fo;
+        if (GC_object_finalized_proc) {
+          GC_dirty(GC_fnlz_roots.fo_head + i);
+        } else {
+          *pneeds_barrier = TRUE;
+        }
+      } else {
+        fo_set_next(prev_fo, next_fo);
+        GC_dirty(prev_fo);
+      }
+      GC_fo_entries--;
+      if (GC_object_finalized_proc)
+        GC_object_finalized_proc(real_ptr);
+
+    /* Add to list of objects awaiting finalization.    */
+      fo_set_next(curr_fo, GC_fnlz_roots.finalize_now);
+      GC_dirty(curr_fo);
+      SET_FINALIZE_NOW(curr_fo);
+      FNLZ_QUEUE_ADD(1);
+      /* unhide object pointer so any future collections will   */
+      /* see it.                                                */
+      curr_fo -> fo_hidden_base =
+                (word)GC_REVEAL_POINTER(curr_fo -> fo_hidden_base);
+      GC_bytes_finalized +=
+                curr_fo -> fo_object_size + sizeof(struct finalizable_object);
+    GC_ASSERT(GC_is_marked(GC_base(curr_fo)));
+}
+
 GC_INNER void GC_finalize(void)
 {
     struct finalizable_object * curr_fo, * prev_fo, * next_fo;
     ptr_t real_ptr;
-    size_t i;
+    size_t i, k;
     size_t fo_size = GC_fnlz_roots.fo_head == NULL ? 0 :
                                 (size_t)1 << GC_log_fo_table_size;
     GC_bool needs_barrier = FALSE;
+    GC_bool young_only = !GC_is_full_gc && !GC_young_fo_overflow
+                         && fo_size > 0;
+                /* In a minor collection, process only the entries      */
+                /* registered since the previous collection.            */
 
     GC_ASSERT(I_HOLD_LOCK());
+    if (GC_young_fo_arr != NULL)
+      GC_set_mark_bit(GC_base(GC_young_fo_arr));
 #   ifndef SMALL_CONFIG
       /* Save current GC_[dl/ll]_entries value for stats printing */
-      GC_old_dl_entries = GC_dl_hashtbl.entries;
+      GC_old_dl_entries = GC_dl_entries(&GC_dl_hashtbl);
 #     ifndef GC_LONG_REFS_NOT_NEEDED
-        GC_old_ll_entries = GC_ll_hashtbl.entries;
+        GC_old_ll_entries = GC_dl_entries(&GC_ll_hashtbl);
 #     endif
 #   endif
 
 #   ifndef GC_TOGGLE_REFS_NOT_NEEDED
       GC_mark_togglerefs();
+#   endif
+#   ifndef GC_EPHEMERONS_NOT_NEEDED
+      GC_mark_ephemerons();
 #   endif
     GC_make_disappearing_links_disappear(&GC_dl_hashtbl, FALSE);
 
   /* Mark all objects reachable via chains of 1 or more pointers        */
   /* from finalizable objects.                                          */
     GC_ASSERT(!GC_collection_in_progress());
-    for (i = 0; i < fo_size; i++) {
-      for (curr_fo = GC_fnlz_roots.fo_head[i];
-           curr_fo != NULL; curr_fo = fo_next(curr_fo)) {
-        GC_ASSERT(GC_size(curr_fo) >= sizeof(struct finalizable_object));
-        real_ptr = (ptr_t)GC_REVEAL_POINTER(curr_fo->fo_hidden_base);
-        if (!GC_is_marked(real_ptr)) {
+    if (young_only) {
+      /* The old entries are marked since the previous collection.  */
+      for (k = 0; k < GC_young_fo_size; k++) {
+        real_ptr = (ptr_t)GC_REVEAL_POINTER(GC_young_fo_arr[k]);
+        curr_fo = GC_find_fo(real_ptr, &i, &prev_fo);
+        if (curr_fo != NULL && !GC_is_marked(real_ptr)) {
+          GC_MARKED_FOR_FINALIZATION(real_ptr);
+          GC_mark_fo(real_ptr, curr_fo -> fo_mark_proc);
+          if (GC_is_marked(real_ptr)) {
+            WARN("Finalization cycle involving %p\n", real_ptr);
+          }
+        }
+      }
+    } else
+#   ifdef PARALLEL_MARK
+      /* else */ if (GC_parallel
+                     && GC_fo_entries >= PARALLEL_FINALIZE_MIN_ENTRIES) {
+        GC_mark_fo_parallel(fo_size);
+      } else
+#   endif
+    /* else */ {
+      for (i = 0; i < fo_size; i++) {
+        for (curr_fo = GC_fnlz_roots.fo_head[i];
+             curr_fo != NULL; curr_fo = fo_next(curr_fo)) {
+          GC_ASSERT(GC_size(curr_fo) >= sizeof(struct finalizable_object));
+          real_ptr = (ptr_t)GC_REVEAL_POINTER(curr_fo->fo_hidden_base);
+          if (!GC_is_marked(real_ptr)) {
             GC_MARKED_FOR_FINALIZATION(real_ptr);
             GC_mark_fo(real_ptr, curr_fo -> fo_mark_proc);
             if (GC_is_marked(real_ptr)) {
                 WARN("Finalization cycle involving %p\n", real_ptr);
             }
+          }
         }
       }
     }
   /* Enqueue for finalization all objects that are still                */
   /* unreachable.                                                       */
     GC_bytes_finalized = 0;
-    for (i = 0; i < fo_size; i++) {
-      curr_fo = GC_fnlz_roots.fo_head[i];
-      prev_fo = 0;
-      while (curr_fo != 0) {
-        real_ptr = (ptr_t)GC_REVEAL_POINTER(curr_fo->fo_hidden_base);
-        if (!GC_is_marked(real_ptr)) {
-            if (!GC_java_finalization) {
-              GC_set_mark_bit(real_ptr);
-            }
-            /* Delete from hash table */
-              next_fo = fo_next(curr_fo);
-              if (NULL == prev_fo) {
-                GC_fnlz_roots.fo_head[i] = next_fo;
-                if (GC_object_finalized_proc) {
-                  GC_dirty(GC_fnlz_roots.fo_head + i);
-                } else {
-                  needs_barrier = TRUE;
-                }
-              } else {
-                fo_set_next(prev_fo, next_fo);
-                GC_dirty(prev_fo);
-              }
-              GC_fo_entries--;
-              if (GC_object_finalized_proc)
-                GC_object_finalized_proc(real_ptr);
-
-            /* Add to list of objects awaiting finalization.    */
-              fo_set_next(curr_fo, GC_fnlz_roots.finalize_now);
-              GC_dirty(curr_fo);
-              SET_FINALIZE_NOW(curr_fo);
-              /* unhide object pointer so any future collections will   */
-              /* see it.                                                */
-              curr_fo -> fo_hidden_base =
-                        (word)GC_REVEAL_POINTER(curr_fo -> fo_hidden_base);
-              GC_bytes_finalized +=
-                        curr_fo -> fo_object_size
-                        + sizeof(struct finalizable_object);
-            GC_ASSERT(GC_is_marked(GC_base(curr_fo)));
+    if (young_only) {
+      for (k = 0; k < GC_young_fo_size; k++) {
+        real_ptr = (ptr_t)GC_REVEAL_POINTER(GC_young_fo_arr[k]);
+        curr_fo = GC_find_fo(real_ptr, &i, &prev_fo);
+        if (curr_fo != NULL && !GC_is_marked(real_ptr))
+          GC_enqueue_fo(curr_fo, prev_fo, i, &needs_barrier);
+      }
+    } else {
+      for (i = 0; i < fo_size; i++) {
+        curr_fo = GC_fnlz_roots.fo_head[i];
+        prev_fo = 0;
+        while (curr_fo != 0) {
+          real_ptr = (ptr_t)GC_REVEAL_POINTER(curr_fo->fo_hidden_base);
+          if (!GC_is_marked(real_ptr)) {
+            next_fo = fo_next(curr_fo);
+            GC_enqueue_fo(curr_fo, prev_fo, i, &needs_barrier);
             curr_fo = next_fo;
-        } else {
+          } else {
             prev_fo = curr_fo;
             curr_fo = fo_next(curr_fo);
+          }
         }
       }
     }
+    /* The remaining entries are all marked now, and remain marked  */
+    /* until the next full collection.                              */
+    GC_young_fo_size = 0;
+    GC_young_fo_overflow = FALSE;
 
   if (GC_java_finalization) {
     /* make sure we mark everything reachable from objects finalized
@@ -1112,6 +2307,7 @@ GC_INNER void GC_finalize(void)
                 fo_set_next(prev_fo, next_fo);
                 GC_dirty(prev_fo);
               }
+              FNLZ_QUEUE_SUB(1);
               curr_fo -> fo_hidden_base =
                                 GC_HIDE_POINTER(curr_fo -> fo_hidden_base);
               GC_bytes_finalized -=
@@ -1134,8 +2330,16 @@ GC_INNER void GC_finalize(void)
   if (needs_barrier)
     GC_dirty(GC_fnlz_roots.fo_head); /* entire object */
 
-  /* Remove dangling disappearing links. */
-  GC_make_disappearing_links_disappear(&GC_dl_hashtbl, TRUE);
+  /* Remove dangling disappearing links (and queue the cleared ones).   */
+  {
+    word old_queue_size = GC_dl_queue_size;
+
+    GC_make_disappearing_links_disappear(&GC_dl_hashtbl, TRUE);
+    if (GC_dl_queue_size > GC_dl_queue_capacity)
+      SET_DL_QUEUE_SIZE(GC_dl_queue_capacity);
+    if (GC_dl_queue_size != old_queue_size)
+      GC_dirty(GC_dl_queue);
+  }
 
 # ifndef GC_TOGGLE_REFS_NOT_NEEDED
     GC_clear_togglerefs();
@@ -1144,6 +2348,10 @@ GC_INNER void GC_finalize(void)
     GC_make_disappearing_links_disappear(&GC_ll_hashtbl, FALSE);
     GC_make_disappearing_links_disappear(&GC_ll_hashtbl, TRUE);
 # endif
+# ifndef GC_MOVABLE_NOT_NEEDED
+    GC_make_disappearing_links_disappear(&GC_mh_hashtbl, FALSE);
+    GC_make_disappearing_links_disappear(&GC_mh_hashtbl, TRUE);
+# endif
 
   if (GC_fail_count) {
     /* Don't prevent running finalizers if there has been an allocation */
@@ -1186,6 +2394,7 @@ GC_INNER void GC_finalize(void)
           fo_set_next(curr_fo, GC_fnlz_roots.finalize_now);
           GC_dirty(curr_fo);
           SET_FINALIZE_NOW(curr_fo);
+          FNLZ_QUEUE_ADD(1);
 
           /* unhide object pointer so any future collections will       */
           /* see it.                                                    */
@@ -1197,6 +2406,7 @@ GC_INNER void GC_finalize(void)
       }
     }
     GC_fo_entries = 0;  /* all entries deleted from the hash table */
+    GC_young_fo_size = 0;
   }
 
   /* Invoke all remaining finalizers that haven't yet been run.
@@ -1263,16 +2473,22 @@ GC_API int GC_CALL GC_invoke_finalizers(void)
         }
         curr_fo = GC_fnlz_roots.finalize_now;
 #       ifdef THREADS
-            if (curr_fo != NULL)
+            if (curr_fo != NULL) {
                 SET_FINALIZE_NOW(fo_next(curr_fo));
+                FNLZ_QUEUE_SUB(1);
+            }
             UNLOCK();
             if (curr_fo == 0) break;
 #       else
             GC_fnlz_roots.finalize_now = fo_next(curr_fo);
+            FNLZ_QUEUE_SUB(1);
 #       endif
         fo_set_next(curr_fo, 0);
+        GC_PROBE2(finalizer_start, curr_fo -> fo_hidden_base,
+                  curr_fo -> fo_client_data);
         (*(curr_fo -> fo_fn))((ptr_t)(curr_fo -> fo_hidden_base),
                               curr_fo -> fo_client_data);
+        GC_PROBE1(finalizer_done, curr_fo -> fo_hidden_base);
         curr_fo -> fo_client_data = 0;
         ++count;
         /* Explicit freeing of curr_fo is probably a bad idea.  */
@@ -1296,6 +2512,59 @@ GC_API int GC_CALL GC_invoke_finalizers(void)
     return count;
 }
 
+#ifdef FINALIZER_THREADS
+  /* Same as GC_invoke_finalizers but take (at most) the given number   */
+  /* of objects from the head of the queue at once.  Used by the        */
+  /* finalizer threads to reduce the allocation lock contention.        */
+  GC_INNER unsigned GC_invoke_finalizers_batch(unsigned batch)
+  {
+    struct finalizable_object *curr_fo, *last_fo;
+    unsigned count = 0;
+    word bytes_freed_before;
+    DCL_LOCK_STATE;
+
+    GC_ASSERT(I_DONT_HOLD_LOCK());
+    GC_ASSERT(batch > 0);
+    LOCK();
+    bytes_freed_before = GC_bytes_freed;
+    curr_fo = GC_fnlz_roots.finalize_now;
+    for (last_fo = curr_fo; last_fo != NULL; last_fo = fo_next(last_fo)) {
+      if (++count == batch) break;
+    }
+    if (last_fo != NULL) {
+      SET_FINALIZE_NOW(fo_next(last_fo));
+      fo_set_next(last_fo, NULL); /* detach the batch */
+    } else {
+      SET_FINALIZE_NOW(NULL);
+    }
+    FNLZ_QUEUE_SUB(count);
+    UNLOCK();
+
+    while (curr_fo != NULL) {
+      struct finalizable_object *next_fo = fo_next(curr_fo);
+
+      fo_set_next(curr_fo, 0);
+      GC_PROBE2(finalizer_start, curr_fo -> fo_hidden_base,
+                curr_fo -> fo_client_data);
+      (*(curr_fo -> fo_fn))((ptr_t)(curr_fo -> fo_hidden_base),
+                            curr_fo -> fo_client_data);
+      GC_PROBE1(finalizer_done, curr_fo -> fo_hidden_base);
+      curr_fo -> fo_client_data = 0;
+      curr_fo = next_fo;
+    }
+    if (count != 0
+#       ifndef THREAD_SANITIZER
+          && bytes_freed_before != GC_bytes_freed
+#       endif
+       ) {
+      LOCK();
+      GC_finalizer_bytes_freed += (GC_bytes_freed - bytes_freed_before);
+      UNLOCK();
+    }
+    return count;
+  }
+#endif /* FINALIZER_THREADS */
+
 static word last_finalizer_notification = 0;
 
 GC_INNER void GC_notify_or_invoke_finalizers(void)
@@ -1347,6 +2616,9 @@ GC_INNER void GC_notify_or_invoke_finalizers(void)
       UNLOCK();
       return;
     }
+#   ifdef FINALIZER_THREADS
+      if (GC_hand_over_finalizers()) return; /* the lock is released */
+#   endif
 
     if (!GC_finalize_on_demand) {
       unsigned char *pnested = GC_check_finalizer_nested();
@@ -1387,18 +2659,19 @@ GC_INNER void GC_notify_or_invoke_finalizers(void)
     GC_log_printf("%lu finalization entries;"
                   " %lu/%lu short/long disappearing links alive\n",
                   (unsigned long)GC_fo_entries,
-                  (unsigned long)GC_dl_hashtbl.entries,
+                  (unsigned long)GC_dl_entries(&GC_dl_hashtbl),
                   (unsigned long)IF_LONG_REFS_PRESENT_ELSE(
-                                                GC_ll_hashtbl.entries, 0));
+                                        GC_dl_entries(&GC_ll_hashtbl), 0));
 
     for (fo = GC_fnlz_roots.finalize_now; fo != NULL; fo = fo_next(fo))
       ++ready;
     GC_log_printf("%lu finalization-ready objects;"
                   " %ld/%ld short/long links cleared\n",
                   ready,
-                  (long)GC_old_dl_entries - (long)GC_dl_hashtbl.entries,
-                  (long)IF_LONG_REFS_PRESENT_ELSE(
-                              GC_old_ll_entries - GC_ll_hashtbl.entries, 0));
+                  (long)GC_old_dl_entries
+                                - (long)GC_dl_entries(&GC_dl_hashtbl),
+                  (long)IF_LONG_REFS_PRESENT_ELSE(GC_old_ll_entries
+                                - GC_dl_entries(&GC_ll_hashtbl), 0));
   }
 #endif /* !SMALL_CONFIG */
 
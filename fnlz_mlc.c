@@ -26,30 +26,34 @@
 # define FINALIZER_CLOSURE_FLAG 0x1
 #endif
 
-STATIC int GC_CALLBACK GC_finalized_disclaim(void *obj)
+STATIC void GC_CALLBACK GC_finalized_disclaim(void **objs, size_t n)
 {
-#   ifdef AO_HAVE_load
-        word fc_word = (word)AO_load((volatile AO_t *)obj);
-#   else
-        word fc_word = *(word *)obj;
-#   endif
+    size_t i;
+
+    GC_ASSERT(!GC_find_leak);
+    for (i = 0; i < n; i++) {
+        void *obj = objs[i];
+#       ifdef AO_HAVE_load
+            word fc_word = (word)AO_load((volatile AO_t *)obj);
+#       else
+            word fc_word = *(word *)obj;
+#       endif
+        const struct GC_finalizer_closure *fc;
 
-    if ((fc_word & FINALIZER_CLOSURE_FLAG) != 0) {
-       /* The disclaim function may be passed fragments from the        */
-       /* free-list, on which it should not run finalization.           */
-       /* To recognize this case, we use the fact that the first word   */
-       /* on such fragments is always multiple of 4 (a link to the next */
-       /* fragment, or NULL).  If it is desirable to have a finalizer   */
-       /* which does not use the first word for storing finalization    */
-       /* info, GC_reclaim_with_finalization must be extended to clear  */
-       /* fragments so that the assumption holds for the selected word. */
-        const struct GC_finalizer_closure *fc
-                        = (struct GC_finalizer_closure *)(fc_word
+        /* The disclaim function may be passed fragments from the       */
+        /* free-list, on which it should not run finalization.          */
+        /* To recognize this case, we use the fact that the first word  */
+        /* on such fragments is always multiple of 4 (a link to the     */
+        /* next fragment, or NULL).  If it is desirable to have         */
+        /* a finalizer which does not use the first word for storing    */
+        /* finalization info, GC_disclaim_batch_and_reclaim must be     */
+        /* extended to clear fragments so that the assumption holds for */
+        /* the selected word.                                           */
+        if ((fc_word & FINALIZER_CLOSURE_FLAG) == 0) continue;
+        fc = (struct GC_finalizer_closure *)(fc_word
                                         & ~(word)FINALIZER_CLOSURE_FLAG);
-        GC_ASSERT(!GC_find_leak);
         (*fc->proc)((word *)obj + 1, fc->cd);
     }
-    return 0;
 }
 
 GC_API void GC_CALL GC_init_finalized_malloc(void)
@@ -78,7 +82,12 @@ GC_API void GC_CALL GC_init_finalized_malloc(void)
     GC_finalized_kind = GC_new_kind_inner(GC_new_free_list_inner(),
                                           GC_DS_LENGTH, TRUE, TRUE);
     GC_ASSERT(GC_finalized_kind != 0);
-    GC_register_disclaim_proc(GC_finalized_kind, GC_finalized_disclaim, TRUE);
+    /* Every object of the kind (except for the free-list fragments)    */
+    /* has a finalizer, thus hb_disclaim_bits are not used (to avoid    */
+    /* touching the block header on each allocation).                   */
+    GC_register_disclaim_batch_proc(GC_finalized_kind, GC_finalized_disclaim,
+                                    TRUE);
+    GC_obj_kinds[GC_finalized_kind].ok_disclaim_needed_only = FALSE;
     UNLOCK();
 }
 
@@ -89,11 +98,47 @@ GC_API void GC_CALL GC_register_disclaim_proc(int kind, GC_disclaim_proc proc,
     GC_ASSERT(NONNULL_ARG_NOT_NULL(proc));
     if (!EXPECT(GC_find_leak, FALSE)) {
         GC_obj_kinds[kind].ok_disclaim_proc = proc;
+        GC_obj_kinds[kind].ok_disclaim_batch_proc = 0;
+        GC_obj_kinds[kind].ok_disclaim_needed_only = FALSE;
+        GC_obj_kinds[kind].ok_mark_unconditionally =
+                                        (GC_bool)mark_unconditionally;
+    }
+}
+
+GC_API void GC_CALL GC_register_disclaim_batch_proc(int kind,
+                                GC_disclaim_batch_proc proc,
+                                int mark_unconditionally)
+{
+    GC_ASSERT((unsigned)kind < MAXOBJKINDS);
+    GC_ASSERT(NONNULL_ARG_NOT_NULL(proc));
+    if (!EXPECT(GC_find_leak, FALSE)) {
+        GC_obj_kinds[kind].ok_disclaim_proc = 0;
+        GC_obj_kinds[kind].ok_disclaim_batch_proc = proc;
+        GC_obj_kinds[kind].ok_disclaim_needed_only = TRUE;
         GC_obj_kinds[kind].ok_mark_unconditionally =
                                         (GC_bool)mark_unconditionally;
     }
 }
 
+GC_API void GC_CALL GC_set_disclaim_needed(const void *p)
+{
+    hdr *hhdr = HDR(p);
+    word bit_no = MARK_BIT_NO((ptr_t)p - (ptr_t)HBLKPTR(p), hhdr -> hb_sz);
+#   if defined(THREADS) && !defined(DISCLAIM_BITS_ATOMIC)
+        DCL_LOCK_STATE;
+#   endif
+
+    GC_ASSERT(GC_base((void *)p) == p);
+    GC_ASSERT(GC_obj_kinds[hhdr -> hb_obj_kind].ok_disclaim_needed_only);
+#   if defined(THREADS) && !defined(DISCLAIM_BITS_ATOMIC)
+        LOCK();
+        SET_DISCLAIM_BIT(hhdr, bit_no);
+        UNLOCK();
+#   else
+        SET_DISCLAIM_BIT(hhdr, bit_no);
+#   endif
+}
+
 GC_API GC_ATTR_MALLOC void * GC_CALL GC_finalized_malloc(size_t lb,
                                 const struct GC_finalizer_closure *fclos)
 {
@@ -116,16 +116,51 @@ built-in "new" and "delete".
 
 # if __cplusplus >= 201402L || _MSVC_LANG >= 201402L // C++14
     void operator delete(void* obj, size_t size) GC_NOEXCEPT {
-      (void)size; // size is ignored
-      GC_FREE(obj);
+      GC_FREE_SIZED(obj, size);
     }
 
 #   if defined(GC_OPERATOR_NEW_ARRAY) && !defined(CPPCHECK)
       void operator delete[](void* obj, size_t size) GC_NOEXCEPT {
-        (void)size;
-        GC_FREE(obj);
+        GC_FREE_SIZED(obj, size);
       }
 #   endif
 # endif // C++14
 
+# ifdef GC_ALIGNED_NEW
+    // The over-aligned objects might not start at the beginning of
+    // the allocated heap object, thus they are freed by their base.
+    void* operator new(size_t size, std::align_val_t al) {
+      void* obj = GC_memalign_uncollectable(static_cast<size_t>(al), size);
+      if (0 == obj)
+        GC_ALLOCATOR_THROW_OR_ABORT();
+      return obj;
+    }
+
+    void operator delete(void* obj, std::align_val_t) GC_NOEXCEPT {
+      GC_free(GC_base(obj));
+    }
+
+    void operator delete(void* obj, size_t size,
+                         std::align_val_t) GC_NOEXCEPT {
+      (void)size;
+      GC_free(GC_base(obj));
+    }
+
+#   if defined(GC_OPERATOR_NEW_ARRAY) && !defined(CPPCHECK)
+      void* operator new[](size_t size, std::align_val_t al) {
+        return operator new(size, al);
+      }
+
+      void operator delete[](void* obj, std::align_val_t) GC_NOEXCEPT {
+        GC_free(GC_base(obj));
+      }
+
+      void operator delete[](void* obj, size_t size,
+                             std::align_val_t) GC_NOEXCEPT {
+        (void)size;
+        GC_free(GC_base(obj));
+      }
+#   endif
+# endif // GC_ALIGNED_NEW
+
 #endif // !_MSC_VER && !__DMC__ || GC_NO_INLINE_STD_NEW
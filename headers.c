@@ -46,13 +46,29 @@ GC_INNER hdr * GC_find_header(ptr_t h)
 /* Never returns a pointer to a free hblk.                      */
 GC_INNER hdr *
 #ifdef PRINT_BLACK_LIST
-  GC_header_cache_miss(ptr_t p, hdr_cache_entry *hce, ptr_t source)
+  GC_header_cache_miss(ptr_t p, hdr_cache_t *hc, hdr_cache_entry *hce,
+                       ptr_t source)
 #else
-  GC_header_cache_miss(ptr_t p, hdr_cache_entry *hce)
+  GC_header_cache_miss(ptr_t p, hdr_cache_t *hc, hdr_cache_entry *hce)
 #endif
 {
   hdr *hhdr;
-  HC_MISS();
+  int i;
+
+# if HDR_CACHE_WAYS > 1
+    for (i = 1; i < HDR_CACHE_WAYS; i++) {
+      if (HCE_VALID_FOR(hce + i, p)) {
+        hdr_cache_entry e = hce[i];
+
+        /* Move the entry to the front of the set.    */
+        for (; i > 0; i--) hce[i] = hce[i - 1];
+        hce[0] = e;
+        hc -> hc_hits++;
+        return e.hce_hdr;
+      }
+    }
+# endif
+  hc -> hc_misses++;
   GET_HDR(p, hhdr);
   if (IS_FORWARDING_ADDR_OR_NIL(hhdr)) {
     if (GC_all_interior_pointers) {
@@ -93,6 +109,8 @@ GC_INNER hdr *
       GC_ADD_TO_BLACK_LIST_NORMAL(p, source);
       return 0;
     } else {
+      /* Evict the least recently used entry of the set.        */
+      for (i = HDR_CACHE_WAYS - 1; i > 0; i--) hce[i] = hce[i - 1];
       hce -> block_addr = (word)(p) >> LOG_HBLKSIZE;
       hce -> hce_hdr = hhdr;
       return hhdr;
@@ -184,12 +202,30 @@ GC_INLINE void free_hdr(hdr * hhdr)
     GC_hdr_free_list = hhdr;
 }
 
-#ifdef COUNT_HDR_CACHE_HITS
-  /* Used for debugging/profiling (the symbols are externally visible). */
-  word GC_hdr_cache_hits = 0;
-  word GC_hdr_cache_misses = 0;
+#ifdef PARALLEL_MARK
+  GC_INNER volatile AO_t GC_hdr_cache_hits = 0;
+  GC_INNER volatile AO_t GC_hdr_cache_misses = 0;
+#else
+  GC_INNER word GC_hdr_cache_hits = 0;
+  GC_INNER word GC_hdr_cache_misses = 0;
 #endif
 
+GC_INNER void GC_hdr_cache_flush_stats(hdr_cache_t *hc)
+{
+# ifdef PARALLEL_MARK
+    /* The markers could flush their caches concurrently.       */
+    if (hc -> hc_hits != 0)
+      (void)AO_fetch_and_add(&GC_hdr_cache_hits, (AO_t)(hc -> hc_hits));
+    if (hc -> hc_misses != 0)
+      (void)AO_fetch_and_add(&GC_hdr_cache_misses, (AO_t)(hc -> hc_misses));
+# else
+    GC_hdr_cache_hits += hc -> hc_hits;
+    GC_hdr_cache_misses += hc -> hc_misses;
+# endif
+  hc -> hc_hits = 0;
+  hc -> hc_misses = 0;
+}
+
 GC_INNER void GC_init_headers(void)
 {
     unsigned i;
@@ -205,6 +241,9 @@ GC_INNER void GC_init_headers(void)
     for (i = 0; i < TOP_SZ; i++) {
         GC_top_index[i] = GC_all_nils;
     }
+#   ifdef USE_HEAP_ARENA
+      GC_init_arena();
+#   endif
 }
 
 /* Make sure that there is a bottom level index block for address addr. */
@@ -304,10 +343,11 @@ GC_INNER GC_bool GC_install_counts(struct hblk *h, size_t sz/* bytes */)
 /* Remove the header for block h */
 GC_INNER void GC_remove_header(struct hblk *h)
 {
-    hdr **ha;
-    GET_HDR_ADDR(h, ha);
-    free_hdr(*ha);
-    *ha = 0;
+    hdr *hhdr;
+
+    GET_HDR(h, hhdr);
+    free_hdr(hhdr);
+    SET_HDR(h, 0);
 }
 
 /* Remove forwarding counts for h */
@@ -355,6 +395,101 @@ GC_API void GC_CALL GC_apply_to_all_blocks(GC_walk_hblk_fn fn,
      }
 }
 
+/* Apply fn to each allocated heap block whose header is described by  */
+/* the entries [lo, hi] of the given bottom index, passing the worker   */
+/* id to it.                                                            */
+STATIC void GC_apply_to_bi_blocks(bottom_index *index_p, signed_word lo,
+                                  signed_word hi, GC_walk_hblk_par_fn fn,
+                                  unsigned id, GC_word client_data)
+{
+    signed_word j;
+
+    for (j = hi; j >= lo;) {
+        if (!IS_FORWARDING_ADDR_OR_NIL(index_p->index[j])) {
+            if (!HBLK_IS_FREE(index_p->index[j])) {
+                (*fn)(((struct hblk *)
+                          (((index_p->key << LOG_BOTTOM_SZ) + (word)j)
+                           << LOG_HBLKSIZE)),
+                      id, client_data);
+            }
+            j--;
+        } else if (index_p->index[j] == 0) {
+            j--;
+        } else {
+            j -= (signed_word)(index_p->index[j]);
+        }
+    }
+}
+
+#ifdef PARALLEL_MARK
+  /* The number of entries of a bottom index claimed by a worker of     */
+  /* GC_apply_to_all_blocks_parallel at once.                           */
+# ifndef LOG_WALK_CHUNK_SZ
+#   define LOG_WALK_CHUNK_SZ 8
+# endif
+# if LOG_WALK_CHUNK_SZ > LOG_BOTTOM_SZ
+#   undef LOG_WALK_CHUNK_SZ
+#   define LOG_WALK_CHUNK_SZ LOG_BOTTOM_SZ
+# endif
+# define WALK_CHUNK_SZ ((signed_word)1 << LOG_WALK_CHUNK_SZ)
+
+  STATIC bottom_index *GC_next_walk_bi = NULL;
+  STATIC signed_word GC_next_walk_chunk = 0;
+                        /* The next bottom index (and the chunk in it)  */
+                        /* to be claimed by a worker.  Protected by     */
+                        /* mark lock.                                   */
+  STATIC GC_walk_hblk_par_fn GC_walk_par_fn = 0;
+  STATIC GC_word GC_walk_par_client_data = 0;
+
+  /* Walk the blocks of the bottom index chunks claimed one by one.     */
+  STATIC void GC_walk_blocks_parts(unsigned id, mse *local_mark_stack)
+  {
+    UNUSED_ARG(local_mark_stack);
+    for (;;) {
+      bottom_index *index_p;
+      signed_word lo = 0;
+
+      GC_acquire_mark_lock();
+      index_p = GC_next_walk_bi;
+      if (index_p != NULL) {
+        lo = GC_next_walk_chunk;
+        GC_next_walk_chunk += WALK_CHUNK_SZ;
+        if (GC_next_walk_chunk >= BOTTOM_SZ) {
+          GC_next_walk_bi = index_p -> asc_link;
+          GC_next_walk_chunk = 0;
+        }
+      }
+      GC_release_mark_lock();
+      if (NULL == index_p) break;
+      GC_apply_to_bi_blocks(index_p, lo, lo + WALK_CHUNK_SZ - 1,
+                            GC_walk_par_fn, id, GC_walk_par_client_data);
+    }
+  }
+#endif /* PARALLEL_MARK */
+
+GC_API void GC_CALL GC_apply_to_all_blocks_parallel(GC_walk_hblk_par_fn fn,
+                                                    GC_word client_data)
+{
+    bottom_index * index_p;
+
+    GC_ASSERT(I_HOLD_LOCK());
+#   ifdef PARALLEL_MARK
+      if (GC_parallel) {
+        GC_walk_par_fn = fn;
+        GC_walk_par_client_data = client_data;
+        GC_next_walk_bi = GC_all_bottom_indices;
+        GC_next_walk_chunk = 0;
+        GC_do_parallel_task(GC_walk_blocks_parts);
+        GC_walk_par_fn = 0;
+        return;
+      }
+#   endif
+    for (index_p = GC_all_bottom_indices; index_p != 0;
+         index_p = index_p -> asc_link) {
+        GC_apply_to_bi_blocks(index_p, 0, BOTTOM_SZ-1, fn, 0, client_data);
+    }
+}
+
 GC_INNER struct hblk * GC_next_block(struct hblk *h, GC_bool allow_free)
 {
     REGISTER bottom_index * bi;
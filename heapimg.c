@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) 2023 Ivan Maidanski
+ *
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose, provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+#include "private/gc_priv.h"
+
+/*
+ * Persistent heap images.  The heap (which should lie entirely in the
+ * heap arena) is written to a file after a full collection: a header,
+ * the descriptors of the object kinds, a record (offset, object size,
+ * kind) per in-use block, and then the arena contents starting at a
+ * page-aligned file offset (the free blocks are left as holes).  A new
+ * process reserves its arena at the same address, maps the file there
+ * privately (copy-on-write, so the pages are read in lazily and shared
+ * with the page cache until written) and rebuilds the block headers from
+ * the records.  The restored blocks are frozen (see GC_freeze_heap), so
+ * they form an old generation which is never swept.
+ * Only the heap is restored; the image root should be passed from the
+ * writer to the loader explicitly, and the pointers from the heap to
+ * the outside (e.g. to the static data) are not relocated.
+ */
+
+#ifdef USE_HEAP_ARENA
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define HEAP_IMAGE_MAGIC "GCHIMG1"
+
+struct heap_image_hdr {
+    char magic[8];
+    word word_sz;       /* sizeof(word)                                 */
+    word hblk_sz;       /* HBLKSIZE                                     */
+    word n_kinds;       /* the number of the kind descriptors following */
+    word start;         /* the image address (the arena start)          */
+    word len;           /* the image length (a multiple of page size)   */
+    word root;          /* the pointer passed to GC_write_heap_image    */
+    word n_blocks;      /* the number of the block records following    */
+    word data_offset;   /* the file offset of the image contents        */
+};
+
+struct heap_image_kind {
+    word descr;
+    word relocate_descr;
+};
+
+struct heap_image_block {
+    word offset;        /* relative to the image start                  */
+    word sz;            /* hb_sz                                        */
+    word kind_flags;    /* hb_obj_kind, IGNORE_OFF_PAGE flag << 8       */
+};
+
+#define HEAP_IMAGE_BUF_BLOCKS 256
+
+STATIC int GC_heap_image_pwrite(int fd, const void *buf, size_t len,
+                                word offset)
+{
+    while (len > 0) {
+      ssize_t n = pwrite(fd, buf, len, (off_t)offset);
+
+      if (n < 0) {
+        if (EINTR == errno || EAGAIN == errno) continue;
+        return -1;
+      }
+      buf = (const char *)buf + n;
+      len -= (size_t)n;
+      offset += (word)n;
+    }
+    return 0;
+}
+
+STATIC int GC_heap_image_read(int fd, void *buf, size_t len)
+{
+    while (len > 0) {
+      ssize_t n = read(fd, buf, len);
+
+      if (n <= 0) {
+        if (n < 0 && (EINTR == errno || EAGAIN == errno)) continue;
+        return -1;
+      }
+      buf = (char *)buf + n;
+      len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Return the end of the heap part in the arena, or 0 if the heap is    */
+/* not entirely in the arena.                                           */
+STATIC word GC_heap_image_end(void)
+{
+    word end = GC_arena_start;
+    word i;
+
+    if (0 == GC_arena_size) return 0;
+    for (i = 0; i < GC_n_heap_sects; i++) {
+      word s = (word)GC_heap_sects[i].hs_start;
+      word e = s + GC_heap_sects[i].hs_bytes;
+
+      if (s < GC_arena_start || e > GC_arena_start + GC_arena_size)
+        return 0;
+      if (e > end) end = e;
+    }
+    return end;
+}
+
+/* Write the block records (if fd is not -1) and return their number.   */
+/* Adjacent in-use blocks are written by a single call.                 */
+STATIC word GC_heap_image_blocks(int fd, word start, word end,
+                                 word rec_offset, word data_offset,
+                                 int *perror)
+{
+    struct heap_image_block buf[HEAP_IMAGE_BUF_BLOCKS];
+    size_t n = 0;
+    word count = 0;
+    word run_start = 0, run_end = 0;
+    struct hblk *h;
+
+    for (h = GC_next_block((struct hblk *)start, FALSE);
+         h != NULL && (word)h < end;
+         h = GC_next_block(h + OBJ_SZ_TO_BLOCKS(HDR(h) -> hb_sz), FALSE)) {
+      hdr *hhdr = HDR(h);
+      word blk_end = (word)(h + OBJ_SZ_TO_BLOCKS(hhdr -> hb_sz));
+
+      count++;
+      if (-1 == fd) continue;
+      buf[n].offset = (word)h - start;
+      buf[n].sz = hhdr -> hb_sz;
+      buf[n].kind_flags = hhdr -> hb_obj_kind
+                        | (word)(hhdr -> hb_flags & IGNORE_OFF_PAGE) << 8;
+      if (++n == HEAP_IMAGE_BUF_BLOCKS) {
+        *perror |= GC_heap_image_pwrite(fd, buf, sizeof(buf), rec_offset);
+        rec_offset += sizeof(buf);
+        n = 0;
+      }
+      if (run_end != (word)h) {
+        if (run_end != run_start)
+          *perror |= GC_heap_image_pwrite(fd, (void *)run_start,
+                                          (size_t)(run_end - run_start),
+                                          data_offset + run_start - start);
+        run_start = (word)h;
+      }
+      run_end = blk_end;
+    }
+    if (fd != -1) {
+      if (n > 0)
+        *perror |= GC_heap_image_pwrite(fd, buf,
+                                n * sizeof(struct heap_image_block),
+                                rec_offset);
+      if (run_end != run_start)
+        *perror |= GC_heap_image_pwrite(fd, (void *)run_start,
+                                        (size_t)(run_end - run_start),
+                                        data_offset + run_start - start);
+    }
+    return count;
+}
+
+GC_API int GC_CALL GC_write_heap_image(const char *path, void *root)
+{
+    struct heap_image_hdr ih;
+    word end = 0;
+    word rec_offset;
+    int fd;
+    int error = 0;
+    unsigned i;
+    IF_CANCEL(int cancel_state;)
+    DCL_LOCK_STATE;
+
+    if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+
+    LOCK();
+    DISABLE_CANCEL(cancel_state);
+    /* The empty blocks are freed by the sweep.  */
+    if (GC_dont_gc || GC_find_leak || !GC_collect_and_sweep_inner()) {
+      error = 1;
+    } else {
+      /* The large-object space is out of the arena too.       */
+      end = GC_heap_image_end();
+      if (0 == end || (word)GC_next_block(NULL, FALSE) < GC_arena_start
+          || GC_next_block((struct hblk *)end, FALSE) != NULL) {
+        GC_COND_LOG_PRINTF("Heap image: the heap is not in the arena\n");
+        error = 1;
+      }
+    }
+    if (!error) {
+      /* The objects should not be modified while written.      */
+      STOP_WORLD();
+      BZERO(&ih, sizeof(ih));
+      BCOPY(HEAP_IMAGE_MAGIC, ih.magic, sizeof(HEAP_IMAGE_MAGIC));
+      ih.word_sz = sizeof(word);
+      ih.hblk_sz = HBLKSIZE;
+      ih.n_kinds = GC_n_kinds;
+      ih.start = GC_arena_start;
+      ih.len = ROUNDUP_PAGESIZE(end - GC_arena_start);
+      ih.root = (word)root;
+      ih.n_blocks = GC_heap_image_blocks(-1, GC_arena_start, end, 0, 0,
+                                         &error);
+      rec_offset = sizeof(ih) + GC_n_kinds * sizeof(struct heap_image_kind);
+      ih.data_offset = ROUNDUP_PAGESIZE(rec_offset
+                        + ih.n_blocks * sizeof(struct heap_image_block));
+      error |= GC_heap_image_pwrite(fd, &ih, sizeof(ih), 0);
+      for (i = 0; i < GC_n_kinds; i++) {
+        struct heap_image_kind k;
+
+        k.descr = GC_obj_kinds[i].ok_descriptor;
+        k.relocate_descr = (word)GC_obj_kinds[i].ok_relocate_descr;
+        error |= GC_heap_image_pwrite(fd, &k, sizeof(k),
+                                      sizeof(ih) + i * sizeof(k));
+      }
+      (void)GC_heap_image_blocks(fd, GC_arena_start, end, rec_offset,
+                                 ih.data_offset, &error);
+      /* The free blocks (and the tail) become holes in the file. */
+      if (ftruncate(fd, (off_t)(ih.data_offset + ih.len)) != 0) error = 1;
+      START_WORLD();
+    }
+    RESTORE_CANCEL(cancel_state);
+    UNLOCK();
+    if (close(fd) != 0) error = 1;
+    return error ? -1 : 0;
+}
+
+/* Rebuild the headers of the in-use blocks of the mapped image.        */
+STATIC GC_bool GC_heap_image_restore_blocks(int fd,
+                                            const struct heap_image_hdr *ih)
+{
+    struct heap_image_block buf[HEAP_IMAGE_BUF_BLOCKS];
+    struct hblk *fb = (struct hblk *)ih -> start;
+                                /* the free block following the last    */
+                                /* restored one                         */
+    word left = ih -> n_blocks;
+
+    while (left > 0) {
+      size_t n = left < HEAP_IMAGE_BUF_BLOCKS ? (size_t)left
+                                              : HEAP_IMAGE_BUF_BLOCKS;
+      size_t i;
+
+      if (GC_heap_image_read(fd, buf, n * sizeof(struct heap_image_block))
+            != 0)
+        return FALSE;
+      for (i = 0; i < n; i++) {
+        struct hblk *h = (struct hblk *)(ih -> start + buf[i].offset);
+        word sz = buf[i].sz;
+        unsigned kind = (unsigned)(buf[i].kind_flags & 0xff);
+
+        if (buf[i].offset % HBLKSIZE != 0 || buf[i].offset >= ih -> len
+            || 0 == sz || sz > ih -> len || kind >= GC_n_kinds
+            || !GC_alloc_hblk_at(fb, h, (size_t)sz, (int)kind,
+                                 FROZEN_BLK | ((unsigned)(buf[i].kind_flags
+                                                >> 8) & IGNORE_OFF_PAGE)))
+          return FALSE;
+        /* All the objects of the image are considered live. */
+        GC_set_hdr_marks(HDR(h));
+        fb = h + OBJ_SZ_TO_BLOCKS(sz);
+      }
+      left -= n;
+    }
+    return TRUE;
+}
+
+GC_API void * GC_CALL GC_load_heap_image(const char *path)
+{
+    struct heap_image_hdr ih;
+    struct stat st;
+    GC_bool ok = FALSE;
+    int fd = open(path, O_RDONLY);
+    unsigned i;
+    DCL_LOCK_STATE;
+
+    if (fd < 0) return NULL;
+    if (GC_heap_image_read(fd, &ih, sizeof(ih)) != 0
+        || memcmp(ih.magic, HEAP_IMAGE_MAGIC, sizeof(HEAP_IMAGE_MAGIC)) != 0
+        || ih.word_sz != sizeof(word) || ih.hblk_sz != HBLKSIZE
+        || 0 == ih.len || ih.start % HBLKSIZE != 0
+        /* A truncated file could not be mapped entirely.     */
+        || fstat(fd, &st) != 0 || (word)st.st_size < ih.data_offset
+        || (word)st.st_size - ih.data_offset < ih.len) {
+      (void)close(fd);
+      return NULL;
+    }
+    if (!EXPECT(GC_is_initialized, TRUE)) {
+      /* Reserve the arena at the image address and do not expand the  */
+      /* heap yet.                                                      */
+      GC_arena_hint = (ptr_t)ih.start;
+      GC_fast_startup = TRUE;
+      GC_init();
+    }
+
+    LOCK();
+    if (GC_arena_start != ih.start || GC_heapsize != 0
+        || ih.n_kinds > GC_n_kinds || ih.data_offset % GC_page_size != 0) {
+      GC_COND_LOG_PRINTF("Heap image %s is incompatible or the heap is"
+                         " in use already\n", path);
+    } else {
+      ok = TRUE;
+      for (i = 0; i < ih.n_kinds && ok; i++) {
+        struct heap_image_kind k;
+
+        ok = GC_heap_image_read(fd, &k, sizeof(k)) == 0
+                && k.descr == GC_obj_kinds[i].ok_descriptor
+                && k.relocate_descr
+                    == (word)GC_obj_kinds[i].ok_relocate_descr;
+      }
+      if (ok && GC_arena_map_file(fd, ih.data_offset, (size_t)ih.len)) {
+        GC_add_heap_space((struct hblk *)ih.start, (size_t)ih.len);
+        ok = GC_heap_image_restore_blocks(fd, &ih);
+        /* On failure, the blocks restored so far remain frozen and    */
+        /* the rest is free, i.e. the heap is consistent.              */
+      } else {
+        ok = FALSE;
+      }
+      if (!ok) {
+        GC_COND_LOG_PRINTF("Cannot load heap image %s\n", path);
+      }
+    }
+    UNLOCK();
+    (void)close(fd);
+    return ok ? (void *)ih.root : NULL;
+}
+
+#else /* !USE_HEAP_ARENA */
+
+GC_API int GC_CALL GC_write_heap_image(const char *path, void *root)
+{
+    UNUSED_ARG(path);
+    UNUSED_ARG(root);
+    return -1;
+}
+
+GC_API void * GC_CALL GC_load_heap_image(const char *path)
+{
+    UNUSED_ARG(path);
+    return NULL;
+}
+
+#endif /* !USE_HEAP_ARENA */
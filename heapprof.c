@@ -0,0 +1,679 @@
+/*
+ * Copyright (c) 2023 Ivan Maidanski
+ *
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose, provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+#include "private/gc_priv.h"
+
+/*
+ * A statistical allocation sampler.  Once about GC_heap_prof_rate bytes
+ * (on average, the distance between the samples is random) have been
+ * allocated since the previous sample, the object allocated by the next
+ * slow-path allocation (i.e. the one refilling a free list or allocating
+ * a large object) is sampled: the call stack is recorded and the sample
+ * is accounted in the bucket of that stack.  The sampled objects which
+ * are not marked by a collection are dropped from the "in use" counts of
+ * their buckets (as well as the explicitly deallocated ones).  The
+ * profile is written in the legacy text format of the heap profiles
+ * understood by pprof ("heap_v2" sampling).
+ * In the sampled leak detection mode, a sampled object found unreachable
+ * without having been explicitly deallocated is counted as leaked in its
+ * bucket, and the leaks are reported per allocation stack by
+ * GC_print_all_errors.  Unlike GC_find_leak, the unreachable objects are
+ * reclaimed as usual, and the unsampled ones cost nothing extra.
+ */
+
+#ifdef HEAP_PROFILE
+
+#include <errno.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#ifndef HEAP_PROF_DEPTH
+# define HEAP_PROF_DEPTH 32 /* the maximum number of the recorded frames */
+#endif
+
+#define HEAP_PROF_SKIP 2 /* GC_heap_prof_record and GC_heap_prof_sample */
+
+#ifndef HEAP_PROF_TABLE_SIZE
+# define HEAP_PROF_TABLE_SIZE 1024 /* power of two */
+#endif
+
+#ifndef HEAP_PROF_SAMPLES_TABLE_SIZE
+# define HEAP_PROF_SAMPLES_TABLE_SIZE 4096 /* power of two */
+#endif
+
+#define HEAP_PROF_OBJ_HASH(p) \
+        ((((word)(p) >> 4) ^ ((word)(p) >> 16)) \
+         & (HEAP_PROF_SAMPLES_TABLE_SIZE - 1))
+
+#ifndef HEAP_PROF_LEAK_RATE
+# define HEAP_PROF_LEAK_RATE (512 * 1024) /* the default sampling rate */
+#endif
+
+struct heap_prof_bucket {
+    struct heap_prof_bucket *next;
+    word hash;
+    word alloc_count;   /* the numbers and total size of the sampled    */
+    word alloc_bytes;   /* objects allocated at this stack...           */
+    word inuse_count;   /* ...and of those still alive as of the latest */
+    word inuse_bytes;   /* collection (or allocated after it).          */
+    word leak_count;    /* the numbers and total size of the sampled    */
+    word leak_bytes;    /* objects found unreachable while not freed... */
+    word leak_reported; /* ...and the part of leak_count printed.       */
+    int depth;
+    void *pcs[1];       /* actually depth elements */
+};
+
+struct heap_prof_sample {
+    struct heap_prof_sample *next;
+    ptr_t obj;          /* the object base; not seen by the marker      */
+    word size;
+    struct heap_prof_bucket *bucket;
+};
+
+GC_INNER word GC_heap_prof_next_sample = GC_WORD_MAX;
+
+STATIC word GC_heap_prof_rate = 0;
+                        /* The mean distance between the samples (in    */
+                        /* bytes), zero if the profiling is off.        */
+
+STATIC struct heap_prof_bucket **GC_heap_prof_buckets = NULL;
+
+GC_INNER struct heap_prof_sample **GC_heap_prof_samples = NULL;
+                        /* The sampled objects not yet found            */
+                        /* unreachable or deallocated, hashed by the    */
+                        /* address.  Allocated along with the first     */
+                        /* sample.                                      */
+
+STATIC struct heap_prof_sample *GC_heap_prof_free_samples = NULL;
+
+STATIC GC_bool GC_heap_prof_check_leaks = FALSE;
+STATIC word GC_heap_prof_n_leaks = 0;
+
+STATIC word GC_heap_prof_seed = 0x2545F491;
+
+/* Return a pseudo-random number from the exponential distribution with */
+/* the given mean (the distance to the next sample for the Poisson      */
+/* process).  The natural logarithm is approximated piecewise linearly  */
+/* in 1/1024 units which is enough for the sampling.                    */
+STATIC word GC_heap_prof_next_distance(word mean)
+{
+    unsigned u;
+    int msb = 0;
+    word log2_u, e;
+
+    GC_heap_prof_seed ^= GC_heap_prof_seed << 13;
+    GC_heap_prof_seed ^= GC_heap_prof_seed >> 7;
+    GC_heap_prof_seed ^= GC_heap_prof_seed << 17;
+    u = (unsigned)((GC_heap_prof_seed >> 8) & 0xffff) + 1; /* 1 .. 2^16 */
+    while ((u >> (msb + 1)) != 0)
+      msb++;
+    log2_u = (word)msb * 1024 + ((((word)u << 10) >> msb) - 1024);
+    e = ((word)16 * 1024 - log2_u) * 710 / 1024; /* -ln(u / 2^16) * 1024 */
+    if (0 == e) e = 1;
+    return mean / 1024 * e + (mean % 1024) * e / 1024;
+}
+
+STATIC void GC_heap_prof_set_next_sample(void)
+{
+    word total = GC_bytes_allocd + GC_bytes_allocd_before_gc;
+    word d;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    if (0 == GC_heap_prof_rate) {
+      GC_heap_prof_next_sample = GC_WORD_MAX;
+      return;
+    }
+    d = GC_heap_prof_next_distance(GC_heap_prof_rate);
+    GC_heap_prof_next_sample = total < GC_WORD_MAX - d ? total + d
+                                : GC_WORD_MAX - 1;
+}
+
+GC_API void GC_CALL GC_set_heap_profile_rate(size_t bytes)
+{
+    DCL_LOCK_STATE;
+
+    if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+    LOCK();
+    GC_heap_prof_rate = (word)bytes;
+    GC_heap_prof_set_next_sample();
+    UNLOCK();
+}
+
+GC_API size_t GC_CALL GC_get_heap_profile_rate(void)
+{
+    return (size_t)GC_heap_prof_rate;
+}
+
+STATIC struct heap_prof_bucket *GC_heap_prof_get_bucket(void **pcs,
+                                                        int depth)
+{
+    struct heap_prof_bucket *b;
+    word hash = 0;
+    int i;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    if (NULL == GC_heap_prof_buckets) {
+      GC_heap_prof_buckets = (struct heap_prof_bucket **)
+                GC_scratch_alloc(HEAP_PROF_TABLE_SIZE
+                                 * sizeof(struct heap_prof_bucket *));
+      if (NULL == GC_heap_prof_buckets) return NULL;
+      BZERO(GC_heap_prof_buckets,
+            HEAP_PROF_TABLE_SIZE * sizeof(struct heap_prof_bucket *));
+    }
+    for (i = 0; i < depth; i++)
+      hash = (hash ^ (word)pcs[i]) * 31 + (hash >> 17);
+    for (b = GC_heap_prof_buckets[hash & (HEAP_PROF_TABLE_SIZE - 1)];
+         b != NULL; b = b -> next) {
+      if (b -> hash == hash && b -> depth == depth
+          && 0 == memcmp(b -> pcs, pcs, depth * sizeof(void *)))
+        return b;
+    }
+
+    b = (struct heap_prof_bucket *)GC_scratch_alloc(
+                        sizeof(struct heap_prof_bucket)
+                        + (depth > 0 ? depth - 1 : 0) * sizeof(void *));
+    if (NULL == b) return NULL;
+    BZERO(b, sizeof(struct heap_prof_bucket));
+    b -> hash = hash;
+    b -> depth = depth;
+    BCOPY(pcs, b -> pcs, depth * sizeof(void *));
+    b -> next = GC_heap_prof_buckets[hash & (HEAP_PROF_TABLE_SIZE - 1)];
+    GC_heap_prof_buckets[hash & (HEAP_PROF_TABLE_SIZE - 1)] = b;
+    return b;
+}
+
+/* Not inlined to keep the number of the skipped frames constant.      */
+GC_ATTR_NOINLINE STATIC void GC_heap_prof_record(ptr_t p, word lb)
+{
+    void *pcs[HEAP_PROF_DEPTH + HEAP_PROF_SKIP];
+    struct heap_prof_bucket *b;
+    struct heap_prof_sample *s;
+    int depth;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    /* backtrace may call dl_iterate_phdr (see GC_save_callers). */
+    depth = backtrace(pcs, HEAP_PROF_DEPTH + HEAP_PROF_SKIP)
+                - HEAP_PROF_SKIP;
+    if (depth < 0) depth = 0;
+    b = GC_heap_prof_get_bucket(pcs + HEAP_PROF_SKIP, depth);
+    if (NULL == b) return;
+
+    if (NULL == GC_heap_prof_samples) {
+      struct heap_prof_sample **samples = (struct heap_prof_sample **)
+                GC_scratch_alloc(HEAP_PROF_SAMPLES_TABLE_SIZE
+                                 * sizeof(struct heap_prof_sample *));
+
+      if (NULL == samples) return;
+      BZERO(samples,
+            HEAP_PROF_SAMPLES_TABLE_SIZE * sizeof(struct heap_prof_sample *));
+      GC_heap_prof_samples = samples;
+    }
+    s = GC_heap_prof_free_samples;
+    if (s != NULL) {
+      GC_heap_prof_free_samples = s -> next;
+    } else {
+      s = (struct heap_prof_sample *)GC_scratch_alloc(
+                                        sizeof(struct heap_prof_sample));
+      if (NULL == s) return;
+    }
+    s -> obj = (ptr_t)GC_base(p);
+    s -> size = lb;
+    s -> bucket = b;
+    s -> next = GC_heap_prof_samples[HEAP_PROF_OBJ_HASH(s -> obj)];
+    GC_heap_prof_samples[HEAP_PROF_OBJ_HASH(s -> obj)] = s;
+    b -> alloc_count++;
+    b -> alloc_bytes += lb;
+    b -> inuse_count++;
+    b -> inuse_bytes += lb;
+}
+
+GC_ATTR_NO_SANITIZE_THREAD GC_ATTR_NOINLINE
+GC_INNER void GC_heap_prof_sample(void *p, size_t lb)
+{
+    DCL_LOCK_STATE;
+
+    /* A racy pre-check to avoid the lock on most of the refills.       */
+    if (GC_bytes_allocd + GC_bytes_allocd_before_gc
+            < GC_heap_prof_next_sample)
+      return;
+
+    LOCK();
+    if (GC_bytes_allocd + GC_bytes_allocd_before_gc
+            >= GC_heap_prof_next_sample
+        && GC_heap_prof_rate != 0 && GC_base(p) != NULL) {
+      GC_heap_prof_record((ptr_t)p, (word)lb);
+      GC_heap_prof_set_next_sample();
+    }
+    UNLOCK();
+}
+
+STATIC void GC_heap_prof_drop(struct heap_prof_sample **prev)
+{
+    struct heap_prof_sample *s = *prev;
+
+    s -> bucket -> inuse_count--;
+    s -> bucket -> inuse_bytes -= s -> size;
+    *prev = s -> next;
+    s -> next = GC_heap_prof_free_samples;
+    GC_heap_prof_free_samples = s;
+}
+
+GC_ATTR_NO_SANITIZE_THREAD
+GC_INNER void GC_heap_prof_free(void *p)
+{
+    struct heap_prof_sample **prev;
+    DCL_LOCK_STATE;
+
+    /* A racy pre-check: the slot of a sampled object is not empty (the */
+    /* sample has been recorded before the object was returned to the   */
+    /* client).                                                         */
+    if (NULL == GC_heap_prof_samples[HEAP_PROF_OBJ_HASH(p)])
+      return;
+
+    LOCK();
+    for (prev = &GC_heap_prof_samples[HEAP_PROF_OBJ_HASH(p)];
+         *prev != NULL; prev = &((*prev) -> next)) {
+      if ((*prev) -> obj == (ptr_t)p) {
+        GC_heap_prof_drop(prev);
+        break;
+      }
+    }
+    UNLOCK();
+}
+
+GC_INNER void GC_heap_prof_after_mark(void)
+{
+    GC_bool found_leaks = FALSE;
+    int i;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    for (i = 0; GC_heap_prof_samples != NULL
+                && i < HEAP_PROF_SAMPLES_TABLE_SIZE; i++) {
+      struct heap_prof_sample **prev = &GC_heap_prof_samples[i];
+      struct heap_prof_sample *s;
+
+      while ((s = *prev) != NULL) {
+        if (GC_base(s -> obj) != s -> obj) {
+          /* The block has been deallocated, e.g. by GC_free_n_inner. */
+        } else if (GC_is_marked(s -> obj)) {
+          prev = &(s -> next);
+          continue;
+        } else if (GC_heap_prof_check_leaks) {
+          s -> bucket -> leak_count++;
+          s -> bucket -> leak_bytes += s -> size;
+          GC_heap_prof_n_leaks++;
+          found_leaks = TRUE;
+        }
+        GC_heap_prof_drop(prev);
+      }
+    }
+    if (found_leaks) GC_SET_HAVE_ERRORS();
+}
+
+GC_INNER GC_bool GC_heap_prof_print_leaks(void)
+{
+    struct heap_prof_bucket *b;
+    GC_bool printed = FALSE;
+    int i, j;
+    DCL_LOCK_STATE;
+
+    LOCK();
+    for (i = 0; GC_heap_prof_buckets != NULL && i < HEAP_PROF_TABLE_SIZE;
+         i++) {
+      for (b = GC_heap_prof_buckets[i]; b != NULL; b = b -> next) {
+        if (b -> leak_count == b -> leak_reported) continue;
+
+        GC_err_printf("Leaked %lu sampled objects (%lu in total, %lu bytes)"
+                      " allocated at:\n",
+                      (unsigned long)(b -> leak_count - b -> leak_reported),
+                      (unsigned long)b -> leak_count,
+                      (unsigned long)b -> leak_bytes);
+        for (j = 0; j < b -> depth; j++)
+          GC_err_printf("\t%p\n", b -> pcs[j]);
+        b -> leak_reported = b -> leak_count;
+        printed = TRUE;
+      }
+    }
+    UNLOCK();
+    return printed;
+}
+
+GC_API void GC_CALL GC_set_sampled_leak_check(int value)
+{
+    DCL_LOCK_STATE;
+
+    if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+    LOCK();
+    GC_heap_prof_check_leaks = (GC_bool)(value != 0);
+    if (GC_heap_prof_check_leaks && 0 == GC_heap_prof_rate) {
+      GC_heap_prof_rate = HEAP_PROF_LEAK_RATE;
+      GC_heap_prof_set_next_sample();
+    }
+    UNLOCK();
+}
+
+GC_API int GC_CALL GC_get_sampled_leak_check(void)
+{
+    return (int)GC_heap_prof_check_leaks;
+}
+
+GC_API size_t GC_CALL GC_get_sampled_leak_count(void)
+{
+    word n;
+    DCL_LOCK_STATE;
+
+    LOCK();
+    n = GC_heap_prof_n_leaks;
+    UNLOCK();
+    return (size_t)n;
+}
+
+STATIC int GC_heap_prof_write(int fd, const char *buf, size_t len)
+{
+    while (len > 0) {
+      ssize_t n = write(fd, buf, len);
+
+      if (n < 0) {
+        if (EINTR == errno || EAGAIN == errno) continue;
+        return -1;
+      }
+      buf += n;
+      len -= (size_t)n;
+    }
+    return 0;
+}
+
+STATIC int GC_heap_prof_write_maps(int fd)
+{
+    char buf[4096];
+    int maps_fd = open("/proc/self/maps", O_RDONLY);
+    int result = 0;
+
+    if (maps_fd < 0) return -1;
+    for (;;) {
+      ssize_t n = read(maps_fd, buf, sizeof(buf));
+
+      if (n <= 0) {
+        if (n < 0 && EINTR == errno) continue;
+        if (n < 0) result = -1;
+        break;
+      }
+      if (GC_heap_prof_write(fd, buf, (size_t)n) < 0) {
+        result = -1;
+        break;
+      }
+    }
+    (void)close(maps_fd);
+    return result;
+}
+
+GC_API int GC_CALL GC_write_heap_profile(const char *path)
+{
+    struct heap_prof_bucket *b;
+    word inuse_count = 0, inuse_bytes = 0;
+    word alloc_count = 0, alloc_bytes = 0;
+    char buf[64];
+    int fd, i, j;
+    int result = 0;
+    IF_CANCEL(int cancel_state;)
+    DCL_LOCK_STATE;
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+    DISABLE_CANCEL(cancel_state);
+    LOCK();
+    for (i = 0; GC_heap_prof_buckets != NULL && i < HEAP_PROF_TABLE_SIZE;
+         i++) {
+      for (b = GC_heap_prof_buckets[i]; b != NULL; b = b -> next) {
+        inuse_count += b -> inuse_count;
+        inuse_bytes += b -> inuse_bytes;
+        alloc_count += b -> alloc_count;
+        alloc_bytes += b -> alloc_bytes;
+      }
+    }
+    (void)snprintf(buf, sizeof(buf), "heap profile: %lu: %lu [%lu: %lu]",
+                   (unsigned long)inuse_count, (unsigned long)inuse_bytes,
+                   (unsigned long)alloc_count, (unsigned long)alloc_bytes);
+    result |= GC_heap_prof_write(fd, buf, strlen(buf));
+    (void)snprintf(buf, sizeof(buf), " @ heap_v2/%lu\n",
+                   (unsigned long)GC_heap_prof_rate);
+    result |= GC_heap_prof_write(fd, buf, strlen(buf));
+
+    for (i = 0; GC_heap_prof_buckets != NULL && i < HEAP_PROF_TABLE_SIZE
+                && 0 == result; i++) {
+      for (b = GC_heap_prof_buckets[i]; b != NULL; b = b -> next) {
+        (void)snprintf(buf, sizeof(buf), "%lu: %lu [%lu: %lu] @",
+                       (unsigned long)b -> inuse_count,
+                       (unsigned long)b -> inuse_bytes,
+                       (unsigned long)b -> alloc_count,
+                       (unsigned long)b -> alloc_bytes);
+        result |= GC_heap_prof_write(fd, buf, strlen(buf));
+        for (j = 0; j < b -> depth; j++) {
+          (void)snprintf(buf, sizeof(buf), " %p", b -> pcs[j]);
+          result |= GC_heap_prof_write(fd, buf, strlen(buf));
+        }
+        result |= GC_heap_prof_write(fd, "\n", 1);
+      }
+    }
+    UNLOCK();
+
+    if (0 == result) {
+      static const char maps_hdr[] = "\nMAPPED_LIBRARIES:\n";
+
+      result = GC_heap_prof_write(fd, maps_hdr, sizeof(maps_hdr) - 1);
+      if (0 == result)
+        result = GC_heap_prof_write_maps(fd);
+    }
+    if (close(fd) < 0) result = -1;
+    RESTORE_CANCEL(cancel_state);
+    return result != 0 ? -1 : 0;
+}
+
+#else /* !HEAP_PROFILE */
+
+GC_API void GC_CALL GC_set_heap_profile_rate(size_t bytes)
+{
+    UNUSED_ARG(bytes);
+}
+
+GC_API size_t GC_CALL GC_get_heap_profile_rate(void)
+{
+    return 0;
+}
+
+GC_API int GC_CALL GC_write_heap_profile(const char *path)
+{
+    UNUSED_ARG(path);
+    return -1;
+}
+
+GC_API void GC_CALL GC_set_sampled_leak_check(int value)
+{
+    UNUSED_ARG(value);
+}
+
+GC_API int GC_CALL GC_get_sampled_leak_check(void)
+{
+    return 0;
+}
+
+GC_API size_t GC_CALL GC_get_sampled_leak_count(void)
+{
+    return 0;
+}
+
+#endif /* !HEAP_PROFILE */
+
+/*
+ * Heap snapshot.  The reachable objects (as found by a full collection)
+ * are written with the world stopped in a compact binary format (see
+ * tools/heapsnap.c for a reader):
+ *   header: "GCSNAP1\0", varint(sizeof(word)), varint(GC_gc_no);
+ *   object: 1, zz(addr - prev_addr), varint(size), varint(kind), edges;
+ *   root:   2, varint(start), varint(length), edges;
+ *   end:    0;
+ * where varint is LEB128, zz is the zigzag encoding of a signed value,
+ * and edges is a list of varint(zz(target - addr) + 1) terminated by 0
+ * (addr is that of the object or the root range).  The edges are the
+ * words of the object (or the static root range) pointing into the
+ * reachable objects, each one resolved to the object base.  Thread
+ * stacks and registers are not dumped, thus the reachable objects not
+ * referenced from the heap or the static roots are referenced from
+ * them (or are the thread-local free list entries).
+ */
+
+#ifndef HEAP_SNAPSHOT_BUF_SIZE
+# define HEAP_SNAPSHOT_BUF_SIZE 8192
+#endif
+
+struct heap_snapshot_s {
+    GC_heap_snapshot_write_proc write_proc;
+    void *client_data;
+    int error;
+    size_t len;
+    word prev_addr;
+    unsigned char buf[HEAP_SNAPSHOT_BUF_SIZE];
+};
+
+STATIC void GC_snapshot_flush(struct heap_snapshot_s *hs)
+{
+    if (hs -> len > 0 && 0 == hs -> error
+        && hs -> write_proc(hs -> buf, hs -> len, hs -> client_data) != 0)
+      hs -> error = 1;
+    hs -> len = 0;
+}
+
+STATIC void GC_snapshot_put_varint(struct heap_snapshot_s *hs, word v)
+{
+    if (hs -> len + (CPP_WORDSZ + 6) / 7 > HEAP_SNAPSHOT_BUF_SIZE)
+      GC_snapshot_flush(hs);
+    while (v >= 0x80) {
+      hs -> buf[hs -> len++] = (unsigned char)(v | 0x80);
+      v >>= 7;
+    }
+    hs -> buf[hs -> len++] = (unsigned char)v;
+}
+
+#define ZIGZAG(d) (((word)(d) << 1) ^ (word)((signed_word)(d) \
+                                            >> (CPP_WORDSZ - 1)))
+
+/* Write the references from the given range to the reachable objects, */
+/* then the terminating zero.                                           */
+STATIC void GC_snapshot_put_edges(struct heap_snapshot_s *hs,
+                                  ptr_t start, ptr_t end, word origin)
+{
+    ptr_t q;
+
+    for (q = start; (word)q + sizeof(word) <= (word)end;
+         q += sizeof(word)) {
+      word v = *(word *)q;
+      ptr_t base;
+
+      if (v < (word)GC_least_plausible_heap_addr
+          || v >= (word)GC_greatest_plausible_heap_addr)
+        continue;
+      base = (ptr_t)GC_base((void *)v);
+      if (base != NULL && GC_is_marked(base))
+        GC_snapshot_put_varint(hs, ZIGZAG((word)base - origin) + 1);
+    }
+    GC_snapshot_put_varint(hs, 0);
+}
+
+STATIC void GC_CALLBACK GC_snapshot_block(struct hblk *h, GC_word client_data)
+{
+    struct heap_snapshot_s *hs = (struct heap_snapshot_s *)client_data;
+    hdr *hhdr = HDR(h);
+    size_t sz = (size_t)hhdr -> hb_sz;
+    size_t bit_no;
+    ptr_t p, plim;
+
+    if (hs -> error) return;
+    VALIDATE_MARKS(hhdr);
+    if (GC_block_empty(hhdr)) return;
+    p = h -> hb_body;
+    plim = sz > MAXOBJBYTES ? p : h -> hb_body + HBLKSIZE - sz;
+    for (bit_no = 0; (word)p <= (word)plim;
+         bit_no += MARK_BIT_OFFSET(sz), p += sz) {
+      if (!mark_bit_from_hdr(hhdr, bit_no)) continue;
+
+      GC_snapshot_put_varint(hs, 1);
+      GC_snapshot_put_varint(hs, ZIGZAG((word)p - hs -> prev_addr));
+      GC_snapshot_put_varint(hs, (word)sz);
+      GC_snapshot_put_varint(hs, (word)hhdr -> hb_obj_kind);
+      if (hhdr -> hb_descr != 0) {
+        GC_snapshot_put_edges(hs, p, p + sz, (word)p);
+      } else {
+        GC_snapshot_put_varint(hs, 0);
+      }
+      hs -> prev_addr = (word)p;
+    }
+}
+
+GC_API int GC_CALL GC_write_heap_snapshot(GC_heap_snapshot_write_proc fn,
+                                          void *client_data)
+{
+    static const char magic[] = "GCSNAP1";
+    struct heap_snapshot_s hs;
+    int i;
+    IF_CANCEL(int cancel_state;)
+    DCL_LOCK_STATE;
+
+    if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+    hs.write_proc = fn;
+    hs.client_data = client_data;
+    hs.error = 0;
+    hs.len = 0;
+    hs.prev_addr = 0;
+
+    LOCK();
+    /* A full collection makes the mark bits denote the reachable      */
+    /* objects; the marking is done by the parallel markers if any.    */
+    DISABLE_CANCEL(cancel_state);
+    ENTER_GC();
+    if (GC_dont_gc || !GC_try_to_collect_inner(GC_never_stop_func))
+      hs.error = 1;
+    EXIT_GC();
+#   ifdef PARALLEL_MARK
+      if (GC_parallel)
+        GC_wait_for_reclaim();
+#   endif
+#   ifdef THREAD_LOCAL_SWEEP
+      GC_wait_for_sweep_claims();
+#   endif
+
+    if (0 == hs.error) {
+      STOP_WORLD();
+      BCOPY(magic, hs.buf, sizeof(magic));
+      hs.len = sizeof(magic);
+      GC_snapshot_put_varint(&hs, sizeof(word));
+      GC_snapshot_put_varint(&hs, GC_gc_no);
+      GC_apply_to_all_blocks(GC_snapshot_block, (word)&hs);
+      for (i = 0; i < n_root_sets; i++) {
+        ptr_t start = GC_static_roots[i].r_start;
+        ptr_t end = GC_static_roots[i].r_end;
+
+        GC_snapshot_put_varint(&hs, 2);
+        GC_snapshot_put_varint(&hs, (word)start);
+        GC_snapshot_put_varint(&hs, (word)(end - start));
+        GC_snapshot_put_edges(&hs, start, end, (word)start);
+      }
+      GC_snapshot_put_varint(&hs, 0);
+      GC_snapshot_flush(&hs);
+      START_WORLD();
+    }
+    UNLOCK();
+    RESTORE_CANCEL(cancel_state);
+    return hs.error ? -1 : 0;
+}
@@ -138,6 +138,15 @@ CORD_API CORD CORD_substr(CORD x, size_t i, size_t n);
 /* modified; only the result is balanced.                               */
 CORD_API CORD CORD_balance(CORD x);
 
+/* Turn on (if value is nonzero) or off the balanced concatenation      */
+/* mode.  In this mode, CORD_cat and CORD_cat_char_star keep the depths */
+/* of the sibling subcords different by at most one (like in an AVL     */
+/* tree) by reallocating O(log n) nodes on each concatenation, instead  */
+/* of rebalancing the whole result by CORD_balance once it becomes too  */
+/* deep.  Thus a long series of appends has no latency spikes.  Off by  */
+/* default.  Not synchronized.                                          */
+CORD_API void CORD_set_balanced_cat(int value);
+
 /* The following traverse a cord by applying a function to each         */
 /* character.  This is occasionally appropriate, especially where       */
 /* speed is crucial.  But, since C doesn't have nested functions,       */
@@ -167,6 +176,22 @@ CORD_API int CORD_iter5(CORD x, size_t i, CORD_iter_fn f1,
 CORD_API int CORD_iter(CORD x, CORD_iter_fn f1, void * client_data);
 #define CORD_iter(x, f1, cd) CORD_iter5(x, 0, f1, CORD_NO_FN, cd)
 
+/* Function to apply to contiguous spans of a cord.  The span is not    */
+/* NUL-terminated (and might contain NUL characters), it is valid only  */
+/* during the call.                                                     */
+typedef int (* CORD_chunk_iter_fn)(const char * s, size_t len,
+                                   void * client_data);
+
+/* Apply f to the consecutive spans of the cord, in ascending order,    */
+/* starting at position i.  The spans of flat strings and of directly   */
+/* accessible function nodes (e.g. produced by CORD_from_file_mmap) are */
+/* passed as is, the other function nodes are materialized piecewise to */
+/* a small buffer.  Terminates as soon as f returns nonzero, in which   */
+/* case returns nonzero too, otherwise returns 0.  The specified value  */
+/* of i must be < CORD_len(x).                                          */
+CORD_API int CORD_iter_chunks(CORD x, size_t i, CORD_chunk_iter_fn f,
+                              void * client_data);
+
 /* Similar to CORD_iter5, but end-to-beginning.  No provisions for      */
 /* CORD_batched_iter_fn.                                                */
 CORD_API int CORD_riter4(CORD x, size_t i, CORD_iter_fn f1, void * client_data);
@@ -228,6 +253,22 @@ CORD_API int CORD_riter(CORD x, CORD_iter_fn f1, void * client_data);
 #define CORD_FOR(pos, cord) \
     for (CORD_set_pos(pos, cord, 0); CORD_pos_valid(pos); CORD_next(pos))
 
+/* An index of the leaves of a cord for random access.  Unlike CORD_pos, */
+/* it is immutable once built, thus it may be shared by any number of   */
+/* threads reading the same cord concurrently.  CORD_index_fetch finds  */
+/* the leaf by binary search over the leaf offsets (O(log leaves))      */
+/* instead of walking the cord from the root.  The index keeps the cord */
+/* alive.                                                               */
+typedef struct CORD_index_s * CORD_index;
+
+/* Build the index of x.  Takes time and space linear in the number of  */
+/* leaves of x.  Returns 0 for the empty cord.                          */
+CORD_API CORD_index CORD_index_new(CORD x);
+
+/* Same as CORD_fetch(x, i) where x is the indexed cord.  i should be   */
+/* less than CORD_len(x).                                               */
+CORD_API char CORD_index_fetch(CORD_index ix, size_t i);
+
 
 /* An out of memory handler to call.  May be supplied by client.        */
 /* Must not return.                                                     */
@@ -295,6 +336,15 @@ CORD_API CORD CORD_from_file_eager(FILE * f);
 /* demand.  The binary mode restriction applies.                        */
 CORD_API CORD CORD_from_file_lazy(FILE * f);
 
+/* Same as CORD_from_file_lazy, except that the file is memory-mapped   */
+/* (if supported by the platform), thus the characters are accessed     */
+/* without stdio calls, and iteration over the resulting cord scans     */
+/* the mapped memory directly.  The file should not be truncated while  */
+/* the cord is in use.  The file is unmapped (and f is closed) when the */
+/* result becomes inaccessible.  Falls back to CORD_from_file_lazy if   */
+/* mapping fails.                                                       */
+CORD_API CORD CORD_from_file_mmap(FILE * f);
+
 /* Turn a cord into a C string. The result shares no structure with     */
 /* x, and is thus modifiable.                                           */
 CORD_API char * CORD_to_char_star(CORD x);
@@ -312,6 +362,31 @@ CORD_API const char * CORD_to_const_char_star(CORD x);
 /* Returns EOF if a write error occurs, 1 otherwise.                    */
 CORD_API int CORD_put(CORD x, FILE * f);
 
+#if !defined(CORD_NO_IOVEC) && !defined(CORD_IOVEC) \
+    && (defined(__unix__) || defined(__APPLE__) || defined(__CYGWIN__))
+# define CORD_IOVEC
+#endif
+
+#ifdef CORD_IOVEC
+  struct iovec;
+
+  /* Fill iov (up to n entries) with the consecutive spans of x starting */
+  /* at position i, without copying the flat strings of x.  The parts   */
+  /* of the function nodes not accessible directly are materialized to  */
+  /* newly allocated strings, the references to which are held only by  */
+  /* iov, thus iov should be visible to the collector (e.g., be on the  */
+  /* stack) while in use.  The position after the last stored span is   */
+  /* saved to *pnext (it equals CORD_len(x) if no more spans remain).   */
+  /* Returns the number of the filled entries.                          */
+  CORD_API size_t CORD_to_iovec(CORD x, size_t i, struct iovec * iov,
+                                size_t n, size_t * pnext);
+
+  /* Write a cord to the file descriptor fd by writev calls (retried on */
+  /* interrupts and partial writes).  Returns EOF if a write error      */
+  /* occurs (errno is set by writev), 1 otherwise.                      */
+  CORD_API int CORD_writev(int fd, CORD x);
+#endif
+
 /* "Not found" result for the following two functions.                  */
 #define CORD_NOT_FOUND ((size_t)(-1))
 
@@ -80,6 +80,75 @@ void CORD_ec_flush_buf(CORD_ec x);
 /* original.                                                            */
 void CORD_ec_append_cord(CORD_ec x, CORD s);
 
+/* Cord builders are an alternative to extensible cords for building    */
+/* large cords.  The characters are accumulated in buffers which double */
+/* in size (starting from CORD_BUFSZ) up to CORD_BUILDER_MAX_BUFSZ, and */
+/* a full buffer becomes a leaf as is (without copying).  The leaves    */
+/* are combined pairwise as they are produced (like the digits of       */
+/* a binary counter), thus CORD_builder_finish returns a balanced cord  */
+/* without a separate CORD_balance pass.                                */
+/*
+ * A client might look like:
+ *
+ *      {
+ *          CORD_builder b;
+ *          CORD result;
+ *
+ *          CORD_builder_init(b);
+ *          while(...) {
+ *              ...
+ *              CORD_builder_append(b, c);
+ *              ...
+ *              CORD_builder_append_span(b, s, len);
+ *          }
+ *          result = CORD_builder_finish(b);
+ */
+
+# ifndef CORD_BUILDER_MAX_BUFSZ
+#   define CORD_BUILDER_MAX_BUFSZ (1024 * 1024)
+# endif
+
+# define CORD_BUILDER_STACK_SZ (8 * sizeof(size_t))
+
+typedef struct CORD_builder_struct {
+    char * cb_buf;          /* The current buffer, or NULL.             */
+    char * cb_bufptr;
+    char * cb_buflim;       /* The end of the current buffer.           */
+    size_t cb_bufsz;        /* Size of the next buffer to allocate.     */
+    size_t cb_n;            /* Number of entries in cb_stack.           */
+    CORD cb_stack[CORD_BUILDER_STACK_SZ];
+                            /* The cords built so far (to be            */
+                            /* concatenated in this order), each one    */
+                            /* combining 2**cb_levels[i] leaves.        */
+    unsigned char cb_levels[CORD_BUILDER_STACK_SZ];
+} CORD_builder[1];
+
+/* Initialize a cord builder.   */
+CORD_API void CORD_builder_init(CORD_builder b);
+
+/* Flush the current buffer (if full) and allocate a new one.  Called   */
+/* by CORD_builder_append.                                              */
+CORD_API void CORD_builder_grow(CORD_builder b);
+
+/* Append a character to a cord builder.        */
+#define CORD_builder_append(b, c) \
+                ((void)((b)[0].cb_bufptr == (b)[0].cb_buflim \
+                        ? (CORD_builder_grow(b), 0) : 0), \
+                 (void)(*(b)[0].cb_bufptr++ = (c)))
+
+/* Append len characters starting at s.  The characters are copied.     */
+/* Like for CORD_builder_append, the characters should not be NUL (use  */
+/* CORD_builder_append_cord with CORD_nul instead).                     */
+CORD_API void CORD_builder_append_span(CORD_builder b, const char * s,
+                                       size_t len);
+
+/* Append a cord to a cord builder.  Structure remains shared with      */
+/* original.                                                            */
+CORD_API void CORD_builder_append_cord(CORD_builder b, CORD x);
+
+/* Return the cord built so far, and reinitialize the builder.          */
+CORD_API CORD CORD_builder_finish(CORD_builder b);
+
 #ifdef __cplusplus
   } /* extern "C" */
 #endif
@@ -111,6 +111,90 @@ GC_API int GC_CALL GC_get_parallel(void);
 /* the marker threads.  Does not use any synchronization.               */
 GC_API void GC_CALL GC_set_markers_count(unsigned);
 
+/* Turn on/off the parallel reclaim mode.  In this mode, the collector  */
+/* sweeps all the small-object blocks at the end of each collection     */
+/* (instead of deferring it to the allocator) partitioning the work     */
+/* among the marker threads.  The mode has effect only if the parallel  */
+/* marker is running and the collector is not in the incremental mode   */
+/* backed by the virtual dirty bits.  Off by default unless the         */
+/* GC_PARALLEL_RECLAIM environment variable is set.  The time spent in  */
+/* the parallel sweep is reported by GC_get_prof_stats.  The functions  */
+/* do not use any synchronization.                                      */
+GC_API void GC_CALL GC_set_parallel_reclaim(int);
+GC_API int GC_CALL GC_get_parallel_reclaim(void);
+
+/* Turn on/off the lazy clear mode of the parallel reclaim.  In this    */
+/* mode, the marker threads sweep only the blocks of the kinds which    */
+/* free objects are not cleared (e.g. the atomic ones), the rest are    */
+/* left to the allocator, so that the objects are cleared by a thread   */
+/* refilling its free list (in bulk, shortly before they are handed     */
+/* out) instead of during the collection.  Has no effect unless the     */
+/* parallel reclaim mode is on.  Off by default unless the              */
+/* GC_LAZY_CLEAR environment variable is set.  The functions do not use */
+/* any synchronization.                                                 */
+GC_API void GC_CALL GC_set_lazy_clear(int);
+GC_API int GC_CALL GC_get_lazy_clear(void);
+
+/* Turn on/off the bump-pointer allocation mode.  In this mode (which   */
+/* has effect only if the collector is built with the thread-local      */
+/* allocation support), the small atomic and normal objects are carved  */
+/* by each thread out of a fresh heap block (of the objects of the same */
+/* size) by incrementing a pointer instead of popping a free list, when */
+/* the allocator would take a fresh block anyway (i.e. there are no     */
+/* reclaimed objects of the size).  The rest of the block is kept by    */
+/* the thread till it is exhausted.  Not used in the manual VDB mode.   */
+/* Off by default unless the GC_BUMP_ALLOC environment variable is set. */
+/* Affects subsequent allocations.  The functions do not use any        */
+/* synchronization.                                                     */
+GC_API void GC_CALL GC_set_bump_alloc(int);
+GC_API int GC_CALL GC_get_bump_alloc(void);
+
+/* Request the NUMA mode (if the argument is non-zero).  In this mode   */
+/* (supported on Linux if the parallel marker is built in), each heap   */
+/* section is bound to the NUMA node of the thread that caused the heap */
+/* growth, the free heap blocks are kept on per-node lists (the blocks  */
+/* of the node the allocating thread runs on are preferred), and the    */
+/* marker threads are pinned to the nodes round-robin, stealing the     */
+/* marking work from markers of the same node first.  Has effect only   */
+/* if called before GC initialization; the mode is also requested if   */
+/* the GC_NUMA environment variable is set.  GC_get_numa_mode returns   */
+/* the number of nodes if the mode is on, zero otherwise.  The          */
+/* functions do not use any synchronization.                            */
+GC_API void GC_CALL GC_set_numa_mode(int);
+GC_API int GC_CALL GC_get_numa_mode(void);
+
+/* Turn on/off the huge pages mode.  In this mode (supported on Linux   */
+/* only), the heap is grown in 2 MiB-aligned chunks (of a multiple of   */
+/* 2 MiB) advised to be backed by the transparent huge pages, and only  */
+/* whole huge pages of free heap blocks are returned to the OS (if      */
+/* unmapping is enabled) so that they are not split.  Reduces TLB       */
+/* misses (e.g. during marking) on large heaps at the expense of a      */
+/* coarser heap growth.  Should be called before GC initialization;     */
+/* the mode is also turned on if the GC_HUGE_PAGES environment          */
+/* variable is set.  The getter returns non-zero if the mode is on.     */
+GC_API void GC_CALL GC_set_huge_pages(int);
+GC_API int GC_CALL GC_get_huge_pages(void);
+
+/* Set the large-object space threshold.  Each object of at least the   */
+/* given size (in bytes) is allocated in its own memory mapping outside */
+/* the regular heap sections (supported on Linux only), and the mapping */
+/* is released to the OS as soon as the object is found unreachable (or */
+/* is explicitly deallocated), i.e. without waiting for the unmapping   */
+/* of old free blocks.  Thus huge objects do not fragment the heap.     */
+/* Pages of such objects are not write-protected, so they are always    */
+/* treated as dirty in the incremental mode.  Zero (the default unless  */
+/* the GC_LARGE_OBJECT_THRESHOLD environment variable is set) turns the */
+/* space off.  A value not exceeding a few heap blocks is not advisable */
+/* as each allocation in the space costs a system call.  The setter     */
+/* acquires the GC lock, the getter does not.                           */
+GC_API void GC_CALL GC_set_large_object_threshold(size_t);
+GC_API size_t GC_CALL GC_get_large_object_threshold(void);
+
+/* Return the total size of the memory mappings of the large-object     */
+/* space (this amount is included in the heap size).  Acquires the GC   */
+/* lock.                                                                */
+GC_API size_t GC_CALL GC_get_large_object_space_bytes(void);
+
 /* Public R/W variables */
 /* The supplied setter and getter functions are preferred for new code. */
 
@@ -302,6 +386,23 @@ GC_API GC_ATTR_DEPRECATED GC_word GC_non_gc_bytes;
 GC_API void GC_CALL GC_set_non_gc_bytes(GC_word);
 GC_API GC_word GC_CALL GC_get_non_gc_bytes(void);
 
+/* Report the memory allocated outside the GC heap (e.g. by malloc or   */
+/* mmap) which is owned by the collectible objects and released when    */
+/* they are reclaimed (e.g. by a finalizer or a disclaim procedure).    */
+/* delta is positive when such memory is acquired, and negative when it */
+/* is released.  The growth of the external memory since the recent    */
+/* collection is counted as allocation to decide when to collect next,  */
+/* and the total amount is counted in the heap size compared against    */
+/* the soft heap limit.  Thus the collector runs often enough even if   */
+/* the objects holding the memory are small.  Does not acquire the      */
+/* allocation lock (if the atomic operations are available), so it may  */
+/* be called from a disclaim procedure.                                 */
+GC_API void GC_CALL GC_adjust_external_bytes(GC_signed_word /* delta */);
+
+/* Return the current amount of the external memory reported by the     */
+/* above function (or 0 if more was released than acquired).            */
+GC_API GC_word GC_CALL GC_get_external_bytes(void);
+
 GC_API GC_ATTR_DEPRECATED int GC_no_dls;
                         /* Do not register dynamic library data         */
                         /* segments automatically.  Also, if set by the */
@@ -381,6 +482,21 @@ GC_API GC_ATTR_DEPRECATED int GC_dont_precollect;
 GC_API void GC_CALL GC_set_dont_precollect(int);
 GC_API int GC_CALL GC_get_dont_precollect(void);
 
+/* Set/get the fast-startup mode (off by default unless the collector   */
+/* is built with FAST_STARTUP macro defined, or GC_FAST_STARTUP         */
+/* environment variable is set).  In this mode, GC_init does only the   */
+/* work every allocation needs: the initial collection is skipped (as   */
+/* if GC_dont_precollect is set), the initial heap expansion is         */
+/* postponed till the first allocation, the main static data roots are  */
+/* registered at the first collection, and the cheapest available way   */
+/* is used to find the main stack bottom.  This is intended for short-  */
+/* lived programs.  Has no effect on the heap expansion and the root    */
+/* registration if the incremental mode is turned on at initialization. */
+/* The setter should be called before GC_INIT(); the setter and getter  */
+/* are unsynchronized.                                                  */
+GC_API void GC_CALL GC_set_fast_startup(int);
+GC_API int GC_CALL GC_get_fast_startup(void);
+
 GC_API GC_ATTR_DEPRECATED unsigned long GC_time_limit;
                                /* If incremental collection is enabled, */
                                /* we try to terminate collections       */
@@ -392,7 +508,10 @@ GC_API GC_ATTR_DEPRECATED unsigned long GC_time_limit;
                                /* GC_TIME_UNLIMITED will essentially    */
                                /* disable incremental collection while  */
                                /* leaving generational collection       */
-                               /* enabled.                              */
+                               /* enabled.  The limit also applies to   */
+                               /* the examination of the heap blocks at */
+                               /* the sweep start, the rest of which is */
+                               /* done by the subsequent allocations.   */
 #define GC_TIME_UNLIMITED 999999
                                /* Setting GC_time_limit to this value   */
                                /* will disable the "pause time exceeded"*/
@@ -442,8 +561,9 @@ GC_API void GC_CALL GC_set_allocd_bytes_per_finalizer(GC_word);
 GC_API GC_word GC_CALL GC_get_allocd_bytes_per_finalizer(void);
 
 /* Tell the collector to start various performance measurements.        */
-/* Only the total time taken by full collections is calculated, as      */
-/* of now.  And, currently, there is no way to stop the measurements.   */
+/* The total time taken by full collections, the world-stopped pauses   */
+/* histogram and the per-collection phase times are calculated, as of   */
+/* now.  And, currently, there is no way to stop the measurements.      */
 /* The function does not use any synchronization.  Defined only if the  */
 /* library has been compiled without NO_CLOCK.                          */
 GC_API void GC_CALL GC_start_performance_measurement(void);
@@ -455,6 +575,120 @@ GC_API void GC_CALL GC_start_performance_measurement(void);
 /* library has been compiled without NO_CLOCK.                          */
 GC_API unsigned long GC_CALL GC_get_full_gc_total_time(void);
 
+/* The number of buckets of the pause time histogram.  The buckets are  */
+/* logarithmic with 4 linear sub-buckets per each power of two (i.e.    */
+/* the relative precision is 25%), GC_PAUSE_BUCKET_LOWER_US(i) is the   */
+/* lower bound (in microseconds) of the pauses counted in i-th bucket.  */
+/* The last bucket also counts all the longer pauses.                   */
+#define GC_PAUSE_HIST_BUCKETS 128
+#define GC_PAUSE_BUCKET_LOWER_US(i) \
+        ((i) < 4 ? (GC_word)(i) : (GC_word)(4 + (i) % 4) << ((i) / 4 - 1))
+
+/* The statistics of the world-stopped marking pauses (the times are    */
+/* in nanoseconds).                                                     */
+struct GC_pause_stats_s {
+  GC_word n_pauses;
+  GC_word max_pause_ns;
+  GC_word total_pause_ns;
+                /* Note: this one wraps around on overflow.             */
+  GC_word histogram[GC_PAUSE_HIST_BUCKETS];
+};
+
+/* Get a snapshot of the pause statistics collected since the start of  */
+/* the performance measurements (or since the last reset).  A non-zero  */
+/* reset argument instructs the collector to clear the statistics after */
+/* copying them (pstats may be NULL to just reset them).  Acquires the  */
+/* allocator lock.  Defined only if the library has been compiled       */
+/* without NO_CLOCK.                                                    */
+GC_API void GC_CALL GC_get_pause_stats(struct GC_pause_stats_s * /* pstats */,
+                                       int /* reset */);
+
+/* The breakdown of a collection (cycle) duration by phases, in         */
+/* nanoseconds.  If a collection consists of several world-stopped      */
+/* pauses (e.g. in the incremental mode), then the values of the first  */
+/* four fields are the sums over all the pauses of the collection.      */
+/* Note: the reclaim phase time does not include the lazy sweeping      */
+/* performed later during the allocation.                               */
+struct GC_phase_times_s {
+  GC_word gc_no;        /* the collection number (see GC_get_gc_no)     */
+  GC_word stop_world_ns; /* time to stop all the mutator threads        */
+  GC_word root_scan_ns; /* time to push the roots (including stacks)    */
+  GC_word mark_ns;      /* marking time (excluding the root scan)       */
+  GC_word pause_ns;     /* total duration of the world-stopped pauses   */
+  GC_word finalize_ns;  /* finalization processing time                 */
+  GC_word reclaim_ns;   /* time to initiate sweep (reclaim)             */
+};
+
+/* Get the phase times of the last completed collection.  The result    */
+/* is meaningful only if the performance measurements were started      */
+/* before the collection (otherwise all the fields are zero).  Acquires */
+/* the allocator lock.  Defined only if the library has been compiled   */
+/* without NO_CLOCK.                                                    */
+GC_API void GC_CALL GC_get_last_phase_times(struct GC_phase_times_s *);
+
+/* The hardware performance counter values (the events are counted in  */
+/* the user mode only; a value is zero if the event is not supported by */
+/* the CPU or the kernel).                                              */
+struct GC_perf_counts_s {
+  GC_word cycles;
+  GC_word instructions;
+  GC_word llc_misses;   /* last-level cache misses                      */
+  GC_word dtlb_misses;  /* data TLB load misses                         */
+};
+
+/* The hardware performance counters of a collection by phases.         */
+struct GC_phase_counters_s {
+  GC_word gc_no;        /* the collection number (see GC_get_gc_no)     */
+  struct GC_perf_counts_s mark;
+                /* world-stopped marking (including the root scan) by   */
+                /* the collecting thread                                */
+  struct GC_perf_counts_s markers;
+                /* work of the marker threads, i.e. the parallel        */
+                /* marking and sweeping (the sum over all of them)      */
+  struct GC_perf_counts_s finalize; /* finalization processing          */
+  struct GC_perf_counts_s reclaim;  /* sweep initiation (reclaim)       */
+};
+
+/* Get the hardware performance counters (cycles, instructions, cache   */
+/* and TLB misses) of the phases of the last completed collection, e.g. */
+/* to find out whether the marking is memory-bound.  Like the phase     */
+/* times, the counters are read only if the performance measurements    */
+/* were started before the collection.  Supported only on Linux (by the */
+/* perf_event interface, thus subject to perf_event_paranoid).  Returns */
+/* 0 (and zeroes the structure) if the counters are unavailable.        */
+/* Acquires the allocator lock.                                         */
+GC_API int GC_CALL GC_get_last_phase_counters(struct GC_phase_counters_s *);
+
+/* The work done by a marker (i.e. a marker thread or the thread which  */
+/* initiated the parallel marking) during a collection.  A marker is    */
+/* idle when it has run out of work and waits for the other markers to  */
+/* share some or to finish the marking.                                 */
+struct GC_marker_stats_s {
+  GC_word objs_marked;  /* number of the objects marked by the marker   */
+  GC_word bytes_marked; /* total size of these objects                  */
+  GC_word steal_attempts; /* attempts to take entries from the global   */
+                        /* mark stack or the deques of other markers    */
+  GC_word steals;       /* the attempts which got at least one entry    */
+  GC_word idle_ns;      /* time spent waiting for more work             */
+  GC_word lock_waits;   /* number of the mark lock acquisitions         */
+  GC_word lock_wait_ns; /* time spent acquiring the mark lock           */
+};
+
+/* Get the per-marker statistics of the last completed collection, to   */
+/* check how evenly the marking work is distributed among the markers   */
+/* (e.g. to choose the value passed to GC_set_markers_count).  At most  */
+/* max_markers elements of the stats array are filled in, the element   */
+/* index is the marker id (0 is for the thread initiating the marking). */
+/* Returns the number of markers (0 if the parallel marking was not     */
+/* used in the collection, or if the library has been compiled without  */
+/* PARALLEL_MARK).  The times are zero if compiled with NO_CLOCK.       */
+/* The statistics are also printed after each collection if the GC      */
+/* statistics printing is on (see GC_PRINT_STATS).  Acquires the        */
+/* allocator lock.                                                      */
+GC_API unsigned GC_CALL GC_get_marker_stats(
+                                struct GC_marker_stats_s * /* stats */,
+                                unsigned /* max_markers */);
+
 /* Set whether the GC will allocate executable memory pages or not.     */
 /* A non-zero argument instructs the collector to allocate memory with  */
 /* the executable flag on.  Must be called before the collector is      */
@@ -477,6 +711,52 @@ GC_API int GC_CALL GC_get_pages_executable(void);
 GC_API void GC_CALL GC_set_min_bytes_allocd(size_t);
 GC_API size_t GC_CALL GC_get_min_bytes_allocd(void);
 
+/* Set/get the heap growth ratio (in percent) triggering a collection.  */
+/* If non-zero, then a collection is triggered once the amount of the   */
+/* allocated memory since the previous collection reaches the given     */
+/* percentage of the live data and the roots (it is halved in the       */
+/* incremental mode), like GOGC does in the Go runtime; otherwise (the  */
+/* default) the amount is based on GC_free_space_divisor.  Not          */
+/* synchronized.                                                        */
+GC_API void GC_CALL GC_set_heap_growth_percent(unsigned);
+GC_API unsigned GC_CALL GC_get_heap_growth_percent(void);
+
+/* Set/get the bounds (in bytes, rounded to the heap block size) of a   */
+/* heap expansion step.  The heap is expanded at once to the size       */
+/* expected to be needed for the recent peak of the live data (the      */
+/* history is kept since the latest GC_gcollect_and_unmap call) but not */
+/* by more than the maximum step (unless the allocation request itself  */
+/* needs more).  Likewise, the free memory within that size is not      */
+/* returned to the OS (except for GC_gcollect_and_unmap and the soft    */
+/* limit or memory pressure cases) to avoid the heap oscillation under  */
+/* a bursty load.  The defaults are defined by the MINHINCR and         */
+/* MAXHINCR macros.  Not synchronized.                                  */
+GC_API void GC_CALL GC_set_min_heap_increment(size_t);
+GC_API size_t GC_CALL GC_get_min_heap_increment(void);
+GC_API void GC_CALL GC_set_max_heap_increment(size_t);
+GC_API size_t GC_CALL GC_get_max_heap_increment(void);
+
+/* Set/get the initial heap size hint.  If called before the collector  */
+/* initialization, then the value overrides the one defined by the      */
+/* GC_INITIAL_HEAP_SIZE macro (but not the environment variable of the  */
+/* same name); otherwise the heap is just expanded up to the given size */
+/* if it is smaller.  Zero (the default) means no hint.                 */
+GC_API void GC_CALL GC_set_initial_heap_size(size_t);
+GC_API size_t GC_CALL GC_get_initial_heap_size(void);
+
+/* Set/get the target share (in percent, less than 100) of the elapsed  */
+/* time spent in the collector.  If non-zero, then the amount to be     */
+/* allocated between collections (see above) is scaled after each       */
+/* collection based on the measured time of the collection cycle (the   */
+/* world-stopped pauses, the incremental marking steps and the sweep    */
+/* initiation) relative to the time elapsed since the previous one.     */
+/* Zero (the default) turns the pacing off.  A non-zero value starts    */
+/* the performance measurements (see GC_start_performance_measurement). */
+/* Not synchronized.  Defined only if the library has been compiled     */
+/* without NO_CLOCK.                                                    */
+GC_API void GC_CALL GC_set_gc_cpu_percent(unsigned);
+GC_API unsigned GC_CALL GC_get_gc_cpu_percent(void);
+
 /* Set/get the size in pages of units operated by GC_collect_a_little.  */
 /* The value should not be zero.  Not synchronized.                     */
 GC_API void GC_CALL GC_set_rate(int);
@@ -556,6 +836,16 @@ GC_API GC_ATTR_DEPRECATED void * GC_CALL GC_malloc_stubborn(size_t);
 /* value which is not the expected one (due to the alignment).          */
 GC_API GC_ATTR_MALLOC GC_ATTR_ALLOC_SIZE(2) void * GC_CALL
         GC_memalign(size_t /* align */, size_t /* lb */);
+
+/* The same as GC_memalign but allocate a pointer-free or an            */
+/* uncollectible object, respectively.  The (atomic) object is not      */
+/* cleared.  Unlike the result of GC_malloc_uncollectable, the          */
+/* uncollectible object should be explicitly deallocated by passing     */
+/* the result of GC_base() for it to GC_free().                         */
+GC_API GC_ATTR_MALLOC GC_ATTR_ALLOC_SIZE(2) void * GC_CALL
+        GC_memalign_atomic(size_t /* align */, size_t /* lb */);
+GC_API GC_ATTR_MALLOC GC_ATTR_ALLOC_SIZE(2) void * GC_CALL
+        GC_memalign_uncollectable(size_t /* align */, size_t /* lb */);
 GC_API int GC_CALL GC_posix_memalign(void ** /* memptr */, size_t /* align */,
                         size_t /* lb */) GC_ATTR_NONNULL(1);
 #ifndef GC_NO_VALLOC
@@ -573,6 +863,96 @@ GC_API int GC_CALL GC_posix_memalign(void ** /* memptr */, size_t /* align */,
 /* GC_free(0) is a no-op, as required by ANSI C for free.               */
 GC_API void GC_CALL GC_free(void *);
 
+/* Explicitly deallocate n objects at once, the pointers (to the base   */
+/* of the objects) are given in the ptrs array; null entries are        */
+/* ignored.  This is equivalent to calling GC_free() for each of them   */
+/* but the allocation lock is acquired only once, and the header of     */
+/* each block is looked up once.  The array is reordered (sorted by     */
+/* address) by the call.  The same restrictions as for GC_free apply.   */
+GC_API void GC_CALL GC_free_n(void ** /* ptrs */, size_t /* n */);
+
+/* Same as GC_free but the size requested on allocation of the object   */
+/* (lb) is given too, like in a C++14 sized delete.  If the collector   */
+/* is built with the thread-local allocation support, then a small      */
+/* normal or pointer-free object is put directly to the thread-local    */
+/* free list of the calling thread without acquiring the allocation     */
+/* lock, thus the next allocation of that size by the thread reuses it. */
+/* Such objects are not counted by GC_get_expl_freed_bytes_since_gc.    */
+/* lb should not exceed the object size, the same restrictions as for   */
+/* GC_free apply.                                                       */
+GC_API void GC_CALL GC_free_sized(void *, size_t /* lb */);
+
+/* Turn on/off the batched free mode.  In this mode (which has effect   */
+/* only if the collector is built with the thread-local allocation      */
+/* support), GC_free does not acquire the allocation lock for a small   */
+/* object but appends it to a batch of the calling thread, the batch is */
+/* passed to GC_free_n once full (or when the thread is unregistered).  */
+/* Thus the frees of objects allocated by another thread (e.g. in a     */
+/* producer/consumer pipeline) do not contend on the lock, the objects  */
+/* are put to the global free lists and then taken by the allocating    */
+/* thread on the next refill of its free list.  The objects in a batch  */
+/* are not reused (nor reclaimed) until the batch is passed.  Off by    */
+/* default unless the GC_BATCHED_FREE environment variable is set.  The */
+/* functions do not use any synchronization.                            */
+GC_API void GC_CALL GC_set_batched_free(int);
+GC_API int GC_CALL GC_get_batched_free(void);
+
+/* Return the objects cached by the thread-local free lists of the      */
+/* calling thread (and those of its GC_free batch) to the global free   */
+/* lists, so that they could be reused by the other threads.  Intended  */
+/* to be called by a thread which is going to be idle for a while (e.g. */
+/* a thread of a pool before waiting for a job).  The thread-local      */
+/* allocation is resumed gradually once the thread allocates again.     */
+/* Besides, the free lists of a thread which has been inside            */
+/* GC_do_blocking for a whole collection cycle are returned             */
+/* automatically at the next full collection.  A no-op unless the       */
+/* collector is built with the thread-local allocation support.         */
+GC_API void GC_CALL GC_flush_thread_local_free_lists(void);
+
+/* Region (arena) allocation for the data which dies all at once (e.g.  */
+/* the data of a request).  The objects of a region are bump-allocated  */
+/* from large uncollectable chunks, thus they are never marked or swept */
+/* individually; the chunks are scanned for pointers (conservatively,   */
+/* like the other uncollectable objects) while the region exists.       */
+/* GC_region_destroy deallocates all the objects of the region at once  */
+/* returning its chunks to the heap, so no object of the region should  */
+/* be used afterwards (the client is responsible for this).  A region   */
+/* object should not be passed to GC_free, GC_realloc and the like, nor */
+/* registered for finalization.  The region functions do not use any    */
+/* synchronization except for that the chunks allocation and the region */
+/* destruction acquire the allocation lock, thus a region should be     */
+/* used by one thread at a time.  GC_region_create and GC_region_malloc */
+/* return NULL (or the result of the out-of-memory handler) if out of   */
+/* memory.  The objects are cleared and aligned like those returned by  */
+/* GC_malloc.                                                           */
+typedef struct GC_region_s *GC_region;
+GC_API GC_region GC_CALL GC_region_create(void);
+GC_API GC_ATTR_MALLOC GC_ATTR_ALLOC_SIZE(2) void * GC_CALL
+        GC_region_malloc(GC_region, size_t /* lb */);
+GC_API void GC_CALL GC_region_destroy(GC_region);
+
+/* Pools of collectible objects of the same size (e.g. the nodes of a   */
+/* data structure).  Unlike GC_malloc_many, a pool always takes whole   */
+/* fresh heap blocks, and hands out their objects in order, thus the    */
+/* objects allocated one after another are adjacent.  The objects       */
+/* returned to the pool by GC_pool_free are reused by the pool only     */
+/* (these and the not yet allocated ones are kept by the pool across    */
+/* the collections).  The allocated objects are collectible as usual;   */
+/* an unreachable one is reclaimed to the global free lists.            */
+/* GC_pool_create returns NULL if lb exceeds the small object size      */
+/* limit (half of the heap block size) or if out of memory.  The pool   */
+/* objects are cleared (those given to GC_pool_free too), and could be  */
+/* passed to GC_free (but not to GC_pool_free of another pool).  After  */
+/* GC_pool_destroy, the free objects of the pool are reclaimed by the   */
+/* next collection.  The pool functions do not use any synchronization  */
+/* except for that a refill of the pool acquires the allocation lock,   */
+/* thus a pool should be used by one thread at a time.                  */
+typedef struct GC_pool_s *GC_pool;
+GC_API GC_pool GC_CALL GC_pool_create(size_t /* lb */);
+GC_API GC_ATTR_MALLOC void * GC_CALL GC_pool_malloc(GC_pool);
+GC_API void GC_CALL GC_pool_free(GC_pool, void *);
+GC_API void GC_CALL GC_pool_destroy(GC_pool);
+
 /* The "stubborn" objects allocation is not supported anymore.  Exists  */
 /* only for the backward compatibility.                                 */
 #define GC_MALLOC_STUBBORN(sz)  GC_MALLOC(sz)
@@ -647,6 +1027,30 @@ GC_API int GC_CALL GC_expand_hp(size_t /* number_of_bytes */);
 /* data races).                                                         */
 GC_API void GC_CALL GC_set_max_heap_size(GC_word /* n */);
 
+/* Set/get the soft limit of the heap memory backed by the OS (i.e.     */
+/* excluding the unmapped free blocks).  As the heap approaches the     */
+/* limit, the collections are triggered more often, the heap grows by   */
+/* smaller increments and all the free blocks are unmapped (if          */
+/* supported) at the end of each collection.  Unlike the maximum heap   */
+/* size, the soft limit does not cause the allocation failures.  Zero   */
+/* means no limit.  On Linux, the default is derived from the cgroup    */
+/* (v2) memory limit of the process (80% of it) unless the              */
+/* GC_SOFT_HEAP_LIMIT environment variable is set.  Not synchronized.   */
+GC_API void GC_CALL GC_set_soft_heap_limit(GC_word /* n */);
+GC_API GC_word GC_CALL GC_get_soft_heap_limit(void);
+
+/* Start watching the memory pressure (Linux PSI) of the cgroup of the  */
+/* process (or the system-wide one if not available).  On the pressure  */
+/* event, the scavenger thread unmaps all the free blocks, and the next */
+/* allocation triggers a collection followed by unmapping, like         */
+/* GC_gcollect_and_unmap does.  The argument is the PSI trigger, e.g.   */
+/* "some 150000 2000000" (the stall and window durations in             */
+/* microseconds), NULL means the default one.  Returns 1 on success, 0  */
+/* if failed or not supported (e.g., the collector is built without     */
+/* memory unmapping or threads support).  Acquires the GC lock (and     */
+/* initializes the collector if needed).                                */
+GC_API int GC_CALL GC_watch_memory_pressure(const char * /* trigger */);
+
 /* Inform the collector that a certain section of statically allocated  */
 /* memory contains no pointers to garbage collected memory.  Thus it    */
 /* need not be scanned.  This is sometimes important if the application */
@@ -673,6 +1077,23 @@ GC_API void GC_CALL GC_add_roots(void * /* low_address */,
 GC_API void GC_CALL GC_remove_roots(void * /* low_address */,
                                     void * /* high_address_plus_1 */);
 
+/* Same as GC_add_roots but for a segment which is rarely written (if   */
+/* ever) after registration, e.g. a large table of pointers built at    */
+/* startup.  The collector scans such a segment once, remembers the     */
+/* pointers to the heap found in it, and then marks from the remembered */
+/* pointers only; the pages of the segment written since the previous   */
+/* collection (as reported by the virtual dirty bits) are rescanned.    */
+/* This works only if the incremental mode is on and the dirty bits are */
+/* available for the static roots (e.g., soft-dirty bits on Linux);     */
+/* otherwise the segment is scanned at each collection the same way as  */
+/* the other roots.  The segment is excluded from the other roots (as   */
+/* if by GC_exclude_static_roots; thus it might be a part of the data   */
+/* segment of the program), while the exclusions are not applied to it. */
+/* The segment is removed by GC_remove_roots and GC_clear_roots (but it */
+/* remains excluded from the other roots).  Wizards only.               */
+GC_API void GC_CALL GC_add_frozen_roots(void * /* low_address */,
+                                        void * /* high_address_plus_1 */);
+
 /* Add a displacement to the set of those considered valid by the       */
 /* collector.  GC_register_displacement(n) means that if p was returned */
 /* by GC_malloc, then (char *)p + n will be considered to be a valid    */
@@ -701,6 +1122,22 @@ GC_API void GC_CALL GC_gcollect(void);
 /* the system is running out of resources.                              */
 GC_API void GC_CALL GC_gcollect_and_unmap(void);
 
+/* Set the rate (in bytes per second) at which a background scavenger   */
+/* thread returns free heap blocks to the OS.  The blocks eligible for  */
+/* unmapping are the same as without the scavenger (i.e. those free for */
+/* the number of collections set by GC_UNMAP_THRESHOLD), but they are   */
+/* unmapped (and merged with the adjacent free blocks) between the      */
+/* collections by small portions instead of at the end of each          */
+/* collection, thus shortening the pause.  Zero (the default unless the */
+/* GC_SCAVENGER_RATE environment variable is set) means no scavenging.  */
+/* Has no effect if memory unmapping is not compiled in or the          */
+/* collector is built without POSIX threads support.  The setter        */
+/* acquires the GC lock (and initializes the collector if needed); the  */
+/* getter does not use any synchronization.  The scavenger is turned    */
+/* off in a child process after fork.                                   */
+GC_API void GC_CALL GC_set_scavenger_rate(size_t /* bytes_per_sec */);
+GC_API size_t GC_CALL GC_get_scavenger_rate(void);
+
 /* Trigger a full world-stopped collection.  Abort the collection if    */
 /* and when stop_func returns a nonzero value.  Stop_func will be       */
 /* called frequently, and should be reasonably fast.  (stop_func is     */
@@ -822,6 +1259,31 @@ struct GC_prof_stats_s {
             /* Same as returned by GC_get_expl_freed_bytes_since_gc().  */
   GC_word obtained_from_os_bytes;
             /* Total amount of memory obtained from OS, in bytes.       */
+  GC_word parallel_reclaim_ns;
+            /* Total elapsed time spent in the parallel reclaim (see    */
+            /* GC_set_parallel_reclaim), in nanoseconds.  May wrap.     */
+  GC_word parallel_reclaim_work_ns;
+            /* Sum of the times spent by each of the threads taking     */
+            /* part in the parallel reclaim, in nanoseconds.  Divided   */
+            /* by parallel_reclaim_ns, gives the achieved speedup.      */
+  GC_word hdr_cache_hits;
+  GC_word hdr_cache_misses;
+            /* Total number of the block header lookups done by the     */
+            /* marker which hit (missed) its header cache.  A low hit   */
+            /* rate means the header lookups are likely to limit the    */
+            /* mark throughput.  The values may wrap.                   */
+  GC_word black_list_rejects;
+            /* Number of candidate heap block positions rejected by the */
+            /* black lists during the heap block allocation.  A high    */
+            /* value relative to gc_no suggests the black lists cause   */
+            /* the heap growth.  The value may wrap.                    */
+  GC_word black_list_entries;
+            /* The current size (in bits) of each black list.  It grows */
+            /* with the heap size to keep the hash collisions rare.     */
+  GC_word external_bytes;
+            /* Memory outside the GC heap owned by the objects, as      */
+            /* reported by GC_adjust_external_bytes.  Same as returned  */
+            /* by GC_get_external_bytes().                              */
 };
 
 /* Atomically get GC statistics (various global counters).  Clients     */
@@ -843,6 +1305,122 @@ GC_API size_t GC_CALL GC_get_prof_stats(struct GC_prof_stats_s *,
                                                  size_t /* stats_sz */);
 #endif
 
+/* Per-thread statistics (the counters are cumulative since the thread  */
+/* registration).  To be cheap, the allocation is accounted only when   */
+/* a thread-local free list is refilled (i.e. all objects of the list   */
+/* are counted at once), thus objects allocated directly from the       */
+/* global free lists (e.g. large ones, a few first ones of each size,   */
+/* or those of the client-defined kinds) are not counted here.          */
+#define GC_THREAD_STATS_SIZE_CLASSES 6
+struct GC_thread_stats_s {
+  GC_word bytes_allocd;
+                /* Bytes of objects taken by the thread to its          */
+                /* thread-local free lists.                             */
+  GC_word n_refills;
+                /* Number of the thread-local free lists refills.       */
+  GC_word objs_allocd[GC_THREAD_STATS_SIZE_CLASSES];
+                /* Number of objects taken to the thread-local free     */
+                /* lists by size class: objs_allocd[i] counts objects   */
+                /* not bigger than 16<<i bytes (and bigger than those   */
+                /* of the previous class); the last class includes all  */
+                /* the bigger objects.                                  */
+  GC_word stopped_ns;
+                /* Total time the thread was stopped by the collector   */
+                /* (in nanoseconds).                                    */
+  GC_word lock_wait_ns;
+                /* Total time the thread waited for the allocation lock */
+                /* (only the contended acquisitions are measured).      */
+  GC_word stack_cleared_bytes;
+                /* Total size of the stack regions below the stack      */
+                /* pointer cleared by the collector (so that the stale  */
+                /* pointers there do not cause a false retention).      */
+};
+
+/* Atomically get the statistics of the current thread.  The fields not */
+/* supported by the collector configuration (e.g. all of them unless    */
+/* it is built with the pthreads support) are zero.  The stats_sz       */
+/* argument and the result have the same meaning as for                 */
+/* GC_get_prof_stats.                                                   */
+GC_API size_t GC_CALL GC_get_my_thread_stats(struct GC_thread_stats_s *,
+                                             size_t /* stats_sz */);
+
+/* Heap fragmentation summary, one entry per (kind, object size) pair   */
+/* having at least one heap block in use.  The liveness information is  */
+/* as of the recent collection (i.e. the objects allocated since then   */
+/* are not counted as live).                                            */
+#define GC_OCCUPANCY_BUCKETS 10
+struct GC_size_class_stats_s {
+  unsigned kind;
+                /* The object kind (0 is pointer-free, 1 is normal).    */
+  GC_word obj_bytes;
+                /* The object size (in bytes), or 0 for the large       */
+                /* objects (those occupying one or more whole blocks).  */
+  GC_word n_blocks;
+                /* The number of heap blocks (or large objects).        */
+  GC_word block_bytes;
+                /* Total size of the blocks, in bytes.                  */
+  GC_word n_objs;
+                /* The number of objects the blocks could hold.         */
+  GC_word live_objs;
+                /* The number of objects marked by the recent GC.       */
+  GC_word live_bytes;
+                /* Same as live_objs but in bytes.                      */
+  GC_word occupancy[GC_OCCUPANCY_BUCKETS + 1];
+                /* Histogram of the blocks by the fraction of the live  */
+                /* objects: occupancy[i] counts the blocks with the     */
+                /* live fraction in [i/GC_OCCUPANCY_BUCKETS,            */
+                /* (i+1)/GC_OCCUPANCY_BUCKETS), the last element counts */
+                /* the full blocks.                                     */
+};
+
+/* Fill in the given array of the given number of entries with the      */
+/* fragmentation summary.  Returns the total number of entries (which   */
+/* could be greater than the array length).  Walks the whole heap with  */
+/* the allocation lock held.  Not available (returns 0) if the          */
+/* collector is built with NO_DEBUGGING.                                */
+GC_API size_t GC_CALL GC_get_size_class_stats(
+                                        struct GC_size_class_stats_s *,
+                                        size_t /* n_entries */);
+
+/* Same as GC_get_size_class_stats but the summary is written to the    */
+/* given buffer (of the given size) as a JSON object, truncated if      */
+/* needed and always NUL-terminated (unless buf_size is 0).  Returns    */
+/* the length of the whole JSON text (excluding the terminating NUL),   */
+/* like snprintf does.                                                  */
+GC_API size_t GC_CALL GC_get_size_class_stats_json(char * /* buf */,
+                                                   size_t /* buf_size */);
+
+/* Pointer density of the objects allocated by GC_malloc (and the like, */
+/* i.e. of the normal kind), one entry per object size.  Only the       */
+/* objects marked by the recent collection are examined.  A word is     */
+/* counted as a pointer if it points to (or inside, if interior         */
+/* pointers are recognized) a heap object.  The size classes for which  */
+/* n_objs_no_ptrs is close to n_objs (over several collections) are     */
+/* likely to be allocated by GC_malloc_atomic instead, this would       */
+/* reduce the marking work.  The allocation sites are not tracked.      */
+struct GC_scan_yield_stats_s {
+  GC_word obj_bytes;
+                /* The object size (in bytes), or 0 for the large       */
+                /* objects.                                             */
+  GC_word n_objs;
+                /* The number of the examined objects.                  */
+  GC_word n_objs_no_ptrs;
+                /* The number of those of them containing no pointers.  */
+  GC_word n_words;
+                /* The total number of words scanned.                   */
+  GC_word n_ptr_words;
+                /* The number of those of them looking like pointers.   */
+};
+
+/* Fill in the given array of the given number of entries with the      */
+/* pointer density statistics.  Returns the total number of entries.    */
+/* Scans all the live normal objects with the allocation lock held,     */
+/* so it is intended for profiling.  Not available (returns 0) if the   */
+/* collector is built with NO_DEBUGGING.                                */
+GC_API size_t GC_CALL GC_get_scan_yield_stats(
+                                        struct GC_scan_yield_stats_s *,
+                                        size_t /* n_entries */);
+
 /* Get the element value (converted to bytes) at a given index of       */
 /* size_map table which provides requested-to-actual allocation size    */
 /* mapping.  Assumes the collector is initialized.  Returns -1 if the   */
@@ -851,6 +1429,119 @@ GC_API size_t GC_CALL GC_get_prof_stats(struct GC_prof_stats_s *,
 /* to avoid data races on multiprocessors.                              */
 GC_API size_t GC_CALL GC_get_size_map_at(int i);
 
+/* Adaptive size classes.  The requests bigger than the tiny ones (i.e. */
+/* those above GC_TINY_FREELISTS-1 granules, minus the extra byte if    */
+/* any) are rounded up to a limited set of object sizes.  The profiling */
+/* mode records a histogram of the requested sizes (only for the        */
+/* requests passed to GC_malloc_kind_global, e.g. GC_malloc and         */
+/* GC_malloc_atomic ones).  GC_set_size_profiling(1) turns it on (and   */
+/* clears the histogram), 0 turns it off.  GC_tune_size_map rebuilds    */
+/* the size classes (for the sizes up to the biggest observed one) to   */
+/* minimize the internal fragmentation of the recorded requests; the    */
+/* objects allocated before are not affected.  It is a no-op unless     */
+/* the profiling is on.  GC_get_size_classes stores the current sizes   */
+/* (in bytes, ascending, at most n of them) to the given array and      */
+/* returns the total number of them.  GC_set_size_classes installs the  */
+/* given list (as returned by GC_get_size_classes, e.g. in a previous   */
+/* run of the client), and returns 0 (doing nothing) if the list is     */
+/* invalid.  The list could also be preloaded at the collector          */
+/* initialization by GC_SIZE_CLASSES environment variable (as a comma-  */
+/* separated list of sizes).  The sizes above the last class are        */
+/* assigned on demand as usual.  All but GC_get_size_profiling acquire  */
+/* the allocation lock.                                                 */
+GC_API void GC_CALL GC_set_size_profiling(int);
+GC_API int GC_CALL GC_get_size_profiling(void);
+GC_API void GC_CALL GC_tune_size_map(void);
+GC_API size_t GC_CALL GC_get_size_classes(size_t * /* sizes */,
+                                          size_t /* n */);
+GC_API int GC_CALL GC_set_size_classes(const size_t * /* sizes */,
+                                       size_t /* n */);
+
+/* Allocation sampling profiler.  GC_set_heap_profile_rate(n) turns on  */
+/* the sampling of about one object per n allocated bytes (on average,  */
+/* the distance is random), zero (the default) turns it off.  Only the  */
+/* allocations in the slow path (refilling a free list or allocating a  */
+/* large object) are sampled, thus the cost is low.  The call stack of  */
+/* a sampled object is recorded, and the object is accounted as in use  */
+/* until a collection finds it unreachable or it is explicitly          */
+/* deallocated.                                                         */
+/* GC_write_heap_profile writes the profile (the samples collected      */
+/* since the profiling was turned on first time) to the given file in   */
+/* the legacy heap profile format understood by pprof; returns 0 on     */
+/* success, -1 on failure.  The rate could also be set by               */
+/* GC_HEAP_PROFILE_RATE environment variable, and the profile could be  */
+/* written at exit to the file given by GC_HEAP_PROFILE one.  The       */
+/* profiler is supported only on Linux (glibc); otherwise the rate is   */
+/* always zero.  The setter and the writer acquire the allocation lock. */
+GC_API void GC_CALL GC_set_heap_profile_rate(size_t /* bytes */);
+GC_API size_t GC_CALL GC_get_heap_profile_rate(void);
+GC_API int GC_CALL GC_write_heap_profile(const char * /* path */);
+
+/* Sampled leak detection, a low-overhead alternative of GC_find_leak   */
+/* suitable for production.  If turned on, an object sampled by the     */
+/* allocation profiler (see above) and found unreachable without having */
+/* been explicitly deallocated is counted as leaked; the unreachable    */
+/* objects are still reclaimed as usual.  The new leaks are reported    */
+/* by the allocation stack (the sample counts and the total size, not   */
+/* by object) by the same means as GC_find_leak ones, i.e. printed at   */
+/* the next allocation or collection (and GC_ABORT_ON_LEAK is obeyed).  */
+/* Turning it on also sets the profiling rate to a default (512 KiB)    */
+/* if the profiling is off.  Could be also turned on by                 */
+/* GC_SAMPLED_LEAK_CHECK environment variable.  The leaked samples      */
+/* count (found so far) is returned by GC_get_sampled_leak_count.  Not  */
+/* supported where the profiler is not.                                 */
+GC_API void GC_CALL GC_set_sampled_leak_check(int);
+GC_API int GC_CALL GC_get_sampled_leak_check(void);
+GC_API size_t GC_CALL GC_get_sampled_leak_count(void);
+
+/* Object lifetime sampler.  GC_set_lifetime_sampling(n) turns on the   */
+/* sampling of every n-th object allocated in the slow path (refilling  */
+/* a free list or allocating a large object), zero (the default) turns  */
+/* it off.  When a collection finds a sampled object unreachable, the   */
+/* number of the collections it has survived is counted in the          */
+/* histogram of its size class and kind.  The histograms (used to tune  */
+/* e.g. GC_set_full_freq) are retrieved by GC_get_lifetime_stats which  */
+/* fills in up to n elements of the given array and returns the total   */
+/* number of the histograms (for the size classes and kinds seen so     */
+/* far, in no particular order).  The sampling could also be turned on  */
+/* by GC_LIFETIME_SAMPLING environment variable (the histograms are     */
+/* printed at exit then).  Not supported in SMALL_CONFIG.  The setter   */
+/* and GC_get_lifetime_stats acquire the allocation lock.               */
+#define GC_LIFETIME_BUCKETS 8
+struct GC_lifetime_stats_s {
+  GC_word size;         /* object size in bytes, 0 for large objects    */
+  unsigned kind;        /* object kind (e.g. GC_I_NORMAL)               */
+  GC_word n_sampled;    /* total number of the sampled objects          */
+  GC_word n_live;       /* ones not found unreachable yet               */
+  GC_word n_freed;      /* ones deallocated explicitly                  */
+  GC_word died[GC_LIFETIME_BUCKETS];
+                /* the numbers of the sampled objects found unreachable */
+                /* after surviving 0, 1, 2-3, 4-7, 8-15, 16-31, 32-63   */
+                /* and at least 64 collections, respectively            */
+};
+GC_API void GC_CALL GC_set_lifetime_sampling(unsigned /* interval */);
+GC_API unsigned GC_CALL GC_get_lifetime_sampling(void);
+GC_API size_t GC_CALL GC_get_lifetime_stats(
+                                struct GC_lifetime_stats_s * /* stats */,
+                                size_t /* n */);
+
+/* Write a snapshot of the reachable heap objects (their addresses,     */
+/* sizes, kinds and the references between them, along with the         */
+/* references from the static roots) in a compact binary format (see    */
+/* tools/heapsnap.c for the format and a reader).  A full collection is */
+/* done first, then the objects are enumerated with the world stopped   */
+/* and the data is passed to fn by chunks; fn is called with the world  */
+/* stopped and the allocation lock held, thus it should not allocate    */
+/* or acquire locks (e.g., it could just write to an opened file        */
+/* descriptor), and should return non-zero on failure.  Returns 0 on    */
+/* success, -1 if fn failed or the collection is disabled.              */
+typedef int (GC_CALLBACK * GC_heap_snapshot_write_proc)(
+                                        const void * /* buf */,
+                                        size_t /* len */,
+                                        void * /* client_data */);
+GC_API int GC_CALL GC_write_heap_snapshot(GC_heap_snapshot_write_proc,
+                                          void * /* client_data */);
+
 /* Count total memory use in bytes by all allocated blocks.  Acquires   */
 /* the lock.                                                            */
 GC_API size_t GC_CALL GC_get_memory_use(void);
@@ -875,9 +1566,10 @@ GC_API void GC_CALL GC_enable(void);
 /* compiled with MANUAL_VDB defined.  The manual VDB mode should be     */
 /* used only if the client has the appropriate GC_END_STUBBORN_CHANGE   */
 /* and GC_reachable_here (or, alternatively, GC_PTR_STORE_AND_DIRTY)    */
-/* calls (to ensure proper write barriers).  Both the setter and getter */
-/* are not synchronized, and are defined only if the library has been   */
-/* compiled without SMALL_CONFIG.                                       */
+/* calls (to ensure proper write barriers), or the card marking ones    */
+/* (GC_CARD_MARK or GC_PTR_STORE_AND_CARD_MARK, see gc_inline.h).  Both */
+/* the setter and getter are not synchronized, and are defined only if  */
+/* the library has been compiled without SMALL_CONFIG.                  */
 GC_API void GC_CALL GC_set_manual_vdb_allowed(int);
 GC_API int GC_CALL GC_get_manual_vdb_allowed(void);
 
@@ -897,6 +1589,42 @@ GC_API void GC_CALL GC_enable_incremental(void);
 /* Does not acquire the lock.                                           */
 GC_API int GC_CALL GC_is_incremental_mode(void);
 
+/* Enable the generational (but not incremental) collection.  This is   */
+/* the same as GC_enable_incremental() preceded by setting the time     */
+/* limit to GC_TIME_UNLIMITED: each minor collection is done with the   */
+/* world stopped, marks are kept (sticky) from the previous collection, */
+/* and only the objects allocated since then and the marked objects on  */
+/* the dirty pages are traced; every (GC_get_full_freq()+1)-th          */
+/* collection (or when the heap has grown enough) is a full one.  Only  */
+/* the objects registered for finalization since the previous           */
+/* collection are examined by a minor one, the older finalizable        */
+/* objects are left for the next full collection.  The same             */
+/* restrictions as for GC_enable_incremental() apply.  Safe to call     */
+/* before GC_INIT().  Includes a GC_init() call.                        */
+GC_API void GC_CALL GC_enable_generational(void);
+
+/* Return 1 (true) if the incremental mode is on and the time limit is  */
+/* GC_TIME_UNLIMITED (i.e. only the generational part of the mode is    */
+/* functional), 0 otherwise.  Does not acquire the lock.                */
+GC_API int GC_CALL GC_is_generational_mode(void);
+
+/* Turn on/off the stack watermarks.  If on, the collector keeps a copy */
+/* of the cold part of the stack of each thread (taken at the last scan */
+/* of the stack) and a minor collection (in the incremental or the      */
+/* generational mode) does not rescan the stack part adjacent to its    */
+/* cold end which has not changed since then (the objects it references */
+/* are marked already), i.e. only the frames above the "watermark" are  */
+/* scanned.  This reduces the pause time if the threads have deep       */
+/* stacks with rarely changed bottom frames, at the expense of memory   */
+/* (up to the size of the used part of each stack).  The stack of the   */
+/* thread doing the collection, and the ones of the threads inside      */
+/* GC_do_blocking() are always scanned entirely.  Currently this has    */
+/* an effect only for the threads stopped by signals (e.g. on Linux).   */
+/* Off by default (unless GC_STACK_WATERMARKS environment variable is   */
+/* set).  The setter and the getter are unsynchronized.                 */
+GC_API void GC_CALL GC_set_stack_watermarks(int);
+GC_API int GC_CALL GC_get_stack_watermarks(void);
+
 #define GC_PROTECTS_POINTER_HEAP  1 /* May protect non-atomic objects.  */
 #define GC_PROTECTS_PTRFREE_HEAP  2
 #define GC_PROTECTS_STATIC_DATA   4 /* Currently never.                 */
@@ -917,6 +1645,56 @@ GC_API int GC_CALL GC_incremental_protection_needs(void);
 /* No-op unless GC incremental mode is on.                              */
 GC_API void GC_CALL GC_start_incremental_collection(void);
 
+/* Turn on/off the concurrent marking mode.  In this mode (which has    */
+/* effect only if the incremental mode is on), a dedicated collector    */
+/* thread (created on demand) does the marking of each cycle while the  */
+/* mutator threads keep running; the world is stopped only to initiate  */
+/* the cycle (i.e. to read the dirty bits) and for the final re-mark    */
+/* from the roots and the pages dirtied meanwhile.  The last phase of   */
+/* the concurrent marking employs the parallel marker (if available).   */
+/* The mutator threads do not perform incremental marking work in this  */
+/* mode unless the heap would have to grow otherwise (then the          */
+/* allocating thread finishes the cycle itself).  Has no effect if the  */
+/* collector is built without POSIX threads support or incremental mode */
+/* support.  The mode could also be turned on by GC_CONCURRENT_MARK     */
+/* environment variable (provided the incremental mode is on at         */
+/* initialization).  The setter acquires the GC lock (and initializes   */
+/* the collector if needed); the getter does not use any                */
+/* synchronization.  The mode is turned off in a child process after    */
+/* fork.                                                                */
+GC_API void GC_CALL GC_set_concurrent_mark(int);
+GC_API int GC_CALL GC_get_concurrent_mark(void);
+
+/* Set/get the maximum time (in microseconds) the concurrent marker     */
+/* holds the allocation lock for at once (i.e. without letting the      */
+/* mutator threads allocate).  Zero means the marker releases the lock  */
+/* only after a fixed amount of marking work.  The final step of the    */
+/* concurrent marking done by the parallel marker is not interrupted    */
+/* when the time is over.  The default value is 500 us; it could also   */
+/* be set by GC_CONCURRENT_MARK_SLICE environment variable.  No effect  */
+/* unless the collector is built with the concurrent marking support.   */
+/* The setter and the getter are unsynchronized.                        */
+GC_API void GC_CALL GC_set_concurrent_mark_slice(unsigned long);
+GC_API unsigned long GC_CALL GC_get_concurrent_mark_slice(void);
+
+/* Turn on/off the background collection mode.  In this mode, a         */
+/* dedicated collector thread (created on demand) performs the          */
+/* collections (or, in the incremental mode, the collection steps)      */
+/* instead of the thread whose allocation triggers them; the allocating */
+/* thread just wakes it up and keeps allocating from the free lists (or */
+/* from a minimal heap increment).  Only once the allocation since the  */
+/* last collection exceeds twice the usual amount, the allocating       */
+/* thread collects itself (or waits for the collection in progress).    */
+/* The concurrent marking mode (if on) takes precedence over this one   */
+/* for the marking of the incremental cycles.  Has no effect if the     */
+/* collector is built without POSIX threads support.  The mode could    */
+/* also be turned on by GC_BACKGROUND_GC environment variable.  The     */
+/* setter acquires the GC lock (and initializes the collector if        */
+/* needed); the getter does not use any synchronization.  The mode is   */
+/* turned off in a child process after fork.                            */
+GC_API void GC_CALL GC_set_background_gc(int);
+GC_API int GC_CALL GC_get_background_gc(void);
+
 /* Perform some garbage collection work, if appropriate.        */
 /* Return 0 if there is no more work to be done (including the  */
 /* case when garbage collection is not appropriate).            */
@@ -927,6 +1705,64 @@ GC_API void GC_CALL GC_start_incremental_collection(void);
 /* until it returns 0.                                          */
 GC_API int GC_CALL GC_collect_a_little(void);
 
+/* Perform as much garbage collection work as fits the given time     */
+/* budget (in nanoseconds), e.g. when the client event loop is idle:  */
+/* complete the sweep initiation left by the latest collection, start */
+/* a new collection earlier than it would be otherwise (if a quarter  */
+/* of the usual amount has been allocated since the latest one), mark */
+/* (incrementally, if the incremental mode is on), sweep the rest of  */
+/* the heap, return the unneeded free memory to the OS (if supported) */
+/* and then run the finalizers (unless GC_finalize_on_demand is set)  */
+/* if the time is left.  The work is resumed by the next call (or by  */
+/* the allocation).  The budget is only approximately kept, e.g. a    */
+/* world-stopped pause may exceed it (see GC_set_time_limit), and it  */
+/* is ignored if the collector is built with NO_CLOCK.  The           */
+/* non-incremental collection is abandoned once the time is over.     */
+/* Returns 0 if there is no more work to be done.                     */
+GC_API int GC_CALL GC_collect_idle(unsigned long /* time_budget_ns */);
+
+/* Collect the garbage and then freeze the heap: the objects allocated  */
+/* so far are treated as an immutable old generation, i.e. they are     */
+/* never reclaimed, their blocks are never swept (the free space there  */
+/* is abandoned) and the mark bits of these blocks are never cleared;   */
+/* the frozen objects are only scanned (read) by each full collection   */
+/* to find the references to the other objects.  This is intended for  */
+/* pre-fork servers: if the parent freezes the heap before forking the  */
+/* workers, the collections in the workers do not write to the pages of */
+/* the inherited heap, so that these pages remain shared with the       */
+/* parent (copy-on-write).  The block headers (and the mark bits,       */
+/* unless the collector is built with SIDE_MARK_BITMAP) are still       */
+/* written.  There is no way to unfreeze the heap.  Returns 1 on        */
+/* success, 0 if the collection is disabled (or in the leak detection   */
+/* mode).                                                               */
+GC_API int GC_CALL GC_freeze_heap(void);
+
+/* Write an image of the (collected) heap to the file of the given      */
+/* path, so that it could be restored by GC_load_heap_image in a new    */
+/* process of the same program, avoiding the allocation and building    */
+/* of the initial data structures on the next start.  The image holds   */
+/* the heap blocks in use and the given root pointer; the root set      */
+/* (other than the root pointer) is not saved, and the pointers to      */
+/* the outside of the heap (e.g. to static data) are not relocated.     */
+/* Supported only if the heap is allocated from a reserved address      */
+/* range (the collector is built with FLAT_HDR_TABLE or                 */
+/* SIDE_MARK_BITMAP, see USE_HEAP_ARENA), and only if the heap is not   */
+/* yet grown beyond that range.  Returns 0 on success, -1 otherwise.    */
+GC_API int GC_CALL GC_write_heap_image(const char * /* path */,
+                                       void * /* root */);
+
+/* Restore the heap from an image written by GC_write_heap_image.       */
+/* Should be called before GC_INIT (or before any allocation at least); */
+/* the image is mapped at the original address (privately, i.e. the    */
+/* pages are read from the file on demand).  The same build of the      */
+/* collector and the same set of object kinds (created in the same      */
+/* order before the call) are required.  The restored objects are       */
+/* frozen (see GC_freeze_heap) and reachable from the returned root     */
+/* pointer which the client should store in a root location.  Returns   */
+/* the root pointer on success, NULL on failure (the heap is then       */
+/* initialized as usual).                                               */
+GC_API void * GC_CALL GC_load_heap_image(const char * /* path */);
+
 /* Allocate an object of size lb bytes.  The client guarantees that     */
 /* as long as the object is live, it will be referenced by a pointer    */
 /* that points to somewhere within the first 256 bytes of the object.   */
@@ -946,6 +1782,45 @@ GC_API GC_ATTR_MALLOC GC_ATTR_ALLOC_SIZE(1) void * GC_CALL
 GC_API GC_ATTR_MALLOC GC_ATTR_ALLOC_SIZE(1) void * GC_CALL
         GC_malloc_atomic_ignore_off_page(size_t /* lb */);
 
+/* Separate heaps for unrelated workloads (e.g. the tenants of a       */
+/* server) within the same collector.  Each heap has its own free lists */
+/* and heap blocks (those of the object kinds created for the heap on   */
+/* its first GC_heap_malloc and GC_heap_malloc_atomic call, one kind    */
+/* for each), thus objects of different heaps never share a block, and  */
+/* the memory occupied by a heap could be queried separately.  Note:    */
+/* - the kinds are a scarce resource shared with GC_new_kind and        */
+/*   GC_malloc_kind_hint (the collector is built with MAXOBJKINDS=16 by */
+/*   default, a few of them are predefined); once no more kinds could   */
+/*   be created, the objects of a heap without its own kind are         */
+/*   allocated as by GC_malloc (or GC_malloc_atomic), i.e. the heap is  */
+/*   no longer separate, GC_heap_get_size does not count such objects,  */
+/*   and a warning is printed (once per heap);                          */
+/* - the heaps are not isolated otherwise (i.e. this is only a partial  */
+/*   implementation of the per-tenant heaps): there is no per-heap      */
+/*   allocation accounting, collection trigger or collection call, the  */
+/*   collections are still process-wide (triggered by the total         */
+/*   allocation, they stop all the threads and mark all the heaps),     */
+/*   thus a heap affects the pause times and the heap growth of the     */
+/*   others; pointers between the heaps are allowed;                    */
+/* - a heap (and its kinds) cannot be destroyed.                        */
+typedef struct GC_heap_s *GC_heap_t;
+
+/* Create a new heap.  Returns NULL (and prints a warning) if the       */
+/* maximum number of heaps (MAXOBJKINDS) has been reached.              */
+GC_API GC_heap_t GC_CALL GC_new_heap(void);
+
+/* Same as GC_malloc and GC_malloc_atomic, respectively, but allocate   */
+/* the object in the given heap.                                        */
+GC_API GC_ATTR_MALLOC GC_ATTR_ALLOC_SIZE(2) void * GC_CALL
+        GC_heap_malloc(GC_heap_t, size_t /* lb */);
+GC_API GC_ATTR_MALLOC GC_ATTR_ALLOC_SIZE(2) void * GC_CALL
+        GC_heap_malloc_atomic(GC_heap_t, size_t /* lb */);
+
+/* Return the number of bytes in the heap blocks currently used by the  */
+/* given heap (including the free and unreclaimed objects).  Acquires   */
+/* the allocation lock, and walks all the heap blocks.                  */
+GC_API size_t GC_CALL GC_heap_get_size(GC_heap_t);
+
 #ifdef GC_ADD_CALLER
 # define GC_EXTRAS GC_RETURN_ADDR, __FILE__, __LINE__
 # define GC_EXTRA_PARAMS GC_word ra, const char * s, int i
@@ -1009,6 +1884,16 @@ GC_API /* 'realloc' attr */ GC_ATTR_ALLOC_SIZE(2) void * GC_CALL
         GC_debug_realloc_replacement(void * /* object_addr */,
                                      size_t /* size_in_bytes */);
 
+/* Check only about one in n heap blocks for the smashed objects (with  */
+/* the debugging information) at each collection, a different subset    */
+/* of blocks each time (thus a smash is detected within n collections). */
+/* 1 (the default) means the whole heap is checked, 0 turns the checks  */
+/* off.  Could be also set by GC_DEBUG_CHECK_HEAP_PERIOD environment    */
+/* variable.  Has no effect if the collector is built with              */
+/* SHORT_DBG_HDRS.                                                      */
+GC_API void GC_CALL GC_set_debug_check_heap_period(unsigned /* n */);
+GC_API unsigned GC_CALL GC_get_debug_check_heap_period(void);
+
 #ifdef GC_DEBUG_REPLACEMENT
 # define GC_MALLOC(sz) GC_debug_malloc_replacement(sz)
 # define GC_REALLOC(old, sz) GC_debug_realloc_replacement(old, sz)
@@ -1033,6 +1918,7 @@ GC_API /* 'realloc' attr */ GC_ATTR_ALLOC_SIZE(2) void * GC_CALL
 # define GC_MALLOC_ATOMIC_IGNORE_OFF_PAGE(sz) \
                         GC_debug_malloc_atomic_ignore_off_page(sz, GC_EXTRAS)
 # define GC_FREE(p) GC_debug_free(p)
+# define GC_FREE_SIZED(p, sz) ((void)(sz), GC_debug_free(p))
 # define GC_REGISTER_FINALIZER(p, f, d, of, od) \
       GC_debug_register_finalizer(p, f, d, of, od)
 # define GC_REGISTER_FINALIZER_IGNORE_SELF(p, f, d, of, od) \
@@ -1060,6 +1946,7 @@ GC_API /* 'realloc' attr */ GC_ATTR_ALLOC_SIZE(2) void * GC_CALL
 # define GC_MALLOC_ATOMIC_IGNORE_OFF_PAGE(sz) \
                         GC_malloc_atomic_ignore_off_page(sz)
 # define GC_FREE(p) GC_free(p)
+# define GC_FREE_SIZED(p, sz) GC_free_sized(p, sz)
 # define GC_REGISTER_FINALIZER(p, f, d, of, od) \
       GC_register_finalizer(p, f, d, of, od)
 # define GC_REGISTER_FINALIZER_IGNORE_SELF(p, f, d, of, od) \
@@ -1304,6 +2191,63 @@ GC_API int GC_CALL GC_unregister_disappearing_link(void ** /* link */);
         /* routines.  Returns 0 if link was not actually        */
         /* registered (otherwise returns 1).                    */
 
+GC_API int GC_CALL GC_register_disappearing_links(void ** const * /* links */,
+                                        void * const * /* objs */,
+                                        size_t /* n */);
+        /* Same as GC_general_register_disappearing_link called */
+        /* for each of n pairs of links[i] and objs[i] but much */
+        /* faster for a large n: the table is grown to fit all  */
+        /* the links at once, and they are inserted with the    */
+        /* allocation lock acquired just once (e.g. to register */
+        /* the weak references of a deserialized object graph). */
+        /* Returns GC_SUCCESS (even if some links were already  */
+        /* registered), GC_NO_MEMORY (then only a part of the   */
+        /* links might be registered), or GC_UNIMPLEMENTED if   */
+        /* GC_find_leak is true.                                */
+
+GC_API size_t GC_CALL GC_unregister_disappearing_links(
+                                        void ** const * /* links */,
+                                        size_t /* n */);
+        /* Same as GC_unregister_disappearing_link called for   */
+        /* each of n links but acquires the lock once.  Returns */
+        /* the number of links which were actually registered.  */
+
+GC_API int GC_CALL GC_register_disappearing_link_notify(void ** /* link */,
+                                                    const void * /* obj */)
+                        GC_ATTR_NONNULL(1) GC_ATTR_NONNULL(2);
+        /* Same as GC_general_register_disappearing_link but    */
+        /* once the collector clears *link, the link address is */
+        /* also put to the queue of the cleared links (unless   */
+        /* the object containing link is garbage collected at   */
+        /* the same time), like a reference enqueued to Java    */
+        /* ReferenceQueue.  The queue is drained by             */
+        /* GC_drain_cleared_links, thus the client need not     */
+        /* scan all its weak references to find the cleared     */
+        /* ones.  The object containing a queued link is kept   */
+        /* alive until the queue is drained.  The link is       */
+        /* unregistered once it is put to the queue.  Returns   */
+        /* the same values as the above function; a repeated    */
+        /* registration by either of the functions changes the  */
+        /* notification mode of the link.                       */
+
+typedef void (GC_CALLBACK * GC_cleared_link_proc)(void ** /* link */,
+                                                  void * /* client_data */);
+
+GC_API size_t GC_CALL GC_drain_cleared_links(GC_cleared_link_proc,
+                                             void * /* client_data */)
+                        GC_ATTR_NONNULL(1);
+        /* Remove all the links from the queue of the cleared   */
+        /* links (see GC_register_disappearing_link_notify) and */
+        /* pass each of them to the given function (in no       */
+        /* particular order).  The function is called without   */
+        /* the allocation lock held (thus it may, e.g.,         */
+        /* register the link again).  Returns the number of the */
+        /* drained links.  If the queue is empty, the call      */
+        /* returns 0 without acquiring any lock.  Links cleared */
+        /* by the collector while the queue is full (because    */
+        /* of an allocation failure) are queued by the next     */
+        /* collection.                                          */
+
 GC_API int GC_CALL GC_register_long_link(void ** /* link */,
                                     const void * /* obj */)
                         GC_ATTR_NONNULL(1) GC_ATTR_NONNULL(2);
@@ -1325,6 +2269,57 @@ GC_API int GC_CALL GC_unregister_long_link(void ** /* link */);
         /* Similar to GC_unregister_disappearing_link but for a */
         /* registration by either of the above two routines.    */
 
+GC_API int GC_CALL GC_register_long_links(void ** const * /* links */,
+                                          void * const * /* objs */,
+                                          size_t /* n */);
+GC_API size_t GC_CALL GC_unregister_long_links(void ** const * /* links */,
+                                               size_t /* n */);
+        /* Similar to GC_register_disappearing_links and        */
+        /* GC_unregister_disappearing_links, respectively, but  */
+        /* for the long links.                                  */
+
+/* Movable objects support.  An object allocated by GC_malloc_movable  */
+/* is pointer-free (like one returned by GC_malloc_atomic) but may be  */
+/* moved by the collector provided the client accesses it only through */
+/* handles registered by GC_register_movable_handle.  If enabled (see  */
+/* GC_set_evacuation_threshold), at the end of a collection the live   */
+/* movable objects are copied out of the sparsely occupied heap blocks */
+/* into denser ones (with the world stopped), the registered handles  */
+/* are updated to the new addresses, and the emptied blocks are        */
+/* returned to the heap.  The client should not retain any other       */
+/* pointer to (or into) a movable object while a collection may occur, */
+/* e.g. across an allocation call or, if other threads may allocate,   */
+/* outside of GC_call_with_alloc_lock.  Not available if the collector */
+/* is built with GC_MOVABLE_NOT_NEEDED or GC_NO_FINALIZATION.          */
+GC_API GC_ATTR_MALLOC GC_ATTR_ALLOC_SIZE(1) void * GC_CALL
+        GC_malloc_movable(size_t /* size_in_bytes */);
+
+GC_API int GC_CALL GC_register_movable_handle(void ** /* handle */)
+                        GC_ATTR_NONNULL(1);
+        /* Register the location of a handle to the movable object     */
+        /* *handle (which should be non-NULL, and point to the object  */
+        /* base).  The handle keeps the object alive if it is itself   */
+        /* reachable, otherwise it is cleared like a long link (see    */
+        /* GC_register_long_link) once the object is inaccessible.     */
+        /* The value of *handle may be changed by the collector at any */
+        /* collection.  Several handles may refer to the same object.  */
+        /* Returns the same values as                                  */
+        /* GC_general_register_disappearing_link (GC_DUPLICATE means   */
+        /* the previous registration is updated to the new object).    */
+
+GC_API int GC_CALL GC_unregister_movable_handle(void ** /* handle */);
+        /* Undo a registration by GC_register_movable_handle.  Returns */
+        /* 0 if the handle was not actually registered.  The object    */
+        /* is never moved on behalf of an unregistered handle.         */
+
+GC_API void GC_CALL GC_set_evacuation_threshold(unsigned /* percent */);
+GC_API unsigned GC_CALL GC_get_evacuation_threshold(void);
+        /* Set/get the occupancy (in percents of a heap block size)    */
+        /* below which the movable objects are evacuated from a block. */
+        /* Zero (the default) turns the evacuation off.  The value     */
+        /* could also be set by GC_EVACUATION_THRESHOLD environment    */
+        /* variable.                                                   */
+
 /* Support of toggle-ref style of external memory management    */
 /* without hooking up to the host retain/release machinery.     */
 /* The idea of toggle-ref is that an external reference to      */
@@ -1362,6 +2357,59 @@ GC_API GC_toggleref_func GC_CALL GC_get_toggleref_func(void);
 GC_API int GC_CALL GC_toggleref_add(void * /* obj */, int /* is_strong */)
                                                 GC_ATTR_NONNULL(1);
 
+/* The batched variant of the toggle-ref callback: store the new    */
+/* state of each of the n given objects to the same index of the    */
+/* second array.  n is at most TOGGLEREF_BATCH_SIZE (256 by         */
+/* default).  If registered (nonzero), it is used instead of the    */
+/* per-object callback.  Invoked under the same conditions.  Both   */
+/* the setter and the getter acquire the allocation lock.           */
+typedef void (GC_CALLBACK *GC_toggleref_batch_func)(void ** /* objs */,
+                                        GC_ToggleRefStatus * /* states */,
+                                        size_t /* n */);
+GC_API void GC_CALL GC_set_toggleref_batch_func(GC_toggleref_batch_func);
+GC_API GC_toggleref_batch_func GC_CALL GC_get_toggleref_batch_func(void);
+
+/* Turn on (or off) the dirty-only mode of the toggle-ref           */
+/* processing.  In this mode, the callback is invoked at the        */
+/* beginning of a collection only for the objects registered (by    */
+/* GC_toggleref_add) or passed to GC_toggleref_mark_dirty since the */
+/* previous collection, the other entries keep their states.  Thus  */
+/* the client should call GC_toggleref_mark_dirty whenever the      */
+/* state of an object might change (e.g. once the native reference  */
+/* count of the peer goes to or from one).  Off by default.  Both   */
+/* the setter and the getter acquire the allocation lock.           */
+GC_API void GC_CALL GC_set_toggleref_dirty_only(int);
+GC_API int GC_CALL GC_get_toggleref_dirty_only(void);
+
+/* Request the toggle-ref callback to be invoked on the given       */
+/* (registered) object at the next collection (has effect only in   */
+/* the dirty-only mode).  Repeated calls for the same object before */
+/* the collection are cheap.  Returns GC_SUCCESS or GC_NO_MEMORY.   */
+GC_API int GC_CALL GC_toggleref_mark_dirty(void * /* obj */)
+                                                GC_ATTR_NONNULL(1);
+
+/* Ephemerons support.  An ephemeron is a small collectible object  */
+/* holding a key and a value; the value is kept alive by a reachable */
+/* ephemeron only as long as the key is reachable by other means    */
+/* (i.e. not through the values of ephemerons whose keys are dead). */
+/* Thus a weak-keyed cache built of ephemerons does not leak if     */
+/* a value refers back to its own key.  The collector computes the  */
+/* reachable values iteratively (until a fixpoint) at the end of    */
+/* the mark phase, and then clears (sets both fields to NULL) each  */
+/* reachable ephemeron the key of which is not reachable, all in    */
+/* the same collection cycle.  The key and the value (if non-NULL)  */
+/* should point to the beginning of objects allocated by the        */
+/* collector.  The ephemeron object itself should not be freed      */
+/* explicitly.  GC_new_ephemeron returns NULL if out of memory.     */
+/* The getters acquire the allocation lock (thus the result could   */
+/* be safely stored anywhere by the client).                        */
+GC_API GC_ATTR_MALLOC void * GC_CALL GC_new_ephemeron(const void * /* key */,
+                                                const void * /* value */);
+GC_API void * GC_CALL GC_ephemeron_get_key(const void * /* eph */)
+                                                GC_ATTR_NONNULL(1);
+GC_API void * GC_CALL GC_ephemeron_get_value(const void * /* eph */)
+                                                GC_ATTR_NONNULL(1);
+
 /* Finalizer callback support.  Invoked by the collector (with  */
 /* the allocation lock held) for each unreachable object        */
 /* enqueued for finalization.                                   */
@@ -1383,6 +2431,37 @@ GC_API int GC_CALL GC_invoke_finalizers(void);
         /* GC_finalize_on_demand is nonzero, it must be called  */
         /* explicitly.                                          */
 
+/* The number of objects currently waiting for their finalizers to be  */
+/* run, and the peak value of it.  No synchronization is used.          */
+GC_API GC_word GC_CALL GC_get_finalizer_queue_length(void);
+GC_API GC_word GC_CALL GC_get_finalizer_queue_max_length(void);
+
+/* Start n more threads dedicated to running finalizers.  While any of  */
+/* them is running, the finalizers are no longer invoked implicitly by  */
+/* the allocating threads (nor is GC_finalizer_notifier called), even   */
+/* if GC_finalize_on_demand is set; instead, the finalizer threads are  */
+/* woken up to run the finalizers by batches (of the size set by        */
+/* GC_set_finalizer_batch_size, 64 by default).  An explicit            */
+/* GC_invoke_finalizers() call is still allowed.  The threads are not   */
+/* inherited by a child process after fork.  Returns GC_SUCCESS, or     */
+/* GC_UNIMPLEMENTED if the collector is built without POSIX threads     */
+/* support, or GC_NO_MEMORY if a thread could not be created.  Also     */
+/* invoked at the collector initialization if the GC_FINALIZER_THREADS  */
+/* environment variable is set.                                         */
+GC_API int GC_CALL GC_start_finalizer_threads(unsigned /* n */);
+GC_API unsigned GC_CALL GC_get_finalizer_threads(void);
+GC_API void GC_CALL GC_set_finalizer_batch_size(unsigned);
+GC_API unsigned GC_CALL GC_get_finalizer_batch_size(void);
+
+/* Set the limit of the finalization queue length above which an        */
+/* allocating thread (other than a finalizer one) passing through the   */
+/* point where it would otherwise run the finalizers waits (for a few   */
+/* milliseconds at most) for the finalizer threads to catch up.  Zero   */
+/* (the default) means no throttling.  Has no effect unless the         */
+/* finalizer threads are started.  No synchronization is used.          */
+GC_API void GC_CALL GC_set_finalizer_backlog_limit(GC_word);
+GC_API GC_word GC_CALL GC_get_finalizer_backlog_limit(void);
+
 /* Explicitly tell the collector that an object is reachable    */
 /* at a particular program point.  This prevents the argument   */
 /* pointer from being optimized away, even it is otherwise no   */
@@ -1555,6 +2634,39 @@ GC_API void GC_CALL GC_start_mark_threads(void);
   /* systems.  Return -1 otherwise.                                     */
   GC_API int GC_CALL GC_get_thr_restart_signal(void);
 
+  /* Set and get whether the cooperative (safepoint-based) threads      */
+  /* suspension is used.  If enabled, the collector stopping the world  */
+  /* first sets GC_safepoint_requested and waits (up to the safepoint   */
+  /* timeout) for the other threads to reach a safepoint (i.e. to call  */
+  /* GC_safepoint(), typically via GC_SAFEPOINT() polled by the client  */
+  /* in its loops).  The threads inside GC_do_blocking() are treated as */
+  /* stopped already.  Only the threads which have not reached         */
+  /* a safepoint in time are sent the suspend signal.  The default is  */
+  /* off (unless GC_COOPERATIVE_SUSPEND environment variable is set).  */
+  /* Has no effect if the collector does not use signals to suspend     */
+  /* threads.  Acquires the allocation lock.                            */
+  GC_API void GC_CALL GC_set_cooperative_suspend(int);
+  GC_API int GC_CALL GC_get_cooperative_suspend(void);
+
+  /* Set and get the maximum time (in microseconds) the collector waits */
+  /* for the threads to reach a safepoint.  The default is 1000.  Does  */
+  /* not use any synchronization.                                       */
+  GC_API void GC_CALL GC_set_safepoint_timeout(unsigned long);
+  GC_API unsigned long GC_CALL GC_get_safepoint_timeout(void);
+
+  /* Non-zero while the world is being stopped cooperatively.  Should   */
+  /* only be read by the client (by GC_SAFEPOINT).                      */
+  GC_API volatile GC_word GC_safepoint_requested;
+
+  /* Stop the current thread (until the world is restarted) if the     */
+  /* collector is stopping the world.  The current thread should be     */
+  /* registered and should not hold the allocation lock.                */
+  GC_API void GC_CALL GC_safepoint(void);
+
+  /* Poll for a pending world stop (cheap unless it is in progress).    */
+# define GC_SAFEPOINT() \
+        (void)(GC_safepoint_requested != 0 ? (GC_safepoint(), 0) : 0)
+
   /* Explicitly enable GC_register_my_thread() invocation.              */
   /* Done implicitly if a GC thread-creation function is called (or     */
   /* implicit thread registration is activated, or the collector is     */
@@ -1684,6 +2796,34 @@ GC_API void GC_CALL GC_set_stackbottom(void * /* gc_thread_handle */,
                                        const struct GC_stack_base *)
                                                         GC_ATTR_NONNULL(2);
 
+/* Register the stack of a client fiber (coroutine), mem_base of which  */
+/* is the cold end of the stack.  Unlike GC_set_stackbottom, the lock   */
+/* is acquired only here and in GC_unregister_fiber, not on every       */
+/* context switch.  A suspended fiber stack is scanned only from the    */
+/* stack pointer saved by GC_fiber_switch (a newly registered fiber is  */
+/* not scanned until the first switch from it); the scan of such        */
+/* stacks is shared among the marker threads.  Returns the handle of    */
+/* the fiber, or NULL if the feature is not supported (the client       */
+/* should then fall back to GC_set_stackbottom) or out of memory.       */
+/* Not available for Win32 and Darwin threads, IA-64 and E2K for now.   */
+GC_API void * GC_CALL GC_register_fiber(const struct GC_stack_base *)
+                                                        GC_ATTR_NONNULL(1);
+
+/* Unregister the fiber (the handle becomes invalid).  The fiber should */
+/* not be running (or being switched to or from) in any thread.         */
+GC_API void GC_CALL GC_unregister_fiber(void * /* fiber */);
+
+/* Notify the collector that the current thread (the handle of which    */
+/* is returned by GC_get_my_stackbottom) is about to switch from one    */
+/* stack to another one.  Either fiber may be NULL meaning the own      */
+/* stack of the thread.  Should be called on the stack being left, just */
+/* before the actual switch, and not between GC_call_with_gc_active()   */
+/* and its return.  Does not acquire the lock and is async-safe.        */
+GC_API void GC_CALL GC_fiber_switch(void * /* gc_thread_handle */,
+                                    void * /* from_fiber */,
+                                    void * /* to_fiber */)
+                                                        GC_ATTR_NONNULL(1);
+
 /* The following routines are primarily intended for use with a         */
 /* preprocessor which inserts calls to check C pointer arithmetic.      */
 /* They indicate failure by invoking the corresponding _print_proc.     */
@@ -1836,6 +2976,13 @@ typedef int (GC_CALLBACK * GC_has_static_roots_func)(
 GC_API void GC_CALL GC_register_has_static_roots_callback(
                                         GC_has_static_roots_func);
 
+/* Return the number of collections which reused the data roots of the  */
+/* dynamic libraries registered by a previous collection because no     */
+/* library has been loaded or unloaded since then.  Always 0 if the     */
+/* caching is unsupported on the platform (it is currently implemented  */
+/* for glibc-based Linux only).  Acquires the GC lock.                  */
+GC_API GC_word GC_CALL GC_get_dynlib_cache_hits(void);
+
 #if !defined(CPPCHECK) && !defined(GC_WINDOWS_H_INCLUDED) && defined(WINAPI)
   /* windows.h is included before gc.h */
 # define GC_WINDOWS_H_INCLUDED
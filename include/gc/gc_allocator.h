@@ -57,16 +57,60 @@
 /* First some helpers to allow us to dispatch on whether or not a type
  * is known to be pointer-free.
  * These are private, except that the client may invoke the
- * GC_DECLARE_PTRFREE macro.
+ * GC_DECLARE_PTRFREE (or GC_POINTER_FREE_CLASS) macro.
  */
 
 struct GC_true_type {};
 struct GC_false_type {};
 
-template <class GC_tp>
-struct GC_type_traits {
-  GC_false_type GC_is_ptr_free;
-};
+#if __cplusplus >= 201103L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201103L)
+# include <type_traits>
+
+  // Since C++11, the arithmetic and enumeration types (and the arrays
+  // of pointer-free types) are detected automatically.  A class may be
+  // declared pointer-free by GC_POINTER_FREE_CLASS() placed in its body,
+  // such a class should be trivially copyable (e.g., it cannot hold
+  // a std::string member).  Note that the tag is inherited.
+# define GC_POINTER_FREE_CLASS() typedef void GC_pointer_free_tag
+
+  template <class GC_tp> struct GC_void_type { typedef void type; };
+
+  template <class GC_tp, class = void>
+  struct GC_has_ptr_free_tag : std::false_type {};
+
+  template <class GC_tp>
+  struct GC_has_ptr_free_tag<GC_tp,
+        typename GC_void_type<typename GC_tp::GC_pointer_free_tag>::type>
+        : std::true_type {
+#   if !defined(__GNUC__) || defined(__clang__) || __GNUC__ >= 5
+      static_assert(std::is_trivially_copyable<GC_tp>::value,
+                    "pointer-free class should be trivially copyable");
+#   endif
+  };
+
+  template <class GC_tp>
+  struct GC_is_ptr_free_type
+        : std::integral_constant<bool, std::is_arithmetic<GC_tp>::value
+                                || std::is_enum<GC_tp>::value
+                                || GC_has_ptr_free_tag<GC_tp>::value> {};
+
+  template <class GC_tp, size_t GC_n>
+  struct GC_is_ptr_free_type<GC_tp[GC_n]> : GC_is_ptr_free_type<GC_tp> {};
+
+  template <bool> struct GC_ptr_free_select { typedef GC_false_type type; };
+  template <> struct GC_ptr_free_select<true> { typedef GC_true_type type; };
+
+  template <class GC_tp>
+  struct GC_type_traits {
+    typename GC_ptr_free_select<GC_is_ptr_free_type<GC_tp>::value>::type
+                GC_is_ptr_free;
+  };
+#else
+  template <class GC_tp>
+  struct GC_type_traits {
+    GC_false_type GC_is_ptr_free;
+  };
+#endif
 
 # define GC_DECLARE_PTRFREE(T) \
 template<> struct GC_type_traits<T> { GC_true_type GC_is_ptr_free; }
@@ -144,8 +188,8 @@ public:
                                                    false));
   }
 
-  void deallocate(pointer __p, size_type /* GC_n */) GC_NOEXCEPT
-    { GC_FREE(__p); }
+  void deallocate(pointer __p, size_type GC_n) GC_NOEXCEPT
+    { GC_FREE_SIZED(__p, GC_n * sizeof(GC_Tp)); }
 
   size_type max_size() const GC_NOEXCEPT
     { return static_cast<size_t>(-1) / sizeof(GC_Tp); }
@@ -221,8 +265,8 @@ public:
                                                    true));
   }
 
-  void deallocate(pointer __p, size_type /* GC_n */) GC_NOEXCEPT
-    { GC_FREE(__p); }
+  void deallocate(pointer __p, size_type GC_n) GC_NOEXCEPT
+    { GC_FREE_SIZED(__p, GC_n * sizeof(GC_Tp)); }
 
   size_type max_size() const GC_NOEXCEPT
     { return static_cast<size_t>(-1) / sizeof(GC_Tp); }
@@ -338,4 +382,56 @@ inline bool operator!=(const traceable_allocator<GC_T1>&,
   return false;
 }
 
+#if !defined(GC_NO_MEMORY_RESOURCE) && defined(__has_include) \
+    && (__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L))
+# if __has_include(<memory_resource>)
+#   include <memory_resource>
+#   define GC_MEMORY_RESOURCE
+# endif
+#endif
+
+#ifdef GC_MEMORY_RESOURCE
+  // The polymorphic memory resources (C++17) allocating collectible
+  // objects.  gc_memory_resource allocates the objects scanned by the
+  // collector, gc_atomic_memory_resource allocates pointer-free ones.
+  // The requested alignment is honored by GC_memalign.  Deallocation is
+  // optional (as for gc_allocator), so the resource suits well as the
+  // upstream of std::pmr::monotonic_buffer_resource: the chunks of the
+  // latter are linked in the chunks themselves, thus they are traced
+  // until the buffer is released and reclaimed once it is unreachable.
+  // The upstream of a buffer holding pointers to collectible objects
+  // should be gc_memory_resource.  The resource is stateless, but
+  // a single instance should be used for all containers that might swap
+  // or move-assign their elements, as do_is_equal compares the instances.
+  class gc_memory_resource : public std::pmr::memory_resource {
+  protected:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+      void* obj = GC_memalign(alignment, bytes);
+      if (0 == obj)
+        GC_ALLOCATOR_THROW_OR_ABORT();
+      return obj;
+    }
+
+    void do_deallocate(void* p, size_t /* bytes */,
+                       size_t /* alignment */) override {
+      GC_free(GC_base(p));
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other)
+                                        const GC_NOEXCEPT override {
+      return this == &other;
+    }
+  };
+
+  class gc_atomic_memory_resource : public gc_memory_resource {
+  protected:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+      void* obj = GC_memalign_atomic(alignment, bytes);
+      if (0 == obj)
+        GC_ALLOCATOR_THROW_OR_ABORT();
+      return obj;
+    }
+  };
+#endif // GC_MEMORY_RESOURCE
+
 #endif /* GC_ALLOCATOR_H */
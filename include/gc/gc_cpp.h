@@ -158,6 +158,16 @@ by UseGC.  GC is an alias for UseGC, unless GC_NAME_CONFLICT is defined.
 # define GC_PLACEMENT_DELETE
 #endif
 
+#if !defined(GC_NO_ALIGNED_NEW) && !defined(GC_ALIGNED_NEW) \
+    && defined(__cpp_aligned_new) && __cpp_aligned_new >= 201606L
+  // C++17 new for over-aligned types.
+# define GC_ALIGNED_NEW
+#endif
+
+#ifdef GC_ALIGNED_NEW
+# include <new> // for align_val_t
+#endif
+
 #if defined(GC_NEW_ABORTS_ON_OOM) || defined(_LIBCPP_NO_EXCEPTIONS)
 # define GC_OP_NEW_OOM_CHECK(obj) \
                 do { if (!(obj)) GC_abort_on_oom(); } while (0)
@@ -218,6 +228,30 @@ public:
       inline void operator delete[](void*, void*) GC_NOEXCEPT;
 #   endif
 # endif // GC_OPERATOR_NEW_ARRAY
+
+# ifdef GC_ALIGNED_NEW
+    // The instances of an over-aligned class are allocated by GC_memalign
+    // (or its atomic and uncollectible counterparts) thus they might not
+    // start at the beginning of the heap object.
+    inline void* operator new(size_t size, std::align_val_t al);
+    inline void* operator new(size_t size, std::align_val_t al,
+                              GCPlacement gcp);
+    inline void operator delete(void* obj, std::align_val_t) GC_NOEXCEPT;
+#   ifdef GC_PLACEMENT_DELETE
+      inline void operator delete(void*, std::align_val_t,
+                                  GCPlacement) GC_NOEXCEPT;
+#   endif
+#   ifdef GC_OPERATOR_NEW_ARRAY
+      inline void* operator new[](size_t size, std::align_val_t al);
+      inline void* operator new[](size_t size, std::align_val_t al,
+                                  GCPlacement gcp);
+      inline void operator delete[](void* obj, std::align_val_t) GC_NOEXCEPT;
+#     ifdef GC_PLACEMENT_DELETE
+        inline void operator delete[](void*, std::align_val_t,
+                                      GCPlacement) GC_NOEXCEPT;
+#     endif
+#   endif
+# endif // GC_ALIGNED_NEW
 };
 
 /**
@@ -275,6 +309,18 @@ inline void* operator new(size_t size, GC_NS_QUALIFY(GCPlacement) gcp,
                               void*) GC_NOEXCEPT;
 #endif
 
+#ifdef GC_ALIGNED_NEW
+  inline void* operator new(size_t size, std::align_val_t al,
+                            GC_NS_QUALIFY(GCPlacement) gcp);
+    // Same as above but for over-aligned types.  A clean-up function
+    // is not accepted since the object might not start at the beginning
+    // of the heap object.
+# ifdef GC_PLACEMENT_DELETE
+    inline void operator delete(void*, std::align_val_t,
+                                GC_NS_QUALIFY(GCPlacement)) GC_NOEXCEPT;
+# endif
+#endif
+
 #ifndef GC_NO_INLINE_STD_NEW
 
 #if defined(_MSC_VER) || defined(__DMC__) \
@@ -313,14 +359,12 @@ inline void* operator new(size_t size, GC_NS_QUALIFY(GCPlacement) gcp,
 
 # if __cplusplus >= 201402L || _MSVC_LANG >= 201402L // C++14
     inline void operator delete(void* obj, size_t size) GC_NOEXCEPT {
-      (void)size; // size is ignored
-      GC_FREE(obj);
+      GC_FREE_SIZED(obj, size);
     }
 
 #   if defined(GC_OPERATOR_NEW_ARRAY)
       inline void operator delete[](void* obj, size_t size) GC_NOEXCEPT {
-        (void)size;
-        GC_FREE(obj);
+        GC_FREE_SIZED(obj, size);
       }
 #   endif
 # endif // C++14
@@ -471,6 +515,75 @@ inline void gc::operator delete(void* obj) GC_NOEXCEPT
 # endif
 #endif // GC_OPERATOR_NEW_ARRAY
 
+#ifdef GC_ALIGNED_NEW
+  inline void* gc::operator new(size_t size, std::align_val_t al)
+  {
+    void* obj = GC_memalign(static_cast<size_t>(al), size);
+    GC_OP_NEW_OOM_CHECK(obj);
+    return obj;
+  }
+
+  inline void* gc::operator new(size_t size, std::align_val_t al,
+                                GCPlacement gcp)
+  {
+    size_t align = static_cast<size_t>(al);
+    void* obj;
+    switch (gcp) {
+    case UseGC:
+      obj = GC_memalign(align, size);
+      break;
+    case PointerFreeGC:
+      obj = GC_memalign_atomic(align, size);
+      break;
+    case NoGC:
+    default:
+      obj = GC_memalign_uncollectable(align, size);
+    }
+    GC_OP_NEW_OOM_CHECK(obj);
+    return obj;
+  }
+
+  inline void gc::operator delete(void* obj, std::align_val_t) GC_NOEXCEPT
+  {
+    GC_free(GC_base(obj));
+  }
+
+# ifdef GC_PLACEMENT_DELETE
+    inline void gc::operator delete(void* p, std::align_val_t,
+                                    GCPlacement /* gcp */) GC_NOEXCEPT
+    {
+      GC_free(GC_base(p));
+    }
+# endif
+
+# ifdef GC_OPERATOR_NEW_ARRAY
+    inline void* gc::operator new[](size_t size, std::align_val_t al)
+    {
+      return gc::operator new(size, al);
+    }
+
+    inline void* gc::operator new[](size_t size, std::align_val_t al,
+                                    GCPlacement gcp)
+    {
+      return gc::operator new(size, al, gcp);
+    }
+
+    inline void gc::operator delete[](void* obj,
+                                      std::align_val_t al) GC_NOEXCEPT
+    {
+      gc::operator delete(obj, al);
+    }
+
+#   ifdef GC_PLACEMENT_DELETE
+      inline void gc::operator delete[](void* p, std::align_val_t al,
+                                        GCPlacement gcp) GC_NOEXCEPT
+      {
+        gc::operator delete(p, al, gcp);
+      }
+#   endif
+# endif // GC_OPERATOR_NEW_ARRAY
+#endif // GC_ALIGNED_NEW
+
 inline gc_cleanup::~gc_cleanup()
 {
 # ifndef GC_NO_FINALIZATION
@@ -564,4 +677,20 @@ inline void* operator new(size_t size, GC_NS_QUALIFY(GCPlacement) gcp,
   }
 #endif // GC_OPERATOR_NEW_ARRAY
 
+#ifdef GC_ALIGNED_NEW
+  inline void* operator new(size_t size, std::align_val_t al,
+                            GC_NS_QUALIFY(GCPlacement) gcp)
+  {
+    return GC_NS_QUALIFY(gc)::operator new(size, al, gcp);
+  }
+
+# ifdef GC_PLACEMENT_DELETE
+    inline void operator delete(void* p, std::align_val_t al,
+                                GC_NS_QUALIFY(GCPlacement) gcp) GC_NOEXCEPT
+    {
+      GC_NS_QUALIFY(gc)::operator delete(p, al, gcp);
+    }
+# endif
+#endif // GC_ALIGNED_NEW
+
 #endif /* GC_CPP_H */
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2023 Ivan Maidanski
+ *
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose, provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/*
+ * Compressed (32-bit) object references for 64-bit targets.  If the
+ * collector is built with COMPRESSED_REFS, the whole heap is kept inside
+ * the reserved heap arena, thus a pointer to an object could be stored
+ * as its distance (in granules) from GC_cref_base, which fits 32 bits
+ * for the heap up to 32 GiB (by default).  The objects allocated by
+ * GC_cref_malloc consist of such references only (each 32-bit slot is
+ * a reference, zero denotes NULL), the collector traces them precisely
+ * by a dedicated mark procedure.  E.g.:
+ *
+ *   struct node { gc_cref<node> left, right; };
+ *
+ *   node *n = static_cast<node *>(GC_cref_malloc(sizeof(node)));
+ *   n -> left = static_cast<node *>(GC_cref_malloc(sizeof(node)));
+ *
+ * The compressed references are not recognized anywhere else (e.g. on
+ * the stacks, in static data or in the objects of the other kinds), thus
+ * each object should be reachable by an ordinary pointer or from another
+ * object allocated by GC_cref_malloc.  Only the pointers to the object
+ * beginning (or any other granule-aligned pointers into the heap) could
+ * be encoded.  If a non-reference value is stored into such an object,
+ * it might cause a false retention (but no harm otherwise).
+ */
+
+#ifndef GC_CREF_H
+#define GC_CREF_H
+
+#ifndef GC_H
+# include "gc.h"
+#endif
+
+#include "gc_tiny_fl.h" /* for GC_GRANULE_BYTES */
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+typedef unsigned GC_cref_t; /* 32 bits on all supported targets */
+
+GC_API void * GC_cref_base;
+                        /* The address the references are relative to  */
+                        /* (one granule below the heap arena); NULL if  */
+                        /* the compressed references are not supported, */
+                        /* or before GC_init.  Not changed afterwards.  */
+
+/* Return non-zero if the compressed references could be used (i.e.    */
+/* the collector is built with COMPRESSED_REFS and the heap arena is    */
+/* reserved successfully).  Initializes the collector if needed.        */
+GC_API int GC_CALL GC_cref_available(void);
+
+/* Allocate a cleared object consisting of the compressed references.   */
+/* Returns NULL on failure, or if the compressed references are not     */
+/* available.                                                           */
+GC_API GC_ATTR_MALLOC GC_ATTR_ALLOC_SIZE(1) void * GC_CALL
+        GC_cref_malloc(size_t /* lb */);
+
+/* Convert an ordinary pointer to a compressed reference and back.      */
+#define GC_CREF_ENCODE(p) \
+        ((GC_cref_t)((p) != 0 ? ((GC_word)(p) - (GC_word)GC_cref_base) \
+                                / GC_GRANULE_BYTES : 0))
+#define GC_CREF_DECODE(r) \
+        ((r) != 0 ? (void *)((char *)GC_cref_base \
+                             + (GC_word)(r) * GC_GRANULE_BYTES) : (void *)0)
+
+#ifdef __cplusplus
+  } /* extern "C" */
+
+// A compact pointer to T stored as a compressed reference.  Should be
+// used only for the fields of the objects allocated by GC_cref_malloc.
+template <class T>
+class gc_cref {
+  GC_cref_t GC_r;
+
+public:
+  gc_cref() : GC_r(0) {}
+  gc_cref(T *p) : GC_r(GC_CREF_ENCODE(p)) {}
+
+  gc_cref &operator=(T *p) {
+    GC_r = GC_CREF_ENCODE(p);
+    return *this;
+  }
+
+  T *get() const { return static_cast<T *>(GC_CREF_DECODE(GC_r)); }
+  operator T *() const { return get(); }
+  T *operator->() const { return get(); }
+  T &operator*() const { return *get(); }
+
+  // The encoded value.
+  GC_cref_t raw() const { return GC_r; }
+};
+#endif
+
+#endif /* GC_CREF_H */
@@ -45,6 +45,29 @@ GC_API void GC_CALL GC_register_disclaim_proc(int /*kind*/,
                                 GC_disclaim_proc /*proc*/,
                                 int /*mark_from_all*/) GC_ATTR_NONNULL(2);
 
+/* Type of a batched disclaim call-back.  Called with the allocation    */
+/* lock held, with an array of (at most DISCLAIM_BATCH_SIZE, 64 by      */
+/* default) unreachable objects of the same heap block.                 */
+typedef void (GC_CALLBACK * GC_disclaim_batch_proc)(void ** /*objs*/,
+                                                    size_t /*n*/);
+
+/* Same as GC_register_disclaim_proc but "proc" is invoked only for     */
+/* the objects passed to GC_set_disclaim_needed, never for those on     */
+/* a free list, and receives the ones of a block by batches.  The heap  */
+/* blocks without such objects are swept as those of any other kind.    */
+/* Unlike GC_disclaim_proc, "proc" cannot prevent the reclamation of    */
+/* the objects.  Replaces the per-object procedure of the kind, if any. */
+GC_API void GC_CALL GC_register_disclaim_batch_proc(int /*kind*/,
+                                GC_disclaim_batch_proc /*proc*/,
+                                int /*mark_from_all*/) GC_ATTR_NONNULL(2);
+
+/* Request the batched disclaim procedure to be called for the given    */
+/* object (pointer to the beginning of it) once it becomes unreachable. */
+/* The object should be of a kind registered with a batched disclaim    */
+/* procedure.  Does not acquire the allocation lock (if the atomic "or" */
+/* operation is available).  GC_free() cancels the request.             */
+GC_API void GC_CALL GC_set_disclaim_needed(const void *) GC_ATTR_NONNULL(1);
+
 /* The finalizer closure used by GC_finalized_malloc.                   */
 struct GC_finalizer_closure {
     GC_finalization_proc proc;
@@ -52,7 +75,7 @@ struct GC_finalizer_closure {
 };
 
 /* Allocate "size" bytes which is finalized by "fc".  This uses a       */
-/* dedicated object kind with a disclaim procedure, and is more         */
+/* dedicated object kind with a batched disclaim procedure, and is more */
 /* efficient than GC_register_finalizer and friends.                    */
 /* GC_init_finalized_malloc must be called before using this.           */
 /* The collector will reclaim the object during this GC cycle (thus,    */
@@ -73,7 +73,10 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t /* lb */, int /* k */,
 
 /* Generalized version of GC_malloc and GC_malloc_atomic.               */
 /* Uses appropriately the thread-local (if available) or the global     */
-/* free-list of the specified kind.                                     */
+/* free-list of the specified kind.  The thread-local free lists are    */
+/* available for any kind (including the ones created by GC_new_kind)   */
+/* except for the uncollectable ones and, in the incremental mode, the  */
+/* kinds traced by a mark procedure or a per-object descriptor.         */
 GC_API GC_ATTR_MALLOC GC_ATTR_ALLOC_SIZE(1) void * GC_CALL
         GC_malloc_kind(size_t /* lb */, int /* k */);
 
@@ -85,6 +88,21 @@ GC_API GC_ATTR_MALLOC GC_ATTR_ALLOC_SIZE(1) void * GC_CALL
 # define GC_malloc_kind_global GC_malloc_kind
 #endif
 
+/* The expected lifetime hints for GC_malloc_kind_hint.         */
+#define GC_HINT_NONE 0
+#define GC_HINT_LONG_LIVED 1 /* E.g. caches and interned strings. */
+
+/* Same as GC_malloc_kind but takes the hint about the expected         */
+/* lifetime of the object.  The long-lived objects are allocated from   */
+/* a separate set of free lists and heap blocks (those of a companion   */
+/* kind created on demand with the same descriptor), thus such objects  */
+/* do not prevent the blocks of the short-lived ones from being freed   */
+/* entirely.  The hint is ignored for the uncollectable kinds, and if   */
+/* no more kinds could be created.                                      */
+GC_API GC_ATTR_MALLOC GC_ATTR_ALLOC_SIZE(1) void * GC_CALL
+        GC_malloc_kind_hint(size_t /* lb */, int /* k */,
+                            unsigned /* hint */);
+
 /* An internal macro to update the free list pointer atomically (if     */
 /* the AO primitives are available) to avoid race with the marker.      */
 #if defined(GC_THREADS) && defined(AO_HAVE_store)
@@ -200,6 +218,47 @@ GC_API GC_ATTR_MALLOC GC_ATTR_ALLOC_SIZE(1) void * GC_CALL
       } \
     } while (0)
 
+/* Card marking write barrier.  A card is a GC_CARD_BYTES-sized and     */
+/* aligned piece of the address space; the card table contains a byte   */
+/* per card (distinct cards could share the same entry, it is harmless).*/
+/* In the manual VDB mode (see GC_set_manual_vdb_allowed), the card     */
+/* table replaces the page dirty bits, and the collector rescans only   */
+/* the marked objects overlapping the dirty cards.  GC_CARD_MARK(p)     */
+/* marks the card containing the address p (not necessarily the object  */
+/* start); it is the inline equivalent of GC_end_stubborn_change(p).    */
+/* Like the latter, it should follow the pointer store, and the stored  */
+/* value should remain reachable (e.g. by GC_reachable_here) until the  */
+/* card is marked.  The table is not available if the collector is      */
+/* built with GC_DISABLE_INCREMENTAL (or SMALL_CONFIG).                 */
+#define GC_LOG_CARD_BYTES 9
+#define GC_CARD_BYTES ((GC_word)1 << GC_LOG_CARD_BYTES)
+#define GC_LOG_CARD_TABLE_SIZE 18
+#define GC_CARD_TABLE_SIZE ((GC_word)1 << GC_LOG_CARD_TABLE_SIZE)
+
+#define GC_CARD_INDEX(p) \
+        (((GC_word)(p) >> GC_LOG_CARD_BYTES) & (GC_CARD_TABLE_SIZE - 1))
+
+GC_API unsigned char GC_card_table[GC_CARD_TABLE_SIZE];
+
+/* Return the address of GC_card_table, or NULL if the collector is     */
+/* built without the card table.  Intended for the clients which cannot */
+/* refer to a variable exported by the collector library directly (e.g. */
+/* some foreign function interfaces); the result could be cached.       */
+GC_API unsigned char * GC_CALL GC_get_card_table(void);
+
+#define GC_CARD_MARK(p) (void)(GC_card_table[GC_CARD_INDEX(p)] = 1)
+
+/* The inline variant of GC_PTR_STORE_AND_DIRTY(p, q) for the manual    */
+/* VDB mode.  Unlike the latter, p should be of void** type.            */
+#define GC_PTR_STORE_AND_CARD_MARK(p, q) \
+    do { \
+      void **gc_pp_ = (p); \
+      void *gc_q_ = (void *)(q); \
+      *gc_pp_ = gc_q_; \
+      GC_CARD_MARK(gc_pp_); \
+      GC_reachable_here(gc_q_); \
+    } while (0)
+
 GC_API void GC_CALL GC_print_free_list(int /* kind */,
                                        size_t /* sz_in_granules */);
 
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2022 Ivan Maidanski
+ *
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose, provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/*
+ * Compile-time specialized mark procedures for the objects of a fixed
+ * layout.  A layout is given by a bitmap (a template argument) where
+ * bit i (counting from the least significant one) is set if the word i
+ * of the object may contain a pointer.  For each layout, the compiler
+ * generates a dedicated mark procedure which examines exactly the
+ * pointer words (without interpreting a descriptor at run time), and
+ * the procedure is registered (on first use) as a new object kind by
+ * GC_new_proc and GC_new_kind.  E.g.:
+ *
+ *   struct node { GC_word value; node *next; node *prev; };
+ *
+ *   typedef gc_layout<GC_LAYOUT_BIT(node, next)
+ *                     | GC_LAYOUT_BIT(node, prev)> node_layout;
+ *   node *n = static_cast<node *>(node_layout::allocate(sizeof(node)));
+ *
+ * gc_array_layout<bitmap, element_words> is the same but the bitmap
+ * describes an element of an array (repeated through the whole object).
+ *
+ * The objects must be allocated by allocate() of the corresponding class
+ * (the debugging allocation is not supported), the returned objects are
+ * cleared.  An object of gc_layout should be large enough to hold the
+ * highest word mentioned in the bitmap.  Only the words described by
+ * the bitmap are traced; thus the layout should be used for the types
+ * whose pointer fields are known precisely.  Layouts longer than
+ * a bitmap word allows could be handled by gc_typed.h facilities.
+ */
+
+#ifndef GC_LAYOUT_H
+#define GC_LAYOUT_H
+
+#include "gc_mark.h"
+
+#include <stddef.h> /* for offsetof */
+
+/* The bit of the layout bitmap corresponding to the given pointer      */
+/* field of the type.  The field should be word-aligned.                */
+#define GC_LAYOUT_BIT(t, f) ((GC_word)1 << (offsetof(t, f) / sizeof(GC_word)))
+
+// Push the pointer words of an object (or an array element) starting
+// at the given one.  The recursion is unrolled at the compile time, the
+// checks of the bitmap bits are compile-time constants.
+template <GC_word GC_bm, unsigned GC_i>
+struct GC_layout_marker {
+  static inline struct GC_ms_entry *push(GC_word *addr,
+                                         struct GC_ms_entry *msp,
+                                         struct GC_ms_entry *msl) {
+    if ((GC_bm & 1) != 0)
+      msp = GC_MARK_AND_PUSH((void *)addr[GC_i], msp, msl,
+                             (void **)(addr + GC_i));
+    return GC_layout_marker<(GC_bm >> 1), GC_i + 1>::push(addr, msp, msl);
+  }
+};
+
+template <unsigned GC_i>
+struct GC_layout_marker<0, GC_i> {
+  static inline struct GC_ms_entry *push(GC_word *,
+                                         struct GC_ms_entry *msp,
+                                         struct GC_ms_entry *) {
+    return msp;
+  }
+};
+
+// The object kind registration shared by the layout classes.  Proc is
+// the mark procedure of the layout.
+template <GC_mark_proc GC_proc>
+class GC_layout_kind {
+  static unsigned GC_kind;
+
+  static void * GC_CALLBACK new_kind_inner(void *) {
+    if (0 == GC_kind) {
+      unsigned proc_index = GC_new_proc_inner(GC_proc);
+
+      GC_kind = GC_new_kind_inner(GC_new_free_list_inner(),
+                                  GC_MAKE_PROC(proc_index, 0),
+                                  0 /* add_size_to_descriptor */,
+                                  1 /* clear_new_objects */);
+    }
+    return NULL;
+  }
+
+public:
+  // Return the kind of the objects, registering it on the first call.
+  static unsigned kind() {
+    if (0 == GC_kind) {
+      GC_init(); /* no-op if GC is already initialized */
+      (void)GC_call_with_alloc_lock(new_kind_inner, NULL);
+    }
+    return GC_kind;
+  }
+
+  // Allocate a cleared object of the given size; NULL on failure.
+  static void *allocate(size_t lb) {
+    return GC_generic_malloc(lb, static_cast<int>(kind()));
+  }
+};
+
+template <GC_mark_proc GC_proc>
+unsigned GC_layout_kind<GC_proc>::GC_kind = 0;
+
+template <GC_word GC_bm>
+class gc_layout {
+public:
+  static struct GC_ms_entry *mark_proc(GC_word *addr,
+                                       struct GC_ms_entry *msp,
+                                       struct GC_ms_entry *msl,
+                                       GC_word /* env */) {
+    return GC_layout_marker<GC_bm, 0>::push(addr, msp, msl);
+  }
+
+  static unsigned kind() {
+    return GC_layout_kind<mark_proc>::kind();
+  }
+
+  static void *allocate(size_t lb) {
+    return GC_layout_kind<mark_proc>::allocate(lb);
+  }
+};
+
+template <GC_word GC_bm, unsigned GC_elem_words>
+class gc_array_layout {
+  typedef char GC_elem_words_must_be_positive[GC_elem_words > 0 ? 1 : -1];
+
+public:
+  static struct GC_ms_entry *mark_proc(GC_word *addr,
+                                       struct GC_ms_entry *msp,
+                                       struct GC_ms_entry *msl,
+                                       GC_word /* env */) {
+    // The object size is not known statically, ask the collector.
+    GC_word *lim = addr + GC_size(addr) / sizeof(GC_word);
+
+    for (; addr + GC_elem_words <= lim; addr += GC_elem_words)
+      msp = GC_layout_marker<GC_bm, 0>::push(addr, msp, msl);
+    return msp;
+  }
+
+  static unsigned kind() {
+    return GC_layout_kind<mark_proc>::kind();
+  }
+
+  static void *allocate(size_t lb) {
+    return GC_layout_kind<mark_proc>::allocate(lb);
+  }
+};
+
+#endif /* GC_LAYOUT_H */
@@ -201,6 +201,22 @@ typedef void (GC_CALLBACK *GC_walk_hblk_fn)(struct GC_hblk_s *,
 GC_API void GC_CALL GC_apply_to_all_blocks(GC_walk_hblk_fn,
                                 GC_word /* client_data */) GC_ATTR_NONNULL(1);
 
+/* Same as GC_walk_hblk_fn but with the index of the worker thread.     */
+typedef void (GC_CALLBACK *GC_walk_hblk_par_fn)(struct GC_hblk_s *,
+                                                unsigned /* worker */,
+                                                GC_word /* client_data */);
+
+/* Same as GC_apply_to_all_blocks but the heap is partitioned (by the   */
+/* block address) among the marker threads if the parallel marking is  */
+/* on, thus fn is called concurrently from up to GC_get_parallel()+1    */
+/* threads, each block is visited once.  The worker index (less than    */
+/* GC_get_parallel()+1) is passed to fn, e.g. to accumulate the results */
+/* per worker (and merge them once the call returns).  The caller       */
+/* should hold the allocation lock; fn should neither acquire it nor    */
+/* allocate from the GC heap.                                           */
+GC_API void GC_CALL GC_apply_to_all_blocks_parallel(GC_walk_hblk_par_fn,
+                                GC_word /* client_data */) GC_ATTR_NONNULL(1);
+
 /* If there are likely to be false references to a block starting at h  */
 /* of the indicated length, then return the next plausible starting     */
 /* location for h that might avoid these false references.  Otherwise   */
@@ -233,6 +249,23 @@ GC_API unsigned GC_CALL GC_new_kind_inner(void ** /* free_list */,
                             int /* add_size_to_descriptor */,
                             int /* clear_new_objects */) GC_ATTR_NONNULL(1);
 
+/* Set whether the objects of the given kind are recognized only by the */
+/* pointers to their beginning (or at a displacement registered by      */
+/* GC_register_displacement) even if GC_all_interior_pointers is on.    */
+/* This lets the marker reject the interior pointers to such objects    */
+/* (and the pointers past their end) found in the heap and static data  */
+/* without the base address computation, while the objects of the other */
+/* kinds (e.g. buffers) are still kept alive by the interior pointers.  */
+/* The pointers found on the thread stacks and in registers are always  */
+/* recognized as before; once this is set for any kind, the stacks are  */
+/* scanned eagerly.  Has no effect if the interior pointers recognition */
+/* is off.  Should be called right after GC_new_kind, before any object */
+/* of the kind is allocated.  The value must be zero or one.  The       */
+/* setter acquires the allocation lock.                                 */
+GC_API void GC_CALL GC_set_kind_exact_base(unsigned /* kind */,
+                                           int /* value */);
+GC_API int GC_CALL GC_get_kind_exact_base(unsigned /* kind */);
+
 /* Return a new mark procedure identifier, suitable for use as  */
 /* the first argument in GC_MAKE_PROC.                          */
 GC_API unsigned GC_CALL GC_new_proc(GC_mark_proc);
@@ -352,6 +385,59 @@ typedef void (GC_CALLBACK * GC_push_other_roots_proc)(void);
 GC_API void GC_CALL GC_set_push_other_roots(GC_push_other_roots_proc);
 GC_API GC_push_other_roots_proc GC_CALL GC_get_push_other_roots(void);
 
+/* Register a partitioned client roots procedure.  Unlike the one set   */
+/* by GC_set_push_other_roots, it is called once per part (numbered     */
+/* from 0 to nparts-1) and, if parallel marking is on, the parts are    */
+/* distributed among the marker threads, which call the procedure       */
+/* concurrently, each one with its own local mark stack.  The           */
+/* procedure should push the objects referenced from the given part of  */
+/* the client roots (e.g. a slice of a handle table) by                 */
+/* GC_MARK_AND_PUSH (as a mark procedure does) and return the updated   */
+/* mark stack pointer; it should not call other GC functions.  The      */
+/* local mark stack is emptied between the calls, thus a part should    */
+/* reference at most some hundreds of objects not to overflow it (an    */
+/* overflow is handled but is costly).  The procedure is called with    */
+/* the allocation lock held at the end of the roots pushing (i.e. in    */
+/* the same context as GC_push_other_roots).  Registering the same      */
+/* procedure and client data again just updates the number of the      */
+/* parts, zero nparts unregisters it.  The client data is not traced.  */
+/* Returns GC_SUCCESS, or GC_NO_MEMORY if there are too many procedures */
+/* registered.  Acquires the allocation lock.                           */
+typedef struct GC_ms_entry * (GC_CALLBACK * GC_push_roots_part_proc)(
+                                unsigned /* part */,
+                                struct GC_ms_entry * /* mark_stack_ptr */,
+                                struct GC_ms_entry * /* mark_stack_limit */,
+                                void * /* client_data */);
+GC_API int GC_CALL GC_register_push_roots_proc(GC_push_roots_part_proc,
+                                               unsigned /* nparts */,
+                                               void * /* client_data */)
+                                                        GC_ATTR_NONNULL(1);
+
+/* Set and get the precise stack roots procedure of the current thread. */
+/* If set, the stack (and the saved registers) of the thread is not     */
+/* scanned conservatively while it is stopped by the collector; instead */
+/* the procedure is called (with the allocation lock held, the world    */
+/* stopped, and the given client data) and it should push all the       */
+/* pointers held by the thread, e.g. by GC_push_all for each range of   */
+/* the pointer slots of the frames of the thread (the slots are not     */
+/* required to be on the stack), or GC_push_all_eager for a stack part  */
+/* to be scanned conservatively.  Thus the client (e.g. a JIT compiler  */
+/* which knows the exact frame layouts) should ensure no pointers are   */
+/* kept elsewhere, i.e. the thread is stopped only at the points where  */
+/* the frames are described (e.g. in a GC_do_blocking call).  The stack */
+/* of the thread performing the collection is still scanned             */
+/* conservatively (and the procedure is called as well).  Passing 0     */
+/* restores the conservative scanning.  The setter returns 1 if the     */
+/* precise roots are supported (the pthreads-based collector except for */
+/* Darwin, E2K, IA-64 and NaCl), 0 otherwise (the stack is scanned      */
+/* conservatively then).  Both the setter and getter acquire the        */
+/* allocation lock, the current thread should be registered.            */
+typedef void (GC_CALLBACK * GC_stack_roots_proc)(void * /* client_data */);
+GC_API int GC_CALL GC_set_my_stack_roots_proc(GC_stack_roots_proc,
+                                              void * /* client_data */);
+GC_API GC_stack_roots_proc GC_CALL GC_get_my_stack_roots_proc(
+                                            void ** /* pclient_data */);
+
 /* Walk the GC heap visiting all reachable objects.  Assume the caller  */
 /* holds the allocation lock.  Object base pointer, object size and     */
 /* client custom data are passed to the callback (holding the lock).    */
@@ -362,6 +448,17 @@ GC_API void GC_CALL GC_enumerate_reachable_objects_inner(
                                 GC_reachable_object_proc,
                                 void * /* client_data */) GC_ATTR_NONNULL(1);
 
+/* Same as GC_enumerate_reachable_objects_inner but the heap is walked  */
+/* by GC_apply_to_all_blocks_parallel, thus the callback is invoked     */
+/* concurrently (and gets the worker index).                            */
+typedef void (GC_CALLBACK *GC_reachable_object_par_proc)(void * /* obj */,
+                                                size_t /* bytes */,
+                                                unsigned /* worker */,
+                                                void * /* client_data */);
+GC_API void GC_CALL GC_enumerate_reachable_objects_parallel_inner(
+                                GC_reachable_object_par_proc,
+                                void * /* client_data */) GC_ATTR_NONNULL(1);
+
 GC_API int GC_CALL GC_is_tmp_root(void *);
 
 GC_API void GC_CALL GC_print_trace(GC_word /* gc_no */);
@@ -90,6 +90,21 @@ GC_API GC_ATTR_MALLOC GC_ATTR_ALLOC_SIZE(1) void * GC_CALL
         GC_malloc_explicitly_typed_ignore_off_page(size_t /* size_in_bytes */,
                                                    GC_descr /* d */);
 
+GC_API GC_ATTR_MALLOC void * GC_CALL
+        GC_malloc_explicitly_typed_many(size_t /* size_in_bytes */,
+                                        GC_descr /* d */);
+                /* The explicitly typed analog of GC_malloc_many.       */
+                /* Return a list of one or more cleared objects of the  */
+                /* given size described by d, linked through their      */
+                /* first word (GC_NEXT can be used to traverse it).     */
+                /* The objects are handed out with their descriptors    */
+                /* already stored, which additionally treat the first   */
+                /* word as a pointer (so that the list is retained by   */
+                /* the collector); the client should clear the link     */
+                /* field of each taken object.  If the thread-local     */
+                /* allocation is available, then the objects come from  */
+                /* the free list of the calling thread.                 */
+
 GC_API GC_ATTR_MALLOC GC_ATTR_CALLOC_SIZE(1, 2) void * GC_CALL
         GC_calloc_explicitly_typed(size_t /* nelements */,
                                    size_t /* element_size_in_bytes */,
@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2022 Ivan Maidanski
+ *
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose, provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/*
+ * This implements gc_weak_map<K, V>, a hash map from collectible objects
+ * of type K to collectible objects of type V, that does not keep its
+ * keys alive.  A value is kept alive by the map only while its key is
+ * reachable by other means (even if the value refers back to the key),
+ * since each entry is backed by an ephemeron (see GC_new_ephemeron).
+ * Once a key becomes unreachable, its entry silently disappears: the
+ * collector clears the hidden key of the entry (registered as
+ * a disappearing link), and the dead entries are purged when the table
+ * is next rehashed (no rescan of the map is needed after a collection).
+ *
+ * The table uses open addressing with linear probing.  Both keys and
+ * values are stored hidden (GC_HIDE_POINTER), thus the table itself is
+ * traced but pins neither of them.  The keys and the values should point
+ * to the beginning of objects allocated by the collector (not by the
+ * debugging allocator).
+ *
+ * find() does not take any lock if the compiler provides atomic builtins
+ * (GCC, Clang), a replaced table is not reused thus remains valid for
+ * the readers still probing it.  insert() and erase() are serialized by
+ * a mutex in C++11 (and later), otherwise the client should serialize
+ * them.  A find() concurrent with erase() of the same key might return
+ * the old value.  The map object itself should reside in memory scanned
+ * by the collector (e.g., static data, stack or collectible object).
+ */
+
+#ifndef GC_WEAK_MAP_H
+#define GC_WEAK_MAP_H
+
+#include "gc.h"
+#include <new> // for bad_alloc
+
+#if __cplusplus >= 201103L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201103L)
+# include <mutex>
+# define GC_WEAK_MAP_MUTEX
+#endif
+
+#if defined(GC_NEW_ABORTS_ON_OOM) || defined(_LIBCPP_NO_EXCEPTIONS)
+# define GC_WEAK_MAP_THROW_OR_ABORT() GC_abort_on_oom()
+#else
+# define GC_WEAK_MAP_THROW_OR_ABORT() throw std::bad_alloc()
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+# define GC_WEAK_MAP_LOAD(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+# define GC_WEAK_MAP_STORE(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#else
+  // No lock-free readers.
+# define GC_WEAK_MAP_LOAD(p) (*(p))
+# define GC_WEAK_MAP_STORE(p, v) (void)(*(p) = (v))
+# ifdef GC_WEAK_MAP_MUTEX
+#   define GC_WEAK_MAP_LOCKED_FIND
+# endif
+#endif
+
+template <class GC_K, class GC_V>
+class gc_weak_map {
+public:
+  gc_weak_map() : table_(0) {}
+
+  // Return the value associated with key, or null if none.
+  GC_V *find(const GC_K *key) const
+  {
+#   ifdef GC_WEAK_MAP_LOCKED_FIND
+      lock_holder holder(mutex_);
+#   endif
+    table *t = GC_WEAK_MAP_LOAD(&table_);
+    slot *s;
+
+    if (0 == t) return 0;
+    s = probe(t, key);
+    if (0 == s) return 0;
+    return static_cast<GC_V *>(GC_REVEAL_POINTER(
+                                        GC_WEAK_MAP_LOAD(&s->hvalue)));
+  }
+
+  // Associate value with key unless key is already present.  Return
+  // the value associated with key in the map after the call.
+  GC_V *insert(GC_K *key, GC_V *value)
+  {
+    lock_holder holder(mutex_);
+    table *t = table_;
+    slot *s;
+    void *eph;
+
+    if (t != 0) {
+      s = probe(t, key);
+      if (s != 0)
+        return static_cast<GC_V *>(GC_REVEAL_POINTER(s->hvalue));
+    }
+    if (0 == t || (t->used + 1) * 4 > (t->mask + 1) * 3) {
+      t = rehash(t);
+      GC_WEAK_MAP_STORE(&table_, t);
+      GC_END_STUBBORN_CHANGE(this);
+    }
+    eph = GC_new_ephemeron(key, value);
+    if (0 == eph)
+      GC_WEAK_MAP_THROW_OR_ABORT();
+    add(t, key, GC_HIDE_POINTER(value), eph);
+    GC_reachable_here(value);
+    return value;
+  }
+
+  // Remove the entry of key.  Return false if none.
+  bool erase(const GC_K *key)
+  {
+    lock_holder holder(mutex_);
+    slot *s = table_ != 0 ? probe(table_, key) : 0;
+
+    if (0 == s) return false;
+    (void)GC_unregister_disappearing_link(
+                                reinterpret_cast<void **>(&s->hkey));
+    GC_WEAK_MAP_STORE(&s->hkey, static_cast<GC_hidden_pointer>(0));
+    GC_WEAK_MAP_STORE(&s->eph, tombstone());
+    GC_END_STUBBORN_CHANGE(s);
+    return true;
+  }
+
+private:
+  struct slot {
+    GC_hidden_pointer hkey; // zero once the key is dead or erased
+    GC_hidden_pointer hvalue;
+    void *eph; // null if the slot is free
+  };
+
+  struct table {
+    size_t mask; // the number of slots minus one
+    size_t used; // the number of non-free slots
+    slot slots[1];
+  };
+
+# ifdef GC_WEAK_MAP_MUTEX
+    typedef std::lock_guard<std::mutex> lock_holder;
+    mutable std::mutex mutex_;
+# else
+    struct dummy_mutex {};
+    struct lock_holder {
+      explicit lock_holder(dummy_mutex &) {}
+    };
+    mutable dummy_mutex mutex_;
+# endif
+
+  table *table_;
+
+  // Not copyable.
+  gc_weak_map(const gc_weak_map &);
+  gc_weak_map &operator=(const gc_weak_map &);
+
+  static void *tombstone() { return reinterpret_cast<void *>(1); }
+
+  static size_t hash(const void *p)
+  {
+    GC_word h = reinterpret_cast<GC_word>(p);
+
+    h = (h >> 4) ^ (h >> 16); // the low bits are the same
+    return static_cast<size_t>(h * 0x9E3779B1UL);
+  }
+
+  // Return the live slot of key, or null if none.
+  static slot *probe(table *t, const GC_K *key)
+  {
+    GC_hidden_pointer hkey = GC_HIDE_POINTER(key);
+
+    for (size_t i = hash(key) & t->mask;; i = (i + 1) & t->mask) {
+      slot *s = &t->slots[i];
+      void *eph = GC_WEAK_MAP_LOAD(&s->eph);
+
+      if (0 == eph) return 0;
+      if (eph != tombstone() && GC_WEAK_MAP_LOAD(&s->hkey) == hkey)
+        return s;
+    }
+  }
+
+  static table *new_table(size_t n_slots)
+  {
+    table *t = static_cast<table *>(GC_MALLOC_IGNORE_OFF_PAGE(
+                        sizeof(table) + (n_slots - 1) * sizeof(slot)));
+
+    if (0 == t)
+      GC_WEAK_MAP_THROW_OR_ABORT();
+    t->mask = n_slots - 1;
+    return t;
+  }
+
+  // Put a new entry to a free slot of t, and publish it.
+  static void add(table *t, GC_K *key, GC_hidden_pointer hvalue, void *eph)
+  {
+    size_t i = hash(key) & t->mask;
+
+    while (t->slots[i].eph != 0)
+      i = (i + 1) & t->mask;
+    slot *s = &t->slots[i];
+    s->hvalue = hvalue;
+    s->hkey = GC_HIDE_POINTER(key);
+    if (GC_general_register_disappearing_link(
+                        reinterpret_cast<void **>(&s->hkey), key)
+          == GC_NO_MEMORY) {
+      s->hkey = 0;
+      GC_WEAK_MAP_THROW_OR_ABORT();
+    }
+    GC_WEAK_MAP_STORE(&s->eph, eph);
+    GC_END_STUBBORN_CHANGE(s);
+    t->used++;
+    GC_reachable_here(key);
+  }
+
+  static void * GC_CALLBACK reveal_key(void *hkey_ptr)
+  {
+    GC_hidden_pointer hkey = *static_cast<GC_hidden_pointer *>(hkey_ptr);
+
+    return hkey != 0 ? GC_REVEAL_POINTER(hkey) : 0;
+  }
+
+  // Copy the live entries of t (if any) to a new table with enough room
+  // for one more entry.  The links of t are not moved, so t remains
+  // valid for the concurrent readers until it is collected.
+  static table *rehash(table *t)
+  {
+    size_t n_live = 0;
+    size_t n_slots = 16;
+    size_t i;
+
+    if (t != 0) {
+      for (i = 0; i <= t->mask; i++) {
+        void *eph = t->slots[i].eph;
+
+        if (eph != 0 && eph != tombstone()
+            && GC_WEAK_MAP_LOAD(&t->slots[i].hkey) != 0)
+          n_live++;
+      }
+    }
+    while (n_slots < (n_live + 1) * 2)
+      n_slots *= 2;
+
+    table *nt = new_table(n_slots);
+    if (t != 0) {
+      for (i = 0; i <= t->mask; i++) {
+        slot *s = &t->slots[i];
+        GC_K *key;
+
+        if (0 == s->eph || s->eph == tombstone()) continue;
+        // Once revealed with the lock held, the key cannot disappear.
+        key = static_cast<GC_K *>(GC_call_with_alloc_lock(reveal_key,
+                                                          &s->hkey));
+        if (key != 0)
+          add(nt, key, s->hvalue, s->eph);
+      }
+    }
+    return nt;
+  }
+};
+
+#endif /* GC_WEAK_MAP_H */
@@ -57,9 +57,14 @@
 # define AO_HAVE_fetch_and_add
 # define AO_fetch_and_add1(p) AO_fetch_and_add(p, 1)
 # define AO_HAVE_fetch_and_add1
+# define AO_fetch_and_sub1_release(p) \
+                __atomic_fetch_sub(p, 1, __ATOMIC_RELEASE)
+# define AO_HAVE_fetch_and_sub1_release
 
 # define AO_or(p, v) (void)__atomic_or_fetch(p, v, __ATOMIC_RELAXED)
 # define AO_HAVE_or
+# define AO_and(p, v) (void)__atomic_and_fetch(p, v, __ATOMIC_RELAXED)
+# define AO_HAVE_and
 
 # define AO_load(p) __atomic_load_n(p, __ATOMIC_RELAXED)
 # define AO_HAVE_load
@@ -75,6 +80,13 @@
 # define AO_store_release_write(p, v) AO_store_release(p, v)
 # define AO_HAVE_store_release_write
 
+# define AO_int_fetch_and_add(p, v) __atomic_fetch_add(p, v, __ATOMIC_RELAXED)
+# define AO_HAVE_int_fetch_and_add
+# define AO_int_load(p) __atomic_load_n(p, __ATOMIC_RELAXED)
+# define AO_HAVE_int_load
+# define AO_int_store(p, v) __atomic_store_n(p, v, __ATOMIC_RELAXED)
+# define AO_HAVE_int_store
+
 # define AO_char_load(p) __atomic_load_n(p, __ATOMIC_RELAXED)
 # define AO_HAVE_char_load
 # define AO_char_store(p, v) __atomic_store_n(p, v, __ATOMIC_RELAXED)
@@ -95,6 +107,23 @@
                                         __ATOMIC_RELEASE, __ATOMIC_RELAXED);
     }
 #   define AO_HAVE_compare_and_swap_release
+
+    AO_INLINE int
+    AO_compare_and_swap_full(volatile AO_t *p, AO_t ov, AO_t nv)
+    {
+      return (int)__atomic_compare_exchange_n(p, &ov, nv, 0,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    }
+#   define AO_HAVE_compare_and_swap_full
+
+    AO_INLINE int
+    AO_int_compare_and_swap_full(volatile unsigned *p, unsigned ov,
+                                 unsigned nv)
+    {
+      return (int)__atomic_compare_exchange_n(p, &ov, nv, 0,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    }
+#   define AO_HAVE_int_compare_and_swap_full
 # endif
 
 # ifdef __cplusplus
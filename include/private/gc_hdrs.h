@@ -32,8 +32,9 @@ typedef struct hblkhdr hdr;
  * retrieve and set object headers.
  *
  * We take advantage of a header lookup
- * cache.  This is a locally declared direct mapped cache, used inside
- * the marker.  The HC_GET_HDR macro uses and maintains this
+ * cache.  This is a small set-associative cache, used inside
+ * the marker (each parallel marker keeps its own one while marking).
+ * The HC_GET_HDR macro uses and maintains this
  * cache.  Assuming we get reasonable hit rates, this shaves a few
  * memory references from each pointer validation.
  */
@@ -58,48 +59,72 @@ typedef struct hblkhdr hdr;
 #endif
 #define TOP_SZ (1 << LOG_TOP_SZ)
 
-/* #define COUNT_HDR_CACHE_HITS  */
-
-#ifdef COUNT_HDR_CACHE_HITS
-  extern word GC_hdr_cache_hits; /* used for debugging/profiling */
-  extern word GC_hdr_cache_misses;
-# define HC_HIT() (void)(++GC_hdr_cache_hits)
-# define HC_MISS() (void)(++GC_hdr_cache_misses)
-#else
-# define HC_HIT() /* empty */
-# define HC_MISS() /* empty */
-#endif
-
 typedef struct hce {
   word block_addr;    /* right shifted by LOG_HBLKSIZE */
   hdr * hce_hdr;
 } hdr_cache_entry;
 
-#define HDR_CACHE_SIZE 8  /* power of 2 */
+#ifndef HDR_CACHE_SIZE
+# define HDR_CACHE_SIZE 64  /* entries, power of 2 */
+#endif
+#ifndef HDR_CACHE_WAYS
+# define HDR_CACHE_WAYS 2   /* power of 2, not greater than HDR_CACHE_SIZE */
+#endif
+
+/* The set of HDR_CACHE_WAYS entries for a block is selected by the     */
+/* low bits of the block number, the entries of a set are kept in the   */
+/* most-recently-used order.  The hits and misses are accumulated in    */
+/* the cache itself, and added to the global statistics (see            */
+/* GC_get_prof_stats) by GC_hdr_cache_flush_stats.                      */
+/* The cache also holds the mark bits not yet written to the mark word  */
+/* (see SET_MARK_BIT_EXIT_IF_SET) as it is local to the marker.  For    */
+/* the same reason, the objects newly marked by the parallel marker are */
+/* counted here (see GC_get_marker_stats).                              */
+typedef struct hdr_cache_s {
+  hdr_cache_entry hc_entries[HDR_CACHE_SIZE];
+  word hc_hits;
+  word hc_misses;
+# ifdef PARALLEL_MARK
+    word hc_n_marked;
+    word hc_marked_bytes;
+# endif
+# ifdef MARK_BIT_BATCHING
+    word *hc_pending_marks;     /* the mark word address or NULL        */
+    word hc_pending_bits;
+# endif
+} hdr_cache_t;
 
 #define DECLARE_HDR_CACHE \
-        hdr_cache_entry hdr_cache[HDR_CACHE_SIZE]
+        hdr_cache_t hdr_cache_local; \
+        hdr_cache_t *hdr_cache = &hdr_cache_local
 
-#define INIT_HDR_CACHE BZERO(hdr_cache, sizeof(hdr_cache))
+#define INIT_HDR_CACHE BZERO(hdr_cache, sizeof(hdr_cache_t))
 
-#define HCE(h) \
-        (hdr_cache + (((word)(h) >> LOG_HBLKSIZE) & (HDR_CACHE_SIZE-1)))
+#define HCE(h) (hdr_cache -> hc_entries \
+                + (((word)(h) >> LOG_HBLKSIZE) \
+                   & (HDR_CACHE_SIZE / HDR_CACHE_WAYS - 1)) * HDR_CACHE_WAYS)
 
 #define HCE_VALID_FOR(hce, h) ((hce) -> block_addr == \
                                 ((word)(h) >> LOG_HBLKSIZE))
 
-#define HCE_HDR(h) ((hce) -> hce_hdr)
-
+/* Look up the other ways of the set (hce points to the first one), */
+/* then the header itself (caching it if appropriate).              */
 #ifdef PRINT_BLACK_LIST
-  GC_INNER hdr * GC_header_cache_miss(ptr_t p, hdr_cache_entry *hce,
-                                      ptr_t source);
+  GC_INNER hdr * GC_header_cache_miss(ptr_t p, hdr_cache_t *hc,
+                                      hdr_cache_entry *hce, ptr_t source);
 # define HEADER_CACHE_MISS(p, hce, source) \
-          GC_header_cache_miss(p, hce, source)
+          GC_header_cache_miss(p, hdr_cache, hce, source)
 #else
-  GC_INNER hdr * GC_header_cache_miss(ptr_t p, hdr_cache_entry *hce);
-# define HEADER_CACHE_MISS(p, hce, source) GC_header_cache_miss(p, hce)
+  GC_INNER hdr * GC_header_cache_miss(ptr_t p, hdr_cache_t *hc,
+                                      hdr_cache_entry *hce);
+# define HEADER_CACHE_MISS(p, hce, source) \
+          GC_header_cache_miss(p, hdr_cache, hce)
 #endif
 
+/* Add the hit and miss counts of the given cache to the global ones,   */
+/* and reset the former.  Could be called without the allocation lock. */
+GC_INNER void GC_hdr_cache_flush_stats(hdr_cache_t *hc);
+
 /* Set hhdr to the header for p.  Analogous to GET_HDR below,           */
 /* except that in the case of large objects, it gets the header for     */
 /* the object beginning if GC_all_interior_pointers is set.             */
@@ -109,7 +134,7 @@ typedef struct hce {
         { /* cannot use do-while(0) here */ \
           hdr_cache_entry * hce = HCE(p); \
           if (EXPECT(HCE_VALID_FOR(hce, p), TRUE)) { \
-            HC_HIT(); \
+            hdr_cache -> hc_hits++; \
             hhdr = hce -> hce_hdr; \
           } else { \
             hhdr = HEADER_CACHE_MISS(p, hce, source); \
@@ -187,18 +212,43 @@ typedef struct bi {
           GET_BI(p, bi); \
           (ha) = &HDR_FROM_BI(bi, p); \
         } while (0)
-# define GET_HDR(p, hhdr) \
+# ifdef FLAT_HDR_TABLE
+    /* Headers of the blocks inside the reserved heap arena are also    */
+    /* kept in a flat table, thus looked up with a single load.  The    */
+    /* tree remains authoritative (and covers memory outside arena).    */
+#   define GET_HDR(p, hhdr) \
+        do { \
+          word _ofs = (word)(p) - GC_arena_start; \
+          if (EXPECT(_ofs < GC_arena_size, TRUE)) { \
+            (hhdr) = GC_flat_hdrs[_ofs >> LOG_HBLKSIZE]; \
+          } else { \
+            REGISTER hdr ** _ha; \
+            GET_HDR_ADDR(p, _ha); \
+            (hhdr) = *_ha; \
+          } \
+        } while (0)
+#   define SET_FLAT_HDR(p, hhdr) \
+        do { \
+          word _ofs = (word)(p) - GC_arena_start; \
+          if (_ofs < GC_arena_size) \
+            GC_flat_hdrs[_ofs >> LOG_HBLKSIZE] = (hhdr); \
+        } while (0)
+# else
+#   define GET_HDR(p, hhdr) \
         do { \
           REGISTER hdr ** _ha; \
           GET_HDR_ADDR(p, _ha); \
           (hhdr) = *_ha; \
         } while (0)
+#   define SET_FLAT_HDR(p, hhdr) (void)0
+# endif
 # define SET_HDR(p, hhdr) \
         do { \
           REGISTER bottom_index * bi; \
           GET_BI(p, bi); \
           GC_ASSERT(bi != GC_all_nils); \
           HDR_FROM_BI(bi, p) = (hhdr); \
+          SET_FLAT_HDR(p, hhdr); \
         } while (0)
 # define HDR(p) GC_find_header((ptr_t)(p))
 #endif
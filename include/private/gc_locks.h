@@ -132,6 +132,19 @@
       /* defined to just a constant) and weak assertion checking.       */
 #   endif
 
+#   if defined(USE_MCS_LOCK) && (!defined(LINUX) \
+        || defined(USE_PTHREAD_LOCKS) || defined(THREAD_SANITIZER) \
+        || defined(GC_ENABLE_SUSPEND_THREAD) \
+        || !defined(AO_HAVE_compare_and_swap_full) \
+        || !defined(AO_HAVE_int_compare_and_swap_full) \
+        || !defined(AO_HAVE_int_load) || !defined(AO_HAVE_int_store))
+      /* The futex-based queued lock is not supported.  A waiter        */
+      /* suspended by GC_suspend_thread (while the suspending thread    */
+      /* holds the lock) would be handed the lock over, thus            */
+      /* GC_resume_thread could never acquire it.                       */
+#     undef USE_MCS_LOCK
+#   endif
+
 #   ifdef SN_TARGET_PSP2
       EXTERN_C_END
 #     include "psp2-support.h"
@@ -146,6 +159,21 @@
                               res = PSP2_MutexUnlock(&GC_allocate_ml_PSP2); \
                               GC_ASSERT(0 == res); (void)res; }
 
+#   elif defined(USE_MCS_LOCK)
+      /* A queued lock: each waiter spins and then sleeps on its own    */
+      /* queue node, and the lock is handed over in the FIFO order.     */
+#     undef USE_SPIN_LOCK
+      GC_INNER void GC_lock(void);
+      GC_INNER void GC_unlock(void);
+#     ifdef GC_ASSERTIONS
+#       define UNCOND_LOCK() \
+              { GC_ASSERT(I_DONT_HOLD_LOCK()); GC_lock(); SET_LOCK_HOLDER(); }
+#       define UNCOND_UNLOCK() \
+              { GC_ASSERT(I_HOLD_LOCK()); UNSET_LOCK_HOLDER(); GC_unlock(); }
+#     else
+#       define UNCOND_LOCK() GC_lock()
+#       define UNCOND_UNLOCK() GC_unlock()
+#     endif
 #   elif (!defined(THREAD_LOCAL_ALLOC) || defined(USE_SPIN_LOCK)) \
          && !defined(USE_PTHREAD_LOCKS) && !defined(THREAD_SANITIZER)
       /* In the THREAD_LOCAL_ALLOC case, the allocation lock tends to   */
@@ -228,7 +256,8 @@
 #   endif /* !GC_WIN32_THREADS */
 # endif /* GC_PTHREADS */
 # if defined(GC_ALWAYS_MULTITHREADED) \
-      && (defined(USE_PTHREAD_LOCKS) || defined(USE_SPIN_LOCK))
+      && (defined(USE_PTHREAD_LOCKS) || defined(USE_SPIN_LOCK) \
+          || defined(USE_MCS_LOCK))
 #   define GC_need_to_lock TRUE
 #   define set_need_to_lock() (void)0
 # else
@@ -142,8 +142,8 @@ GC_INLINE mse * GC_push_obj(ptr_t obj, hdr * hhdr, mse * mark_stack_top,
     hdr * my_hhdr; \
     HC_GET_HDR(current, my_hhdr, source); /* contains "break" */ \
     mark_stack_top = GC_push_contents_hdr(current, mark_stack_top, \
-                                          mark_stack_limit, \
-                                          source, my_hhdr, TRUE); \
+                                          mark_stack_limit, source, \
+                                          my_hhdr, TRUE, hdr_cache); \
   } while (0)
 
 /* Set mark bit, exit (using "break" statement) if it is already set.   */
@@ -156,7 +156,7 @@ GC_INLINE mse * GC_push_obj(ptr_t obj, hdr * hhdr, mse * mark_stack_top,
 #   define SET_MARK_BIT_EXIT_IF_SET(hhdr, bit_no) \
       { /* cannot use do-while(0) here */ \
         volatile unsigned char * mark_byte_addr = \
-                        (unsigned char *)(hhdr)->hb_marks + (bit_no); \
+                        (unsigned char *)HDR_MARKS(hhdr) + (bit_no); \
         /* Unordered atomic load and store are sufficient here. */ \
         if (AO_char_load(mark_byte_addr) != 0) \
           break; /* go to the enclosing loop end */ \
@@ -165,7 +165,7 @@ GC_INLINE mse * GC_push_obj(ptr_t obj, hdr * hhdr, mse * mark_stack_top,
 # else
 #   define SET_MARK_BIT_EXIT_IF_SET(hhdr, bit_no) \
       { /* cannot use do-while(0) here */ \
-        char * mark_byte_addr = (char *)(hhdr)->hb_marks + (bit_no); \
+        char * mark_byte_addr = (char *)HDR_MARKS(hhdr) + (bit_no); \
         if (*mark_byte_addr != 0) break; /* go to the enclosing loop end */ \
         *mark_byte_addr = 1; \
       }
@@ -205,13 +205,52 @@ GC_INLINE mse * GC_push_obj(ptr_t obj, hdr * hhdr, mse * mark_stack_top,
            *(addr) = old | my_bits; \
         }
 # endif /* !PARALLEL_MARK */
-# define SET_MARK_BIT_EXIT_IF_SET(hhdr, bit_no) \
-    { /* cannot use do-while(0) here */ \
-        word * mark_word_addr = (hhdr)->hb_marks + divWORDSZ(bit_no); \
+# ifdef MARK_BIT_BATCHING
+    /* The newly set bits of the same mark word are accumulated in the  */
+    /* marker-local header cache (hdr_cache, if not NULL), and written  */
+    /* by a single atomic "or" once the marker moves to another word    */
+    /* (or by FLUSH_PENDING_MARKS).  Meanwhile, another marker may push */
+    /* the object once more, which is benign as mentioned above.        */
+#   define FLUSH_PENDING_MARKS(hc) \
+        do { \
+          if ((hc) -> hc_pending_marks != NULL) { \
+            AO_or((volatile AO_t *)(hc)->hc_pending_marks, \
+                  (AO_t)(hc)->hc_pending_bits); \
+            (hc) -> hc_pending_marks = NULL; \
+          } \
+        } while (0)
+#   define SET_MARK_BIT_EXIT_IF_SET(hhdr, bit_no) \
+      { /* cannot use do-while(0) here */ \
+        word * mark_word_addr = HDR_MARKS(hhdr) + divWORDSZ(bit_no); \
+        word my_bits = (word)1 << modWORDSZ(bit_no); \
+        \
+        if (NULL == hdr_cache) { \
+          OR_WORD_EXIT_IF_SET(mark_word_addr, my_bits); \
+        } else if (hdr_cache -> hc_pending_marks == mark_word_addr) { \
+          if (((hdr_cache -> hc_pending_bits | *mark_word_addr) \
+               & my_bits) != 0) \
+            break; /* go to the enclosing loop end */ \
+          hdr_cache -> hc_pending_bits |= my_bits; \
+        } else { \
+          if ((*mark_word_addr & my_bits) != 0) \
+            break; /* go to the enclosing loop end */ \
+          FLUSH_PENDING_MARKS(hdr_cache); \
+          hdr_cache -> hc_pending_marks = mark_word_addr; \
+          hdr_cache -> hc_pending_bits = my_bits; \
+        } \
+      }
+# else
+#   define SET_MARK_BIT_EXIT_IF_SET(hhdr, bit_no) \
+      { /* cannot use do-while(0) here */ \
+        word * mark_word_addr = HDR_MARKS(hhdr) + divWORDSZ(bit_no); \
         OR_WORD_EXIT_IF_SET(mark_word_addr, \
                 (word)1 << modWORDSZ(bit_no)); /* contains "break" */ \
-    }
+      }
+# endif /* !MARK_BIT_BATCHING */
 #endif /* !USE_MARK_BYTES */
+#ifndef FLUSH_PENDING_MARKS
+# define FLUSH_PENDING_MARKS(hc) (void)0
+#endif
 
 #ifdef PARALLEL_MARK
 # define INCR_MARKS(hhdr) \
@@ -251,6 +290,14 @@ GC_INLINE mse * GC_push_obj(ptr_t obj, hdr * hhdr, mse * mark_stack_top,
     } while (0)
 #endif /* !I386 */
 
+/* Is the given displacement from the object beginning valid for the    */
+/* objects of the block?  Only the registered displacements are valid   */
+/* for the kinds requiring an exact base.                               */
+#define GC_IS_VALID_OFFSET(hhdr, obj_displ) \
+        ((GC_valid_offsets[obj_displ] & VALID_OFFSET_REGISTERED) != 0 \
+         || (GC_valid_offsets[obj_displ] != 0 \
+             && !GC_obj_kinds[(hhdr) -> hb_obj_kind].ok_exact_base))
+
 /* If the mark bit corresponding to current is not set, set it, and     */
 /* push the contents of the object on the mark stack.  Current points   */
 /* to the beginning of the object.  We rely on the fact that the        */
@@ -259,11 +306,17 @@ GC_INLINE mse * GC_push_obj(ptr_t obj, hdr * hhdr, mse * mark_stack_top,
 /* to the object.  Thus we can omit the otherwise necessary tests       */
 /* here.  Note in particular that the "displ" value is the displacement */
 /* from the beginning of the heap block, which may itself be in the     */
-/* interior of a large object.                                          */
+/* interior of a large object.  hdr_cache is the header cache of the   */
+/* marker (or NULL), it is used only if MARK_BIT_BATCHING or to count   */
+/* the marked objects in case of the parallel marker.                   */
 GC_INLINE mse * GC_push_contents_hdr(ptr_t current, mse * mark_stack_top,
                                      mse * mark_stack_limit, ptr_t source,
-                                     hdr * hhdr, GC_bool do_offset_check)
+                                     hdr * hhdr, GC_bool do_offset_check,
+                                     hdr_cache_t *hdr_cache)
 {
+# if !defined(MARK_BIT_BATCHING) && !defined(PARALLEL_MARK)
+    UNUSED_ARG(hdr_cache);
+# endif
   do {
     size_t displ = HBLKDISPL(current); /* Displacement in block; in bytes. */
     /* displ is always within range.  If current doesn't point to the   */
@@ -298,7 +351,12 @@ GC_INLINE mse * GC_push_contents_hdr(ptr_t current, mse * mark_stack_top,
           GC_ASSERT(obj_displ < hhdr -> hb_sz);
           /* Must be in all_interior_pointer case, not first block      */
           /* already did validity check on cache miss.                  */
-        } else if (do_offset_check && !GC_valid_offsets[obj_displ]) {
+          if (do_offset_check
+              && GC_obj_kinds[hhdr -> hb_obj_kind].ok_exact_base) {
+            GC_ADD_TO_BLACK_LIST_NORMAL(current, source);
+            break;
+          }
+        } else if (do_offset_check && !GC_IS_VALID_OFFSET(hhdr, obj_displ)) {
           GC_ADD_TO_BLACK_LIST_NORMAL(current, source);
           break;
         }
@@ -324,7 +382,7 @@ GC_INLINE mse * GC_push_contents_hdr(ptr_t current, mse * mark_stack_top,
             GC_STATIC_ASSERT(HBLKSIZE <= (1 << 15));
             obj_displ = (((low_prod >> 16) + 1) * (size_t)hhdr->hb_sz) >> 16;
 #         endif
-          if (do_offset_check && !GC_valid_offsets[obj_displ]) {
+          if (do_offset_check && !GC_IS_VALID_OFFSET(hhdr, obj_displ)) {
             GC_ADD_TO_BLACK_LIST_NORMAL(current, source);
             break;
           }
@@ -345,6 +403,7 @@ GC_INLINE mse * GC_push_contents_hdr(ptr_t current, mse * mark_stack_top,
 #   endif /* MARK_BIT_PER_OBJ */
     TRACE(source, GC_log_printf("GC #%lu: passed validity tests\n",
                                 (unsigned long)GC_gc_no));
+    VALIDATE_MARKS(hhdr);
     SET_MARK_BIT_EXIT_IF_SET(hhdr, gran_displ); /* contains "break" */
     TRACE(source, GC_log_printf("GC #%lu: previously unmarked\n",
                                 (unsigned long)GC_gc_no));
@@ -352,6 +411,12 @@ GC_INLINE mse * GC_push_contents_hdr(ptr_t current, mse * mark_stack_top,
                                      (unsigned long)GC_gc_no, (void *)base,
                                      (void *)source));
     INCR_MARKS(hhdr);
+#   ifdef PARALLEL_MARK
+      if (hdr_cache != NULL) {
+        hdr_cache -> hc_n_marked++;
+        hdr_cache -> hc_marked_bytes += hhdr -> hb_sz;
+      }
+#   endif
     GC_STORE_BACK_PTR(source, base);
     mark_stack_top = GC_push_obj(base, hhdr, mark_stack_top,
                                  mark_stack_limit);
@@ -82,6 +82,10 @@
 # endif
 #endif
 
+#if defined(USE_MCS_LOCK) && !defined(AO_REQUIRE_CAS)
+# define AO_REQUIRE_CAS
+#endif
+
 #include "gc/gc_tiny_fl.h"
 #include "gc/gc_mark.h"
 
@@ -382,6 +386,14 @@ EXTERN_C_BEGIN
                         /* for processing by GC_invoke_finalizers.      */
                         /* Invoked with lock.                           */
 
+# ifndef GC_MOVABLE_NOT_NEEDED
+    GC_INNER void GC_evacuate_movable(void);
+                        /* Copy the live objects of the movable kind    */
+                        /* out of the sparsely occupied blocks, and     */
+                        /* update their registered handles.  Invoked    */
+                        /* with lock after GC_finalize, before sweep.   */
+# endif
+
 # ifndef GC_TOGGLE_REFS_NOT_NEEDED
     GC_INNER void GC_process_togglerefs(void);
                         /* Process the toggle-refs before GC starts.    */
@@ -586,6 +598,9 @@ EXTERN_C_END
     /* to avoid "variable might be uninitialized" compiler warnings.    */
 #   define CLOCK_TYPE_INITIALIZER 0
 # endif
+# define NS_TIME_DIFF(a, b) ((word)MS_TIME_DIFF(a, b) * 1000000 \
+                             + NS_FRAC_TIME_DIFF(a, b))
+                        /* The total time difference in nanoseconds.    */
 #endif /* !NO_CLOCK */
 
 /* We use bzero and bcopy internally.  They may not be available.       */
@@ -627,6 +642,20 @@ EXTERN_C_BEGIN
 # endif
 #endif /* CPPCHECK */
 
+/* Static tracing probes (USDT, systemtap-sdt compatible) of provider  */
+/* "bdwgc"; no-op unless USDT_PROBES is defined.  The probes are used  */
+/* as statements.                                                       */
+#ifdef USDT_PROBES
+# include <sys/sdt.h>
+# define GC_PROBE(name) STAP_PROBE(bdwgc, name)
+# define GC_PROBE1(name, a1) STAP_PROBE1(bdwgc, name, a1)
+# define GC_PROBE2(name, a1, a2) STAP_PROBE2(bdwgc, name, a1, a2)
+#else
+# define GC_PROBE(name) (void)0
+# define GC_PROBE1(name, a1) (void)0
+# define GC_PROBE2(name, a1, a2) (void)0
+#endif
+
 /*
  * Stop and restart mutator threads.
  */
@@ -644,8 +673,23 @@ EXTERN_C_BEGIN
        || defined(GC_WIN32_THREADS) || defined(GC_PTHREADS)
       GC_INNER void GC_stop_world(void);
       GC_INNER void GC_start_world(void);
-#     define STOP_WORLD() GC_stop_world()
-#     define START_WORLD() GC_start_world()
+#     ifdef USDT_PROBES
+#       define STOP_WORLD() \
+                do { \
+                  GC_PROBE(stop_world_start); \
+                  GC_stop_world(); \
+                  GC_PROBE(stop_world_done); \
+                } while (0)
+#       define START_WORLD() \
+                do { \
+                  GC_PROBE(start_world_start); \
+                  GC_start_world(); \
+                  GC_PROBE(start_world_done); \
+                } while (0)
+#     else
+#       define STOP_WORLD() GC_stop_world()
+#       define START_WORLD() GC_start_world()
+#     endif
 #   else
         /* Just do a sanity check: we are not inside GC_do_blocking().  */
 #     define STOP_WORLD() GC_ASSERT(GC_blocked_sp == NULL)
@@ -1148,6 +1192,24 @@ struct hblkhdr {
 #       ifdef MARK_BIT_PER_GRANULE
 #         define LARGE_BLOCK 0x20
 #       endif
+#       ifdef USE_LARGE_OBJ_SPACE
+#         define LOS_BLK 0x40   /* The object has its own memory        */
+                                /* mapping (not a part of any heap      */
+                                /* section), it is unmapped once freed. */
+#       endif
+#       define FROZEN_BLK 0x80  /* The block is a part of the frozen    */
+                                /* heap (see GC_freeze_heap): its mark  */
+                                /* bits are never cleared and it is     */
+                                /* never swept, only scanned.           */
+    unsigned char hb_rescan;    /* Some of the mark stack entries       */
+                                /* dropped on the mark stack overflow   */
+                                /* point to the block, so the marked    */
+                                /* objects in it should be pushed again */
+                                /* (see GC_push_next_marked).           */
+#   ifdef USE_NUMA
+      unsigned char hb_node;    /* NUMA node the block memory is bound  */
+                                /* to (0 unless NUMA mode is on).       */
+#   endif
     unsigned short hb_last_reclaimed;
                                 /* Value of GC_gc_no when block was     */
                                 /* last allocated or swept. May wrap.   */
@@ -1197,6 +1259,11 @@ struct hblkhdr {
       size_t hb_n_marks;        /* Without parallel marking, the count  */
                                 /* is accurate.                         */
 #   endif
+    word hb_mark_epoch;         /* The value of GC_mark_epoch the mark  */
+                                /* bits (and hb_n_marks) belong to.     */
+                                /* The bits of an older epoch are       */
+                                /* stale, i.e. they are treated as      */
+                                /* clear (see VALIDATE_MARKS).          */
 #   ifdef USE_MARK_BYTES
 #     define MARK_BITS_SZ (MARK_BITS_PER_HBLK + 1)
         /* Unlike the other case, this is in units of bytes.            */
@@ -1219,8 +1286,42 @@ struct hblkhdr {
 #     define MARK_BITS_SZ (MARK_BITS_PER_HBLK/CPP_WORDSZ + 1)
       word hb_marks[MARK_BITS_SZ];
 #   endif /* !USE_MARK_BYTES */
+#   ifdef SIDE_MARK_BITMAP
+#     ifdef USE_MARK_BYTES
+        char *hb_mark_bits;
+#       define SIDE_MARKS_SLOT_SZ \
+                (((word)MARK_BITS_SZ + sizeof(word) - 1) & ~(sizeof(word) - 1))
+#     else
+        word *hb_mark_bits;
+#       define SIDE_MARKS_SLOT_SZ ((word)MARK_BITS_SZ * sizeof(word))
+#     endif
+                                /* The mark bits actually used: either  */
+                                /* the slot of the block in the side    */
+                                /* bitmap of the arena or hb_marks.     */
+                                /* SIDE_MARKS_SLOT_SZ is the slot size  */
+                                /* in bytes.                            */
+#   endif
+#   ifdef ENABLE_DISCLAIM
+#     define DISCLAIM_BITS_SZ (MARK_BITS_PER_HBLK/CPP_WORDSZ + 1)
+      word hb_disclaim_bits[DISCLAIM_BITS_SZ];
+                                /* Only for the kinds with              */
+                                /* ok_disclaim_needed_only: i'th bit is */
+                                /* set if the object with the mark bit  */
+                                /* number i has been passed to          */
+                                /* GC_set_disclaim_needed.  Cleared     */
+                                /* once the object is disclaimed.  A    */
+                                /* zero bitmap lets the sweep skip the  */
+                                /* disclaim pass for the block.         */
+#   endif
 };
 
+/* The mark bits (or bytes) of the block described by hhdr.   */
+#ifdef SIDE_MARK_BITMAP
+# define HDR_MARKS(hhdr) ((hhdr) -> hb_mark_bits)
+#else
+# define HDR_MARKS(hhdr) ((hhdr) -> hb_marks)
+#endif
+
 # define ANY_INDEX 23   /* "Random" mark bit index for assertions */
 
 /*  heap block body */
@@ -1287,6 +1388,33 @@ struct roots {
                 /* Delete before registering new dynamic libraries */
 };
 
+#ifdef FROZEN_ROOTS
+# ifndef MAX_FROZEN_ROOTS
+#   define MAX_FROZEN_ROOTS 64
+# endif
+
+  /* A root registered by GC_add_frozen_roots.  Instead of the range    */
+  /* itself, the collector pushes the compact array of the heap         */
+  /* pointers found in it (fr_ptrs), which is updated only for the      */
+  /* HBLKSIZE pages written since they were scanned.                    */
+  struct GC_frozen_root_s {
+    ptr_t fr_start;     /* multiple of word size */
+    ptr_t fr_end;
+    word *fr_ptrs;      /* the remembered pointers, page by page */
+    size_t fr_n_ptrs;
+    size_t fr_ptrs_cap; /* the capacity of fr_ptrs  */
+    unsigned short *fr_page_counts;
+                        /* The number of fr_ptrs elements for each page */
+                        /* (the first page is the one containing        */
+                        /* fr_start).                                   */
+    unsigned char *fr_stale;
+                        /* Nonzero for each page to be rescanned.       */
+    size_t fr_n_stale;  /* the number of nonzero fr_stale elements      */
+    size_t fr_n_pages;
+    GC_bool fr_valid;   /* fr_ptrs and fr_page_counts are filled in.    */
+  };
+#endif
+
 #if !defined(MSWIN32) && !defined(MSWINCE) && !defined(CYGWIN32)
     /* Size of hash table index to roots.       */
 #   define LOG_RT_SIZE 6
@@ -1326,15 +1454,50 @@ typedef int mark_state_t;   /* Current state of marking.                */
                             /* Used to remember where we are during     */
                             /* concurrent marking.                      */
 
-struct disappearing_link;
 struct finalizable_object;
 
-struct dl_hashtbl_s {
-    struct disappearing_link **head;
+#if defined(THREADS) && defined(AO_HAVE_test_and_set_acquire) \
+    && (defined(GC_PTHREADS) || defined(GC_WIN32_THREADS))
+  /* The client operations on the disappearing links acquire just the   */
+  /* lock of the table shard, not the allocation lock.                  */
+# define DL_SHARD_LOCKS
+#endif
+
+#ifndef LOG_DL_SHARDS
+# define LOG_DL_SHARDS 4
+#endif
+#define DL_SHARDS (1 << LOG_DL_SHARDS)
+
+/* A shard of a disappearing links table.  The slots are the pairs of   */
+/* the hidden link and object pointers, with open addressing; a slot    */
+/* with zero link is empty.                                             */
+struct dl_shard_s {
+    word *slots;        /* Cache-line aligned pointer into slots_base.  */
+    ptr_t slots_base;   /* The pointer-free object holding the slots.   */
     word entries;
-    unsigned log_size;
+    word notify_entries; /* The number of the entries registered by     */
+                        /* GC_register_disappearing_link_notify.        */
+    unsigned log_size;  /* Log2 of the number of slots.                 */
+#   ifdef DL_SHARD_LOCKS
+      volatile AO_TS_t lock;
+#   endif
 };
 
+struct dl_hashtbl_s {
+    union {
+      struct dl_shard_s s;
+      char pad[CACHE_LINE_SIZE]; /* to avoid false sharing of locks */
+    } shards[DL_SHARDS];
+};
+
+#if defined(DL_SHARD_LOCKS) && !defined(GC_NO_FINALIZATION)
+  GC_INNER void GC_acquire_dl_shard_locks(void);
+  GC_INNER void GC_release_dl_shard_locks(void);
+                        /* Acquire (release) the locks of all shards of */
+                        /* the disappearing links tables.  Called with  */
+                        /* the allocation lock held (around fork).      */
+#endif
+
 struct fnlz_roots_s {
   struct finalizable_object **fo_head;
   /* List of objects that should be finalized now: */
@@ -1518,13 +1681,37 @@ struct _GC_arrays {
 #   define GC_dl_hashtbl GC_arrays._dl_hashtbl
 #   define GC_fnlz_roots GC_arrays._fnlz_roots
 #   define GC_log_fo_table_size GC_arrays._log_fo_table_size
+#   define GC_young_fo_arr GC_arrays._young_fo_arr
+#   define GC_young_fo_size GC_arrays._young_fo_size
+#   define GC_young_fo_capacity GC_arrays._young_fo_capacity
 #   ifndef GC_LONG_REFS_NOT_NEEDED
 #     define GC_ll_hashtbl GC_arrays._ll_hashtbl
       struct dl_hashtbl_s _ll_hashtbl;
+#   endif
+#   ifndef GC_MOVABLE_NOT_NEEDED
+#     define GC_mh_hashtbl GC_arrays._mh_hashtbl
+      struct dl_hashtbl_s _mh_hashtbl;
 #   endif
     struct dl_hashtbl_s _dl_hashtbl;
+#   define GC_dl_queue GC_arrays._dl_queue
+#   define GC_dl_queue_size GC_arrays._dl_queue_size
+#   define GC_dl_queue_capacity GC_arrays._dl_queue_capacity
+    word *_dl_queue;
+                /* The queue of the cleared links to be drained by      */
+                /* GC_drain_cleared_links.  Each element is a pair of   */
+                /* the base of the object containing the link (or NULL) */
+                /* and the hidden link.  Updated holding the allocation */
+                /* lock, its size is read without it.                   */
+    word _dl_queue_size;
+    word _dl_queue_capacity;
     struct fnlz_roots_s _fnlz_roots;
     unsigned _log_fo_table_size;
+    word *_young_fo_arr;
+                /* Hidden pointers to the objects registered for        */
+                /* finalization since the previous collection (possibly */
+                /* with duplicates and already unregistered ones).      */
+    size_t _young_fo_size;
+    size_t _young_fo_capacity;
 #   ifndef GC_TOGGLE_REFS_NOT_NEEDED
 #     define GC_toggleref_arr GC_arrays._toggleref_arr
 #     define GC_toggleref_array_size GC_arrays._toggleref_array_size
@@ -1532,6 +1719,25 @@ struct _GC_arrays {
       union toggle_ref_u *_toggleref_arr;
       size_t _toggleref_array_size;
       size_t _toggleref_array_capacity;
+#     define GC_toggleref_dirty_set GC_arrays._toggleref_dirty_set
+#     define GC_log_toggleref_dirty_set_size \
+                GC_arrays._log_toggleref_dirty_set_size
+#     define GC_toggleref_dirty_entries GC_arrays._toggleref_dirty_entries
+      word *_toggleref_dirty_set;
+                /* Hidden pointers to the objects passed to             */
+                /* GC_toggleref_mark_dirty since the last toggle-refs   */
+                /* processing, an open-addressing hash set.             */
+      unsigned _log_toggleref_dirty_set_size;
+      size_t _toggleref_dirty_entries;
+#   endif
+#   ifndef GC_EPHEMERONS_NOT_NEEDED
+#     define GC_ephemeron_arr GC_arrays._ephemeron_arr
+#     define GC_ephemeron_array_size GC_arrays._ephemeron_array_size
+#     define GC_ephemeron_array_capacity GC_arrays._ephemeron_array_capacity
+      word *_ephemeron_arr;
+                /* Hidden pointers to the registered ephemerons.        */
+      size_t _ephemeron_array_size;
+      size_t _ephemeron_array_capacity;
 #   endif
 # endif
 # ifdef TRACE_BUF
@@ -1620,10 +1826,21 @@ struct _GC_arrays {
                        /* test.                                         */
 #   define OBJ_MAP_LEN  BYTES_TO_GRANULES(HBLKSIZE)
 # endif
+# ifdef BITMAP_SWEEP
+#   define GC_obj_start_masks GC_arrays._obj_start_masks
+    word _obj_start_masks[MAXOBJGRANULES + 1][HBLK_GRANULES / CPP_WORDSZ];
+                       /* GC_obj_start_masks[sz_in_granules] has the    */
+                       /* mark bits set for every object of the size    */
+                       /* which fits in a block entirely.               */
+# endif
 # define VALID_OFFSET_SZ HBLKSIZE
   char _valid_offsets[VALID_OFFSET_SZ];
-                                /* GC_valid_offsets[i] == TRUE ==> i    */
-                                /* is registered as a displacement.     */
+                                /* GC_valid_offsets[i] != 0 ==> i is    */
+                                /* a valid displacement; the            */
+                                /* VALID_OFFSET_REGISTERED bit is set   */
+                                /* if i is registered explicitly (or    */
+                                /* is zero).                            */
+# define VALID_OFFSET_REGISTERED 2
 # ifndef GC_DISABLE_INCREMENTAL
 #   define GC_grungy_pages GC_arrays._grungy_pages
     page_hash_table _grungy_pages; /* Pages that were dirty at last     */
@@ -1631,6 +1848,10 @@ struct _GC_arrays {
 #   define GC_dirty_pages GC_arrays._dirty_pages
     volatile page_hash_table _dirty_pages;
                         /* Pages dirtied since last GC_read_dirty. */
+#   define GC_grungy_cards GC_arrays._grungy_cards
+    unsigned char _grungy_cards[GC_CARD_TABLE_SIZE];
+                        /* The copy of GC_card_table at last            */
+                        /* GC_read_dirty; used in the manual VDB mode.  */
 # endif
 # if (defined(CHECKSUMS) && (defined(GWW_VDB) || defined(SOFT_VDB))) \
      || defined(PROC_VDB)
@@ -1656,6 +1877,26 @@ struct _GC_arrays {
 #   define GC_heap_lengths GC_arrays._heap_lengths
     word _heap_lengths[MAX_HEAP_SECTS];
                 /* Committed lengths of memory regions obtained from kernel. */
+# endif
+# ifdef USE_HEAP_ARENA
+#   define GC_arena_start GC_arrays._arena_start
+    word _arena_start;  /* The HBLKSIZE-aligned start of the reserved   */
+                        /* heap arena.                                  */
+#   define GC_arena_size GC_arrays._arena_size
+    word _arena_size;   /* The size of the arena, zero if the arena     */
+                        /* could not be reserved.                       */
+# endif
+# ifdef FLAT_HDR_TABLE
+#   define GC_flat_hdrs GC_arrays._flat_hdrs
+    hdr **_flat_hdrs;   /* A lazily committed mirror of the block       */
+                        /* headers of the arena indexed by the block    */
+                        /* number relative to GC_arena_start.           */
+# endif
+# ifdef SIDE_MARK_BITMAP
+#   define GC_side_marks GC_arrays._side_marks
+    ptr_t _side_marks;  /* The lazily committed mark bits of the arena  */
+                        /* blocks, SIDE_MARKS_SLOT_SZ bytes per block,  */
+                        /* so the bits of adjacent blocks are dense.    */
 # endif
   struct roots _static_roots[MAX_ROOT_SETS];
   struct exclusion _excl_table[MAX_EXCLUSIONS];
@@ -1719,6 +1960,12 @@ GC_EXTERN struct obj_kind {
                         /* template is used as is.                      */
   GC_bool ok_init;
                 /* Clear objects before putting them on the free list.  */
+  GC_bool ok_exact_base;
+                        /* Recognize only the pointers to the object    */
+                        /* beginning or at a registered displacement    */
+                        /* even if GC_all_interior_pointers is on.      */
+                        /* Not applied to the pointers found on the     */
+                        /* thread stacks and in registers.              */
 # ifdef ENABLE_DISCLAIM
     GC_bool ok_mark_unconditionally;
                         /* Mark from all, including unmarked, objects   */
@@ -1729,7 +1976,17 @@ GC_EXTERN struct obj_kind {
                         /* is reclaimed, but must also tolerate being   */
                         /* called with object from freelist.  Non-zero  */
                         /* exit prevents object from being reclaimed.   */
-#   define OK_DISCLAIM_INITZ /* comma */, FALSE, 0
+    void (GC_CALLBACK *ok_disclaim_batch_proc)(void ** /*objs*/,
+                                               size_t /*n*/);
+                        /* Alternative to ok_disclaim_proc, called for  */
+                        /* the unmarked objects of a block by batches,  */
+                        /* cannot resurrect them.                       */
+    GC_bool ok_disclaim_needed_only;
+                        /* Pass only the objects flagged in             */
+                        /* hb_disclaim_bits to ok_disclaim_batch_proc;  */
+                        /* the blocks with no flagged objects are swept */
+                        /* (or freed if empty) as usual.                */
+#   define OK_DISCLAIM_INITZ /* comma */, FALSE, 0, 0, FALSE
 # else
 #   define OK_DISCLAIM_INITZ /* empty */
 # endif /* !ENABLE_DISCLAIM */
@@ -1772,6 +2029,11 @@ GC_EXTERN struct obj_kind {
 
 GC_EXTERN unsigned GC_n_kinds;
 
+GC_EXTERN GC_bool GC_have_exact_base_kinds;
+                /* ok_exact_base is set for some kind, thus the stacks  */
+                /* should not be pushed as ordinary ranges (which are   */
+                /* subject to the offset check by the marker).          */
+
 GC_EXTERN size_t GC_page_size;
                 /* May mean the allocation granularity size, not page size. */
 
@@ -1805,6 +2067,25 @@ GC_EXTERN word GC_black_list_spacing;
                         /* "stack-blacklisted", i.e. that are           */
                         /* problematic in the interior of an object.    */
 
+GC_EXTERN unsigned GC_log_bl_entries;
+                        /* Log2 of the current number of bits in each   */
+                        /* black list; grows with the heap.             */
+
+GC_EXTERN word GC_black_list_rejects;
+                        /* Number of candidate heap block positions     */
+                        /* rejected by GC_allochblk_nth as black listed.*/
+
+GC_EXTERN word GC_external_bytes;
+                        /* Bytes of the memory outside the GC heap      */
+                        /* owned by the objects, as reported by         */
+                        /* GC_adjust_external_bytes (the value is       */
+                        /* treated as signed).  Updated atomically if   */
+                        /* possible.                                    */
+
+GC_INNER word GC_get_external_bytes_inner(void);
+                        /* Same as GC_get_external_bytes but does not   */
+                        /* acquire the lock.                            */
+
 #ifdef GC_GCJ_SUPPORT
   extern struct hblk * GC_hblkfreelist[];
   extern word GC_free_bytes[];  /* Both remain visible to GNU GCJ.      */
@@ -1870,9 +2151,9 @@ struct GC_traced_stack_sect_s {
  */
 
 #ifdef USE_MARK_BYTES
-# define mark_bit_from_hdr(hhdr,n) ((hhdr)->hb_marks[n])
-# define set_mark_bit_from_hdr(hhdr,n) ((hhdr)->hb_marks[n] = 1)
-# define clear_mark_bit_from_hdr(hhdr,n) ((hhdr)->hb_marks[n] = 0)
+# define mark_bit_from_hdr(hhdr,n) (HDR_MARKS(hhdr)[n])
+# define set_mark_bit_from_hdr(hhdr,n) (HDR_MARKS(hhdr)[n] = 1)
+# define clear_mark_bit_from_hdr(hhdr,n) (HDR_MARKS(hhdr)[n] = 0)
 #else
 /* Set mark bit correctly, even if mark bits may be concurrently        */
 /* accessed.                                                            */
@@ -1886,11 +2167,11 @@ struct GC_traced_stack_sect_s {
 #   define OR_WORD(addr, bits) (void)(*(addr) |= (bits))
 # endif
 # define mark_bit_from_hdr(hhdr,n) \
-              (((hhdr)->hb_marks[divWORDSZ(n)] >> modWORDSZ(n)) & (word)1)
+              ((HDR_MARKS(hhdr)[divWORDSZ(n)] >> modWORDSZ(n)) & (word)1)
 # define set_mark_bit_from_hdr(hhdr,n) \
-              OR_WORD((hhdr)->hb_marks+divWORDSZ(n), (word)1 << modWORDSZ(n))
+              OR_WORD(HDR_MARKS(hhdr)+divWORDSZ(n), (word)1 << modWORDSZ(n))
 # define clear_mark_bit_from_hdr(hhdr,n) \
-              ((hhdr)->hb_marks[divWORDSZ(n)] &= ~((word)1 << modWORDSZ(n)))
+              (HDR_MARKS(hhdr)[divWORDSZ(n)] &= ~((word)1 << modWORDSZ(n)))
 #endif /* !USE_MARK_BYTES */
 
 #ifdef MARK_BIT_PER_OBJ
@@ -1911,6 +2192,28 @@ struct GC_traced_stack_sect_s {
                                 : BYTES_TO_GRANULES((sz) * HBLK_OBJS(sz)))
 #endif
 
+#ifdef ENABLE_DISCLAIM
+  /* The bits of hb_disclaim_bits are set by the client without the     */
+  /* lock if possible, and are cleared with the lock held.              */
+# if defined(THREADS) && defined(AO_HAVE_or) && defined(AO_HAVE_and)
+#   define DISCLAIM_BITS_ATOMIC
+#   define SET_DISCLAIM_BIT(hhdr, n) \
+        AO_or((volatile AO_t *)&(hhdr)->hb_disclaim_bits[divWORDSZ(n)], \
+              (AO_t)((word)1 << modWORDSZ(n)))
+#   define CLEAR_DISCLAIM_BITS(hhdr, i, bits) \
+        AO_and((volatile AO_t *)&(hhdr)->hb_disclaim_bits[i], \
+               ~(AO_t)(bits))
+# else
+#   define SET_DISCLAIM_BIT(hhdr, n) \
+        (void)((hhdr)->hb_disclaim_bits[divWORDSZ(n)] \
+                |= (word)1 << modWORDSZ(n))
+#   define CLEAR_DISCLAIM_BITS(hhdr, i, bits) \
+        (void)((hhdr)->hb_disclaim_bits[i] &= ~(word)(bits))
+# endif
+# define CLEAR_DISCLAIM_BIT(hhdr, n) \
+        CLEAR_DISCLAIM_BITS(hhdr, divWORDSZ(n), (word)1 << modWORDSZ(n))
+#endif /* ENABLE_DISCLAIM */
+
 /* Important internal collector routines */
 
 GC_INNER ptr_t GC_approx_sp(void);
@@ -1929,7 +2232,12 @@ GC_INNER struct hblk * GC_prev_block(struct hblk * h);
                         /* Return 0 if there is no such block.          */
 GC_INNER void GC_mark_init(void);
 GC_INNER void GC_clear_marks(void);
-                        /* Clear mark bits for all heap objects.        */
+                        /* Clear mark bits for all heap objects (by     */
+                        /* starting a new mark epoch).                  */
+GC_EXTERN word GC_mark_epoch;
+                        /* The current mark epoch (see VALIDATE_MARKS). */
+                        /* Updated only with the allocation lock held   */
+                        /* and no markers running.                      */
 GC_INNER void GC_invalidate_mark_state(void);
                                 /* Tell the marker that marked          */
                                 /* objects may point to unmarked        */
@@ -1983,6 +2291,16 @@ GC_INNER void GC_push_all_stack(ptr_t b, ptr_t t);
 GC_INNER void GC_push_roots(GC_bool all, ptr_t cold_gc_frame);
                                         /* Push all or dirty roots.     */
 
+GC_EXTERN unsigned GC_n_push_roots_procs;
+                        /* The number of the procedures registered by   */
+                        /* GC_register_push_roots_proc.                 */
+
+GC_INNER void GC_push_client_roots(void);
+                        /* Call the registered partitioned client roots */
+                        /* procedures for all their parts (using all    */
+                        /* the marker threads if parallel marking is    */
+                        /* on).  The caller holds the GC lock.          */
+
 GC_API_PRIV GC_push_other_roots_proc GC_push_other_roots;
                         /* Push system or application specific roots    */
                         /* onto the mark stack.  In some environments   */
@@ -2131,6 +2449,29 @@ GC_INNER void GC_with_callee_saves_pushed(void (*fn)(ptr_t, void *),
 
 GC_INNER void GC_clear_hdr_marks(hdr * hhdr);
                                     /* Clear the mark bits in a header */
+GC_INNER void GC_refresh_hdr_marks(hdr * hhdr);
+                                    /* Clear the stale mark bits in a  */
+                                    /* header (unless these are kept   */
+                                    /* across collections), and set    */
+                                    /* its epoch to the current one.   */
+                                    /* Safe to be called concurrently  */
+                                    /* by the marker threads.          */
+
+/* Ensure the mark bits of the block (hhdr) belong to the current mark  */
+/* epoch.  Should precede any access to the mark bits (or hb_n_marks)   */
+/* of a block which might not have been marked or swept in the current  */
+/* cycle.  A full collection just increments GC_mark_epoch instead of   */
+/* clearing the mark bits of all the heap blocks, thus the bits of the  */
+/* blocks not reached by the marker are cleared by the sweeper.         */
+#ifdef PARALLEL_MARK
+# define GC_HDR_MARK_EPOCH(hhdr) \
+        (word)AO_load_acquire((volatile AO_t *)&(hhdr)->hb_mark_epoch)
+#else
+# define GC_HDR_MARK_EPOCH(hhdr) ((hhdr) -> hb_mark_epoch)
+#endif
+#define VALIDATE_MARKS(hhdr) \
+        (EXPECT(GC_HDR_MARK_EPOCH(hhdr) == GC_mark_epoch, TRUE) ? (void)0 \
+         : GC_refresh_hdr_marks(hhdr))
 GC_INNER void GC_set_hdr_marks(hdr * hhdr);
                                     /* Set the mark bits in a header */
 GC_INNER void GC_set_fl_marks(ptr_t p);
@@ -2155,6 +2496,24 @@ GC_INNER void GC_exclude_static_roots_inner(void *start, void *finish);
 GC_INNER void GC_cond_register_dynamic_libraries(void);
                 /* Remove and reregister dynamic libraries if we're     */
                 /* configured to do that at each GC.                    */
+#ifdef FROZEN_ROOTS
+  GC_EXTERN struct GC_frozen_root_s GC_frozen_roots[MAX_FROZEN_ROOTS];
+  GC_EXTERN int GC_n_frozen_roots;
+
+  GC_INNER void GC_note_frozen_roots_dirty(void);
+                /* Record the pages of the frozen roots dirtied since   */
+                /* the previous GC_read_dirty call.  Should be called   */
+                /* after each GC_read_dirty (with the output needed).   */
+#endif
+#ifdef DYNLIB_CACHE
+  GC_INNER word GC_get_dynlib_generation(void);
+                /* Return a value which changes whenever a dynamic      */
+                /* library is loaded or unloaded, or 0 if unknown.      */
+  GC_EXTERN word GC_dynlib_generation;
+                /* The value of GC_get_dynlib_generation() when the     */
+                /* dynamic library roots were last registered; 0 if     */
+                /* they should be registered again.                     */
+#endif
 
 /* Machine dependent startup routines */
 ptr_t GC_get_main_stack_base(void);     /* Cold end of stack.           */
@@ -2165,6 +2524,26 @@ ptr_t GC_get_main_stack_base(void);     /* Cold end of stack.           */
 
 void GC_register_data_segments(void);
 
+GC_EXTERN GC_bool GC_fast_startup;
+                /* Do only the necessary work in GC_init (see           */
+                /* GC_set_fast_startup).                                */
+GC_EXTERN word GC_deferred_heapsize;
+                /* The initial heap size GC_init has not expanded the   */
+                /* heap by; 0 if none.                                  */
+#ifdef CAN_DEFER_ROOTS
+  GC_EXTERN GC_bool GC_roots_deferred;
+                /* The main static data roots are not registered yet.   */
+  GC_INNER void GC_register_deferred_roots(void);
+                /* Register the roots postponed by GC_init.  Called     */
+                /* before the roots are pushed, removed or write-       */
+                /* protected for the first time.                        */
+# define GC_REGISTER_DEFERRED_ROOTS() \
+        (void)(EXPECT(GC_roots_deferred, FALSE) \
+                ? (GC_register_deferred_roots(), 0) : 0)
+#else
+# define GC_REGISTER_DEFERRED_ROOTS() (void)0
+#endif
+
 #ifdef THREADS
   /* Both are invoked from GC_init only.        */
   GC_INNER void GC_thr_init(void);
@@ -2255,6 +2634,12 @@ GC_INNER struct hblk * GC_allochblk(size_t size_in_bytes, int kind,
                                 /* the marker that block is valid       */
                                 /* for objects of indicated size.       */
 
+GC_INNER GC_bool GC_set_size_classes_inner(const size_t *sizes, size_t n);
+                        /* Install the given ascending list of object   */
+                        /* sizes (in bytes) as the size classes of the  */
+                        /* non-tiny requests.  Returns FALSE (with no   */
+                        /* effect) if the list is invalid.              */
+
 GC_INNER ptr_t GC_alloc_large(size_t lb, int k, unsigned flags);
                         /* Allocate a large block of size lb bytes.     */
                         /* The block is not cleared.  flags argument    */
@@ -2269,14 +2654,33 @@ GC_INNER void GC_freehblk(struct hblk * p);
                                 /* Deallocate a heap block and mark it  */
                                 /* as invalid.                          */
 
+GC_INNER struct hblk *GC_grow_hblk(struct hblk *h, size_t lb);
+                                /* Try to grow the large object at h to */
+                                /* lb bytes without copying: absorb     */
+                                /* the adjacent free block, or remap    */
+                                /* the large-object space region.       */
+                                /* Returns the new object address (h    */
+                                /* unless the region is moved), or NULL */
+                                /* if the object is left as is.         */
+
 /*  Miscellaneous GC routines.  */
 GC_INNER GC_bool GC_expand_hp_inner(word n);
+GC_INNER void GC_add_heap_space(struct hblk *space, size_t bytes);
+                                /* Add the memory just obtained from    */
+                                /* the OS to the heap.                  */
+GC_INNER GC_bool GC_collect_and_sweep_inner(void);
+                                /* Do a full collection and sweep all   */
+                                /* the blocks at once.  Returns FALSE   */
+                                /* if the collection has not been done. */
 GC_INNER void GC_start_reclaim(GC_bool abort_if_found);
                                 /* Restore unmarked objects to free     */
                                 /* lists, or (if abort_if_found is      */
                                 /* TRUE) report them.                   */
                                 /* Sweeping of small object pages is    */
                                 /* largely deferred.                    */
+GC_INNER void GC_freeze_heap_blocks(void);
+                                /* Mark all the in-use blocks as frozen */
+                                /* and drop the free and reclaim lists. */
 GC_INNER void GC_continue_reclaim(word sz, int kind);
                                 /* Sweep pages of the given size and    */
                                 /* kind, as long as possible, and       */
@@ -2286,6 +2690,18 @@ GC_INNER void GC_continue_reclaim(word sz, int kind);
 GC_INNER GC_bool GC_reclaim_all(GC_stop_func stop_func, GC_bool ignore_old);
                                 /* Reclaim all blocks.  Abort (in a     */
                                 /* consistent state) if f returns TRUE. */
+GC_EXTERN GC_bool GC_start_reclaim_pending;
+                                /* GC_start_reclaim has not examined    */
+                                /* all the heap blocks yet.             */
+GC_INNER GC_bool GC_continue_start_reclaim(GC_stop_func stop_func);
+                                /* Examine the heap blocks left by the  */
+                                /* pending GC_start_reclaim until       */
+                                /* stop_func returns TRUE.  Return TRUE */
+                                /* if no blocks are left.  Should be    */
+                                /* completed before the mark bits are   */
+                                /* changed.                             */
+#define GC_finish_start_reclaim() \
+                (void)GC_continue_start_reclaim(GC_never_stop_func)
 GC_INNER ptr_t GC_reclaim_generic(struct hblk * hbp, hdr *hhdr, size_t sz,
                                   GC_bool init, ptr_t list,
                                   signed_word *count);
@@ -2294,6 +2710,10 @@ GC_INNER ptr_t GC_reclaim_generic(struct hblk * hbp, hdr *hhdr, size_t sz,
                                 /* bytes.  Add list to the end of the   */
                                 /* free list.  Add the number of        */
                                 /* reclaimed bytes to *count.           */
+#ifdef BITMAP_SWEEP
+  GC_INNER void GC_init_obj_start_masks(void);
+                                /* Fill in GC_obj_start_masks.          */
+#endif
 GC_INNER GC_bool GC_block_empty(hdr * hhdr);
                                 /* Block completely unmarked?   */
 GC_INNER int GC_CALLBACK GC_never_stop_func(void);
@@ -2322,9 +2742,184 @@ GC_INNER void GC_collect_a_little_inner(int n);
                                 /* A unit is an amount appropriate for  */
                                 /* HBLKSIZE bytes of allocation.        */
 
+#ifdef CONCURRENT_MARK
+  GC_EXTERN GC_bool GC_concurrent_mark;
+                        /* The concurrent marker thread is running,     */
+                        /* the mutator should not do marking itself.    */
+                        /* Protected by the allocation lock.            */
+
+  GC_INNER GC_bool GC_concurrent_mark_some(void);
+                        /* Do a slice of the marking for the collection */
+                        /* in progress (with the world running), and    */
+                        /* finish the collection if the marking is      */
+                        /* done.  Returns TRUE if there is still work   */
+                        /* to do.  Called by the marker thread.         */
+
+  GC_INNER void GC_notify_concurrent_marker(void);
+                        /* Wake up the concurrent marker thread.  The   */
+                        /* allocation lock is held.                     */
+
+  GC_INNER void GC_start_concurrent_marker(void);
+                        /* Create (and register) the concurrent marker  */
+                        /* thread unless already started.  Acquires the */
+                        /* allocation lock.                             */
+#endif /* CONCURRENT_MARK */
+
+#ifdef BACKGROUND_GC
+  GC_EXTERN GC_bool GC_background_gc;
+                        /* The background collector thread is running,  */
+                        /* the allocating thread only wakes it up       */
+                        /* unless the allocation gets too far ahead of  */
+                        /* the collections.  Protected by the           */
+                        /* allocation lock.                             */
+
+  GC_INNER GC_bool GC_background_gc_lags(void);
+                        /* Whether the bytes allocated since the last   */
+                        /* collection exceed the hard limit, i.e. the   */
+                        /* allocating thread should do the collection   */
+                        /* work itself rather than wait for the         */
+                        /* background collector.                        */
+
+  GC_INNER GC_bool GC_background_collect_some(void);
+                        /* Do a collection (or a number of incremental  */
+                        /* steps in the incremental mode) if            */
+                        /* appropriate.  Returns TRUE if there is still */
+                        /* work to do.  Called by the background        */
+                        /* collector thread.                            */
+
+  GC_INNER void GC_notify_background_gc(void);
+                        /* Wake up the background collector thread.     */
+                        /* The allocation lock is held.                 */
+
+  GC_INNER void GC_start_background_gc(void);
+                        /* Create (and register) the background         */
+                        /* collector thread unless already started.     */
+                        /* Acquires the allocation lock.                */
+#endif /* BACKGROUND_GC */
+
+#if defined(CONCURRENT_MARK) || defined(BACKGROUND_GC)
+  GC_INNER void GC_collect_a_little_or_notify(int n);
+                        /* Same as GC_collect_a_little_inner but, if    */
+                        /* the concurrent marker (or the background     */
+                        /* collector) is running, just wake it up       */
+                        /* instead of doing any collection work.  Used  */
+                        /* by the allocation slow paths.                */
+#else
+# define GC_collect_a_little_or_notify(n) GC_collect_a_little_inner(n)
+#endif
+
+#ifdef SCAVENGER_THREAD
+  GC_EXTERN word GC_scavenger_rate;
+                        /* The budget (bytes per second) of the free    */
+                        /* blocks unmapping done by the scavenger       */
+                        /* thread; zero means the thread is idle and    */
+                        /* the blocks are unmapped at the end of each   */
+                        /* collection as usual.  Protected by the       */
+                        /* allocation lock.                             */
+
+  GC_INNER void GC_start_scavenger(void);
+                        /* Create the scavenger thread unless already   */
+                        /* started.  Acquires the allocation lock.      */
+#endif
+
+#ifdef CGROUP_MEMORY_LIMIT
+  /* cgroup (v2) support (os_dep.c): */
+  GC_INNER word GC_cgroup_memory_limit(void);
+                        /* The memory limit (bytes) of the cgroup of    */
+                        /* the process (the minimum among it and its    */
+                        /* ancestors); zero means no limit or unknown.  */
+# ifdef WATCH_MEMORY_PRESSURE
+    GC_INNER int GC_open_memory_pressure(const char *trigger);
+                        /* Open the memory.pressure file of the cgroup  */
+                        /* (or the system-wide one) and write the given */
+                        /* PSI trigger to it.  Returns the descriptor   */
+                        /* to poll for POLLPRI, or -1 on failure.       */
+# endif
+#endif
+
+#ifdef WATCH_MEMORY_PRESSURE
+  GC_EXTERN GC_bool GC_memory_pressure;
+                        /* Set by the scavenger thread on a memory      */
+                        /* pressure event.  Triggers a collection       */
+                        /* followed by unmapping of all the free        */
+                        /* blocks.  Protected by the allocation lock.   */
+#endif
+
+#ifdef FINALIZER_THREADS
+  GC_INNER GC_bool GC_hand_over_finalizers(void);
+                        /* Wake up the finalizer threads (and wait for  */
+                        /* them to shorten the queue if it exceeds the  */
+                        /* backlog limit).  Returns FALSE (keeping the  */
+                        /* allocation lock) if no such threads are      */
+                        /* running, otherwise releases the lock first.  */
+
+  GC_INNER unsigned GC_invoke_finalizers_batch(unsigned batch);
+                        /* Run up to batch finalizers taken from the    */
+                        /* queue at once.  Called without the lock.     */
+#endif
+
 GC_INNER void * GC_generic_malloc_inner(size_t lb, int k);
                                 /* Allocate an object of the given      */
                                 /* kind but assuming lock already held. */
+
+#ifdef HEAP_PROFILE
+  GC_EXTERN word GC_heap_prof_next_sample;
+                /* The value of the total allocated bytes counter to    */
+                /* take the next allocation sample at; GC_WORD_MAX if   */
+                /* the allocation sampling is off.                      */
+  GC_INNER void GC_heap_prof_sample(void *p, size_t lb);
+                /* Sample the object p (of lb bytes) just allocated in  */
+                /* a slow path if it is time to.  Acquires the lock.    */
+  GC_INNER void GC_heap_prof_after_mark(void);
+                /* Drop the sampled objects found unreachable by the    */
+                /* collection (counting them as leaked in the sampled   */
+                /* leak detection mode).                                */
+  struct heap_prof_sample;
+  GC_EXTERN struct heap_prof_sample **GC_heap_prof_samples;
+  GC_INNER void GC_heap_prof_free(void *p);
+                /* Drop the sample of the object p (if any) being       */
+                /* explicitly deallocated.  Acquires the lock.          */
+  GC_INNER GC_bool GC_heap_prof_print_leaks(void);
+                /* Print the sampled leaks found since the previous     */
+                /* call, by allocation stack.  Returns TRUE if any.     */
+# define GC_HEAP_PROF_SAMPLE(p, lb) \
+        (void)(EXPECT(GC_heap_prof_next_sample != GC_WORD_MAX, FALSE) \
+               && (p) != NULL ? (GC_heap_prof_sample(p, lb), 0) : 0)
+# define GC_HEAP_PROF_FREE(p) \
+        (void)(EXPECT(GC_heap_prof_samples != NULL, FALSE) \
+               ? (GC_heap_prof_free(p), 0) : 0)
+#else
+# define GC_HEAP_PROF_SAMPLE(p, lb) (void)0
+# define GC_HEAP_PROF_FREE(p) (void)0
+#endif
+
+#ifdef LIFETIME_SAMPLING
+  GC_EXTERN unsigned GC_lifetime_interval;
+                /* Sample every such slow-path allocation; zero if the  */
+                /* lifetime sampling is off.                            */
+  GC_INNER void GC_lifetime_sample(void *p);
+                /* Count the object p just allocated in a slow path,    */
+                /* and sample it if it is time to.                      */
+  GC_INNER void GC_lifetime_after_mark(void);
+                /* Account the sampled objects found unreachable by     */
+                /* the collection in the lifetime histograms.           */
+  struct lifetime_sample;
+  GC_EXTERN struct lifetime_sample **GC_lifetime_samples;
+  GC_INNER void GC_lifetime_free(void *p);
+                /* Drop the sample of the object p (if any) being       */
+                /* explicitly deallocated.  Acquires the lock.          */
+  GC_INNER void GC_print_lifetime_stats(void);
+# define GC_LIFETIME_SAMPLE(p) \
+        (void)(EXPECT(GC_lifetime_interval != 0, FALSE) \
+               && (p) != NULL ? (GC_lifetime_sample(p), 0) : 0)
+# define GC_LIFETIME_FREE(p) \
+        (void)(EXPECT(GC_lifetime_samples != NULL, FALSE) \
+               ? (GC_lifetime_free(p), 0) : 0)
+#else
+# define GC_LIFETIME_SAMPLE(p) (void)0
+# define GC_LIFETIME_FREE(p) (void)0
+#endif
+
 #if defined(DBG_HDRS_ALL) || defined(GC_GCJ_SUPPORT) \
     || !defined(GC_NO_FINALIZATION)
   GC_INNER void * GC_generic_malloc_inner_ignore_off_page(size_t lb, int k);
@@ -2335,6 +2930,16 @@ GC_INNER void * GC_generic_malloc_inner(size_t lb, int k);
                                 /* object is live.                      */
 #endif
 
+GC_INNER void GC_generic_malloc_many_with_tail(size_t lb, int k,
+                                               word tail, void **result);
+                                /* Same as GC_generic_malloc_many but   */
+                                /* also store tail (if nonzero) to the  */
+                                /* last word of each object before the  */
+                                /* list is handed out.  Used to prefill */
+                                /* the typed objects descriptors.       */
+
+GC_EXTERN int GC_explicit_kind; /* defined in typd_mlc.c */
+
 GC_INNER GC_bool GC_collect_or_expand(word needed_blocks,
                                       GC_bool ignore_off_page, GC_bool retry);
 
@@ -2369,9 +2974,52 @@ GC_INNER ptr_t GC_allocobj(size_t sz, int kind);
 /* Allocation routines that bypass the thread local cache.      */
 #if defined(THREAD_LOCAL_ALLOC) && defined(GC_GCJ_SUPPORT)
     GC_INNER void * GC_core_gcj_malloc(size_t, void *);
+#   if defined(AO_HAVE_load_acquire) && defined(AO_HAVE_nop_write) \
+       && !defined(NO_INCREMENTAL_GCJ_TLFL)
+      /* GC_gcj_malloc uses the thread-local free lists even in the     */
+      /* incremental mode, relying on a handshake with the marker       */
+      /* (see the GC_DS_PER_OBJECT case in GC_mark_from).               */
+#     define INCREMENTAL_GCJ_TLFL
+#   endif
 #endif
 
+#ifdef PARALLEL_MARK
+  GC_EXTERN volatile AO_t GC_hdr_cache_hits;
+  GC_EXTERN volatile AO_t GC_hdr_cache_misses;
+#else
+  GC_EXTERN word GC_hdr_cache_hits;
+  GC_EXTERN word GC_hdr_cache_misses;
+#endif
+                                /* The cumulative header cache          */
+                                /* statistics (see hdr_cache_t).        */
 GC_INNER void GC_init_headers(void);
+#ifdef USE_HEAP_ARENA
+  GC_INNER void GC_init_arena(void);
+                                /* Reserve the heap arena (and its flat */
+                                /* header table) in os_dep.c.  Leaves   */
+                                /* GC_arena_size zero on failure.       */
+  GC_INNER ptr_t GC_arena_get_mem(size_t bytes);
+                                /* Commit the next bytes of the arena   */
+                                /* for the heap growth.  Returns NULL   */
+                                /* if the arena is not reserved or      */
+                                /* exhausted.                           */
+  GC_EXTERN ptr_t GC_arena_hint;
+                                /* The address to reserve the arena at  */
+                                /* (if free), e.g. that of a heap image */
+                                /* to be loaded; GC_ARENA_HINT by       */
+                                /* default, NULL if any.                */
+  GC_INNER GC_bool GC_arena_map_file(int fd, word offset, size_t bytes);
+                                /* Map the given part of the file at    */
+                                /* the arena start (privately), instead */
+                                /* of committing the memory.  Fails     */
+                                /* unless the arena is still unused.    */
+  GC_INNER GC_bool GC_alloc_hblk_at(struct hblk *fb, struct hblk *h,
+                                    size_t sz, int kind, unsigned flags);
+                                /* Allocate the block for objects of sz */
+                                /* bytes at h from the free block fb    */
+                                /* containing it.  Used to restore a    */
+                                /* heap image.                          */
+#endif
 GC_INNER struct hblkhdr * GC_install_header(struct hblk *h);
                                 /* Install a header for block h.        */
                                 /* Return 0 on failure, or the header   */
@@ -2449,6 +3097,42 @@ GC_EXTERN void (*GC_print_heap_obj)(ptr_t p);
   /* With a particular level of optimizations, it should...              */
 #endif
 
+#ifndef NO_CLOCK
+  GC_EXTERN GC_bool GC_measure_performance;
+                /* Do performance measurements if set to true (e.g.,    */
+                /* accumulation of the total time of full collections). */
+  GC_EXTERN word GC_root_scan_ns;
+                /* Time spent pushing the roots during the current      */
+                /* world-stopped marking (in nanoseconds); updated only */
+                /* if GC_measure_performance.                           */
+#endif
+
+#ifdef PERF_COUNTERS
+  /* Hardware performance counters (os_dep.c): */
+# define GC_PERF_NCOUNTERS 4
+  typedef struct {
+    int fds[GC_PERF_NCOUNTERS]; /* -1 if the event is not supported     */
+    long tid;                   /* the measured thread, 0 if none       */
+  } GC_perf_group_t;
+# define GC_PERF_GROUP_INITIALIZER { { -1, -1, -1, -1 }, 0 }
+  GC_INNER GC_bool GC_perf_read(GC_perf_group_t *,
+                                struct GC_perf_counts_s *);
+                /* Read the counters of the calling thread (opening     */
+                /* them first, or reopening if the group was used by    */
+                /* another thread).  Returns FALSE (and zero values) if */
+                /* no counter is available.                             */
+  GC_INNER void GC_perf_add_delta(struct GC_perf_counts_s *acc,
+                                  const struct GC_perf_counts_s *from,
+                                  const struct GC_perf_counts_s *to);
+                /* Add the increase of the counters to acc.             */
+# ifdef PARALLEL_MARK
+    GC_EXTERN struct GC_perf_counts_s GC_markers_perf_counts;
+                /* The counters accumulated by the marker threads (in   */
+                /* GC_mark_thread) while GC_measure_performance is set; */
+                /* protected by the mark lock.                          */
+# endif
+#endif /* PERF_COUNTERS */
+
 #ifdef KEEP_BACK_PTRS
   GC_EXTERN long GC_backtraces;
 #endif
@@ -2485,6 +3169,9 @@ GC_EXTERN GC_bool GC_print_back_height;
   GC_INNER void GC_free_inner(void * p);
 #endif
 
+GC_INNER void GC_free_n_inner(void **ptrs, size_t n);
+                /* GC_free_n without acquiring the lock and sorting.    */
+
 /* Macros used for collector internal allocation.       */
 /* These assume the collector lock is held.             */
 #ifdef DBG_HDRS_ALL
@@ -2511,9 +3198,66 @@ GC_EXTERN GC_bool GC_print_back_height;
 # endif
 #endif /* !DBG_HDRS_ALL */
 
+#ifdef USE_HUGE_PAGES
+  /* Transparent huge pages support (os_dep.c): */
+# ifndef HUGE_PAGE_SIZE
+#   define HUGE_PAGE_SIZE ((word)2 << 20)
+# endif
+  GC_EXTERN GC_bool GC_huge_pages;
+                /* Grow the heap in HUGE_PAGE_SIZE-aligned chunks and   */
+                /* unmap only whole huge pages.  Set only before GC     */
+                /* initialization.                                      */
+  GC_INNER ptr_t GC_unix_get_huge_mem(size_t bytes);
+                /* Same as GET_MEM but the result is HUGE_PAGE_SIZE     */
+                /* aligned and advised to be backed by huge pages.      */
+                /* bytes should be a multiple of HUGE_PAGE_SIZE.        */
+# define GC_UNMAP_GRANULE (GC_huge_pages ? HUGE_PAGE_SIZE : GC_page_size)
+#else
+# define GC_UNMAP_GRANULE GC_page_size
+#endif /* !USE_HUGE_PAGES */
+
+#ifdef USE_LARGE_OBJ_SPACE
+  /* Large-object space (allchblk.c): */
+  GC_EXTERN word GC_los_threshold;
+                /* Objects of at least this size (in bytes) are         */
+                /* allocated each in its own memory mapping.  Zero      */
+                /* means the large-object space is off.                 */
+  GC_EXTERN word GC_max_heapsize;
+                /* The heap size limit (alloc.c), zero means no limit.  */
+  GC_INNER struct hblk *GC_los_alloc(size_t lb, int k, unsigned flags);
+                /* Map a new region for a single object of lb bytes     */
+                /* (lb is rounded up to a granule), install its headers */
+                /* as for a heap block allocated by GC_allochblk.       */
+                /* Returns NULL on failure.                             */
+  GC_INNER GC_bool GC_is_los_page(struct hblk *h);
+                /* Check whether h belongs to the large-object space.   */
+  GC_INNER ptr_t GC_unix_get_los_mem(size_t bytes);
+  GC_INNER void GC_unix_free_los_mem(ptr_t start, size_t bytes);
+                /* Map (unmap) a region of the large-object space.      */
+                /* bytes should be a multiple of GC_page_size (which    */
+                /* should be a multiple of HBLKSIZE).                   */
+  GC_INNER GC_bool GC_unix_remap_los_mem(ptr_t start, size_t old_bytes,
+                                         size_t new_bytes, ptr_t dest);
+                /* Grow a region of the large-object space in place (if */
+                /* dest is NULL) or move its pages to dest replacing    */
+                /* the mapping reserved there, without copying.         */
+                /* Returns FALSE on failure (the region is unchanged).  */
+# define IS_LOS_HDR(hhdr) (((hhdr) -> hb_flags & LOS_BLK) != 0)
+#else
+# define IS_LOS_HDR(hhdr) FALSE
+#endif /* !USE_LARGE_OBJ_SPACE */
+
 #ifdef USE_MUNMAP
   /* Memory unmapping: */
   GC_INNER void GC_unmap_old(unsigned threshold);
+  GC_INNER word GC_unmap_old_bytes(unsigned threshold, word max_bytes);
+                /* Same as GC_unmap_old but stop once at least          */
+                /* max_bytes are unmapped.  Returns the number of bytes */
+                /* in the unmapped blocks.                              */
+  GC_INNER word GC_unmap_excess_bytes(void);
+                /* The amount of the mapped heap memory above the size  */
+                /* expected to be needed for the recent live data (the  */
+                /* hysteresis of unmapping); GC_WORD_MAX if no history. */
   GC_INNER void GC_merge_unmapped(void);
   GC_INNER void GC_unmap(ptr_t start, size_t bytes);
   GC_INNER void GC_remap(ptr_t start, size_t bytes);
@@ -2524,11 +3268,30 @@ GC_EXTERN GC_bool GC_print_back_height;
     /* Compute end address for an unmap operation on the indicated block. */
     GC_INLINE ptr_t GC_unmap_end(ptr_t start, size_t bytes)
     {
-      return (ptr_t)((word)(start + bytes) & ~(GC_page_size - 1));
+      return (ptr_t)((word)(start + bytes) & ~(GC_UNMAP_GRANULE - 1));
     }
 # endif
 #endif /* USE_MUNMAP */
 
+#ifdef USE_NUMA
+  /* NUMA support (os_dep.c): */
+# ifndef MAX_NUMA_NODES
+#   define MAX_NUMA_NODES 8
+# endif
+  GC_EXTERN int GC_numa_nodes;
+                /* Number of NUMA nodes heap blocks are distributed     */
+                /* among; zero unless NUMA mode is on.                  */
+  GC_INNER void GC_numa_init(void);
+                /* Turn on NUMA mode if it has been requested.          */
+  GC_INNER int GC_numa_current_node(void);
+                /* The node the calling thread is running on (or 0).    */
+  GC_INNER void GC_numa_bind(ptr_t start, size_t bytes, int node);
+                /* Set the preferred node for the pages of the given    */
+                /* (not yet touched) memory region.                     */
+  GC_INNER void GC_numa_pin_thread(int node);
+                /* Restrict the calling thread to the CPUs of the node. */
+#endif /* USE_NUMA */
+
 #ifdef CAN_HANDLE_FORK
   GC_EXTERN int GC_handle_fork;
                 /* Fork-handling mode:                                  */
@@ -2608,6 +3371,20 @@ GC_EXTERN GC_bool GC_print_back_height;
 # define GC_auto_incremental (GC_incremental && !GC_manual_vdb)
 
   GC_INNER void GC_dirty_inner(const void *p); /* does not require locking */
+
+  /* Is any card overlapping the given range dirty in GC_grungy_cards?  */
+  /* Used only in the manual VDB mode.  The range should not cross      */
+  /* a heap block boundary (unless it starts at one).                   */
+  GC_INLINE GC_bool GC_cards_were_dirty(ptr_t p, word sz)
+  {
+    word i = GC_CARD_INDEX(p);
+    word last = GC_CARD_INDEX(p + sz - 1);
+
+    for (;; i = (i + 1) & (GC_CARD_TABLE_SIZE - 1)) {
+      if (GC_grungy_cards[i] != 0) return TRUE;
+      if (i == last) return FALSE;
+    }
+  }
 # define GC_dirty(p) (GC_manual_vdb ? GC_dirty_inner(p) : (void)0)
 # define REACHABLE_AFTER_DIRTY(p) GC_reachable_here(p)
 #endif /* !GC_DISABLE_INCREMENTAL */
@@ -2762,9 +3539,182 @@ GC_EXTERN signed_word GC_bytes_found;
                         /* Previously set to backing store pointer.     */
 #endif /* !THREADS */
 
-#ifdef THREAD_LOCAL_ALLOC
+GC_EXTERN GC_bool GC_stack_watermarks; /* defined in misc.c */
+
+GC_EXTERN GC_bool GC_is_full_gc;
+                        /* Is the current collection a full one (i.e.   */
+                        /* were the mark bits cleared at its start)?    */
+                        /* Otherwise all the objects marked at the end  */
+                        /* of the previous collection remain marked.    */
+                        /* Defined in alloc.c.                          */
+
+#ifdef THREADS
+  GC_EXTERN GC_bool GC_skip_unchanged_stacks;
+                        /* Set by GC_push_roots (only while the thread  */
+                        /* stacks are pushed) if the objects referenced */
+                        /* from the parts of the stacks that have not   */
+                        /* changed since the previous scan are known to */
+                        /* be marked (i.e. in a minor collection).      */
+                        /* Defined in mark_rts.c.                       */
+#endif
+
+#if defined(THREADS) && defined(AO_HAVE_test_and_set_acquire) \
+    && defined(AO_HAVE_store_release) && defined(AO_HAVE_fetch_and_add) \
+    && !defined(NO_SHARDED_FREE_LISTS) && !defined(SHARDED_FREE_LISTS)
+  /* Let GC_free put the small objects of the PTRFREE and NORMAL kinds  */
+  /* to the per-size-class lists each protected by its own spin lock,   */
+  /* and GC_malloc_kind_global take them from there, without acquiring  */
+  /* the allocation lock.                                               */
+# define SHARDED_FREE_LISTS
+#endif
+
+#if defined(THREAD_LOCAL_ALLOC) || defined(SHARDED_FREE_LISTS)
   GC_EXTERN GC_bool GC_world_stopped; /* defined in alloc.c */
+#endif
+
+#ifdef THREAD_LOCAL_ALLOC
   GC_INNER void GC_mark_thread_local_free_lists(void);
+  GC_INNER void *GC_take_typed_tlfl(size_t granules, word tail);
+                /* Detach and return the thread-local free list of the  */
+                /* explicitly typed objects of the given size (refilled */
+                /* first if empty) storing tail to the last word of     */
+                /* each object while the list is still reachable from   */
+                /* the thread-local storage.  Returns NULL if the       */
+                /* thread-local allocation is unavailable (or the       */
+                /* concurrent marker is running).  Defined in           */
+                /* thread_local_alloc.c.                                */
+  GC_INNER GC_bool GC_batch_free(void *p);
+                /* Append the small object p being explicitly freed to  */
+                /* the batch of the current thread (see                 */
+                /* GC_set_batched_free).  Returns FALSE (p is not       */
+                /* freed) if the batched free mode is off or the thread */
+                /* has no thread-local free lists.  Defined in          */
+                /* thread_local_alloc.c.                                */
+  GC_INNER GC_bool GC_free_to_local_fl(void *p);
+                /* Put the small normal or pointer-free object p being  */
+                /* explicitly freed to the matching thread-local free   */
+                /* list of the current thread.  Returns FALSE (p is not */
+                /* freed) if it is not possible.  Defined in            */
+                /* thread_local_alloc.c.                                */
+  GC_INNER void GC_add_mark_assist_debt(word bytes);
+                /* Charge the current thread for the given amount of    */
+                /* its free lists refill.                               */
+  GC_INNER int GC_take_mark_assist_units(void);
+                /* Return the number of the marking work units (see     */
+                /* GC_collect_a_little_inner) owed by the current       */
+                /* thread for its allocation during the incremental     */
+                /* collection in progress, and clear the debt.  Thus    */
+                /* the threads allocating heavily do most of the work,  */
+                /* while those allocating rarely seldom pay anything.   */
+                /* The lock should be held.                             */
+# ifndef MAX_ASSIST_UNITS
+#   define MAX_ASSIST_UNITS 64
+# endif
+#else
+# define GC_add_mark_assist_debt(bytes) (void)0
+# define GC_take_mark_assist_units() 1
+#endif
+
+#if defined(THREAD_LOCAL_ALLOC) && defined(AO_HAVE_test_and_set_acquire) \
+    && !defined(NO_READY_CHUNKS) && !defined(USE_READY_CHUNKS)
+# define USE_READY_CHUNKS
+#endif
+
+#if defined(THREAD_LOCAL_ALLOC) && defined(AO_HAVE_fetch_and_add1) \
+    && defined(AO_HAVE_fetch_and_sub1_release) \
+    && defined(AO_HAVE_load_acquire) \
+    && (defined(GC_PTHREADS) || defined(GC_WIN32_THREADS)) \
+    && !defined(NO_THREAD_LOCAL_SWEEP) && !defined(THREAD_LOCAL_SWEEP)
+  /* Let the allocating thread sweep a block (or build the free list of */
+  /* a new one) for its thread-local free list without holding the GC   */
+  /* lock unless parallel marking is on (which has its own mechanism    */
+  /* for this, protected by the mark lock).                             */
+# define THREAD_LOCAL_SWEEP
+#endif
+
+#ifdef THREAD_LOCAL_SWEEP
+  GC_EXTERN volatile AO_t GC_sweep_claims;
+                /* Number of blocks claimed (with the GC lock held) and */
+                /* being swept without the lock.  It is not safe to     */
+                /* collect if this is nonzero.  Defined in reclaim.c.   */
+  GC_INNER void GC_wait_for_sweep_claims(void);
+                /* Wait (with the GC lock held) until all the blocks    */
+                /* claimed are swept.                                   */
+#endif
+#ifdef SIMD_PTR_FILTER
+  GC_INNER void GC_init_ptr_filter(void);
+                /* Select the vector pointer filter used by the marker  */
+                /* depending on the processor features.  Called by      */
+                /* GC_init.  Defined in mark.c.                         */
+#endif
+
+#ifdef USE_READY_CHUNKS
+  GC_INNER void GC_mark_ready_chunks(void);
+                /* Set mark bits of all objects queued (as swept but    */
+                /* not yet handed out) by GC_generic_malloc_many.       */
+                /* Called (like GC_mark_thread_local_free_lists) only   */
+                /* with the world stopped.  Defined in mallocx.c.       */
+#endif
+
+#ifdef SHARDED_FREE_LISTS
+  GC_EXTERN volatile AO_t GC_fl_shards_bytes_freed;
+                /* The number of bytes put to the shards and not yet    */
+                /* added to GC_bytes_freed.                             */
+# define GC_EXPL_FREED_BYTES() \
+                (GC_bytes_freed + (word)AO_load(&GC_fl_shards_bytes_freed))
+
+  GC_INNER void GC_flush_fl_shard(int k, size_t lg);
+                /* Move the objects freed to the shard of the given     */
+                /* kind and size (in granules) to the global free list, */
+                /* and account the ones taken from it.  Does nothing    */
+                /* for the kinds other than PTRFREE and NORMAL, or if   */
+                /* the shard is busy.  The lock should be held.         */
+                /* Defined in malloc.c.                                 */
+  GC_INNER void GC_flush_fl_shards(void);
+                /* Same as GC_flush_fl_shard for all the shards, also   */
+                /* add GC_fl_shards_bytes_freed to GC_bytes_freed.      */
+  GC_INNER void GC_mark_fl_shards(void);
+                /* Set mark bits of all objects in the shards.  Called  */
+                /* (like GC_mark_ready_chunks) only with the world      */
+                /* stopped.                                             */
+#else
+# define GC_EXPL_FREED_BYTES() GC_bytes_freed
+#endif
+
+#ifdef COMPRESSED_REFS
+  GC_INNER void GC_init_compressed_refs(void);
+                /* Set GC_cref_base and register the object kind of     */
+                /* compressed references if the heap arena is reserved. */
+                /* Called by GC_init.  Defined in cref_mlc.c.           */
+#endif
+
+/* The state of the clearing of the inaccessible part of a stack (see  */
+/* GC_clear_stack).  Only the region hotter than the recent stack      */
+/* pointer but not hotter than the watermark (the deepest stack pointer */
+/* seen since the last collection) is cleared, and only once.           */
+struct GC_clear_stack_s {
+  ptr_t high_water;     /* "Hottest" stack pointer value we have seen   */
+                        /* recently.  Degrades over time.               */
+  ptr_t min_sp;         /* Coolest stack pointer value from which we    */
+                        /* have already cleared the stack.              */
+  word last_cleared;    /* GC_gc_no when the clearing was restarted.    */
+  word bytes_allocd_at_reset;
+  word cleared_bytes;   /* Total bytes of the stack cleared.            */
+};
+
+#ifdef THREAD_LOCAL_ALLOC
+  GC_INNER struct GC_clear_stack_s *GC_my_clear_stack_state(void);
+                /* Return the stack clearing state of the current       */
+                /* thread, or NULL if it has no thread-local free       */
+                /* lists yet.  Does not acquire the allocation lock.    */
+                /* Defined in thread_local_alloc.c.                     */
+#endif
+
+#ifdef THREAD_STATS
+  GC_INNER void GC_fill_my_thread_stats(struct GC_thread_stats_s *pstats);
+                        /* Add the statistics of the current thread to  */
+                        /* *pstats.  Requires the allocation lock.      */
+                        /* Defined in pthread_support.c.                */
 #endif
 
 #if defined(GLIBC_2_19_TSX_BUG) && defined(THREADS)
@@ -2987,6 +3937,41 @@ GC_INNER void *GC_store_debug_info_inner(void *p, word sz, const char *str,
               /* was already done, or there was nothing to do for       */
               /* some other reason.                                     */
 
+  GC_INNER void GC_do_parallel_task(void (*fn)(unsigned /* id */,
+                                          mse * /* local_mark_stack */));
+              /* Run fn on the calling thread (as helper 0) and on all  */
+              /* the idle marker threads, and wait for all of them to   */
+              /* return.  The caller holds the GC lock (but not the     */
+              /* mark lock); the helpers hold neither while running fn. */
+              /* Used for distributing non-marking work, e.g. sweep.    */
+              /* fn is also passed the local mark stack of the helper   */
+              /* (LOCAL_MARK_STACK_SIZE entries).                       */
+
+  GC_INNER void GC_mark_stack_in_parallel(void);
+              /* Mark from the entries pushed onto the global mark      */
+              /* stack (outside of the regular mark phase) using all    */
+              /* the marker threads.  The caller holds the GC lock.     */
+
+  GC_INNER void GC_marker_stats_next_cycle(void);
+              /* Save the per-marker statistics of the collection being */
+              /* completed (see GC_get_marker_stats), print them if     */
+              /* needed, and clear them for the next collection.  The   */
+              /* caller holds the GC lock.                              */
+
+  GC_INNER void GC_defer_stacks_scan(void);
+  GC_INNER void GC_scan_deferred_stacks(void);
+              /* If the parallel marker is on, the thread stacks pushed */
+              /* by GC_push_all_stack between these two calls are only  */
+              /* recorded (if they are to be scanned eagerly), and then */
+              /* scanned using all the marker threads by the latter     */
+              /* call.  The caller holds the GC lock.                   */
+
+  GC_EXTERN word GC_parallel_reclaim_ns;
+  GC_EXTERN word GC_parallel_reclaim_work_ns;
+              /* Total elapsed time spent in parallel reclaim, and sum  */
+              /* of the times spent by each of the participating        */
+              /* threads, in nanoseconds.  Both may wrap.               */
+
   GC_INNER void GC_start_mark_threads_inner(void);
 #endif /* PARALLEL_MARK */
 
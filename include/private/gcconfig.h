@@ -2582,6 +2582,59 @@ EXTERN_C_BEGIN
 # define MMAP_SUPPORTED
 #endif
 
+#if defined(LINUX) && defined(MMAP_SUPPORTED) && !defined(NO_HUGE_PAGES) \
+    && !defined(USE_HUGE_PAGES)
+  /* Support heap growth in huge page aligned chunks backed by the      */
+  /* transparent huge pages (see GC_set_huge_pages).                    */
+# define USE_HUGE_PAGES
+#endif
+
+#if defined(LINUX) && defined(MMAP_SUPPORTED) \
+    && !defined(USE_PROC_FOR_LIBRARIES) \
+    && !defined(NO_LARGE_OBJ_SPACE) && !defined(USE_LARGE_OBJ_SPACE) \
+    && !defined(COMPRESSED_REFS)
+  /* Support allocation of huge objects each in its own memory mapping  */
+  /* (see GC_set_large_object_threshold).  Not compatible with the      */
+  /* roots discovery by /proc/self/maps as GC_our_memory cannot shrink. */
+# define USE_LARGE_OBJ_SPACE
+#endif
+
+#if defined(FLAT_HDR_TABLE) && !defined(USE_HEAP_ARENA)
+  /* The flat header table covers the heap arena.       */
+# define USE_HEAP_ARENA
+#endif
+#if defined(SIDE_MARK_BITMAP) && !defined(USE_HEAP_ARENA)
+  /* The side mark bitmap covers the heap arena.        */
+# define USE_HEAP_ARENA
+#endif
+#if defined(COMPRESSED_REFS) && !defined(USE_HEAP_ARENA)
+  /* The compressed references are offsets in the heap arena.   */
+# define USE_HEAP_ARENA
+#endif
+#if defined(USE_HEAP_ARENA) && (!defined(LINUX) || CPP_WORDSZ != 64 \
+        || !defined(MMAP_SUPPORTED) || defined(USE_PROC_FOR_LIBRARIES))
+  /* The heap arena requires a large address space reservation; the   */
+  /* reserved range should not be registered as a root either.        */
+# undef USE_HEAP_ARENA
+# undef FLAT_HDR_TABLE
+# undef SIDE_MARK_BITMAP
+# undef COMPRESSED_REFS
+#endif
+#if defined(COMPRESSED_REFS) && !defined(GC_ARENA_SIZE)
+  /* Addressable by 32-bit references in granules.      */
+# define GC_ARENA_SIZE ((word)1 << 35) /* 32 GiB */
+#endif
+#if defined(USE_HEAP_ARENA) && !defined(GC_ARENA_SIZE)
+# define GC_ARENA_SIZE ((word)1 << 36) /* 64 GiB */
+#endif
+#if defined(USE_HEAP_ARENA) && !defined(GC_ARENA_HINT)
+  /* The preferred arena address, far from the area where the shared    */
+  /* libraries and the other mappings are placed by the kernel, so that */
+  /* the arena is at the same address in every process (as needed to    */
+  /* load a heap image); ignored if not free.  Zero means any address.  */
+# define GC_ARENA_HINT ((word)1 << 45) /* 32 TiB */
+#endif
+
 /* Xbox One (DURANGO) may not need to be this aggressive, but the       */
 /* default is likely too lax under heavy allocation pressure.           */
 /* The platform does not have a virtual paging system, so it does not   */
@@ -2636,6 +2689,16 @@ EXTERN_C_BEGIN
 # endif
 #endif /* SOFT_VDB */
 
+#if defined(SOFT_VDB) && !defined(NO_UFFD_WP_VDB) && !defined(UFFD_WP_VDB)
+  /* Prefer userfaultfd write-protection (if supported by the kernel)   */
+  /* to the soft-dirty bits.                                            */
+# define UFFD_WP_VDB
+#endif
+
+#ifndef SOFT_VDB
+# undef UFFD_WP_VDB
+#endif
+
 #ifdef GC_DISABLE_INCREMENTAL
 # undef CHECKSUMS
 #endif
@@ -2700,6 +2763,13 @@ EXTERN_C_BEGIN
 # define NO_VDB_FOR_STATIC_ROOTS
 #endif
 
+#if !defined(NO_VDB_FOR_STATIC_ROOTS) && !defined(NO_FROZEN_ROOTS) \
+    && !defined(FROZEN_ROOTS)
+  /* Remember the heap pointers found in the roots registered by        */
+  /* GC_add_frozen_roots, and rescan only the pages written since then. */
+# define FROZEN_ROOTS
+#endif
+
 #if ((defined(UNIX_LIKE) && (defined(DARWIN) || defined(HAIKU) \
                              || defined(HURD) || defined(OPENBSD) \
                              || defined(ARM32) \
@@ -2875,6 +2945,13 @@ EXTERN_C_BEGIN
 # define SUSPEND_HANDLER_NO_CONTEXT
 #endif
 
+#if defined(SIGNAL_BASED_STOP_WORLD) && !defined(NO_PARALLEL_RESTART) \
+    && !defined(PARALLEL_RESTART)
+  /* Let the restarted threads forward the restart signal to the other  */
+  /* suspended threads (see GC_start_world).                            */
+# define PARALLEL_RESTART
+#endif
+
 #if (defined(MSWIN32) || defined(MSWINCE) \
         || (defined(USE_PROC_FOR_LIBRARIES) && defined(THREADS))) \
     && !defined(NO_CRT) && !defined(NO_WRAP_MARK_SOME)
@@ -2954,6 +3031,126 @@ EXTERN_C_BEGIN
 # define MIN_STACK_SIZE (8 * HBLKSIZE * sizeof(word))
 #endif
 
+#if defined(GC_PTHREADS) && !defined(GC_WIN32_THREADS) \
+    && !defined(GC_DISABLE_INCREMENTAL) && !defined(NO_CONCURRENT_MARK) \
+    && !defined(CONCURRENT_MARK) && !defined(SN_TARGET_ORBIS) \
+    && !defined(SN_TARGET_PSP2)
+  /* Support marking by a dedicated background thread while the world   */
+  /* is running (see GC_set_concurrent_mark).                           */
+# define CONCURRENT_MARK
+#endif
+
+#if defined(GC_PTHREADS) && !defined(GC_WIN32_THREADS) \
+    && !defined(NO_BACKGROUND_GC) && !defined(BACKGROUND_GC) \
+    && !defined(SN_TARGET_ORBIS) && !defined(SN_TARGET_PSP2)
+  /* Support running the collections by a dedicated thread rather than  */
+  /* by the allocating one (see GC_set_background_gc).                  */
+# define BACKGROUND_GC
+#endif
+
+#if defined(GC_PTHREADS) && !defined(GC_WIN32_THREADS) \
+    && !defined(GC_DARWIN_THREADS) && !defined(NO_FIBER_STACKS) \
+    && !defined(FIBER_STACKS) && !defined(STACK_GROWS_UP) \
+    && !defined(E2K) && !defined(IA64) && !defined(NACL) \
+    && !defined(SN_TARGET_ORBIS) && !defined(SN_TARGET_PSP2)
+  /* Support the registry of the client fiber (coroutine) stacks        */
+  /* switched without the allocation lock (see GC_register_fiber).      */
+# define FIBER_STACKS
+#endif
+
+#if defined(USE_MUNMAP) && defined(GC_PTHREADS) \
+    && !defined(GC_WIN32_THREADS) && !defined(NO_SCAVENGER_THREAD) \
+    && !defined(SCAVENGER_THREAD) && !defined(SN_TARGET_ORBIS) \
+    && !defined(SN_TARGET_PSP2)
+  /* Support unmapping of free blocks by a background thread between    */
+  /* collections (see GC_set_scavenger_rate).                           */
+# define SCAVENGER_THREAD
+#endif
+
+#if defined(GC_PTHREADS) && !defined(GC_WIN32_THREADS) \
+    && !defined(GC_NO_FINALIZATION) && !defined(NO_FINALIZER_THREADS) \
+    && !defined(FINALIZER_THREADS) && !defined(SN_TARGET_ORBIS) \
+    && !defined(SN_TARGET_PSP2)
+  /* Support running the finalizers by a pool of dedicated threads      */
+  /* (see GC_start_finalizer_threads).                                  */
+# define FINALIZER_THREADS
+#endif
+
+#if defined(GC_PTHREADS) && !defined(GC_WIN32_THREADS) \
+    && !defined(NO_CLOCK) && !defined(SMALL_CONFIG) \
+    && !defined(NO_THREAD_STATS) && !defined(THREAD_STATS)
+  /* Collect per-thread statistics (see GC_get_my_thread_stats).        */
+# define THREAD_STATS
+#endif
+
+#if defined(GC_PTHREADS) && !defined(GC_WIN32_THREADS) \
+    && !defined(GC_DARWIN_THREADS) && !defined(E2K) && !defined(IA64) \
+    && !defined(NACL) && !defined(PRECISE_STACK_ROOTS)
+  /* Support the client precise roots procedures pushed in place of the */
+  /* thread stacks (see GC_set_my_stack_roots_proc).                    */
+# define PRECISE_STACK_ROOTS
+#endif
+
+#if defined(LINUX) && defined(PARALLEL_MARK) && !defined(HOST_ANDROID) \
+    && !defined(NO_NUMA) && !defined(USE_NUMA)
+  /* Support node-local heap block free lists and marker threads on     */
+  /* NUMA systems (see GC_set_numa_mode).                               */
+# define USE_NUMA
+#endif
+
+#if defined(LINUX) && !defined(NO_CGROUP_MEMORY_LIMIT) \
+    && !defined(CGROUP_MEMORY_LIMIT)
+  /* Derive the default soft heap limit from the cgroup (v2) memory     */
+  /* limit (see GC_set_soft_heap_limit).                                */
+# define CGROUP_MEMORY_LIMIT
+#endif
+
+#if defined(CGROUP_MEMORY_LIMIT) && defined(SCAVENGER_THREAD) \
+    && !defined(WATCH_MEMORY_PRESSURE)
+  /* Support the memory pressure (PSI) notifications handled by the     */
+  /* scavenger thread (see GC_watch_memory_pressure).                   */
+# define WATCH_MEMORY_PRESSURE
+#endif
+
+#if defined(LINUX) && defined(GC_HAVE_BUILTIN_BACKTRACE) \
+    && !defined(REDIRECT_MALLOC) && !defined(SMALL_CONFIG) \
+    && !defined(NO_HEAP_PROFILE) && !defined(HEAP_PROFILE)
+  /* Support the allocation sampling profiler (see                      */
+  /* GC_set_heap_profile_rate).                                         */
+# define HEAP_PROFILE
+#endif
+
+#if !defined(SMALL_CONFIG) && !defined(NO_LIFETIME_SAMPLING) \
+    && !defined(LIFETIME_SAMPLING)
+  /* Support the object lifetime sampler (see GC_set_lifetime_sampling). */
+# define LIFETIME_SAMPLING
+#endif
+
+#if defined(DYNAMIC_LOADING) && defined(LINUX) && GC_GLIBC_PREREQ(2, 4) \
+    && !defined(USE_PROC_FOR_LIBRARIES) && !defined(NO_DYNLIB_CACHE) \
+    && !defined(DYNLIB_CACHE)
+  /* Keep the registered dynamic library roots across collections as    */
+  /* long as the dlpi_adds/dlpi_subs counters of dl_iterate_phdr are    */
+  /* unchanged (see GC_cond_register_dynamic_libraries).                */
+# define DYNLIB_CACHE
+#endif
+
+#if defined(LINUX) && !defined(NO_CLOCK) && !defined(SMALL_CONFIG) \
+    && !defined(NO_PERF_COUNTERS) && !defined(PERF_COUNTERS)
+  /* Read the hardware performance counters (perf_event) around the     */
+  /* collection phases (see GC_get_last_phase_counters).                */
+# define PERF_COUNTERS
+#endif
+
+#if defined(UNIX_LIKE) && !defined(DATAEND_IS_FUNC) \
+    && !defined(REDIRECT_MALLOC) && !defined(NO_DEFERRED_ROOTS) \
+    && !defined(CAN_DEFER_ROOTS)
+  /* The main static data roots registration could be postponed till    */
+  /* the first collection (see GC_set_fast_startup).  Not done if the   */
+  /* data end is probed, as the heap could be mapped right after it.    */
+# define CAN_DEFER_ROOTS
+#endif
+
 #if defined(HOST_ANDROID) && !defined(THREADS) \
     && !defined(USE_GET_STACKBASE_FOR_MAIN)
   /* Always use pthread_attr_getstack on Android ("-lpthread" option is  */
@@ -3029,6 +3226,12 @@ EXTERN_C_BEGIN
 # define USE_MARK_BYTES
 #endif
 
+#if defined(MARK_BIT_BATCHING) \
+    && (!defined(PARALLEL_MARK) || defined(USE_MARK_BYTES))
+  /* Only the atomic update of the mark bits is batched.        */
+# undef MARK_BIT_BATCHING
+#endif
+
 #if (defined(MSWINCE) && !defined(__CEGCC__) || defined(MSWINRT_FLAVOR)) \
     && !defined(NO_GETENV)
 # define NO_GETENV
@@ -3167,10 +3370,27 @@ EXTERN_C_BEGIN
 # define FIXUP_POINTER(p)
 #endif
 
+#if ((defined(X86_64) && (GC_GNUC_PREREQ(4, 9) || GC_CLANG_PREREQ(3, 8))) \
+     || (defined(AARCH64) && defined(__ARM_NEON) && defined(__GNUC__))) \
+    && CPP_WORDSZ == 64 && ALIGNMENT == 8 && !defined(NEED_FIXUP_POINTER) \
+    && !defined(NO_SIMD_PTR_FILTER) && !defined(SIMD_PTR_FILTER)
+  /* Filter the scanned words against the plausible heap bounds using   */
+  /* the vector instructions (AVX2 ones are selected at run time).      */
+# define SIMD_PTR_FILTER
+#endif
+
 #if !defined(MARK_BIT_PER_GRANULE) && !defined(MARK_BIT_PER_OBJ)
 # define MARK_BIT_PER_GRANULE   /* Usually faster       */
 #endif
 
+#if defined(MARK_BIT_PER_GRANULE) && !defined(USE_MARK_BYTES) \
+    && (GC_GNUC_PREREQ(3, 4) || defined(__clang__)) \
+    && !defined(NO_BITMAP_SWEEP) && !defined(BITMAP_SWEEP)
+  /* Sweep the small-object blocks a word of mark bits at a time (using */
+  /* the count-trailing-zeros and popcount builtins).                   */
+# define BITMAP_SWEEP
+#endif
+
 /* Some static sanity tests.    */
 #if !defined(CPPCHECK)
 # if defined(MARK_BIT_PER_GRANULE) && defined(MARK_BIT_PER_OBJ)
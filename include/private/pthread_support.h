@@ -116,6 +116,13 @@ typedef struct GC_Thread_Rep {
                                 /* not need a signal sent to stop it.   */
 # ifdef GC_WIN32_THREADS
 #   define IS_SUSPENDED 0x40    /* Thread is suspended by SuspendThread. */
+# elif defined(GC_DARWIN_THREADS)
+#   define STATE_SAVED 0x40     /* Thread is suspended by GC_stop_world */
+                                /* and its registers are in the         */
+                                /* stopped_state field.                 */
+# endif
+# ifdef FINALIZER_THREADS
+#   define FINALIZER_THREAD 0x80 /* Thread of the finalizers pool.      */
 # endif
 
 # ifndef GC_NO_FINALIZATION
@@ -172,6 +179,11 @@ typedef struct GC_Thread_Rep {
                                 /* valid only if the thread is blocked; */
                                 /* non-NULL value means already set.    */
 #   endif
+    GC_THREAD_STATE_T stopped_state;
+                                /* The thread registers captured right  */
+                                /* after suspending it, to be reused by */
+                                /* GC_push_all_stacks (valid only if    */
+                                /* STATE_SAVED is set).                 */
 # endif
 
 # ifdef SIGNAL_BASED_STOP_WORLD
@@ -187,6 +199,19 @@ typedef struct GC_Thread_Rep {
                                 /* and GC_resume_thread(); updated with */
                                 /* the GC lock held, but could be read  */
                                 /* from a signal handler.               */
+#   endif
+    volatile AO_t safepoint_stop_count;
+                                /* The value of GC_stop_count when the  */
+                                /* thread last stopped at a safepoint.  */
+#   ifdef PARALLEL_RESTART
+      struct GC_Thread_Rep *restart_next;
+                                /* The next thread in the restart order */
+                                /* (valid only in GC_start_world).      */
+      struct GC_Thread_Rep *restart_children[2];
+                                /* The suspended threads to be sent     */
+                                /* the restart signal by this one once  */
+                                /* it is restarted; cleared by the      */
+                                /* thread itself.                       */
 #   endif
 # endif
 
@@ -199,6 +224,38 @@ typedef struct GC_Thread_Rep {
     ptr_t normstack;            /* The start and size of the "normal"   */
                                 /* stack (set by GC_register_altstack). */
     word normstack_size;
+
+    ptr_t stack_snapshot;       /* A copy of the cold part of the stack */
+                                /* taken at the last scan of it (used   */
+                                /* if GC_stack_watermarks); the buffer  */
+                                /* end corresponds to stack_snapshot_hi */
+                                /* or NULL.  Protected by GC lock.      */
+    size_t stack_snapshot_size; /* The buffer size.                     */
+    size_t stack_snapshot_len;  /* The number of the valid bytes at the */
+                                /* buffer end (0 means no snapshot).    */
+    ptr_t stack_snapshot_hi;
+    word stack_snapshot_gc_no;  /* The value of GC_gc_no at the moment  */
+                                /* the snapshot was taken.              */
+
+    GC_stack_roots_proc stack_roots_proc;
+                                /* Pushes the roots of the thread       */
+                                /* instead of scanning its stack (see   */
+                                /* GC_set_my_stack_roots_proc), or 0.   */
+    void *stack_roots_cd;       /* The client data for the above.       */
+
+#   ifdef FIBER_STACKS
+      volatile AO_t fiber_to;   /* The fiber (a GC_fiber_t value) which */
+                                /* the thread has switched to the last  */
+                                /* time by GC_fiber_switch, 0 means the */
+                                /* own stack.                           */
+      volatile AO_t fiber_from; /* The fiber the thread has switched    */
+                                /* from; the thread may still run on    */
+                                /* its stack if stopped in the middle   */
+                                /* of the switch.                       */
+      volatile AO_t own_saved_sp;
+                                /* The stack pointer of the own stack   */
+                                /* saved when switching to a fiber.     */
+#   endif
 # endif
 
 # if defined(E2K) || defined(IA64)
@@ -224,6 +281,20 @@ typedef struct GC_Thread_Rep {
 
 # ifdef THREAD_LOCAL_ALLOC
     struct thread_local_freelists tlfs GC_ATTR_WORD_ALIGNED;
+    word blocking_gc_no;        /* The value of GC_gc_no when the       */
+                                /* thread last entered the do-blocking  */
+                                /* state.  Protected by GC lock.        */
+#   define SET_BLOCKING_GC_NO(p) (void)((p) -> blocking_gc_no = GC_gc_no)
+# else
+#   define SET_BLOCKING_GC_NO(p) (void)0
+# endif
+
+# ifdef THREAD_STATS
+    word stopped_ns;            /* Total time spent in the suspend      */
+                                /* handler; updated by the thread.      */
+    word lock_wait_ns;          /* Total time of the contended lock     */
+                                /* acquisitions; updated with the       */
+                                /* allocation lock held.                */
 # endif
 
 # ifdef NACL
@@ -253,33 +324,87 @@ typedef struct GC_Thread_Rep {
 # endif
 } * GC_thread;
 
+#ifdef THREAD_LOCAL_ALLOC
+  /* Check whether the thread-local free lists of p should be returned  */
+  /* to the global ones by GC_mark_thread_local_free_lists, i.e. the    */
+  /* thread has been in the do-blocking state (thus not allocating)     */
+  /* since before the previous collection ended.  Only in a full        */
+  /* collection, as otherwise the objects of the lists (marked by the   */
+  /* previous collection) would not be reclaimed.                       */
+# define SHOULD_FLUSH_IDLE_TLFS(p)         (GC_is_full_gc && ((p) -> flags & DO_BLOCKING) != 0          && (p) -> blocking_gc_no < GC_gc_no)
+#endif
+
 #ifndef THREAD_TABLE_SZ
 # define THREAD_TABLE_SZ 256    /* Power of 2 (for speed). */
 #endif
 
 #ifdef GC_WIN32_THREADS
-# define THREAD_TABLE_INDEX(id) /* id is of DWORD type */ \
-                (int)((((id) >> 8) ^ (id)) % THREAD_TABLE_SZ)
+# define THREAD_ID_HASH(id) /* id is of DWORD type */ (((id) >> 8) ^ (id))
 #elif CPP_WORDSZ == 64
-# define THREAD_TABLE_INDEX(id) \
-    (int)(((((NUMERIC_THREAD_ID(id) >> 8) ^ NUMERIC_THREAD_ID(id)) >> 16) \
-          ^ ((NUMERIC_THREAD_ID(id) >> 8) ^ NUMERIC_THREAD_ID(id))) \
-         % THREAD_TABLE_SZ)
+# define THREAD_ID_HASH(id) \
+        ((((NUMERIC_THREAD_ID(id) >> 8) ^ NUMERIC_THREAD_ID(id)) >> 16) \
+         ^ ((NUMERIC_THREAD_ID(id) >> 8) ^ NUMERIC_THREAD_ID(id)))
 #else
-# define THREAD_TABLE_INDEX(id) \
-                (int)(((NUMERIC_THREAD_ID(id) >> 16) \
-                       ^ (NUMERIC_THREAD_ID(id) >> 8) \
-                       ^ NUMERIC_THREAD_ID(id)) % THREAD_TABLE_SZ)
+# define THREAD_ID_HASH(id) \
+                ((NUMERIC_THREAD_ID(id) >> 16) \
+                 ^ (NUMERIC_THREAD_ID(id) >> 8) ^ NUMERIC_THREAD_ID(id))
 #endif
 
-GC_EXTERN GC_thread GC_threads[THREAD_TABLE_SZ];
+#ifdef GC_WIN32_THREADS
+# define THREAD_TABLE_INDEX(id) (int)(THREAD_ID_HASH(id) % THREAD_TABLE_SZ)
+  GC_EXTERN GC_thread GC_threads[THREAD_TABLE_SZ];
+#else
+  /* The hash table of the registered threads.  It starts with          */
+  /* THREAD_TABLE_SZ buckets and is doubled (by GC_new_thread) each     */
+  /* time the number of the entries exceeds the number of the buckets,  */
+  /* thus the chains remain short and iterating over all the threads    */
+  /* costs about the same as walking a dense array of them.             */
+# define THREAD_TABLE_INDEX(id) \
+                (int)(THREAD_ID_HASH(id) % (unsigned)GC_thread_table_sz)
+  GC_EXTERN GC_thread *GC_threads;
+  GC_EXTERN int GC_thread_table_sz;
+#endif
 
 #ifdef GC_ASSERTIONS
   GC_EXTERN GC_bool GC_thr_initialized;
 #endif
 
+#ifdef PARALLEL_RESTART
+  GC_EXTERN int GC_nprocs;
+#endif
+
 GC_INNER GC_thread GC_lookup_thread(thread_id_t);
 
+#ifdef FIBER_STACKS
+  /* A client fiber stack registered by GC_register_fiber.      */
+  typedef struct GC_Fiber_Rep {
+    struct GC_Fiber_Rep *next;  /* Links in GC_fibers list.             */
+    struct GC_Fiber_Rep *prev;
+    ptr_t stack_hi;             /* The cold end of the stack.           */
+    volatile AO_t saved_sp;     /* The stack pointer saved when the     */
+                                /* fiber was left the last time, or     */
+                                /* stack_hi if it has not run yet.      */
+  } *GC_fiber_t;
+
+  /* Push the saved parts of all the registered fiber stacks.  Returns  */
+  /* the total size of the pushed stacks.  Called by GC_push_all_stacks */
+  /* with the world stopped.                                            */
+  GC_INNER word GC_push_fiber_stacks(void);
+#endif
+
+#if defined(USE_COMPILER_TLS) && !defined(GC_WIN32_THREADS) \
+    && !defined(NACL)
+  /* The entry of the current thread in GC_threads, or NULL if the      */
+  /* thread is not registered (or has unregistered itself).  Since the  */
+  /* entry is not freed while the thread is registered, it can be read  */
+  /* without acquiring the allocation lock.                             */
+# define SELF_THREAD_TLS
+  extern __thread GC_ATTR_TLS_FAST GC_thread GC_self_thread_tls;
+# define GC_self_thread() GC_self_thread_tls
+#else
+# define GC_self_thread() GC_lookup_thread(pthread_self())
+#endif
+
 #ifdef NACL
   GC_EXTERN __thread GC_thread GC_nacl_gc_thread_self;
   GC_INNER void GC_nacl_initialize_gc_thread(void);
@@ -104,6 +104,10 @@ EXTERN_C_BEGIN
 # endif
 #endif /* !THREAD_FREELISTS_KINDS */
 
+#ifndef FREE_BATCH_SZ
+# define FREE_BATCH_SZ 64
+#endif
+
 /* One of these should be declared as the tlfs field in the     */
 /* structure pointed to by a GC_thread.                         */
 typedef struct thread_local_freelists {
@@ -117,6 +121,35 @@ typedef struct thread_local_freelists {
         /* Value used for gcj_freelists[-1]; allocation is      */
         /* erroneous.                                           */
 # endif
+  void * typed_freelists[TINY_FREELISTS];
+        /* Free lists of the explicitly typed objects (the      */
+        /* objects of GC_explicit_kind).                        */
+# if MAXOBJKINDS > THREAD_FREELISTS_KINDS
+    void ** kind_freelists[MAXOBJKINDS - THREAD_FREELISTS_KINDS];
+        /* Free lists of the other kinds (e.g. created by       */
+        /* GC_new_kind), TINY_FREELISTS entries each; allocated */
+        /* on the first use of the kind by the thread.          */
+# endif
+  ptr_t bump_ptr[THREAD_FREELISTS_KINDS][TINY_FREELISTS];
+  ptr_t bump_limit[THREAD_FREELISTS_KINDS][TINY_FREELISTS];
+        /* The bump-pointer allocation buffers (filled only if  */
+        /* GC_set_bump_alloc is on): the objects from bump_ptr  */
+        /* up to the last byte bump_limit (inclusive) of a      */
+        /* fresh block are not yet handed out, they are marked  */
+        /* by GC_mark_thread_local_fls_for.                     */
+  void * free_batch[FREE_BATCH_SZ];
+  word free_batch_len;
+        /* The objects explicitly freed by the thread but not   */
+        /* put yet to the global free lists (GC_batch_free).    */
+        /* They are marked by GC_mark_thread_local_fls_for,     */
+        /* thus not reclaimed by the collector meanwhile.       */
+  struct GC_clear_stack_s clear_stack;
+        /* The state of GC_clear_stack for the thread stack.    */
+  word assist_debt;
+        /* The bytes obtained by the free lists refills of the  */
+        /* thread during the incremental collection in progress */
+        /* not yet paid for by the marking work (the remainder  */
+        /* of a unit, see GC_take_mark_assist_units).           */
   /* Free lists contain either a pointer or a small count       */
   /* reflecting the number of granules allocated at that        */
   /* size.                                                      */
@@ -131,6 +164,11 @@ typedef struct thread_local_freelists {
 # define DIRECT_GRANULES (HBLKSIZE/GRANULE_BYTES)
         /* Don't use local free lists for up to this much       */
         /* allocation.                                          */
+# ifdef THREAD_STATS
+    word refill_bytes;  /* Statistics of the free lists refills */
+    word refill_count;  /* (see GC_thread_stats_s).             */
+    word refill_objs[GC_THREAD_STATS_SIZE_CLASSES];
+# endif
 } *GC_tlfs;
 
 #if defined(USE_PTHREAD_SPECIFIC)
@@ -181,6 +219,12 @@ GC_INNER void GC_init_thread_local(GC_tlfs p);
 /* We hold the allocator lock.                          */
 GC_INNER void GC_destroy_thread_local(GC_tlfs p);
 
+/* Return the free lists of a thread to the global ones, the thread     */
+/* keeps using the thread-local allocation.  Called by the thread       */
+/* itself, or while the thread is in the do-blocking state.  We hold    */
+/* the allocator lock.                                                  */
+GC_INNER void GC_flush_thread_local(GC_tlfs p);
+
 /* The thread support layer must arrange to mark thread-local   */
 /* free lists explicitly, since the link field is often         */
 /* invisible to the marker.  It knows how to find all threads;  */
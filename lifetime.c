@@ -0,0 +1,324 @@
+/*
+ * Copyright (c) 2023 Ivan Maidanski
+ *
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose, provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+#include "private/gc_priv.h"
+
+/*
+ * An object lifetime sampler.  Every GC_lifetime_interval-th object
+ * allocated in the slow path (i.e. the one refilling a free list or
+ * allocating a large object) is recorded in a side table hashed by the
+ * address, along with the number of the collections completed by the
+ * allocation.  When a collection finds a sampled object unmarked, the
+ * number of the collections the object has survived is accounted in the
+ * histogram of the object size class and kind, and the sample is
+ * dropped.  The explicitly deallocated objects are counted separately.
+ * Unlike the allocation profiler (heapprof.c), the call stack is not
+ * recorded, thus the sampler is available on all targets.
+ */
+
+#ifdef LIFETIME_SAMPLING
+
+#ifndef LIFETIME_SAMPLES_TABLE_SIZE
+# define LIFETIME_SAMPLES_TABLE_SIZE 4096 /* power of two */
+#endif
+
+#ifndef LIFETIME_CLASSES_TABLE_SIZE
+# define LIFETIME_CLASSES_TABLE_SIZE 64 /* power of two */
+#endif
+
+#define LIFETIME_OBJ_HASH(p) \
+        ((((word)(p) >> 4) ^ ((word)(p) >> 16)) \
+         & (LIFETIME_SAMPLES_TABLE_SIZE - 1))
+
+#define LIFETIME_CLASS_HASH(sz, kind) \
+        (((word)(sz) / GRANULE_BYTES + (word)(kind) * 7) \
+         & (LIFETIME_CLASSES_TABLE_SIZE - 1))
+
+struct lifetime_class {
+    struct lifetime_class *next;
+    struct GC_lifetime_stats_s stats;
+};
+
+struct lifetime_sample {
+    struct lifetime_sample *next;
+    ptr_t obj;          /* the object base; not seen by the marker      */
+    word alloc_gc_no;   /* GC_gc_no at the allocation                   */
+    struct lifetime_class *cls;
+};
+
+GC_INNER unsigned GC_lifetime_interval = 0;
+
+STATIC unsigned GC_lifetime_skipped = 0;
+                        /* The number of the slow-path allocations      */
+                        /* since the previous sample.  Updated without  */
+                        /* the lock, thus some of them might be lost.   */
+
+STATIC struct lifetime_class **GC_lifetime_classes = NULL;
+STATIC unsigned GC_lifetime_n_classes = 0;
+
+GC_INNER struct lifetime_sample **GC_lifetime_samples = NULL;
+                        /* The sampled objects not yet found            */
+                        /* unreachable or deallocated, hashed by the    */
+                        /* address.  Allocated along with the first     */
+                        /* sample.                                      */
+
+STATIC struct lifetime_sample *GC_lifetime_free_samples = NULL;
+
+GC_API void GC_CALL GC_set_lifetime_sampling(unsigned interval)
+{
+    DCL_LOCK_STATE;
+
+    if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+    LOCK();
+    GC_lifetime_interval = interval;
+    GC_lifetime_skipped = 0;
+    UNLOCK();
+}
+
+GC_API unsigned GC_CALL GC_get_lifetime_sampling(void)
+{
+    return GC_lifetime_interval;
+}
+
+/* Get the histogram of the given size (zero for large objects) and     */
+/* kind, creating it if needed.                                         */
+STATIC struct lifetime_class *GC_lifetime_get_class(word sz, unsigned kind)
+{
+    struct lifetime_class *c;
+    word h = LIFETIME_CLASS_HASH(sz, kind);
+
+    GC_ASSERT(I_HOLD_LOCK());
+    if (NULL == GC_lifetime_classes) {
+      GC_lifetime_classes = (struct lifetime_class **)
+                GC_scratch_alloc(LIFETIME_CLASSES_TABLE_SIZE
+                                 * sizeof(struct lifetime_class *));
+      if (NULL == GC_lifetime_classes) return NULL;
+      BZERO(GC_lifetime_classes,
+            LIFETIME_CLASSES_TABLE_SIZE * sizeof(struct lifetime_class *));
+    }
+    for (c = GC_lifetime_classes[h]; c != NULL; c = c -> next) {
+      if (c -> stats.size == sz && c -> stats.kind == kind)
+        return c;
+    }
+
+    c = (struct lifetime_class *)GC_scratch_alloc(
+                                        sizeof(struct lifetime_class));
+    if (NULL == c) return NULL;
+    BZERO(c, sizeof(struct lifetime_class));
+    c -> stats.size = sz;
+    c -> stats.kind = kind;
+    c -> next = GC_lifetime_classes[h];
+    GC_lifetime_classes[h] = c;
+    GC_lifetime_n_classes++;
+    return c;
+}
+
+STATIC void GC_lifetime_record(ptr_t p)
+{
+    hdr *hhdr = HDR(p);
+    struct lifetime_class *c;
+    struct lifetime_sample *s;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    c = GC_lifetime_get_class(hhdr -> hb_sz > MAXOBJBYTES ? 0
+                                : hhdr -> hb_sz, hhdr -> hb_obj_kind);
+    if (NULL == c) return;
+
+    if (NULL == GC_lifetime_samples) {
+      struct lifetime_sample **samples = (struct lifetime_sample **)
+                GC_scratch_alloc(LIFETIME_SAMPLES_TABLE_SIZE
+                                 * sizeof(struct lifetime_sample *));
+
+      if (NULL == samples) return;
+      BZERO(samples,
+            LIFETIME_SAMPLES_TABLE_SIZE * sizeof(struct lifetime_sample *));
+      GC_lifetime_samples = samples;
+    }
+    s = GC_lifetime_free_samples;
+    if (s != NULL) {
+      GC_lifetime_free_samples = s -> next;
+    } else {
+      s = (struct lifetime_sample *)GC_scratch_alloc(
+                                        sizeof(struct lifetime_sample));
+      if (NULL == s) return;
+    }
+    s -> obj = p;
+    s -> alloc_gc_no = GC_gc_no;
+    s -> cls = c;
+    s -> next = GC_lifetime_samples[LIFETIME_OBJ_HASH(p)];
+    GC_lifetime_samples[LIFETIME_OBJ_HASH(p)] = s;
+    c -> stats.n_sampled++;
+    c -> stats.n_live++;
+}
+
+GC_ATTR_NO_SANITIZE_THREAD
+GC_INNER void GC_lifetime_sample(void *p)
+{
+    ptr_t base;
+    DCL_LOCK_STATE;
+
+    /* A racy pre-check to avoid the lock on most of the allocations.   */
+    if (++GC_lifetime_skipped < GC_lifetime_interval)
+      return;
+
+    LOCK();
+    if (GC_lifetime_skipped >= GC_lifetime_interval
+        && GC_lifetime_interval != 0
+        && (base = (ptr_t)GC_base(p)) != NULL) {
+      GC_lifetime_skipped = 0;
+      GC_lifetime_record(base);
+    }
+    UNLOCK();
+}
+
+STATIC void GC_lifetime_drop(struct lifetime_sample **prev)
+{
+    struct lifetime_sample *s = *prev;
+
+    s -> cls -> stats.n_live--;
+    *prev = s -> next;
+    s -> next = GC_lifetime_free_samples;
+    GC_lifetime_free_samples = s;
+}
+
+GC_ATTR_NO_SANITIZE_THREAD
+GC_INNER void GC_lifetime_free(void *p)
+{
+    struct lifetime_sample **prev;
+    DCL_LOCK_STATE;
+
+    /* A racy pre-check: the slot of a sampled object is not empty (the */
+    /* sample has been recorded before the object was returned to the   */
+    /* client).                                                         */
+    if (NULL == GC_lifetime_samples[LIFETIME_OBJ_HASH(p)])
+      return;
+
+    LOCK();
+    for (prev = &GC_lifetime_samples[LIFETIME_OBJ_HASH(p)];
+         *prev != NULL; prev = &((*prev) -> next)) {
+      if ((*prev) -> obj == (ptr_t)p) {
+        (*prev) -> cls -> stats.n_freed++;
+        GC_lifetime_drop(prev);
+        break;
+      }
+    }
+    UNLOCK();
+}
+
+GC_INNER void GC_lifetime_after_mark(void)
+{
+    int i;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    for (i = 0; GC_lifetime_samples != NULL
+                && i < LIFETIME_SAMPLES_TABLE_SIZE; i++) {
+      struct lifetime_sample **prev = &GC_lifetime_samples[i];
+      struct lifetime_sample *s;
+
+      while ((s = *prev) != NULL) {
+        if (GC_base(s -> obj) != s -> obj) {
+          /* The block has been deallocated, e.g. by GC_free_n_inner. */
+          s -> cls -> stats.n_freed++;
+        } else if (GC_is_marked(s -> obj)) {
+          prev = &(s -> next);
+          continue;
+        } else {
+          /* GC_gc_no has been already incremented by this collection. */
+          word survived = GC_gc_no - s -> alloc_gc_no - 1;
+          unsigned bucket = 0;
+
+          while (survived != 0 && bucket < GC_LIFETIME_BUCKETS - 1) {
+            survived >>= 1;
+            bucket++;
+          }
+          s -> cls -> stats.died[bucket]++;
+        }
+        GC_lifetime_drop(prev);
+      }
+    }
+}
+
+GC_API size_t GC_CALL GC_get_lifetime_stats(struct GC_lifetime_stats_s *stats,
+                                            size_t n)
+{
+    size_t cnt = 0;
+    int i;
+    DCL_LOCK_STATE;
+
+    LOCK();
+    for (i = 0; GC_lifetime_classes != NULL
+                && i < LIFETIME_CLASSES_TABLE_SIZE; i++) {
+      struct lifetime_class *c;
+
+      for (c = GC_lifetime_classes[i]; c != NULL; c = c -> next) {
+        if (cnt < n)
+          stats[cnt] = c -> stats;
+        cnt++;
+      }
+    }
+    GC_ASSERT(cnt == GC_lifetime_n_classes);
+    UNLOCK();
+    return cnt;
+}
+
+GC_INNER void GC_print_lifetime_stats(void)
+{
+    struct lifetime_class *c;
+    int i, j;
+    DCL_LOCK_STATE;
+
+    LOCK();
+    GC_printf("Sampled object lifetimes (one per %u slow-path allocations)"
+              ", collections survived: 0 1 2-3 4-7 8-15 16-31 32-63 64+\n",
+              GC_lifetime_interval);
+    for (i = 0; GC_lifetime_classes != NULL
+                && i < LIFETIME_CLASSES_TABLE_SIZE; i++) {
+      for (c = GC_lifetime_classes[i]; c != NULL; c = c -> next) {
+        if (c -> stats.size != 0) {
+          GC_printf("kind %u size %lu:", c -> stats.kind,
+                    (unsigned long)c -> stats.size);
+        } else {
+          GC_printf("kind %u large:", c -> stats.kind);
+        }
+        for (j = 0; j < GC_LIFETIME_BUCKETS; j++)
+          GC_printf(" %lu", (unsigned long)c -> stats.died[j]);
+        GC_printf("; live %lu, freed %lu, sampled %lu\n",
+                  (unsigned long)c -> stats.n_live,
+                  (unsigned long)c -> stats.n_freed,
+                  (unsigned long)c -> stats.n_sampled);
+      }
+    }
+    UNLOCK();
+}
+
+#else /* !LIFETIME_SAMPLING */
+
+GC_API void GC_CALL GC_set_lifetime_sampling(unsigned interval)
+{
+    UNUSED_ARG(interval);
+}
+
+GC_API unsigned GC_CALL GC_get_lifetime_sampling(void)
+{
+    return 0;
+}
+
+GC_API size_t GC_CALL GC_get_lifetime_stats(struct GC_lifetime_stats_s *stats,
+                                            size_t n)
+{
+    UNUSED_ARG(stats);
+    UNUSED_ARG(n);
+    return 0;
+}
+
+#endif /* !LIFETIME_SAMPLING */
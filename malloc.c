@@ -55,9 +55,23 @@ GC_INNER ptr_t GC_alloc_large(size_t lb, int k, unsigned flags)
     /* Do our share of marking work */
         if (GC_incremental && !GC_dont_gc) {
             ENTER_GC();
-            GC_collect_a_little_inner((int)n_blocks);
+            GC_collect_a_little_or_notify((int)n_blocks);
             EXIT_GC();
         }
+#   ifdef USE_LARGE_OBJ_SPACE
+      if (GC_los_threshold != 0 && lb >= GC_los_threshold) {
+        if (!GC_incremental) {
+          /* Unlike GC_allochblk, this never fails for lack of free     */
+          /* blocks, so start a collection here if it is time to.       */
+          ENTER_GC();
+          GC_collect_a_little_inner((int)n_blocks);
+          EXIT_GC();
+        }
+        h = GC_los_alloc(lb, k, flags);
+        if (h != NULL) return h -> hb_body;
+        /* Otherwise fall back to the heap.     */
+      }
+#   endif
     h = GC_allochblk(lb, k, flags);
 #   ifdef USE_MUNMAP
         if (0 == h) {
@@ -93,7 +107,8 @@ STATIC ptr_t GC_alloc_large_and_clear(size_t lb, int k, unsigned flags)
     GC_ASSERT(I_HOLD_LOCK());
     result = GC_alloc_large(lb, k, flags);
     if (result != NULL
-          && (GC_debugging_started || GC_obj_kinds[k].ok_init)) {
+          && (GC_debugging_started || GC_obj_kinds[k].ok_init)
+          && !IS_LOS_HDR(HDR(result))) { /* fresh mapping is zeroed */
         word n_blocks = OBJ_SZ_TO_BLOCKS(lb);
 
         /* Clear the whole block, in case of GC_realloc call. */
@@ -155,6 +170,189 @@ STATIC void GC_extend_size_map(size_t i)
     GC_size_map[low_limit] = granule_sz;
 }
 
+/* The biggest request size whose GC_size_map entry is fixed by         */
+/* GC_init_size_map; the entries above are the tunable ones.            */
+#define TUNED_SIZE_MIN (GRANULES_TO_BYTES(TINY_FREELISTS-1) - EXTRA_BYTES)
+
+/* The biggest request size served by the objects of lg granules.       */
+#define LG_REQUEST_MAX(lg) (GRANULES_TO_BYTES(lg) - EXTRA_BYTES)
+
+STATIC word *GC_size_profile = NULL;
+                        /* Histogram of the small object request sizes  */
+                        /* (in bytes) seen by GC_malloc_kind_global;    */
+                        /* NULL unless the profiling is on.             */
+STATIC word *GC_size_profile_buf = NULL;
+                        /* The histogram storage (allocated once).      */
+
+GC_API void GC_CALL GC_set_size_profiling(int value)
+{
+  DCL_LOCK_STATE;
+
+  if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+  LOCK();
+  if (value) {
+    if (NULL == GC_size_profile_buf) {
+      GC_size_profile_buf = (word *)GC_scratch_alloc(
+                                (MAXOBJBYTES + 1) * sizeof(word));
+    }
+    if (GC_size_profile_buf != NULL)
+      BZERO(GC_size_profile_buf, (MAXOBJBYTES + 1) * sizeof(word));
+    GC_size_profile = GC_size_profile_buf;
+  } else {
+    GC_size_profile = NULL;
+  }
+  UNLOCK();
+}
+
+GC_API int GC_CALL GC_get_size_profiling(void)
+{
+  return GC_size_profile != NULL;
+}
+
+/* Set GC_size_map for the request sizes above TUNED_SIZE_MIN from the  */
+/* given ascending list of size classes (in granules).  The entries     */
+/* above the last class are left to GC_extend_size_map.                 */
+STATIC void GC_fill_size_map(const size_t *lg_classes, size_t n)
+{
+  size_t lb;
+  size_t i = 0;
+
+  for (lb = TUNED_SIZE_MIN + 1; lb <= MAXOBJBYTES; lb++) {
+    while (i < n && LG_REQUEST_MAX(lg_classes[i]) < lb)
+      i++;
+    GC_size_map[lb] = i < n ? lg_classes[i] : 0;
+  }
+}
+
+/* The per-object share (in bytes) of the unused tail of a block of     */
+/* objects of lg granules.                                              */
+#define TAIL_WASTE(lg) \
+        (GRANULES_TO_BYTES(HBLK_GRANULES % (lg)) / (HBLK_GRANULES / (lg)))
+
+/* The cost of one more size class, in bytes (as a half-empty block).   */
+#ifndef SIZE_CLASS_PENALTY
+# define SIZE_CLASS_PENALTY (HBLKSIZE / 2)
+#endif
+
+/* The candidate classes are the even granule counts (for the same      */
+/* reason as in GC_extend_size_map) above the tiny ones.                */
+#define N_CANDIDATE_CLASSES (MAXOBJGRANULES / 2 - (TINY_FREELISTS-1) / 2)
+#define CANDIDATE_LG(k) ((((TINY_FREELISTS-1) / 2) + 1 + (k)) * 2)
+
+GC_API void GC_CALL GC_tune_size_map(void)
+{
+  /* Cumulative count and bytes of the requests up to each candidate   */
+  /* limit, the best cost of covering the sizes up to it, and the      */
+  /* previous class in that best solution.  Index 0 means "none".      */
+  word cnt[N_CANDIDATE_CLASSES + 1];
+  word sum[N_CANDIDATE_CLASSES + 1];
+  word best[N_CANDIDATE_CLASSES + 1];
+  int prev[N_CANDIDATE_CLASSES + 1];
+  size_t lg_classes[N_CANDIDATE_CLASSES];
+  size_t lb = TUNED_SIZE_MIN + 1;
+  size_t n;
+  int k, j;
+  int last = 0;
+  DCL_LOCK_STATE;
+
+  GC_STATIC_ASSERT(CANDIDATE_LG(N_CANDIDATE_CLASSES - 1) <= MAXOBJGRANULES);
+  LOCK();
+  if (NULL == GC_size_profile) {
+    UNLOCK();
+    return;
+  }
+  cnt[0] = sum[0] = best[0] = 0;
+  for (k = 1; k <= (int)N_CANDIDATE_CLASSES; k++) {
+    size_t lim = LG_REQUEST_MAX(CANDIDATE_LG(k - 1));
+
+    cnt[k] = cnt[k - 1];
+    sum[k] = sum[k - 1];
+    for (; lb <= lim && lb <= MAXOBJBYTES; lb++) {
+      cnt[k] += GC_size_profile[lb];
+      sum[k] += GC_size_profile[lb] * lb;
+    }
+    if (cnt[k] != cnt[k - 1]) last = k;
+  }
+
+  /* Choose the classes minimizing the total internal fragmentation    */
+  /* (object rounding up plus block tails) of the observed requests.    */
+  for (k = 1; k <= last; k++) {
+    word lg_bytes = GRANULES_TO_BYTES(CANDIDATE_LG(k - 1))
+                        + TAIL_WASTE(CANDIDATE_LG(k - 1));
+
+    best[k] = GC_WORD_MAX;
+    prev[k] = 0;
+    for (j = 0; j < k; j++) {
+      word n_reqs = cnt[k] - cnt[j];
+      word cost = best[j] + n_reqs * lg_bytes - (sum[k] - sum[j])
+                  + (n_reqs != 0 ? SIZE_CLASS_PENALTY : 0);
+
+      if (cost < best[k]) {
+        best[k] = cost;
+        prev[k] = j;
+      }
+    }
+  }
+
+  /* Collect the chosen classes (in the ascending order).              */
+  n = 0;
+  for (k = last; k > 0; k = prev[k])
+    lg_classes[N_CANDIDATE_CLASSES - ++n] = CANDIDATE_LG(k - 1);
+  GC_fill_size_map(lg_classes + N_CANDIDATE_CLASSES - n, n);
+  GC_COND_LOG_PRINTF("Tuned size map: %u classes up to %lu bytes\n",
+                     (unsigned)n, (unsigned long)LG_REQUEST_MAX(
+                                        last > 0 ? CANDIDATE_LG(last - 1)
+                                        : TINY_FREELISTS-1));
+  UNLOCK();
+}
+
+GC_API size_t GC_CALL GC_get_size_classes(size_t *sizes, size_t n)
+{
+  size_t lb;
+  size_t lg = 0;
+  size_t result = 0;
+  DCL_LOCK_STATE;
+
+  LOCK();
+  for (lb = TUNED_SIZE_MIN + 1; lb <= MAXOBJBYTES; lb++) {
+    if (GC_size_map[lb] == lg || 0 == GC_size_map[lb]) continue;
+    lg = GC_size_map[lb];
+    if (result < n) sizes[result] = GRANULES_TO_BYTES(lg);
+    result++;
+  }
+  UNLOCK();
+  return result;
+}
+
+GC_INNER GC_bool GC_set_size_classes_inner(const size_t *sizes, size_t n)
+{
+  size_t lg_classes[MAXOBJGRANULES];
+  size_t i;
+
+  if (n > MAXOBJGRANULES) return FALSE;
+  for (i = 0; i < n; i++) {
+    if (sizes[i] % GRANULE_BYTES != 0 || sizes[i] > MAXOBJBYTES
+        || LG_REQUEST_MAX(BYTES_TO_GRANULES(sizes[i])) <= TUNED_SIZE_MIN
+        || (i > 0 && sizes[i] <= sizes[i - 1]))
+      return FALSE;
+    lg_classes[i] = BYTES_TO_GRANULES(sizes[i]);
+  }
+  GC_fill_size_map(lg_classes, n);
+  return TRUE;
+}
+
+GC_API int GC_CALL GC_set_size_classes(const size_t *sizes, size_t n)
+{
+  GC_bool ok;
+  DCL_LOCK_STATE;
+
+  if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+  LOCK();
+  ok = GC_set_size_classes_inner(sizes, n);
+  UNLOCK();
+  return (int)ok;
+}
+
 /* Allocate lb bytes for an object of kind k.           */
 /* Should not be used to directly to allocate objects   */
 /* that require special handling on allocation.         */
@@ -288,9 +486,134 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_generic_malloc(size_t lb, int k)
         }
     }
     if (EXPECT(NULL == result, FALSE)) return (*GC_get_oom_fn())(lb);
+    GC_HEAP_PROF_SAMPLE(result, lb);
+    GC_LIFETIME_SAMPLE(result);
     return result;
 }
 
+#ifdef SHARDED_FREE_LISTS
+  /* The free list shards, one per size class of the PTRFREE and NORMAL */
+  /* kinds.  A shard holds the objects explicitly deallocated by        */
+  /* GC_free (linked through the first word like on the free lists)     */
+  /* until they are taken by GC_malloc_kind_global or moved to the      */
+  /* global free list (by GC_flush_fl_shard) when the latter is about   */
+  /* to be refilled, and at the beginning of each reclaim phase.  Both  */
+  /* the producers and consumers acquire only the spin lock of the      */
+  /* shard, and take the usual (locked) path if the lock is busy, thus  */
+  /* the collector never waits for it.  The objects in the shards are   */
+  /* counted as explicitly freed ones at once, and as allocated again   */
+  /* (when taken from a shard) once flushed.  They are marked at each   */
+  /* collection like the thread-local free lists, so that an object     */
+  /* taken from a shard after the world is restarted is not reclaimed.  */
+  struct fl_shard_s {
+    volatile AO_TS_t fs_lock;
+    volatile AO_t fs_head;      /* ptr_t; the first object or NULL.     */
+    word fs_bytes_reused;       /* the number of bytes taken from the   */
+                                /* shard since the last flush.          */
+  };
+
+  GC_INNER volatile AO_t GC_fl_shards_bytes_freed = 0;
+
+  STATIC union {
+    struct fl_shard_s s;
+    char pad[CACHE_LINE_SIZE]; /* to avoid false sharing of locks */
+  } GC_fl_shards[NORMAL + 1][MAXOBJGRANULES + 1];
+
+  /* Put the object p of lg granules to the shard.  Returns FALSE if    */
+  /* the shard lock is busy for too long.                               */
+  STATIC GC_bool GC_fl_shard_put(int k, size_t lg, ptr_t p)
+  {
+    struct fl_shard_s *sh = &GC_fl_shards[k][lg].s;
+    int i;
+
+    for (i = 0; AO_test_and_set_acquire(&sh -> fs_lock) == AO_TS_SET; i++) {
+      if (i >= 128) return FALSE; /* the holder might be preempted */
+    }
+    /* Link the object before publishing it, as the shard could be      */
+    /* traversed by GC_mark_fl_shards at any moment.                    */
+    obj_link(p) = (ptr_t)sh -> fs_head;
+    AO_store_release(&sh -> fs_head, (AO_t)p);
+    AO_CLEAR(&sh -> fs_lock);
+    (void)AO_fetch_and_add(&GC_fl_shards_bytes_freed,
+                           (AO_t)GRANULES_TO_BYTES((word)lg));
+    return TRUE;
+  }
+
+  /* Take an object from the shard if possible.                         */
+  STATIC void *GC_fl_shard_get(int k, size_t lg)
+  {
+    struct fl_shard_s *sh = &GC_fl_shards[k][lg].s;
+    ptr_t op;
+
+    if (0 == AO_load(&sh -> fs_head)
+        || AO_test_and_set_acquire(&sh -> fs_lock) == AO_TS_SET)
+      return NULL;
+    op = (ptr_t)sh -> fs_head;
+    if (op != NULL) {
+      AO_store_release(&sh -> fs_head, (AO_t)obj_link(op));
+      sh -> fs_bytes_reused += GRANULES_TO_BYTES((word)lg);
+    }
+    AO_CLEAR(&sh -> fs_lock);
+    if (op != NULL && k != PTRFREE) obj_link(op) = NULL;
+    return op;
+  }
+
+  GC_INNER void GC_flush_fl_shard(int k, size_t lg)
+  {
+    struct fl_shard_s *sh;
+    ptr_t first, last;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    if (k > NORMAL) return;
+    sh = &GC_fl_shards[k][lg].s;
+    if ((0 == AO_load(&sh -> fs_head) && 0 == sh -> fs_bytes_reused)
+        || AO_test_and_set_acquire(&sh -> fs_lock) == AO_TS_SET)
+      return;
+    first = (ptr_t)sh -> fs_head;
+    AO_store(&sh -> fs_head, 0);
+    GC_bytes_allocd += sh -> fs_bytes_reused;
+    sh -> fs_bytes_reused = 0;
+    AO_CLEAR(&sh -> fs_lock);
+    if (first != NULL) {
+      void **flh = &GC_obj_kinds[k].ok_freelist[lg];
+
+      for (last = first; obj_link(last) != NULL; last = obj_link(last)) {
+        /* empty */
+      }
+      obj_link(last) = *flh;
+      *flh = first;
+    }
+  }
+
+  GC_INNER void GC_flush_fl_shards(void)
+  {
+    int k;
+    size_t lg;
+    AO_t bytes_freed = AO_load(&GC_fl_shards_bytes_freed);
+
+    /* The objects could be put to the shards concurrently.     */
+    (void)AO_fetch_and_add(&GC_fl_shards_bytes_freed, (AO_t)0 - bytes_freed);
+    GC_bytes_freed += (word)bytes_freed;
+
+    for (k = 0; k <= NORMAL; k++) {
+      for (lg = 1; lg <= MAXOBJGRANULES; lg++)
+        GC_flush_fl_shard(k, lg);
+    }
+  }
+
+  GC_INNER void GC_mark_fl_shards(void)
+  {
+    int k;
+    size_t lg;
+
+    GC_ASSERT(GC_world_stopped);
+    for (k = 0; k <= NORMAL; k++) {
+      for (lg = 1; lg <= MAXOBJGRANULES; lg++)
+        GC_set_fl_marks((ptr_t)GC_fl_shards[k][lg].s.fs_head);
+    }
+  }
+#endif /* SHARDED_FREE_LISTS */
+
 GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc_kind_global(size_t lb, int k)
 {
     GC_ASSERT(k < MAXOBJKINDS);
@@ -301,7 +624,16 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc_kind_global(size_t lb, int k)
         DCL_LOCK_STATE;
 
         GC_DBG_COLLECT_AT_MALLOC(lb);
+#       ifdef SHARDED_FREE_LISTS
+          /* Not if the request sizes are profiled (under the lock).    */
+          if (k <= NORMAL && NULL == GC_size_profile) {
+            op = GC_fl_shard_get(k, GC_size_map[lb]);
+            if (op != NULL) return op;
+          }
+#       endif
         LOCK();
+        if (EXPECT(GC_size_profile != NULL, FALSE))
+          GC_size_profile[lb]++;
         lg = GC_size_map[lb];
         opp = &GC_obj_kinds[k].ok_freelist[lg];
         op = *opp;
@@ -348,6 +680,169 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc(size_t lb)
     return GC_malloc_kind(lb, NORMAL);
 }
 
+STATIC unsigned char GC_long_lived_kinds[MAXOBJKINDS] = { 0 };
+                        /* The companion kind (plus one) to allocate    */
+                        /* the long-lived objects of the given kind     */
+                        /* from, 0 if not created yet.  Updated with    */
+                        /* the allocation lock held.                    */
+
+/* Return the companion kind of k to allocate the long-lived objects    */
+/* from (or k itself if no more kinds could be created).                */
+GC_ATTR_NO_SANITIZE_THREAD
+STATIC int GC_long_lived_kind(int k)
+{
+    unsigned res;
+    DCL_LOCK_STATE;
+
+    /* A racy pre-check to avoid the lock once the kind is created.     */
+    if (EXPECT(GC_long_lived_kinds[k] != 0, TRUE))
+      return (int)GC_long_lived_kinds[k] - 1;
+
+    LOCK();
+    if (0 == GC_long_lived_kinds[k]) {
+      res = (unsigned)k;
+      if (GC_n_kinds < MAXOBJKINDS) {
+        struct obj_kind *ok = &GC_obj_kinds[k];
+
+        res = GC_new_kind_inner(GC_new_free_list_inner(), ok -> ok_descriptor,
+                                ok -> ok_relocate_descr, ok -> ok_init);
+        GC_obj_kinds[res].ok_exact_base = ok -> ok_exact_base;
+#       ifdef ENABLE_DISCLAIM
+          GC_obj_kinds[res].ok_mark_unconditionally =
+                                        ok -> ok_mark_unconditionally;
+          GC_obj_kinds[res].ok_disclaim_proc = ok -> ok_disclaim_proc;
+          GC_obj_kinds[res].ok_disclaim_batch_proc =
+                                        ok -> ok_disclaim_batch_proc;
+          GC_obj_kinds[res].ok_disclaim_needed_only =
+                                        ok -> ok_disclaim_needed_only;
+#       endif
+        GC_long_lived_kinds[res] = (unsigned char)(res + 1);
+      }
+      GC_long_lived_kinds[k] = (unsigned char)(res + 1);
+    }
+    res = (unsigned)GC_long_lived_kinds[k] - 1;
+    UNLOCK();
+    return (int)res;
+}
+
+GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc_kind_hint(size_t lb, int k,
+                                                         unsigned hint)
+{
+    GC_ASSERT(k < MAXOBJKINDS);
+    if (GC_HINT_LONG_LIVED == hint && !IS_UNCOLLECTABLE(k)) {
+      if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+      k = GC_long_lived_kind(k);
+    }
+    return GC_malloc_kind(lb, k);
+}
+
+struct GC_heap_s {
+    unsigned char hs_kinds[NORMAL + 1];
+                        /* The kind (plus one) to allocate the heap     */
+                        /* objects of the given predefined kind (either */
+                        /* PTRFREE or NORMAL) from, 0 if not created    */
+                        /* yet.  Updated with the allocation lock held. */
+};
+
+STATIC struct GC_heap_s GC_heaps[MAXOBJKINDS];
+                        /* The heaps created so far (more heaps than    */
+                        /* kinds would not be separate anyway), so that */
+                        /* no memory is allocated for them.             */
+STATIC unsigned GC_n_heaps = 0;
+
+GC_API GC_heap_t GC_CALL GC_new_heap(void)
+{
+    GC_heap_t heap = NULL;
+    DCL_LOCK_STATE;
+
+    if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+    LOCK();
+    if (GC_n_heaps < MAXOBJKINDS)
+      heap = &GC_heaps[GC_n_heaps++];
+    UNLOCK();
+    if (NULL == heap)
+      WARN("Too many separate heaps (max: %" WARN_PRIuPTR ")\n",
+           (word)MAXOBJKINDS);
+    return heap;
+}
+
+/* Return the kind of the heap to allocate the objects of the given     */
+/* predefined kind from, creating it on the first call (or k itself if  */
+/* no more kinds could be created).                                     */
+GC_ATTR_NO_SANITIZE_THREAD
+STATIC int GC_heap_kind(GC_heap_t heap, int k)
+{
+    unsigned res;
+    GC_bool no_kinds = FALSE;
+    DCL_LOCK_STATE;
+
+    /* A racy pre-check to avoid the lock once the kind is created.     */
+    if (EXPECT(heap -> hs_kinds[k] != 0, TRUE))
+      return (int)heap -> hs_kinds[k] - 1;
+
+    LOCK();
+    if (0 == heap -> hs_kinds[k]) {
+      res = (unsigned)k;
+      if (GC_n_kinds < MAXOBJKINDS) {
+        struct obj_kind *ok = &GC_obj_kinds[k];
+
+        res = GC_new_kind_inner(GC_new_free_list_inner(), ok -> ok_descriptor,
+                                ok -> ok_relocate_descr, ok -> ok_init);
+      } else {
+        no_kinds = TRUE;
+      }
+      heap -> hs_kinds[k] = (unsigned char)(res + 1);
+    }
+    res = (unsigned)heap -> hs_kinds[k] - 1;
+    UNLOCK();
+    if (no_kinds)
+      WARN("No more object kinds for a separate heap,"
+           " using the predefined kind %" WARN_PRIuPTR "\n", (word)k);
+    return (int)res;
+}
+
+GC_API GC_ATTR_MALLOC void * GC_CALL GC_heap_malloc(GC_heap_t heap,
+                                                    size_t lb)
+{
+    return GC_malloc_kind(lb, GC_heap_kind(heap, NORMAL));
+}
+
+GC_API GC_ATTR_MALLOC void * GC_CALL GC_heap_malloc_atomic(GC_heap_t heap,
+                                                           size_t lb)
+{
+    return GC_malloc_kind(lb, GC_heap_kind(heap, PTRFREE));
+}
+
+static void GC_CALLBACK heap_block_add_size(struct hblk *h, GC_word data)
+{
+    word *pdata = (word *)data; /* { atomic_kind, kind, bytes } */
+    hdr *hhdr = HDR(h);
+
+    if ((word)hhdr -> hb_obj_kind == pdata[0]
+        || (word)hhdr -> hb_obj_kind == pdata[1])
+      pdata[2] += ((word)hhdr -> hb_sz + HBLKSIZE-1) & ~(word)(HBLKSIZE-1);
+}
+
+GC_API size_t GC_CALL GC_heap_get_size(GC_heap_t heap)
+{
+    word data[3];
+    int k;
+    DCL_LOCK_STATE;
+
+    LOCK();
+    /* Skip the kinds not created yet, and the predefined ones.         */
+    for (k = 0; k <= NORMAL; k++) {
+      int heap_kind = (int)heap -> hs_kinds[k] - 1;
+
+      data[k] = heap_kind >= 0 && heap_kind != k ? (word)heap_kind
+                                                 : ~(word)0;
+    }
+    data[2] = 0;
+    GC_apply_to_all_blocks(heap_block_add_size, (word)data);
+    UNLOCK();
+    return (size_t)data[2];
+}
+
 GC_API GC_ATTR_MALLOC void * GC_CALL GC_generic_malloc_uncollectable(
                                                         size_t lb, int k)
 {
@@ -392,6 +887,7 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_generic_malloc_uncollectable(
         /* pointer.  We do need to hold the lock while we adjust        */
         /* mark bits.                                                   */
         LOCK();
+        VALIDATE_MARKS(hhdr);
         set_mark_bit_from_hdr(hhdr, 0); /* Only object. */
 #       ifndef THREADS
           GC_ASSERT(hhdr -> hb_n_marks == 0);
@@ -582,6 +1078,8 @@ GC_API void GC_CALL GC_free(void * p)
       GC_log_printf("GC_free(%p) after GC #%lu\n",
                     p, (unsigned long)GC_gc_no);
 #   endif
+    GC_HEAP_PROF_FREE(p);
+    GC_LIFETIME_FREE(p);
     h = HBLKPTR(p);
     hhdr = HDR(h);
 #   if defined(REDIRECT_MALLOC) && \
@@ -604,15 +1102,32 @@ GC_API void GC_CALL GC_free(void * p)
     if (EXPECT(ngranules <= MAXOBJGRANULES, TRUE)) {
         void **flh;
 
+#       ifdef THREAD_LOCAL_ALLOC
+          if (GC_batch_free(p)) return;
+#       endif
+        /* The object still belongs to the caller (and p keeps it      */
+        /* reachable), so clear it before acquiring any lock.          */
+        if (ok -> ok_init && EXPECT(sz > sizeof(word), TRUE)) {
+            BZERO((word *)p + 1, sz-sizeof(word));
+        }
+#       ifdef SHARDED_FREE_LISTS
+          if (knd <= NORMAL && !GC_find_leak
+#             ifdef ENABLE_DISCLAIM
+                && (hhdr -> hb_flags & HAS_DISCLAIM) == 0
+#             endif
+              && GC_fl_shard_put(knd, ngranules, (ptr_t)p))
+            return;
+#       endif
         LOCK();
         GC_bytes_freed += sz;
         if (IS_UNCOLLECTABLE(knd)) GC_non_gc_bytes -= sz;
                 /* Its unnecessary to clear the mark bit.  If the       */
                 /* object is reallocated, it doesn't matter.  O.w. the  */
                 /* collector will do it, since it's on a free list.     */
-        if (ok -> ok_init && EXPECT(sz > sizeof(word), TRUE)) {
-            BZERO((word *)p + 1, sz-sizeof(word));
-        }
+#       ifdef ENABLE_DISCLAIM
+          if (EXPECT((hhdr -> hb_flags & HAS_DISCLAIM) != 0, FALSE))
+            CLEAR_DISCLAIM_BIT(hhdr, MARK_BIT_NO((ptr_t)p - (ptr_t)h, sz));
+#       endif
         flh = &(ok -> ok_freelist[ngranules]);
         obj_link(p) = *flh;
         *flh = (ptr_t)p;
@@ -623,7 +1138,7 @@ GC_API void GC_CALL GC_free(void * p)
         LOCK();
         GC_bytes_freed += sz;
         if (IS_UNCOLLECTABLE(knd)) GC_non_gc_bytes -= sz;
-        if (nblocks > 1) {
+        if (nblocks > 1 && !IS_LOS_HDR(hhdr)) {
           GC_large_allocd_bytes -= nblocks * HBLKSIZE;
         }
         GC_freehblk(h);
@@ -631,6 +1146,146 @@ GC_API void GC_CALL GC_free(void * p)
     }
 }
 
+GC_API void GC_CALL GC_free_sized(void *p, size_t lb)
+{
+    if (NULL == p) return;
+    GC_ASSERT(GC_size(p) >= lb);
+#   ifdef THREAD_LOCAL_ALLOC
+      /* The size class is not determined by lb (e.g., the size map     */
+      /* might round it up), so lb is used just to skip the large ones. */
+      if (BYTES_TO_GRANULES(lb) < TINY_FREELISTS
+          && GC_free_to_local_fl(p)) {
+        GC_HEAP_PROF_FREE(p);
+        GC_LIFETIME_FREE(p);
+        return;
+      }
+#   else
+      (void)lb;
+#   endif
+    GC_free(p);
+}
+
+/* Sort the pointers by address (Shell's method).  Unlike qsort, this   */
+/* neither allocates nor calls back.                                    */
+STATIC void GC_sort_ptrs(void **a, size_t n)
+{
+    size_t gap, i, j;
+
+    for (gap = 1; gap < n / 3; gap = gap * 3 + 1) {
+      /* empty */
+    }
+    for (; gap > 0; gap /= 3) {
+      for (i = gap; i < n; i++) {
+        void *v = a[i];
+
+        for (j = i; j >= gap && (word)a[j - gap] > (word)v; j -= gap)
+          a[j] = a[j - gap];
+        a[j] = v;
+      }
+    }
+}
+
+GC_API void GC_CALL GC_free_n(void **ptrs, size_t n)
+{
+    DCL_LOCK_STATE;
+
+#   ifdef HEAP_PROFILE
+      if (EXPECT(GC_heap_prof_samples != NULL, FALSE)) {
+        size_t i;
+
+        for (i = 0; i < n; i++) {
+          if (ptrs[i] != NULL) GC_heap_prof_free(ptrs[i]);
+        }
+      }
+#   endif
+#   ifdef LIFETIME_SAMPLING
+      if (EXPECT(GC_lifetime_samples != NULL, FALSE)) {
+        size_t i;
+
+        for (i = 0; i < n; i++) {
+          if (ptrs[i] != NULL) GC_lifetime_free(ptrs[i]);
+        }
+      }
+#   endif
+    /* Sort the objects by address, so that those of the same block     */
+    /* are adjacent and the header is looked up once per block.         */
+    GC_sort_ptrs(ptrs, n);
+    LOCK();
+    GC_free_n_inner(ptrs, n);
+    UNLOCK();
+}
+
+GC_INNER void GC_free_n_inner(void **ptrs, size_t n)
+{
+    size_t i;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    for (i = 0; i < n; ) {
+        void *p = ptrs[i];
+        struct hblk *h;
+        hdr *hhdr;
+        size_t sz; /* In bytes */
+        size_t ngranules;   /* sz in granules */
+        int knd;
+        struct obj_kind * ok;
+
+        if (NULL == p) {
+            i++;
+            continue;
+        }
+#       ifdef LOG_ALLOCS
+          GC_log_printf("GC_free_n(%p) after GC #%lu\n",
+                        p, (unsigned long)GC_gc_no);
+#       endif
+        h = HBLKPTR(p);
+        hhdr = HDR(h);
+#       if defined(REDIRECT_MALLOC) && \
+            ((defined(NEED_CALLINFO) && defined(GC_HAVE_BUILTIN_BACKTRACE)) \
+             || defined(GC_SOLARIS_THREADS) || defined(GC_LINUX_THREADS) \
+             || defined(MSWIN32))
+          /* See the comment in GC_free.        */
+          if (0 == hhdr) {
+            i++;
+            continue;
+          }
+#       endif
+        sz = (size_t)hhdr->hb_sz;
+        ngranules = BYTES_TO_GRANULES(sz);
+        knd = hhdr -> hb_obj_kind;
+        ok = &GC_obj_kinds[knd];
+        if (EXPECT(ngranules <= MAXOBJGRANULES, TRUE)) {
+            void **flh = &(ok -> ok_freelist[ngranules]);
+
+            do {
+                GC_ASSERT(GC_base(p) == p);
+                GC_bytes_freed += sz;
+                if (IS_UNCOLLECTABLE(knd)) GC_non_gc_bytes -= sz;
+#               ifdef ENABLE_DISCLAIM
+                  if (EXPECT((hhdr -> hb_flags & HAS_DISCLAIM) != 0, FALSE))
+                    CLEAR_DISCLAIM_BIT(hhdr,
+                                MARK_BIT_NO((ptr_t)p - (ptr_t)h, sz));
+#               endif
+                if (ok -> ok_init && EXPECT(sz > sizeof(word), TRUE)) {
+                    BZERO((word *)p + 1, sz-sizeof(word));
+                }
+                obj_link(p) = *flh;
+                *flh = (ptr_t)p;
+            } while (++i < n && HBLKPTR(p = ptrs[i]) == h);
+        } else {
+            size_t nblocks = OBJ_SZ_TO_BLOCKS(sz);
+
+            GC_ASSERT(GC_base(p) == p);
+            GC_bytes_freed += sz;
+            if (IS_UNCOLLECTABLE(knd)) GC_non_gc_bytes -= sz;
+            if (nblocks > 1 && !IS_LOS_HDR(hhdr)) {
+              GC_large_allocd_bytes -= nblocks * HBLKSIZE;
+            }
+            GC_freehblk(h);
+            i++;
+        }
+    }
+}
+
 /* Explicitly deallocate an object p when we already hold lock.         */
 /* Only used for internally allocated objects, so we can take some      */
 /* shortcuts.                                                           */
@@ -666,7 +1321,7 @@ GC_API void GC_CALL GC_free(void * p)
         size_t nblocks = OBJ_SZ_TO_BLOCKS(sz);
         GC_bytes_freed += sz;
         if (IS_UNCOLLECTABLE(knd)) GC_non_gc_bytes -= sz;
-        if (nblocks > 1) {
+        if (nblocks > 1 && !IS_LOS_HDR(hhdr)) {
           GC_large_allocd_bytes -= nblocks * HBLKSIZE;
         }
         GC_freehblk(h);
@@ -55,22 +55,21 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_generic_or_special_malloc(size_t lb,
                                                                   int knd)
 {
     switch(knd) {
-        case PTRFREE:
-        case NORMAL:
-            return GC_malloc_kind(lb, knd);
         case UNCOLLECTABLE:
 #       ifdef GC_ATOMIC_UNCOLLECTABLE
           case AUNCOLLECTABLE:
 #       endif
             return GC_generic_malloc_uncollectable(lb, knd);
         default:
-            return GC_generic_malloc(lb, knd);
+            return GC_malloc_kind(lb, knd);
     }
 }
 
 /* Change the size of the block pointed to by p to contain at least   */
 /* lb bytes.  The object may be (and quite likely will be) moved.     */
 /* The kind (e.g. atomic) is the same as that of the old.             */
+/* A large object is grown in place if followed by a free block (or,  */
+/* in the large-object space, by remapping its pages).                */
 /* Shrinking of large blocks is not implemented well.                 */
 GC_API void * GC_CALL GC_realloc(void * p, size_t lb)
 {
@@ -157,6 +156,17 @@ GC_API void * GC_CALL GC_realloc(void * p, size_t lb)
         /* shrink */
         sz = lb;
     }
+#   ifndef NO_REALLOC_IN_PLACE
+      else if (sz > MAXOBJBYTES) {
+        DCL_LOCK_STATE;
+
+        /* Try to extend the object without copying it. */
+        LOCK();
+        result = GC_grow_hblk(h, ADD_SLOP(lb));
+        UNLOCK();
+        if (result != NULL) return result;
+      }
+#   endif
     result = GC_generic_or_special_malloc((word)lb, obj_kind);
     if (EXPECT(result != NULL, TRUE)) {
       /* In case of shrink, it could also return original object.       */
@@ -267,7 +277,7 @@ void GC_CALL GC_incr_bytes_freed(size_t n)
 
 GC_API size_t GC_CALL GC_get_expl_freed_bytes_since_gc(void)
 {
-    return (size_t)GC_bytes_freed;
+    return (size_t)GC_EXPL_FREED_BYTES();
 }
 
 # ifdef PARALLEL_MARK
@@ -282,6 +292,163 @@ GC_API size_t GC_CALL GC_get_expl_freed_bytes_since_gc(void)
                         /* expensive.)                                  */
 # endif /* PARALLEL_MARK */
 
+#ifdef USE_READY_CHUNKS
+  /* Queues of "ready chunks", one per size class of the PTRFREE and    */
+  /* NORMAL kinds.  A chunk is the free list of one block swept by      */
+  /* GC_generic_malloc_many ahead of time (while it holds the lock or   */
+  /* acts as a free list builder); the chunks are consumed by the later */
+  /* calls without acquiring the allocation lock.  The chunks of a      */
+  /* queue are linked through the second word of their first object     */
+  /* (every object is at least a granule long).  The queued objects     */
+  /* are accounted as allocated ones, and they are marked at each       */
+  /* collection like the thread-local free lists.  Each queue has its   */
+  /* own spin lock which is only tried by the consumers, thus a busy    */
+  /* queue just makes the caller to take the usual (locked) path.       */
+# ifndef READY_CHUNKS_MAX
+#   define READY_CHUNKS_MAX 4 /* per queue */
+# endif
+
+  struct ready_chunks_s {
+    volatile AO_TS_t rc_lock;
+    volatile AO_t rc_head;      /* ptr_t; the first chunk or NULL.      */
+    unsigned rc_count;          /* the number of queued chunks; could   */
+                                /* be read without holding rc_lock.     */
+  };
+
+  STATIC struct ready_chunks_s GC_ready_chunks[NORMAL + 1][MAXOBJGRANULES + 1];
+
+# define CHUNK_NEXT(p) (((ptr_t *)(p))[1])
+# define READY_CHUNKS_KIND(k) ((k) <= NORMAL && !GC_manual_vdb)
+
+  /* Get a chunk from the queue of the given kind and size if possible. */
+  STATIC GC_bool GC_get_ready_chunk(int k, size_t lg, void **result)
+  {
+    struct ready_chunks_s *q = &GC_ready_chunks[k][lg];
+    ptr_t chunk;
+
+    if (0 == AO_load(&q -> rc_head)
+        || AO_test_and_set_acquire(&q -> rc_lock) == AO_TS_SET)
+      return FALSE;
+    chunk = (ptr_t)q -> rc_head;
+    if (chunk != NULL) {
+      /* The chunk should be referenced by the caller before it is      */
+      /* unlinked from the queue, so that it remains visible to the     */
+      /* collector at any moment the world might be stopped.            */
+      *result = chunk;
+      AO_store_release(&q -> rc_head, (AO_t)CHUNK_NEXT(chunk));
+      q -> rc_count--;
+    }
+    AO_CLEAR(&q -> rc_lock);
+    if (NULL == chunk) return FALSE;
+    CHUNK_NEXT(chunk) = NULL; /* restore the cleared state of the object */
+    return TRUE;
+  }
+
+  /* Put the chunks (linked by CHUNK_NEXT) to the queue.  Returns FALSE */
+  /* if the queue lock is busy for too long.                            */
+  STATIC GC_bool GC_put_ready_chunks(int k, size_t lg, ptr_t chunks)
+  {
+    struct ready_chunks_s *q = &GC_ready_chunks[k][lg];
+    ptr_t last = chunks;
+    unsigned n = 1;
+    int i;
+
+    while (CHUNK_NEXT(last) != NULL) {
+      last = CHUNK_NEXT(last);
+      n++;
+    }
+    for (i = 0; AO_test_and_set_acquire(&q -> rc_lock) == AO_TS_SET; i++) {
+      if (i >= 128) return FALSE; /* the holder might be preempted */
+    }
+    CHUNK_NEXT(last) = (ptr_t)q -> rc_head;
+    AO_store_release(&q -> rc_head, (AO_t)chunks);
+    q -> rc_count += n;
+    AO_CLEAR(&q -> rc_lock);
+    return TRUE;
+  }
+
+  /* Detach up to the number of blocks missing in the queue of the      */
+  /* given kind and size from the reclaim list (the caller holds the    */
+  /* allocation lock).  Returns the blocks linked through hb_next.      */
+  STATIC struct hblk *GC_take_extra_blocks(struct hblk **rlh, int k,
+                                           size_t lg)
+  {
+    struct hblk *first = rlh[lg];
+    struct hblk *hbp = first;
+    hdr *hhdr = NULL;
+    unsigned n = GC_ready_chunks[k][lg].rc_count;
+
+    for (; n < READY_CHUNKS_MAX && hbp != NULL; n++) {
+      hhdr = HDR(hbp);
+      hhdr -> hb_last_reclaimed = (unsigned short)GC_gc_no;
+      hbp = hhdr -> hb_next;
+    }
+    if (NULL == hhdr) return NULL;
+    hhdr -> hb_next = NULL;
+    rlh[lg] = hbp;
+    return first;
+  }
+
+  /* Sweep the extra blocks taken by GC_take_extra_blocks.  If op (the  */
+  /* free list of the block reclaimed by the caller) is empty, then the */
+  /* first non-empty free list replaces it, the rest ones are queued.   */
+  /* The chunks which could not be queued are appended to op.  The      */
+  /* result is the new value of op.                                     */
+  STATIC void *GC_reclaim_extra_blocks(struct hblk *hbp, size_t lb, int k,
+                                       void *op, signed_word *pcount)
+  {
+    size_t lg = BYTES_TO_GRANULES(lb);
+    ptr_t chunks = NULL;
+
+    while (hbp != NULL) {
+      hdr *hhdr = HDR(hbp);
+      struct hblk *next = hhdr -> hb_next;
+      ptr_t fl = GC_reclaim_generic(hbp, hhdr, lb, GC_obj_kinds[k].ok_init,
+                                    0, pcount);
+
+      if (fl != NULL) {
+        if (NULL == op) {
+          op = fl;
+        } else {
+          CHUNK_NEXT(fl) = chunks;
+          chunks = fl;
+        }
+      }
+      hbp = next;
+    }
+    if (chunks != NULL && !GC_put_ready_chunks(k, lg, chunks)) {
+      void **opp = (void **)op;
+
+      while (*opp != NULL) opp = &obj_link(*opp);
+      do {
+        ptr_t next = CHUNK_NEXT(chunks);
+
+        CHUNK_NEXT(chunks) = NULL;
+        *opp = chunks;
+        while (*opp != NULL) opp = &obj_link(*opp);
+        chunks = next;
+      } while (chunks != NULL);
+    }
+    return op;
+  }
+
+  GC_INNER void GC_mark_ready_chunks(void)
+  {
+    int k;
+    size_t lg;
+
+    for (k = 0; k <= NORMAL; k++) {
+      for (lg = 1; lg <= MAXOBJGRANULES; lg++) {
+        ptr_t chunk;
+
+        for (chunk = (ptr_t)GC_ready_chunks[k][lg].rc_head; chunk != NULL;
+             chunk = CHUNK_NEXT(chunk))
+          GC_set_fl_marks(chunk);
+      }
+    }
+  }
+#endif /* USE_READY_CHUNKS */
+
 /* Return a list of 1 or more objects of the indicated size, linked     */
 /* through the first word in the object.  This has the advantage that   */
 /* it acquires the allocation lock only once, and may greatly reduce    */
@@ -298,6 +465,28 @@ GC_API size_t GC_CALL GC_get_expl_freed_bytes_since_gc(void)
 /* invoked just as we were returning.                                   */
 /* Note that the client should usually clear the link field.            */
 GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
+{
+    GC_PROBE2(malloc_many_start, lb, k);
+    GC_generic_malloc_many_with_tail(lb, k, 0, result);
+    GC_PROBE2(malloc_many_done, lb, *result);
+    /* The first object of the refilled list is allocated by the caller */
+    /* usually right away.                                              */
+    GC_HEAP_PROF_SAMPLE(*result, lb);
+    GC_LIFETIME_SAMPLE(*result);
+}
+
+/* Store tail to the last word of each object of the list.  Called      */
+/* before the list is published, i.e. while the objects are protected   */
+/* from the collector either by the allocation lock or by the free      */
+/* list builder count.                                                  */
+STATIC void GC_set_list_tails(void *op, size_t lw, word tail)
+{
+    for (; op != NULL; op = obj_link(op))
+      ((word *)op)[lw - 1] = tail;
+}
+
+GC_INNER void GC_generic_malloc_many_with_tail(size_t lb, int k, word tail,
+                                               void **result)
 {
     void *op;
     void *p;
@@ -315,8 +504,11 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
     /* the last one) to support multiple objects allocation.        */
     if (!SMALL_OBJ(lb) || GC_manual_vdb) {
         op = GC_generic_malloc(lb, k);
-        if (EXPECT(0 != op, TRUE))
+        if (EXPECT(0 != op, TRUE)) {
             obj_link(op) = 0;
+            if (tail != 0)
+              ((word *)op)[BYTES_TO_WORDS(lb) - 1] = tail;
+        }
         *result = op;
 #       ifndef GC_DISABLE_INCREMENTAL
           if (GC_manual_vdb && GC_is_heap_ptr(result)) {
@@ -334,11 +526,19 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
     GC_INVOKE_FINALIZERS();
     GC_DBG_COLLECT_AT_MALLOC(lb);
     if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+#   ifdef USE_READY_CHUNKS
+      /* Skip the lock if no marking work is due.       */
+      if (READY_CHUNKS_KIND(k) && 0 == tail
+          && !(GC_incremental && !GC_dont_gc)
+          && GC_get_ready_chunk(k, lg, result))
+        return;
+#   endif
     LOCK();
-    /* Do our share of marking work */
+    /* Do our share of marking work, in proportion to the amount the    */
+    /* current thread has allocated by the previous refills.            */
       if (GC_incremental && !GC_dont_gc) {
         ENTER_GC();
-        GC_collect_a_little_inner(1);
+        GC_collect_a_little_or_notify(GC_take_mark_assist_units());
         EXIT_GC();
       }
     /* First see if we can reclaim a page of objects waiting to be */
@@ -347,12 +547,50 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
     if (rlh != NULL) {
         struct hblk * hbp;
         hdr * hhdr;
+#       ifdef USE_READY_CHUNKS
+          struct hblk *extra_blocks;
+#       endif
 
         while ((hbp = rlh[lg]) != NULL) {
             hhdr = HDR(hbp);
             rlh[lg] = hhdr -> hb_next;
             GC_ASSERT(hhdr -> hb_sz == lb);
             hhdr -> hb_last_reclaimed = (unsigned short) GC_gc_no;
+#           ifdef USE_READY_CHUNKS
+              extra_blocks = READY_CHUNKS_KIND(k) && 0 == tail
+                                ? GC_take_extra_blocks(rlh, k, lg) : NULL;
+#           endif
+#           ifdef THREAD_LOCAL_SWEEP
+              if (!GC_parallel) {
+                /* Claim the block and sweep it without the lock.       */
+                (void)AO_fetch_and_add1(&GC_sweep_claims);
+                UNLOCK();
+                op = GC_reclaim_generic(hbp, hhdr, lb, ok -> ok_init, 0,
+                                        &my_bytes_allocd);
+#               ifdef USE_READY_CHUNKS
+                  if (extra_blocks != NULL)
+                    op = GC_reclaim_extra_blocks(extra_blocks, lb, k, op,
+                                                 &my_bytes_allocd);
+#               endif
+                if (op != 0) {
+                  if (tail != 0) GC_set_list_tails(op, lw, tail);
+                  *result = op;
+                }
+                (void)AO_fetch_and_sub1_release(&GC_sweep_claims);
+                LOCK();
+                if (op != 0) {
+                  GC_bytes_found += my_bytes_allocd;
+                  GC_bytes_allocd += my_bytes_allocd;
+                  GC_add_mark_assist_debt((word)my_bytes_allocd);
+                  UNLOCK();
+                  (void)GC_clear_stack(0);
+                  return;
+                }
+                rlh = ok -> ok_reclaim_list; /* reload rlh after locking */
+                if (NULL == rlh) break;
+                continue;
+              }
+#           endif
 #           ifdef PARALLEL_MARK
               if (GC_parallel) {
                   signed_word my_bytes_allocd_tmp =
@@ -375,12 +613,19 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
 #           endif
             op = GC_reclaim_generic(hbp, hhdr, lb,
                                     ok -> ok_init, 0, &my_bytes_allocd);
+#           ifdef USE_READY_CHUNKS
+              if (extra_blocks != NULL)
+                op = GC_reclaim_extra_blocks(extra_blocks, lb, k, op,
+                                             &my_bytes_allocd);
+#           endif
             if (op != 0) {
 #             ifdef PARALLEL_MARK
                 if (GC_parallel) {
+                  if (tail != 0) GC_set_list_tails(op, lw, tail);
                   *result = op;
                   (void)AO_fetch_and_add(&GC_bytes_allocd_tmp,
                                          (AO_t)my_bytes_allocd);
+                  GC_add_mark_assist_debt((word)my_bytes_allocd);
                   GC_acquire_mark_lock();
                   -- GC_fl_builder_count;
                   if (GC_fl_builder_count == 0) GC_notify_all_builder();
@@ -402,6 +647,7 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
               /* that count.                                          */
               GC_bytes_found += my_bytes_allocd;
               GC_bytes_allocd += my_bytes_allocd;
+              GC_add_mark_assist_debt((word)my_bytes_allocd);
               goto out;
             }
 #           ifdef PARALLEL_MARK
@@ -424,6 +670,9 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
     /* Next try to use prefix of global free list if there is one.      */
     /* We don't refill it, but we need to use it up before allocating   */
     /* a new block ourselves.                                           */
+#     ifdef SHARDED_FREE_LISTS
+        GC_flush_fl_shard(k, lg);
+#     endif
       opp = &(GC_obj_kinds[k].ok_freelist[lg]);
       if ( (op = *opp) != 0 ) {
         *opp = 0;
@@ -437,6 +686,7 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
           }
         }
         GC_bytes_allocd += my_bytes_allocd;
+        GC_add_mark_assist_debt((word)my_bytes_allocd);
         goto out;
       }
     /* Next try to allocate a new block worth of objects of this size.  */
@@ -444,7 +694,9 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
         struct hblk *h = GC_allochblk(lb, k, 0);
         if (h /* != NULL */) { /* CPPCHECK */
           if (IS_UNCOLLECTABLE(k)) GC_set_hdr_marks(HDR(h));
-          GC_bytes_allocd += HBLKSIZE - HBLKSIZE % lb;
+          my_bytes_allocd = HBLKSIZE - HBLKSIZE % lb;
+          GC_bytes_allocd += my_bytes_allocd;
+          GC_add_mark_assist_debt((word)my_bytes_allocd);
 #         ifdef PARALLEL_MARK
             if (GC_parallel) {
               GC_acquire_mark_lock();
@@ -454,7 +706,7 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
 
               op = GC_build_fl(h, lw,
                         (ok -> ok_init || GC_debugging_started), 0);
-
+              if (tail != 0) GC_set_list_tails(op, lw, tail);
               *result = op;
               GC_acquire_mark_lock();
               -- GC_fl_builder_count;
@@ -463,6 +715,24 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
               (void) GC_clear_stack(0);
               return;
             }
+#         endif
+#         ifdef THREAD_LOCAL_SWEEP
+            /* In the incremental mode, the fresh block has just been   */
+            /* unprotected and marked dirty, so keep building its free  */
+            /* list under the lock, i.e. not racing with the marker     */
+            /* steps and the dirty bits re-reading done with the world  */
+            /* started.                                                 */
+            if (!GC_parallel && !GC_incremental) {
+              (void)AO_fetch_and_add1(&GC_sweep_claims);
+              UNLOCK();
+              op = GC_build_fl(h, lw,
+                        (ok -> ok_init || GC_debugging_started), 0);
+              if (tail != 0) GC_set_list_tails(op, lw, tail);
+              *result = op;
+              (void)AO_fetch_and_sub1_release(&GC_sweep_claims);
+              (void) GC_clear_stack(0);
+              return;
+            }
 #         endif
           op = GC_build_fl(h, lw, (ok -> ok_init || GC_debugging_started), 0);
           goto out;
@@ -475,6 +745,7 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
       if (0 != op) obj_link(op) = 0;
 
   out:
+    if (tail != 0) GC_set_list_tails(op, lw, tail);
     *result = op;
     UNLOCK();
     (void) GC_clear_stack(0);
@@ -497,25 +768,28 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc_many(size_t lb)
 #include <limits.h>
 
 /* Debug version is tricky and currently missing.       */
-GC_API GC_ATTR_MALLOC void * GC_CALL GC_memalign(size_t align, size_t lb)
+/* The common part of GC_memalign and friends, malloc_fn is the        */
+/* routine to allocate the (unaligned) object.                          */
+STATIC void *GC_memalign_with(size_t align, size_t lb,
+                              void * (GC_CALL *malloc_fn)(size_t))
 {
     size_t new_lb;
     size_t offset;
     ptr_t result;
 
-    if (align <= GRANULE_BYTES) return GC_malloc(lb);
+    if (align <= GRANULE_BYTES) return malloc_fn(lb);
     if (align >= HBLKSIZE/2 || lb >= HBLKSIZE/2) {
         if (EXPECT(align > HBLKSIZE, FALSE)) {
           return (*GC_get_oom_fn())(LONG_MAX-1024); /* Fail */
         }
-        return GC_malloc(lb <= HBLKSIZE? HBLKSIZE : lb);
+        return malloc_fn(lb <= HBLKSIZE? HBLKSIZE : lb);
             /* Will be HBLKSIZE aligned.        */
     }
     /* We could also try to make sure that the real rounded-up object size */
     /* is a multiple of align.  That would be correct up to HBLKSIZE.      */
     /* TODO: Not space efficient for big align values. */
     new_lb = SIZET_SAT_ADD(lb, align - 1);
-    result = (ptr_t)GC_malloc(new_lb);
+    result = (ptr_t)malloc_fn(new_lb);
             /* It is OK not to check result for NULL as in that case    */
             /* GC_memalign returns NULL too since (0 + 0 % align) is 0. */
     offset = (word)result % align;
@@ -532,6 +806,23 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_memalign(size_t align, size_t lb)
     return result;
 }
 
+GC_API GC_ATTR_MALLOC void * GC_CALL GC_memalign(size_t align, size_t lb)
+{
+    return GC_memalign_with(align, lb, GC_malloc);
+}
+
+GC_API GC_ATTR_MALLOC void * GC_CALL GC_memalign_atomic(size_t align,
+                                                        size_t lb)
+{
+    return GC_memalign_with(align, lb, GC_malloc_atomic);
+}
+
+GC_API GC_ATTR_MALLOC void * GC_CALL GC_memalign_uncollectable(size_t align,
+                                                               size_t lb)
+{
+    return GC_memalign_with(align, lb, GC_malloc_uncollectable);
+}
+
 /* This one exists largely to redirect posix_memalign for leaks finding. */
 GC_API int GC_CALL GC_posix_memalign(void **memptr, size_t align, size_t lb)
 {
@@ -652,3 +943,160 @@ GC_API void GC_CALL GC_ptr_store_and_dirty(void *p, const void *q)
   GC_dirty(p);
   REACHABLE_AFTER_DIRTY(q);
 }
+
+#ifndef GC_REGION_CHUNK_SIZE
+# define GC_REGION_CHUNK_SIZE (16 * HBLKSIZE)
+#endif
+
+/* The chunks of a region are uncollectable objects, the first granule  */
+/* of each holds the pointer to the previously allocated one.           */
+#define REGION_CHUNK_HDR_SZ GRANULE_BYTES
+
+struct GC_region_s {
+  ptr_t last_chunk;     /* the list of all the chunks of the region     */
+  ptr_t cur;            /* the free space of the current chunk          */
+  ptr_t limit;
+};
+
+GC_API GC_region GC_CALL GC_region_create(void)
+{
+  return (GC_region)GC_malloc_uncollectable(sizeof(struct GC_region_s));
+}
+
+/* Allocate a new chunk of the given size (including the header) for    */
+/* the region, and link it to the others.                               */
+static ptr_t new_region_chunk(GC_region r, size_t bytes)
+{
+  ptr_t chunk = (ptr_t)GC_malloc_uncollectable(bytes);
+
+  if (EXPECT(NULL == chunk, FALSE)) return NULL;
+  *(ptr_t *)chunk = r -> last_chunk;
+  r -> last_chunk = chunk;
+  return chunk;
+}
+
+GC_API GC_ATTR_MALLOC void * GC_CALL GC_region_malloc(GC_region r,
+                                                      size_t lb)
+{
+  size_t bytes = lb != 0 ? ROUNDUP_GRANULE_SIZE(lb) : GRANULE_BYTES;
+  ptr_t result = r -> cur;
+  ptr_t chunk;
+
+  if (EXPECT((word)(r -> limit - result) >= bytes, TRUE)) {
+    r -> cur = result + bytes;
+    return result;
+  }
+  if (bytes >= GC_REGION_CHUNK_SIZE / 4) {
+    /* Allocate a dedicated chunk, the current one is still used for    */
+    /* the smaller objects.                                             */
+    chunk = new_region_chunk(r, SIZET_SAT_ADD(bytes, REGION_CHUNK_HDR_SZ));
+    return chunk != NULL ? chunk + REGION_CHUNK_HDR_SZ : NULL;
+  }
+  chunk = new_region_chunk(r, GC_REGION_CHUNK_SIZE);
+  if (EXPECT(NULL == chunk, FALSE)) return NULL;
+  result = chunk + REGION_CHUNK_HDR_SZ;
+  r -> cur = result + bytes;
+  r -> limit = chunk + GC_REGION_CHUNK_SIZE;
+  return result;
+}
+
+GC_API void GC_CALL GC_region_destroy(GC_region r)
+{
+  ptr_t chunk;
+  DCL_LOCK_STATE;
+
+  if (NULL == r) return;
+  LOCK();
+  /* Each chunk is a large object, so its blocks are returned to the    */
+  /* free lists of heap blocks right away.                              */
+  for (chunk = r -> last_chunk; chunk != NULL; ) {
+    void *p = chunk;
+
+    chunk = *(ptr_t *)chunk;
+    GC_free_n_inner(&p, 1);
+  }
+  GC_free_n_inner((void **)&r, 1);
+  UNLOCK();
+}
+
+struct GC_pool_s {
+  ptr_t free_list;      /* the free objects of the pool linked through  */
+                        /* their first word; reachable from the pool,   */
+                        /* thus kept across the collections             */
+  size_t gran;          /* the object size in granules                  */
+};
+
+GC_API GC_pool GC_CALL GC_pool_create(size_t lb)
+{
+  GC_pool pool;
+
+  if (!SMALL_OBJ(lb)) return NULL;
+  pool = (GC_pool)GC_malloc_uncollectable(sizeof(struct GC_pool_s));
+  if (EXPECT(pool != NULL, TRUE))
+    pool -> gran = ROUNDED_UP_GRANULES(lb);
+  return pool;
+}
+
+/* Allocate a new heap block for the pool, and put all its objects to   */
+/* the free list of the pool.  Returns FALSE if out of memory.          */
+static GC_bool pool_refill(GC_pool pool)
+{
+  size_t gran = pool -> gran;
+  struct hblk *h;
+  GC_bool retry = FALSE;
+  DCL_LOCK_STATE;
+
+  LOCK();
+  if (GC_incremental && !GC_dont_gc) {
+    ENTER_GC();
+    GC_collect_a_little_or_notify(1);
+    EXIT_GC();
+  }
+  h = GC_allochblk(GRANULES_TO_BYTES(gran), NORMAL, 0);
+  while (NULL == h && GC_collect_or_expand(1, FALSE, retry)) {
+    h = GC_allochblk(GRANULES_TO_BYTES(gran), NORMAL, 0);
+    retry = TRUE;
+  }
+  if (h != NULL) {
+    /* The whole block is counted as allocated right away, as in case  */
+    /* of GC_malloc_many.                                               */
+    GC_bytes_allocd += HBLKSIZE - HBLKSIZE % GRANULES_TO_BYTES(gran);
+    pool -> free_list = GC_build_fl(h, GRANULES_TO_WORDS(gran), TRUE,
+                                    pool -> free_list);
+    GC_dirty(pool);
+  }
+  UNLOCK();
+  return h != NULL;
+}
+
+GC_API GC_ATTR_MALLOC void * GC_CALL GC_pool_malloc(GC_pool pool)
+{
+  ptr_t p = pool -> free_list;
+
+  if (EXPECT(NULL == p, FALSE)) {
+    if (!pool_refill(pool))
+      return (*GC_get_oom_fn())(GRANULES_TO_BYTES(pool -> gran));
+    p = pool -> free_list;
+  }
+  pool -> free_list = (ptr_t)obj_link(p);
+  obj_link(p) = NULL;
+  return p;
+}
+
+GC_API void GC_CALL GC_pool_free(GC_pool pool, void *p)
+{
+  if (NULL == p) return;
+  GC_ASSERT(GC_size(p) == GRANULES_TO_BYTES(pool -> gran));
+  BZERO(p, GRANULES_TO_BYTES(pool -> gran));
+  obj_link(p) = pool -> free_list;
+  GC_dirty(p);
+  pool -> free_list = (ptr_t)p;
+  GC_dirty(pool);
+}
+
+GC_API void GC_CALL GC_pool_destroy(GC_pool pool)
+{
+  /* The free objects become unreachable, and are reclaimed by the next */
+  /* collection.                                                        */
+  GC_free(pool);
+}
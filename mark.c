@@ -17,6 +17,14 @@
 
 #include "private/gc_pmark.h"
 
+#ifdef SIMD_PTR_FILTER
+# ifdef X86_64
+#   include <immintrin.h>
+# else
+#   include <arm_neon.h>
+# endif
+#endif
+
 /* Make arguments appear live to compiler.  Put here to minimize the    */
 /* risk of inlining.  Used to minimize junk left in registers.          */
 GC_ATTR_NOINLINE
@@ -60,20 +68,22 @@ GC_API void GC_CALL GC_noop1(GC_word x)
 /* It's done here, since we need to deal with mark descriptors.         */
 GC_INNER struct obj_kind GC_obj_kinds[MAXOBJKINDS] = {
 /* PTRFREE */ { &GC_aobjfreelist[0], 0 /* filled in dynamically */,
-                /* 0 | */ GC_DS_LENGTH, FALSE, FALSE
+                /* 0 | */ GC_DS_LENGTH, FALSE, FALSE, FALSE
                 /*, */ OK_DISCLAIM_INITZ },
 /* NORMAL */  { &GC_objfreelist[0], 0,
                 /* 0 | */ GC_DS_LENGTH,
                                 /* adjusted in GC_init for EXTRA_BYTES  */
-                TRUE /* add length to descr */, TRUE
+                TRUE /* add length to descr */, TRUE, FALSE
                 /*, */ OK_DISCLAIM_INITZ },
 /* UNCOLLECTABLE */
               { &GC_uobjfreelist[0], 0,
-                /* 0 | */ GC_DS_LENGTH, TRUE /* add length to descr */, TRUE
+                /* 0 | */ GC_DS_LENGTH, TRUE /* add length to descr */, TRUE,
+                FALSE
                 /*, */ OK_DISCLAIM_INITZ },
 # ifdef GC_ATOMIC_UNCOLLECTABLE
               { &GC_auobjfreelist[0], 0,
-                /* 0 | */ GC_DS_LENGTH, FALSE /* add length to descr */, FALSE
+                /* 0 | */ GC_DS_LENGTH, FALSE /* add length to descr */, FALSE,
+                FALSE
                 /*, */ OK_DISCLAIM_INITZ },
 # endif
 };
@@ -99,6 +109,16 @@ GC_INNER struct obj_kind GC_obj_kinds[MAXOBJKINDS] = {
   GC_INNER GC_bool GC_parallel_mark_disabled = FALSE;
 #endif
 
+/* After a mark stack overflow, the blocks pointed to by the dropped    */
+/* entries are flagged (hb_rescan), so it is enough to push again the   */
+/* marked objects of the flagged blocks only.  That is not so if some   */
+/* entry could not be attributed to a block, or the marker state was    */
+/* invalidated otherwise; then all the marked objects are pushed.       */
+STATIC GC_bool GC_rescan_all_marked = FALSE;
+STATIC GC_bool GC_rescan_flagged_only = FALSE;
+                                /* The mode of the current heap scan    */
+                                /* in the MS_[PARTIALLY_]INVALID state. */
+
 /* Is a collection in progress?  Note that this can return true in the  */
 /* non-incremental case, if a collection has been abandoned and the     */
 /* mark state is now MS_INVALID.                                        */
@@ -107,8 +127,10 @@ GC_INNER GC_bool GC_collection_in_progress(void)
     return GC_mark_state != MS_NONE;
 }
 
-/* Clear all mark bits in the header.   */
-GC_INNER void GC_clear_hdr_marks(hdr *hhdr)
+GC_INNER word GC_mark_epoch = 0;
+
+/* Clear the mark bits in the header without touching its epoch.      */
+static void clear_hdr_mark_bits(hdr *hhdr)
 {
   size_t last_bit;
 
@@ -120,11 +142,18 @@ GC_INNER void GC_clear_hdr_marks(hdr *hhdr)
     last_bit = FINAL_MARK_BIT((size_t)hhdr->hb_sz);
 # endif
 
-    BZERO(hhdr -> hb_marks, sizeof(hhdr->hb_marks));
+    BZERO(HDR_MARKS(hhdr), sizeof(hhdr->hb_marks));
     set_mark_bit_from_hdr(hhdr, last_bit);
     hhdr -> hb_n_marks = 0;
 }
 
+/* Clear all mark bits in the header.   */
+GC_INNER void GC_clear_hdr_marks(hdr *hhdr)
+{
+    clear_hdr_mark_bits(hhdr);
+    hhdr -> hb_mark_epoch = GC_mark_epoch;
+}
+
 /* Set all mark bits in the header.  Used for uncollectible blocks. */
 GC_INNER void GC_set_hdr_marks(hdr *hhdr)
 {
@@ -134,36 +163,60 @@ GC_INNER void GC_set_hdr_marks(hdr *hhdr)
 
 #   ifdef USE_MARK_BYTES
       for (i = 0; i <= n_marks; i += (unsigned)MARK_BIT_OFFSET(sz)) {
-        hhdr -> hb_marks[i] = 1;
+        HDR_MARKS(hhdr)[i] = 1;
       }
 #   else
       /* Note that all bits are set even in case of MARK_BIT_PER_GRANULE,   */
       /* instead of setting every n-th bit where n is MARK_BIT_OFFSET(sz).  */
       /* This is done for a performance reason.                             */
       for (i = 0; i < divWORDSZ(n_marks); ++i) {
-        hhdr -> hb_marks[i] = GC_WORD_MAX;
+        HDR_MARKS(hhdr)[i] = GC_WORD_MAX;
       }
       /* Set the remaining bits near the end (plus one bit past the end).   */
-      hhdr -> hb_marks[i] = ((((word)1 << modWORDSZ(n_marks)) - 1) << 1) | 1;
+      HDR_MARKS(hhdr)[i] = ((((word)1 << modWORDSZ(n_marks)) - 1) << 1) | 1;
 #   endif
 #   ifdef MARK_BIT_PER_OBJ
       hhdr -> hb_n_marks = n_marks;
 #   else
       hhdr -> hb_n_marks = HBLK_OBJS(sz);
 #   endif
+    hhdr -> hb_mark_epoch = GC_mark_epoch;
 }
 
-/* Clear all mark bits associated with block h. */
-static void GC_CALLBACK clear_marks_for_block(struct hblk *h, GC_word dummy)
+#ifdef PARALLEL_MARK
+  /* The epoch value of a header being refreshed by a marker.   */
+# define MARK_EPOCH_BUSY GC_WORD_MAX
+#endif
+
+GC_INNER void GC_refresh_hdr_marks(hdr *hhdr)
 {
-    hdr * hhdr = HDR(h);
+    word epoch = GC_mark_epoch;
 
-    UNUSED_ARG(dummy);
-    if (IS_UNCOLLECTABLE(hhdr -> hb_obj_kind)) return;
-        /* Mark bit for these is cleared only once the object is        */
-        /* explicitly deallocated.  This either frees the block, or     */
-        /* the bit is cleared once the object is on the free list.      */
-    GC_clear_hdr_marks(hhdr);
+#   ifdef PARALLEL_MARK
+      /* Claim the header as another marker might be refreshing it.     */
+      for (;;) {
+        word cur = GC_HDR_MARK_EPOCH(hhdr);
+
+        if (cur == epoch) return; /* done by another marker */
+        if (cur != MARK_EPOCH_BUSY
+            && AO_compare_and_swap((volatile AO_t *)&hhdr->hb_mark_epoch,
+                                   (AO_t)cur, (AO_t)MARK_EPOCH_BUSY))
+          break;
+        /* Just spin, clearing the bits does not take long.       */
+      }
+#   endif
+    /* Mark bit for uncollectible objects is cleared only once the      */
+    /* object is explicitly deallocated.  This either frees the block,  */
+    /* or the bit is cleared once the object is on the free list.  The  */
+    /* frozen blocks are never swept, thus their bits are kept as well. */
+    if (!IS_UNCOLLECTABLE(hhdr -> hb_obj_kind)
+        && (hhdr -> hb_flags & FROZEN_BLK) == 0)
+      clear_hdr_mark_bits(hhdr);
+#   ifdef PARALLEL_MARK
+      AO_store_release((volatile AO_t *)&hhdr->hb_mark_epoch, (AO_t)epoch);
+#   else
+      hhdr -> hb_mark_epoch = epoch;
+#   endif
 }
 
 /* Slow but general routines for setting/clearing/asking about mark bits. */
@@ -173,6 +226,7 @@ GC_API void GC_CALL GC_set_mark_bit(const void *p)
     hdr * hhdr = HDR(h);
     word bit_no = MARK_BIT_NO((ptr_t)p - (ptr_t)h, hhdr -> hb_sz);
 
+    VALIDATE_MARKS(hhdr);
     if (!mark_bit_from_hdr(hhdr, bit_no)) {
       set_mark_bit_from_hdr(hhdr, bit_no);
       ++hhdr -> hb_n_marks;
@@ -185,6 +239,7 @@ GC_API void GC_CALL GC_clear_mark_bit(const void *p)
     hdr * hhdr = HDR(h);
     word bit_no = MARK_BIT_NO((ptr_t)p - (ptr_t)h, hhdr -> hb_sz);
 
+    VALIDATE_MARKS(hhdr);
     if (mark_bit_from_hdr(hhdr, bit_no)) {
       size_t n_marks = hhdr -> hb_n_marks;
 
@@ -209,6 +264,7 @@ GC_API int GC_CALL GC_is_marked(const void *p)
     hdr * hhdr = HDR(h);
     word bit_no = MARK_BIT_NO((ptr_t)p - (ptr_t)h, hhdr -> hb_sz);
 
+    VALIDATE_MARKS(hhdr);
     return (int)mark_bit_from_hdr(hhdr, bit_no); /* 0 or 1 */
 }
 
@@ -218,10 +274,15 @@ GC_API int GC_CALL GC_is_marked(const void *p)
 GC_INNER void GC_clear_marks(void)
 {
     GC_ASSERT(GC_is_initialized); /* needed for GC_push_roots */
-    GC_apply_to_all_blocks(clear_marks_for_block, (word)0);
+    GC_finish_start_reclaim();
+    /* Rather than clearing the mark bits of all the heap blocks, just  */
+    /* make them stale (see VALIDATE_MARKS).                            */
+    GC_mark_epoch++;
     GC_objects_are_marked = FALSE;
     GC_mark_state = MS_INVALID;
     GC_scan_ptr = NULL;
+    GC_rescan_all_marked = FALSE; /* nothing is marked yet */
+    GC_rescan_flagged_only = FALSE;
 }
 
 /* Initiate a garbage collection.  Initiates a full collection if the   */
@@ -230,13 +291,22 @@ GC_INNER void GC_initiate_gc(void)
 {
     GC_ASSERT(I_HOLD_LOCK());
     GC_ASSERT(GC_is_initialized);
+    GC_finish_start_reclaim();
 #   ifndef GC_DISABLE_INCREMENTAL
         if (GC_incremental) {
 #         ifdef CHECKSUMS
             GC_read_dirty(FALSE);
             GC_check_dirty();
+#         elif defined(FROZEN_ROOTS)
+            /* The dirty bits of frozen roots are needed even for a     */
+            /* full collection.                                         */
+            GC_read_dirty(GC_mark_state == MS_INVALID
+                          && 0 == GC_n_frozen_roots);
 #         else
             GC_read_dirty(GC_mark_state == MS_INVALID);
+#         endif
+#         ifdef FROZEN_ROOTS
+            GC_note_frozen_roots_dirty();
 #         endif
         }
         GC_n_rescuing_pages = 0;
@@ -248,6 +318,7 @@ GC_INNER void GC_initiate_gc(void)
         /* This is really a full collection, and mark bits are invalid. */
     }
     GC_scan_ptr = NULL;
+    GC_rescan_flagged_only = FALSE;
 }
 
 #ifdef PARALLEL_MARK
@@ -272,7 +343,19 @@ static void push_roots_and_advance(GC_bool push_all, ptr_t cold_gc_frame)
 {
   if (GC_scan_ptr != NULL) return; /* not ready to push */
 
-  GC_push_roots(push_all, cold_gc_frame);
+# ifndef NO_CLOCK
+    if (GC_measure_performance) {
+      CLOCK_TYPE start_time, done_time;
+
+      GET_TIME(start_time);
+      GC_push_roots(push_all, cold_gc_frame);
+      GET_TIME(done_time);
+      GC_root_scan_ns += NS_TIME_DIFF(done_time, start_time);
+    } else
+# endif
+  /* else */ {
+    GC_push_roots(push_all, cold_gc_frame);
+  }
   GC_objects_are_marked = TRUE;
   if (GC_mark_state != MS_INVALID)
     GC_mark_state = MS_ROOTS_PUSHED;
@@ -396,6 +479,8 @@ static void push_roots_and_advance(GC_bool push_all, ptr_t cold_gc_frame)
                 if (GC_mark_stack_too_small) {
                     alloc_mark_stack(2*GC_mark_stack_size);
                 }
+                GC_rescan_flagged_only = !GC_rescan_all_marked;
+                GC_rescan_all_marked = FALSE;
                 GC_mark_state = MS_PARTIALLY_INVALID;
             }
             GC_scan_ptr = GC_push_next_marked(GC_scan_ptr);
@@ -507,12 +592,51 @@ static void push_roots_and_advance(GC_bool push_all, ptr_t cold_gc_frame)
 
 GC_INNER void GC_invalidate_mark_state(void)
 {
+    GC_rescan_all_marked = TRUE;
     GC_mark_state = MS_INVALID;
     GC_mark_stack_top = GC_mark_stack-1;
 }
 
+/* Flag the blocks of the objects pointed to by the mark stack entries  */
+/* from low to high (inclusive) which are about to be dropped.          */
+/* Could be called by a parallel marker without the allocation lock.    */
+STATIC void GC_flag_dropped_entries(mse *low, mse *high)
+{
+    /* Note: if the overflow happens while pushing the uncollectable or */
+    /* dirty blocks, the rest of them is covered by continuing the heap */
+    /* scan in the MS_INVALID state (which is never restricted to the   */
+    /* flagged blocks), and the roots are pushed at the end of the scan. */
+    for (; (word)low <= (word)high; low++) {
+      struct hblk *h = HBLKPTR(low -> mse_start);
+      hdr *hhdr = HDR(h);
+      word displ;
+
+      while (IS_FORWARDING_ADDR_OR_NIL(hhdr) && hhdr != NULL) {
+        h = FORWARDED_ADDR(h, hhdr);
+        hhdr = HDR(h);
+      }
+      if (NULL == hhdr || HBLK_IS_FREE(hhdr)) {
+        /* Not a heap object, e.g. a root or a range pushed by a    */
+        /* client mark procedure.                                   */
+        GC_rescan_all_marked = TRUE;
+        return;
+      }
+      /* Rescanning the block pushes only the marked objects again, */
+      /* but a mark procedure may push a part of an unmarked one.   */
+      displ = (word)(low -> mse_start - (ptr_t)h);
+      VALIDATE_MARKS(hhdr);
+      if (!mark_bit_from_hdr(hhdr, MARK_BIT_NO(displ - displ % hhdr -> hb_sz,
+                                                hhdr -> hb_sz))) {
+        GC_rescan_all_marked = TRUE;
+        return;
+      }
+      hhdr -> hb_rescan = TRUE; /* the concurrent stores are benign */
+    }
+}
+
 GC_INNER mse * GC_signal_mark_stack_overflow(mse *msp)
 {
+    GC_flag_dropped_entries(msp - GC_MARK_STACK_DISCARDS, msp - 1);
     GC_mark_state = MS_INVALID;
 #   ifdef PARALLEL_MARK
       /* We are using a local_mark_stack in parallel mode, so   */
@@ -542,9 +666,138 @@ GC_INNER mse * GC_signal_mark_stack_overflow(mse *msp)
  * encoding, we optionally maintain a cache for the block address to
  * header mapping, we prefetch when an object is "grayed", etc.
  */
+#ifdef SIMD_PTR_FILTER
+  /* A pointer filter returns the mask of plausible pointers among      */
+  /* CPP_WORDSZ words starting at p: bit i is set if p[i] - least_ha is */
+  /* less than span (as unsigned values).  The caller examines only the */
+  /* words reported by the filter, so the pointer-sparse ranges are     */
+  /* skipped several words at a time.                                   */
+  typedef word (*GC_ptr_filter_proc)(const word *p, word least_ha,
+                                     word span);
+
+# ifdef X86_64
+    GC_ATTR_NO_SANITIZE_ADDR GC_ATTR_NO_SANITIZE_MEMORY
+    GC_ATTR_NO_SANITIZE_THREAD __attribute__((__target__("avx2")))
+    STATIC word GC_ptr_filter_avx2(const word *p, word least_ha, word span)
+    {
+      /* The unsigned comparison is done as a signed one of the values  */
+      /* with the flipped sign bit.                                     */
+      const __m256i sign = _mm256_set1_epi64x((long long)SIGNB);
+      const __m256i lo = _mm256_set1_epi64x((long long)least_ha);
+      const __m256i span_v = _mm256_set1_epi64x((long long)(span ^ SIGNB));
+      word mask = 0;
+      unsigned i;
+
+      for (i = 0; i < CPP_WORDSZ; i += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+        __m256i hit = _mm256_cmpgt_epi64(span_v,
+                            _mm256_xor_si256(_mm256_sub_epi64(v, lo), sign));
+
+        mask |= (word)(unsigned)_mm256_movemask_pd(
+                                        _mm256_castsi256_pd(hit)) << i;
+      }
+      return mask;
+    }
+# else
+    GC_ATTR_NO_SANITIZE_ADDR GC_ATTR_NO_SANITIZE_MEMORY
+    GC_ATTR_NO_SANITIZE_THREAD
+    STATIC word GC_ptr_filter_neon(const word *p, word least_ha, word span)
+    {
+      const uint64x2_t lo = vdupq_n_u64((uint64_t)least_ha);
+      const uint64x2_t span_v = vdupq_n_u64((uint64_t)span);
+      word mask = 0;
+      unsigned i;
+
+      for (i = 0; i < CPP_WORDSZ; i += 2) {
+        uint64x2_t hit = vcltq_u64(vsubq_u64(
+                                vld1q_u64((const uint64_t *)(p + i)), lo),
+                                   span_v);
+
+        mask |= (word)((vgetq_lane_u64(hit, 0) & 1)
+                       | (vgetq_lane_u64(hit, 1) & 2)) << i;
+      }
+      return mask;
+    }
+# endif /* !X86_64 */
+
+  STATIC GC_ptr_filter_proc GC_ptr_filter = 0;
+                        /* NULL if the vector instructions are not      */
+                        /* supported by the processor (or disabled).    */
+
+  GC_INNER void GC_init_ptr_filter(void)
+  {
+#   ifdef X86_64
+#     if !defined(__clang__) || GC_CLANG_PREREQ(6, 0)
+        /* GC_init might be called from a constructor.  */
+        __builtin_cpu_init();
+#     endif
+      if (__builtin_cpu_supports("avx2"))
+        GC_ptr_filter = GC_ptr_filter_avx2;
+#   else
+      GC_ptr_filter = GC_ptr_filter_neon;
+#   endif
+    if (0 != GETENV("GC_NO_SIMD_PTR_FILTER"))
+      GC_ptr_filter = 0;
+  }
+
+# define GC_ctz_word(m) __builtin_ctzll((unsigned long long)(m))
+#endif /* SIMD_PTR_FILTER */
+
+#ifdef MARK_PREFETCH_FIFO
+  /* The candidate pointers found by GC_mark_from are not marked at     */
+  /* once but are put to a small ring buffer (FIFO): a pointer and the  */
+  /* bottom index entry containing its header are prefetched when the   */
+  /* pointer enters the buffer, and the pointer is marked (i.e. its     */
+  /* header and mark bit are examined) only when it is evicted by       */
+  /* MARK_PREFETCH_FIFO_SIZE later candidates.  Thus the cache misses   */
+  /* on the object and its header are overlapped with the scanning.     */
+# ifndef MARK_PREFETCH_FIFO_SIZE
+#   define MARK_PREFETCH_FIFO_SIZE 8 /* must be a power of 2 */
+# endif
+# ifdef FLAT_HDR_TABLE
+#   define PREFETCH_HDR_SLOT(p) \
+      do { \
+        word ofs = (word)(p) - GC_arena_start; \
+        \
+        if (EXPECT(ofs < GC_arena_size, TRUE)) \
+          PREFETCH(&GC_flat_hdrs[ofs >> LOG_HBLKSIZE]); \
+      } while (0)
+# elif defined(HASH_TL)
+    /* Only the first bottom index of the hash chain is checked.        */
+#   define PREFETCH_HDR_SLOT(p) \
+      do { \
+        word hi = (word)(p) >> (LOG_BOTTOM_SZ + LOG_HBLKSIZE); \
+        bottom_index *bi = GC_top_index[TL_HASH(hi)]; \
+        \
+        if (EXPECT(bi -> key == hi, TRUE)) \
+          PREFETCH(&HDR_FROM_BI(bi, p)); \
+      } while (0)
+# else
+#   define PREFETCH_HDR_SLOT(p) PREFETCH(&HDR_INNER(p))
+# endif
+
+# define FIFO_PUSH_CONTENTS(p, src, mark_stack_top, mark_stack_limit) \
+    do { \
+      unsigned fifo_i = fifo_pos++ & (MARK_PREFETCH_FIFO_SIZE - 1); \
+      ptr_t evicted = fifo_ptrs[fifo_i]; \
+      ptr_t evicted_src = fifo_srcs[fifo_i]; \
+      \
+      PREFETCH(p); \
+      PREFETCH_HDR_SLOT(p); \
+      fifo_ptrs[fifo_i] = (p); \
+      fifo_srcs[fifo_i] = (src); \
+      if (evicted != NULL) \
+        PUSH_CONTENTS(evicted, mark_stack_top, mark_stack_limit, \
+                      evicted_src); \
+    } while (0)
+#endif /* MARK_PREFETCH_FIFO */
+
+/* Same as GC_mark_from but using the given header cache (which is not */
+/* required to be empty).                                               */
 GC_ATTR_NO_SANITIZE_ADDR GC_ATTR_NO_SANITIZE_MEMORY GC_ATTR_NO_SANITIZE_THREAD
-GC_INNER mse * GC_mark_from(mse *mark_stack_top, mse *mark_stack,
-                            mse *mark_stack_limit)
+STATIC mse * GC_mark_from_cached(mse *mark_stack_top, mse *mark_stack,
+                                 mse *mark_stack_limit,
+                                 hdr_cache_t *hdr_cache)
 {
   signed_word credit = HBLKSIZE;  /* Remaining credit for marking work. */
   ptr_t current_p;      /* Pointer to current candidate ptr.            */
@@ -553,12 +806,25 @@ GC_INNER mse * GC_mark_from(mse *mark_stack_top, mse *mark_stack,
   word descr;
   ptr_t greatest_ha = (ptr_t)GC_greatest_plausible_heap_addr;
   ptr_t least_ha = (ptr_t)GC_least_plausible_heap_addr;
-  DECLARE_HDR_CACHE;
+# ifdef MARK_PREFETCH_FIFO
+    ptr_t fifo_ptrs[MARK_PREFETCH_FIFO_SIZE];
+    ptr_t fifo_srcs[MARK_PREFETCH_FIFO_SIZE];
+    unsigned fifo_pos = 0;
+# endif
 
 # define SPLIT_RANGE_WORDS 128  /* Must be power of 2.          */
+# ifdef PARALLEL_MARK
+#   ifndef EAGER_SPLIT_BYTES
+#     define EAGER_SPLIT_BYTES (64 * 1024)
+#   endif
+#   define EAGER_SPLIT_ENTRIES 16
+# endif
 
   GC_objects_are_marked = TRUE;
-  INIT_HDR_CACHE;
+# ifdef MARK_PREFETCH_FIFO
+    BZERO(fifo_ptrs, sizeof(fifo_ptrs));
+    BZERO(fifo_srcs, sizeof(fifo_srcs));
+# endif
 # ifdef OS2 /* Use untweaked version to circumvent compiler problem.    */
     while ((word)mark_stack_top >= (word)mark_stack && credit >= 0)
 # else
@@ -590,6 +856,27 @@ GC_INNER mse * GC_mark_from(mse *mark_stack_top, mse *mark_stack,
                 || (word)current_p >= (word)GC_greatest_plausible_heap_addr);
 #         ifdef PARALLEL_MARK
 #           define SHARE_BYTES 2048
+            if (descr >= EAGER_SPLIT_BYTES && GC_parallel
+                && (word)mark_stack_top
+                    < (word)(mark_stack_limit - EAGER_SPLIT_ENTRIES)) {
+              /* Fan out a huge range at once (rather than halving it   */
+              /* repeatedly), so that the other markers could take the  */
+              /* pieces as soon as possible.  The pieces are split      */
+              /* further (if still large) by the marker popping them.   */
+              word chunk = (descr / EAGER_SPLIT_ENTRIES)
+                            & ~(word)(sizeof(word)-1);
+              int i;
+
+              for (i = 0; i < EAGER_SPLIT_ENTRIES - 1; i++) {
+                mark_stack_top -> mse_start = current_p;
+                mark_stack_top -> mse_descr.w = chunk + sizeof(word);
+                                        /* Handle misaligned pointers.  */
+                mark_stack_top++;
+                current_p += chunk;
+              }
+              descr -= chunk * (EAGER_SPLIT_ENTRIES - 1);
+              goto retry;
+            }
             if (descr > SHARE_BYTES && GC_parallel
                 && (word)mark_stack_top < (word)(mark_stack_limit - 1)) {
               word new_size = (descr/2) & ~(word)(sizeof(word)-1);
@@ -649,7 +936,6 @@ GC_INNER mse * GC_mark_from(mse *mark_stack_top, mse *mark_stack,
             LOAD_WORD_OR_CONTINUE(current, current_p);
             FIXUP_POINTER(current);
             if (current >= (word)least_ha && current < (word)greatest_ha) {
-                PREFETCH((ptr_t)current);
 #               ifdef ENABLE_TRACE
                   if (GC_trace_addr == current_p) {
                     GC_log_printf("GC #%lu: considering(3) %p -> %p\n",
@@ -657,8 +943,14 @@ GC_INNER mse * GC_mark_from(mse *mark_stack_top, mse *mark_stack,
                                   (void *)current);
                   }
 #               endif /* ENABLE_TRACE */
-                PUSH_CONTENTS((ptr_t)current, mark_stack_top,
-                              mark_stack_limit, current_p);
+#               ifdef MARK_PREFETCH_FIFO
+                  FIFO_PUSH_CONTENTS((ptr_t)current, current_p,
+                                     mark_stack_top, mark_stack_limit);
+#               else
+                  PREFETCH((ptr_t)current);
+                  PUSH_CONTENTS((ptr_t)current, mark_stack_top,
+                                mark_stack_limit, current_p);
+#               endif
             }
           }
           continue;
@@ -696,9 +988,30 @@ GC_INNER mse * GC_mark_from(mse *mark_stack_top, mse *mark_stack,
                 mark_stack_top--;
                 continue;
             }
-            descr = *(word *)(type_descr
-                              - ((signed_word)descr + (GC_INDIR_PER_OBJ_BIAS
-                                                       - GC_DS_PER_OBJECT)));
+#           ifdef INCREMENTAL_GCJ_TLFL
+              if (EXPECT(GC_incremental, FALSE)) {
+                /* The free object might be allocated from a thread-    */
+                /* local free list concurrently (the world is running), */
+                /* and the next one (which type_descr would point to)   */
+                /* might be allocated and filled in before we load the  */
+                /* descriptor.  GC_gcj_malloc stores the "vtable"       */
+                /* pointer followed by a write barrier, thus if the     */
+                /* first word is unchanged after the descriptor load,   */
+                /* then the latter is not affected by such a race.      */
+                /* Otherwise, retry with the new "vtable" pointer.      */
+                descr = AO_load_acquire((volatile AO_t *)(type_descr
+                                - ((signed_word)descr + (GC_INDIR_PER_OBJ_BIAS
+                                                         - GC_DS_PER_OBJECT))));
+                if (EXPECT(*(volatile ptr_t *)current_p != type_descr,
+                           FALSE))
+                  continue;
+              } else
+#           endif
+            /* else */ {
+              descr = *(word *)(type_descr
+                                - ((signed_word)descr + (GC_INDIR_PER_OBJ_BIAS
+                                                         - GC_DS_PER_OBJECT)));
+            }
           }
           if (0 == descr) {
               /* Can happen either because we generated a 0 descriptor  */
@@ -732,9 +1045,51 @@ GC_INNER mse * GC_mark_from(mse *mark_stack_top, mse *mark_stack,
     {
 #     define PREF_DIST 4
 
-#     if !defined(SMALL_CONFIG) && !defined(USE_PTR_HWTAG)
+#     if !defined(SMALL_CONFIG) && !defined(USE_PTR_HWTAG) \
+         && !defined(MARK_PREFETCH_FIFO)
         word deferred;
+#     endif
 
+      /* Skip the pointer-sparse (e.g. numeric) words of the range      */
+      /* quickly, the rest (less than CPP_WORDSZ words) is handled by   */
+      /* the loops below.                                               */
+#     ifdef SIMD_PTR_FILTER
+        if (GC_ptr_filter != 0) {
+          word span = (word)greatest_ha - (word)least_ha;
+
+          for (; (word)current_p + WORDS_TO_BYTES(CPP_WORDSZ - 1)
+                    <= (word)limit;
+               current_p += WORDS_TO_BYTES(CPP_WORDSZ)) {
+            word m = GC_ptr_filter((word *)current_p, (word)least_ha, span);
+
+            for (; m != 0; m &= m - 1) {
+              ptr_t q = current_p + WORDS_TO_BYTES(GC_ctz_word(m));
+
+              current = *(word *)q;
+#             ifdef ENABLE_TRACE
+                if (GC_trace_addr == q) {
+                  GC_log_printf("GC #%lu: considering(4) %p -> %p\n",
+                                (unsigned long)GC_gc_no, (void *)q,
+                                (void *)current);
+                }
+#             endif /* ENABLE_TRACE */
+#             ifdef MARK_PREFETCH_FIFO
+                FIFO_PUSH_CONTENTS((ptr_t)current, q,
+                                   mark_stack_top, mark_stack_limit);
+#             else
+                PREFETCH((ptr_t)current);
+                PUSH_CONTENTS((ptr_t)current, mark_stack_top,
+                              mark_stack_limit, q);
+#             endif
+            }
+          }
+        }
+#     endif /* SIMD_PTR_FILTER */
+#     if !defined(SMALL_CONFIG) && !defined(USE_PTR_HWTAG) \
+         && !defined(MARK_PREFETCH_FIFO)
+#       ifdef SIMD_PTR_FILTER
+          if ((word)current_p > (word)limit) goto next_object;
+#       endif
         /* Try to prefetch the next pointer to be examined ASAP.        */
         /* Empirically, this also seems to help slightly without        */
         /* prefetches, at least on linux/x86.  Presumably this loop     */
@@ -773,9 +1128,6 @@ GC_INNER mse * GC_mark_from(mse *mark_stack_top, mse *mark_stack,
         FIXUP_POINTER(current);
         PREFETCH(current_p + PREF_DIST*CACHE_LINE_SIZE);
         if (current >= (word)least_ha && current < (word)greatest_ha) {
-          /* Prefetch the contents of the object we just pushed.  It's  */
-          /* likely we will need them soon.                             */
-          PREFETCH((ptr_t)current);
 #         ifdef ENABLE_TRACE
             if (GC_trace_addr == current_p) {
               GC_log_printf("GC #%lu: considering(1) %p -> %p\n",
@@ -783,12 +1135,21 @@ GC_INNER mse * GC_mark_from(mse *mark_stack_top, mse *mark_stack,
                             (void *)current);
             }
 #         endif /* ENABLE_TRACE */
-          PUSH_CONTENTS((ptr_t)current, mark_stack_top,
-                        mark_stack_limit, current_p);
+#         ifdef MARK_PREFETCH_FIFO
+            FIFO_PUSH_CONTENTS((ptr_t)current, current_p,
+                               mark_stack_top, mark_stack_limit);
+#         else
+            /* Prefetch the contents of the object we just pushed.      */
+            /* It's likely we will need them soon.                      */
+            PREFETCH((ptr_t)current);
+            PUSH_CONTENTS((ptr_t)current, mark_stack_top,
+                          mark_stack_limit, current_p);
+#         endif
         }
       }
 
-#     if !defined(SMALL_CONFIG) && !defined(USE_PTR_HWTAG)
+#     if !defined(SMALL_CONFIG) && !defined(USE_PTR_HWTAG) \
+         && !defined(MARK_PREFETCH_FIFO)
         /* We still need to mark the entry we previously prefetched.    */
         /* We already know that it passes the preliminary pointer       */
         /* validity test.                                               */
@@ -805,6 +1166,35 @@ GC_INNER mse * GC_mark_from(mse *mark_stack_top, mse *mark_stack,
 #     endif
     }
   }
+# ifdef MARK_PREFETCH_FIFO
+  {
+    /* Mark the candidates remaining in the buffer.  This may push new  */
+    /* entries to the mark stack which are left for the next call.      */
+    unsigned i;
+
+    for (i = 0; i < MARK_PREFETCH_FIFO_SIZE; i++) {
+      ptr_t p = fifo_ptrs[i];
+
+      if (p != NULL)
+        PUSH_CONTENTS(p, mark_stack_top, mark_stack_limit, fifo_srcs[i]);
+    }
+  }
+# endif
+  /* Make the mark bits visible to the other markers and to the       */
+  /* caller.                                                          */
+  FLUSH_PENDING_MARKS(hdr_cache);
+  return mark_stack_top;
+}
+
+GC_INNER mse * GC_mark_from(mse *mark_stack_top, mse *mark_stack,
+                            mse *mark_stack_limit)
+{
+  DECLARE_HDR_CACHE;
+
+  INIT_HDR_CACHE;
+  mark_stack_top = GC_mark_from_cached(mark_stack_top, mark_stack,
+                                       mark_stack_limit, hdr_cache);
+  GC_hdr_cache_flush_stats(hdr_cache);
   return mark_stack_top;
 }
 
@@ -819,9 +1209,18 @@ STATIC unsigned GC_active_count = 0;    /* Number of active helpers.    */
                                         /* within each mark cycle.  But */
                                         /* once it returns to 0, it     */
                                         /* stays zero for the cycle.    */
+STATIC void (*GC_help_task)(unsigned, mse *) = 0;
+                                /* Non-NULL while helpers are requested */
+                                /* to run a job other than marking (see */
+                                /* GC_do_parallel_task).  Protected by  */
+                                /* mark lock.                           */
 
 GC_INNER word GC_mark_no = 0;
 
+#ifdef PERF_COUNTERS
+  GC_INNER struct GC_perf_counts_s GC_markers_perf_counts = { 0, 0, 0, 0 };
+#endif
+
 #ifdef LINT2
 # define LOCAL_MARK_STACK_SIZE (HBLKSIZE / 8)
 #else
@@ -831,6 +1230,96 @@ GC_INNER word GC_mark_no = 0;
         /* GC_mark_from.                                                */
 #endif
 
+/* Per-marker work-stealing deques (Chase-Lev).  Each marker owns one   */
+/* deque; only the owner pushes and pops at the bottom end, while the   */
+/* other markers steal single entries from the top end by advancing     */
+/* top with a compare-and-swap.  The deques are fixed-size circular     */
+/* buffers; if the owner runs out of room, the surplus entries are      */
+/* returned to the global mark stack (which otherwise only holds the    */
+/* entries pushed before the parallel mark is started).                 */
+#ifndef MARK_DEQUE_SIZE
+# define MARK_DEQUE_SIZE LOCAL_MARK_STACK_SIZE /* a power of 2 */
+#endif
+
+typedef struct {
+    volatile AO_t top;          /* Next entry to steal.                 */
+    volatile AO_t bottom;       /* Next free slot for the owner.        */
+    mse *entries;               /* MARK_DEQUE_SIZE entries.             */
+#   ifdef USE_NUMA
+      int node;                 /* The node the owner is running on.    */
+#   endif
+} GC_mark_deque;
+
+#ifdef USE_NUMA
+  /* Markers steal from the ones running on the same node first.        */
+# define N_STEAL_PASSES (GC_numa_nodes > 1 ? 2 : 1)
+# define IS_STEAL_VICTIM(dq, my_dq, pass) \
+                (N_STEAL_PASSES == 1 \
+                 || ((dq) -> node == (my_dq) -> node) == ((pass) == 0))
+#else
+# define N_STEAL_PASSES 1
+# define IS_STEAL_VICTIM(dq, my_dq, pass) TRUE
+#endif
+
+STATIC GC_mark_deque *GC_mark_deques = NULL;
+                                /* GC_markers_m1 + 1 deques indexed by  */
+                                /* the marker id.                       */
+
+STATIC struct GC_marker_stats_s *GC_marker_stats = NULL;
+                                /* GC_markers_m1 + 1 elements (indexed  */
+                                /* by the marker id) for the current    */
+                                /* collection followed by the same      */
+                                /* number of ones for the last          */
+                                /* completed collection.  An element is */
+                                /* updated only by the marker owning    */
+                                /* the id.                              */
+
+STATIC unsigned GC_last_marker_stats_cnt = 0;
+                                /* Number of the markers participated   */
+                                /* in the last completed collection (0  */
+                                /* if the parallel marking was not      */
+                                /* used).  Protected by the GC lock.    */
+
+STATIC volatile AO_t GC_waiting_markers = 0;
+                                /* Number of markers blocked waiting    */
+                                /* for more work to appear.  Updated    */
+                                /* with the mark lock held, but read    */
+                                /* without it to decide whether a       */
+                                /* notification is needed.              */
+
+#define MARK_DEQUE_SLOT(dq, i) \
+                ((dq) -> entries + ((word)(i) & (MARK_DEQUE_SIZE - 1)))
+
+/* Allocate the deques of all markers (if not yet).  We hold the GC     */
+/* lock.                                                                */
+static void alloc_mark_deques(void)
+{
+    size_t bytes_to_get;
+    int i;
+
+    if (GC_mark_deques != NULL) return;
+    bytes_to_get = ROUNDUP_PAGESIZE_IF_MMAP((GC_markers_m1 + 1)
+                        * (sizeof(GC_mark_deque)
+                           + MARK_DEQUE_SIZE * sizeof(mse)
+                           + 2 * sizeof(struct GC_marker_stats_s)));
+    GC_mark_deques = (GC_mark_deque *)GET_MEM(bytes_to_get);
+    if (NULL == GC_mark_deques)
+      ABORT("Insufficient memory for mark deques");
+    GC_add_to_our_memory((ptr_t)GC_mark_deques, bytes_to_get);
+    for (i = 0; i <= GC_markers_m1; ++i) {
+      GC_mark_deques[i].top = 0;
+      GC_mark_deques[i].bottom = 0;
+      GC_mark_deques[i].entries = (mse *)(GC_mark_deques
+                                          + (GC_markers_m1 + 1))
+                                  + (size_t)i * MARK_DEQUE_SIZE;
+    }
+    GC_marker_stats = (struct GC_marker_stats_s *)(GC_mark_deques[0].entries
+                                + (size_t)(GC_markers_m1 + 1)
+                                  * MARK_DEQUE_SIZE);
+    BZERO(GC_marker_stats,
+          2 * (GC_markers_m1 + 1) * sizeof(struct GC_marker_stats_s));
+}
+
 /* Wait all markers to finish initialization (i.e. store        */
 /* marker_[b]sp, marker_mach_threads, GC_marker_Id).            */
 GC_INNER void GC_wait_for_markers_init(void)
@@ -857,6 +1346,7 @@ GC_INNER void GC_wait_for_markers_init(void)
       ABORT("Insufficient memory for main local_mark_stack");
     GC_add_to_our_memory((ptr_t)GC_main_local_mark_stack, bytes_to_get);
   }
+  alloc_mark_deques();
 
   /* Reuse marker lock and builders count to synchronize        */
   /* marker threads startup.                                    */
@@ -927,6 +1417,7 @@ STATIC void GC_return_mark_stack(mse * low, mse * high)
     if ((word)(my_start - GC_mark_stack + stack_size)
                 > (word)GC_mark_stack_size) {
       GC_COND_LOG_PRINTF("No room to copy back mark stack\n");
+      GC_flag_dropped_entries(low, high);
       GC_mark_state = MS_INVALID;
       GC_mark_stack_too_small = TRUE;
       /* We drop the local mark stack.  We'll fix things later. */
@@ -942,56 +1433,156 @@ STATIC void GC_return_mark_stack(mse * low, mse * high)
     GC_notify_all_marker();
 }
 
-#ifndef N_LOCAL_ITERS
-# define N_LOCAL_ITERS 1
-#endif
+/* Push n entries starting at low to the bottom of the deque owned by   */
+/* the caller.  Return the number of entries actually pushed (which     */
+/* is less than n only if the deque is full).                           */
+STATIC size_t GC_mark_deque_push(GC_mark_deque *dq, const mse *low,
+                                 size_t n)
+{
+    AO_t b = AO_load(&dq->bottom);
+    AO_t t = AO_load_acquire(&dq->top);
+    size_t room = MARK_DEQUE_SIZE - (size_t)(b - t);
+    size_t i;
+
+    GC_ASSERT((size_t)(b - t) <= MARK_DEQUE_SIZE);
+    if (n > room) n = room;
+    for (i = 0; i < n; ++i) {
+      *MARK_DEQUE_SLOT(dq, b + i) = low[i];
+    }
+    /* The entries should be visible to thieves before bottom is.       */
+    AO_store_release(&dq->bottom, b + (AO_t)n);
+    return n;
+}
+
+/* Pop an entry from the bottom of the deque owned by the caller into   */
+/* *res.  Return FALSE if the deque is empty (or its last entry has     */
+/* been stolen concurrently).                                           */
+STATIC GC_bool GC_mark_deque_pop(GC_mark_deque *dq, mse *res)
+{
+    AO_t b = AO_load(&dq->bottom) - 1;
+    AO_t t;
+    GC_bool result = TRUE;
+
+    AO_store(&dq->bottom, b);
+    AO_nop_full(); /* order the store of bottom w.r.t. the load of top */
+    t = AO_load(&dq->top);
+    if ((signed_word)(b - t) < 0) {
+      AO_store(&dq->bottom, b + 1); /* empty */
+      return FALSE;
+    }
+    *res = *MARK_DEQUE_SLOT(dq, b);
+    if (b == t) {
+      /* The last entry, race against thieves for it.   */
+      result = (GC_bool)AO_compare_and_swap(&dq->top, t, t + 1);
+      AO_nop_full();
+      AO_store(&dq->bottom, b + 1);
+    }
+    return result;
+}
 
-/* This function is only called when the local  */
-/* and the main mark stacks are both empty.     */
-static GC_bool has_inactive_helpers(void)
+/* Try to steal an entry from the top of the deque of another marker    */
+/* into *res.  Return FALSE if the deque is empty or if we lost a race  */
+/* for the entry against its owner or another thief.                    */
+STATIC GC_bool GC_mark_deque_steal(GC_mark_deque *dq, mse *res)
 {
-  GC_bool res;
+    AO_t t = AO_load_acquire(&dq->top);
+    AO_t b;
+    mse *p;
 
-  GC_acquire_mark_lock();
-  res = GC_active_count < GC_helper_count;
-  GC_release_mark_lock();
-  return res;
+    AO_nop_full(); /* order the load of top w.r.t. the load of bottom */
+    b = AO_load_acquire(&dq->bottom);
+    if ((signed_word)(b - t) <= 0) return FALSE;
+    /* The slot cannot be reused by the owner unless top has already    */
+    /* moved past t, in which case the CAS below fails and the value    */
+    /* read (maybe a torn one) is dropped.                              */
+    p = MARK_DEQUE_SLOT(dq, t);
+    res -> mse_start = (ptr_t)AO_load((volatile AO_t *)&p->mse_start);
+    res -> mse_descr.w = (word)AO_load(&p->mse_descr.ao);
+    AO_nop_full(); /* the entry should be read before claiming it */
+    return (GC_bool)AO_compare_and_swap(&dq->top, t, t + 1);
+}
+
+/* Is there any entry left in the global mark stack or in any deque?    */
+/* The result is reliable only if no marker can produce new work        */
+/* (i.e. GC_active_count is zero), otherwise it is just a hint.         */
+static GC_bool mark_work_available(void)
+{
+    int i;
+
+    if ((word)AO_load(&GC_first_nonempty)
+            <= (word)AO_load((volatile AO_t *)&GC_mark_stack_top))
+      return TRUE;
+    for (i = 0; i <= GC_markers_m1; ++i) {
+      GC_mark_deque *dq = &GC_mark_deques[i];
+
+      if ((signed_word)(AO_load(&dq->bottom) - AO_load(&dq->top)) > 0)
+        return TRUE;
+    }
+    return FALSE;
 }
 
+/* Move the entries in [low, high] to the deque owned by the caller,    */
+/* the ones which do not fit are copied back to the global mark stack.  */
+/* Wake up the waiting markers, if any.  We do not hold the mark lock.  */
+STATIC void GC_share_mark_entries(GC_mark_deque *dq, mse *low, mse *high)
+{
+    size_t n = (size_t)(high - low + 1);
+    size_t pushed = GC_mark_deque_push(dq, low, n);
+
+    if (pushed < n) {
+      GC_return_mark_stack(low + pushed, high); /* notifies markers */
+      return;
+    }
+    AO_nop_full(); /* order the push w.r.t. the waiters count load */
+    if (AO_load(&GC_waiting_markers) != 0) {
+      /* The waiters check for work holding the mark lock, so acquiring */
+      /* it ensures none of them misses the notification.               */
+      GC_acquire_mark_lock();
+      GC_release_mark_lock();
+      GC_notify_all_marker();
+    }
+}
+
+#ifndef N_LOCAL_ITERS
+# define N_LOCAL_ITERS 1
+#endif
+
 /* Mark from the local mark stack.              */
 /* On return, the local mark stack is empty.    */
-/* But this may be achieved by copying the      */
-/* local mark stack back into the global one.   */
+/* But this may be achieved by moving the       */
+/* local mark stack entries to our deque.       */
 /* We do not hold the mark lock.                */
-STATIC void GC_do_local_mark(mse *local_mark_stack, mse *local_top)
+STATIC void GC_do_local_mark(mse *local_mark_stack, mse *local_top,
+                             GC_mark_deque *dq, hdr_cache_t *hc)
 {
     unsigned n;
 
     for (;;) {
         for (n = 0; n < N_LOCAL_ITERS; ++n) {
-            local_top = GC_mark_from(local_top, local_mark_stack,
-                                     local_mark_stack + LOCAL_MARK_STACK_SIZE);
+            local_top = GC_mark_from_cached(local_top, local_mark_stack,
+                                    local_mark_stack + LOCAL_MARK_STACK_SIZE,
+                                    hc);
             if ((word)local_top < (word)local_mark_stack) return;
             if ((word)(local_top - local_mark_stack)
                         >= LOCAL_MARK_STACK_SIZE / 2) {
-                GC_return_mark_stack(local_mark_stack, local_top);
+                GC_share_mark_entries(dq, local_mark_stack, local_top);
                 return;
             }
         }
-        if ((word)AO_load((volatile AO_t *)&GC_mark_stack_top)
-            < (word)AO_load(&GC_first_nonempty)
-            && (word)local_top > (word)(local_mark_stack + 1)
-            && has_inactive_helpers()) {
-            /* Try to share the load, since the main stack is empty,    */
-            /* and helper threads are waiting for a refill.             */
+        if ((word)local_top > (word)(local_mark_stack + 1)
+            && AO_load(&GC_waiting_markers) != 0
+            && (signed_word)(AO_load(&dq->bottom)
+                             - AO_load(&dq->top)) <= 0) {
+            /* Try to share the load, since our deque is empty, and     */
+            /* other markers are waiting for a refill.                  */
             /* The entries near the bottom of the stack are likely      */
-            /* to require more work.  Thus we return those, even though */
+            /* to require more work.  Thus we share those, even though  */
             /* it's harder.                                             */
             mse * new_bottom = local_mark_stack
                                 + (local_top - local_mark_stack)/2;
             GC_ASSERT((word)new_bottom > (word)local_mark_stack
                       && (word)new_bottom < (word)local_top);
-            GC_return_mark_stack(local_mark_stack, new_bottom - 1);
+            GC_share_mark_entries(dq, local_mark_stack, new_bottom - 1);
             memmove(local_mark_stack, new_bottom,
                     (local_top - new_bottom + 1) * sizeof(mse));
             local_top -= (new_bottom - local_mark_stack);
@@ -1003,16 +1594,62 @@ STATIC void GC_do_local_mark(mse *local_mark_stack, mse *local_top)
 # define ENTRIES_TO_GET 5
 #endif
 
-/* Mark using the local mark stack until the global mark stack is empty */
-/* and there are no active workers. Update GC_first_nonempty to reflect */
-/* progress.  Caller holds the mark lock.                               */
+/* Fill the local mark stack with up to ENTRIES_TO_GET entries stolen   */
+/* from the deques of other markers, the victims are visited starting   */
+/* from a random one (the ones on the same NUMA node are preferred).   */
+/* Return the top of the local mark stack.                              */
+STATIC mse * GC_steal_from_deques(mse *local_mark_stack, int id,
+                                  unsigned *rnd)
+{
+    mse *local_top = local_mark_stack - 1;
+    unsigned n_markers = (unsigned)GC_markers_m1 + 1;
+    unsigned i, start;
+    int pass;
+
+    /* A simple xorshift generator is good enough to pick a victim.     */
+    *rnd ^= *rnd << 13;
+    *rnd ^= *rnd >> 17;
+    *rnd ^= *rnd << 5;
+    start = *rnd % n_markers;
+    for (pass = 0; pass < N_STEAL_PASSES; ++pass) {
+      for (i = 0; i < n_markers; ++i) {
+        unsigned victim = (start + i) % n_markers;
+        GC_mark_deque *dq;
+
+        if (victim == (unsigned)id) continue;
+        dq = &GC_mark_deques[victim];
+        if (!IS_STEAL_VICTIM(dq, &GC_mark_deques[id], pass)) continue;
+        while ((word)(local_top - local_mark_stack) + 1 < ENTRIES_TO_GET
+               && GC_mark_deque_steal(dq, local_top + 1)) {
+            ++local_top;
+        }
+        if ((word)local_top >= (word)local_mark_stack) return local_top;
+      }
+    }
+    return local_top;
+}
+
+/* Mark using the local mark stack until the global mark stack and all  */
+/* the deques are empty and there are no active workers.  Work is taken */
+/* from our own deque first, then from the global mark stack (updating  */
+/* GC_first_nonempty to reflect progress), and then stolen from the     */
+/* deques of the other markers.  Caller holds the mark lock.            */
 /* Caller has already incremented GC_helper_count.  We decrement it,    */
 /* and maintain GC_active_count.                                        */
 STATIC void GC_mark_local(mse *local_mark_stack, int id)
 {
     mse * my_first_nonempty;
+    GC_mark_deque *my_dq = &GC_mark_deques[id];
+    unsigned rnd = (unsigned)id * 0x9e3779b9U + (unsigned)GC_mark_no + 1;
+    hdr_cache_t hc; /* the heap blocks do not change during the parallel */
+                    /* mark, thus the cache is kept till we finish.      */
+    struct GC_marker_stats_s *my_stats = &GC_marker_stats[id];
 
+    BZERO(&hc, sizeof(hc));
     GC_active_count++;
+#   ifdef USE_NUMA
+      my_dq -> node = GC_numa_current_node();
+#   endif
     my_first_nonempty = (mse *)AO_load(&GC_first_nonempty);
     GC_ASSERT((word)GC_mark_stack <= (word)my_first_nonempty);
     GC_ASSERT((word)my_first_nonempty
@@ -1023,9 +1660,22 @@ STATIC void GC_mark_local(mse *local_mark_stack, int id)
         size_t n_on_stack;
         unsigned n_to_get;
         mse * my_top;
-        mse * local_top;
-        mse * global_first_nonempty = (mse *)AO_load(&GC_first_nonempty);
+        mse * local_top = local_mark_stack - 1;
+        mse * global_first_nonempty;
+#       ifndef NO_CLOCK
+          CLOCK_TYPE idle_start, locked_time;
+#       endif
+
+        while ((word)(local_top - local_mark_stack) + 1 < ENTRIES_TO_GET
+               && GC_mark_deque_pop(my_dq, local_top + 1)) {
+            ++local_top;
+        }
+        if ((word)local_top >= (word)local_mark_stack) {
+            GC_do_local_mark(local_mark_stack, local_top, my_dq, &hc);
+            continue;
+        }
 
+        global_first_nonempty = (mse *)AO_load(&GC_first_nonempty);
         GC_ASSERT((word)my_first_nonempty >= (word)GC_mark_stack &&
                   (word)my_first_nonempty <=
                         (word)AO_load((volatile AO_t *)&GC_mark_stack_top)
@@ -1043,64 +1693,77 @@ STATIC void GC_mark_local(mse *local_mark_stack, int id)
         /* Perhaps we should also update GC_first_nonempty, if it */
         /* is less.  But that would require using atomic updates. */
         my_top = (mse *)AO_load_acquire((volatile AO_t *)(&GC_mark_stack_top));
-        if ((word)my_top < (word)my_first_nonempty) {
-            GC_acquire_mark_lock();
-            my_top = GC_mark_stack_top;
-                /* Asynchronous modification impossible here,   */
-                /* since we hold mark lock.                     */
-            n_on_stack = my_top - my_first_nonempty + 1;
-            if (0 == n_on_stack) {
-                GC_active_count--;
-                GC_ASSERT(GC_active_count <= GC_helper_count);
-                /* Other markers may redeposit objects          */
-                /* on the stack.                                */
-                if (0 == GC_active_count) GC_notify_all_marker();
-                while (GC_active_count > 0
-                       && (word)AO_load(&GC_first_nonempty)
-                                > (word)GC_mark_stack_top) {
-                    /* We will be notified if either GC_active_count    */
-                    /* reaches zero, or if more objects are pushed on   */
-                    /* the global mark stack.                           */
-                    GC_wait_marker();
-                }
-                if (GC_active_count == 0
-                    && (word)AO_load(&GC_first_nonempty)
-                        > (word)GC_mark_stack_top) {
-                    GC_bool need_to_notify = FALSE;
-                    /* The above conditions can't be falsified while we */
-                    /* hold the mark lock, since neither                */
-                    /* GC_active_count nor GC_mark_stack_top can        */
-                    /* change.  GC_first_nonempty can only be           */
-                    /* incremented asynchronously.  Thus we know that   */
-                    /* both conditions actually held simultaneously.    */
-                    GC_helper_count--;
-                    if (0 == GC_helper_count) need_to_notify = TRUE;
-                    GC_VERBOSE_LOG_PRINTF("Finished mark helper %d\n", id);
-                    if (need_to_notify) GC_notify_all_marker();
-                    return;
-                }
-                /* Else there's something on the stack again, or        */
-                /* another helper may push something.                   */
-                GC_active_count++;
-                GC_ASSERT(GC_active_count > 0);
-                GC_release_mark_lock();
-                continue;
-            } else {
-                GC_release_mark_lock();
-            }
-        } else {
+        if ((word)my_top >= (word)my_first_nonempty) {
             n_on_stack = my_top - my_first_nonempty + 1;
-        }
-        n_to_get = ENTRIES_TO_GET;
-        if (n_on_stack < 2 * ENTRIES_TO_GET) n_to_get = 1;
-        local_top = GC_steal_mark_stack(my_first_nonempty, my_top,
-                                        local_mark_stack, n_to_get,
-                                        &my_first_nonempty);
-        GC_ASSERT((word)my_first_nonempty >= (word)GC_mark_stack &&
-                  (word)my_first_nonempty <=
+            n_to_get = ENTRIES_TO_GET;
+            if (n_on_stack < 2 * ENTRIES_TO_GET) n_to_get = 1;
+            my_stats -> steal_attempts++;
+            local_top = GC_steal_mark_stack(my_first_nonempty, my_top,
+                                            local_mark_stack, n_to_get,
+                                            &my_first_nonempty);
+            GC_ASSERT((word)my_first_nonempty >= (word)GC_mark_stack &&
+                      (word)my_first_nonempty <=
                         (word)AO_load((volatile AO_t *)&GC_mark_stack_top)
                         + sizeof(mse));
-        GC_do_local_mark(local_mark_stack, local_top);
+        } else {
+            my_stats -> steal_attempts++;
+            local_top = GC_steal_from_deques(local_mark_stack, id, &rnd);
+        }
+        if ((word)local_top >= (word)local_mark_stack) {
+            my_stats -> steals++;
+            GC_do_local_mark(local_mark_stack, local_top, my_dq, &hc);
+            continue;
+        }
+
+#       ifndef NO_CLOCK
+          GET_TIME(idle_start);
+#       endif
+        GC_acquire_mark_lock();
+        my_stats -> lock_waits++;
+#       ifndef NO_CLOCK
+          GET_TIME(locked_time);
+          my_stats -> lock_wait_ns += NS_TIME_DIFF(locked_time, idle_start);
+#       endif
+        GC_active_count--;
+        GC_ASSERT(GC_active_count <= GC_helper_count);
+        if (0 == GC_active_count) GC_notify_all_marker();
+        AO_store(&GC_waiting_markers, AO_load(&GC_waiting_markers) + 1);
+        AO_nop_full(); /* order the store w.r.t. the deques checks */
+        while (GC_active_count > 0 && !mark_work_available()) {
+            /* We will be notified if either GC_active_count    */
+            /* reaches zero, or if more entries are pushed on   */
+            /* the global mark stack or to a deque (while       */
+            /* GC_waiting_markers is non-zero).                 */
+            GC_wait_marker();
+        }
+        AO_store(&GC_waiting_markers, AO_load(&GC_waiting_markers) - 1);
+#       ifndef NO_CLOCK
+          {
+            CLOCK_TYPE done_time;
+
+            GET_TIME(done_time);
+            my_stats -> idle_ns += NS_TIME_DIFF(done_time, locked_time);
+          }
+#       endif
+        if (GC_active_count == 0 && !mark_work_available()) {
+            GC_bool need_to_notify = FALSE;
+            /* The above conditions can't be falsified while we */
+            /* hold the mark lock, since no marker is active    */
+            /* and only active ones push entries.               */
+            GC_helper_count--;
+            if (0 == GC_helper_count) need_to_notify = TRUE;
+            GC_VERBOSE_LOG_PRINTF("Finished mark helper %d\n", id);
+            if (need_to_notify) GC_notify_all_marker();
+            my_stats -> objs_marked += hc.hc_n_marked;
+            my_stats -> bytes_marked += hc.hc_marked_bytes;
+            GC_hdr_cache_flush_stats(&hc);
+            return;
+        }
+        /* Else there's something to steal again, or another    */
+        /* marker may push something.                           */
+        GC_active_count++;
+        GC_ASSERT(GC_active_count > 0);
+        GC_release_mark_lock();
     }
 }
 
@@ -1108,6 +1771,8 @@ STATIC void GC_mark_local(mse *local_mark_stack, int id)
 /* Currently runs until the mark stack is empty.                        */
 STATIC void GC_do_parallel_mark(void)
 {
+    int i;
+
     GC_ASSERT(I_HOLD_LOCK());
     GC_acquire_mark_lock();
 
@@ -1118,6 +1783,11 @@ STATIC void GC_do_parallel_mark(void)
     GC_VERBOSE_LOG_PRINTF("Starting marking for mark phase number %lu\n",
                           (unsigned long)GC_mark_no);
     GC_first_nonempty = (AO_t)GC_mark_stack;
+    GC_ASSERT(GC_mark_deques != NULL);
+    for (i = 0; i <= GC_markers_m1; ++i) {
+      GC_mark_deques[i].top = 0;
+      GC_mark_deques[i].bottom = 0;
+    }
     GC_active_count = 0;
     GC_helper_count = 1;
     GC_help_wanted = TRUE;
@@ -1137,6 +1807,47 @@ STATIC void GC_do_parallel_mark(void)
     GC_notify_all_marker();
 }
 
+/* Same protocol as for GC_do_parallel_mark but the "phase" consists of */
+/* calling fn on every participating thread.  We hold the GC lock.      */
+GC_INNER void GC_do_parallel_task(void (*fn)(unsigned, mse *))
+{
+    GC_ASSERT(I_HOLD_LOCK());
+    GC_ASSERT(fn != 0);
+    GC_acquire_mark_lock();
+    if (GC_help_wanted || GC_active_count != 0 || GC_helper_count != 0)
+        ABORT("Tried to start parallel task in bad state");
+    GC_help_task = fn;
+    GC_helper_count = 1;
+    GC_help_wanted = TRUE;
+    GC_notify_all_marker();
+        /* Wake up potential helpers.   */
+    GC_release_mark_lock();
+    fn(0, GC_main_local_mark_stack);
+    GC_acquire_mark_lock();
+    GC_help_wanted = FALSE;
+    GC_helper_count--;
+    while (GC_helper_count > 0) {
+      GC_wait_marker();
+    }
+    GC_help_task = 0;
+    GC_mark_no++;
+    GC_release_mark_lock();
+    GC_notify_all_marker();
+}
+
+/* Mark from the entries of the global mark stack using all the marker  */
+/* threads, leaving it empty.  Used outside the regular mark phase,     */
+/* e.g. to mark from finalizable objects.  We hold the GC lock.         */
+GC_INNER void GC_mark_stack_in_parallel(void)
+{
+    GC_ASSERT(I_HOLD_LOCK());
+    GC_ASSERT(GC_parallel);
+    if ((word)GC_mark_stack_top < (word)GC_mark_stack) return;
+    GC_do_parallel_mark();
+    GC_ASSERT((word)GC_mark_stack_top < (word)GC_first_nonempty);
+    GC_mark_stack_top = GC_mark_stack - 1;
+}
+
 /* Try to help out the marker, if it's running.  We hold the mark lock  */
 /* only, the initiating thread holds the allocation lock.               */
 GC_INNER void GC_help_marker(word my_mark_no)
@@ -1159,13 +1870,75 @@ GC_INNER void GC_help_marker(word my_mark_no)
       return;
     }
     GC_helper_count = (unsigned)my_id + 1;
+    if (GC_help_task != 0) {
+      void (*fn)(unsigned, mse *) = GC_help_task;
+
+      GC_release_mark_lock();
+      fn((unsigned)my_id, local_mark_stack);
+      GC_acquire_mark_lock();
+      if (0 == --GC_helper_count) GC_notify_all_marker();
+      return;
+    }
     GC_mark_local(local_mark_stack, (int)my_id);
     /* GC_mark_local decrements GC_helper_count. */
 #   undef my_id
 }
 
+GC_INNER void GC_marker_stats_next_cycle(void)
+{
+    unsigned i, n_markers = (unsigned)GC_markers_m1 + 1;
+    struct GC_marker_stats_s *last_stats;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    if (NULL == GC_marker_stats) return;
+    last_stats = GC_marker_stats + n_markers;
+    GC_last_marker_stats_cnt = 0;
+    for (i = 0; i < n_markers; ++i) {
+      last_stats[i] = GC_marker_stats[i];
+      if (GC_marker_stats[i].lock_waits != 0)
+        GC_last_marker_stats_cnt = n_markers; /* marked in parallel */
+    }
+    BZERO(GC_marker_stats, n_markers * sizeof(struct GC_marker_stats_s));
+    if (!GC_print_stats || 0 == GC_last_marker_stats_cnt) return;
+
+    for (i = 0; i < n_markers; ++i) {
+      GC_log_printf("Marker %u: %lu objects (%lu KiB) marked,"
+                    " %lu of %lu steals succeeded, idle %lu us,"
+                    " %lu lock waits (%lu us)\n", i,
+                    (unsigned long)last_stats[i].objs_marked,
+                    TO_KiB_UL(last_stats[i].bytes_marked),
+                    (unsigned long)last_stats[i].steals,
+                    (unsigned long)last_stats[i].steal_attempts,
+                    (unsigned long)(last_stats[i].idle_ns / 1000),
+                    (unsigned long)last_stats[i].lock_waits,
+                    (unsigned long)(last_stats[i].lock_wait_ns / 1000));
+    }
+}
+
 #endif /* PARALLEL_MARK */
 
+GC_API unsigned GC_CALL GC_get_marker_stats(struct GC_marker_stats_s *stats,
+                                            unsigned max_markers)
+{
+#   ifdef PARALLEL_MARK
+      unsigned n_markers;
+      DCL_LOCK_STATE;
+
+      LOCK();
+      n_markers = GC_last_marker_stats_cnt;
+      if (n_markers != 0)
+        BCOPY(GC_marker_stats + n_markers, stats,
+              (n_markers < max_markers ? n_markers : max_markers)
+                * sizeof(struct GC_marker_stats_s));
+      UNLOCK();
+      return n_markers;
+#   else
+      UNUSED_ARG(stats);
+      UNUSED_ARG(max_markers);
+      return 0;
+#   endif
+}
+
 /* Allocate or reallocate space for mark stack of size n entries.  */
 /* May silently fail.                                              */
 static void alloc_mark_stack(size_t n)
@@ -1390,24 +2163,17 @@ GC_API struct GC_ms_entry * GC_CALL GC_mark_and_push(void *obj,
       return mark_stack_ptr;
     }
     return GC_push_contents_hdr((ptr_t)obj, mark_stack_ptr, mark_stack_limit,
-                                (ptr_t)src, hhdr, TRUE);
+                                (ptr_t)src, hhdr, TRUE, NULL);
 }
 
-/* Mark and push (i.e. gray) a single object p onto the main    */
-/* mark stack.  Consider p to be valid if it is an interior     */
-/* pointer.                                                     */
-/* The object p has passed a preliminary pointer validity       */
-/* test, but we do not definitely know whether it is valid.     */
-/* Mark bits are NOT atomically updated.  Thus this must be the */
-/* only thread setting them.                                    */
+/* Mark and push (i.e. gray) a single object p onto the given mark      */
+/* stack.  Consider p to be valid if it is an interior pointer.         */
+/* The object p has passed a preliminary pointer validity test, but we  */
+/* do not definitely know whether it is valid.  Return the new top of   */
+/* the mark stack.                                                      */
 GC_ATTR_NO_SANITIZE_ADDR
-GC_INNER void
-# if defined(PRINT_BLACK_LIST) || defined(KEEP_BACK_PTRS)
-    GC_mark_and_push_stack(ptr_t p, ptr_t source)
-# else
-    GC_mark_and_push_stack(ptr_t p)
-#   define source ((ptr_t)0)
-# endif
+GC_INLINE mse *mark_and_push_stack_to(ptr_t p, mse *mark_stack_top,
+                                      mse *mark_stack_limit, ptr_t source)
 {
     hdr * hhdr;
     ptr_t r = p;
@@ -1419,26 +2185,43 @@ GC_INNER void
             || (r = (ptr_t)GC_base(p)) == NULL
             || (hhdr = HDR(r)) == NULL) {
         GC_ADD_TO_BLACK_LIST_STACK(p, source);
-        return;
+        return mark_stack_top;
       }
     }
     if (EXPECT(HBLK_IS_FREE(hhdr), FALSE)) {
         GC_ADD_TO_BLACK_LIST_NORMAL(p, source);
-        return;
+        return mark_stack_top;
     }
 #   ifdef THREADS
       /* Pointer is on the stack.  We may have dirtied the object       */
       /* it points to, but have not called GC_dirty yet.                */
       GC_dirty(p); /* entire object */
 #   endif
-    GC_mark_stack_top = GC_push_contents_hdr(r, GC_mark_stack_top,
-                                             GC_mark_stack_limit,
-                                             source, hhdr, FALSE);
+    return GC_push_contents_hdr(r, mark_stack_top, mark_stack_limit,
+                                source, hhdr, FALSE, NULL);
     /* We silently ignore pointers to near the end of a block,  */
     /* which is very mildly suboptimal.                         */
     /* FIXME: We should probably add a header word to address   */
     /* this.                                                    */
 }
+
+/* Mark and push (i.e. gray) a single object p onto the main    */
+/* mark stack.  Consider p to be valid if it is an interior     */
+/* pointer.                                                     */
+/* Mark bits are NOT atomically updated.  Thus this must be the */
+/* only thread setting them.                                    */
+GC_ATTR_NO_SANITIZE_ADDR
+GC_INNER void
+# if defined(PRINT_BLACK_LIST) || defined(KEEP_BACK_PTRS)
+    GC_mark_and_push_stack(ptr_t p, ptr_t source)
+# else
+    GC_mark_and_push_stack(ptr_t p)
+#   define source ((ptr_t)0)
+# endif
+{
+    GC_mark_stack_top = mark_and_push_stack_to(p, GC_mark_stack_top,
+                                               GC_mark_stack_limit, source);
+}
 # undef source
 
 #ifdef TRACE_BUF
@@ -1513,8 +2296,26 @@ GC_API void GC_CALL GC_push_all_eager(void *bottom, void *top)
 
     /* Check all pointers in range and push if they appear to be valid. */
     lim = (word *)(((word)top) & ~(ALIGNMENT-1)) - 1;
-    for (current_p = (ptr_t)(((word)bottom + ALIGNMENT-1) & ~(ALIGNMENT-1));
-         (word)current_p <= (word)lim; current_p += ALIGNMENT) {
+    current_p = (ptr_t)(((word)bottom + ALIGNMENT-1) & ~(ALIGNMENT-1));
+#   ifdef SIMD_PTR_FILTER
+      if (GC_ptr_filter != 0) {
+        word span = (word)greatest_ha - (word)least_ha;
+
+        for (; (word)current_p + WORDS_TO_BYTES(CPP_WORDSZ - 1)
+                    <= (word)lim;
+             current_p += WORDS_TO_BYTES(CPP_WORDSZ)) {
+          word m = GC_ptr_filter((word *)current_p, (word)least_ha, span);
+
+          for (; m != 0; m &= m - 1) {
+            ptr_t p = current_p + WORDS_TO_BYTES(GC_ctz_word(m));
+            REGISTER word q = *(word *)p;
+
+            GC_PUSH_ONE_STACK(q, p);
+          }
+        }
+      }
+#   endif
+    for (; (word)current_p <= (word)lim; current_p += ALIGNMENT) {
       REGISTER word q;
 
       LOAD_WORD_OR_CONTINUE(q, current_p);
@@ -1524,10 +2325,269 @@ GC_API void GC_CALL GC_push_all_eager(void *bottom, void *top)
 #   undef GC_least_plausible_heap_addr
 }
 
+#ifdef PARALLEL_MARK
+  struct GC_stack_range_s {
+    ptr_t lo;
+    ptr_t hi;
+  };
+
+  STATIC struct GC_stack_range_s *GC_stack_ranges = NULL;
+  STATIC size_t GC_stack_ranges_size = 0;   /* capacity */
+  STATIC size_t GC_n_stack_ranges = 0;
+  STATIC word GC_stack_ranges_bytes = 0;
+  STATIC size_t GC_next_stack_range = 0;
+                        /* Index of the next range to be scanned by     */
+                        /* a helper.  Protected by mark lock.           */
+  STATIC GC_bool GC_stacks_scan_deferred = FALSE;
+
+# ifndef STACK_RANGE_CHUNK_BYTES
+#   define STACK_RANGE_CHUNK_BYTES (16 * 1024)
+# endif
+# ifndef MIN_PARALLEL_STACKS_SCAN_BYTES
+#   define MIN_PARALLEL_STACKS_SCAN_BYTES (4 * STACK_RANGE_CHUNK_BYTES)
+# endif
+
+  /* Record [bottom, top) to be scanned later.  Deep stacks are split   */
+  /* into chunks, so that the work is evenly shared between markers.    */
+  STATIC void GC_add_stack_range(ptr_t bottom, ptr_t top)
+  {
+    GC_ASSERT(I_HOLD_LOCK());
+    while ((word)bottom < (word)top) {
+      ptr_t lim = top;
+
+      if ((word)(top - bottom) > STACK_RANGE_CHUNK_BYTES) {
+        /* The chunk boundary is aligned not to miss a word.            */
+        lim = (ptr_t)(((word)bottom + STACK_RANGE_CHUNK_BYTES)
+                      & ~(word)(ALIGNMENT-1));
+      }
+      if (GC_n_stack_ranges == GC_stack_ranges_size) {
+        size_t new_size = GC_stack_ranges_size > 0
+                            ? 2 * GC_stack_ranges_size : 64;
+        struct GC_stack_range_s *new_ranges = (struct GC_stack_range_s *)
+                GC_scratch_alloc(new_size * sizeof(struct GC_stack_range_s));
+
+        if (EXPECT(NULL == new_ranges, FALSE)) {
+          GC_push_all_eager(bottom, top);
+          return;
+        }
+        if (GC_stack_ranges_size > 0) {
+          BCOPY(GC_stack_ranges, new_ranges,
+                GC_n_stack_ranges * sizeof(struct GC_stack_range_s));
+#         ifndef GWW_VDB
+            GC_scratch_recycle_no_gww(GC_stack_ranges,
+                GC_stack_ranges_size * sizeof(struct GC_stack_range_s));
+#         endif
+        }
+        GC_stack_ranges = new_ranges;
+        GC_stack_ranges_size = new_size;
+      }
+      GC_stack_ranges[GC_n_stack_ranges].lo = bottom;
+      GC_stack_ranges[GC_n_stack_ranges].hi = lim;
+      GC_n_stack_ranges++;
+      GC_stack_ranges_bytes += (word)(lim - bottom);
+      bottom = lim;
+    }
+  }
+
+  /* Mark from the local mark stack until it is empty.  If it becomes   */
+  /* more than half full, the entries are moved to the global mark      */
+  /* stack instead (to be processed by GC_do_parallel_mark).  Returns   */
+  /* the new top of the local mark stack.  We do not hold mark lock.    */
+  STATIC mse *GC_drain_local_mark_stack(mse *local_mark_stack,
+                                        mse *local_top)
+  {
+    while ((word)local_top >= (word)local_mark_stack) {
+      local_top = GC_mark_from(local_top, local_mark_stack,
+                               local_mark_stack + LOCAL_MARK_STACK_SIZE);
+      if ((word)(local_top - local_mark_stack)
+            >= LOCAL_MARK_STACK_SIZE / 2) {
+        GC_return_mark_stack(local_mark_stack, local_top);
+        return local_mark_stack - 1;
+      }
+    }
+    return local_top;
+  }
+
+  /* Scan the recorded stack ranges claimed one by one until there are  */
+  /* none left, the same way as GC_push_all_eager does, but pushing to  */
+  /* (and marking from) the local mark stack of the helper.             */
+  GC_ATTR_NO_SANITIZE_ADDR GC_ATTR_NO_SANITIZE_MEMORY
+  GC_ATTR_NO_SANITIZE_THREAD
+  STATIC void GC_scan_stack_ranges(unsigned id, mse *local_mark_stack)
+  {
+    mse *local_top = local_mark_stack - 1;
+    mse *local_limit = local_mark_stack + LOCAL_MARK_STACK_SIZE;
+    word greatest_ha = (word)GC_greatest_plausible_heap_addr;
+    word least_ha = (word)GC_least_plausible_heap_addr;
+
+    UNUSED_ARG(id);
+    for (;;) {
+      size_t i;
+      ptr_t current_p;
+      word *lim;
+
+      GC_acquire_mark_lock();
+      i = GC_next_stack_range++;
+      GC_release_mark_lock();
+      if (i >= GC_n_stack_ranges) break;
+
+      lim = (word *)((word)GC_stack_ranges[i].hi & ~(word)(ALIGNMENT-1)) - 1;
+      for (current_p = (ptr_t)(((word)GC_stack_ranges[i].lo + ALIGNMENT-1)
+                               & ~(word)(ALIGNMENT-1));
+           (word)current_p <= (word)lim; current_p += ALIGNMENT) {
+        word q;
+
+        LOAD_WORD_OR_CONTINUE(q, current_p);
+        if (q >= least_ha && q < greatest_ha) {
+          local_top = mark_and_push_stack_to((ptr_t)q, local_top,
+                                             local_limit, current_p);
+          if ((word)(local_top - local_mark_stack)
+                >= LOCAL_MARK_STACK_SIZE / 4)
+            local_top = GC_drain_local_mark_stack(local_mark_stack,
+                                                  local_top);
+        }
+      }
+    }
+    (void)GC_drain_local_mark_stack(local_mark_stack, local_top);
+  }
+
+  GC_INNER void GC_defer_stacks_scan(void)
+  {
+    GC_ASSERT(I_HOLD_LOCK());
+    GC_ASSERT(!GC_stacks_scan_deferred);
+#   ifndef NEED_FIXUP_POINTER
+      if (GC_parallel) {
+        GC_n_stack_ranges = 0;
+        GC_stack_ranges_bytes = 0;
+        GC_stacks_scan_deferred = TRUE;
+      }
+#   endif
+  }
+
+  GC_INNER void GC_scan_deferred_stacks(void)
+  {
+    GC_ASSERT(I_HOLD_LOCK());
+    if (!GC_stacks_scan_deferred) return;
+    GC_stacks_scan_deferred = FALSE;
+    if (GC_stack_ranges_bytes >= MIN_PARALLEL_STACKS_SCAN_BYTES) {
+      GC_next_stack_range = 0;
+      GC_do_parallel_task(GC_scan_stack_ranges);
+    } else {
+      size_t i;
+
+      /* Not worth waking up the helpers.       */
+      for (i = 0; i < GC_n_stack_ranges; i++)
+        GC_push_all_eager(GC_stack_ranges[i].lo, GC_stack_ranges[i].hi);
+    }
+  }
+#endif /* PARALLEL_MARK */
+
+#ifndef MAX_PUSH_ROOTS_PROCS
+# define MAX_PUSH_ROOTS_PROCS 16
+#endif
+
+STATIC struct GC_push_roots_proc_s {
+    GC_push_roots_part_proc proc;
+    unsigned nparts;
+    void *client_data;
+} GC_push_roots_procs[MAX_PUSH_ROOTS_PROCS];
+
+GC_INNER unsigned GC_n_push_roots_procs = 0;
+
+GC_API int GC_CALL GC_register_push_roots_proc(GC_push_roots_part_proc proc,
+                                               unsigned nparts,
+                                               void *client_data)
+{
+    unsigned i;
+    int res = GC_SUCCESS;
+    DCL_LOCK_STATE;
+
+    GC_ASSERT(NONNULL_ARG_NOT_NULL(proc));
+    LOCK();
+    for (i = 0; i < GC_n_push_roots_procs; i++) {
+      if (GC_push_roots_procs[i].proc == proc
+          && GC_push_roots_procs[i].client_data == client_data) break;
+    }
+    if (0 == nparts) {
+      if (i < GC_n_push_roots_procs) {
+        /* Move the last entry to the place of the removed one. */
+        GC_push_roots_procs[i] =
+                        GC_push_roots_procs[--GC_n_push_roots_procs];
+      }
+    } else if (i < GC_n_push_roots_procs) {
+      GC_push_roots_procs[i].nparts = nparts;
+    } else if (i < MAX_PUSH_ROOTS_PROCS) {
+      GC_push_roots_procs[i].proc = proc;
+      GC_push_roots_procs[i].nparts = nparts;
+      GC_push_roots_procs[i].client_data = client_data;
+      GC_n_push_roots_procs++;
+    } else {
+      res = GC_NO_MEMORY;
+    }
+    UNLOCK();
+    return res;
+}
+
+#ifdef PARALLEL_MARK
+  STATIC word GC_next_roots_part = 0;
+                        /* Index of the next part (counting all the     */
+                        /* procedures) to be pushed by a helper.        */
+                        /* Protected by mark lock.                      */
+
+  /* Call the registered procedures for the parts claimed one by one,   */
+  /* marking from the local mark stack after each call.                 */
+  STATIC void GC_push_roots_parts(unsigned id, mse *local_mark_stack)
+  {
+    mse *local_top = local_mark_stack - 1;
+
+    UNUSED_ARG(id);
+    for (;;) {
+      word part;
+      unsigned i;
+
+      GC_acquire_mark_lock();
+      part = GC_next_roots_part++;
+      GC_release_mark_lock();
+      for (i = 0; i < GC_n_push_roots_procs; i++) {
+        if (part < GC_push_roots_procs[i].nparts) break;
+        part -= GC_push_roots_procs[i].nparts;
+      }
+      if (i >= GC_n_push_roots_procs) break;
+
+      local_top = (*GC_push_roots_procs[i].proc)((unsigned)part, local_top,
+                                local_mark_stack + LOCAL_MARK_STACK_SIZE,
+                                GC_push_roots_procs[i].client_data);
+      local_top = GC_drain_local_mark_stack(local_mark_stack, local_top);
+    }
+  }
+#endif /* PARALLEL_MARK */
+
+GC_INNER void GC_push_client_roots(void)
+{
+    unsigned i, part;
+
+    GC_ASSERT(I_HOLD_LOCK());
+#   ifdef PARALLEL_MARK
+      if (GC_parallel && (GC_n_push_roots_procs > 1
+                          || GC_push_roots_procs[0].nparts > 1)) {
+        GC_next_roots_part = 0;
+        GC_do_parallel_task(GC_push_roots_parts);
+        return;
+      }
+#   endif
+    for (i = 0; i < GC_n_push_roots_procs; i++) {
+      for (part = 0; part < GC_push_roots_procs[i].nparts; part++) {
+        GC_mark_stack_top = (*GC_push_roots_procs[i].proc)(part,
+                                GC_mark_stack_top, GC_mark_stack_limit,
+                                GC_push_roots_procs[i].client_data);
+      }
+    }
+}
+
 GC_INNER void GC_push_all_stack(ptr_t bottom, ptr_t top)
 {
 #   ifndef NEED_FIXUP_POINTER
-      if (GC_all_interior_pointers
+      if (GC_all_interior_pointers && !GC_have_exact_base_kinds
 #         if defined(THREADS) && defined(MPROTECT_VDB)
             && !GC_auto_incremental
 #         endif
@@ -1537,6 +2597,12 @@ GC_INNER void GC_push_all_stack(ptr_t bottom, ptr_t top)
       } else
 #   endif
     /* else */ {
+#     ifdef PARALLEL_MARK
+        if (GC_stacks_scan_deferred) {
+          GC_add_stack_range(bottom, top);
+          return;
+        }
+#     endif
       GC_push_all_eager(bottom, top);
     }
 }
@@ -1612,7 +2678,7 @@ GC_INNER void GC_push_all_stack(ptr_t bottom, ptr_t top)
 GC_ATTR_NO_SANITIZE_THREAD
 STATIC void GC_push_marked1(struct hblk *h, hdr *hhdr)
 {
-    word * mark_word_addr = &(hhdr->hb_marks[0]);
+    word * mark_word_addr = &(HDR_MARKS(hhdr)[0]);
     word *p;
     word *plim;
 
@@ -1666,7 +2732,7 @@ STATIC void GC_push_marked1(struct hblk *h, hdr *hhdr)
 GC_ATTR_NO_SANITIZE_THREAD
 STATIC void GC_push_marked2(struct hblk *h, hdr *hhdr)
 {
-    word * mark_word_addr = &(hhdr->hb_marks[0]);
+    word * mark_word_addr = &(HDR_MARKS(hhdr)[0]);
     word *p;
     word *plim;
 
@@ -1718,7 +2784,7 @@ STATIC void GC_push_marked2(struct hblk *h, hdr *hhdr)
 GC_ATTR_NO_SANITIZE_THREAD
 STATIC void GC_push_marked4(struct hblk *h, hdr *hhdr)
 {
-    word * mark_word_addr = &(hhdr->hb_marks[0]);
+    word * mark_word_addr = &(HDR_MARKS(hhdr)[0]);
     word *p;
     word *plim;
 
@@ -1782,6 +2848,7 @@ STATIC void GC_push_marked(struct hblk *h, hdr *hhdr)
 
     /* Some quick shortcuts: */
         if ((/* 0 | */ GC_DS_LENGTH) == descr) return;
+        VALIDATE_MARKS(hhdr);
         if (GC_block_empty(hhdr)/* nothing marked */) return;
 #   if !defined(GC_DISABLE_INCREMENTAL)
       GC_n_rescuing_pages++;
@@ -1793,7 +2860,11 @@ STATIC void GC_push_marked(struct hblk *h, hdr *hhdr)
         lim = (ptr_t)((word)(h + 1)->hb_body - sz);
     }
 
-    switch(BYTES_TO_GRANULES(sz)) {
+    /* The accelerators scan the objects conservatively, thus these   */
+    /* are not used for the kinds with a mark procedure (which might  */
+    /* not store the references as plain pointers).                   */
+    switch ((descr & GC_DS_TAGS) == GC_DS_PROC ? 0
+                                               : BYTES_TO_GRANULES(sz)) {
 #   if defined(USE_PUSH_MARKED_ACCELERATORS)
       case 1:
         GC_push_marked1(h, hhdr);
@@ -1889,21 +2960,63 @@ STATIC void GC_push_marked(struct hblk *h, hdr *hhdr)
   }
 #endif /* GC_DISABLE_INCREMENTAL */
 
+#ifndef GC_DISABLE_INCREMENTAL
+  /* Similar to GC_push_marked but pushes only the objects which        */
+  /* overlap the cards dirty at the last GC_read_dirty (thus, is used   */
+  /* only in the manual VDB mode).  h is a small object block.          */
+  STATIC void GC_push_marked_dirty_cards(struct hblk *h, hdr *hhdr)
+  {
+    word sz = hhdr -> hb_sz;
+    ptr_t p;
+    word bit_no;
+    ptr_t lim = (ptr_t)((word)(h + 1)->hb_body - sz);
+    mse * GC_mark_stack_top_reg;
+    mse * mark_stack_limit = GC_mark_stack_limit;
+
+    if ((/* 0 | */ GC_DS_LENGTH) == hhdr -> hb_descr) return;
+    VALIDATE_MARKS(hhdr);
+    if (GC_block_empty(hhdr)/* nothing marked */) return;
+    GC_n_rescuing_pages++;
+    GC_objects_are_marked = TRUE;
+    GC_mark_stack_top_reg = GC_mark_stack_top;
+    for (p = h -> hb_body, bit_no = 0; (word)p <= (word)lim;
+         p += sz, bit_no += MARK_BIT_OFFSET(sz)) {
+      if (mark_bit_from_hdr(hhdr, bit_no) && GC_cards_were_dirty(p, sz)) {
+        GC_mark_stack_top_reg = GC_push_obj(p, hhdr, GC_mark_stack_top_reg,
+                                            mark_stack_limit);
+      }
+    }
+    GC_mark_stack_top = GC_mark_stack_top_reg;
+  }
+#endif /* !GC_DISABLE_INCREMENTAL */
+
 /* Similar to GC_push_marked, but skip over unallocated blocks  */
+/* (and the blocks without hb_rescan set if GC_rescan_flagged_only) */
 /* and return address of next plausible block.                  */
 STATIC struct hblk * GC_push_next_marked(struct hblk *h)
 {
     hdr * hhdr = HDR(h);
 
-    if (EXPECT(IS_FORWARDING_ADDR_OR_NIL(hhdr) || HBLK_IS_FREE(hhdr), FALSE)) {
-      h = GC_next_block(h, FALSE);
-      if (NULL == h) return NULL;
-      hhdr = GC_find_header((ptr_t)h);
-    } else {
-#     ifdef LINT2
-        if (NULL == h) ABORT("Bad HDR() definition");
-#     endif
+    for (;;) {
+        if (EXPECT(IS_FORWARDING_ADDR_OR_NIL(hhdr)
+                   || HBLK_IS_FREE(hhdr), FALSE)) {
+          h = GC_next_block(h, FALSE);
+          if (NULL == h) {
+            GC_rescan_flagged_only = FALSE;
+            return NULL;
+          }
+          hhdr = GC_find_header((ptr_t)h);
+        } else {
+#         ifdef LINT2
+            if (NULL == h) ABORT("Bad HDR() definition");
+#         endif
+        }
+        if (!GC_rescan_flagged_only || hhdr -> hb_rescan)
+          break;
+        h += OBJ_SZ_TO_BLOCKS(hhdr -> hb_sz);
+        hhdr = HDR(h);
     }
+    hhdr -> hb_rescan = FALSE;
     GC_push_marked(h, hhdr);
     return h + OBJ_SZ_TO_BLOCKS(hhdr -> hb_sz);
 }
@@ -1943,15 +3056,18 @@ STATIC struct hblk * GC_push_next_marked(struct hblk *h)
         /* MS_PUSH_UNCOLLECTABLE phase.                                 */
       } else
 #   endif
-    /* else */ {
+    /* else */ if (GC_manual_vdb && hhdr -> hb_sz <= MAXOBJBYTES) {
+      GC_push_marked_dirty_cards(h, hhdr);
+    } else {
       GC_push_marked(h, hhdr);
     }
     return h + OBJ_SZ_TO_BLOCKS(hhdr -> hb_sz);
   }
 #endif /* !GC_DISABLE_INCREMENTAL */
 
-/* Similar to above, but for uncollectible pages.  Needed since we      */
-/* do not clear marks for such pages, even for full collections.        */
+/* Similar to above, but for uncollectible (and frozen) pages.  Needed  */
+/* since we do not clear marks for such pages, even for full            */
+/* collections.                                                         */
 STATIC struct hblk * GC_push_next_marked_uncollectable(struct hblk *h)
 {
     hdr * hhdr = HDR(h);
@@ -1967,7 +3083,8 @@ STATIC struct hblk * GC_push_next_marked_uncollectable(struct hblk *h)
             if (NULL == h) ABORT("Bad HDR() definition");
 #         endif
         }
-        if (hhdr -> hb_obj_kind == UNCOLLECTABLE) {
+        if (hhdr -> hb_obj_kind == UNCOLLECTABLE
+            || (hhdr -> hb_flags & FROZEN_BLK) != 0) {
             GC_push_marked(h, hhdr);
             break;
         }
@@ -49,6 +49,50 @@ int GC_no_dls = 0;      /* Register dynamic library data segments.      */
   }
 #endif /* !NO_DEBUGGING || GC_ASSERTIONS */
 
+#if defined(FROZEN_ROOTS) || (!defined(NO_DEBUGGING) && !defined(NO_CLOCK))
+  STATIC struct exclusion * GC_next_exclusion(ptr_t start_addr);
+
+  /* Scan the words of [bottom, top) (not excluded from the roots, if   */
+  /* with_exclusions) the way the marker does, but without marking      */
+  /* anything.  Store the words pointing to the heap to buf (unless it  */
+  /* is NULL), at most max_n of them.  Return the number of such words  */
+  /* (not greater than max_n).                                          */
+  GC_ATTR_NO_SANITIZE_ADDR GC_ATTR_NO_SANITIZE_MEMORY
+  GC_ATTR_NO_SANITIZE_THREAD
+  STATIC size_t GC_collect_heap_ptrs(ptr_t bottom, ptr_t top,
+                                     GC_bool with_exclusions, word *buf,
+                                     size_t max_n)
+  {
+    size_t count = 0;
+
+    while ((word)bottom < (word)top) {
+      struct exclusion *next = with_exclusions ? GC_next_exclusion(bottom)
+                                               : NULL;
+      ptr_t lim = top;
+      ptr_t p;
+
+      if (next != 0 && (word)next -> e_start < (word)top)
+        lim = next -> e_start;
+      for (p = (ptr_t)(((word)bottom + ALIGNMENT-1)
+                       & ~(word)(ALIGNMENT-1));
+           (word)p + sizeof(word) <= (word)lim; p += ALIGNMENT) {
+        word q = *(word *)p;
+
+        if (q >= (word)GC_least_plausible_heap_addr
+            && q < (word)GC_greatest_plausible_heap_addr
+            && HDR(q) != NULL) {
+          if (count == max_n) return count;
+          if (buf != NULL) buf[count] = q;
+          count++;
+        }
+      }
+      if (lim == top) break;
+      bottom = next -> e_end;
+    }
+    return count;
+  }
+#endif /* FROZEN_ROOTS || !NO_DEBUGGING && !NO_CLOCK */
+
 #if !defined(NO_DEBUGGING)
   /* For debugging:     */
   void GC_print_static_roots(void)
@@ -57,11 +101,39 @@ int GC_no_dls = 0;      /* Register dynamic library data segments.      */
     word size;
 
     for (i = 0; i < n_root_sets; i++) {
+#     ifndef NO_CLOCK
+        CLOCK_TYPE start_time, done_time;
+        size_t count;
+
+        GET_TIME(start_time);
+        count = GC_collect_heap_ptrs(GC_static_roots[i].r_start,
+                                     GC_static_roots[i].r_end, TRUE,
+                                     NULL, ~(size_t)0);
+        GET_TIME(done_time);
+        GC_printf("From %p to %p%s, scanned in %lu us"
+                  " (%lu pointers to heap)\n",
+                  (void *)GC_static_roots[i].r_start,
+                  (void *)GC_static_roots[i].r_end,
+                  GC_static_roots[i].r_tmp ? " (temporary)" : "",
+                  MS_TIME_DIFF(done_time, start_time) * 1000
+                    + NS_FRAC_TIME_DIFF(done_time, start_time) / 1000,
+                  (unsigned long)count);
+#     else
         GC_printf("From %p to %p%s\n",
                   (void *)GC_static_roots[i].r_start,
                   (void *)GC_static_roots[i].r_end,
                   GC_static_roots[i].r_tmp ? " (temporary)" : "");
+#     endif
     }
+#   ifdef FROZEN_ROOTS
+      for (i = 0; i < GC_n_frozen_roots; i++) {
+        GC_printf("Frozen from %p to %p, %lu remembered pointers%s\n",
+                  (void *)GC_frozen_roots[i].fr_start,
+                  (void *)GC_frozen_roots[i].fr_end,
+                  (unsigned long)GC_frozen_roots[i].fr_n_ptrs,
+                  GC_frozen_roots[i].fr_valid ? "" : " (not scanned yet)");
+      }
+#   endif
     GC_printf("GC_root_size= %lu\n", (unsigned long)GC_root_size);
 
     if ((size = GC_compute_root_size()) != GC_root_size)
@@ -266,6 +338,10 @@ void GC_add_roots_inner(ptr_t b, ptr_t e, GC_bool tmp)
     n_root_sets++;
 }
 
+#ifdef FROZEN_ROOTS
+  STATIC void GC_remove_frozen_roots_inner(ptr_t b, ptr_t e);
+#endif
+
 GC_API void GC_CALL GC_clear_roots(void)
 {
     DCL_LOCK_STATE;
@@ -277,6 +353,15 @@ GC_API void GC_CALL GC_clear_roots(void)
 #   endif
     n_root_sets = 0;
     GC_root_size = 0;
+#   ifdef CAN_DEFER_ROOTS
+      GC_roots_deferred = FALSE;
+#   endif
+#   ifdef FROZEN_ROOTS
+      GC_remove_frozen_roots_inner(NULL, (ptr_t)GC_WORD_MAX);
+#   endif
+#   ifdef DYNLIB_CACHE
+      GC_dynlib_generation = 0;
+#   endif
 #   if !defined(MSWIN32) && !defined(MSWINCE) && !defined(CYGWIN32)
       BZERO(GC_root_index, RT_SIZE * sizeof(void *));
 #   endif
@@ -348,6 +433,7 @@ GC_API void GC_CALL GC_remove_roots(void *b, void *e)
       return;
 
     LOCK();
+    GC_REGISTER_DEFERRED_ROOTS();
     GC_remove_roots_inner((ptr_t)b, (ptr_t)e);
     UNLOCK();
 }
@@ -360,9 +446,16 @@ STATIC void GC_remove_roots_inner(ptr_t b, ptr_t e)
 #   endif
 
     GC_ASSERT(I_HOLD_LOCK());
+#   ifdef FROZEN_ROOTS
+      GC_remove_frozen_roots_inner(b, e);
+#   endif
     for (i = 0; i < n_root_sets; ) {
         if ((word)GC_static_roots[i].r_start >= (word)b
             && (word)GC_static_roots[i].r_end <= (word)e) {
+#           ifdef DYNLIB_CACHE
+              if (GC_static_roots[i].r_tmp)
+                GC_dynlib_generation = 0; /* re-register the libraries */
+#           endif
             GC_remove_root_at_pos(i);
         } else {
             i++;
@@ -622,6 +715,37 @@ GC_API void GC_CALL GC_exclude_static_roots(void *b, void *e)
                 (GC_parallel \
                     ? GC_push_conditional_eager(b, t, all) \
                     : GC_push_conditional_static(b, t, all))
+#elif defined(PARALLEL_MARK)
+# ifndef ROOT_CHUNK_BYTES
+#   define ROOT_CHUNK_BYTES (256 * 1024)
+# endif
+
+  /* Push [bottom, top) as multiple mark stack entries of at most       */
+  /* ROOT_CHUNK_BYTES each, so that all the markers could take their    */
+  /* share of a large root from the global mark stack at once instead   */
+  /* of waiting for the marker which took the whole range to split it.  */
+  /* At most a quarter of the free mark stack space is used, the rest   */
+  /* of the range is pushed as a single entry.                          */
+  STATIC void GC_push_root_chunks(ptr_t bottom, ptr_t top)
+  {
+    word max_chunks = (word)(GC_mark_stack_limit - GC_mark_stack_top) / 4;
+
+    while ((word)(top - bottom) > ROOT_CHUNK_BYTES && max_chunks > 1) {
+      /* The chunk boundary is aligned not to miss a word.      */
+      ptr_t lim = (ptr_t)(((word)bottom + ROOT_CHUNK_BYTES)
+                          & ~(word)(ALIGNMENT-1));
+
+      GC_push_conditional_static(bottom, lim, TRUE);
+      bottom = lim;
+      max_chunks--;
+    }
+    GC_push_conditional_static(bottom, top, TRUE);
+  }
+
+# define GC_PUSH_CONDITIONAL(b, t, all) \
+                (GC_parallel && (all) \
+                    ? GC_push_root_chunks(b, t) \
+                    : GC_push_conditional_static(b, t, all))
 #else
 # define GC_PUSH_CONDITIONAL(b, t, all) GC_push_conditional_static(b, t, all)
 #endif
@@ -645,6 +769,217 @@ STATIC void GC_push_conditional_with_exclusions(ptr_t bottom, ptr_t top,
     }
 }
 
+#ifdef FROZEN_ROOTS
+  GC_INNER struct GC_frozen_root_s GC_frozen_roots[MAX_FROZEN_ROOTS];
+  GC_INNER int GC_n_frozen_roots = 0;
+
+  /* The buffer (swapped with fr_ptrs) to rebuild fr_ptrs into.         */
+  STATIC word *GC_frozen_spare_ptrs = NULL;
+  STATIC size_t GC_frozen_spare_cap = 0;
+
+  GC_INLINE GC_bool frozen_roots_tracked(void)
+  {
+#   ifdef PROC_VDB
+      return GC_incremental;
+#   else
+      return GC_incremental && GC_is_vdb_for_static_roots();
+#   endif
+  }
+
+  /* Set *plo and *phi to the part of the page k of r within the root.  */
+  GC_INLINE void frozen_page_bounds(const struct GC_frozen_root_s *r,
+                                    size_t k, ptr_t *plo, ptr_t *phi)
+  {
+    ptr_t page = (ptr_t)((word)r -> fr_start & ~(word)(HBLKSIZE-1))
+                 + k * HBLKSIZE;
+
+    *plo = 0 == k ? r -> fr_start : page;
+    *phi = k + 1 == r -> fr_n_pages ? r -> fr_end : page + HBLKSIZE;
+  }
+
+  GC_API void GC_CALL GC_add_frozen_roots(void *b, void *e)
+  {
+    DCL_LOCK_STATE;
+
+    if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+    b = (void *)(((word)b + (sizeof(word) - 1)) & ~(word)(sizeof(word) - 1));
+    e = (void *)((word)e & ~(word)(sizeof(word) - 1));
+    if ((word)b >= (word)e) return;
+
+    LOCK();
+    if (GC_n_frozen_roots < MAX_FROZEN_ROOTS) {
+      struct GC_frozen_root_s *r = &GC_frozen_roots[GC_n_frozen_roots];
+      size_t n_pages = ((word)e - 1) / HBLKSIZE - (word)b / HBLKSIZE + 1;
+
+      BZERO(r, sizeof(*r));
+      r -> fr_page_counts = (unsigned short *)GC_scratch_alloc(
+                                n_pages * sizeof(unsigned short));
+      r -> fr_stale = (unsigned char *)GC_scratch_alloc(n_pages);
+      if (EXPECT(r -> fr_page_counts != NULL && r -> fr_stale != NULL,
+                 TRUE)) {
+        r -> fr_start = (ptr_t)b;
+        r -> fr_end = (ptr_t)e;
+        r -> fr_n_pages = n_pages;
+        BZERO(r -> fr_stale, n_pages);
+        GC_n_frozen_roots++;
+        /* Do not scan the range as a part of the other roots.  */
+        GC_exclude_static_roots_inner(b, e);
+        UNLOCK();
+        return;
+      }
+    }
+    GC_COND_LOG_PRINTF("Cannot register frozen root %p .. %p;"
+                       " registering it as usual\n", b, e);
+    GC_add_roots_inner((ptr_t)b, (ptr_t)e, FALSE);
+    UNLOCK();
+  }
+
+  STATIC void GC_remove_frozen_roots_inner(ptr_t b, ptr_t e)
+  {
+    int i;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    for (i = 0; i < GC_n_frozen_roots; ) {
+      struct GC_frozen_root_s *r = &GC_frozen_roots[i];
+
+      if ((word)(r -> fr_start) >= (word)b
+          && (word)(r -> fr_end) <= (word)e) {
+#       ifndef GWW_VDB
+          GC_scratch_recycle_no_gww(r -> fr_ptrs,
+                                    r -> fr_ptrs_cap * sizeof(word));
+          GC_scratch_recycle_no_gww(r -> fr_page_counts,
+                                r -> fr_n_pages * sizeof(unsigned short));
+          GC_scratch_recycle_no_gww(r -> fr_stale, r -> fr_n_pages);
+#       endif
+        *r = GC_frozen_roots[--GC_n_frozen_roots];
+      } else {
+        i++;
+      }
+    }
+  }
+
+  GC_INNER void GC_note_frozen_roots_dirty(void)
+  {
+    int i;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    for (i = 0; i < GC_n_frozen_roots; i++) {
+      struct GC_frozen_root_s *r = &GC_frozen_roots[i];
+      size_t k;
+
+      if (!(r -> fr_valid)) continue;
+      for (k = 0; k < r -> fr_n_pages; k++) {
+        ptr_t lo, hi;
+
+        if (r -> fr_stale[k]) continue;
+        frozen_page_bounds(r, k, &lo, &hi);
+        if (GC_page_was_dirty((struct hblk *)lo)) {
+          r -> fr_stale[k] = 1;
+          r -> fr_n_stale++;
+        }
+      }
+    }
+  }
+
+  /* Rebuild fr_ptrs of r rescanning the stale pages (all of them if    */
+  /* r is not valid yet).  Returns FALSE if out of memory.  The world   */
+  /* is expected to be stopped.                                         */
+  STATIC GC_bool GC_rescan_frozen_root(struct GC_frozen_root_s *r)
+  {
+    size_t k;
+    size_t n = 0;
+    size_t old_ofs = 0;
+    word *ptrs;
+
+    for (k = 0; k < r -> fr_n_pages; k++) {
+      if (r -> fr_valid && !(r -> fr_stale[k])) {
+        n += r -> fr_page_counts[k];
+      } else {
+        ptr_t lo, hi;
+
+        frozen_page_bounds(r, k, &lo, &hi);
+        n += GC_collect_heap_ptrs(lo, hi, FALSE, NULL,
+                                  HBLKSIZE / sizeof(word));
+      }
+    }
+    if (n > GC_frozen_spare_cap) {
+      size_t new_cap = n + n / 4;
+      word *new_ptrs = (word *)GC_scratch_alloc(new_cap * sizeof(word));
+
+      if (EXPECT(NULL == new_ptrs, FALSE)) return FALSE;
+#     ifndef GWW_VDB
+        GC_scratch_recycle_no_gww(GC_frozen_spare_ptrs,
+                                  GC_frozen_spare_cap * sizeof(word));
+#     endif
+      GC_frozen_spare_ptrs = new_ptrs;
+      GC_frozen_spare_cap = new_cap;
+    }
+
+    ptrs = GC_frozen_spare_ptrs;
+    n = 0;
+    for (k = 0; k < r -> fr_n_pages; k++) {
+      size_t cnt = r -> fr_valid ? r -> fr_page_counts[k] : 0;
+
+      if (r -> fr_valid && !(r -> fr_stale[k])) {
+        BCOPY(r -> fr_ptrs + old_ofs, ptrs + n, cnt * sizeof(word));
+        old_ofs += cnt;
+      } else {
+        ptr_t lo, hi;
+
+        old_ofs += cnt;
+        frozen_page_bounds(r, k, &lo, &hi);
+        cnt = GC_collect_heap_ptrs(lo, hi, FALSE, ptrs + n,
+                                   GC_frozen_spare_cap - n);
+        r -> fr_page_counts[k] = (unsigned short)cnt;
+        r -> fr_stale[k] = 0;
+      }
+      n += cnt;
+    }
+
+    /* Swap the buffers.        */
+    GC_frozen_spare_ptrs = r -> fr_ptrs;
+    r -> fr_ptrs = ptrs;
+    k = r -> fr_ptrs_cap;
+    r -> fr_ptrs_cap = GC_frozen_spare_cap;
+    GC_frozen_spare_cap = k;
+    r -> fr_n_ptrs = n;
+    r -> fr_n_stale = 0;
+    r -> fr_valid = TRUE;
+    return TRUE;
+  }
+
+  STATIC void GC_push_frozen_roots(GC_bool all)
+  {
+    GC_bool tracked = frozen_roots_tracked();
+    int i;
+
+    for (i = 0; i < GC_n_frozen_roots; i++) {
+      struct GC_frozen_root_s *r = &GC_frozen_roots[i];
+      GC_bool push_all = all;
+
+      if (tracked && (!(r -> fr_valid) || r -> fr_n_stale > 0)) {
+        if (EXPECT(!GC_rescan_frozen_root(r), FALSE))
+          r -> fr_valid = FALSE;
+        push_all = TRUE; /* some remembered pointers are new */
+      }
+      if (!tracked || !(r -> fr_valid)) {
+        /* Push the root as usual (except for the exclusions), and      */
+        /* scan it again once tracked.                                  */
+        r -> fr_valid = FALSE;
+        GC_PUSH_CONDITIONAL(r -> fr_start, r -> fr_end, push_all);
+      } else if (push_all && r -> fr_n_ptrs > 0) {
+        GC_PUSH_CONDITIONAL((ptr_t)(r -> fr_ptrs),
+                            (ptr_t)(r -> fr_ptrs + r -> fr_n_ptrs), TRUE);
+      }
+    }
+  }
+#else
+  GC_API void GC_CALL GC_add_frozen_roots(void *b, void *e)
+  {
+    GC_add_roots(b, e);
+  }
+#endif /* !FROZEN_ROOTS */
+
 #if defined(E2K) || defined(IA64)
   /* Similar to GC_push_all_stack_sections() but for IA-64 registers store. */
   GC_INNER void GC_push_all_register_sections(ptr_t bs_lo, ptr_t bs_hi,
@@ -720,7 +1055,7 @@ STATIC void GC_push_all_stack_partially_eager(ptr_t bottom, ptr_t top,
                                               ptr_t cold_gc_frame)
 {
 #ifndef NEED_FIXUP_POINTER
-  if (GC_all_interior_pointers) {
+  if (GC_all_interior_pointers && !GC_have_exact_base_kinds) {
     /* Push the hot end of the stack eagerly, so that register values   */
     /* saved inside GC frames are marked before they disappear.         */
     /* The rest of the marking can be deferred until later.             */
@@ -812,7 +1147,7 @@ STATIC void GC_push_current_stack(ptr_t cold_gc_frame, void *context)
             {
                 ptr_t bsp = GC_save_regs_ret_val;
                 ptr_t cold_gc_bs_pointer = bsp - 2048;
-                if (GC_all_interior_pointers
+                if (GC_all_interior_pointers && !GC_have_exact_base_kinds
                     && (word)cold_gc_bs_pointer > (word)BACKING_STORE_BASE) {
                   /* Adjust cold_gc_bs_pointer if below our innermost   */
                   /* "traced stack section" in backing store.           */
@@ -850,12 +1185,54 @@ STATIC void GC_push_current_stack(ptr_t cold_gc_frame, void *context)
 
 GC_INNER void (*GC_push_typed_structures)(void) = 0;
 
+#ifdef THREADS
+  GC_INNER GC_bool GC_skip_unchanged_stacks = FALSE;
+#endif
+
+#ifdef DYNLIB_CACHE
+  GC_INNER word GC_dynlib_generation = 0;
+
+  STATIC word GC_dynlib_cache_hits = 0;
+                /* The number of times the registration of the dynamic  */
+                /* libraries was skipped by GC_dynlib_generation match. */
+#endif
+
+GC_API GC_word GC_CALL GC_get_dynlib_cache_hits(void)
+{
+# ifdef DYNLIB_CACHE
+    word value;
+    DCL_LOCK_STATE;
+
+    LOCK();
+    value = GC_dynlib_cache_hits;
+    UNLOCK();
+    return value;
+# else
+    return 0;
+# endif
+}
+
 GC_INNER void GC_cond_register_dynamic_libraries(void)
 {
   GC_ASSERT(I_HOLD_LOCK());
 # if (defined(DYNAMIC_LOADING) && !defined(MSWIN_XBOX1)) \
      || defined(CYGWIN32) || defined(MSWIN32) || defined(MSWINCE) \
      || defined(PCR)
+#   ifdef DYNLIB_CACHE
+      if (!GC_no_dls) {
+        word gen = GC_get_dynlib_generation();
+
+        if (gen != 0 && gen == GC_dynlib_generation) {
+          /* No library has been loaded or unloaded since the roots     */
+          /* were registered, thus the temporary roots are still valid. */
+          GC_dynlib_cache_hits++;
+          return;
+        }
+        GC_dynlib_generation = gen;
+      } else {
+        GC_dynlib_generation = 0;
+      }
+#   endif
     GC_remove_tmp_roots();
     if (!GC_no_dls) GC_register_dynamic_libraries();
 # else
@@ -903,6 +1280,9 @@ GC_INNER void GC_push_roots(GC_bool all, ptr_t cold_gc_frame)
                              GC_static_roots[i].r_start,
                              GC_static_roots[i].r_end, all);
     }
+#   ifdef FROZEN_ROOTS
+      GC_push_frozen_roots(all);
+#   endif
 
     /* Mark all free list header blocks, if those were allocated from   */
     /* the garbage collected heap.  This makes sure they don't          */
@@ -937,6 +1317,14 @@ GC_INNER void GC_push_roots(GC_bool all, ptr_t cold_gc_frame)
         if (GC_world_stopped)
             GC_mark_thread_local_free_lists();
 #   endif
+#   ifdef USE_READY_CHUNKS
+        if (GC_world_stopped)
+            GC_mark_ready_chunks();
+#   endif
+#   ifdef SHARDED_FREE_LISTS
+        if (GC_world_stopped)
+            GC_mark_fl_shards();
+#   endif
 
     /* Now traverse stacks, and mark from register contents.    */
     /* These must be done last, since they can legitimately     */
@@ -954,6 +1342,18 @@ GC_INNER void GC_push_roots(GC_bool all, ptr_t cold_gc_frame)
         /* Note that without interior pointer recognition lots  */
         /* of stuff may have been pushed already, and this      */
         /* should be careful about mark stack overflows.        */
+#       ifdef THREADS
+          /* An object explicitly deallocated could be reallocated      */
+          /* (unmarked) at the same address, thus a stack word that     */
+          /* has not changed could now reference an unmarked one.       */
+          GC_skip_unchanged_stacks = !all && GC_stack_watermarks
+                                        && 0 == GC_bytes_freed;
+#       endif
         (*GC_push_other_roots)();
+#       ifdef THREADS
+          GC_skip_unchanged_stacks = FALSE;
+#       endif
     }
+    if (GC_n_push_roots_procs > 0)
+        GC_push_client_roots();
 }
@@ -78,6 +78,8 @@ GC_INNER unsigned GC_n_mark_procs = GC_RESERVED_MARK_PROCS;
 
 GC_INNER unsigned GC_n_kinds = GC_N_KINDS_INITIAL_VALUE;
 
+GC_INNER GC_bool GC_have_exact_base_kinds = FALSE;
+
 GC_INNER GC_bool GC_debugging_started = FALSE;
                 /* defined here so we don't have to load dbg_mlc.o */
 
@@ -91,6 +93,18 @@ int GC_dont_gc = FALSE;
 
 int GC_dont_precollect = FALSE;
 
+#ifdef FAST_STARTUP
+  GC_INNER GC_bool GC_fast_startup = TRUE;
+#else
+  GC_INNER GC_bool GC_fast_startup = FALSE;
+#endif
+
+GC_INNER word GC_deferred_heapsize = 0;
+
+#ifdef CAN_DEFER_ROOTS
+  GC_INNER GC_bool GC_roots_deferred = FALSE;
+#endif
+
 GC_bool GC_quiet = 0; /* used also in pcr_interface.c */
 
 #if !defined(NO_CLOCK) || !defined(SMALL_CONFIG)
@@ -280,17 +294,16 @@ STATIC void GC_init_size_map(void)
 
 # ifdef THREADS
 #   define BIG_CLEAR_SIZE 2048  /* Clear this much now and then.        */
+#   if !defined(MAX_CLEAR_SIZE) && defined(THREAD_LOCAL_ALLOC)
+#     define MAX_CLEAR_SIZE 4096
+                        /* Clear at most this much per call, so that    */
+                        /* the cost is bounded even if a thread has     */
+                        /* returned from a deep recursion.              */
+#   endif
 # else
-    STATIC word GC_stack_last_cleared = 0; /* GC_no when we last did this */
-    STATIC ptr_t GC_min_sp = NULL;
-                        /* Coolest stack pointer value from which       */
-                        /* we've already cleared the stack.             */
-    STATIC ptr_t GC_high_water = NULL;
-                        /* "hottest" stack pointer value we have seen   */
-                        /* recently.  Degrades over time.               */
-    STATIC word GC_bytes_allocd_at_reset = 0;
-#   define DEGRADE_RATE 50
+    STATIC struct GC_clear_stack_s GC_clear_stack_state;
 # endif
+# define DEGRADE_RATE 50
 
 # if defined(ASM_CLEAR_CODE)
     void *GC_clear_stack_inner(void *, ptr_t);
@@ -322,6 +335,86 @@ STATIC void GC_init_size_map(void)
     }
 # endif /* !ASM_CLEAR_CODE */
 
+# if !defined(THREADS) || defined(THREAD_LOCAL_ALLOC)
+#   define SLOP 400
+        /* Extra bytes we clear every time.  This clears our own        */
+        /* activation record, and should cause more frequent            */
+        /* clearing near the cold end of the stack, a good thing.       */
+#   define GC_SLOP 4000
+        /* We make high_water this much hotter than we really saw it,   */
+        /* to cover for GC noise etc. above our current frame.          */
+#   define CLEAR_THRESHOLD 100000
+        /* We restart the clearing process after this many bytes of     */
+        /* allocation.  Otherwise very heavily recursive programs       */
+        /* with sparse stacks may result in heaps that grow almost      */
+        /* without bounds.  As the heap gets larger, collection         */
+        /* frequency decreases, thus clearing frequency would decrease, */
+        /* thus more junk remains accessible, thus the heap gets        */
+        /* larger ...                                                   */
+
+    /* Clear the part of the stack (hotter than sp) which has been used */
+    /* since the clearing was restarted (i.e. down to the watermark)    */
+    /* but is not cleared yet.  The clearing state is either global or  */
+    /* that of the current thread.  Returns arg.                        */
+    GC_ATTR_NO_SANITIZE_THREAD
+    static void *clear_stack_watermark(void *arg, ptr_t sp,
+                                       struct GC_clear_stack_s *cs)
+    {
+      if (GC_gc_no > cs -> last_cleared) {
+        /* Start things over, so we clear the entire stack again */
+        if (0 == cs -> last_cleared) {
+#         ifdef THREADS
+            cs -> high_water = sp;
+#         else
+            cs -> high_water = (ptr_t)GC_stackbottom;
+#         endif
+        }
+        cs -> min_sp = cs -> high_water;
+        cs -> last_cleared = GC_gc_no;
+        cs -> bytes_allocd_at_reset = GC_bytes_allocd;
+      }
+      /* Adjust high_water */
+      MAKE_COOLER(cs -> high_water, WORDS_TO_BYTES(DEGRADE_RATE) + GC_SLOP);
+      if ((word)sp HOTTER_THAN (word)(cs -> high_water)) {
+          cs -> high_water = sp;
+      }
+      MAKE_HOTTER(cs -> high_water, GC_SLOP);
+      {
+        ptr_t limit = cs -> min_sp;
+
+        MAKE_HOTTER(limit, SLOP);
+        if ((word)sp COOLER_THAN (word)limit) {
+#         ifdef MAX_CLEAR_SIZE
+            ptr_t max_limit = sp;
+
+            MAKE_HOTTER(max_limit, MAX_CLEAR_SIZE * sizeof(word));
+            if ((word)limit HOTTER_THAN (word)max_limit)
+              limit = max_limit;
+#         endif
+          limit = (ptr_t)((word)limit & ~0xf);
+                          /* Make it sufficiently aligned for assembly  */
+                          /* implementations of GC_clear_stack_inner.   */
+          cs -> min_sp = sp;
+#         ifdef STACK_GROWS_DOWN
+            cs -> cleared_bytes += (word)(sp - limit);
+#         else
+            cs -> cleared_bytes += (word)(limit - sp);
+#         endif
+          return GC_clear_stack_inner(arg, limit);
+        }
+      }
+      if (GC_bytes_allocd - cs -> bytes_allocd_at_reset > CLEAR_THRESHOLD) {
+        /* Restart clearing process, but limit how much clearing we do. */
+        cs -> min_sp = sp;
+        MAKE_HOTTER(cs -> min_sp, CLEAR_THRESHOLD/4);
+        if ((word)(cs -> min_sp) HOTTER_THAN (word)(cs -> high_water))
+          cs -> min_sp = cs -> high_water;
+        cs -> bytes_allocd_at_reset = GC_bytes_allocd;
+      }
+      return arg;
+    }
+# endif
+
 # ifdef THREADS
     /* Used to occasionally clear a bigger chunk.       */
     /* TODO: Should be more random than it is ...       */
@@ -346,25 +439,16 @@ STATIC void GC_init_size_map(void)
   {
     ptr_t sp = GC_approx_sp();  /* Hotter than actual sp */
 #   ifdef THREADS
-        word volatile dummy[SMALL_CLEAR_SIZE];
-#   endif
+      word volatile dummy[SMALL_CLEAR_SIZE];
+#     ifdef THREAD_LOCAL_ALLOC
+        struct GC_clear_stack_s *cs = GC_my_clear_stack_state();
 
-#   define SLOP 400
-        /* Extra bytes we clear every time.  This clears our own        */
-        /* activation record, and should cause more frequent            */
-        /* clearing near the cold end of the stack, a good thing.       */
-#   define GC_SLOP 4000
-        /* We make GC_high_water this much hotter than we really saw    */
-        /* it, to cover for GC noise etc. above our current frame.      */
-#   define CLEAR_THRESHOLD 100000
-        /* We restart the clearing process after this many bytes of     */
-        /* allocation.  Otherwise very heavily recursive programs       */
-        /* with sparse stacks may result in heaps that grow almost      */
-        /* without bounds.  As the heap gets larger, collection         */
-        /* frequency decreases, thus clearing frequency would decrease, */
-        /* thus more junk remains accessible, thus the heap gets        */
-        /* larger ...                                                   */
-#   ifdef THREADS
+        if (EXPECT(cs != NULL, TRUE))
+          return clear_stack_watermark(arg, sp, cs);
+#     endif
+
+      /* The thread is not registered yet, or the thread-local state    */
+      /* is not available, thus clear randomly.                         */
       if (next_random_no() == 0) {
         ptr_t limit = sp;
 
@@ -375,43 +459,10 @@ STATIC void GC_init_size_map(void)
         return GC_clear_stack_inner(arg, limit);
       }
       BZERO((void *)dummy, SMALL_CLEAR_SIZE*sizeof(word));
+      return arg;
 #   else
-      if (GC_gc_no > GC_stack_last_cleared) {
-        /* Start things over, so we clear the entire stack again */
-        if (GC_stack_last_cleared == 0)
-          GC_high_water = (ptr_t)GC_stackbottom;
-        GC_min_sp = GC_high_water;
-        GC_stack_last_cleared = GC_gc_no;
-        GC_bytes_allocd_at_reset = GC_bytes_allocd;
-      }
-      /* Adjust GC_high_water */
-      MAKE_COOLER(GC_high_water, WORDS_TO_BYTES(DEGRADE_RATE) + GC_SLOP);
-      if ((word)sp HOTTER_THAN (word)GC_high_water) {
-          GC_high_water = sp;
-      }
-      MAKE_HOTTER(GC_high_water, GC_SLOP);
-      {
-        ptr_t limit = GC_min_sp;
-
-        MAKE_HOTTER(limit, SLOP);
-        if ((word)sp COOLER_THAN (word)limit) {
-          limit = (ptr_t)((word)limit & ~0xf);
-                          /* Make it sufficiently aligned for assembly  */
-                          /* implementations of GC_clear_stack_inner.   */
-          GC_min_sp = sp;
-          return GC_clear_stack_inner(arg, limit);
-        }
-      }
-      if (GC_bytes_allocd - GC_bytes_allocd_at_reset > CLEAR_THRESHOLD) {
-        /* Restart clearing process, but limit how much clearing we do. */
-        GC_min_sp = sp;
-        MAKE_HOTTER(GC_min_sp, CLEAR_THRESHOLD/4);
-        if ((word)GC_min_sp HOTTER_THAN (word)GC_high_water)
-          GC_min_sp = GC_high_water;
-        GC_bytes_allocd_at_reset = GC_bytes_allocd;
-      }
+      return clear_stack_watermark(arg, sp, &GC_clear_stack_state);
 #   endif
-    return arg;
   }
 
 #endif /* !ALWAYS_SMALL_CLEAR_STACK && !STACK_NOT_SCANNED */
@@ -422,14 +473,16 @@ GC_API void * GC_CALL GC_base(void * p)
 {
     ptr_t r;
     struct hblk *h;
-    bottom_index *bi;
     hdr *candidate_hdr;
 
     r = (ptr_t)p;
     if (!EXPECT(GC_is_initialized, TRUE)) return NULL;
+    /* The heap lies entirely within the plausible range, which is      */
+    /* tight if the heap is grown inside the arena.                     */
+    if ((word)r < (word)GC_least_plausible_heap_addr
+        || (word)r >= (word)GC_greatest_plausible_heap_addr) return NULL;
     h = HBLKPTR(r);
-    GET_BI(r, bi);
-    candidate_hdr = HDR_FROM_BI(bi, r);
+    GET_HDR(r, candidate_hdr);
     if (NULL == candidate_hdr) return NULL;
     /* If it's a pointer to the middle of a large object, move it       */
     /* to the beginning.                                                */
@@ -440,6 +493,27 @@ GC_API void * GC_CALL GC_base(void * p)
         }
     if (HBLK_IS_FREE(candidate_hdr)) return NULL;
     /* Make sure r points to the beginning of the object */
+#   ifdef MARK_BIT_PER_GRANULE
+      if (EXPECT((candidate_hdr -> hb_flags & LARGE_BLOCK) == 0, TRUE)) {
+        /* Avoid the division by using the table of remainders (the     */
+        /* same one as used by the marker, see GC_obj_map).  The header */
+        /* might be updated concurrently (if the lock is not held), so  */
+        /* each field is loaded once and the result is checked to be    */
+        /* inside the block.                                            */
+        unsigned short *map = candidate_hdr -> hb_map;
+        word sz = candidate_hdr -> hb_sz;
+        ptr_t limit;
+
+        if (EXPECT(NULL == map, FALSE)) return NULL;
+        r = (ptr_t)((word)r & ~(word)(GRANULE_BYTES - 1))
+            - GRANULES_TO_BYTES((word)map[BYTES_TO_GRANULES(HBLKDISPL(r))]);
+        limit = r + sz;
+        if ((word)r < (word)h || (word)limit > (word)(h + 1)
+            || (word)p >= (word)limit)
+          return NULL;
+        return (void *)r;
+      }
+#   endif
         r = (ptr_t)((word)r & ~(WORDS_TO_BYTES(1) - 1));
         {
             word sz = candidate_hdr -> hb_sz;
@@ -457,11 +531,13 @@ GC_API void * GC_CALL GC_base(void * p)
 /* Return TRUE if and only if p points to somewhere in GC heap. */
 GC_API int GC_CALL GC_is_heap_ptr(const void *p)
 {
-    bottom_index *bi;
+    hdr *hhdr;
 
     GC_ASSERT(GC_is_initialized);
-    GET_BI(p, bi);
-    return HDR_FROM_BI(bi, p) != 0;
+    if ((word)p < (word)GC_least_plausible_heap_addr
+        || (word)p >= (word)GC_greatest_plausible_heap_addr) return 0;
+    GET_HDR(p, hhdr);
+    return hhdr != 0;
 }
 
 /* Return the size of an object, given a pointer to its base.           */
@@ -469,8 +545,9 @@ GC_API int GC_CALL GC_is_heap_ptr(const void *p)
 /* but that shouldn't be relied upon.)                                  */
 GC_API size_t GC_CALL GC_size(const void * p)
 {
-    hdr * hhdr = HDR(p);
+    hdr * hhdr;
 
+    GET_HDR(p, hhdr);
     return (size_t)hhdr->hb_sz;
 }
 
@@ -563,8 +640,26 @@ GC_API void GC_CALL GC_get_heap_usage_safe(GC_word *pheap_size,
     pstats->bytes_reclaimed_since_gc = GC_bytes_found > 0 ?
                                         (word)GC_bytes_found : 0;
     pstats->reclaimed_bytes_before_gc = GC_reclaimed_bytes_before_gc;
-    pstats->expl_freed_bytes_since_gc = GC_bytes_freed; /* since gc-7.7 */
+    pstats->expl_freed_bytes_since_gc = GC_EXPL_FREED_BYTES();
+                                        /* since gc-7.7 */
     pstats->obtained_from_os_bytes = GC_our_mem_bytes; /* since gc-8.2 */
+#   ifdef PARALLEL_MARK
+      pstats->parallel_reclaim_ns = GC_parallel_reclaim_ns;
+      pstats->parallel_reclaim_work_ns = GC_parallel_reclaim_work_ns;
+#   else
+      pstats->parallel_reclaim_ns = 0;
+      pstats->parallel_reclaim_work_ns = 0;
+#   endif
+#   ifdef PARALLEL_MARK
+      pstats->hdr_cache_hits = (word)AO_load(&GC_hdr_cache_hits);
+      pstats->hdr_cache_misses = (word)AO_load(&GC_hdr_cache_misses);
+#   else
+      pstats->hdr_cache_hits = GC_hdr_cache_hits;
+      pstats->hdr_cache_misses = GC_hdr_cache_misses;
+#   endif
+    pstats->black_list_rejects = GC_black_list_rejects;
+    pstats->black_list_entries = (word)1 << GC_log_bl_entries;
+    pstats->external_bytes = GC_get_external_bytes_inner();
   }
 
 # include <string.h> /* for memset() */
@@ -618,6 +713,56 @@ GC_API void GC_CALL GC_get_heap_usage_safe(GC_word *pheap_size,
 
 #endif /* !GC_GET_HEAP_USAGE_NOT_NEEDED */
 
+GC_API size_t GC_CALL GC_get_my_thread_stats(struct GC_thread_stats_s *pstats,
+                                             size_t stats_sz)
+{
+    struct GC_thread_stats_s stats;
+
+    BZERO(&stats, sizeof(stats));
+#   ifdef THREAD_STATS
+      {
+        DCL_LOCK_STATE;
+
+        LOCK();
+        GC_fill_my_thread_stats(&stats);
+        UNLOCK();
+      }
+#   elif !defined(THREADS) && !defined(ALWAYS_SMALL_CLEAR_STACK) \
+         && !defined(STACK_NOT_SCANNED)
+      stats.stack_cleared_bytes = GC_clear_stack_state.cleared_bytes;
+#   endif
+    if (stats_sz >= sizeof(stats)) {
+      BCOPY(&stats, pstats, sizeof(stats));
+      if (stats_sz > sizeof(stats)) {
+        /* Fill in the remaining part with -1.    */
+        memset((char *)pstats + sizeof(stats), 0xff,
+               stats_sz - sizeof(stats));
+      }
+      return sizeof(stats);
+    }
+    if (EXPECT(stats_sz > 0, TRUE))
+      BCOPY(&stats, pstats, stats_sz);
+    return stats_sz;
+}
+
+#ifndef PRECISE_STACK_ROOTS
+  /* The thread stacks are always scanned conservatively.       */
+  GC_API int GC_CALL GC_set_my_stack_roots_proc(GC_stack_roots_proc fn,
+                                                void *client_data)
+  {
+    UNUSED_ARG(fn);
+    UNUSED_ARG(client_data);
+    return 0;
+  }
+
+  GC_API GC_stack_roots_proc GC_CALL GC_get_my_stack_roots_proc(
+                                                void **pclient_data)
+  {
+    if (pclient_data != NULL) *pclient_data = NULL;
+    return 0;
+  }
+#endif /* !PRECISE_STACK_ROOTS */
+
 #if defined(THREADS) && !defined(SIGNAL_BASED_STOP_WORLD)
   /* GC does not use signals to suspend and restart threads.    */
   GC_API void GC_CALL GC_set_suspend_signal(int sig)
@@ -639,6 +784,33 @@ GC_API void GC_CALL GC_get_heap_usage_safe(GC_word *pheap_size,
   {
     return -1;
   }
+
+  volatile GC_word GC_safepoint_requested = 0;
+
+  GC_API void GC_CALL GC_set_cooperative_suspend(int value)
+  {
+    UNUSED_ARG(value);
+  }
+
+  GC_API int GC_CALL GC_get_cooperative_suspend(void)
+  {
+    return 0;
+  }
+
+  GC_API void GC_CALL GC_set_safepoint_timeout(unsigned long us)
+  {
+    UNUSED_ARG(us);
+  }
+
+  GC_API unsigned long GC_CALL GC_get_safepoint_timeout(void)
+  {
+    return 0;
+  }
+
+  GC_API void GC_CALL GC_safepoint(void)
+  {
+    /* Threads are not suspended cooperatively. */
+  }
 #endif /* THREADS && !SIGNAL_BASED_STOP_WORLD */
 
 #if !defined(_MAX_PATH) && (defined(MSWIN32) || defined(MSWINCE) \
@@ -927,16 +1099,73 @@ STATIC word GC_parse_mem_size_arg(const char *str)
 
 #define GC_LOG_STD_NAME "gc.log"
 
+#if defined(LIFETIME_SAMPLING) && !defined(DONT_USE_ATEXIT)
+  static void GC_print_lifetime_stats_at_exit(void)
+  {
+    GC_print_lifetime_stats();
+  }
+#endif
+
+#if defined(HEAP_PROFILE) && !defined(DONT_USE_ATEXIT)
+  static void GC_write_heap_profile_at_exit(void)
+  {
+    char * path = GETENV("GC_HEAP_PROFILE");
+
+    if (path != NULL && GC_write_heap_profile(path) != 0)
+      WARN("Cannot write heap profile\n", 0);
+  }
+#endif
+
+static size_t initial_heap_size_hint = 0;
+                        /* Set by GC_set_initial_heap_size before the   */
+                        /* collector initialization; zero means unset.  */
+
+GC_API void GC_CALL GC_set_initial_heap_size(size_t bytes)
+{
+    initial_heap_size_hint = bytes;
+    if (GC_is_initialized) {
+      /* Just expand the heap up to the given size.  The unlocked read  */
+      /* of GC_heapsize is harmless here.                               */
+      word heap_size = GC_heapsize;
+
+      if (bytes > heap_size)
+        (void)GC_expand_hp(bytes - (size_t)heap_size);
+    }
+}
+
+GC_API size_t GC_CALL GC_get_initial_heap_size(void)
+{
+    return initial_heap_size_hint;
+}
+
+#ifdef CAN_DEFER_ROOTS
+  GC_INNER void GC_register_deferred_roots(void)
+  {
+    GC_ASSERT(I_HOLD_LOCK());
+    GC_roots_deferred = FALSE;
+#   ifdef SEARCH_FOR_DATA_START
+      if (NULL == GC_data_start) GC_init_linux_data_start();
+#   endif
+    GC_register_data_segments();
+  }
+#endif /* CAN_DEFER_ROOTS */
+
 GC_API void GC_CALL GC_init(void)
 {
     /* LOCK(); -- no longer does anything this early. */
     word initial_heap_sz;
     IF_CANCEL(int cancel_state;)
+#   ifndef NO_CLOCK
+      CLOCK_TYPE start_time = CLOCK_TYPE_INITIALIZER;
+#   endif
 #   if defined(GC_ASSERTIONS) && defined(GC_ALWAYS_MULTITHREADED)
       DCL_LOCK_STATE;
 #   endif
 
     if (EXPECT(GC_is_initialized, TRUE)) return;
+#   ifndef NO_CLOCK
+      GET_TIME(start_time);
+#   endif
 #   ifdef REDIRECT_MALLOC
       {
         static GC_bool init_started = FALSE;
@@ -949,8 +1178,10 @@ GC_API void GC_CALL GC_init(void)
 #   if defined(GC_INITIAL_HEAP_SIZE) && !defined(CPPCHECK)
       initial_heap_sz = GC_INITIAL_HEAP_SIZE;
 #   else
-      initial_heap_sz = MINHINCR * HBLKSIZE;
+      initial_heap_sz = GC_get_min_heap_increment();
 #   endif
+    if (initial_heap_size_hint != 0)
+      initial_heap_sz = initial_heap_size_hint;
 
     DISABLE_CANCEL(cancel_state);
     /* Note that although we are nominally called with the */
@@ -1101,6 +1332,21 @@ GC_API void GC_CALL GC_init(void)
         GC_dont_gc = 1;
 #     endif
     }
+    if (0 != GETENV("GC_FAST_STARTUP")) {
+      GC_fast_startup = TRUE;
+    }
+    if (0 != GETENV("GC_PARALLEL_RECLAIM")) {
+      GC_set_parallel_reclaim(1);
+    }
+    if (0 != GETENV("GC_LAZY_CLEAR")) {
+      GC_set_lazy_clear(1);
+    }
+    if (0 != GETENV("GC_BUMP_ALLOC")) {
+      GC_set_bump_alloc(1);
+    }
+    if (0 != GETENV("GC_BATCHED_FREE")) {
+      GC_set_batched_free(1);
+    }
     if (0 != GETENV("GC_PRINT_BACK_HEIGHT")) {
       GC_print_back_height = TRUE;
     }
@@ -1150,6 +1396,16 @@ GC_API void GC_CALL GC_init(void)
             GC_full_freq = full_freq;
         }
       }
+#   endif
+#   ifndef SHORT_DBG_HDRS
+      {
+        char * period_string = GETENV("GC_DEBUG_CHECK_HEAP_PERIOD");
+        if (period_string != NULL) {
+          int period = atoi(period_string);
+          if (period >= 0)
+            GC_set_debug_check_heap_period((unsigned)period);
+        }
+      }
 #   endif
     {
       char * interval_string = GETENV("GC_LARGE_ALLOC_WARN_INTERVAL");
@@ -1171,6 +1427,34 @@ GC_API void GC_CALL GC_init(void)
             GC_free_space_divisor = (unsigned)space_divisor;
         }
     }
+    {
+        char * growth_string = GETENV("GC_HEAP_GROWTH_PERCENT");
+        if (growth_string != NULL) {
+          int percent = atoi(growth_string);
+          if (percent > 0)
+            GC_set_heap_growth_percent((unsigned)percent);
+        }
+    }
+#   ifndef NO_CLOCK
+      {
+        char * cpu_string = GETENV("GC_CPU_PERCENT");
+        if (cpu_string != NULL) {
+          int percent = atoi(cpu_string);
+          if (percent > 0 && percent < 100)
+            GC_set_gc_cpu_percent((unsigned)percent);
+        }
+      }
+#   endif
+#   if !defined(GC_NO_FINALIZATION) && !defined(GC_MOVABLE_NOT_NEEDED)
+      {
+        char * evac_string = GETENV("GC_EVACUATION_THRESHOLD");
+        if (evac_string != NULL) {
+          int percent = atoi(evac_string);
+          if (percent >= 0 && percent <= 100)
+            GC_set_evacuation_threshold((unsigned)percent);
+        }
+      }
+#   endif
 #   ifdef USE_MUNMAP
       {
         char * string = GETENV("GC_UNMAP_THRESHOLD");
@@ -1220,6 +1504,10 @@ GC_API void GC_CALL GC_init(void)
 #   endif
     GC_exclude_static_roots_inner(beginGC_arrays, endGC_arrays);
     GC_exclude_static_roots_inner(beginGC_obj_kinds, endGC_obj_kinds);
+#   ifndef GC_DISABLE_INCREMENTAL
+      GC_exclude_static_roots_inner(GC_card_table,
+                                    GC_card_table + sizeof(GC_card_table));
+#   endif
 #   ifdef SEPARATE_GLOBALS
       GC_exclude_static_roots_inner(beginGC_objfreelist, endGC_objfreelist);
       GC_exclude_static_roots_inner(beginGC_aobjfreelist, endGC_aobjfreelist);
@@ -1267,12 +1555,23 @@ GC_API void GC_CALL GC_init(void)
       GC_ASSERT(!((word)GC_stackbottom HOTTER_THAN (word)GC_approx_sp()));
 #   endif
     GC_init_headers();
+#   ifdef SIMD_PTR_FILTER
+      GC_init_ptr_filter();
+#   endif
 #   ifdef SEARCH_FOR_DATA_START
       /* For MPROTECT_VDB, the temporary fault handler should be        */
       /* installed first, before the write fault one in GC_dirty_init.  */
-      if (GC_REGISTER_MAIN_STATIC_DATA()) GC_init_linux_data_start();
+      if (GC_REGISTER_MAIN_STATIC_DATA() && !GC_fast_startup)
+        GC_init_linux_data_start();
 #   endif
+    if (0 != GETENV("GC_STACK_WATERMARKS")) {
+      GC_stack_watermarks = TRUE;
+    }
 #   ifndef GC_DISABLE_INCREMENTAL
+      if (0 != GETENV("GC_ENABLE_GENERATIONAL")) {
+        GC_time_limit = GC_TIME_UNLIMITED;
+        GC_incremental = TRUE; /* indicate intention to turn it on */
+      }
       if (GC_incremental || 0 != GETENV("GC_ENABLE_INCREMENTAL")) {
 #       if defined(BASE_ATOMIC_OPS_EMULATED) || defined(CHECKSUMS) \
            || defined(REDIRECT_MALLOC) || defined(REDIRECT_MALLOC_IN_HEADER) \
@@ -1287,6 +1586,10 @@ GC_API void GC_CALL GC_init(void)
         /* else */ {
           /* For GWW_VDB on Win32, this needs to happen before any      */
           /* heap memory is allocated.                                  */
+#         ifdef SEARCH_FOR_DATA_START
+            if (GC_REGISTER_MAIN_STATIC_DATA() && NULL == GC_data_start)
+              GC_init_linux_data_start(); /* not done above */
+#         endif
           GC_incremental = GC_dirty_init();
           GC_ASSERT(GC_bytes_allocd == 0);
         }
@@ -1295,7 +1598,20 @@ GC_API void GC_CALL GC_init(void)
 
     /* Add initial guess of root sets.  Do this first, since sbrk(0)    */
     /* might be used.                                                   */
-      if (GC_REGISTER_MAIN_STATIC_DATA()) GC_register_data_segments();
+    if (GC_REGISTER_MAIN_STATIC_DATA()) {
+#     ifdef CAN_DEFER_ROOTS
+        if (GC_fast_startup && !GC_incremental) {
+          GC_roots_deferred = TRUE; /* till the first collection */
+        } else
+#     endif
+      /* else */ {
+#       ifdef SEARCH_FOR_DATA_START
+          if (NULL == GC_data_start)
+            GC_init_linux_data_start(); /* not done above */
+#       endif
+        GC_register_data_segments();
+      }
+    }
 
     GC_bl_init();
     GC_mark_init();
@@ -1322,7 +1638,58 @@ GC_API void GC_CALL GC_init(void)
           }
         }
     }
-    if (initial_heap_sz != 0) {
+    {
+        char * sz_str = GETENV("GC_SOFT_HEAP_LIMIT");
+        if (sz_str != NULL) {
+          word limit = GC_parse_mem_size_arg(sz_str);
+          if (GC_WORD_MAX == limit) {
+            WARN("Bad soft heap limit %s - ignoring\n", sz_str);
+          } else {
+            GC_set_soft_heap_limit(limit);
+          }
+        }
+#       ifdef CGROUP_MEMORY_LIMIT
+          else if (0 == GC_get_soft_heap_limit()) {
+            word cgroup_limit = GC_cgroup_memory_limit();
+
+            if (cgroup_limit != 0) {
+#             ifndef CGROUP_SOFT_LIMIT_PERCENT
+#               define CGROUP_SOFT_LIMIT_PERCENT 80
+#             endif
+              GC_set_soft_heap_limit(cgroup_limit / 100
+                                        * CGROUP_SOFT_LIMIT_PERCENT);
+              GC_COND_LOG_PRINTF("Soft heap limit: %lu KiB"
+                                 " (cgroup memory.max: %lu KiB)\n",
+                                 TO_KiB_UL(GC_get_soft_heap_limit()),
+                                 TO_KiB_UL(cgroup_limit));
+            }
+          }
+#       endif
+    }
+#   ifdef USE_HUGE_PAGES
+      if (0 != GETENV("GC_HUGE_PAGES")) GC_huge_pages = TRUE;
+#   endif
+#   ifdef USE_LARGE_OBJ_SPACE
+      {
+        char * sz_str = GETENV("GC_LARGE_OBJECT_THRESHOLD");
+        if (sz_str != NULL) {
+          word value = GC_parse_mem_size_arg(sz_str);
+          if (GC_WORD_MAX == value) {
+            WARN("Bad large object threshold %s - ignoring\n", sz_str);
+          } else {
+            GC_los_threshold = value;
+          }
+        }
+      }
+#   endif
+#   ifdef USE_NUMA
+      if (0 != GETENV("GC_NUMA")) GC_set_numa_mode(1);
+      GC_numa_init();
+#   endif
+    if (initial_heap_sz != 0 && GC_fast_startup && !GC_incremental) {
+      /* Let the first allocation expand the heap.      */
+      GC_deferred_heapsize = initial_heap_sz;
+    } else if (initial_heap_sz != 0) {
       if (!GC_expand_hp_inner(divHBLKSZ(initial_heap_sz))) {
         GC_err_printf("Can't start up: not enough memory\n");
         EXIT();
@@ -1340,6 +1707,25 @@ GC_API void GC_CALL GC_init(void)
       }
 #   endif
     GC_init_size_map();
+    {
+      char * classes_str = GETENV("GC_SIZE_CLASSES");
+      if (classes_str != NULL) {
+        size_t sizes[MAXOBJGRANULES];
+        size_t n = 0;
+        char *p = classes_str;
+
+        while (*p != '\0' && n < MAXOBJGRANULES) {
+          sizes[n++] = (size_t)STRTOULL(p, &p, 10);
+          if (*p == ',') p++;
+          else if (*p != '\0') break;
+        }
+        if (*p != '\0' || !GC_set_size_classes_inner(sizes, n))
+          WARN("Bad size classes list %s - ignoring\n", classes_str);
+      }
+    }
+#   ifdef BITMAP_SWEEP
+      GC_init_obj_start_masks();
+#   endif
 #   ifdef PCR
       if (PCR_IL_Lock(PCR_Bool_false, PCR_allSigsBlocked, PCR_waitForever)
           != PCR_ERes_okay) {
@@ -1351,6 +1737,9 @@ GC_API void GC_CALL GC_init(void)
       GC_pcr_install();
 #   endif
     GC_is_initialized = TRUE;
+#   ifdef COMPRESSED_REFS
+      GC_init_compressed_refs(); /* allocates a free list */
+#   endif
 #   ifdef THREADS
 #       if defined(LINT2) \
            && !(defined(GC_ASSERTIONS) && defined(GC_ALWAYS_MULTITHREADED))
@@ -1363,7 +1752,7 @@ GC_API void GC_CALL GC_init(void)
 #   endif
     COND_DUMP;
     /* Get black list set up and/or incremental GC started */
-    if (!GC_dont_precollect || GC_incremental) {
+    if ((!GC_dont_precollect && !GC_fast_startup) || GC_incremental) {
         GC_gcollect_inner();
     }
 #   if defined(GC_ASSERTIONS) && defined(GC_ALWAYS_MULTITHREADED)
@@ -1371,7 +1760,7 @@ GC_API void GC_CALL GC_init(void)
 #   endif
 #   if defined(THREADS) && defined(UNIX_LIKE) && !defined(NO_GETCONTEXT)
       /* Ensure getcontext_works is set to avoid potential data race.   */
-      if (GC_dont_gc || GC_dont_precollect)
+      if (GC_dont_gc || GC_dont_precollect || GC_fast_startup)
         GC_with_callee_saves_pushed(callee_saves_pushed_dummy_fn, NULL);
 #   endif
 #   ifndef DONT_USE_ATEXIT
@@ -1389,11 +1778,117 @@ GC_API void GC_CALL GC_init(void)
       /* Initialize thread-local allocation.    */
       GC_init_parallel();
 #   endif
+#   ifdef CONCURRENT_MARK
+      {
+        char * slice_string = GETENV("GC_CONCURRENT_MARK_SLICE");
+
+        if (slice_string != NULL) {
+          long slice = atol(slice_string);
+
+          if (slice >= 0)
+            GC_set_concurrent_mark_slice((unsigned long)slice);
+        }
+      }
+      if (GC_incremental && 0 != GETENV("GC_CONCURRENT_MARK"))
+        GC_start_concurrent_marker();
+#   endif
+#   ifdef BACKGROUND_GC
+      if (0 != GETENV("GC_BACKGROUND_GC"))
+        GC_start_background_gc();
+#   endif
+#   ifdef SCAVENGER_THREAD
+      {
+        char * rate_str = GETENV("GC_SCAVENGER_RATE");
+        if (rate_str != NULL) {
+          word rate = GC_parse_mem_size_arg(rate_str);
+          if (GC_WORD_MAX == rate) {
+            WARN("Bad scavenger rate %s - ignoring\n", rate_str);
+          } else {
+            GC_set_scavenger_rate((size_t)rate);
+          }
+        }
+      }
+#   endif
+#   ifdef HEAP_PROFILE
+      {
+        char * rate_str = GETENV("GC_HEAP_PROFILE_RATE");
+        if (rate_str != NULL) {
+          word rate = GC_parse_mem_size_arg(rate_str);
+          if (GC_WORD_MAX == rate) {
+            WARN("Bad heap profile rate %s - ignoring\n", rate_str);
+          } else {
+            GC_set_heap_profile_rate((size_t)rate);
+          }
+        }
+        if (GETENV("GC_SAMPLED_LEAK_CHECK") != NULL)
+          GC_set_sampled_leak_check(1);
+#       ifndef DONT_USE_ATEXIT
+          if (GETENV("GC_HEAP_PROFILE") != NULL)
+            atexit(GC_write_heap_profile_at_exit);
+#       endif
+      }
+#   endif
+#   ifdef LIFETIME_SAMPLING
+      {
+        char * interval_str = GETENV("GC_LIFETIME_SAMPLING");
+        if (interval_str != NULL) {
+          int interval = atoi(interval_str);
+          if (interval <= 0) {
+            WARN("Bad lifetime sampling interval %s - ignoring\n",
+                 interval_str);
+          } else {
+            GC_set_lifetime_sampling((unsigned)interval);
+#           ifndef DONT_USE_ATEXIT
+              atexit(GC_print_lifetime_stats_at_exit);
+#           endif
+          }
+        }
+      }
+#   endif
+#   ifdef WATCH_MEMORY_PRESSURE
+      {
+        char * trigger_str = GETENV("GC_MEMORY_PRESSURE_TRIGGER");
+        if (trigger_str != NULL
+            && !GC_watch_memory_pressure(*trigger_str != '\0'
+                                            ? trigger_str : NULL))
+          WARN("Cannot watch memory pressure\n", 0);
+      }
+#   endif
+#   ifdef FINALIZER_THREADS
+      {
+        char * limit_str = GETENV("GC_FINALIZER_BACKLOG_LIMIT");
+        char * n_str = GETENV("GC_FINALIZER_THREADS");
+
+        if (limit_str != NULL)
+          GC_set_finalizer_backlog_limit((GC_word)STRTOULL(limit_str,
+                                                           NULL, 10));
+        if (n_str != NULL) {
+          int n = atoi(n_str);
+
+          if (n > 0) {
+            (void)GC_start_finalizer_threads((unsigned)n);
+          } else {
+            WARN("Bad number of finalizer threads %s - ignoring\n", n_str);
+          }
+        }
+      }
+#   endif
 
 #   if defined(DYNAMIC_LOADING) && defined(DARWIN)
         /* This must be called WITHOUT the allocation lock held */
         /* and before any threads are created.                  */
         GC_init_dyld();
+#   endif
+#   ifndef NO_CLOCK
+      if (GC_print_stats) {
+        CLOCK_TYPE done_time;
+
+        GET_TIME(done_time);
+        GC_log_printf("Initialization took %lu ms %lu ns%s\n",
+                      MS_TIME_DIFF(done_time, start_time),
+                      NS_FRAC_TIME_DIFF(done_time, start_time),
+                      GC_fast_startup ? " (fast startup)" : "");
+      }
 #   endif
     RESTORE_CANCEL(cancel_state);
 }
@@ -1426,6 +1921,8 @@ GC_API void GC_CALL GC_enable_incremental(void)
             } else
 #         endif
           /* else */ {
+            /* Do it before the write fault handler is installed.  */
+            GC_REGISTER_DEFERRED_ROOTS();
             GC_incremental = GC_dirty_init();
           }
         }
@@ -1442,6 +1939,9 @@ GC_API void GC_CALL GC_enable_incremental(void)
             /* clean since nothing can point to an      */
             /* unmarked object.                         */
           GC_read_dirty(FALSE);
+#         ifdef FROZEN_ROOTS
+            GC_note_frozen_roots_dirty();
+#         endif
           RESTORE_CANCEL(cancel_state);
         }
       }
@@ -1452,6 +1952,29 @@ GC_API void GC_CALL GC_enable_incremental(void)
   GC_init();
 }
 
+GC_API void GC_CALL GC_enable_generational(void)
+{
+  GC_time_limit = GC_TIME_UNLIMITED;
+  GC_enable_incremental();
+}
+
+GC_API int GC_CALL GC_is_generational_mode(void)
+{
+  return GC_incremental && GC_time_limit == GC_TIME_UNLIMITED;
+}
+
+GC_INNER GC_bool GC_stack_watermarks = FALSE;
+
+GC_API void GC_CALL GC_set_stack_watermarks(int value)
+{
+  GC_stack_watermarks = (GC_bool)(value != 0);
+}
+
+GC_API int GC_CALL GC_get_stack_watermarks(void)
+{
+  return (int)GC_stack_watermarks;
+}
+
 GC_API void GC_CALL GC_start_mark_threads(void)
 {
 #   ifdef PARALLEL_MARK
@@ -2110,9 +2633,12 @@ GC_API unsigned GC_CALL GC_new_kind_inner(void **fl, GC_word descr,
       GC_obj_kinds[result].ok_descriptor = descr;
       GC_obj_kinds[result].ok_relocate_descr = adjust;
       GC_obj_kinds[result].ok_init = (GC_bool)clear;
+      GC_obj_kinds[result].ok_exact_base = FALSE;
 #     ifdef ENABLE_DISCLAIM
         GC_obj_kinds[result].ok_mark_unconditionally = FALSE;
         GC_obj_kinds[result].ok_disclaim_proc = 0;
+        GC_obj_kinds[result].ok_disclaim_batch_proc = 0;
+        GC_obj_kinds[result].ok_disclaim_needed_only = FALSE;
 #     endif
     } else {
       ABORT("Too many kinds");
@@ -2131,6 +2657,24 @@ GC_API unsigned GC_CALL GC_new_kind(void **fl, GC_word descr, int adjust,
     return result;
 }
 
+GC_API void GC_CALL GC_set_kind_exact_base(unsigned kind, int value)
+{
+    DCL_LOCK_STATE;
+
+    GC_ASSERT(kind < MAXOBJKINDS);
+    GC_ASSERT(value == FALSE || value == TRUE);
+    LOCK();
+    GC_obj_kinds[kind].ok_exact_base = (GC_bool)value;
+    if (value) GC_have_exact_base_kinds = TRUE;
+    UNLOCK();
+}
+
+GC_API int GC_CALL GC_get_kind_exact_base(unsigned kind)
+{
+    GC_ASSERT(kind < MAXOBJKINDS);
+    return (int)GC_obj_kinds[kind].ok_exact_base;
+}
+
 GC_API unsigned GC_CALL GC_new_proc_inner(GC_mark_proc proc)
 {
     unsigned result = GC_n_mark_procs;
@@ -2397,6 +2941,140 @@ GC_API GC_word GC_CALL GC_get_gc_no(void)
   }
 #endif
 
+#ifndef CONCURRENT_MARK
+  GC_API void GC_CALL GC_set_concurrent_mark(int value)
+  {
+    UNUSED_ARG(value);
+  }
+
+  GC_API int GC_CALL GC_get_concurrent_mark(void)
+  {
+    return 0;
+  }
+
+  GC_API void GC_CALL GC_set_concurrent_mark_slice(unsigned long value)
+  {
+    UNUSED_ARG(value);
+  }
+
+  GC_API unsigned long GC_CALL GC_get_concurrent_mark_slice(void)
+  {
+    return 0;
+  }
+#endif
+
+#ifndef BACKGROUND_GC
+  GC_API void GC_CALL GC_set_background_gc(int value)
+  {
+    UNUSED_ARG(value);
+  }
+
+  GC_API int GC_CALL GC_get_background_gc(void)
+  {
+    return 0;
+  }
+#endif
+
+#ifndef FIBER_STACKS
+  GC_API void * GC_CALL GC_register_fiber(const struct GC_stack_base *sb)
+  {
+    UNUSED_ARG(sb);
+    return NULL;
+  }
+
+  GC_API void GC_CALL GC_unregister_fiber(void *fiber)
+  {
+    UNUSED_ARG(fiber);
+  }
+
+  GC_API void GC_CALL GC_fiber_switch(void *gc_thread_handle,
+                                      void *from_fiber, void *to_fiber)
+  {
+    UNUSED_ARG(gc_thread_handle);
+    UNUSED_ARG(from_fiber);
+    UNUSED_ARG(to_fiber);
+  }
+#endif
+
+#ifndef FINALIZER_THREADS
+  GC_API int GC_CALL GC_start_finalizer_threads(unsigned n)
+  {
+    UNUSED_ARG(n);
+    return GC_UNIMPLEMENTED;
+  }
+
+  GC_API unsigned GC_CALL GC_get_finalizer_threads(void)
+  {
+    return 0;
+  }
+
+  GC_API void GC_CALL GC_set_finalizer_batch_size(unsigned n)
+  {
+    UNUSED_ARG(n);
+  }
+
+  GC_API unsigned GC_CALL GC_get_finalizer_batch_size(void)
+  {
+    return 0;
+  }
+
+  GC_API void GC_CALL GC_set_finalizer_backlog_limit(GC_word n)
+  {
+    UNUSED_ARG(n);
+  }
+
+  GC_API GC_word GC_CALL GC_get_finalizer_backlog_limit(void)
+  {
+    return 0;
+  }
+#endif
+
+#ifndef SCAVENGER_THREAD
+  GC_API void GC_CALL GC_set_scavenger_rate(size_t bytes_per_sec)
+  {
+    UNUSED_ARG(bytes_per_sec);
+  }
+
+  GC_API size_t GC_CALL GC_get_scavenger_rate(void)
+  {
+    return 0;
+  }
+#endif
+
+#ifndef WATCH_MEMORY_PRESSURE
+  GC_API int GC_CALL GC_watch_memory_pressure(const char *trigger)
+  {
+    UNUSED_ARG(trigger);
+    return 0;
+  }
+#endif
+
+#ifndef THREAD_LOCAL_ALLOC
+  GC_API void GC_CALL GC_set_bump_alloc(int value)
+  {
+    UNUSED_ARG(value);
+  }
+
+  GC_API int GC_CALL GC_get_bump_alloc(void)
+  {
+    return 0;
+  }
+
+  GC_API void GC_CALL GC_set_batched_free(int value)
+  {
+    UNUSED_ARG(value);
+  }
+
+  GC_API int GC_CALL GC_get_batched_free(void)
+  {
+    return 0;
+  }
+
+  GC_API void GC_CALL GC_flush_thread_local_free_lists(void)
+  {
+  }
+#endif
+
 GC_API int GC_CALL GC_get_parallel(void)
 {
 # ifdef THREADS
@@ -2635,6 +3313,16 @@ GC_API int GC_CALL GC_get_dont_precollect(void)
     return GC_dont_precollect;
 }
 
+GC_API void GC_CALL GC_set_fast_startup(int value)
+{
+    GC_fast_startup = (GC_bool)value;
+}
+
+GC_API int GC_CALL GC_get_fast_startup(void)
+{
+    return (int)GC_fast_startup;
+}
+
 GC_API void GC_CALL GC_set_full_freq(int value)
 {
     GC_ASSERT(value >= 0);
@@ -2684,18 +3372,18 @@ GC_API size_t GC_CALL GC_get_hblk_size(void)
   {
     GC_ASSERT(GC_is_initialized);
     LOCK();
-#   ifdef THREAD_LOCAL_ALLOC
+#   if defined(THREAD_LOCAL_ALLOC) || defined(SHARDED_FREE_LISTS)
       GC_ASSERT(!GC_world_stopped);
 #   endif
     STOP_WORLD();
-#   ifdef THREAD_LOCAL_ALLOC
+#   if defined(THREAD_LOCAL_ALLOC) || defined(SHARDED_FREE_LISTS)
       GC_world_stopped = TRUE;
 #   endif
   }
 
   GC_API void GC_CALL GC_start_world_external(void)
   {
-#   ifdef THREAD_LOCAL_ALLOC
+#   if defined(THREAD_LOCAL_ALLOC) || defined(SHARDED_FREE_LISTS)
       GC_ASSERT(GC_world_stopped);
       GC_world_stopped = FALSE;
 #   else
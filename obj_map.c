@@ -40,9 +40,9 @@ GC_INNER void GC_register_displacement_inner(size_t offset)
         ABORT("Bad argument to GC_register_displacement");
     }
     if (!GC_valid_offsets[offset]) {
-      GC_valid_offsets[offset] = TRUE;
       GC_modws_valid_offsets[offset % sizeof(word)] = TRUE;
     }
+    GC_valid_offsets[offset] |= VALID_OFFSET_REGISTERED;
 }
 
 #ifdef MARK_BIT_PER_GRANULE
@@ -99,13 +99,16 @@
                         /* Undefined on GC_pages_executable real use.   */
 
 #if ((defined(LINUX_STACKBOTTOM) || defined(NEED_PROC_MAPS) \
-      || defined(PROC_VDB) || defined(SOFT_VDB)) && !defined(PROC_READ)) \
+      || defined(PROC_VDB) || defined(SOFT_VDB) || defined(USE_NUMA) \
+      || defined(CGROUP_MEMORY_LIMIT)) \
+     && !defined(PROC_READ)) \
     || defined(CPPCHECK)
 # define PROC_READ read
           /* Should probably call the real read, if read is wrapped.    */
 #endif
 
-#if defined(LINUX_STACKBOTTOM) || defined(NEED_PROC_MAPS)
+#if defined(LINUX_STACKBOTTOM) || defined(NEED_PROC_MAPS) \
+    || defined(USE_NUMA) || defined(CGROUP_MEMORY_LIMIT)
   /* Repeatedly perform a read call until the buffer is filled  */
   /* up, or we encounter EOF or an error.                       */
   STATIC ssize_t GC_repeat_read(int fd, char *buf, size_t count)
@@ -122,7 +125,24 @@
     }
     return num_read;
   }
-#endif /* LINUX_STACKBOTTOM || NEED_PROC_MAPS */
+#endif /* LINUX_STACKBOTTOM || NEED_PROC_MAPS || USE_NUMA || ... */
+
+#if defined(USE_NUMA) || defined(CGROUP_MEMORY_LIMIT)
+  /* Read a short sysfs file into buf (as a nul-terminated string).     */
+  /* Return FALSE on failure.                                           */
+  static GC_bool read_sysfs_file(const char *path, char *buf, size_t size)
+  {
+    int f = open(path, O_RDONLY);
+    ssize_t len;
+
+    if (f < 0) return FALSE;
+    len = GC_repeat_read(f, buf, size - 1);
+    close(f);
+    if (len <= 0) return FALSE;
+    buf[len] = '\0';
+    return TRUE;
+  }
+#endif
 
 #ifdef NEED_PROC_MAPS
 /* We need to parse /proc/self/maps, either to find dynamic libraries,  */
@@ -1298,6 +1318,15 @@ GC_INNER size_t GC_page_size = 0;
       void *stackaddr;
       size_t size;
 
+#     if defined(LINUX_STACKBOTTOM) && defined(USE_LIBC_PRIVATES) \
+         && !defined(USE_GET_STACKBASE_FOR_MAIN)
+        if (GC_fast_startup && 0 != &__libc_stack_end
+            && 0 != __libc_stack_end) {
+          /* Avoid pthread_getattr_np which parses /proc/self/maps for  */
+          /* the main thread.                                           */
+          return GC_linux_main_stack_base();
+        }
+#     endif
 #     ifdef HAVE_PTHREAD_ATTR_GET_NP
         if (pthread_attr_init(&attr) == 0
             && (pthread_attr_get_np(pthread_self(), &attr) == 0
@@ -1694,7 +1723,14 @@ void GC_register_data_segments(void)
     typedef UINT (WINAPI * GetWriteWatch_type)(
                                 DWORD, PVOID, GC_ULONG_PTR /* SIZE_T */,
                                 PVOID *, GC_ULONG_PTR *, PULONG);
+    typedef UINT (WINAPI * ResetWriteWatch_type)(PVOID,
+                                                 GC_ULONG_PTR /* SIZE_T */);
     static FARPROC GetWriteWatch_func;
+    static FARPROC ResetWriteWatch_func;
+                        /* If available, the dirty pages are read       */
+                        /* without the reset flag, and the write-watch  */
+                        /* state is reset once per heap section, only   */
+                        /* up to the last dirty page found.             */
     static DWORD GetWriteWatch_alloc_flag;
 
 #   define GC_GWW_AVAILABLE() (GetWriteWatch_func != 0)
@@ -1763,6 +1799,7 @@ void GC_register_data_segments(void)
             GetWriteWatch_func = 0;
           } else {
             GetWriteWatch_alloc_flag = MEM_WRITE_WATCH;
+            ResetWriteWatch_func = GetProcAddress(hK32, "ResetWriteWatch");
           }
           VirtualFree(page, 0 /* dwSize */, MEM_RELEASE);
         } else {
@@ -2291,6 +2328,182 @@ void GC_register_data_segments(void)
 
 #endif  /* MMAP_SUPPORTED */
 
+#ifdef USE_HUGE_PAGES
+  GC_INNER GC_bool GC_huge_pages = FALSE;
+
+  GC_INNER ptr_t GC_unix_get_huge_mem(size_t bytes)
+  {
+    size_t len;
+    ptr_t result, aligned;
+
+    GC_ASSERT(bytes % HUGE_PAGE_SIZE == 0);
+    /* Over-allocate to be able to trim the unaligned ends.     */
+    len = bytes + HUGE_PAGE_SIZE - GC_page_size;
+    if (len < bytes) return NULL; /* overflow */
+    result = GC_unix_mmap_get_mem(len);
+    if (NULL == result) return NULL;
+    aligned = (ptr_t)(((word)result + HUGE_PAGE_SIZE - 1)
+                      & ~(HUGE_PAGE_SIZE - 1));
+    if (aligned != result)
+      (void)munmap(result, (size_t)(aligned - result));
+    if ((word)(aligned + bytes) < (word)(result + len))
+      (void)munmap(aligned + bytes, (size_t)(result + len - aligned - bytes));
+#   ifdef MADV_HUGEPAGE
+      if (madvise(aligned, bytes, MADV_HUGEPAGE) != 0) {
+        GC_COND_LOG_PRINTF("madvise(MADV_HUGEPAGE) failed, errno= %d\n",
+                           errno);
+      }
+#   endif
+    return aligned;
+  }
+#endif /* USE_HUGE_PAGES */
+
+#ifdef USE_LARGE_OBJ_SPACE
+  GC_INNER ptr_t GC_unix_get_los_mem(size_t bytes)
+  {
+    GC_ASSERT(bytes % GC_page_size == 0 && GC_page_size % HBLKSIZE == 0);
+    return GC_unix_mmap_get_mem(bytes);
+  }
+
+  GC_INNER void GC_unix_free_los_mem(ptr_t start, size_t bytes)
+  {
+    GC_ASSERT((word)start % GC_page_size == 0);
+    if (munmap(start, bytes) != 0)
+      ABORT_ARG1("munmap of large object failed", ": errno= %d", errno);
+  }
+
+  GC_INNER GC_bool GC_unix_remap_los_mem(ptr_t start, size_t old_bytes,
+                                         size_t new_bytes, ptr_t dest)
+  {
+    void *result;
+
+    GC_ASSERT((word)start % GC_page_size == 0);
+    GC_ASSERT(old_bytes % GC_page_size == 0
+              && new_bytes % GC_page_size == 0);
+    if (NULL == dest) {
+      result = mremap(start, old_bytes, new_bytes, 0);
+      dest = start;
+    } else {
+      /* The reserved mapping at dest is replaced atomically.   */
+      result = mremap(start, old_bytes, new_bytes,
+                      MREMAP_MAYMOVE | MREMAP_FIXED, dest);
+    }
+    if (MAP_FAILED == result) {
+      /* Failure to grow in place is expected if the next pages are used. */
+      if (dest != start) {
+        GC_COND_LOG_PRINTF("mremap of large object failed, errno= %d\n",
+                           errno);
+      }
+      return FALSE;
+    }
+    GC_ASSERT((ptr_t)result == dest);
+    return TRUE;
+  }
+#endif /* USE_LARGE_OBJ_SPACE */
+
+#ifdef USE_HEAP_ARENA
+  STATIC ptr_t GC_arena_free_ptr = NULL;
+                        /* The start of the unused part of the arena.   */
+
+  GC_INNER ptr_t GC_arena_hint = (ptr_t)GC_ARENA_HINT;
+
+  GC_INNER void GC_init_arena(void)
+  {
+    size_t len = (size_t)GC_ARENA_SIZE + HBLKSIZE;
+    void *arena;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    GC_ASSERT(GC_page_size != 0);
+    /* The range is just reserved, pages are committed on demand.       */
+    arena = mmap(GC_arena_hint, len, PROT_NONE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (MAP_FAILED == arena) {
+      GC_COND_LOG_PRINTF("Cannot reserve heap arena, errno= %d\n", errno);
+      return;
+    }
+#   ifdef FLAT_HDR_TABLE
+      {
+        size_t table_len = (size_t)(GC_ARENA_SIZE >> LOG_HBLKSIZE)
+                            * sizeof(hdr *);
+        void *table = mmap(NULL, table_len, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                           -1, 0);
+
+        if (MAP_FAILED == table) {
+          GC_COND_LOG_PRINTF(
+                "Cannot reserve flat header table, errno= %d\n", errno);
+          (void)munmap(arena, len);
+          return;
+        }
+        GC_flat_hdrs = (hdr **)table;
+      }
+#   endif
+#   ifdef SIDE_MARK_BITMAP
+      {
+        size_t marks_len = (size_t)(GC_ARENA_SIZE >> LOG_HBLKSIZE)
+                            * SIDE_MARKS_SLOT_SZ;
+        void *marks = mmap(NULL, marks_len, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                           -1, 0);
+
+        /* On failure, the mark bits are kept in the block headers.     */
+        if (MAP_FAILED == marks) {
+          GC_COND_LOG_PRINTF(
+                "Cannot reserve side mark bitmap, errno= %d\n", errno);
+        } else {
+          GC_side_marks = (ptr_t)marks;
+        }
+      }
+#   endif
+    GC_arena_start = ((word)arena + HBLKSIZE - 1) & ~(word)(HBLKSIZE - 1);
+    GC_arena_free_ptr = (ptr_t)GC_arena_start;
+    GC_arena_size = GC_ARENA_SIZE;
+  }
+
+  GC_INNER ptr_t GC_arena_get_mem(size_t bytes)
+  {
+    ptr_t result = GC_arena_free_ptr;
+
+    GC_ASSERT(I_HOLD_LOCK());
+#   ifdef USE_HUGE_PAGES
+      if (GC_huge_pages)
+        result = (ptr_t)(((word)result + HUGE_PAGE_SIZE - 1)
+                         & ~(HUGE_PAGE_SIZE - 1));
+#   endif
+    if ((word)result > GC_arena_start + GC_arena_size
+        || bytes > GC_arena_start + GC_arena_size - (word)result)
+      return NULL;
+    if (mmap(result, bytes, (PROT_READ | PROT_WRITE)
+                            | (GC_pages_executable ? PROT_EXEC : 0),
+             MAP_PRIVATE | MAP_FIXED | MAP_ANONYMOUS, -1, 0) == MAP_FAILED)
+      return NULL;
+#   if defined(USE_HUGE_PAGES) && defined(MADV_HUGEPAGE)
+      if (GC_huge_pages && madvise(result, bytes, MADV_HUGEPAGE) != 0) {
+        GC_COND_LOG_PRINTF("madvise(MADV_HUGEPAGE) failed, errno= %d\n",
+                           errno);
+      }
+#   endif
+    GC_arena_free_ptr = result + bytes;
+    return result;
+  }
+
+  GC_INNER GC_bool GC_arena_map_file(int fd, word offset, size_t bytes)
+  {
+    GC_ASSERT(I_HOLD_LOCK());
+    if (0 == GC_arena_size || GC_arena_free_ptr != (ptr_t)GC_arena_start
+        || bytes > GC_arena_size)
+      return FALSE;
+    if (mmap(GC_arena_free_ptr, bytes, (PROT_READ | PROT_WRITE)
+                                | (GC_pages_executable ? PROT_EXEC : 0),
+             MAP_PRIVATE | MAP_FIXED, fd, (off_t)offset) == MAP_FAILED) {
+      GC_COND_LOG_PRINTF("Cannot map heap image, errno= %d\n", errno);
+      return FALSE;
+    }
+    GC_arena_free_ptr += bytes;
+    return TRUE;
+  }
+#endif /* USE_HEAP_ARENA */
+
 #if defined(USE_MMAP)
   ptr_t GC_unix_get_mem(size_t bytes)
   {
@@ -2371,6 +2584,325 @@ ptr_t GC_unix_get_mem(size_t bytes)
 
 # endif /* UN*X */
 
+#ifdef USE_NUMA
+# include <sched.h>
+# include <sys/syscall.h>
+
+# ifndef MPOL_PREFERRED
+#   define MPOL_PREFERRED 1
+# endif
+
+GC_INNER int GC_numa_nodes = 0;
+
+STATIC GC_bool GC_numa_requested = FALSE;
+
+GC_API void GC_CALL GC_set_numa_mode(int value)
+{
+  GC_numa_requested = (GC_bool)(value != 0);
+}
+
+GC_API int GC_CALL GC_get_numa_mode(void)
+{
+  return (int)GC_numa_nodes;
+}
+
+/* Parse a list of the form "0-3,8,10-11" and call fn for each listed   */
+/* number less than limit.                                              */
+static void parse_sysfs_list(const char *s, int limit,
+                             void (*fn)(int, void *), void *client_data)
+{
+  while (*s != '\0') {
+    int lo, hi;
+
+    if (!isdigit((unsigned char)*s)) break;
+    for (lo = 0; isdigit((unsigned char)*s); s++) lo = lo * 10 + (*s - '0');
+    hi = lo;
+    if ('-' == *s) {
+      for (hi = 0, s++; isdigit((unsigned char)*s); s++)
+        hi = hi * 10 + (*s - '0');
+    }
+    for (; lo <= hi && lo < limit; lo++) fn(lo, client_data);
+    if (*s != ',') break;
+    s++;
+  }
+}
+
+static void update_max_node(int node, void *pmax)
+{
+  if (node >= *(int *)pmax) *(int *)pmax = node + 1;
+}
+
+GC_INNER void GC_numa_init(void)
+{
+  char buf[128];
+  int nodes = 0;
+
+  if (!GC_numa_requested || GC_numa_nodes != 0) return;
+  if (!read_sysfs_file("/sys/devices/system/node/online", buf, sizeof(buf))) {
+    WARN("Cannot determine NUMA nodes, NUMA mode is off\n", 0);
+    return;
+  }
+  parse_sysfs_list(buf, MAX_NUMA_NODES, update_max_node, &nodes);
+  if (0 == nodes) {
+    WARN("No NUMA nodes found, NUMA mode is off\n", 0);
+    return;
+  }
+  GC_numa_nodes = nodes;
+  GC_COND_LOG_PRINTF("NUMA mode is on, number of nodes: %d\n", nodes);
+}
+
+GC_INNER int GC_numa_current_node(void)
+{
+  unsigned cpu, node;
+
+  if (0 == GC_numa_nodes
+      || syscall(SYS_getcpu, &cpu, &node, NULL) != 0
+      || node >= (unsigned)GC_numa_nodes)
+    return 0;
+  return (int)node;
+}
+
+GC_INNER void GC_numa_bind(ptr_t start, size_t bytes, int node)
+{
+  unsigned long nodemask = 1UL << node;
+
+  GC_ASSERT(GC_numa_nodes > 0 && node < GC_numa_nodes);
+  if (((word)start | bytes) % GC_page_size != 0) return;
+  /* The memory is not touched yet, so the pages will be allocated on   */
+  /* the node (if possible) at the first access.                        */
+  if (syscall(SYS_mbind, start, bytes, MPOL_PREFERRED, &nodemask,
+              sizeof(nodemask) * 8, 0) != 0) {
+    GC_COND_LOG_PRINTF("mbind(%p, %lu) failed, errno= %d\n",
+                       (void *)start, (unsigned long)bytes, errno);
+  }
+}
+
+static void add_to_cpu_set(int cpu, void *pset)
+{
+  CPU_SET(cpu, (cpu_set_t *)pset);
+}
+
+GC_INNER void GC_numa_pin_thread(int node)
+{
+  char path[64];
+  char buf[256];
+  cpu_set_t mask;
+
+  GC_ASSERT(GC_numa_nodes > 0 && node < GC_numa_nodes);
+  (void)snprintf(path, sizeof(path),
+                 "/sys/devices/system/node/node%d/cpulist", node);
+  if (!read_sysfs_file(path, buf, sizeof(buf))) return;
+  CPU_ZERO(&mask);
+  parse_sysfs_list(buf, CPU_SETSIZE, add_to_cpu_set, &mask);
+  if (CPU_COUNT(&mask) > 0
+      && sched_setaffinity(0 /* current thread */,
+                           sizeof(mask), &mask) != 0) {
+    GC_COND_LOG_PRINTF("Cannot bind thread to NUMA node %d, errno= %d\n",
+                       node, errno);
+  }
+}
+
+#else
+  GC_API void GC_CALL GC_set_numa_mode(int value)
+  {
+    UNUSED_ARG(value);
+  }
+
+  GC_API int GC_CALL GC_get_numa_mode(void)
+  {
+    return 0;
+  }
+#endif /* !USE_NUMA */
+
+#ifdef PERF_COUNTERS
+# include <linux/perf_event.h>
+# include <sys/syscall.h>
+
+  /* The events in the order of the GC_perf_counts_s fields.    */
+  static const struct {
+    unsigned type;
+    unsigned long long config;
+  } perf_events[GC_PERF_NCOUNTERS] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB
+                          | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                          | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) }
+  };
+
+  STATIC void GC_perf_close(GC_perf_group_t *pg)
+  {
+    int i;
+
+    for (i = 0; i < GC_PERF_NCOUNTERS; i++) {
+      if (pg -> fds[i] != -1) {
+        (void)close(pg -> fds[i]);
+        pg -> fds[i] = -1;
+      }
+    }
+    pg -> tid = 0;
+  }
+
+  STATIC void GC_perf_open(GC_perf_group_t *pg, long tid)
+  {
+    struct perf_event_attr attr;
+    int i;
+
+    BZERO(&attr, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    for (i = 0; i < GC_PERF_NCOUNTERS; i++) {
+      attr.type = perf_events[i].type;
+      attr.config = perf_events[i].config;
+      pg -> fds[i] = (int)syscall(SYS_perf_event_open, &attr,
+                                  0 /* calling thread */, -1 /* any CPU */,
+                                  -1 /* no group */, 0UL);
+      if (pg -> fds[i] != -1) {
+        (void)fcntl(pg -> fds[i], F_SETFD, FD_CLOEXEC);
+      } else if (0 == i) {
+        GC_COND_LOG_PRINTF("Cannot open perf event counters, errno= %d\n",
+                           errno);
+      }
+    }
+    pg -> tid = tid;
+  }
+
+  GC_INNER GC_bool GC_perf_read(GC_perf_group_t *pg,
+                                struct GC_perf_counts_s *pc)
+  {
+    GC_word values[GC_PERF_NCOUNTERS];
+    long tid = (long)syscall(SYS_gettid);
+    GC_bool found = FALSE;
+    int i;
+
+    if (pg -> tid != tid) {
+      GC_perf_close(pg);
+      GC_perf_open(pg, tid);
+    }
+    for (i = 0; i < GC_PERF_NCOUNTERS; i++) {
+      unsigned long long v;
+
+      values[i] = 0;
+      if (pg -> fds[i] != -1
+          && read(pg -> fds[i], &v, sizeof(v)) == (ssize_t)sizeof(v)) {
+        values[i] = (GC_word)v;
+        found = TRUE;
+      }
+    }
+    pc -> cycles = values[0];
+    pc -> instructions = values[1];
+    pc -> llc_misses = values[2];
+    pc -> dtlb_misses = values[3];
+    return found;
+  }
+
+  /* The counters could be reopened in between (by another thread),    */
+  /* thus a decrease is ignored.                                        */
+# define PERF_ADD_DELTA(acc, from, to, field) \
+        (void)((to) -> field > (from) -> field \
+                ? ((acc) -> field += (to) -> field - (from) -> field) : 0)
+
+  GC_INNER void GC_perf_add_delta(struct GC_perf_counts_s *acc,
+                                  const struct GC_perf_counts_s *from,
+                                  const struct GC_perf_counts_s *to)
+  {
+    PERF_ADD_DELTA(acc, from, to, cycles);
+    PERF_ADD_DELTA(acc, from, to, instructions);
+    PERF_ADD_DELTA(acc, from, to, llc_misses);
+    PERF_ADD_DELTA(acc, from, to, dtlb_misses);
+  }
+#endif /* PERF_COUNTERS */
+
+#ifdef CGROUP_MEMORY_LIMIT
+# ifndef CGROUP_FS_ROOT
+#   define CGROUP_FS_ROOT "/sys/fs/cgroup"
+# endif
+
+  /* Store the directory of the cgroup (v2) of the process to buf.      */
+  /* Return FALSE if it is unknown (e.g., only cgroup v1 is mounted).   */
+  static GC_bool cgroup_dir(char *buf, size_t size)
+  {
+    char cgroup_buf[512];
+    const char *path;
+    size_t len;
+
+    if (!read_sysfs_file("/proc/self/cgroup", cgroup_buf,
+                         sizeof(cgroup_buf)))
+      return FALSE;
+    /* The unified hierarchy entry is "0::<path>".      */
+    for (path = cgroup_buf; strncmp(path, "0::", 3) != 0; path++) {
+      path = strchr(path, '\n');
+      if (NULL == path) return FALSE;
+    }
+    path += 3;
+    len = strcspn(path, "\n");
+    if (len + sizeof(CGROUP_FS_ROOT) > size) return FALSE;
+    BCOPY(CGROUP_FS_ROOT, buf, sizeof(CGROUP_FS_ROOT) - 1);
+    BCOPY(path, buf + sizeof(CGROUP_FS_ROOT) - 1, len);
+    buf[sizeof(CGROUP_FS_ROOT) - 1 + len] = '\0';
+    return TRUE;
+  }
+
+  GC_INNER word GC_cgroup_memory_limit(void)
+  {
+    char dir[512 + sizeof(CGROUP_FS_ROOT) + sizeof("/memory.max")];
+    word result = 0;
+    size_t len;
+
+    if (!cgroup_dir(dir, sizeof(dir) - sizeof("/memory.max") + 1))
+      return 0;
+    len = strlen(dir);
+    if (len > 0 && '/' == dir[len - 1]) len--;
+
+    /* The limits of the ancestors apply too.  The root cgroup has no   */
+    /* memory.max file.                                                 */
+    while (len > sizeof(CGROUP_FS_ROOT) - 1) {
+      char value[32];
+
+      BCOPY("/memory.max", dir + len, sizeof("/memory.max"));
+      if (read_sysfs_file(dir, value, sizeof(value))
+          && isdigit((unsigned char)value[0])) {
+        word limit = (word)strtoul(value, NULL, 10); /* "max" otherwise */
+
+        if (0 == result || limit < result) result = limit;
+      }
+      while (len > 0 && dir[--len] != '/') {
+        /* empty */
+      }
+    }
+    return result;
+  }
+
+# ifdef WATCH_MEMORY_PRESSURE
+  GC_INNER int GC_open_memory_pressure(const char *trigger)
+  {
+    char path[512 + sizeof(CGROUP_FS_ROOT) + sizeof("/memory.pressure")];
+    int f = -1;
+    size_t len = strlen(trigger) + 1; /* including the terminator */
+
+    if (cgroup_dir(path, sizeof(path) - sizeof("/memory.pressure") + 1)) {
+      BCOPY("/memory.pressure", path + strlen(path),
+            sizeof("/memory.pressure"));
+      f = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    }
+    if (-1 == f) {
+      /* Fall back to the system-wide pressure.        */
+      f = open("/proc/pressure/memory", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    }
+    if (-1 == f) return -1;
+    if (write(f, trigger, len) != (ssize_t)len) {
+      GC_COND_LOG_PRINTF("Cannot set memory pressure trigger, errno= %d\n",
+                         errno);
+      close(f);
+      return -1;
+    }
+    return f;
+  }
+# endif /* WATCH_MEMORY_PRESSURE */
+#endif /* CGROUP_MEMORY_LIMIT */
+
 # ifdef OS2
 
 void * os2_alloc(size_t bytes)
@@ -2619,13 +3151,15 @@ void * os2_alloc(size_t bytes)
 /* Compute a page aligned starting address for the unmap        */
 /* operation on a block of size bytes starting at start.        */
 /* Return 0 if the block is too small to make this feasible.    */
+/* In the huge pages mode, only whole huge pages are unmapped   */
+/* (so that they are not split by the kernel).                  */
 STATIC ptr_t GC_unmap_start(ptr_t start, size_t bytes)
 {
-    ptr_t result = (ptr_t)(((word)start + GC_page_size - 1)
-                            & ~(GC_page_size - 1));
+    word granule = GC_UNMAP_GRANULE;
+    ptr_t result = (ptr_t)(((word)start + granule - 1) & ~(granule - 1));
 
     GC_ASSERT(GC_page_size != 0);
-    if ((word)(result + GC_page_size) > (word)(start + bytes)) return 0;
+    if ((word)(result + granule) > (word)(start + bytes)) return 0;
     return result;
 }
 
@@ -3009,6 +3543,88 @@ GC_API GC_push_other_roots_proc GC_CALL GC_get_push_other_roots(void)
       return GC_GWW_AVAILABLE();
     }
 
+  static void gww_set_grungy_pages(PVOID *pages, GC_ULONG_PTR count,
+                                   DWORD page_size)
+  {
+    PVOID *pages_end = pages + count;
+
+    while (pages != pages_end) {
+      struct hblk * h = (struct hblk *) *pages++;
+      struct hblk * h_end = (struct hblk *) ((char *) h + page_size);
+      do {
+        set_pht_entry_from_index(GC_grungy_pages, PHT_HASH(h));
+      } while ((word)(++h) < (word)h_end);
+    }
+  }
+
+  /* GetWriteWatch is documented as returning non-zero when it fails,   */
+  /* but the documentation doesn't explicitly say why it would fail or  */
+  /* what its behavior will be if it fails.  It does appear to fail, at */
+  /* least on recent Win2K instances, if the underlying memory was not  */
+  /* allocated with the appropriate flag.  This is common if            */
+  /* GC_enable_incremental is called shortly after GC initialization.   */
+  /* To avoid modifying the interface, we silently work around such a   */
+  /* failure, it only affects the initial (small) heap allocation.      */
+  static void gww_sect_failed(word i, GC_bool output_unneeded)
+  {
+    static int warn_count = 0;
+    struct hblk * start = (struct hblk *)GC_heap_sects[i].hs_start;
+    static struct hblk *last_warned = 0;
+    size_t nblocks = divHBLKSZ(GC_heap_sects[i].hs_bytes);
+
+    if (i != 0 && last_warned != start && warn_count++ < 5) {
+      last_warned = start;
+      WARN("GC_gww_read_dirty unexpectedly failed at %p:"
+           " Falling back to marking all pages dirty\n", start);
+    }
+    if (!output_unneeded) {
+      unsigned j;
+
+      for (j = 0; j < nblocks; ++j) {
+        word hash = PHT_HASH(start + j);
+        set_pht_entry_from_index(GC_grungy_pages, hash);
+      }
+    }
+  }
+
+  /* Read the dirty pages of the i-th heap section without resetting    */
+  /* the write-watch state, continuing past the last returned page if   */
+  /* the buffer fills up, then reset the state by a single call, only   */
+  /* up to the end of the last dirty page.  Thus a clean section costs  */
+  /* one call, and the reset does not depend on the buffer size.  The   */
+  /* pages dirtied between the two calls are lost, thus the world       */
+  /* should be stopped (as for GC_read_dirty).  Returns FALSE on        */
+  /* failure.                                                           */
+  static GC_bool gww_read_sect_batched(word i, GC_bool output_unneeded)
+  {
+    ptr_t start = GC_heap_sects[i].hs_start;
+    ptr_t limit = start + GC_heap_sects[i].hs_bytes;
+    ptr_t consumed = start;
+
+    if (output_unneeded) {
+      consumed = limit; /* no need to read anything */
+    } else {
+      GC_ULONG_PTR count;
+
+      do {
+        DWORD page_size;
+
+        count = GC_GWW_BUF_LEN;
+        if ((*(GetWriteWatch_type)(word)GetWriteWatch_func)(
+                        0 /* flags */, consumed, (word)(limit - consumed),
+                        gww_buf, &count, &page_size) != 0)
+          return FALSE;
+        if (count > 0) {
+          gww_set_grungy_pages(gww_buf, count, page_size);
+          consumed = (ptr_t)gww_buf[count - 1] + page_size;
+        }
+      } while (count == GC_GWW_BUF_LEN && (word)consumed < (word)limit);
+    }
+    return consumed == start
+           || (*(ResetWriteWatch_type)(word)ResetWriteWatch_func)(
+                                start, (word)(consumed - start)) == 0;
+  }
+
   GC_INLINE void GC_gww_read_dirty(GC_bool output_unneeded)
   {
     word i;
@@ -3020,59 +3636,30 @@ GC_API GC_push_other_roots_proc GC_CALL GC_get_push_other_roots(void)
     for (i = 0; i != GC_n_heap_sects; ++i) {
       GC_ULONG_PTR count;
 
+      if (ResetWriteWatch_func != 0) {
+        if (!gww_read_sect_batched(i, output_unneeded))
+          gww_sect_failed(i, output_unneeded);
+        continue;
+      }
       do {
         PVOID * pages = gww_buf;
         DWORD page_size;
 
         count = GC_GWW_BUF_LEN;
-        /* GetWriteWatch is documented as returning non-zero when it    */
-        /* fails, but the documentation doesn't explicitly say why it   */
-        /* would fail or what its behavior will be if it fails.  It     */
-        /* does appear to fail, at least on recent Win2K instances, if  */
-        /* the underlying memory was not allocated with the appropriate */
-        /* flag.  This is common if GC_enable_incremental is called     */
-        /* shortly after GC initialization.  To avoid modifying the     */
-        /* interface, we silently work around such a failure, it only   */
-        /* affects the initial (small) heap allocation. If there are    */
-        /* more dirty pages than will fit in the buffer, this is not    */
-        /* treated as a failure; we must check the page count in the    */
-        /* loop condition. Since each partial call will reset the       */
-        /* status of some pages, this should eventually terminate even  */
-        /* in the overflow case.                                        */
+        /* If there are more dirty pages than will fit in the buffer,   */
+        /* this is not treated as a failure; we must check the page     */
+        /* count in the loop condition.  Since each partial call will   */
+        /* reset the status of some pages, this should eventually       */
+        /* terminate even in the overflow case.                         */
         if ((*(GetWriteWatch_type)(word)GetWriteWatch_func)(
                                         WRITE_WATCH_FLAG_RESET,
                                         GC_heap_sects[i].hs_start,
                                         GC_heap_sects[i].hs_bytes,
                                         pages, &count, &page_size) != 0) {
-          static int warn_count = 0;
-          struct hblk * start = (struct hblk *)GC_heap_sects[i].hs_start;
-          static struct hblk *last_warned = 0;
-          size_t nblocks = divHBLKSZ(GC_heap_sects[i].hs_bytes);
-
-          if (i != 0 && last_warned != start && warn_count++ < 5) {
-            last_warned = start;
-            WARN("GC_gww_read_dirty unexpectedly failed at %p:"
-                 " Falling back to marking all pages dirty\n", start);
-          }
-          if (!output_unneeded) {
-            unsigned j;
-
-            for (j = 0; j < nblocks; ++j) {
-              word hash = PHT_HASH(start + j);
-              set_pht_entry_from_index(GC_grungy_pages, hash);
-            }
-          }
+          gww_sect_failed(i, output_unneeded);
           count = 1;  /* Done with this section. */
         } else /* succeeded */ if (!output_unneeded) {
-          PVOID * pages_end = pages + count;
-
-          while (pages != pages_end) {
-            struct hblk * h = (struct hblk *) *pages++;
-            struct hblk * h_end = (struct hblk *) ((char *) h + page_size);
-            do {
-              set_pht_entry_from_index(GC_grungy_pages, PHT_HASH(h));
-            } while ((word)(++h) < (word)h_end);
-          }
+          gww_set_grungy_pages(pages, count, page_size);
         }
       } while (count == GC_GWW_BUF_LEN);
       /* FIXME: It's unclear from Microsoft's documentation if this loop */
@@ -3089,10 +3676,30 @@ GC_API GC_push_other_roots_proc GC_CALL GC_get_push_other_roots(void)
 #elif defined(SOFT_VDB)
   static int clear_refs_fd = -1;
 # define GC_GWW_AVAILABLE() (clear_refs_fd != -1)
+# ifdef UFFD_WP_VDB
+#   include <linux/userfaultfd.h>
+#   include <sys/ioctl.h>
+#   include <sys/syscall.h>
+#   if !defined(__NR_userfaultfd) || !defined(UFFDIO_REGISTER_MODE_WP)
+      /* The kernel headers are too old.        */
+#     undef UFFD_WP_VDB
+#   endif
+# endif
+# ifdef UFFD_WP_VDB
+    /* The userfaultfd descriptor the heap sections are registered at   */
+    /* in the asynchronous write-protect mode, or -1 if the soft-dirty  */
+    /* bits are used instead.                                           */
+    static int uffd_wp_fd = -1;
+#   define GC_UFFD_WP_USED() (uffd_wp_fd != -1)
+# endif
 #else
 # define GC_GWW_AVAILABLE() FALSE
 #endif /* !GWW_VDB && !SOFT_VDB */
 
+#ifndef GC_UFFD_WP_USED
+# define GC_UFFD_WP_USED() FALSE
+#endif
+
 #ifdef DEFAULT_VDB
   /* The client asserts that unallocated pages in the heap are never    */
   /* written.                                                           */
@@ -3454,7 +4061,9 @@ GC_API GC_push_other_roots_proc GC_CALL GC_get_push_other_roots(void)
       }
 #   elif defined(SOFT_VDB)
       if (soft_dirty_init()) {
-        GC_COND_LOG_PRINTF("Using soft-dirty bit feature\n");
+        GC_COND_LOG_PRINTF(GC_UFFD_WP_USED()
+                            ? "Using userfaultfd write-protect feature\n"
+                            : "Using soft-dirty bit feature\n");
         return TRUE;
       }
 #   endif
@@ -3855,6 +4464,268 @@ GC_INLINE void GC_proc_read_dirty(GC_bool output_unneeded)
     return TRUE;
   }
 
+# ifdef UFFD_WP_VDB
+    /* The userfaultfd write-protect mode with the asynchronous faults  */
+    /* resolution (Linux v6.7+): a write to a protected page of a       */
+    /* registered range just unprotects the page (without a signal),    */
+    /* and PAGEMAP_SCAN ioctl reports the written ranges and protects   */
+    /* them again in the same syscall.  Unlike clear_refs, this does    */
+    /* not touch the page tables outside the heap.                      */
+#   ifndef PAGEMAP_SCAN
+      /* The definitions are from linux/fs.h.   */
+      struct page_region {
+        uint64_t start;
+        uint64_t end;
+        uint64_t categories;
+      };
+
+      struct pm_scan_arg {
+        uint64_t size;
+        uint64_t flags;
+        uint64_t start;
+        uint64_t end;
+        uint64_t walk_end;
+        uint64_t vec;
+        uint64_t vec_len;
+        uint64_t max_pages;
+        uint64_t category_inverted;
+        uint64_t category_mask;
+        uint64_t category_anyof_mask;
+        uint64_t return_mask;
+      };
+
+#     define PAGEMAP_SCAN _IOWR('f', 16, struct pm_scan_arg)
+#     define PAGE_IS_WRITTEN (1 << 1)
+#     define PM_SCAN_WP_MATCHING (1 << 0)
+#     define PM_SCAN_CHECK_WPASYNC (1 << 1)
+#   endif
+#   ifndef UFFD_USER_MODE_ONLY
+#     define UFFD_USER_MODE_ONLY 1
+#   endif
+#   ifndef UFFD_FEATURE_WP_UNPOPULATED
+#     define UFFD_FEATURE_WP_UNPOPULATED (1 << 13)
+#   endif
+#   ifndef UFFD_FEATURE_WP_ASYNC
+#     define UFFD_FEATURE_WP_ASYNC (1 << 15)
+#   endif
+
+    /* The number of the leading GC_heap_sects entries registered at    */
+    /* uffd_wp_fd (the heap sections are only appended to the array).  */
+    static word uffd_registered_sects;
+
+    /* Whether the soft-dirty bits could be used if userfaultfd fails.  */
+    static GC_bool uffd_soft_dirty_fallback;
+
+    static GC_bool uffd_wp_open(void)
+    {
+      struct uffdio_api api;
+      int fd = (int)syscall(__NR_userfaultfd,
+                            O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY);
+
+      if (-1 == fd && EINVAL == errno) {
+        /* UFFD_USER_MODE_ONLY is not supported (Linux prior to v5.11). */
+        fd = (int)syscall(__NR_userfaultfd, O_CLOEXEC | O_NONBLOCK);
+      }
+      if (-1 == fd)
+        return FALSE;
+      BZERO(&api, sizeof(api));
+      api.api = UFFD_API;
+      api.features = UFFD_FEATURE_WP_ASYNC | UFFD_FEATURE_WP_UNPOPULATED;
+      if (ioctl(fd, UFFDIO_API, &api) == -1) {
+        close(fd);
+        return FALSE;
+      }
+      uffd_wp_fd = fd;
+      uffd_registered_sects = 0;
+      return TRUE;
+    }
+
+    static void uffd_wp_close(void)
+    {
+      close(uffd_wp_fd);
+      uffd_wp_fd = -1;
+    }
+
+    /* Reopen the userfaultfd (if used) after the files of /proc have   */
+    /* been reopened in the forked child.  The child does not inherit   */
+    /* the registrations, and the inherited descriptor refers to the    */
+    /* address space of the parent process.  The /proc files are closed */
+    /* if no way to track the dirty pages remains.                      */
+    static void uffd_wp_update_child(void)
+    {
+      if (!GC_UFFD_WP_USED())
+        return;
+      uffd_wp_close();
+      if (-1 == clear_refs_fd || uffd_wp_open())
+        return;
+      if (uffd_soft_dirty_fallback) {
+        GC_COND_LOG_PRINTF("Failed to reopen userfaultfd in child;"
+                           " using soft-dirty bits\n");
+      } else {
+        close(clear_refs_fd);
+        clear_refs_fd = -1;
+        close(pagemap_fd);
+      }
+    }
+
+    /* Check that PAGEMAP_SCAN ioctl is supported by the kernel.        */
+    static GC_bool uffd_wp_scan_supported(ptr_t vaddr)
+    {
+      struct pm_scan_arg arg;
+
+      GC_ASSERT(GC_page_size != 0);
+      BZERO(&arg, sizeof(arg));
+      arg.size = sizeof(arg);
+      arg.start = (word)vaddr & ~(GC_page_size-1);
+      arg.end = arg.start + GC_page_size;
+      arg.vec = (word)soft_vdb_buf;
+      arg.vec_len = VDB_BUF_SZ / sizeof(struct page_region);
+      arg.category_mask = PAGE_IS_WRITTEN;
+      arg.return_mask = PAGE_IS_WRITTEN;
+      return ioctl(pagemap_fd, PAGEMAP_SCAN, &arg) >= 0;
+    }
+
+    static GC_bool uffd_wp_init(void)
+    {
+      char *str = GETENV("GC_USE_UFFD_WP");
+
+      if (str != NULL && *str == '0' && *(str + 1) == '\0')
+        return FALSE; /* the environment variable is set "0" */
+      if (!uffd_wp_open()) {
+        GC_COND_LOG_PRINTF("userfaultfd write-protect is not available\n");
+        return FALSE;
+      }
+      if (!uffd_wp_scan_supported((ptr_t)soft_vdb_buf)) {
+        GC_COND_LOG_PRINTF("PAGEMAP_SCAN is not supported by kernel\n");
+        uffd_wp_close();
+        return FALSE;
+      }
+      return TRUE;
+    }
+
+    static GC_bool uffd_wp_register(ptr_t start, ptr_t limit)
+    {
+      struct uffdio_register reg;
+
+      GC_ASSERT(GC_page_size != 0);
+      BZERO(&reg, sizeof(reg));
+      reg.range.start = (word)start & ~(GC_page_size-1);
+      reg.range.len = (((word)limit + GC_page_size-1) & ~(GC_page_size-1))
+                      - reg.range.start;
+      reg.mode = UFFDIO_REGISTER_MODE_WP;
+      return ioctl(uffd_wp_fd, UFFDIO_REGISTER, &reg) != -1;
+    }
+
+    /* Fetch the ranges written since the previous scan of the given    */
+    /* heap section (or since its registration), and write-protect the  */
+    /* ranges again.  Return FALSE on failure.                          */
+    static GC_bool uffd_wp_set_grungy_pages(ptr_t vaddr, ptr_t limit,
+                                            GC_bool output_unneeded)
+    {
+      struct page_region *regions = (struct page_region *)soft_vdb_buf;
+      word end;
+
+      GC_ASSERT(GC_page_size != 0);
+      vaddr = (ptr_t)((word)vaddr & ~(GC_page_size-1));
+      end = ((word)limit + GC_page_size-1) & ~(GC_page_size-1);
+      while ((word)vaddr < end) {
+        struct pm_scan_arg arg;
+        long i, res;
+
+        BZERO(&arg, sizeof(arg));
+        arg.size = sizeof(arg);
+        arg.flags = PM_SCAN_WP_MATCHING | PM_SCAN_CHECK_WPASYNC;
+        arg.start = (word)vaddr;
+        arg.end = end;
+        arg.vec = (word)regions;
+        arg.vec_len = VDB_BUF_SZ / sizeof(struct page_region);
+        arg.category_mask = PAGE_IS_WRITTEN;
+        arg.return_mask = PAGE_IS_WRITTEN;
+        res = ioctl(pagemap_fd, PAGEMAP_SCAN, &arg);
+        if (res < 0 || arg.walk_end <= (word)vaddr)
+          return FALSE;
+
+        if (!output_unneeded) {
+          for (i = 0; i < res; i++) {
+            struct hblk *h;
+
+#           ifdef DEBUG_DIRTY_BITS
+              GC_log_printf("dirty pages at: %p..%p\n",
+                            (void *)(word)regions[i].start,
+                            (void *)(word)regions[i].end);
+#           endif
+            for (h = (struct hblk *)(word)regions[i].start;
+                 (word)h < (word)regions[i].end; h++) {
+              word index = PHT_HASH(h);
+
+              set_pht_entry_from_index(GC_grungy_pages, index);
+            }
+          }
+        }
+        /* Continue if the regions buffer is full.      */
+        vaddr = (ptr_t)(word)arg.walk_end;
+      }
+      return TRUE;
+    }
+
+    /* Return FALSE if the soft-dirty bits should be used instead.  If  */
+    /* the latter are not supported, then all pages are reported dirty */
+    /* on failure, and the registration is retried the next time.       */
+    static GC_bool uffd_wp_read_dirty(GC_bool output_unneeded)
+    {
+      word i;
+
+      /* Lazily register the newly added heap sections.  All pages of  */
+      /* a just registered range are reported as written by the scan.  */
+      for (; uffd_registered_sects < GC_n_heap_sects;
+           uffd_registered_sects++) {
+        ptr_t start = GC_heap_sects[uffd_registered_sects].hs_start;
+
+        if (!uffd_wp_register(start, start
+                        + GC_heap_sects[uffd_registered_sects].hs_bytes))
+          break;
+      }
+
+      if (uffd_registered_sects == GC_n_heap_sects) {
+        if (!output_unneeded)
+          BZERO(GC_grungy_pages, sizeof(GC_grungy_pages));
+        for (i = 0; i != GC_n_heap_sects; ++i) {
+          ptr_t vaddr = GC_heap_sects[i].hs_start;
+
+          if (!uffd_wp_set_grungy_pages(vaddr,
+                                        vaddr + GC_heap_sects[i].hs_bytes,
+                                        output_unneeded))
+            break;
+        }
+        if (i == GC_n_heap_sects) {
+#         ifdef CHECKSUMS
+            if (!output_unneeded)
+              GC_or_pages(GC_written_pages, GC_grungy_pages);
+#         endif
+          return TRUE;
+        }
+      }
+
+      WARN("userfaultfd write-protect failed, errno= %" WARN_PRIdPTR
+           "\n", (signed_word)errno);
+      if (uffd_soft_dirty_fallback) {
+        /* The soft-dirty bits have never been cleared while userfaultfd */
+        /* was in use, thus the first read of them reports all the pages */
+        /* as dirty.                                                     */
+        uffd_wp_close();
+        return FALSE;
+      }
+      if (!output_unneeded) {
+        /* Punt: */
+        memset(GC_grungy_pages, 0xff, sizeof(page_hash_table));
+#       ifdef CHECKSUMS
+          memset(GC_written_pages, 0xff, sizeof(page_hash_table));
+#       endif
+      }
+      return TRUE;
+    }
+# endif /* UFFD_WP_VDB */
+
 # ifdef CAN_HANDLE_FORK
     GC_INNER void GC_dirty_update_child(void)
     {
@@ -3865,6 +4736,11 @@ GC_INLINE void GC_proc_read_dirty(GC_bool output_unneeded)
       close(pagemap_fd);
       if (!soft_dirty_open_files())
         GC_incremental = FALSE;
+#     ifdef UFFD_WP_VDB
+        uffd_wp_update_child();
+        if (-1 == clear_refs_fd)
+          GC_incremental = FALSE;
+#     endif
     }
 # endif /* CAN_HANDLE_FORK */
 
@@ -3920,6 +4796,8 @@ GC_INLINE void GC_proc_read_dirty(GC_bool output_unneeded)
     GC_INNER GC_bool GC_dirty_init(void)
 # endif
   {
+    GC_bool soft_dirty_ok;
+
     GC_ASSERT(I_HOLD_LOCK());
     GC_ASSERT(NULL == soft_vdb_buf);
 #   ifdef MPROTECT_VDB
@@ -3944,7 +4822,14 @@ GC_INLINE void GC_proc_read_dirty(GC_bool output_unneeded)
     soft_vdb_buf = (pagemap_elem_t *)GC_scratch_alloc(VDB_BUF_SZ);
     if (NULL == soft_vdb_buf)
       ABORT("Insufficient space for /proc pagemap buffer");
-    if (!detect_soft_dirty_supported((ptr_t)soft_vdb_buf)) {
+    soft_dirty_ok = detect_soft_dirty_supported((ptr_t)soft_vdb_buf);
+#   ifdef UFFD_WP_VDB
+      /* Prefer userfaultfd; the soft-dirty bits are a fallback.        */
+      uffd_soft_dirty_fallback = soft_dirty_ok;
+      if (uffd_wp_init())
+        return TRUE;
+#   endif
+    if (!soft_dirty_ok) {
       GC_COND_LOG_PRINTF("Soft-dirty bit is not supported by kernel\n");
       /* Release the resources. */
       GC_scratch_recycle_no_gww(soft_vdb_buf, VDB_BUF_SZ);
@@ -4074,21 +4959,32 @@ GC_INLINE void GC_proc_read_dirty(GC_bool output_unneeded)
     GC_ASSERT(I_HOLD_LOCK());
 #   ifndef THREADS
       /* Similar as for GC_proc_read_dirty.     */
-      if (getpid() != saved_proc_pid
-          && (-1 == clear_refs_fd /* no need to retry */
-              || (close(clear_refs_fd), close(pagemap_fd),
-                  !soft_dirty_open_files()))) {
-        /* Failed to reopen the files.  */
-        if (!output_unneeded) {
-          /* Punt: */
-          memset(GC_grungy_pages, 0xff, sizeof(page_hash_table));
-#         ifdef CHECKSUMS
-            memset(GC_written_pages, 0xff, sizeof(page_hash_table));
-#         endif
+      if (getpid() != saved_proc_pid) {
+        if (clear_refs_fd != -1) {
+          close(clear_refs_fd);
+          close(pagemap_fd);
+          (void)soft_dirty_open_files();
+        }
+#       ifdef UFFD_WP_VDB
+          uffd_wp_update_child();
+#       endif
+        if (-1 == clear_refs_fd) {
+          /* Failed to reopen the files.        */
+          if (!output_unneeded) {
+            /* Punt: */
+            memset(GC_grungy_pages, 0xff, sizeof(page_hash_table));
+#           ifdef CHECKSUMS
+              memset(GC_written_pages, 0xff, sizeof(page_hash_table));
+#           endif
+          }
+          return;
         }
-        return;
       }
 #   endif
+#   ifdef UFFD_WP_VDB
+      if (GC_UFFD_WP_USED() && uffd_wp_read_dirty(output_unneeded))
+        return;
+#   endif
 
     if (!output_unneeded) {
       word i;
@@ -4114,6 +5010,12 @@ GC_INLINE void GC_proc_read_dirty(GC_bool output_unneeded)
                                 (int)i < n_root_sets-1 ?
                                     GC_static_roots[i+1].r_start : NULL);
         }
+#     endif
+#     ifdef FROZEN_ROOTS
+        for (i = 0; (int)i < GC_n_frozen_roots; ++i) {
+          soft_set_grungy_pages(GC_frozen_roots[i].fr_start,
+                                GC_frozen_roots[i].fr_end, NULL);
+        }
 #     endif
     }
 
@@ -4152,21 +5054,36 @@ GC_INNER GC_bool GC_dirty_init(void)
 }
 #endif /* PCR_VDB */
 
-#ifndef GC_DISABLE_INCREMENTAL
+#ifdef GC_DISABLE_INCREMENTAL
+  GC_API unsigned char * GC_CALL GC_get_card_table(void)
+  {
+    return NULL;
+  }
+#else
   GC_INNER GC_bool GC_manual_vdb = FALSE;
 
-  /* Manually mark the page containing p as dirty.  Logically, this     */
+  /* The card table written by the client write barrier (see            */
+  /* GC_CARD_MARK) in the manual VDB mode.  Excluded from the roots.    */
+  /* The GC_API attribute (export, visibility) comes from the           */
+  /* declaration in gc_inline.h (included by gc_priv.h), like for the   */
+  /* other public variables; GC_API itself may expand to extern.        */
+  unsigned char GC_card_table[GC_CARD_TABLE_SIZE];
+
+  GC_API unsigned char * GC_CALL GC_get_card_table(void)
+  {
+    return GC_card_table;
+  }
+
+  /* Manually mark the card containing p as dirty.  Logically, this     */
   /* dirties the entire object.                                         */
   GC_INNER void GC_dirty_inner(const void *p)
   {
-    word index = PHT_HASH(p);
-
 #   if defined(MPROTECT_VDB)
-      /* Do not update GC_dirty_pages if it should be followed by the   */
+      /* Do not update the dirty bits if it should be followed by the   */
       /* page unprotection.                                             */
       GC_ASSERT(GC_manual_vdb);
 #   endif
-    async_set_pht_entry_from_index(GC_dirty_pages, index);
+    GC_CARD_MARK(p);
   }
 
   /* Retrieve system dirty bits for the heap to a local buffer (unless  */
@@ -4176,22 +5093,23 @@ GC_INNER GC_bool GC_dirty_init(void)
   GC_INNER void GC_read_dirty(GC_bool output_unneeded)
   {
     GC_ASSERT(I_HOLD_LOCK());
-    if (GC_manual_vdb
-#       if defined(MPROTECT_VDB)
-          || !GC_GWW_AVAILABLE()
-#       endif
-        ) {
+    if (GC_manual_vdb) {
       if (!output_unneeded)
-        BCOPY((/* no volatile */ void *)GC_dirty_pages, GC_grungy_pages,
-              sizeof(GC_dirty_pages));
-      BZERO((/* no volatile */ void *)GC_dirty_pages,
-            sizeof(GC_dirty_pages));
-#     ifdef MPROTECT_VDB
-        if (!GC_manual_vdb)
-          GC_protect_heap();
-#     endif
+        BCOPY(GC_card_table, GC_grungy_cards, sizeof(GC_card_table));
+      BZERO(GC_card_table, sizeof(GC_card_table));
       return;
     }
+#   ifdef MPROTECT_VDB
+      if (!GC_GWW_AVAILABLE()) {
+        if (!output_unneeded)
+          BCOPY((/* no volatile */ void *)GC_dirty_pages, GC_grungy_pages,
+                sizeof(GC_dirty_pages));
+        BZERO((/* no volatile */ void *)GC_dirty_pages,
+              sizeof(GC_dirty_pages));
+        GC_protect_heap();
+        return;
+      }
+#   endif
 
 #   ifdef GWW_VDB
       GC_gww_read_dirty(output_unneeded);
@@ -4223,10 +5141,12 @@ GC_INNER GC_bool GC_dirty_init(void)
       if (GC_manual_vdb) return FALSE;
 #     if defined(MPROTECT_VDB)
         /* Currently used only in conjunction with SOFT_VDB.    */
-        return GC_GWW_AVAILABLE();
+        /* The static data is not write-protected by userfaultfd */
+        /* (as it is not an anonymous mapping generally).        */
+        return GC_GWW_AVAILABLE() && !GC_UFFD_WP_USED();
 #     else
         GC_ASSERT(GC_incremental);
-        return TRUE;
+        return !GC_UFFD_WP_USED();
 #     endif
     }
 # endif
@@ -4239,6 +5159,17 @@ GC_INNER GC_bool GC_dirty_init(void)
   {
     word index;
 
+    if (GC_manual_vdb) {
+      if (NULL == HDR(h))
+        return TRUE;
+      return GC_cards_were_dirty((ptr_t)h, HBLKSIZE);
+    }
+#   ifdef USE_LARGE_OBJ_SPACE
+      /* The large-object space is outside the heap sections, thus its  */
+      /* pages are never write-protected.                               */
+      if (GC_is_los_page(h))
+        return TRUE;
+#   endif
 #   ifdef PCR_VDB
       if (!GC_manual_vdb) {
         if ((word)h < (word)GC_vd_base
@@ -5019,6 +5950,25 @@ GC_API void GC_CALL GC_set_pages_executable(int value)
   GC_pages_executable = (GC_bool)(value != 0);
 }
 
+GC_API void GC_CALL GC_set_huge_pages(int value)
+{
+  GC_ASSERT(!GC_is_initialized);
+# ifdef USE_HUGE_PAGES
+    GC_huge_pages = (GC_bool)(value != 0);
+# else
+    UNUSED_ARG(value);
+# endif
+}
+
+GC_API int GC_CALL GC_get_huge_pages(void)
+{
+# ifdef USE_HUGE_PAGES
+    return (int)GC_huge_pages;
+# else
+    return 0;
+# endif
+}
+
 /* Returns non-zero if the GC-allocated memory is executable.   */
 /* GC_get_pages_executable is defined after all the places      */
 /* where GC_get_pages_executable is undefined.                  */
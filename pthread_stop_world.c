@@ -244,7 +244,116 @@ GC_API int GC_CALL GC_get_thr_restart_signal(void)
 # define ao_store_async(p, v) AO_store(p, v)
 #endif /* !BASE_ATOMIC_OPS_EMULATED */
 
-STATIC sem_t GC_suspend_ack_sem; /* also used to acknowledge restart */
+#if defined(LINUX) && !defined(NO_FUTEX_ACK) \
+    && defined(AO_HAVE_int_fetch_and_add) && defined(AO_HAVE_int_load) \
+    && defined(AO_HAVE_int_store) && defined(AO_HAVE_nop_full)
+  /* Use a single futex-based counter instead of the semaphore for the  */
+  /* acknowledgements, thus the thread stopping (or starting) the world */
+  /* is woken up just once, when the last thread has acknowledged.      */
+# define USE_FUTEX_ACK
+#endif
+
+#ifdef USE_FUTEX_ACK
+# include <limits.h>
+# include <linux/futex.h>
+# include <sys/syscall.h>
+
+  STATIC volatile unsigned GC_suspend_ack_cnt = 0;
+                        /* The number of the received acknowledgements  */
+                        /* not consumed yet by the thread stopping the  */
+                        /* world.  Also used to acknowledge restart.    */
+  STATIC volatile unsigned GC_suspend_ack_wait_cnt = 0;
+                        /* The value of GC_suspend_ack_cnt the thread   */
+                        /* stopping the world waits for (zero means it  */
+                        /* does not wait).                              */
+
+  /* Acknowledge the suspension (or restart) of the current thread.     */
+  /* Async-signal-safe (errno is restored by the signal handler).       */
+  static void ack_post(void)
+  {
+    unsigned cnt;
+
+    AO_nop_full(); /* the thread state is updated before the ack */
+    cnt = AO_int_fetch_and_add(&GC_suspend_ack_cnt, 1) + 1;
+    AO_nop_full();
+    if (AO_int_load(&GC_suspend_ack_wait_cnt) == cnt)
+      (void)syscall(SYS_futex, &GC_suspend_ack_cnt, FUTEX_WAKE_PRIVATE, 1,
+                    NULL, NULL, 0);
+  }
+
+  static int get_ack_count(void)
+  {
+    return (int)AO_int_load(&GC_suspend_ack_cnt);
+  }
+
+  /* Wait until n acknowledgements are received or, if pts is non-NULL, */
+  /* until the given absolute time (of CLOCK_REALTIME) is reached.      */
+  /* Consume the received acknowledgements (but not more than n) and    */
+  /* return their number.                                               */
+  static int ack_wait(int n, const struct timespec *pts)
+  {
+    unsigned cnt;
+
+    AO_int_store(&GC_suspend_ack_wait_cnt, (unsigned)n);
+    AO_nop_full();
+    for (;;) {
+      cnt = AO_int_load(&GC_suspend_ack_cnt);
+      if (cnt >= (unsigned)n) {
+        cnt = (unsigned)n;
+        break;
+      }
+      if (syscall(SYS_futex, &GC_suspend_ack_cnt,
+                  pts != NULL ? FUTEX_WAIT_BITSET_PRIVATE
+                                | FUTEX_CLOCK_REALTIME
+                              : FUTEX_WAIT_PRIVATE,
+                  cnt, pts, NULL, FUTEX_BITSET_MATCH_ANY) != 0
+          && errno != EAGAIN && errno != EINTR) {
+        if (NULL == pts)
+          ABORT("futex wait failed");
+        break; /* timed out or not supported */
+      }
+    }
+    AO_int_store(&GC_suspend_ack_wait_cnt, 0);
+    AO_nop_full(); /* see the thread state updated by the acked ones */
+    if (cnt != 0)
+      (void)AO_int_fetch_and_add(&GC_suspend_ack_cnt, (unsigned)-(int)cnt);
+    return (int)cnt;
+  }
+#else
+  STATIC sem_t GC_suspend_ack_sem; /* also used to acknowledge restart */
+
+# define ack_post() (void)sem_post(&GC_suspend_ack_sem)
+
+  static int get_ack_count(void)
+  {
+    int value;
+
+    sem_getvalue(&GC_suspend_ack_sem, &value);
+    return value;
+  }
+#endif /* !USE_FUTEX_ACK */
+
+#ifdef PARALLEL_RESTART
+  static int raise_signal(GC_thread p, int sig);
+
+  /* Send the restart signal to the threads this one is responsible     */
+  /* for (see GC_build_restart_tree).  Called from the signal handler   */
+  /* once the thread has been restarted.  Errors are ignored, the lost  */
+  /* threads are resent the signal by resend_lost_signals.              */
+  static void forward_restart_signal(GC_thread me)
+  {
+    int i;
+
+    for (i = 0; i < 2; i++) {
+      GC_thread p = me -> restart_children[i];
+
+      if (p != NULL) {
+        me -> restart_children[i] = NULL;
+        (void)raise_signal(p, GC_sig_thr_restart);
+      }
+    }
+  }
+#endif /* PARALLEL_RESTART */
 
 STATIC void GC_suspend_handler_inner(ptr_t dummy, void *context);
 
@@ -332,6 +441,9 @@ STATIC void GC_suspend_handler_inner(ptr_t dummy, void *context)
   IF_CANCEL(int cancel_state;)
 # ifdef GC_ENABLE_SUSPEND_THREAD
     word suspend_cnt;
+# endif
+# ifdef THREAD_STATS
+    CLOCK_TYPE start_time, end_time;
 # endif
   AO_t my_stop_count = ao_load_acquire_async(&GC_stop_count);
                         /* After the barrier, this thread should see    */
@@ -358,6 +470,13 @@ STATIC void GC_suspend_handler_inner(ptr_t dummy, void *context)
 # endif
   me = GC_lookup_thread_async(self);
   if ((me -> last_stop_count & ~(word)THREAD_RESTARTED) == my_stop_count) {
+      if (ao_load_async(&(me -> safepoint_stop_count)) == my_stop_count) {
+        /* The thread has reached a safepoint after the deadline, but   */
+        /* the signal is sent to it anyway, thus just acknowledge.      */
+        ack_post();
+        RESTORE_CANCEL(cancel_state);
+        return;
+      }
       /* Duplicate signal.  OK if we are retrying.      */
       if (!GC_retry_signals) {
           WARN("Duplicate suspend signal in thread %p\n", self);
@@ -375,11 +494,14 @@ STATIC void GC_suspend_handler_inner(ptr_t dummy, void *context)
 # ifdef GC_ENABLE_SUSPEND_THREAD
     suspend_cnt = (word)ao_load_async(&(me -> ext_suspend_cnt));
 # endif
+# ifdef THREAD_STATS
+    GET_TIME(start_time); /* clock_gettime is async-signal-safe */
+# endif
 
   /* Tell the thread that wants to stop the world that this     */
   /* thread has been stopped.  Note that sem_post() is          */
   /* the only async-signal-safe primitive in LinuxThreads.      */
-  sem_post(&GC_suspend_ack_sem);
+  ack_post();
   ao_store_release_async(&(me -> last_stop_count), my_stop_count);
 
   /* Wait until that thread tells us to restart by sending      */
@@ -403,6 +525,13 @@ STATIC void GC_suspend_handler_inner(ptr_t dummy, void *context)
 #          endif
           );
 
+# ifdef PARALLEL_RESTART
+    forward_restart_signal(me);
+# endif
+# ifdef THREAD_STATS
+    GET_TIME(end_time);
+    me -> stopped_ns += NS_TIME_DIFF(end_time, start_time);
+# endif
 # ifdef DEBUG_THREADS
     GC_log_printf("Continuing %p\n", (void *)self);
 # endif
@@ -421,7 +550,7 @@ STATIC void GC_suspend_handler_inner(ptr_t dummy, void *context)
     /* less likely than losing the SUSPEND signal as we do not do       */
     /* much between the first sem_post and sigsuspend calls), more      */
     /* handshaking is provided to work around it.                       */
-    sem_post(&GC_suspend_ack_sem);
+    ack_post();
     /* Set the flag that the thread has been restarted. */
     if (GC_retry_signals)
       ao_store_release_async(&(me -> last_stop_count),
@@ -430,23 +559,206 @@ STATIC void GC_suspend_handler_inner(ptr_t dummy, void *context)
   RESTORE_CANCEL(cancel_state);
 }
 
-static void suspend_restart_barrier(int n_live_threads)
+STATIC GC_bool GC_cooperative_suspend = FALSE;
+                        /* Wait for threads to reach a safepoint before */
+                        /* sending them the suspend signal.             */
+
+#ifndef GC_SAFEPOINT_TIMEOUT
+# define GC_SAFEPOINT_TIMEOUT 1000 /* us */
+#endif
+STATIC unsigned long GC_safepoint_timeout = GC_SAFEPOINT_TIMEOUT;
+
+volatile GC_word GC_safepoint_requested = 0;
+
+static pthread_mutex_t safepoint_ml = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t safepoint_cv = PTHREAD_COND_INITIALIZER;
+                        /* Used to wake up the threads stopped at       */
+                        /* a safepoint (signaled by GC_start_world).    */
+
+GC_API void GC_CALL GC_set_cooperative_suspend(int value)
+{
+  DCL_LOCK_STATE;
+
+  LOCK();
+  GC_cooperative_suspend = (GC_bool)(value != 0);
+  UNLOCK();
+}
+
+GC_API int GC_CALL GC_get_cooperative_suspend(void)
+{
+  return (int)GC_cooperative_suspend;
+}
+
+GC_API void GC_CALL GC_set_safepoint_timeout(unsigned long us)
+{
+  GC_safepoint_timeout = us;
+}
+
+GC_API unsigned long GC_CALL GC_get_safepoint_timeout(void)
+{
+  return GC_safepoint_timeout;
+}
+
+STATIC void GC_safepoint_inner(ptr_t dummy, void *context)
+{
+  GC_thread me;
+  AO_t my_stop_count;
+  sigset_t set, oldset;
+# ifdef E2K
+    ptr_t bs_lo;
+    size_t stack_size;
+# endif
+# ifdef THREAD_STATS
+    CLOCK_TYPE start_time, end_time;
+# endif
+  IF_CANCEL(int cancel_state;)
+
+  UNUSED_ARG(dummy);
+  UNUSED_ARG(context);
+  /* Block the suspend signal so that the world cannot be stopped (by   */
+  /* signaling this thread) while we look up the threads table and      */
+  /* until we are ready to be treated as stopped.  The pending signal,  */
+  /* if any, is handled once unblocked.                                 */
+  if (sigemptyset(&set) != 0 || sigaddset(&set, GC_sig_suspend) != 0)
+    ABORT("sigset setup failed");
+  if (pthread_sigmask(SIG_BLOCK, &set, &oldset) != 0)
+    ABORT("pthread_sigmask failed");
+  if (!AO_load_acquire((volatile AO_t *)&GC_safepoint_requested)) {
+    /* The world has been stopped (and restarted) already. */
+    (void)pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+    return;
+  }
+  my_stop_count = AO_load_acquire(&GC_stop_count);
+  if ((my_stop_count & THREAD_RESTARTED) != 0) {
+    (void)pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+    return;
+  }
+
+  DISABLE_CANCEL(cancel_state);
+  me = GC_lookup_thread_async(pthread_self());
+  if ((me -> flags & DO_BLOCKING) != 0
+      || (me -> last_stop_count & ~(word)THREAD_RESTARTED) == my_stop_count) {
+    /* Already treated as stopped (e.g., called from a function with    */
+    /* the collector inactive).                                         */
+    RESTORE_CANCEL(cancel_state);
+    (void)pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+    return;
+  }
+  GC_store_stack_ptr(me);
+# ifdef E2K
+    GC_ASSERT(NULL == me -> backing_store_end);
+    GET_PROCEDURE_STACK_LOCAL(&bs_lo, &stack_size);
+    me -> backing_store_end = bs_lo;
+    me -> backing_store_ptr = bs_lo + stack_size;
+# endif
+# ifdef THREAD_STATS
+    GET_TIME(start_time);
+# endif
+  AO_store_release(&(me -> safepoint_stop_count), my_stop_count);
+  AO_store_release(&(me -> last_stop_count), my_stop_count);
+  (void)pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+
+  /* Wait until the world is restarted.       */
+  (void)pthread_mutex_lock(&safepoint_ml);
+  while (AO_load_acquire(&GC_stop_count) == my_stop_count)
+    (void)pthread_cond_wait(&safepoint_cv, &safepoint_ml);
+  (void)pthread_mutex_unlock(&safepoint_ml);
+
+# ifdef THREAD_STATS
+    GET_TIME(end_time);
+    me -> stopped_ns += NS_TIME_DIFF(end_time, start_time);
+# endif
+# ifdef E2K
+    GC_ASSERT(me -> backing_store_end == bs_lo);
+    FREE_PROCEDURE_STACK_LOCAL(bs_lo, stack_size);
+    me -> backing_store_ptr = NULL;
+    me -> backing_store_end = NULL;
+# endif
+  RESTORE_CANCEL(cancel_state);
+}
+
+GC_API void GC_CALL GC_safepoint(void)
+{
+  if (GC_safepoint_requested)
+    GC_with_callee_saves_pushed(GC_safepoint_inner, NULL);
+}
+
+#ifndef SAFEPOINT_YIELD_CNT
+# define SAFEPOINT_YIELD_CNT 16
+#endif
+#ifndef SAFEPOINT_POLL_USECS
+# define SAFEPOINT_POLL_USECS 50 /* us */
+#endif
+#ifndef SAFEPOINT_MAX_STALLED_POLLS
+# define SAFEPOINT_MAX_STALLED_POLLS 4
+#endif
+
+/* Wait (for up to GC_safepoint_timeout) until all running threads      */
+/* are stopped at a safepoint.  The threads which have not reached it   */
+/* are to be sent the suspend signal by the caller.  The waiting ends   */
+/* earlier if no more threads reach a safepoint during a few polls      */
+/* (e.g., the remaining ones are blocked on the allocation lock).       */
+STATIC void GC_wait_for_safepoints(void)
 {
+  pthread_t self = pthread_self();
+  unsigned long wait_usecs = 0;
+  int prev_pending = -1;
+  unsigned iter, stalled_polls = 0;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  AO_store_release((volatile AO_t *)&GC_safepoint_requested, 1);
+  for (iter = 0; ; iter++) {
+    int n_pending = 0;
     int i;
 
-    for (i = 0; i < n_live_threads; i++) {
-      while (0 != sem_wait(&GC_suspend_ack_sem)) {
-        /* On Linux, sem_wait is documented to always return zero.      */
-        /* But the documentation appears to be incorrect.               */
-        /* EINTR seems to happen with some versions of gdb.             */
-        if (errno != EINTR)
-          ABORT("sem_wait failed");
+    for (i = 0; i < GC_thread_table_sz; i++) {
+      GC_thread p;
+
+      for (p = GC_threads[i]; p != NULL; p = p -> tm.next) {
+        if (THREAD_EQUAL(p -> id, self)
+            || (p -> flags & (FINISHED | DO_BLOCKING)) != 0)
+          continue;
+#       ifdef GC_ENABLE_SUSPEND_THREAD
+          if ((p -> ext_suspend_cnt & 1) != 0) continue;
+#       endif
+        if (AO_load_acquire(&(p -> last_stop_count)) != GC_stop_count)
+          n_pending++;
       }
     }
-#   ifdef GC_ASSERTIONS
-      sem_getvalue(&GC_suspend_ack_sem, &i);
-      GC_ASSERT(0 == i);
+    if (0 == n_pending || wait_usecs >= GC_safepoint_timeout) break;
+    if (iter < SAFEPOINT_YIELD_CNT) {
+      sched_yield();
+      continue;
+    }
+    if (n_pending != prev_pending) {
+      prev_pending = n_pending;
+      stalled_polls = 0;
+    } else if (++stalled_polls > SAFEPOINT_MAX_STALLED_POLLS) {
+      break;
+    }
+    GC_usleep(SAFEPOINT_POLL_USECS);
+    wait_usecs += SAFEPOINT_POLL_USECS;
+  }
+}
+
+static void suspend_restart_barrier(int n_live_threads)
+{
+#   ifdef USE_FUTEX_ACK
+      (void)ack_wait(n_live_threads, NULL);
+#   else
+      int i;
+
+      for (i = 0; i < n_live_threads; i++) {
+        while (0 != sem_wait(&GC_suspend_ack_sem)) {
+          /* On Linux, sem_wait is documented to always return zero.    */
+          /* But the documentation appears to be incorrect.             */
+          /* EINTR seems to happen with some versions of gdb.           */
+          if (errno != EINTR)
+            ABORT("sem_wait failed");
+        }
+      }
 #   endif
+    GC_ASSERT(get_ack_count() == 0);
 }
 
 # define WAIT_UNIT 3000 /* us */
@@ -463,9 +775,8 @@ static int resend_lost_signals(int n_live_threads,
       int prev_sent = 0;
 
       for (;;) {
-        int ack_count;
+        int ack_count = get_ack_count();
 
-        sem_getvalue(&GC_suspend_ack_sem, &ack_count);
         if (ack_count == n_live_threads)
           break;
         if (wait_usecs > RETRY_INTERVAL) {
@@ -479,7 +790,7 @@ static int resend_lost_signals(int n_live_threads,
 
           GC_COND_LOG_PRINTF("Resent %d signals after timeout, retry: %d\n",
                              newly_sent, retry);
-          sem_getvalue(&GC_suspend_ack_sem, &ack_count);
+          ack_count = get_ack_count();
           if (newly_sent < n_live_threads - ack_count) {
             WARN("Lost some threads while stopping or starting world?!\n", 0);
             n_live_threads = ack_count + newly_sent;
@@ -513,10 +824,14 @@ static void resend_lost_signals_retry(int n_live_threads,
       TS_NSEC_ADD(ts, TIMEOUT_BEFORE_RESEND * 1000);
       /* First, try to wait for the semaphore with some timeout.            */
       /* On failure, fallback to WAIT_UNIT pause and resend of the signal.  */
-      for (i = 0; i < n_live_threads; i++) {
-        if (0 != sem_timedwait(&GC_suspend_ack_sem, &ts))
-          break; /* Wait timed out or any other error.  */
-      }
+#     ifdef USE_FUTEX_ACK
+        i = ack_wait(n_live_threads, &ts);
+#     else
+        for (i = 0; i < n_live_threads; i++) {
+          if (0 != sem_timedwait(&GC_suspend_ack_sem, &ts))
+            break; /* Wait timed out or any other error.  */
+        }
+#     endif
       /* Update the count of threads to wait the ack from.      */
       n_live_threads -= i;
     }
@@ -677,6 +992,9 @@ STATIC void GC_restart_handler(int sig)
         if (GC_parallel)
           GC_wait_for_reclaim();
 #     endif
+#     ifdef THREAD_LOCAL_SWEEP
+        GC_wait_for_sweep_claims(); /* for the same reason */
+#     endif
 
       if (GC_manual_vdb) {
         /* See the relevant comment in GC_stop_world.   */
@@ -771,6 +1089,92 @@ STATIC void GC_restart_handler(int sig)
 # undef ao_store_release_async
 #endif /* !GC_OPENBSD_UTHREADS && !NACL */
 
+#if defined(SIGNAL_BASED_STOP_WORLD) && !defined(STACK_GROWS_UP) \
+    && !defined(GC_DISABLE_INCREMENTAL)
+  /* Push the stack [lo, hi) of a stopped thread except for its cold    */
+  /* part which has not changed since the previous scan of the stack    */
+  /* (if GC_push_roots allows that, i.e. the objects referenced from    */
+  /* there are known to be marked), then save a copy of the stack (up   */
+  /* to the buffer size, starting from hi) to be compared against at    */
+  /* the next collection.  The stacks are scanned eagerly in the        */
+  /* incremental mode, so the copy matches the scanned contents.        */
+  STATIC void GC_push_stack_above_watermark(GC_thread p, ptr_t lo,
+                                            ptr_t hi)
+  {
+    ptr_t watermark = hi; /* [watermark, hi) is left unscanned */
+    ptr_t copy_lo;
+
+    GC_ASSERT(((word)hi & (sizeof(word)-1)) == 0);
+    if (p -> stack_snapshot_len > 0 && p -> stack_snapshot_hi == hi
+        && GC_skip_unchanged_stacks
+        && p -> stack_snapshot_gc_no + 1 >= GC_gc_no) {
+      word *live = (word *)hi;
+      word *saved = (word *)(p -> stack_snapshot + p -> stack_snapshot_size);
+      word *lim = (word *)(hi - p -> stack_snapshot_len);
+
+      if ((word)lim < (word)lo)
+        lim = (word *)(((word)lo + sizeof(word)-1) & ~(sizeof(word)-1));
+      while ((word)live > (word)lim && live[-1] == saved[-1]) {
+        live--;
+        saved--;
+      }
+      watermark = (ptr_t)live;
+    }
+    GC_push_all_stack(lo, watermark);
+
+    if (NULL == p -> stack_snapshot) {
+      size_t bytes = ROUNDUP_PAGESIZE((size_t)(hi - lo));
+
+      p -> stack_snapshot = (ptr_t)GC_scratch_alloc(bytes);
+      if (NULL == p -> stack_snapshot) return;
+      p -> stack_snapshot_size = bytes;
+    }
+    copy_lo = (word)(hi - lo) > p -> stack_snapshot_size
+                ? hi - p -> stack_snapshot_size
+                : (ptr_t)(((word)lo + sizeof(word)-1) & ~(sizeof(word)-1));
+    if ((word)copy_lo < (word)watermark)
+      BCOPY(copy_lo, p -> stack_snapshot + p -> stack_snapshot_size
+                     - (size_t)(hi - copy_lo), (size_t)(watermark - copy_lo));
+    p -> stack_snapshot_len = (size_t)(hi - copy_lo);
+    p -> stack_snapshot_hi = hi;
+    p -> stack_snapshot_gc_no = GC_gc_no;
+  }
+#endif
+
+#ifdef FIBER_STACKS
+  /* Return the cold end of the stack the thread runs on, lo being its  */
+  /* stack pointer and hi being the cold end of its own stack.  The     */
+  /* candidates are the own stack and the fibers the thread has just    */
+  /* switched from and to; as the stacks do not overlap, the one        */
+  /* containing lo has the nearest cold end above lo.  If the thread    */
+  /* runs on a fiber, then the saved part of the own stack is pushed    */
+  /* (and its size is added to *ptotal_size).                           */
+  static ptr_t fiber_stack_hi(GC_thread p, ptr_t lo, ptr_t hi,
+                              word *ptotal_size)
+  {
+    GC_fiber_t fibers[2];
+    ptr_t res = hi;
+    ptr_t own_lo;
+    int i;
+
+    fibers[0] = (GC_fiber_t)AO_load(&(p -> fiber_to));
+    fibers[1] = (GC_fiber_t)AO_load(&(p -> fiber_from));
+    for (i = 0; i < 2; i++) {
+      if (fibers[i] != NULL && (word)(fibers[i] -> stack_hi) > (word)lo
+          && (word)(fibers[i] -> stack_hi) < (word)res)
+        res = fibers[i] -> stack_hi;
+    }
+    if (res != hi) {
+      own_lo = (ptr_t)AO_load(&(p -> own_saved_sp));
+      if (own_lo != NULL && (word)own_lo < (word)hi) {
+        GC_push_all_stack(own_lo, hi);
+        *ptotal_size += (word)(hi - own_lo);
+      }
+    }
+    return res;
+  }
+#endif /* FIBER_STACKS */
+
 /* Should do exactly the right thing if the world is stopped; should    */
 /* not fail if it is not.                                               */
 GC_INNER void GC_push_all_stacks(void)
@@ -793,7 +1197,12 @@ GC_INNER void GC_push_all_stacks(void)
 #   ifdef DEBUG_THREADS
       GC_log_printf("Pushing stacks from thread %p\n", (void *)self);
 #   endif
-    for (i = 0; i < THREAD_TABLE_SZ; i++) {
+#   if defined(PARALLEL_MARK) && !defined(E2K)
+      /* On E2K, the procedure stack of the current thread is freed     */
+      /* before we return, thus it cannot be scanned later.             */
+      GC_defer_stacks_scan();
+#   endif
+    for (i = 0; i < GC_thread_table_sz; i++) {
       for (p = GC_threads[i]; p != NULL; p = p -> tm.next) {
 #       if defined(E2K) || defined(IA64)
           GC_bool is_self = FALSE;
@@ -801,6 +1210,17 @@ GC_INNER void GC_push_all_stacks(void)
 
         if (KNOWN_FINISHED(p)) continue;
         ++nthreads;
+#       ifdef PRECISE_STACK_ROOTS
+          if (p -> stack_roots_proc != 0) {
+            /* The client pushes the roots of the thread.       */
+            (*(p -> stack_roots_proc))(p -> stack_roots_cd);
+            if (!THREAD_EQUAL(p -> id, self)) {
+              p -> stack_snapshot_len = 0;
+              continue;
+            }
+            /* Our own frames are scanned conservatively anyway. */
+          }
+#       endif
         traced_stack_sect = p -> traced_stack_sect;
         if (THREAD_EQUAL(p -> id, self)) {
             GC_ASSERT((p -> flags & DO_BLOCKING) == 0);
@@ -857,13 +1277,34 @@ GC_INNER void GC_push_all_stacks(void)
                         (void *)p->id, (void *)lo, (void *)hi);
 #       endif
         if (0 == lo) ABORT("GC_push_all_stacks: sp not set!");
+#       ifdef FIBER_STACKS
+          if (p -> fiber_to != 0 || p -> fiber_from != 0)
+            hi = fiber_stack_hi(p, lo, hi, &total_size);
+#       endif
         if (p->altstack != NULL && (word)p->altstack <= (word)lo
             && (word)lo <= (word)p->altstack + p->altstack_size) {
           hi = p->altstack + p->altstack_size;
           /* FIXME: Need to scan the normal stack too, but how ? */
           /* FIXME: Assume stack grows down */
         }
-        GC_push_all_stack_sections(lo, hi, traced_stack_sect);
+#       if defined(SIGNAL_BASED_STOP_WORLD) && !defined(STACK_GROWS_UP) \
+           && !defined(GC_DISABLE_INCREMENTAL)
+          /* Only the threads stopped by us (in a world-stopped phase   */
+          /* of an incremental collection) have their stacks compared   */
+          /* against the snapshot.                                      */
+          if (GC_stack_watermarks && GC_auto_incremental
+              && (GC_stop_count & THREAD_RESTARTED) == 0
+              && NULL == traced_stack_sect
+              && ((word)hi & (sizeof(word)-1)) == 0
+              && !THREAD_EQUAL(p -> id, self)
+              && (p -> flags & DO_BLOCKING) == 0) {
+            GC_push_stack_above_watermark(p, lo, hi);
+          } else
+#       endif
+        /* else */ {
+          p -> stack_snapshot_len = 0;
+          GC_push_all_stack_sections(lo, hi, traced_stack_sect);
+        }
 #       ifdef STACK_GROWS_UP
           total_size += lo - hi;
 #       else
@@ -901,6 +1342,14 @@ GC_INNER void GC_push_all_stacks(void)
 #       endif
       }
     }
+#   ifdef FIBER_STACKS
+      total_size += GC_push_fiber_stacks();
+#   endif
+#   if defined(PARALLEL_MARK) && !defined(E2K)
+      /* Scan the stacks (which are not pushed lazily), sharing them    */
+      /* among the marker threads.                                      */
+      GC_scan_deferred_stacks();
+#   endif
     GC_VERBOSE_LOG_PRINTF("Pushed %d thread stacks\n", (int)nthreads);
     if (!found_me && !GC_in_thread_creation)
       ABORT("Collecting from unknown thread");
@@ -929,7 +1378,7 @@ STATIC int GC_suspend_all(void)
       GC_ASSERT((GC_stop_count & THREAD_RESTARTED) == 0);
 #   endif
     GC_ASSERT(I_HOLD_LOCK());
-    for (i = 0; i < THREAD_TABLE_SZ; i++) {
+    for (i = 0; i < GC_thread_table_sz; i++) {
       for (p = GC_threads[i]; p != NULL; p = p -> tm.next) {
         if (!THREAD_EQUAL(p -> id, self)) {
             if ((p -> flags & (FINISHED | DO_BLOCKING)) != 0) continue;
@@ -1076,6 +1525,8 @@ GC_INNER void GC_stop_world(void)
       /* (thus double-locking should not occur in                       */
       /* async_set_pht_entry_from_index based on test-and-set).         */
     }
+    if (GC_cooperative_suspend)
+      GC_wait_for_safepoints();
     n_live_threads = GC_suspend_all();
     if (GC_retry_signals) {
       resend_lost_signals_retry(n_live_threads, GC_suspend_all);
@@ -1084,6 +1535,7 @@ GC_INNER void GC_stop_world(void)
     }
     if (GC_manual_vdb)
       GC_release_dirty_lock(); /* cannot be done in GC_suspend_all */
+    AO_store((volatile AO_t *)&GC_safepoint_requested, 0);
 # endif
 
 # ifdef PARALLEL_MARK
@@ -1264,7 +1716,7 @@ GC_INNER void GC_stop_world(void)
 
       GC_ASSERT((GC_stop_count & THREAD_RESTARTED) != 0);
 #   endif
-    for (i = 0; i < THREAD_TABLE_SZ; i++) {
+    for (i = 0; i < GC_thread_table_sz; i++) {
       for (p = GC_threads[i]; p != NULL; p = p -> tm.next) {
         if (!THREAD_EQUAL(p -> id, self)) {
           if ((p -> flags & (FINISHED | DO_BLOCKING)) != 0) continue;
@@ -1275,6 +1727,9 @@ GC_INNER void GC_stop_world(void)
             if (GC_retry_signals
                 && AO_load(&(p -> last_stop_count)) == GC_stop_count)
               continue; /* The thread has been restarted. */
+            if ((AO_load(&(p -> safepoint_stop_count)) | THREAD_RESTARTED)
+                == GC_stop_count)
+              continue; /* Stopped at a safepoint, no signal needed. */
             n_live_threads++;
 #         endif
 #         ifdef DEBUG_THREADS
@@ -1309,10 +1764,111 @@ GC_INNER void GC_stop_world(void)
   }
 #endif /* !NACL */
 
+#ifdef PARALLEL_RESTART
+# ifndef PARALLEL_RESTART_ROOTS
+#   define PARALLEL_RESTART_ROOTS 4
+# endif
+
+  /* Arrange the threads to be restarted into a binary tree (except for */
+  /* the first PARALLEL_RESTART_ROOTS ones, each thread has a parent),  */
+  /* so that each restarted thread forwards the restart signal to its   */
+  /* children (thus the restart latency is logarithmic in the number    */
+  /* of threads, at least on a multiprocessor).  Should be called while */
+  /* the world is still stopped.  Returns the first thread in the       */
+  /* restart order list, the number of threads is stored to *pn.        */
+  STATIC GC_thread GC_build_restart_tree(int *pn)
+  {
+    GC_thread first = NULL;
+    GC_thread last = NULL;
+    GC_thread parent = NULL;
+    pthread_t self = pthread_self();
+    int n = 0;
+    int i, child_idx = 0;
+
+    GC_ASSERT((GC_stop_count & THREAD_RESTARTED) == 0);
+    for (i = 0; i < GC_thread_table_sz; i++) {
+      GC_thread p;
+
+      for (p = GC_threads[i]; p != NULL; p = p -> tm.next) {
+        if (THREAD_EQUAL(p -> id, self)
+            || (p -> flags & (FINISHED | DO_BLOCKING)) != 0)
+          continue;
+#       ifdef GC_ENABLE_SUSPEND_THREAD
+          if ((p -> ext_suspend_cnt & 1) != 0) continue;
+#       endif
+        if (AO_load(&(p -> safepoint_stop_count)) == GC_stop_count)
+          continue; /* stopped at a safepoint */
+        p -> restart_next = NULL;
+        p -> restart_children[0] = NULL;
+        p -> restart_children[1] = NULL;
+        if (NULL == first) {
+          first = p;
+          parent = p;
+        } else {
+          last -> restart_next = p;
+        }
+        last = p;
+        if (++n > PARALLEL_RESTART_ROOTS) {
+          parent -> restart_children[child_idx] = p;
+          if (++child_idx == 2) {
+            child_idx = 0;
+            parent = parent -> restart_next;
+          }
+        }
+      }
+    }
+    *pn = n;
+    return first;
+  }
+
+  /* Send the restart signal to the roots of the restart tree.  Return  */
+  /* the number of the threads expected to be restarted.                */
+  STATIC int GC_restart_tree_roots(GC_thread first, int n)
+  {
+    int n_live_threads = n;
+    int i = 0;
+    GC_thread p;
+
+    GC_ASSERT((GC_stop_count & THREAD_RESTARTED) != 0);
+    for (p = first; p != NULL; p = p -> restart_next, i++) {
+      if (i < PARALLEL_RESTART_ROOTS) {
+        int result;
+
+#       ifdef DEBUG_THREADS
+          GC_log_printf("Sending restart signal to %p\n", (void *)p->id);
+#       endif
+        result = raise_signal(p, GC_sig_thr_restart);
+        if (ESRCH == result) {
+          /* Not really there anymore.  The children, if any, are to be */
+          /* resent the signal.                                         */
+          n_live_threads--;
+          continue;
+        }
+        if (result != 0)
+          ABORT_ARG1("pthread_kill failed at resume",
+                     ": errcode= %d", result);
+      }
+      if (GC_on_thread_event)
+        GC_on_thread_event(GC_EVENT_THREAD_UNSUSPENDED,
+                           (void *)(word)THREAD_SYSTEM_ID(p));
+    }
+    return n_live_threads;
+  }
+#endif /* PARALLEL_RESTART */
+
 GC_INNER void GC_start_world(void)
 {
 # ifndef NACL
     int n_live_threads;
+#   ifdef PARALLEL_RESTART
+      GC_thread first = NULL;
+
+      /* The threads are forwarded the signal only if we wait for them  */
+      /* to acknowledge the restart, thus the tree is not accessed once */
+      /* we return.  On a uniprocessor, forwarding does not pay off.    */
+      if (GC_retry_signals && GC_nprocs > 1)
+        first = GC_build_restart_tree(&n_live_threads);
+#   endif
 
     GC_ASSERT(I_HOLD_LOCK()); /* held continuously since the world stopped */
 #   ifdef DEBUG_THREADS
@@ -1324,7 +1880,14 @@ GC_INNER void GC_start_world(void)
                     /* signal handler (note that pthread_kill is not on */
                     /* the list of functions which synchronize memory). */
 #   endif
-    n_live_threads = GC_restart_all();
+#   ifdef PARALLEL_RESTART
+      if (first != NULL) {
+        n_live_threads = GC_restart_tree_roots(first, n_live_threads);
+      } else
+#   endif
+    /* else */ {
+      n_live_threads = GC_restart_all();
+    }
 #   ifdef GC_OPENBSD_UTHREADS
       (void)n_live_threads;
 #   else
@@ -1338,6 +1901,14 @@ GC_INNER void GC_start_world(void)
           suspend_restart_barrier(n_live_threads);
         }
       }
+      if (GC_cooperative_suspend) {
+        /* Wake up the threads stopped at a safepoint.  This is done    */
+        /* last because a thread suspended by the signal might hold     */
+        /* the mutex.                                                   */
+        (void)pthread_mutex_lock(&safepoint_ml);
+        (void)pthread_cond_broadcast(&safepoint_cv);
+        (void)pthread_mutex_unlock(&safepoint_ml);
+      }
 #   endif
 #   ifdef DEBUG_THREADS
       GC_log_printf("World started\n");
@@ -1364,8 +1935,10 @@ GC_INNER void GC_stop_init(void)
     if (SIGNAL_UNSET == GC_sig_thr_restart)
         GC_sig_thr_restart = SIG_THR_RESTART;
 
-    if (sem_init(&GC_suspend_ack_sem, GC_SEM_INIT_PSHARED, 0) != 0)
+#   ifndef USE_FUTEX_ACK
+      if (sem_init(&GC_suspend_ack_sem, GC_SEM_INIT_PSHARED, 0) != 0)
         ABORT("sem_init failed");
+#   endif
     GC_stop_count = THREAD_RESTARTED; /* i.e. the world is not stopped */
 
     if (sigfillset(&act.sa_mask) != 0) {
@@ -1429,6 +2002,12 @@ GC_INNER void GC_stop_init(void)
                 "Will retry suspend and restart signals if necessary\n");
     }
 
+    str = GETENV("GC_COOPERATIVE_SUSPEND");
+    if (str != NULL && (*str != '0' || *(str + 1) != '\0')) {
+      GC_cooperative_suspend = TRUE;
+      GC_COND_LOG_PRINTF("Will wait for threads to reach a safepoint\n");
+    }
+
 #   ifndef NO_SIGNALS_UNBLOCK_IN_MAIN
       /* Explicitly unblock the signals once before new threads creation. */
       GC_unblock_gc_signals();
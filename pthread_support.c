@@ -61,7 +61,28 @@
 #endif /* GC_NETBSD_THREADS */
 
 /* Allocator lock definitions.          */
-#if !defined(USE_SPIN_LOCK)
+#if defined(USE_MCS_LOCK)
+# include <linux/futex.h>
+# include <sys/syscall.h>
+
+  /* A node of the allocation lock queue.  A thread holds (or waits    */
+  /* for) the allocation lock at most once at a time, thus a single     */
+  /* node per thread is enough.                                         */
+  struct mcs_node_s {
+    volatile AO_t next; /* the next waiter in the queue */
+    volatile unsigned state; /* one of MCS_x values; the futex word */
+  };
+
+# define MCS_GRANTED 0  /* the lock is handed over to the node owner */
+# define MCS_WAITING 1  /* the owner spins waiting for the lock */
+# define MCS_PARKED 2   /* the owner sleeps on the futex */
+
+  static __thread struct mcs_node_s mcs_node;
+
+  STATIC volatile AO_t GC_lock_tail = 0;
+                        /* The last node of the queue (the lock holder  */
+                        /* if no one waits), or 0 if the lock is free.  */
+#elif !defined(USE_SPIN_LOCK)
   GC_INNER pthread_mutex_t GC_allocate_ml = PTHREAD_MUTEX_INITIALIZER;
 #endif
 
@@ -258,7 +279,11 @@
   GC_INNER GC_bool GC_need_to_lock = FALSE;
 #endif
 
-STATIC int GC_nprocs = 1;
+#ifdef PARALLEL_RESTART
+  GC_INNER int GC_nprocs = 1;
+#else
+  STATIC int GC_nprocs = 1;
+#endif
                         /* Number of processors.  We may not have       */
                         /* access to all of them, but this is as good   */
                         /* a guess as any ...                           */
@@ -273,10 +298,12 @@ STATIC int GC_nprocs = 1;
     int i;
     GC_thread p;
 
-    for (i = 0; i < THREAD_TABLE_SZ; ++i) {
+    for (i = 0; i < GC_thread_table_sz; ++i) {
       for (p = GC_threads[i]; p != NULL; p = p -> tm.next) {
-        if (!KNOWN_FINISHED(p))
-          GC_mark_thread_local_fls_for(&p->tlfs);
+        if (KNOWN_FINISHED(p)) continue;
+        if (SHOULD_FLUSH_IDLE_TLFS(p))
+          GC_flush_thread_local(&p->tlfs);
+        GC_mark_thread_local_fls_for(&p->tlfs);
       }
     }
   }
@@ -289,7 +316,7 @@ STATIC int GC_nprocs = 1;
         int i;
         GC_thread p;
 
-        for (i = 0; i < THREAD_TABLE_SZ; ++i) {
+        for (i = 0; i < GC_thread_table_sz; ++i) {
           for (p = GC_threads[i]; p != NULL; p = p -> tm.next) {
             if (!KNOWN_FINISHED(p))
               GC_check_tls_for(&p->tlfs);
@@ -373,6 +400,9 @@ STATIC int GC_nprocs = 1;
 STATIC void * GC_mark_thread(void * id)
 {
   word my_mark_no = 0;
+# ifdef PERF_COUNTERS
+    GC_perf_group_t perf_group = GC_PERF_GROUP_INITIALIZER;
+# endif
   IF_CANCEL(int cancel_state;)
 
   if ((word)id == GC_WORD_MAX) return 0; /* to prevent a compiler warning */
@@ -380,6 +410,11 @@ STATIC void * GC_mark_thread(void * id)
                          /* Mark threads are not cancellable; they      */
                          /* should be invisible to client.              */
   set_marker_thread_name((unsigned)(word)id);
+# ifdef USE_NUMA
+    /* Spread the markers evenly among the nodes.       */
+    if (GC_numa_nodes > 1)
+      GC_numa_pin_thread((int)((word)id % (unsigned)GC_numa_nodes));
+# endif
 # if defined(USE_PROC_FOR_LIBRARIES) \
      || (defined(IA64) && (defined(HAVE_PTHREAD_ATTR_GET_NP) \
                            || defined(HAVE_PTHREAD_GETATTR_NP)))
@@ -412,6 +447,17 @@ STATIC void * GC_mark_thread(void * id)
 #   ifdef DEBUG_THREADS
       GC_log_printf("Starting helper for mark number %lu (thread %u)\n",
                     (unsigned long)my_mark_no, (unsigned)(word)id);
+#   endif
+#   ifdef PERF_COUNTERS
+      if (GC_measure_performance) {
+        struct GC_perf_counts_s before, after;
+
+        (void)GC_perf_read(&perf_group, &before);
+        GC_help_marker(my_mark_no);
+        (void)GC_perf_read(&perf_group, &after);
+        GC_perf_add_delta(&GC_markers_perf_counts, &before, &after);
+        continue;
+      }
 #   endif
     GC_help_marker(my_mark_no);
   }
@@ -543,21 +589,114 @@ GC_INNER void GC_start_mark_threads_inner(void)
 
 #endif /* PARALLEL_MARK */
 
+#ifdef CONCURRENT_MARK
+  GC_INNER GC_bool GC_concurrent_mark = FALSE;
+
+  static GC_bool concurrent_marker_started = FALSE;
+                                /* Protected by the allocation lock.    */
+
+  /* The concurrent marker thread waits on conc_mark_cv for a request.  */
+  /* The mutator (holding the allocation lock) acquires conc_mark_mutex */
+  /* only for a short time to post the request.                         */
+# ifdef CAN_HANDLE_FORK
+    static pthread_mutex_t conc_mark_mutex;
+    static pthread_cond_t conc_mark_cv;
+                        /* initialized by GC_start_concurrent_marker    */
+# else
+    static pthread_mutex_t conc_mark_mutex = PTHREAD_MUTEX_INITIALIZER;
+    static pthread_cond_t conc_mark_cv = PTHREAD_COND_INITIALIZER;
+# endif
+  static GC_bool conc_mark_requested = FALSE;
+                                /* Protected by conc_mark_mutex.        */
+#endif /* CONCURRENT_MARK */
+
+#ifdef BACKGROUND_GC
+  GC_INNER GC_bool GC_background_gc = FALSE;
+
+  static GC_bool background_gc_started = FALSE;
+                                /* Protected by the allocation lock.    */
+
+  /* Same as for the concurrent marker.   */
+# ifdef CAN_HANDLE_FORK
+    static pthread_mutex_t bg_gc_mutex;
+    static pthread_cond_t bg_gc_cv;
+                        /* initialized by GC_start_background_gc        */
+# else
+    static pthread_mutex_t bg_gc_mutex = PTHREAD_MUTEX_INITIALIZER;
+    static pthread_cond_t bg_gc_cv = PTHREAD_COND_INITIALIZER;
+# endif
+  static GC_bool bg_gc_requested = FALSE;
+                                /* Protected by bg_gc_mutex.            */
+#endif /* BACKGROUND_GC */
+
+#ifdef SCAVENGER_THREAD
+  GC_INNER word GC_scavenger_rate = 0;
+
+  static GC_bool scavenger_started = FALSE;
+                                /* Protected by the allocation lock.    */
+# ifdef WATCH_MEMORY_PRESSURE
+    STATIC int GC_pressure_fd = -1;
+                                /* The PSI trigger descriptor polled by */
+                                /* the scavenger thread.  Protected by  */
+                                /* the allocation lock.                 */
+# endif
+#endif
+
+#ifdef FINALIZER_THREADS
+  static unsigned n_finalizer_threads = 0;
+                                /* Protected by the allocation lock.    */
+# ifndef FINALIZER_BATCH_SIZE
+#   define FINALIZER_BATCH_SIZE 64
+# endif
+  static unsigned finalizer_batch_size = FINALIZER_BATCH_SIZE;
+  static GC_word finalizer_backlog_limit = 0;
+  static pthread_mutex_t finalizer_mutex = PTHREAD_MUTEX_INITIALIZER;
+  static pthread_cond_t finalizer_cv = PTHREAD_COND_INITIALIZER;
+                                /* Signaled when the finalization queue */
+                                /* becomes non-empty.                   */
+  static pthread_cond_t finalizer_batch_done_cv = PTHREAD_COND_INITIALIZER;
+#endif
+
 #ifdef GC_ASSERTIONS
   GC_INNER GC_bool GC_thr_initialized = FALSE;
 #endif
 
-GC_INNER GC_thread GC_threads[THREAD_TABLE_SZ] = {0};
+static GC_thread first_thread_table[THREAD_TABLE_SZ];
+
+GC_INNER GC_thread *GC_threads = first_thread_table;
+GC_INNER int GC_thread_table_sz = THREAD_TABLE_SZ;
+
+static int n_thread_entries = 0; /* the number of entries in GC_threads */
+
+/* Update the given bucket of GC_threads (which might be a heap object). */
+#define SET_THREAD_TABLE_HEAD(hv, p) \
+                (void)(GC_threads[hv] = (p), GC_dirty(&GC_threads[hv]))
+
+#ifdef SELF_THREAD_TLS
+  __thread GC_ATTR_TLS_FAST GC_thread GC_self_thread_tls = NULL;
+#endif
 
 /* It may not be safe to allocate when we register the first thread.    */
 /* As "next" and "status" fields are unused, no need to push this       */
 /* (but "backing_store_end" field should be pushed on E2K).             */
 static struct GC_Thread_Rep first_thread;
 
+#ifdef FIBER_STACKS
+  STATIC GC_fiber_t GC_fibers = NULL;
+                        /* The list of the registered fibers.   */
+                        /* Protected by the allocation lock.    */
+#endif
+
 void GC_push_thread_structures(void)
 {
     GC_ASSERT(I_HOLD_LOCK());
     GC_PUSH_ALL_SYM(GC_threads);
+    GC_PUSH_ALL_SYM(first_thread_table);
+#   ifdef FIBER_STACKS
+      GC_PUSH_ALL_SYM(GC_fibers);
+      GC_PUSH_ALL_SYM(first_thread.fiber_to);
+      GC_PUSH_ALL_SYM(first_thread.fiber_from);
+#   endif
 #   ifdef E2K
       GC_PUSH_ALL_SYM(first_thread.backing_store_end);
 #   endif
@@ -573,7 +712,7 @@ void GC_push_thread_structures(void)
     int count = 0;
 
     GC_ASSERT(I_HOLD_LOCK());
-    for (i = 0; i < THREAD_TABLE_SZ; ++i) {
+    for (i = 0; i < GC_thread_table_sz; ++i) {
         GC_thread p;
 
         for (p = GC_threads[i]; p != NULL; p = p -> tm.next) {
@@ -585,15 +724,53 @@ void GC_push_thread_structures(void)
   }
 #endif /* DEBUG_THREADS */
 
+/* Double the number of the buckets of GC_threads.  The relative order  */
+/* of the entries within a chain is preserved (thus the most recent one */
+/* of the entries with the same id remains the first found).  Failure   */
+/* to allocate the new table is not fatal, just the chains get longer.  */
+static void grow_thread_table(void)
+{
+    int new_sz = 2 * GC_thread_table_sz;
+    GC_thread *new_table;
+    int i;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    new_table = (GC_thread *)GC_INTERNAL_MALLOC((size_t)new_sz
+                                                * sizeof(GC_thread), NORMAL);
+    if (EXPECT(NULL == new_table, FALSE)) return;
+    for (i = 0; i < GC_thread_table_sz; ++i) {
+      GC_thread p, next;
+
+      for (p = GC_threads[i]; p != NULL; p = next) {
+        GC_thread *pprev = &new_table[THREAD_ID_HASH(p -> id)
+                                      % (unsigned)new_sz];
+
+        next = p -> tm.next;
+        while (*pprev != NULL)
+          pprev = &((*pprev) -> tm.next);
+        *pprev = p;
+        GC_dirty(pprev);
+        p -> tm.next = NULL;
+      }
+    }
+    if (GC_threads != first_thread_table)
+      GC_INTERNAL_FREE(GC_threads);
+    GC_threads = new_table;
+    GC_thread_table_sz = new_sz;
+}
+
 /* Add a thread to GC_threads.  We assume it wasn't already there.      */
 /* The id field is set by the caller.                                   */
 STATIC GC_thread GC_new_thread(thread_id_t id)
 {
-    int hv = THREAD_TABLE_INDEX(id);
+    int hv;
     GC_thread result;
     static GC_bool first_thread_used = FALSE;
 
     GC_ASSERT(I_HOLD_LOCK());
+    if (EXPECT(n_thread_entries >= GC_thread_table_sz, FALSE))
+      grow_thread_table();
+    hv = THREAD_TABLE_INDEX(id);
 #   ifdef DEBUG_THREADS
         GC_log_printf("Creating thread %p\n", (void *)id);
         for (result = GC_threads[hv];
@@ -620,7 +797,8 @@ STATIC GC_thread GC_new_thread(thread_id_t id)
       result -> kernel_id = gettid();
 #   endif
     result -> tm.next = GC_threads[hv];
-    GC_threads[hv] = result;
+    SET_THREAD_TABLE_HEAD(hv, result);
+    n_thread_entries++;
 #   ifdef NACL
       GC_nacl_gc_thread_self = result;
       GC_nacl_initialize_gc_thread();
@@ -631,6 +809,22 @@ STATIC GC_thread GC_new_thread(thread_id_t id)
     return result;
 }
 
+#ifndef GC_WIN32_THREADS
+  /* Give the memory of the thread stack snapshot (if any) to the heap. */
+  static void free_stack_snapshot(GC_thread p)
+  {
+    GC_ASSERT(I_HOLD_LOCK());
+    if (p -> stack_snapshot != NULL) {
+      GC_scratch_recycle_no_gww(p -> stack_snapshot,
+                                p -> stack_snapshot_size);
+      p -> stack_snapshot = NULL;
+      p -> stack_snapshot_len = 0;
+    }
+  }
+#else
+# define free_stack_snapshot(p) (void)0
+#endif
+
 /* Delete a thread from GC_threads.  We assume it is there.     */
 /* (The code intentionally traps if it wasn't.)                 */
 /* It is safe to delete the main thread.                        */
@@ -656,12 +850,17 @@ STATIC void GC_delete_thread(thread_id_t id)
       prev = p;
     }
     if (NULL == prev) {
-        GC_threads[hv] = p -> tm.next;
+        SET_THREAD_TABLE_HEAD(hv, p -> tm.next);
     } else {
         GC_ASSERT(prev != &first_thread);
         prev -> tm.next = p -> tm.next;
         GC_dirty(prev);
     }
+    n_thread_entries--;
+#   ifdef SELF_THREAD_TLS
+      if (p == GC_self_thread_tls) GC_self_thread_tls = NULL;
+#   endif
+    free_stack_snapshot(p);
     if (EXPECT(p != &first_thread, TRUE)) {
 #     ifdef GC_DARWIN_THREADS
         mach_port_deallocate(mach_task_self(), p -> mach_thread);
@@ -689,12 +888,14 @@ STATIC void GC_delete_thread(thread_id_t id)
         p = p -> tm.next;
     }
     if (NULL == prev) {
-        GC_threads[hv] = p -> tm.next;
+        SET_THREAD_TABLE_HEAD(hv, p -> tm.next);
     } else {
         GC_ASSERT(prev != &first_thread);
         prev -> tm.next = p -> tm.next;
         GC_dirty(prev);
     }
+    n_thread_entries--;
+    free_stack_snapshot(p);
 #   ifdef GC_DARWIN_THREADS
         mach_port_deallocate(mach_task_self(), p -> mach_thread);
 #   endif
@@ -727,7 +928,7 @@ GC_INNER GC_thread GC_lookup_thread(thread_id_t id)
     GC_thread me;
 
     GC_ASSERT(I_HOLD_LOCK());
-    me = GC_lookup_thread(pthread_self());
+    me = GC_self_thread();
     me->finalizer_nested = 0;
   }
 
@@ -742,7 +943,7 @@ GC_INNER GC_thread GC_lookup_thread(thread_id_t id)
     unsigned nesting_level;
 
     GC_ASSERT(I_HOLD_LOCK());
-    me = GC_lookup_thread(pthread_self());
+    me = GC_self_thread();
     nesting_level = me->finalizer_nested;
     if (nesting_level) {
       /* We are inside another GC_invoke_finalizers().          */
@@ -764,7 +965,7 @@ GC_INNER GC_thread GC_lookup_thread(thread_id_t id)
     DCL_LOCK_STATE;
 
     LOCK();
-    me = GC_lookup_thread(pthread_self());
+    me = GC_self_thread();
     UNLOCK();
     return (word)tsd >= (word)(&me->tlfs)
             && (word)tsd < (word)(&me->tlfs) + sizeof(me->tlfs);
@@ -828,7 +1029,7 @@ GC_API void GC_CALL GC_register_altstack(void *normstack,
 #       endif
       }
 #   endif
-    for (i = 0; i < THREAD_TABLE_SZ; i++) {
+    for (i = 0; i < GC_thread_table_sz; i++) {
       for (p = GC_threads[i]; p != NULL; p = p -> tm.next) {
         if (p -> stack_end != NULL) {
 #         ifdef STACK_GROWS_UP
@@ -866,7 +1067,7 @@ GC_API void GC_CALL GC_register_altstack(void *normstack,
           result = marker_sp[i];
       }
 #   endif
-    for (i = 0; i < THREAD_TABLE_SZ; i++) {
+    for (i = 0; i < GC_thread_table_sz; i++) {
       for (p = GC_threads[i]; p != NULL; p = p -> tm.next) {
         if ((word)p->stack_end > (word)result
             && (word)p->stack_end < (word)bound) {
@@ -1099,7 +1300,7 @@ STATIC void GC_wait_for_gc_completion(GC_bool wait_for_all)
 # endif
   static void store_to_threads_table(int hv, GC_thread me)
   {
-    GC_threads[hv] = me;
+    SET_THREAD_TABLE_HEAD(hv, me);
   }
 
   /* Remove all entries from the GC_threads table, except the one for   */
@@ -1110,7 +1311,8 @@ STATIC void GC_wait_for_gc_completion(GC_bool wait_for_all)
     thread_id_t self = pthread_self();
     int hv;
 
-    for (hv = 0; hv < THREAD_TABLE_SZ; ++hv) {
+    n_thread_entries = 0;
+    for (hv = 0; hv < GC_thread_table_sz; ++hv) {
       GC_thread p, next;
       GC_thread me = NULL;
 
@@ -1120,6 +1322,7 @@ STATIC void GC_wait_for_gc_completion(GC_bool wait_for_all)
             && me == NULL) { /* ignore dead threads with the same id */
           me = p;
           p -> tm.next = NULL;
+          n_thread_entries = 1;
 #         ifdef GC_DARWIN_THREADS
             /* Update thread Id after fork (it is OK to call    */
             /* GC_destroy_thread_local and GC_free_internal     */
@@ -1156,6 +1359,7 @@ STATIC void GC_wait_for_gc_completion(GC_bool wait_for_all)
 #         endif
           /* TODO: To avoid TSan hang (when updating GC_bytes_freed),   */
           /* we just skip explicit freeing of GC_threads entries.       */
+          free_stack_snapshot(p);
 #         if !defined(THREAD_SANITIZER) || !defined(CAN_CALL_ATFORK)
             if (p != &first_thread) GC_INTERNAL_FREE(p);
 #         endif
@@ -1185,8 +1389,14 @@ STATIC void GC_wait_for_gc_completion(GC_bool wait_for_all)
 #   ifdef PARALLEL_MARK
       if (GC_parallel)
         wait_for_reclaim_atfork();
+#   endif
+#   ifdef THREAD_LOCAL_SWEEP
+      GC_wait_for_sweep_claims();
 #   endif
     GC_wait_for_gc_completion(TRUE);
+#   if defined(DL_SHARD_LOCKS) && !defined(GC_NO_FINALIZATION)
+      GC_acquire_dl_shard_locks();
+#   endif
 #   ifdef PARALLEL_MARK
       if (GC_parallel) {
 #       if defined(THREAD_SANITIZER) && defined(GC_ASSERTIONS) \
@@ -1219,6 +1429,9 @@ STATIC void GC_wait_for_gc_completion(GC_bool wait_for_all)
           GC_release_mark_lock();
 #       endif
       }
+#   endif
+#   if defined(DL_SHARD_LOCKS) && !defined(GC_NO_FINALIZATION)
+      GC_release_dl_shard_locks();
 #   endif
     RESTORE_CANCEL(fork_cancel_state);
     UNLOCK();
@@ -1247,13 +1460,48 @@ STATIC void GC_wait_for_gc_completion(GC_bool wait_for_all)
         /* TSan does not support threads creation in the child process. */
         available_markers_m1 = 0;
 #     endif
+#   endif
+#   ifdef CONCURRENT_MARK
+      /* The concurrent marker thread is not inherited by the child.    */
+      GC_concurrent_mark = FALSE;
+      concurrent_marker_started = FALSE;
+#   endif
+#   ifdef BACKGROUND_GC
+      /* Neither is the background collector thread.    */
+      GC_background_gc = FALSE;
+      background_gc_started = FALSE;
+#   endif
+#   ifdef SCAVENGER_THREAD
+      /* Neither is the scavenger thread.       */
+      GC_scavenger_rate = 0;
+      scavenger_started = FALSE;
+#     ifdef WATCH_MEMORY_PRESSURE
+        if (GC_pressure_fd != -1) {
+          close(GC_pressure_fd);
+          GC_pressure_fd = -1;
+        }
+#     endif
+#   endif
+#   ifdef FINALIZER_THREADS
+      /* Nor the finalizer ones.        */
+      n_finalizer_threads = 0;
 #   endif
     /* Clean up the thread table, so that just our thread is left.      */
     GC_remove_all_threads_but_me();
 #   ifndef GC_DISABLE_INCREMENTAL
       GC_dirty_update_child();
+#   endif
+#   if defined(DL_SHARD_LOCKS) && !defined(GC_NO_FINALIZATION)
+      GC_release_dl_shard_locks();
 #   endif
     RESTORE_CANCEL(fork_cancel_state);
+#   ifdef USE_MCS_LOCK
+      /* Forget the waiters, they are not inherited by the child.       */
+      if (GC_need_to_lock) {
+        AO_store(&mcs_node.next, 0);
+        AO_store(&GC_lock_tail, (AO_t)&mcs_node);
+      }
+#   endif
     UNLOCK();
     /* Even though after a fork the child only inherits the single      */
     /* thread that called the fork(), if another thread in the parent   */
@@ -1371,6 +1619,9 @@ STATIC GC_thread GC_register_my_thread_inner(const struct GC_stack_base *sb,
 # endif
   GC_in_thread_creation = FALSE;
   GC_record_stack_base(me, sb);
+# ifdef SELF_THREAD_TLS
+    GC_self_thread_tls = me;
+# endif
   return me;
 }
 
@@ -1539,7 +1790,7 @@ GC_INNER void GC_init_parallel(void)
 
       GC_ASSERT(GC_is_initialized);
       LOCK();
-      me = GC_lookup_thread(pthread_self());
+      me = GC_self_thread();
       GC_init_thread_local(&me->tlfs);
       UNLOCK();
 #   endif
@@ -1599,6 +1850,7 @@ static GC_bool do_blocking_enter(GC_thread me)
         me->backing_store_ptr = me->backing_store_end + stack_size;
 #   endif
     me -> flags |= DO_BLOCKING;
+    SET_BLOCKING_GC_NO(me);
     /* Save context here if we want to support precise stack marking */
     return topOfStackUnset;
 }
@@ -1634,7 +1886,7 @@ GC_INNER void GC_do_blocking_inner(ptr_t data, void *context)
 
     UNUSED_ARG(context);
     LOCK();
-    me = GC_lookup_thread(pthread_self());
+    me = GC_self_thread();
     topOfStackUnset = do_blocking_enter(me);
     UNLOCK();
 
@@ -1652,7 +1904,7 @@ GC_INNER void GC_do_blocking_inner(ptr_t data, void *context)
          /* analysis tool might complain that this pointer value    */
          /* (obtained in the first locked section) is unreliable in */
          /* the second locked section.                              */
-         me = GC_lookup_thread(pthread_self());
+         me = GC_self_thread();
          GC_ASSERT(me == saved_me);
       }
 #   endif
@@ -1707,7 +1959,7 @@ GC_API void GC_CALL GC_set_stackbottom(void *gc_thread_handle,
     } else {
         GC_ASSERT(I_HOLD_LOCK());
         if (NULL == t) /* current thread? */
-            t = GC_lookup_thread(pthread_self());
+            t = GC_self_thread();
         GC_ASSERT(!KNOWN_FINISHED(t));
         GC_ASSERT((t -> flags & DO_BLOCKING) == 0
                   && NULL == t -> traced_stack_sect); /* for now */
@@ -1731,12 +1983,11 @@ GC_API void GC_CALL GC_set_stackbottom(void *gc_thread_handle,
 
 GC_API void * GC_CALL GC_get_my_stackbottom(struct GC_stack_base *sb)
 {
-    thread_id_t self = pthread_self();
     GC_thread me;
     DCL_LOCK_STATE;
 
     LOCK();
-    me = GC_lookup_thread(self);
+    me = GC_self_thread();
     /* The thread is assumed to be registered.  */
     if (EXPECT((me -> flags & MAIN_THREAD) != 0, FALSE)) {
         sb -> mem_base = GC_stackbottom;
@@ -1756,6 +2007,90 @@ GC_API void * GC_CALL GC_get_my_stackbottom(struct GC_stack_base *sb)
     return (void *)me; /* gc_thread_handle */
 }
 
+#ifdef FIBER_STACKS
+  GC_API void * GC_CALL GC_register_fiber(const struct GC_stack_base *sb)
+  {
+    GC_fiber_t f;
+    DCL_LOCK_STATE;
+
+    GC_ASSERT(sb -> mem_base != NULL);
+    if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+    LOCK();
+    f = (GC_fiber_t)GC_INTERNAL_MALLOC(sizeof(struct GC_Fiber_Rep), NORMAL);
+    if (EXPECT(f != NULL, TRUE)) {
+      f -> stack_hi = (ptr_t)sb->mem_base;
+      f -> saved_sp = (AO_t)f->stack_hi;
+      f -> next = GC_fibers;
+      if (GC_fibers != NULL) GC_fibers -> prev = f;
+      GC_fibers = f;
+    }
+    UNLOCK();
+    return f;
+  }
+
+  GC_API void GC_CALL GC_unregister_fiber(void *fiber)
+  {
+    GC_fiber_t f = (GC_fiber_t)fiber;
+    DCL_LOCK_STATE;
+
+    if (NULL == f) return;
+    LOCK();
+    if (f -> prev != NULL) {
+      f -> prev -> next = f -> next;
+    } else {
+      GC_ASSERT(GC_fibers == f);
+      GC_fibers = f -> next;
+    }
+    if (f -> next != NULL) f -> next -> prev = f -> prev;
+    /* The record is not freed explicitly as fiber_from of some thread  */
+    /* may still point to it (a stack left earlier does not overlap the */
+    /* current one, thus it does not affect the choice made in          */
+    /* GC_push_all_stacks); the record is reclaimed once unreachable.   */
+    f -> next = NULL;
+    f -> prev = NULL;
+    UNLOCK();
+  }
+
+  GC_API void GC_CALL GC_fiber_switch(void *gc_thread_handle,
+                                      void *from_fiber, void *to_fiber)
+  {
+    GC_thread t = (GC_thread)gc_thread_handle;
+    AO_t sp = (AO_t)GC_approx_sp();
+
+    GC_ASSERT(NULL == t -> traced_stack_sect);
+    GC_ASSERT(t -> fiber_to == (AO_t)from_fiber);
+    /* The order of the stores matters: at any moment, either the       */
+    /* stack the thread runs on is one of fiber_to, fiber_from and the  */
+    /* own stack, or the stack pointer saved here covers its frames.    */
+    if (from_fiber != NULL) {
+      AO_store_release(&(((GC_fiber_t)from_fiber) -> saved_sp), sp);
+    } else {
+      AO_store_release(&(t -> own_saved_sp), sp);
+    }
+    AO_store_release(&(t -> fiber_from), (AO_t)from_fiber);
+    AO_store_release(&(t -> fiber_to), (AO_t)to_fiber);
+  }
+
+  GC_INNER word GC_push_fiber_stacks(void)
+  {
+    GC_fiber_t f;
+    word total_size = 0;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    for (f = GC_fibers; f != NULL; f = f -> next) {
+      ptr_t lo = (ptr_t)AO_load_acquire(&(f -> saved_sp));
+
+      /* The fiber currently running is scanned also here, from the     */
+      /* outdated stack pointer, but this is harmless.                  */
+      if ((word)lo < (word)(f -> stack_hi)) {
+        GC_push_all_stack(lo, f -> stack_hi);
+        total_size += (word)(f -> stack_hi - lo);
+      }
+    }
+    return total_size;
+  }
+#endif /* FIBER_STACKS */
+
 /* GC_call_with_gc_active() has the opposite to GC_do_blocking()        */
 /* functionality.  It might be called from a user function invoked by   */
 /* GC_do_blocking() to temporarily back allow calling any GC function   */
@@ -1764,7 +2099,6 @@ GC_API void * GC_CALL GC_call_with_gc_active(GC_fn_type fn,
                                              void * client_data)
 {
     struct GC_traced_stack_sect_s stacksect;
-    thread_id_t self = pthread_self();
     GC_thread me;
 #   ifdef E2K
       size_t stack_size;
@@ -1772,7 +2106,7 @@ GC_API void * GC_CALL GC_call_with_gc_active(GC_fn_type fn,
     DCL_LOCK_STATE;
 
     LOCK();   /* This will block if the world is stopped.       */
-    me = GC_lookup_thread(self);
+    me = GC_self_thread();
 
     /* Adjust our stack bottom value (this could happen unless  */
     /* GC_get_stack_base() was used which returned GC_SUCCESS). */
@@ -1844,6 +2178,7 @@ GC_API void * GC_CALL GC_call_with_gc_active(GC_fn_type fn,
       me->backing_store_ptr = me->backing_store_end + stack_size;
 #   endif
     me -> flags |= DO_BLOCKING;
+    SET_BLOCKING_GC_NO(me);
     me -> stack_ptr = stacksect.saved_stack_ptr;
     UNLOCK();
 
@@ -1875,6 +2210,9 @@ STATIC void GC_unregister_my_thread_inner(GC_thread me)
     } else {
         me -> flags |= FINISHED;
     }
+#   ifdef SELF_THREAD_TLS
+      GC_self_thread_tls = NULL;
+#   endif
 #   if defined(THREAD_LOCAL_ALLOC)
       /* It is required to call remove_specific defined in specific.c. */
       GC_remove_specific(GC_thread_key);
@@ -1883,7 +2221,9 @@ STATIC void GC_unregister_my_thread_inner(GC_thread me)
 
 GC_API int GC_CALL GC_unregister_my_thread(void)
 {
-    thread_id_t self = pthread_self();
+#   if defined(DEBUG_THREADS) || defined(GC_ASSERTIONS)
+      thread_id_t self = pthread_self();
+#   endif
     GC_thread me;
     IF_CANCEL(int cancel_state;)
     DCL_LOCK_STATE;
@@ -1893,7 +2233,7 @@ GC_API int GC_CALL GC_unregister_my_thread(void)
     /* Wait for any GC that may be marking from our stack to    */
     /* complete before we remove this thread.                   */
     GC_wait_for_gc_completion(FALSE);
-    me = GC_lookup_thread(self);
+    me = GC_self_thread();
 #   ifdef DEBUG_THREADS
         GC_log_printf(
                 "Called GC_unregister_my_thread on %p, gc_thread= %p\n",
@@ -1969,7 +2309,7 @@ GC_API void GC_CALL GC_allow_register_threads(void)
 
     /* Check GC is initialized and the current thread is registered. */
     LOCK(); /* just to match that in win32_threads.c */
-    GC_ASSERT(GC_lookup_thread(pthread_self()) != 0);
+    GC_ASSERT(GC_self_thread() != 0);
     UNLOCK();
 # endif
   INIT_REAL_SYMS(); /* to initialize symbols while single-threaded */
@@ -2006,6 +2346,9 @@ GC_API int GC_CALL GC_register_my_thread(const struct GC_stack_base *sb)
 #       endif
         GC_record_stack_base(me, sb);
         me -> flags &= ~FINISHED; /* but not DETACHED */
+#       ifdef SELF_THREAD_TLS
+          GC_self_thread_tls = me;
+#       endif
     } else {
         UNLOCK();
         return GC_DUPLICATE;
@@ -2028,6 +2371,416 @@ GC_API int GC_CALL GC_register_my_thread(const struct GC_stack_base *sb)
     return GC_SUCCESS;
 }
 
+#ifdef CONCURRENT_MARK
+  GC_INNER void GC_notify_concurrent_marker(void)
+  {
+    GC_ASSERT(I_HOLD_LOCK());
+    GC_ASSERT(GC_concurrent_mark);
+    if (pthread_mutex_lock(&conc_mark_mutex) != 0)
+      ABORT("pthread_mutex_lock failed");
+    conc_mark_requested = TRUE;
+    if (pthread_cond_signal(&conc_mark_cv) != 0)
+      ABORT("pthread_cond_signal failed");
+    if (pthread_mutex_unlock(&conc_mark_mutex) != 0)
+      ABORT("pthread_mutex_unlock failed");
+  }
+
+  STATIC void * GC_concurrent_mark_thread(void *arg)
+  {
+    struct GC_stack_base sb;
+    GC_thread me;
+    IF_CANCEL(int cancel_state;)
+    DCL_LOCK_STATE;
+
+    DISABLE_CANCEL(cancel_state);
+                        /* The thread is invisible to the client.       */
+    if (GC_get_stack_base(&sb) != GC_SUCCESS)
+      ABORT("Failed to get concurrent marker stack base");
+    LOCK();
+    /* The thread should be registered as it stops the world.   */
+    me = GC_register_my_thread_inner(&sb, pthread_self());
+    me -> flags |= DETACHED;
+#   ifdef THREAD_LOCAL_ALLOC
+      GC_init_thread_local(&me->tlfs);
+#   endif
+    GC_concurrent_mark = TRUE;
+    GC_COND_LOG_PRINTF("Started concurrent marker thread\n");
+    UNLOCK();
+
+    for (;;) {
+      GC_bool more_work;
+
+      if (pthread_mutex_lock(&conc_mark_mutex) != 0)
+        ABORT("pthread_mutex_lock failed");
+      while (!conc_mark_requested) {
+        if (pthread_cond_wait(&conc_mark_cv, &conc_mark_mutex) != 0)
+          ABORT("pthread_cond_wait failed");
+      }
+      conc_mark_requested = FALSE;
+      if (pthread_mutex_unlock(&conc_mark_mutex) != 0)
+        ABORT("pthread_mutex_unlock failed");
+
+      do {
+        LOCK();
+        ENTER_GC();
+        more_work = GC_concurrent_mark_some();
+        EXIT_GC();
+        UNLOCK();
+        if (more_work)
+          sched_yield(); /* let the mutators acquire the lock */
+      } while (more_work);
+    }
+    return arg; /* unreachable */
+  }
+
+  GC_INNER void GC_start_concurrent_marker(void)
+  {
+    pthread_t new_thread;
+    pthread_attr_t attr;
+    IF_CANCEL(int cancel_state;)
+    DCL_LOCK_STATE;
+
+    GC_ASSERT(GC_is_initialized);
+    INIT_REAL_SYMS(); /* for pthread_create */
+    set_need_to_lock(); /* we are about to be multi-threaded */
+    DISABLE_CANCEL(cancel_state);
+    LOCK();
+    if (concurrent_marker_started) {
+      /* Just turn it on again (if it has been turned off). */
+      GC_concurrent_mark = TRUE;
+      UNLOCK();
+      RESTORE_CANCEL(cancel_state);
+      return;
+    }
+#   ifdef CAN_HANDLE_FORK
+      /* Initialize (or clean up after fork in the child).      */
+      {
+        pthread_mutex_t mutex_local = PTHREAD_MUTEX_INITIALIZER;
+        pthread_cond_t cv_local = PTHREAD_COND_INITIALIZER;
+
+        BCOPY(&mutex_local, &conc_mark_mutex, sizeof(conc_mark_mutex));
+        BCOPY(&cv_local, &conc_mark_cv, sizeof(conc_mark_cv));
+      }
+#   endif
+    conc_mark_requested = FALSE;
+    if (0 != pthread_attr_init(&attr)) ABORT("pthread_attr_init failed");
+    if (0 != pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED))
+      ABORT("pthread_attr_setdetachstate failed");
+    if (REAL_FUNC(pthread_create)(&new_thread, &attr,
+                                  GC_concurrent_mark_thread, NULL) != 0) {
+      WARN("Concurrent marker thread creation failed\n", 0);
+    } else {
+      concurrent_marker_started = TRUE;
+      /* GC_concurrent_mark is set by the thread itself once it is      */
+      /* registered.                                                    */
+    }
+    (void)pthread_attr_destroy(&attr);
+    UNLOCK();
+    RESTORE_CANCEL(cancel_state);
+  }
+
+  GC_API void GC_CALL GC_set_concurrent_mark(int value)
+  {
+    DCL_LOCK_STATE;
+
+    if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+    if (value) {
+      GC_start_concurrent_marker();
+    } else {
+      LOCK();
+      GC_concurrent_mark = FALSE;
+      UNLOCK();
+    }
+  }
+
+  GC_API int GC_CALL GC_get_concurrent_mark(void)
+  {
+    return (int)GC_concurrent_mark;
+  }
+#endif /* CONCURRENT_MARK */
+
+#ifdef BACKGROUND_GC
+  GC_INNER void GC_notify_background_gc(void)
+  {
+    GC_ASSERT(I_HOLD_LOCK());
+    GC_ASSERT(GC_background_gc);
+    if (pthread_mutex_lock(&bg_gc_mutex) != 0)
+      ABORT("pthread_mutex_lock failed");
+    if (!bg_gc_requested) {
+      bg_gc_requested = TRUE;
+      if (pthread_cond_signal(&bg_gc_cv) != 0)
+        ABORT("pthread_cond_signal failed");
+    }
+    if (pthread_mutex_unlock(&bg_gc_mutex) != 0)
+      ABORT("pthread_mutex_unlock failed");
+  }
+
+  STATIC void * GC_background_gc_thread(void *arg)
+  {
+    struct GC_stack_base sb;
+    GC_thread me;
+    IF_CANCEL(int cancel_state;)
+    DCL_LOCK_STATE;
+
+    DISABLE_CANCEL(cancel_state);
+                        /* The thread is invisible to the client.       */
+    if (GC_get_stack_base(&sb) != GC_SUCCESS)
+      ABORT("Failed to get background collector stack base");
+    LOCK();
+    /* The thread should be registered as it stops the world.   */
+    me = GC_register_my_thread_inner(&sb, pthread_self());
+    me -> flags |= DETACHED;
+#   ifdef THREAD_LOCAL_ALLOC
+      GC_init_thread_local(&me->tlfs);
+#   endif
+    GC_background_gc = TRUE;
+    GC_COND_LOG_PRINTF("Started background collector thread\n");
+    UNLOCK();
+
+    for (;;) {
+      GC_bool more_work;
+
+      if (pthread_mutex_lock(&bg_gc_mutex) != 0)
+        ABORT("pthread_mutex_lock failed");
+      while (!bg_gc_requested) {
+        if (pthread_cond_wait(&bg_gc_cv, &bg_gc_mutex) != 0)
+          ABORT("pthread_cond_wait failed");
+      }
+      bg_gc_requested = FALSE;
+      if (pthread_mutex_unlock(&bg_gc_mutex) != 0)
+        ABORT("pthread_mutex_unlock failed");
+
+      do {
+        LOCK();
+        more_work = GC_background_gc && GC_background_collect_some();
+        UNLOCK();
+        if (more_work)
+          sched_yield(); /* let the mutators acquire the lock */
+      } while (more_work);
+    }
+    return arg; /* unreachable */
+  }
+
+  GC_INNER void GC_start_background_gc(void)
+  {
+    pthread_t new_thread;
+    pthread_attr_t attr;
+    IF_CANCEL(int cancel_state;)
+    DCL_LOCK_STATE;
+
+    GC_ASSERT(GC_is_initialized);
+    INIT_REAL_SYMS(); /* for pthread_create */
+    set_need_to_lock(); /* we are about to be multi-threaded */
+    DISABLE_CANCEL(cancel_state);
+    LOCK();
+    if (background_gc_started) {
+      /* Just turn it on again (if it has been turned off). */
+      GC_background_gc = TRUE;
+      UNLOCK();
+      RESTORE_CANCEL(cancel_state);
+      return;
+    }
+#   ifdef CAN_HANDLE_FORK
+      /* Initialize (or clean up after fork in the child).      */
+      {
+        pthread_mutex_t mutex_local = PTHREAD_MUTEX_INITIALIZER;
+        pthread_cond_t cv_local = PTHREAD_COND_INITIALIZER;
+
+        BCOPY(&mutex_local, &bg_gc_mutex, sizeof(bg_gc_mutex));
+        BCOPY(&cv_local, &bg_gc_cv, sizeof(bg_gc_cv));
+      }
+#   endif
+    bg_gc_requested = FALSE;
+    if (0 != pthread_attr_init(&attr)) ABORT("pthread_attr_init failed");
+    if (0 != pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED))
+      ABORT("pthread_attr_setdetachstate failed");
+    if (REAL_FUNC(pthread_create)(&new_thread, &attr,
+                                  GC_background_gc_thread, NULL) != 0) {
+      WARN("Background collector thread creation failed\n", 0);
+    } else {
+      background_gc_started = TRUE;
+      /* GC_background_gc is set by the thread itself once it is        */
+      /* registered.                                                    */
+    }
+    (void)pthread_attr_destroy(&attr);
+    UNLOCK();
+    RESTORE_CANCEL(cancel_state);
+  }
+
+  GC_API void GC_CALL GC_set_background_gc(int value)
+  {
+    DCL_LOCK_STATE;
+
+    if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+    if (value) {
+      GC_start_background_gc();
+    } else {
+      LOCK();
+      GC_background_gc = FALSE;
+      UNLOCK();
+    }
+  }
+
+  GC_API int GC_CALL GC_get_background_gc(void)
+  {
+    return (int)GC_background_gc;
+  }
+#endif /* BACKGROUND_GC */
+
+#ifdef SCAVENGER_THREAD
+# ifndef SCAVENGER_INTERVAL_MS
+#   define SCAVENGER_INTERVAL_MS 100
+# endif
+
+  /* The scavenger thread wakes up periodically to unmap (a limited     */
+  /* amount of) the free blocks old enough, and to merge the unmapped   */
+  /* blocks with their free neighbors.  Unlike the concurrent marker,   */
+  /* it does not need to be registered as it never stops the world nor */
+  /* allocates from the heap.                                           */
+# ifdef WATCH_MEMORY_PRESSURE
+#   include <poll.h>
+
+#   ifndef MEMORY_PRESSURE_TRIGGER
+      /* 150 ms of the memory stall of some tasks within 2 s.   */
+#     define MEMORY_PRESSURE_TRIGGER "some 150000 2000000"
+#   endif
+# endif
+
+  STATIC void * GC_scavenger_thread(void *arg)
+  {
+#   ifdef WATCH_MEMORY_PRESSURE
+      int pressure_fd = -1;
+#   endif
+    IF_CANCEL(int cancel_state;)
+    DCL_LOCK_STATE;
+
+    DISABLE_CANCEL(cancel_state);
+    for (;;) {
+#     ifdef WATCH_MEMORY_PRESSURE
+        short revents = 0;
+
+        if (pressure_fd != -1) {
+          struct pollfd pfd;
+
+          pfd.fd = pressure_fd;
+          pfd.events = POLLPRI;
+          pfd.revents = 0;
+          if (poll(&pfd, 1, SCAVENGER_INTERVAL_MS) > 0)
+            revents = pfd.revents;
+        } else
+#     endif
+      /* else */ {
+        struct timespec ts;
+
+        ts.tv_sec = SCAVENGER_INTERVAL_MS / 1000;
+        ts.tv_nsec = (SCAVENGER_INTERVAL_MS % 1000) * 1000000L;
+        (void)nanosleep(&ts, 0); /* an early wake-up is harmless */
+      }
+
+      LOCK();
+#     ifdef WATCH_MEMORY_PRESSURE
+        if ((revents & (POLLERR | POLLNVAL)) != 0
+            && GC_pressure_fd == pressure_fd) {
+          /* The trigger is no longer valid (e.g., the cgroup is gone). */
+          close(GC_pressure_fd);
+          GC_pressure_fd = -1;
+        } else if ((revents & POLLPRI) != 0) {
+          GC_COND_LOG_PRINTF("Memory pressure event\n");
+          /* Collect at the next allocation; return the free blocks to */
+          /* the OS right now.                                          */
+          GC_memory_pressure = TRUE;
+          if (GC_unmap_threshold > 0
+              && GC_unmap_old_bytes(0, GC_WORD_MAX) > 0)
+            GC_merge_unmapped();
+        }
+        pressure_fd = GC_pressure_fd;
+#     endif
+      if (GC_scavenger_rate != 0 && GC_unmap_threshold > 0) {
+        word budget = GC_scavenger_rate / 1000 * SCAVENGER_INTERVAL_MS;
+        word excess;
+
+        if (budget < HBLKSIZE) budget = HBLKSIZE;
+        excess = GC_unmap_excess_bytes();
+        if (budget > excess) budget = excess;
+        if (budget > 0 && GC_unmap_old_bytes(GC_unmap_threshold, budget) > 0)
+          GC_merge_unmapped();
+      }
+      UNLOCK();
+    }
+    return arg; /* unreachable */
+  }
+
+  GC_INNER void GC_start_scavenger(void)
+  {
+    pthread_t new_thread;
+    pthread_attr_t attr;
+    IF_CANCEL(int cancel_state;)
+    DCL_LOCK_STATE;
+
+    GC_ASSERT(GC_is_initialized);
+    INIT_REAL_SYMS(); /* for pthread_create */
+    set_need_to_lock(); /* we are about to be multi-threaded */
+    DISABLE_CANCEL(cancel_state);
+    LOCK();
+    if (!scavenger_started) {
+      if (0 != pthread_attr_init(&attr)) ABORT("pthread_attr_init failed");
+      if (0 != pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED))
+        ABORT("pthread_attr_setdetachstate failed");
+      if (REAL_FUNC(pthread_create)(&new_thread, &attr,
+                                    GC_scavenger_thread, NULL) != 0) {
+        WARN("Scavenger thread creation failed\n", 0);
+      } else {
+        scavenger_started = TRUE;
+        GC_COND_LOG_PRINTF("Started scavenger thread\n");
+      }
+      (void)pthread_attr_destroy(&attr);
+    }
+    UNLOCK();
+    RESTORE_CANCEL(cancel_state);
+  }
+
+  GC_API void GC_CALL GC_set_scavenger_rate(size_t bytes_per_sec)
+  {
+    DCL_LOCK_STATE;
+
+    if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+    if (bytes_per_sec != 0) GC_start_scavenger();
+    LOCK();
+    GC_scavenger_rate = scavenger_started ? (word)bytes_per_sec : 0;
+    UNLOCK();
+  }
+
+  GC_API size_t GC_CALL GC_get_scavenger_rate(void)
+  {
+    return (size_t)GC_scavenger_rate;
+  }
+
+# ifdef WATCH_MEMORY_PRESSURE
+    GC_API int GC_CALL GC_watch_memory_pressure(const char *trigger)
+    {
+      int fd;
+      DCL_LOCK_STATE;
+
+      if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+      fd = GC_open_memory_pressure(trigger != NULL ? trigger
+                                        : MEMORY_PRESSURE_TRIGGER);
+      if (-1 == fd) return 0;
+      GC_start_scavenger();
+      LOCK();
+      if (!scavenger_started) {
+        close(fd);
+        fd = -1;
+      } else {
+        if (GC_pressure_fd != -1)
+          close(GC_pressure_fd); /* replace the trigger */
+        GC_pressure_fd = fd;
+      }
+      UNLOCK();
+      return fd != -1;
+    }
+# endif
+#endif /* SCAVENGER_THREAD */
+
 #if !defined(SN_TARGET_ORBIS) && !defined(SN_TARGET_PSP2)
 
   /* Called at thread exit.  Never called for main thread.      */
@@ -2283,7 +3036,140 @@ GC_API int GC_CALL GC_register_my_thread(const struct GC_stack_base *sb)
 
 #endif /* !SN_TARGET_ORBIS && !SN_TARGET_PSP2 */
 
-#if defined(USE_SPIN_LOCK) || !defined(NO_PTHREAD_TRYLOCK)
+#ifdef FINALIZER_THREADS
+# ifndef FINALIZER_THROTTLE_MS
+#   define FINALIZER_THROTTLE_MS 10
+# endif
+
+  /* A finalizer thread waits for the finalization queue to become      */
+  /* non-empty and runs the finalizers by batches.  Unlike the          */
+  /* scavenger, it is a registered thread (created by the pthread_create */
+  /* wrapper) as the finalizers may allocate and manipulate pointers.   */
+  STATIC void * GC_finalizer_thread(void *arg)
+  {
+    IF_CANCEL(int cancel_state;)
+    DCL_LOCK_STATE;
+
+    DISABLE_CANCEL(cancel_state);
+    LOCK();
+    GC_self_thread() -> flags |= FINALIZER_THREAD;
+    UNLOCK();
+    for (;;) {
+      (void)pthread_mutex_lock(&finalizer_mutex);
+      while (!GC_should_invoke_finalizers())
+        (void)pthread_cond_wait(&finalizer_cv, &finalizer_mutex);
+      (void)pthread_mutex_unlock(&finalizer_mutex);
+
+      (void)GC_invoke_finalizers_batch(finalizer_batch_size);
+      (void)pthread_mutex_lock(&finalizer_mutex);
+      (void)pthread_cond_broadcast(&finalizer_batch_done_cv);
+      (void)pthread_mutex_unlock(&finalizer_mutex);
+    }
+    return arg; /* unreachable */
+  }
+
+  GC_INNER GC_bool GC_hand_over_finalizers(void)
+  {
+    GC_bool throttle;
+    IF_CANCEL(int cancel_state;)
+
+    GC_ASSERT(I_HOLD_LOCK());
+    if (0 == n_finalizer_threads) return FALSE;
+    throttle = finalizer_backlog_limit != 0
+               && GC_get_finalizer_queue_length() > finalizer_backlog_limit
+               && (GC_self_thread() -> flags
+                   & FINALIZER_THREAD) == 0;
+    UNLOCK();
+
+    DISABLE_CANCEL(cancel_state);
+    (void)pthread_mutex_lock(&finalizer_mutex);
+    (void)pthread_cond_broadcast(&finalizer_cv);
+#   ifdef HAVE_CLOCK_GETTIME
+      if (throttle) {
+        struct timespec ts;
+
+        /* Wait (for a bounded time, as the finalizers might need   */
+        /* something the current thread holds) for the finalizer    */
+        /* threads to catch up.                                     */
+        if (clock_gettime(CLOCK_REALTIME, &ts) == 0) {
+          ts.tv_nsec += FINALIZER_THROTTLE_MS * 1000000L;
+          if (ts.tv_nsec >= 1000000L * 1000) {
+            ts.tv_nsec -= 1000000L * 1000;
+            ts.tv_sec++;
+          }
+          while (GC_get_finalizer_queue_length() > finalizer_backlog_limit) {
+            if (pthread_cond_timedwait(&finalizer_batch_done_cv,
+                                       &finalizer_mutex, &ts) != 0)
+              break; /* timed out */
+          }
+        }
+      }
+#   else
+      UNUSED_ARG(throttle);
+#   endif
+    (void)pthread_mutex_unlock(&finalizer_mutex);
+    RESTORE_CANCEL(cancel_state);
+    return TRUE;
+  }
+
+  GC_API int GC_CALL GC_start_finalizer_threads(unsigned n)
+  {
+    pthread_attr_t attr;
+    unsigned i;
+    int result = GC_SUCCESS;
+
+    if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+    if (0 != pthread_attr_init(&attr)) ABORT("pthread_attr_init failed");
+    if (0 != pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED))
+      ABORT("pthread_attr_setdetachstate failed");
+    for (i = 0; i < n; i++) {
+      pthread_t new_thread;
+      DCL_LOCK_STATE;
+
+      if (WRAP_FUNC(pthread_create)(&new_thread, &attr,
+                                    GC_finalizer_thread, NULL) != 0) {
+        WARN("Finalizer thread creation failed\n", 0);
+        result = GC_NO_MEMORY;
+        break;
+      }
+      LOCK();
+      n_finalizer_threads++;
+      UNLOCK();
+    }
+    (void)pthread_attr_destroy(&attr);
+    GC_COND_LOG_PRINTF("Started %u finalizer threads\n", i);
+    return result;
+  }
+
+  GC_API unsigned GC_CALL GC_get_finalizer_threads(void)
+  {
+    return n_finalizer_threads;
+  }
+
+  GC_API void GC_CALL GC_set_finalizer_batch_size(unsigned n)
+  {
+    GC_ASSERT(n > 0);
+    finalizer_batch_size = n;
+  }
+
+  GC_API unsigned GC_CALL GC_get_finalizer_batch_size(void)
+  {
+    return finalizer_batch_size;
+  }
+
+  GC_API void GC_CALL GC_set_finalizer_backlog_limit(GC_word n)
+  {
+    finalizer_backlog_limit = n;
+  }
+
+  GC_API GC_word GC_CALL GC_get_finalizer_backlog_limit(void)
+  {
+    return finalizer_backlog_limit;
+  }
+#endif /* FINALIZER_THREADS */
+
+#if defined(USE_SPIN_LOCK) || defined(USE_MCS_LOCK) \
+    || !defined(NO_PTHREAD_TRYLOCK)
 /* Spend a few cycles in a way that can't introduce contention with     */
 /* other threads.                                                       */
 #define GC_PAUSE_SPIN_CYCLES 10
@@ -2308,8 +3194,18 @@ STATIC void GC_pause(void)
                         /* give up.                                     */
 #endif
 
-#if (!defined(USE_SPIN_LOCK) && !defined(NO_PTHREAD_TRYLOCK)) \
-        || defined(PARALLEL_MARK)
+/* #define LOCK_STATS */
+/* Note that LOCK_STATS requires AO_HAVE_test_and_set.  */
+#ifdef LOCK_STATS
+  /* The numbers of the lock acquisitions: without contention, after    */
+  /* spinning, and after blocking (or sleeping), respectively.          */
+  volatile AO_t GC_unlocked_count = 0;
+  volatile AO_t GC_spin_count = 0;
+  volatile AO_t GC_block_count = 0;
+#endif
+
+#if (!defined(USE_SPIN_LOCK) && !defined(USE_MCS_LOCK) \
+     && !defined(NO_PTHREAD_TRYLOCK)) || defined(PARALLEL_MARK)
 /* If we don't want to use the below spinlock implementation, either    */
 /* because we don't have a GC_test_and_set implementation, or because   */
 /* we don't want to risk sleeping, we can still try spinning on         */
@@ -2326,13 +3222,6 @@ STATIC void GC_pause(void)
 /* yield by calling pthread_mutex_lock(); it never makes sense to       */
 /* explicitly sleep.                                                    */
 
-/* #define LOCK_STATS */
-/* Note that LOCK_STATS requires AO_HAVE_test_and_set.  */
-#ifdef LOCK_STATS
-  volatile AO_t GC_spin_count = 0;
-  volatile AO_t GC_block_count = 0;
-  volatile AO_t GC_unlocked_count = 0;
-#endif
 
 STATIC void GC_generic_lock(pthread_mutex_t * lock)
 {
@@ -2384,6 +3273,75 @@ GC_INNER volatile unsigned char GC_collecting = FALSE;
 # define is_collecting() ((GC_bool)GC_collecting)
 #endif
 
+#ifdef THREAD_STATS
+  /* Account the time elapsed since start_time as spent waiting for     */
+  /* the allocation lock by the current thread (which now holds it).    */
+  static void note_lock_wait(CLOCK_TYPE start_time)
+  {
+    GC_thread me = GC_self_thread();
+    CLOCK_TYPE current_time;
+
+    if (NULL == me) return; /* not registered (yet) */
+    GET_TIME(current_time);
+    me -> lock_wait_ns += NS_TIME_DIFF(current_time, start_time);
+  }
+
+  GC_INNER void GC_fill_my_thread_stats(struct GC_thread_stats_s *pstats)
+  {
+    GC_thread me;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    me = GC_self_thread();
+    if (NULL == me) return;
+#   ifdef THREAD_LOCAL_ALLOC
+      {
+        int i;
+
+        pstats -> bytes_allocd += me -> tlfs.refill_bytes;
+        pstats -> n_refills += me -> tlfs.refill_count;
+        for (i = 0; i < GC_THREAD_STATS_SIZE_CLASSES; i++)
+          pstats -> objs_allocd[i] += me -> tlfs.refill_objs[i];
+        pstats -> stack_cleared_bytes += me -> tlfs.clear_stack.cleared_bytes;
+      }
+#   endif
+    pstats -> stopped_ns += me -> stopped_ns;
+    pstats -> lock_wait_ns += me -> lock_wait_ns;
+  }
+#endif /* THREAD_STATS */
+
+#ifdef PRECISE_STACK_ROOTS
+  GC_API int GC_CALL GC_set_my_stack_roots_proc(GC_stack_roots_proc fn,
+                                                void *client_data)
+  {
+    GC_thread me;
+    DCL_LOCK_STATE;
+
+    LOCK();
+    me = GC_self_thread();
+    GC_ASSERT(me != NULL);
+    me -> stack_roots_proc = fn;
+    me -> stack_roots_cd = client_data;
+    UNLOCK();
+    return 1;
+  }
+
+  GC_API GC_stack_roots_proc GC_CALL GC_get_my_stack_roots_proc(
+                                                void **pclient_data)
+  {
+    GC_thread me;
+    GC_stack_roots_proc fn;
+    DCL_LOCK_STATE;
+
+    LOCK();
+    me = GC_self_thread();
+    GC_ASSERT(me != NULL);
+    fn = me -> stack_roots_proc;
+    if (pclient_data != NULL) *pclient_data = me -> stack_roots_cd;
+    UNLOCK();
+    return fn;
+  }
+#endif /* PRECISE_STACK_ROOTS */
+
 #if defined(USE_SPIN_LOCK)
 
 /* Reasonably fast spin locks.  Basically the same implementation */
@@ -2408,11 +3366,17 @@ GC_INNER void GC_lock(void)
     unsigned my_spin_max;
     unsigned my_last_spins;
     unsigned i;
+#   ifdef THREAD_STATS
+      CLOCK_TYPE start_time;
+#   endif
 
     if (EXPECT(AO_test_and_set_acquire(&GC_allocate_lock)
                 == AO_TS_CLEAR, TRUE)) {
         return;
     }
+#   ifdef THREAD_STATS
+      GET_TIME(start_time);
+#   endif
     my_spin_max = (unsigned)AO_load(&spin_max);
     my_last_spins = (unsigned)AO_load(&last_spins);
     for (i = 0; i < my_spin_max; i++) {
@@ -2431,6 +3395,9 @@ GC_INNER void GC_lock(void)
              */
             AO_store(&last_spins, (AO_t)i);
             AO_store(&spin_max, (AO_t)high_spin_max);
+#           ifdef THREAD_STATS
+              note_lock_wait(start_time);
+#           endif
             return;
         }
     }
@@ -2439,6 +3406,9 @@ GC_INNER void GC_lock(void)
 yield:
     for (i = 0;; ++i) {
         if (AO_test_and_set_acquire(&GC_allocate_lock) == AO_TS_CLEAR) {
+#           ifdef THREAD_STATS
+              note_lock_wait(start_time);
+#           endif
             return;
         }
 #       define SLEEP_THRESHOLD 12
@@ -2463,25 +3433,138 @@ yield:
     }
 }
 
+#elif defined(USE_MCS_LOCK)
+
+/* The queued (MCS) allocation lock.  A waiter appends its node to the  */
+/* queue, then spins on the state of its own node (so the waiters do    */
+/* not contend for a single cache line), and then, if the lock is not   */
+/* handed over to it soon, sleeps on the futex of its node.  The lock   */
+/* holder passes the lock directly to the next waiter on release, thus  */
+/* a sleeping waiter is woken up only when it becomes the lock holder.  */
+/* The waiters do not spin while a collection is in progress (the lock  */
+/* is likely to be held for a long time), and on a uniprocessor.        */
+
+GC_INNER void GC_lock(void)
+{
+    struct mcs_node_s *me = &mcs_node;
+    struct mcs_node_s *pred;
+    unsigned state;
+    unsigned i;
+#   ifdef THREAD_STATS
+      CLOCK_TYPE start_time;
+#   endif
+
+    AO_store(&me -> next, 0);
+    if (EXPECT(AO_compare_and_swap_full(&GC_lock_tail, 0, (AO_t)me),
+               TRUE)) {
+#       ifdef LOCK_STATS
+            (void)AO_fetch_and_add1(&GC_unlocked_count);
+#       endif
+        return;
+    }
+#   ifdef THREAD_STATS
+      GET_TIME(start_time);
+#   endif
+    AO_int_store(&me -> state, MCS_WAITING);
+    do {
+        pred = (struct mcs_node_s *)AO_load(&GC_lock_tail);
+    } while (!AO_compare_and_swap_full(&GC_lock_tail, (AO_t)pred,
+                                       (AO_t)me));
+    if (NULL == pred) {
+        /* The lock has been released meanwhile.        */
+#       ifdef LOCK_STATS
+            (void)AO_fetch_and_add1(&GC_spin_count);
+#       endif
+    } else {
+        AO_store_release(&pred -> next, (AO_t)me);
+        for (i = 0; i < SPIN_MAX && GC_nprocs > 1 && !is_collecting();
+             ++i) {
+            if (AO_int_load(&me -> state) == MCS_GRANTED) break;
+            GC_pause();
+        }
+#       ifdef LOCK_STATS
+            (void)AO_fetch_and_add1(AO_int_load(&me -> state) == MCS_GRANTED
+                                    ? &GC_spin_count : &GC_block_count);
+#       endif
+        for (;;) {
+            state = AO_int_load(&me -> state);
+            if (MCS_GRANTED == state) break;
+            if (MCS_WAITING == state
+                && !AO_int_compare_and_swap_full(&me -> state, MCS_WAITING,
+                                                 MCS_PARKED))
+                continue; /* the lock has just been handed over */
+            if (syscall(SYS_futex, &me -> state, FUTEX_WAIT_PRIVATE,
+                        MCS_PARKED, NULL, NULL, 0) != 0
+                && errno != EAGAIN && errno != EINTR)
+                ABORT("futex wait failed");
+        }
+        AO_nop_full(); /* see the data updated by the previous holder */
+    }
+#   ifdef THREAD_STATS
+      note_lock_wait(start_time);
+#   endif
+}
+
+GC_INNER void GC_unlock(void)
+{
+    struct mcs_node_s *me = &mcs_node;
+    struct mcs_node_s *next = (struct mcs_node_s *)AO_load_acquire(
+                                                        &me -> next);
+
+    if (EXPECT(NULL == next, TRUE)) {
+        if (EXPECT(AO_compare_and_swap_release(&GC_lock_tail, (AO_t)me, 0),
+                   TRUE))
+            return;
+        /* A waiter is being appended, wait until it is linked to us.   */
+        while ((next = (struct mcs_node_s *)AO_load_acquire(&me -> next))
+                == NULL)
+            GC_pause();
+    }
+    if (!AO_int_compare_and_swap_full(&next -> state, MCS_WAITING,
+                                      MCS_GRANTED)) {
+        /* The waiter is parked.        */
+        AO_nop_full();
+        AO_int_store(&next -> state, MCS_GRANTED);
+        (void)syscall(SYS_futex, &next -> state, FUTEX_WAKE_PRIVATE, 1,
+                      NULL, NULL, 0);
+    }
+}
+
 #elif defined(USE_PTHREAD_LOCKS)
 
 # ifndef NO_PTHREAD_TRYLOCK
     GC_INNER void GC_lock(void)
     {
+#     ifdef THREAD_STATS
+        CLOCK_TYPE start_time;
+
+        GET_TIME(start_time);
+#     endif
       if (1 == GC_nprocs || is_collecting()) {
         pthread_mutex_lock(&GC_allocate_ml);
       } else {
         GC_generic_lock(&GC_allocate_ml);
       }
+#     ifdef THREAD_STATS
+        note_lock_wait(start_time);
+#     endif
     }
 # elif defined(GC_ASSERTIONS)
     GC_INNER void GC_lock(void)
     {
+#     ifdef THREAD_STATS
+        CLOCK_TYPE start_time;
+
+        GET_TIME(start_time);
+#     endif
       pthread_mutex_lock(&GC_allocate_ml);
+#     ifdef THREAD_STATS
+        note_lock_wait(start_time);
+#     endif
     }
 # endif
 
-#endif /* !USE_SPIN_LOCK && USE_PTHREAD_LOCKS */
+#endif /* !USE_SPIN_LOCK && !USE_MCS_LOCK && USE_PTHREAD_LOCKS */
 
 #ifdef PARALLEL_MARK
 
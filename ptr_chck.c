@@ -139,7 +139,7 @@ GC_API void * GC_CALL GC_is_valid_displacement(void *p)
     pdispl = HBLKDISPL(p);
     offset = pdispl % sz;
     if ((sz > MAXOBJBYTES && (word)p >= (word)h + sz)
-        || !GC_valid_offsets[offset]
+        || !GC_IS_VALID_OFFSET(hhdr, offset)
         || ((word)p + (sz - offset) > (word)(h + 1)
             && !IS_FORWARDING_ADDR_OR_NIL(HDR(h + 1)))) {
         goto fail;
@@ -34,6 +34,28 @@ GC_INNER signed_word GC_bytes_found = 0;
         /* a semaphore during marker threads startup.                   */
 #endif /* PARALLEL_MARK */
 
+#ifdef THREAD_LOCAL_SWEEP
+# ifdef GC_PTHREADS
+#   include <sched.h>
+# endif
+
+  GC_INNER volatile AO_t GC_sweep_claims = 0;
+
+  GC_INNER void GC_wait_for_sweep_claims(void)
+  {
+    GC_ASSERT(I_HOLD_LOCK());
+    /* No block could be claimed while we hold the lock, and the sweep  */
+    /* of the claimed ones does not need the lock, so just spin.        */
+    while (AO_load_acquire(&GC_sweep_claims) != 0) {
+#     ifdef GC_PTHREADS
+        sched_yield();
+#     else
+        Sleep(0);
+#     endif
+    }
+  }
+#endif /* THREAD_LOCAL_SWEEP */
+
 /* We defer printing of leaked objects until we're done with the GC     */
 /* cycle, since the routine for printing objects needs to run outside   */
 /* the collector, e.g. without the allocation lock.                     */
@@ -112,6 +134,10 @@ GC_INNER void GC_print_all_errors(void)
 #       endif
         GC_free(p);
     }
+#   ifdef HEAP_PROFILE
+      if (GC_heap_prof_print_leaks())
+        have_errors = TRUE;
+#   endif
 
     if (have_errors
 #       ifndef GC_ABORT_ON_LEAK
@@ -171,6 +197,52 @@ GC_INLINE word *GC_clear_block(word *p, word sz, signed_word *count)
   return p;
 }
 
+#ifdef BITMAP_SWEEP
+# define MARK_WORDS_PER_HBLK (HBLK_GRANULES / CPP_WORDSZ)
+
+# ifndef GC_ctz_word
+#   define GC_ctz_word(m) __builtin_ctzll((unsigned long long)(m))
+# endif
+# define GC_popcount_word(m) __builtin_popcountll((unsigned long long)(m))
+
+  GC_INNER void GC_init_obj_start_masks(void)
+  {
+    size_t lg, i;
+
+    GC_STATIC_ASSERT(HBLK_GRANULES % CPP_WORDSZ == 0);
+    for (lg = 1; lg <= MAXOBJGRANULES; lg++) {
+      for (i = 0; i + lg <= HBLK_GRANULES; i += lg) {
+        GC_obj_start_masks[lg][divWORDSZ(i)] |= (word)1 << modWORDSZ(i);
+      }
+    }
+  }
+
+  /* The bits of the unmarked objects in the given word of the marks.   */
+# define UNMARKED_OBJS(hhdr, lg, i) \
+                (GC_obj_start_masks[lg][i] & ~HDR_MARKS(hhdr)[i])
+
+  /* The address of the object corresponding to the lowest bit of m.    */
+# define OBJ_OF_BIT(hbp, i, m) \
+        ((hbp)->hb_body + GRANULES_TO_BYTES((i) * CPP_WORDSZ \
+                                            + (word)GC_ctz_word(m)))
+
+  /* Clear a run of adjacent unmarked objects of size sz (by a single   */
+  /* BZERO using the wide stores), then put them on the list.           */
+  GC_INLINE ptr_t GC_clear_run(ptr_t p, ptr_t lim, word sz, ptr_t list,
+                               signed_word *count)
+  {
+    if (p != lim) {
+      BZERO(p, (size_t)(lim - p));
+      *count += (signed_word)(lim - p);
+      for (; (word)p < (word)lim; p += sz) {
+        obj_link(p) = list;
+        list = p;
+      }
+    }
+    return list;
+  }
+#endif /* BITMAP_SWEEP */
+
 /*
  * Restore unmarked small objects in h of size sz to the object
  * free list.  Returns the new list.
@@ -179,8 +251,13 @@ GC_INLINE word *GC_clear_block(word *p, word sz, signed_word *count)
 STATIC ptr_t GC_reclaim_clear(struct hblk *hbp, hdr *hhdr, word sz,
                               ptr_t list, signed_word *count)
 {
-    word bit_no = 0;
-    ptr_t p, plim;
+#   ifdef BITMAP_SWEEP
+      size_t i;
+      ptr_t p, run = NULL, run_end = NULL;
+#   else
+      word bit_no = 0;
+      ptr_t p, plim;
+#   endif
 
     GC_ASSERT(hhdr == GC_find_header((ptr_t)hbp));
 #   ifndef THREADS
@@ -189,10 +266,27 @@ STATIC ptr_t GC_reclaim_clear(struct hblk *hbp, hdr *hhdr, word sz,
       /* Skip the assertion because of a potential race with GC_realloc. */
 #   endif
     GC_ASSERT((sz & (BYTES_PER_WORD-1)) == 0);
-    p = hbp->hb_body;
-    plim = p + HBLKSIZE - sz;
+#   ifdef BITMAP_SWEEP
+      GC_ASSERT(sz <= MAXOBJBYTES && (sz & (GRANULE_BYTES-1)) == 0);
+      /* Collect the adjacent unmarked objects into runs.       */
+      for (i = 0; i < MARK_WORDS_PER_HBLK; i++) {
+        word m = UNMARKED_OBJS(hhdr, BYTES_TO_GRANULES(sz), i);
+
+        for (; m != 0; m &= m - 1) {
+          p = OBJ_OF_BIT(hbp, i, m);
+          if (p != run_end) {
+            list = GC_clear_run(run, run_end, sz, list, count);
+            run = p;
+          }
+          run_end = p + sz;
+        }
+      }
+      list = GC_clear_run(run, run_end, sz, list, count);
+#   else
+      p = hbp->hb_body;
+      plim = p + HBLKSIZE - sz;
 
-    /* go through all words in block */
+      /* go through all words in block */
         while ((word)p <= (word)plim) {
             if (mark_bit_from_hdr(hhdr, bit_no)) {
                 p += sz;
@@ -205,6 +299,7 @@ STATIC ptr_t GC_reclaim_clear(struct hblk *hbp, hdr *hhdr, word sz,
             }
             bit_no += MARK_BIT_OFFSET(sz);
         }
+#   endif
     return list;
 }
 
@@ -212,17 +307,37 @@ STATIC ptr_t GC_reclaim_clear(struct hblk *hbp, hdr *hhdr, word sz,
 STATIC ptr_t GC_reclaim_uninit(struct hblk *hbp, hdr *hhdr, word sz,
                                ptr_t list, signed_word *count)
 {
-    word bit_no = 0;
-    word *p, *plim;
-    signed_word n_bytes_found = 0;
+#   ifdef BITMAP_SWEEP
+      size_t i;
+      word n_objs = 0;
+#   else
+      word bit_no = 0;
+      word *p, *plim;
+      signed_word n_bytes_found = 0;
+#   endif
 
 #   ifndef THREADS
       GC_ASSERT(sz == hhdr -> hb_sz);
 #   endif
-    p = (word *)(hbp->hb_body);
-    plim = (word *)((ptr_t)hbp + HBLKSIZE - sz);
+#   ifdef BITMAP_SWEEP
+      GC_ASSERT(sz <= MAXOBJBYTES && (sz & (GRANULE_BYTES-1)) == 0);
+      for (i = 0; i < MARK_WORDS_PER_HBLK; i++) {
+        word m = UNMARKED_OBJS(hhdr, BYTES_TO_GRANULES(sz), i);
+
+        n_objs += (word)GC_popcount_word(m);
+        for (; m != 0; m &= m - 1) {
+          ptr_t q = OBJ_OF_BIT(hbp, i, m);
 
-    /* go through all words in block */
+          obj_link(q) = list;
+          list = q;
+        }
+      }
+      *count += (signed_word)(n_objs * sz);
+#   else
+      p = (word *)(hbp->hb_body);
+      plim = (word *)((ptr_t)hbp + HBLKSIZE - sz);
+
+      /* go through all words in block */
         while ((word)p <= (word)plim) {
             if (!mark_bit_from_hdr(hhdr, bit_no)) {
                 n_bytes_found += sz;
@@ -233,7 +348,8 @@ STATIC ptr_t GC_reclaim_uninit(struct hblk *hbp, hdr *hhdr, word sz,
             p = (word *)((ptr_t)p + sz);
             bit_no += MARK_BIT_OFFSET(sz);
         }
-    *count += n_bytes_found;
+      *count += n_bytes_found;
+#   endif
     return list;
 }
 
@@ -269,26 +385,130 @@ STATIC ptr_t GC_reclaim_uninit(struct hblk *hbp, hdr *hhdr, word sz,
     }
     return list;
   }
+
+# ifndef DISCLAIM_BATCH_SIZE
+#   define DISCLAIM_BATCH_SIZE 64
+# endif
+
+# ifdef DISCLAIM_BITS_ATOMIC
+#   define DISCLAIM_BITS_WORD(hhdr, i) \
+        (word)AO_load((volatile AO_t *)&(hhdr)->hb_disclaim_bits[i])
+# else
+#   define DISCLAIM_BITS_WORD(hhdr, i) ((hhdr) -> hb_disclaim_bits[i])
+# endif
+
+  /* Is the summary of the block, i.e. hb_disclaim_bits, empty?  Only   */
+  /* for the kinds with ok_disclaim_needed_only set.                    */
+  STATIC GC_bool GC_no_disclaim_needed(hdr *hhdr)
+  {
+    size_t i;
+
+    for (i = 0; i < DISCLAIM_BITS_SZ; i++) {
+      if (DISCLAIM_BITS_WORD(hhdr, i) != 0)
+        return FALSE;
+    }
+    return TRUE;
+  }
+
+  /* Pass the given unreachable objects to the batched disclaim         */
+  /* procedure, then put them on the list.                              */
+  STATIC ptr_t GC_disclaim_objs(void (GC_CALLBACK *proc)(void **, size_t),
+                                void **objs, size_t n, word sz,
+                                ptr_t list, signed_word *count)
+  {
+    size_t i;
+
+    (*proc)(objs, n);
+    for (i = 0; i < n; i++) {
+      ptr_t p = (ptr_t)objs[i];
+
+      obj_link(p) = list;
+      list = p;
+      (void)GC_clear_block((word *)p, sz, count);
+    }
+    return list;
+  }
+
+  /* Same as GC_disclaim_and_reclaim but for a batched disclaim         */
+  /* procedure (which never resurrects the objects).  The procedure is  */
+  /* called once per DISCLAIM_BATCH_SIZE unmarked objects, skipping     */
+  /* the ones not flagged in hb_disclaim_bits if the kind has           */
+  /* ok_disclaim_needed_only set.                                       */
+  STATIC ptr_t GC_disclaim_batch_and_reclaim(struct hblk *hbp, hdr *hhdr,
+                                             word sz, ptr_t list,
+                                             signed_word *count)
+  {
+    struct obj_kind *ok = &GC_obj_kinds[hhdr->hb_obj_kind];
+    void (GC_CALLBACK *proc)(void **, size_t) = ok -> ok_disclaim_batch_proc;
+    GC_bool needed_only = ok -> ok_disclaim_needed_only;
+    void *objs[DISCLAIM_BATCH_SIZE];
+    size_t n = 0;
+    word bit_no = 0;
+    ptr_t p, plim;
+
+#   ifndef THREADS
+      GC_ASSERT(sz == hhdr -> hb_sz);
+#   endif
+    p = hbp->hb_body;
+    plim = p + HBLKSIZE - sz;
+
+    for (; (word)p <= (word)plim; p += sz, bit_no += MARK_BIT_OFFSET(sz)) {
+        if (mark_bit_from_hdr(hhdr, bit_no)) continue;
+        if (needed_only) {
+            if (((DISCLAIM_BITS_WORD(hhdr, divWORDSZ(bit_no))
+                  >> modWORDSZ(bit_no)) & 1) == 0) {
+                obj_link(p) = list;
+                list = p;
+                (void)GC_clear_block((word *)p, sz, count);
+                continue;
+            }
+            CLEAR_DISCLAIM_BIT(hhdr, bit_no);
+        }
+        objs[n++] = p;
+        if (DISCLAIM_BATCH_SIZE == n) {
+            list = GC_disclaim_objs(proc, objs, n, sz, list, count);
+            n = 0;
+        }
+    }
+    if (n > 0)
+        list = GC_disclaim_objs(proc, objs, n, sz, list, count);
+    return list;
+  }
 #endif /* ENABLE_DISCLAIM */
 
 /* Don't really reclaim objects, just check for unmarked ones: */
 STATIC void GC_reclaim_check(struct hblk *hbp, hdr *hhdr, word sz)
 {
-    word bit_no;
-    ptr_t p, plim;
+#   ifdef BITMAP_SWEEP
+      size_t i;
+#   else
+      word bit_no;
+      ptr_t p, plim;
+#   endif
 
 #   ifndef THREADS
       GC_ASSERT(sz == hhdr -> hb_sz);
 #   endif
-    /* go through all words in block */
-    p = hbp->hb_body;
-    plim = p + HBLKSIZE - sz;
-    for (bit_no = 0; (word)p <= (word)plim;
-         p += sz, bit_no += MARK_BIT_OFFSET(sz)) {
-      if (!mark_bit_from_hdr(hhdr, bit_no)) {
-        GC_add_leaked(p);
+#   ifdef BITMAP_SWEEP
+      GC_ASSERT(sz <= MAXOBJBYTES && (sz & (GRANULE_BYTES-1)) == 0);
+      for (i = 0; i < MARK_WORDS_PER_HBLK; i++) {
+        word m = UNMARKED_OBJS(hhdr, BYTES_TO_GRANULES(sz), i);
+
+        for (; m != 0; m &= m - 1) {
+          GC_add_leaked(OBJ_OF_BIT(hbp, i, m));
+        }
       }
-    }
+#   else
+      /* go through all words in block */
+      p = hbp->hb_body;
+      plim = p + HBLKSIZE - sz;
+      for (bit_no = 0; (word)p <= (word)plim;
+           p += sz, bit_no += MARK_BIT_OFFSET(sz)) {
+        if (!mark_bit_from_hdr(hhdr, bit_no)) {
+          GC_add_leaked(p);
+        }
+      }
+#   endif
 }
 
 /* Is a pointer-free block?  Same as IS_PTRFREE macro (in os_dep.c) but */
@@ -318,7 +538,16 @@ GC_INNER ptr_t GC_reclaim_generic(struct hblk * hbp, hdr *hhdr, size_t sz,
 #   endif
 #   ifdef ENABLE_DISCLAIM
       if ((hhdr -> hb_flags & HAS_DISCLAIM) != 0) {
-        result = GC_disclaim_and_reclaim(hbp, hhdr, sz, list, count);
+        struct obj_kind *ok = &GC_obj_kinds[hhdr -> hb_obj_kind];
+
+        if (NULL == ok -> ok_disclaim_batch_proc) {
+          result = GC_disclaim_and_reclaim(hbp, hhdr, sz, list, count);
+        } else if (ok -> ok_disclaim_needed_only
+                   && GC_no_disclaim_needed(hhdr)) {
+          result = GC_reclaim_clear(hbp, hhdr, sz, list, count);
+        } else {
+          result = GC_disclaim_batch_and_reclaim(hbp, hhdr, sz, list, count);
+        }
       } else
 #   endif
     /* else */ if (init || GC_debugging_started) {
@@ -364,6 +593,15 @@ STATIC void GC_reclaim_small_nonempty_block(struct hblk *hbp, word sz,
     void *flh_next;
 
     hhdr -> hb_last_reclaimed = (unsigned short) GC_gc_no;
+#   ifdef ENABLE_DISCLAIM
+      if (!hhdr -> hb_n_marks && ok -> ok_disclaim_needed_only
+          && GC_no_disclaim_needed(hhdr)) {
+        /* Nothing to disclaim, so there is no need to sweep.   */
+        GC_bytes_found += HBLKSIZE;
+        GC_freehblk(hbp);
+        return;
+      }
+#   endif
     flh_next = GC_reclaim_generic(hbp, hhdr, sz, ok -> ok_init,
                                   (ptr_t)(*flh), &GC_bytes_found);
     if (hhdr -> hb_n_marks)
@@ -397,6 +635,20 @@ STATIC void GC_CALLBACK GC_reclaim_block(struct hblk *hbp,
         /* No race as GC_realloc holds the lock while updating hb_sz.   */
         sz = hhdr -> hb_sz;
 #   endif
+    /* The blocks not reached by the marker in the current cycle have   */
+    /* their mark bits cleared only here.                               */
+    VALIDATE_MARKS(hhdr);
+    if (EXPECT((hhdr -> hb_flags & FROZEN_BLK) != 0, FALSE)) {
+        /* Never swept, so that its pages are not written.      */
+        word in_use = sz > MAXOBJBYTES ? sz : sz * hhdr -> hb_n_marks;
+
+        if (IS_PTRFREE_SAFE(hhdr)) {
+          GC_atomic_in_use += in_use;
+        } else {
+          GC_composite_in_use += in_use;
+        }
+        return;
+    }
     if( sz > MAXOBJBYTES ) {  /* 1 big object */
         if( !mark_bit_from_hdr(hhdr, 0) ) {
             if (report_if_found) {
@@ -406,7 +658,16 @@ STATIC void GC_CALLBACK GC_reclaim_block(struct hblk *hbp,
 
 #             ifdef ENABLE_DISCLAIM
                 if (EXPECT(hhdr->hb_flags & HAS_DISCLAIM, 0)) {
-                  if ((*ok->ok_disclaim_proc)(hbp)) {
+                  if (ok -> ok_disclaim_batch_proc != 0) {
+                    void *obj = hbp -> hb_body;
+
+                    if (!ok -> ok_disclaim_needed_only
+                        || !GC_no_disclaim_needed(hhdr)) {
+                      if (ok -> ok_disclaim_needed_only)
+                        CLEAR_DISCLAIM_BIT(hhdr, 0);
+                      (*ok->ok_disclaim_batch_proc)(&obj, 1);
+                    }
+                  } else if ((*ok->ok_disclaim_proc)(hbp)) {
                     /* Not disclaimed => resurrect the object. */
                     set_mark_bit_from_hdr(hhdr, 0);
                     goto in_use;
@@ -417,7 +678,7 @@ STATIC void GC_CALLBACK GC_reclaim_block(struct hblk *hbp,
 #             if defined(CPPCHECK)
                 GC_noop1((word)&blocks);
 #             endif
-              if (blocks > 1) {
+              if (blocks > 1 && !IS_LOS_HDR(hhdr)) {
                 GC_large_allocd_bytes -= blocks * HBLKSIZE;
               }
               GC_bytes_found += sz;
@@ -504,10 +765,11 @@ unsigned GC_n_set_marks(hdr *hhdr)
     word offset = MARK_BIT_OFFSET(hhdr -> hb_sz);
     word limit = FINAL_MARK_BIT(hhdr -> hb_sz);
 
+    VALIDATE_MARKS(hhdr);
     for (i = 0; i < limit; i += offset) {
-        result += hhdr -> hb_marks[i];
+        result += HDR_MARKS(hhdr)[i];
     }
-    GC_ASSERT(hhdr -> hb_marks[limit]); /* the one set past the end */
+    GC_ASSERT(HDR_MARKS(hhdr)[limit]); /* the one set past the end */
     return result;
 }
 
@@ -533,25 +795,33 @@ unsigned GC_n_set_marks(hdr *hhdr)
       word n_objs = HBLK_OBJS(sz);
       word n_mark_words = divWORDSZ(n_objs > 0 ? n_objs : 1); /* round down */
 
+      VALIDATE_MARKS(hhdr);
       for (i = 0; i <= n_mark_words; i++) {
-          result += count_ones(hhdr -> hb_marks[i]);
+          result += count_ones(HDR_MARKS(hhdr)[i]);
       }
 #   else /* MARK_BIT_PER_GRANULE */
 
+      VALIDATE_MARKS(hhdr);
       for (i = 0; i < MARK_BITS_SZ; i++) {
-          result += count_ones(hhdr -> hb_marks[i]);
+          result += count_ones(HDR_MARKS(hhdr)[i]);
       }
 #   endif
     GC_ASSERT(result > 0);
     result--; /* exclude the one bit set past the end */
 #   ifndef MARK_BIT_PER_OBJ
       if (IS_UNCOLLECTABLE(hhdr -> hb_obj_kind)) {
-        unsigned ngranules = (unsigned)BYTES_TO_GRANULES(sz);
+        word ngranules = BYTES_TO_GRANULES(sz);
+        word n_objs = HBLK_OBJS(sz);
 
         /* As mentioned in GC_set_hdr_marks(), all the bits are set     */
-        /* instead of every n-th, thus the result should be adjusted.   */
-        GC_ASSERT(ngranules > 0 && result % ngranules == 0);
-        result /= ngranules;
+        /* instead of every n-th, but GC_clear_fl_marks() clears only   */
+        /* the first bit of a free object, thus count the first bits.   */
+        GC_ASSERT(ngranules > 0);
+        if (0 == n_objs) n_objs = 1;
+        result = 0;
+        for (i = 0; i < n_objs; i++) {
+          result += (unsigned)mark_bit_from_hdr(hhdr, i * ngranules);
+        }
       }
 #   endif
     return result;
@@ -611,8 +881,454 @@ GC_API void GC_CALL GC_print_free_list(int kind, size_t sz_in_granules)
     }
 }
 
+typedef void (*GC_size_class_stats_fn)(const struct GC_size_class_stats_s *,
+                                       void *);
+
+STATIC struct GC_size_class_stats_s *GC_sc_stats = NULL;
+                        /* Per size (in granules, 0 for the large       */
+                        /* objects) entries of the kind being walked.   */
+                        /* Allocated once by GC_scratch_alloc.          */
+
+STATIC void GC_CALLBACK GC_add_block_sc_stats(struct hblk *h,
+                                              GC_word kind)
+{
+    hdr *hhdr = HDR(h);
+    word sz = hhdr -> hb_sz;
+    struct GC_size_class_stats_s *pstats;
+    word n_objs, n_marks;
+
+    if (hhdr -> hb_obj_kind != kind) return;
+    if (sz > MAXOBJBYTES) {
+      pstats = GC_sc_stats;
+      n_objs = 1;
+      pstats -> block_bytes += (sz + (HBLKSIZE-1)) & ~(HBLKSIZE-1);
+    } else {
+      pstats = GC_sc_stats + BYTES_TO_GRANULES(sz);
+      pstats -> obj_bytes = sz;
+      n_objs = HBLK_OBJS(sz);
+      pstats -> block_bytes += HBLKSIZE;
+    }
+    n_marks = GC_n_set_marks(hhdr);
+    pstats -> n_blocks++;
+    pstats -> n_objs += n_objs;
+    pstats -> live_objs += n_marks;
+    pstats -> live_bytes += n_marks * sz;
+    pstats -> occupancy[n_marks >= n_objs ? GC_OCCUPANCY_BUCKETS
+                            : n_marks * GC_OCCUPANCY_BUCKETS / n_objs]++;
+}
+
+/* Pass the non-empty entries of the fragmentation summary to fn.       */
+/* Returns the number of the entries.                                   */
+STATIC size_t GC_walk_size_class_stats(GC_size_class_stats_fn fn,
+                                       void *client_data)
+{
+    size_t n_entries = 0;
+    unsigned kind;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    if (NULL == GC_sc_stats) {
+      GC_sc_stats = (struct GC_size_class_stats_s *)GC_scratch_alloc(
+                (MAXOBJGRANULES + 1) * sizeof(struct GC_size_class_stats_s));
+      if (NULL == GC_sc_stats) return 0;
+    }
+    for (kind = 0; kind < GC_n_kinds; kind++) {
+      size_t i;
+
+      BZERO(GC_sc_stats,
+            (MAXOBJGRANULES + 1) * sizeof(struct GC_size_class_stats_s));
+      GC_apply_to_all_blocks(GC_add_block_sc_stats, (word)kind);
+      /* Report the small object sizes first, the large ones last.      */
+      for (i = 1; i <= MAXOBJGRANULES + 1; i++) {
+        struct GC_size_class_stats_s *pstats =
+                        GC_sc_stats + (i <= MAXOBJGRANULES ? i : 0);
+
+        if (0 == pstats -> n_blocks) continue;
+        pstats -> kind = kind;
+        fn(pstats, client_data);
+        n_entries++;
+      }
+    }
+    return n_entries;
+}
+
+struct sc_stats_array_s {
+    struct GC_size_class_stats_s *entries;
+    size_t n_entries;
+    size_t next;
+};
+
+STATIC void GC_copy_sc_stats(const struct GC_size_class_stats_s *pstats,
+                             void *client_data)
+{
+    struct sc_stats_array_s *parr = (struct sc_stats_array_s *)client_data;
+
+    if (parr -> next < parr -> n_entries)
+      parr -> entries[parr -> next] = *pstats;
+    parr -> next++;
+}
+
+GC_API size_t GC_CALL GC_get_size_class_stats(
+                                struct GC_size_class_stats_s *entries,
+                                size_t n_entries)
+{
+    struct sc_stats_array_s arr;
+    size_t result;
+    DCL_LOCK_STATE;
+
+    arr.entries = entries;
+    arr.n_entries = entries != NULL ? n_entries : 0;
+    arr.next = 0;
+    LOCK();
+    result = GC_walk_size_class_stats(GC_copy_sc_stats, &arr);
+    UNLOCK();
+    return result;
+}
+
+struct json_buf_s {
+    char *buf;
+    size_t buf_size;
+    size_t len; /* may exceed buf_size */
+    GC_bool in_list; /* an entry has been already written */
+};
+
+STATIC void GC_json_puts(struct json_buf_s *pjb, const char *s)
+{
+    for (; *s != '\0'; s++) {
+      if (pjb -> len + 1 < pjb -> buf_size)
+        pjb -> buf[pjb -> len] = *s;
+      pjb -> len++;
+    }
+}
+
+STATIC void GC_json_putw(struct json_buf_s *pjb, word value)
+{
+    char digits[3 * sizeof(word) + 1];
+    char *p = digits + sizeof(digits) - 1;
+
+    *p = '\0';
+    do {
+      *--p = (char)('0' + value % 10);
+      value /= 10;
+    } while (value != 0);
+    GC_json_puts(pjb, p);
+}
+
+STATIC void GC_json_sc_stats(const struct GC_size_class_stats_s *pstats,
+                             void *client_data)
+{
+    struct json_buf_s *pjb = (struct json_buf_s *)client_data;
+    int i;
+
+    if (pjb -> in_list) GC_json_puts(pjb, ",");
+    pjb -> in_list = TRUE;
+    GC_json_puts(pjb, "{\"kind\":");
+    GC_json_putw(pjb, pstats -> kind);
+    GC_json_puts(pjb, ",\"obj_bytes\":");
+    GC_json_putw(pjb, pstats -> obj_bytes);
+    GC_json_puts(pjb, ",\"blocks\":");
+    GC_json_putw(pjb, pstats -> n_blocks);
+    GC_json_puts(pjb, ",\"block_bytes\":");
+    GC_json_putw(pjb, pstats -> block_bytes);
+    GC_json_puts(pjb, ",\"objs\":");
+    GC_json_putw(pjb, pstats -> n_objs);
+    GC_json_puts(pjb, ",\"live_objs\":");
+    GC_json_putw(pjb, pstats -> live_objs);
+    GC_json_puts(pjb, ",\"live_bytes\":");
+    GC_json_putw(pjb, pstats -> live_bytes);
+    GC_json_puts(pjb, ",\"occupancy\":[");
+    for (i = 0; i <= GC_OCCUPANCY_BUCKETS; i++) {
+      if (i > 0) GC_json_puts(pjb, ",");
+      GC_json_putw(pjb, pstats -> occupancy[i]);
+    }
+    GC_json_puts(pjb, "]}");
+}
+
+GC_API size_t GC_CALL GC_get_size_class_stats_json(char *buf,
+                                                   size_t buf_size)
+{
+    struct json_buf_s jb;
+    DCL_LOCK_STATE;
+
+    jb.buf = buf;
+    jb.buf_size = buf != NULL ? buf_size : 0;
+    jb.len = 0;
+    jb.in_list = FALSE;
+    LOCK();
+    GC_json_puts(&jb, "{\"gc_no\":");
+    GC_json_putw(&jb, GC_gc_no);
+    GC_json_puts(&jb, ",\"block_bytes\":");
+    GC_json_putw(&jb, HBLKSIZE);
+    GC_json_puts(&jb, ",\"classes\":[");
+    (void)GC_walk_size_class_stats(GC_json_sc_stats, &jb);
+    UNLOCK();
+    GC_json_puts(&jb, "]}");
+    if (jb.buf_size > 0)
+      buf[jb.len < jb.buf_size ? jb.len : jb.buf_size - 1] = '\0';
+    return jb.len;
+}
+
+STATIC struct GC_scan_yield_stats_s *GC_sy_stats = NULL;
+                        /* Per size (in granules, 0 for the large       */
+                        /* objects) entries.  Allocated once by         */
+                        /* GC_scratch_alloc.                            */
+
+STATIC void GC_CALLBACK GC_add_block_scan_yield(struct hblk *h,
+                                                GC_word dummy)
+{
+    hdr *hhdr = HDR(h);
+    word sz = hhdr -> hb_sz;
+    struct GC_scan_yield_stats_s *pstats;
+    ptr_t p = h -> hb_body;
+    ptr_t plim;
+    word bit_no = 0;
+
+    UNUSED_ARG(dummy);
+    if (hhdr -> hb_obj_kind != NORMAL) return;
+    VALIDATE_MARKS(hhdr);
+    if (sz > MAXOBJBYTES) {
+      pstats = GC_sy_stats;
+      plim = p;
+    } else {
+      pstats = GC_sy_stats + BYTES_TO_GRANULES(sz);
+      pstats -> obj_bytes = sz;
+      plim = p + HBLKSIZE - sz;
+    }
+    for (; (word)p <= (word)plim; p += sz, bit_no += MARK_BIT_OFFSET(sz)) {
+      word *q = (word *)p;
+      word *qlim = (word *)(p + sz);
+      word n_ptr_words = 0;
+
+      if (!mark_bit_from_hdr(hhdr, bit_no)) continue;
+      for (; (word)q < (word)qlim; q++) {
+        word v = *q;
+
+        if (v >= (word)GC_least_plausible_heap_addr
+            && v < (word)GC_greatest_plausible_heap_addr
+            && GC_base((void *)v) != NULL)
+          n_ptr_words++;
+      }
+      pstats -> n_objs++;
+      if (0 == n_ptr_words) pstats -> n_objs_no_ptrs++;
+      pstats -> n_words += BYTES_TO_WORDS(sz);
+      pstats -> n_ptr_words += n_ptr_words;
+    }
+}
+
+GC_API size_t GC_CALL GC_get_scan_yield_stats(
+                                struct GC_scan_yield_stats_s *entries,
+                                size_t n_entries)
+{
+    size_t i;
+    size_t result = 0;
+    DCL_LOCK_STATE;
+
+    LOCK();
+    if (NULL == GC_sy_stats) {
+      GC_sy_stats = (struct GC_scan_yield_stats_s *)GC_scratch_alloc(
+                (MAXOBJGRANULES + 1) * sizeof(struct GC_scan_yield_stats_s));
+      if (NULL == GC_sy_stats) {
+        UNLOCK();
+        return 0;
+      }
+    }
+    BZERO(GC_sy_stats,
+          (MAXOBJGRANULES + 1) * sizeof(struct GC_scan_yield_stats_s));
+    GC_apply_to_all_blocks(GC_add_block_scan_yield, 0);
+    /* Report the small object sizes first, the large ones last.        */
+    for (i = 1; i <= MAXOBJGRANULES + 1; i++) {
+      struct GC_scan_yield_stats_s *pstats =
+                        GC_sy_stats + (i <= MAXOBJGRANULES ? i : 0);
+
+      if (0 == pstats -> n_objs) continue;
+      if (entries != NULL && result < n_entries)
+        entries[result] = *pstats;
+      result++;
+    }
+    UNLOCK();
+    return result;
+}
+
+#else
+
+GC_API size_t GC_CALL GC_get_size_class_stats(
+                                struct GC_size_class_stats_s *entries,
+                                size_t n_entries)
+{
+    UNUSED_ARG(entries);
+    UNUSED_ARG(n_entries);
+    return 0;
+}
+
+GC_API size_t GC_CALL GC_get_size_class_stats_json(char *buf,
+                                                   size_t buf_size)
+{
+    if (buf != NULL && buf_size > 0) *buf = '\0';
+    return 0;
+}
+
+GC_API size_t GC_CALL GC_get_scan_yield_stats(
+                                struct GC_scan_yield_stats_s *entries,
+                                size_t n_entries)
+{
+    UNUSED_ARG(entries);
+    UNUSED_ARG(n_entries);
+    return 0;
+}
+
 #endif /* !NO_DEBUGGING */
 
+#ifdef PARALLEL_MARK
+  STATIC GC_bool GC_parallel_reclaim = FALSE;
+                        /* Sweep all the reclaim lists eagerly (at the  */
+                        /* end of each collection) using the marker     */
+                        /* threads.                                     */
+
+  GC_INNER word GC_parallel_reclaim_ns = 0;
+  GC_INNER word GC_parallel_reclaim_work_ns = 0;
+
+  STATIC word GC_next_reclaim_slot = 0;
+                        /* Index of the next (kind, size) reclaim list  */
+                        /* to be swept by a helper.  Protected by mark  */
+                        /* lock.                                        */
+  STATIC GC_bool GC_par_reclaim_ignore_old = FALSE;
+
+  STATIC GC_bool GC_lazy_clear = FALSE;
+                        /* Leave the blocks of kinds which objects are  */
+                        /* cleared on sweep to the refilling allocator  */
+                        /* in the parallel reclaim mode.                */
+
+  STATIC GC_bool GC_par_reclaim_skip_clear = FALSE;
+
+  /* Sweep the reclaim lists claimed one by one until there are none    */
+  /* left.  Each (kind, size) pair has its own free list, so it is      */
+  /* updated by the owner of the slot without synchronization.  Kinds   */
+  /* with a disclaim procedure are left to the initiating thread.       */
+  STATIC void GC_reclaim_slots(unsigned id, mse *local_mark_stack)
+  {
+    word n_slots = (word)GC_n_kinds * MAXOBJGRANULES;
+    signed_word bytes_found = 0;
+#   ifndef NO_CLOCK
+      CLOCK_TYPE start_time = CLOCK_TYPE_INITIALIZER;
+      CLOCK_TYPE done_time;
+
+      GET_TIME(start_time);
+#   endif
+
+    UNUSED_ARG(id);
+    UNUSED_ARG(local_mark_stack);
+    for (;;) {
+      word slot;
+      size_t gran;
+      struct obj_kind *ok;
+      struct hblk **rlh;
+      struct hblk *hbp;
+      void **flh;
+
+      GC_acquire_mark_lock();
+      slot = GC_next_reclaim_slot++;
+      GC_release_mark_lock();
+      if (slot >= n_slots) break;
+
+      ok = &GC_obj_kinds[slot / MAXOBJGRANULES];
+      if (NULL == ok -> ok_reclaim_list) continue;
+#     ifdef ENABLE_DISCLAIM
+        if (ok -> ok_disclaim_proc != 0
+            || ok -> ok_disclaim_batch_proc != 0) continue;
+#     endif
+      if (GC_par_reclaim_skip_clear
+          && (ok -> ok_init || GC_debugging_started)) continue;
+      gran = (size_t)(slot % MAXOBJGRANULES) + 1;
+      rlh = ok -> ok_reclaim_list + gran;
+      flh = &(ok -> ok_freelist[gran]);
+      while ((hbp = *rlh) != NULL) {
+        hdr *hhdr = HDR(hbp);
+
+        *rlh = hhdr -> hb_next;
+        if (!GC_par_reclaim_ignore_old
+            || (word)hhdr->hb_last_reclaimed == GC_gc_no - 1) {
+          hhdr -> hb_last_reclaimed = (unsigned short)GC_gc_no;
+          *flh = GC_reclaim_generic(hbp, hhdr, hhdr -> hb_sz, ok -> ok_init,
+                                    (ptr_t)(*flh), &bytes_found);
+        }
+      }
+    }
+#   ifndef NO_CLOCK
+      GET_TIME(done_time);
+#   endif
+    GC_acquire_mark_lock();
+    GC_bytes_found += bytes_found;
+#   ifndef NO_CLOCK
+      GC_parallel_reclaim_work_ns += NS_TIME_DIFF(done_time, start_time);
+#   endif
+    GC_release_mark_lock();
+  }
+
+  /* Sweep the reclaim lists of all kinds (except for ones having a     */
+  /* disclaim procedure, and, if skip_clear, for ones which objects are */
+  /* cleared on sweep) using all the marker threads.                    */
+  STATIC void GC_reclaim_all_parallel(GC_bool ignore_old,
+                                      GC_bool skip_clear)
+  {
+#   ifndef NO_CLOCK
+      CLOCK_TYPE start_time = CLOCK_TYPE_INITIALIZER;
+      CLOCK_TYPE done_time;
+
+      GET_TIME(start_time);
+#   endif
+    GC_ASSERT(I_HOLD_LOCK());
+    GC_next_reclaim_slot = 0;
+    GC_par_reclaim_ignore_old = ignore_old;
+    GC_par_reclaim_skip_clear = skip_clear;
+    GC_do_parallel_task(GC_reclaim_slots);
+#   ifndef NO_CLOCK
+      GET_TIME(done_time);
+      GC_parallel_reclaim_ns += NS_TIME_DIFF(done_time, start_time);
+#   endif
+  }
+
+  /* Sweeping by the helpers is not allowed if the collector has to    */
+  /* unprotect the pages being swept (GC_remove_protection).            */
+# define GC_SHOULD_RECLAIM_IN_PARALLEL() \
+        (GC_parallel_reclaim && GC_parallel && (!GC_auto_incremental \
+         || GC_incremental_protection_needs() == GC_PROTECTS_NONE))
+#endif /* PARALLEL_MARK */
+
+GC_API void GC_CALL GC_set_parallel_reclaim(int value)
+{
+# ifdef PARALLEL_MARK
+    GC_parallel_reclaim = (GC_bool)(value != 0);
+# else
+    UNUSED_ARG(value);
+# endif
+}
+
+GC_API int GC_CALL GC_get_parallel_reclaim(void)
+{
+# ifdef PARALLEL_MARK
+    return (int)GC_parallel_reclaim;
+# else
+    return 0;
+# endif
+}
+
+GC_API void GC_CALL GC_set_lazy_clear(int value)
+{
+# ifdef PARALLEL_MARK
+    GC_lazy_clear = (GC_bool)(value != 0);
+# else
+    UNUSED_ARG(value);
+# endif
+}
+
+GC_API int GC_CALL GC_get_lazy_clear(void)
+{
+# ifdef PARALLEL_MARK
+    return (int)GC_lazy_clear;
+# else
+    return 0;
+# endif
+}
+
 /*
  * Clear all obj_link pointers in the list of free objects *flp.
  * Clear *flp.
@@ -631,14 +1347,88 @@ STATIC void GC_clear_fl_links(void **flp)
     }
 }
 
+GC_INNER GC_bool GC_start_reclaim_pending = FALSE;
+STATIC struct hblk *GC_start_reclaim_ptr = NULL;
+                        /* The lowest address of the heap blocks not    */
+                        /* examined yet by the pending GC_start_reclaim. */
+
+/* The part of GC_start_reclaim done once all the heap blocks have been */
+/* examined.                                                            */
+STATIC void GC_complete_start_reclaim(GC_bool report_if_found)
+{
+# if defined(PARALLEL_MARK) && !defined(EAGER_SWEEP)
+    /* With the parallel reclaim mode, sweep everything right now using */
+    /* the marker threads instead of deferring it to the allocator.     */
+    /* In the lazy clear mode, the blocks which free objects should be  */
+    /* cleared are still swept by the allocator, i.e. the objects are   */
+    /* cleared in bulk when a free list is refilled, outside the pause  */
+    /* and shortly before the objects are handed out.                   */
+    if (!report_if_found && GC_SHOULD_RECLAIM_IN_PARALLEL()) {
+      if (GC_lazy_clear) {
+        GC_reclaim_all_parallel(FALSE, TRUE);
+      } else {
+        (void)GC_reclaim_all((GC_stop_func)0, FALSE);
+      }
+    }
+# else
+    UNUSED_ARG(report_if_found);
+# endif
+# ifdef EAGER_SWEEP
+    /* This is a very stupid thing to do.  We make it possible anyway,  */
+    /* so that you can convince yourself that it really is very stupid. */
+    GC_reclaim_all((GC_stop_func)0, FALSE);
+# elif defined(ENABLE_DISCLAIM)
+    /* However, make sure to clear reclaimable objects of kinds with    */
+    /* unconditional marking enabled before we do any significant       */
+    /* marking work.                                                    */
+    GC_reclaim_unconditionally_marked();
+# endif
+# if defined(PARALLEL_MARK)
+    GC_ASSERT(0 == GC_fl_builder_count);
+# endif
+}
+
+/* Clear the reclaim lists and (unless report_if_found) the small      */
+/* object free lists of all kinds.                                      */
+STATIC void GC_clear_reclaim_and_free_lists(GC_bool report_if_found)
+{
+    unsigned kind;
+
+    for (kind = 0; kind < GC_n_kinds; kind++) {
+      struct hblk ** rlist = GC_obj_kinds[kind].ok_reclaim_list;
+      GC_bool should_clobber = (GC_obj_kinds[kind].ok_descriptor != 0);
+
+      if (rlist == 0) continue;       /* This kind not used.  */
+      if (!report_if_found) {
+          void **fop;
+          void **lim = &(GC_obj_kinds[kind].ok_freelist[MAXOBJGRANULES+1]);
+
+          for (fop = GC_obj_kinds[kind].ok_freelist;
+               (word)fop < (word)lim; (*(word **)&fop)++) {
+            if (*fop != 0) {
+              if (should_clobber) {
+                GC_clear_fl_links(fop);
+              } else {
+                *fop = 0;
+              }
+            }
+          }
+      } /* otherwise free list objects are marked,    */
+        /* and its safe to leave them                 */
+      BZERO(rlist, (MAXOBJGRANULES + 1) * sizeof(void *));
+    }
+}
+
 /*
  * Perform GC_reclaim_block on the entire heap, after first clearing
  * small object free lists (if we are not just looking for leaks).
+ * In the incremental mode with a pause time limit, just prepare the
+ * walk over the heap blocks, the latter is done by
+ * GC_continue_start_reclaim calls.
  */
 GC_INNER void GC_start_reclaim(GC_bool report_if_found)
 {
-    unsigned kind;
-
+    GC_ASSERT(!GC_start_reclaim_pending);
 #   if defined(PARALLEL_MARK)
       GC_ASSERT(0 == GC_fl_builder_count);
 #   endif
@@ -646,49 +1436,58 @@ GC_INNER void GC_start_reclaim(GC_bool report_if_found)
       GC_composite_in_use = 0;
       GC_atomic_in_use = 0;
     /* Clear reclaim- and free-lists */
-      for (kind = 0; kind < GC_n_kinds; kind++) {
-        struct hblk ** rlist = GC_obj_kinds[kind].ok_reclaim_list;
-        GC_bool should_clobber = (GC_obj_kinds[kind].ok_descriptor != 0);
-
-        if (rlist == 0) continue;       /* This kind not used.  */
-        if (!report_if_found) {
-            void **fop;
-            void **lim = &(GC_obj_kinds[kind].ok_freelist[MAXOBJGRANULES+1]);
-
-            for (fop = GC_obj_kinds[kind].ok_freelist;
-                 (word)fop < (word)lim; (*(word **)&fop)++) {
-              if (*fop != 0) {
-                if (should_clobber) {
-                  GC_clear_fl_links(fop);
-                } else {
-                  *fop = 0;
-                }
-              }
-            }
-        } /* otherwise free list objects are marked,    */
-          /* and its safe to leave them                 */
-        BZERO(rlist, (MAXOBJGRANULES + 1) * sizeof(void *));
-      }
+      GC_clear_reclaim_and_free_lists(report_if_found);
 
+#   if !defined(GC_DISABLE_INCREMENTAL) && !defined(NO_CLOCK)
+      if (GC_incremental && GC_time_limit != GC_TIME_UNLIMITED
+          && !report_if_found && !GC_find_leak) {
+        GC_start_reclaim_ptr = NULL;
+        GC_start_reclaim_pending = TRUE;
+        return;
+      }
+#   endif
 
   /* Go through all heap blocks (in hblklist) and reclaim unmarked objects */
   /* or enqueue the block for later processing.                            */
     GC_apply_to_all_blocks(GC_reclaim_block, (word)report_if_found);
+    GC_complete_start_reclaim(report_if_found);
+}
 
-# ifdef EAGER_SWEEP
-    /* This is a very stupid thing to do.  We make it possible anyway,  */
-    /* so that you can convince yourself that it really is very stupid. */
-    GC_reclaim_all((GC_stop_func)0, FALSE);
-# elif defined(ENABLE_DISCLAIM)
-    /* However, make sure to clear reclaimable objects of kinds with    */
-    /* unconditional marking enabled before we do any significant       */
-    /* marking work.                                                    */
-    GC_reclaim_unconditionally_marked();
-# endif
-# if defined(PARALLEL_MARK)
-    GC_ASSERT(0 == GC_fl_builder_count);
-# endif
+STATIC void GC_CALLBACK GC_freeze_block(struct hblk *h, GC_word dummy)
+{
+    UNUSED_ARG(dummy);
+    HDR(h) -> hb_flags |= FROZEN_BLK;
+}
 
+GC_INNER void GC_freeze_heap_blocks(void)
+{
+    GC_ASSERT(I_HOLD_LOCK());
+    GC_ASSERT(!GC_start_reclaim_pending);
+    /* The free objects of the frozen blocks are never allocated.       */
+    GC_clear_reclaim_and_free_lists(FALSE);
+    GC_apply_to_all_blocks(GC_freeze_block, 0);
+}
+
+GC_INNER GC_bool GC_continue_start_reclaim(GC_stop_func stop_func)
+{
+    struct hblk *h;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    if (!GC_start_reclaim_pending) return TRUE;
+    while ((h = GC_next_block(GC_start_reclaim_ptr, FALSE)) != NULL) {
+      hdr *hhdr = HDR(h);
+
+      GC_start_reclaim_ptr = h + OBJ_SZ_TO_BLOCKS(hhdr -> hb_sz);
+      /* Skip the blocks allocated since the walk has been started (the */
+      /* objects there are not marked but live).  Any other block has   */
+      /* not been swept in the current cycle yet.                       */
+      if (hhdr -> hb_last_reclaimed != (unsigned short)GC_gc_no)
+        GC_reclaim_block(h, FALSE);
+      if ((*stop_func)()) return FALSE;
+    }
+    GC_start_reclaim_pending = FALSE;
+    GC_complete_start_reclaim(FALSE);
+    return TRUE;
 }
 
 /*
@@ -741,6 +1540,13 @@ GC_INNER GC_bool GC_reclaim_all(GC_stop_func stop_func, GC_bool ignore_old)
         GET_TIME(start_time);
 #   endif
 
+    GC_finish_start_reclaim();
+
+#   ifdef PARALLEL_MARK
+      if (NULL == stop_func && GC_SHOULD_RECLAIM_IN_PARALLEL())
+        GC_reclaim_all_parallel(ignore_old, FALSE);
+        /* The rest (if any) is swept below.    */
+#   endif
     for (kind = 0; kind < GC_n_kinds; kind++) {
         ok = &(GC_obj_kinds[kind]);
         rlp = ok -> ok_reclaim_list;
@@ -812,17 +1618,20 @@ GC_INNER GC_bool GC_reclaim_all(GC_stop_func stop_func, GC_bool ignore_old)
 
 struct enumerate_reachable_s {
   GC_reachable_object_proc proc;
+  GC_reachable_object_par_proc par_proc; /* used instead of proc if set */
   void *client_data;
 };
 
-STATIC void GC_CALLBACK GC_do_enumerate_reachable_objects(struct hblk *hbp,
-                                                          GC_word ped)
+STATIC void GC_CALLBACK GC_do_enumerate_reachable_objects_par(
+                                struct hblk *hbp, unsigned worker, GC_word ped)
 {
   struct hblkhdr *hhdr = HDR(hbp);
   size_t sz = (size_t)hhdr->hb_sz;
   size_t bit_no;
   char *p, *plim;
+  struct enumerate_reachable_s *ed = (struct enumerate_reachable_s *)ped;
 
+  VALIDATE_MARKS(hhdr);
   if (GC_block_empty(hhdr)) {
     return;
   }
@@ -836,12 +1645,21 @@ STATIC void GC_CALLBACK GC_do_enumerate_reachable_objects(struct hblk *hbp,
   /* Go through all words in block. */
   for (bit_no = 0; p <= plim; bit_no += MARK_BIT_OFFSET(sz), p += sz) {
     if (mark_bit_from_hdr(hhdr, bit_no)) {
-      ((struct enumerate_reachable_s *)ped)->proc(p, sz,
-                        ((struct enumerate_reachable_s *)ped)->client_data);
+      if (ed->par_proc != 0) {
+        ed->par_proc(p, sz, worker, ed->client_data);
+      } else {
+        ed->proc(p, sz, ed->client_data);
+      }
     }
   }
 }
 
+STATIC void GC_CALLBACK GC_do_enumerate_reachable_objects(struct hblk *hbp,
+                                                          GC_word ped)
+{
+  GC_do_enumerate_reachable_objects_par(hbp, 0, ped);
+}
+
 GC_API void GC_CALL GC_enumerate_reachable_objects_inner(
                                                 GC_reachable_object_proc proc,
                                                 void *client_data)
@@ -850,6 +1668,21 @@ GC_API void GC_CALL GC_enumerate_reachable_objects_inner(
 
   GC_ASSERT(I_HOLD_LOCK());
   ed.proc = proc;
+  ed.par_proc = 0;
   ed.client_data = client_data;
   GC_apply_to_all_blocks(GC_do_enumerate_reachable_objects, (word)&ed);
 }
+
+GC_API void GC_CALL GC_enumerate_reachable_objects_parallel_inner(
+                                        GC_reachable_object_par_proc proc,
+                                        void *client_data)
+{
+  struct enumerate_reachable_s ed;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  ed.proc = 0;
+  ed.par_proc = proc;
+  ed.client_data = client_data;
+  GC_apply_to_all_blocks_parallel(GC_do_enumerate_reachable_objects_par,
+                                  (word)&ed);
+}
@@ -28,6 +28,13 @@
 #include <string.h>
 
 #include "gc/gc_allocator.h"
+#include "gc/gc_inline.h" // for GC_I_PTRFREE
+#include "gc/gc_layout.h"
+
+#if !defined(GC_NO_FINALIZATION) && !defined(GC_EPHEMERONS_NOT_NEEDED)
+# include "gc/gc_weak_map.h"
+# define WEAK_MAP_TEST
+#endif
 
 # include "private/gcconfig.h"
 
@@ -233,6 +240,146 @@ class F: public E {public:
 int F::nFreedF = 0;
 int F::nAllocatedF = 0;
 
+struct L {
+    GC_word value;
+    L *next;
+};
+
+typedef gc_layout<GC_LAYOUT_BIT(L, next)> L_layout;
+
+L *NewList( int n ) {
+    L *head = 0;
+
+    for (int i = 0; i < n; i++) {
+        L *l = static_cast<L *>(L_layout::allocate(sizeof(L)));
+
+        if (!l) {
+          GC_printf("Out of memory!\n");
+          exit(3);
+        }
+        my_assert(0 == l->value && 0 == l->next);
+        l->value = static_cast<GC_word>(i);
+        GC_PTR_STORE_AND_DIRTY(&l->next, head);
+        head = l;
+    }
+    return head;
+}
+
+void TestList( L *head, int n ) {
+    for (int i = n - 1; i >= 0; i--) {
+        my_assert(head->value == static_cast<GC_word>(i));
+        head = head->next;
+    }
+    my_assert(0 == head);
+}
+
+
+#ifdef WEAK_MAP_TEST
+  void TestWeakMap() {
+    gc_weak_map<GC_word, GC_word> map;
+    GC_word *keys[100];
+
+    for (int i = 0; i < 1000; i++) {
+        GC_word *key = static_cast<GC_word *>(GC_MALLOC(sizeof(GC_word)));
+        GC_word *value = static_cast<GC_word *>(
+                                GC_MALLOC(2 * sizeof(GC_word)));
+
+        if (!key || !value) {
+          GC_printf("Out of memory!\n");
+          exit(3);
+        }
+        *key = static_cast<GC_word>(i);
+        value[0] = static_cast<GC_word>(i);
+        GC_PTR_STORE_AND_DIRTY(&value[1], key); /* refers back to the key */
+        my_assert(map.insert(key, value) == value);
+        if (i < 100) keys[i] = key;
+    }
+    GC_gcollect();
+    for (int i = 0; i < 100; i++) {
+        GC_word *value = map.find(keys[i]);
+
+        my_assert(value != 0 && value[0] == static_cast<GC_word>(i)
+                  && reinterpret_cast<GC_word *>(value[1]) == keys[i]);
+        my_assert(map.insert(keys[i], keys[i]) == value);
+    }
+    my_assert(map.erase(keys[0]) && 0 == map.find(keys[0]));
+    my_assert(!map.erase(keys[0]));
+  }
+#endif
+
+#ifdef GC_POINTER_FREE_CLASS
+  enum Color { RED, GREEN };
+
+  struct P {
+    GC_POINTER_FREE_CLASS();
+    double x, y;
+  };
+
+  template <class T>
+  void CheckPtrFreeAlloc(int expected_kind) {
+    T *p = gc_allocator<T>().allocate(10);
+
+    my_assert(GC_get_kind_and_size(p, 0) == expected_kind);
+    gc_allocator<T>().deallocate(p, 10);
+  }
+
+  void TestPtrFreeTraits() {
+#   ifndef GC_DEBUG
+      CheckPtrFreeAlloc<Color>(GC_I_PTRFREE);
+      CheckPtrFreeAlloc<P>(GC_I_PTRFREE);
+      CheckPtrFreeAlloc<bool>(GC_I_PTRFREE);
+      CheckPtrFreeAlloc<long long[3]>(GC_I_PTRFREE);
+      CheckPtrFreeAlloc<L>(GC_I_NORMAL);
+      CheckPtrFreeAlloc<P *>(GC_I_NORMAL);
+#   endif
+  }
+#endif
+
+#ifdef GC_ALIGNED_NEW
+  struct alignas(256) G: public GC_NS_QUALIFY(gc) {
+    GC_word value;
+  };
+
+  void TestAlignedNew() {
+    for (int i = 0; i < 100; i++) {
+        G *g = new G;
+        G *h = new (GC_NS_QUALIFY(NoGC)) G;
+        G *ga = new (GC_NS_QUALIFY(PointerFreeGC)) G[3];
+
+        my_assert(0 == reinterpret_cast<GC_word>(g) % 256
+                  && 0 == reinterpret_cast<GC_word>(h) % 256
+                  && 0 == reinterpret_cast<GC_word>(ga) % 256);
+        h->value = static_cast<GC_word>(i);
+        delete h;
+        delete[] ga;
+        if (0 == i % 10) delete g;
+    }
+  }
+#endif
+
+#ifdef GC_MEMORY_RESOURCE
+  void TestMemoryResource() {
+    gc_memory_resource res;
+    gc_atomic_memory_resource atomic_res;
+    void *p = atomic_res.allocate(100, 64);
+
+    my_assert(0 == reinterpret_cast<GC_word>(p) % 64);
+    atomic_res.deallocate(p, 100, 64);
+    {
+      std::pmr::monotonic_buffer_resource buf(&res);
+      GC_word **ptrs = static_cast<GC_word **>(
+                                buf.allocate(100 * sizeof(GC_word *)));
+
+      for (int i = 0; i < 100; i++) {
+        ptrs[i] = static_cast<GC_word *>(buf.allocate(sizeof(GC_word)));
+        *ptrs[i] = static_cast<GC_word>(i);
+      }
+      GC_gcollect();
+      for (int i = 0; i < 100; i++)
+        my_assert(*ptrs[i] == static_cast<GC_word>(i));
+    }
+  }
+#endif
 
 GC_word Disguise( void* p ) {
     return GC_HIDE_POINTER(p);
@@ -328,6 +475,7 @@ void* Undisguise( GC_word i ) {
     }
     GC_PTR_STORE_AND_DIRTY(xptr, x);
     x = 0;
+    L *lhead = NewList(1000);
     if (argc != 2
         || (n = atoi(argv[1])) <= 0) {
       GC_printf("usage: cpptest <number-of-iterations>\n"
@@ -419,6 +567,19 @@ void* Undisguise( GC_word i ) {
 
     x = *xptr;
     my_assert(29 == x[0]);
+    TestList(lhead, 1000);
+#   ifdef WEAK_MAP_TEST
+      TestWeakMap();
+#   endif
+#   ifdef GC_POINTER_FREE_CLASS
+      TestPtrFreeTraits();
+#   endif
+#   ifdef GC_ALIGNED_NEW
+      TestAlignedNew();
+#   endif
+#   ifdef GC_MEMORY_RESOURCE
+      TestMemoryResource();
+#   endif
     GC_printf("The test appears to have succeeded.\n");
     return 0;
 }
@@ -40,6 +40,8 @@
 # define rand() GC_RAND_NEXT(&seed)
 #endif /* GC_PTHREADS || LINT2 */
 
+#include "gc/gc_mark.h" /* for GC_new_kind */
+
 #define my_assert(e) \
     if (!(e)) { \
         fflush(stdout); \
@@ -86,6 +88,49 @@ void test_misc_sizes(void)
     }
 }
 
+#define BATCH_MAGIC ((GC_word)0x5a5a5a5a)
+
+static int batch_kind;
+static volatile unsigned batch_disclaimed;
+
+void GC_CALLBACK batch_dct(void **objs, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        /* Only the flagged objects are passed. */
+        my_assert(*(GC_word *)objs[i] == BATCH_MAGIC);
+        *(GC_word *)objs[i] = 0;
+    }
+    batch_disclaimed += (unsigned)n;
+}
+
+void test_disclaim_batch(void)
+{
+    int i;
+
+    batch_kind = (int)GC_new_kind(GC_new_free_list(), GC_DS_LENGTH, 1, 1);
+    GC_register_disclaim_batch_proc(batch_kind, batch_dct, 0);
+    for (i = 0; i < 1000; ++i) {
+        GC_word *p = (GC_word *)GC_generic_malloc(2 * sizeof(GC_word),
+                                                  batch_kind);
+
+        if (p == NULL) {
+            fprintf(stderr, "Out of memory!\n");
+            exit(3);
+        }
+        if (i % 2 == 0) {
+            p[0] = BATCH_MAGIC;
+            GC_set_disclaim_needed(p);
+        }
+    }
+    for (i = 0; i < 4; ++i)
+        GC_gcollect();
+    my_assert(batch_disclaimed <= 500);
+    if (batch_disclaimed == 0)
+        fprintf(stderr, "No batch-disclaimed objects!\n");
+}
+
 typedef struct pair_s *pair_t;
 
 struct pair_s {
@@ -244,6 +289,8 @@ int main(void)
         printf("This test program is not designed for leak detection mode\n");
 
     test_misc_sizes();
+    if (!GC_get_find_leak())
+        test_disclaim_batch();
 
 # if NTHREADS > 0
     printf("Threaded disclaim test.\n");
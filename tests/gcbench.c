@@ -0,0 +1,536 @@
+/*
+ * Copyright (c) 2023 Ivan Maidanski
+ *
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose, provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/* A suite of reproducible collector workloads: the small objects       */
+/* allocation throughput (per the number of threads), the binary trees  */
+/* (GCBench), the large objects churn, the marking of pointer-dense and */
+/* pointer-sparse heaps, the finalizer-heavy and the weak-link-heavy    */
+/* scenarios.  Each scenario is reported in a single line of the form:  */
+/*   BENCH name=<scenario> threads=<n> ops=<n> time_ms=<n>              */
+/*         ops_per_sec=<n> gc_count=<n> pauses=<n> pause_p50_us=<n>     */
+/*         pause_p90_us=<n> pause_p99_us=<n> pause_max_us=<n>           */
+/*         heap_kib=<n> peak_rss_kib=<n>                                */
+/* (the pause percentiles are the upper bounds of the histogram buckets */
+/* of the world-stopped pauses, see GC_get_pause_stats; the peak RSS is */
+/* of the whole process so far, 0 if unknown).  Usage:                  */
+/*   gcbench [<scale>] [<scenario>...]                                  */
+/* where the amount of work is multiplied by scale (1 by default), and  */
+/* only the given scenarios are run (all by default).                   */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_CONFIG_H
+  /* For GC_[P]THREADS */
+# include "config.h"
+#endif
+
+#undef GC_NO_THREAD_REDIRECTS
+#include "gc.h"
+
+#define NOT_GCBUILD
+#include "private/gc_priv.h"
+
+#ifdef UNIX_LIKE
+# include <sys/resource.h>
+#endif
+
+#ifdef GC_PTHREADS
+# ifndef MAX_NTHREADS
+#   define MAX_NTHREADS 4
+# endif
+# include <pthread.h>
+#else
+# undef MAX_NTHREADS
+# define MAX_NTHREADS 1
+#endif
+
+#define CHECK_OUT_OF_MEMORY(p) \
+    do { \
+      if (NULL == (p)) { \
+        fprintf(stderr, "Out of memory\n"); \
+        exit(69); \
+      } \
+    } while (0)
+
+static unsigned scale = 1;
+
+#ifndef NO_CLOCK
+  static CLOCK_TYPE start_time;
+#endif
+static GC_word start_gc_no;
+
+static void bench_begin(void)
+{
+  GC_gcollect();
+# ifndef NO_CLOCK
+    GC_get_pause_stats(NULL, 1 /* reset */);
+# endif
+  start_gc_no = GC_get_gc_no();
+# ifndef NO_CLOCK
+    GET_TIME(start_time);
+# endif
+}
+
+#ifndef NO_CLOCK
+  /* Return the upper bound (in microseconds) of the given percentile   */
+  /* of the pauses recorded in the histogram.                           */
+  static unsigned long pause_percentile(const struct GC_pause_stats_s *ps,
+                                        unsigned percent)
+  {
+    GC_word cnt = 0;
+    GC_word max_us = ps -> max_pause_ns / 1000;
+    int i;
+
+    if (0 == ps -> n_pauses) return 0;
+    for (i = 0; i < GC_PAUSE_HIST_BUCKETS - 1; i++) {
+      cnt += ps -> histogram[i];
+      if (cnt * 100 >= ps -> n_pauses * percent) {
+        GC_word upper_us = GC_PAUSE_BUCKET_LOWER_US(i + 1);
+
+        return (unsigned long)(upper_us < max_us ? upper_us : max_us);
+      }
+    }
+    return (unsigned long)max_us;
+  }
+#endif /* !NO_CLOCK */
+
+static unsigned long peak_rss_kib(void)
+{
+# ifdef UNIX_LIKE
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+#     ifdef DARWIN
+        return (unsigned long)(ru.ru_maxrss >> 10); /* in bytes */
+#     else
+        return (unsigned long)ru.ru_maxrss;
+#     endif
+    }
+# endif
+  return 0;
+}
+
+static void bench_end(const char *name, int nthreads, unsigned long ops)
+{
+  unsigned long time_ms = 0;
+  unsigned long ops_per_sec = 0;
+  struct GC_pause_stats_s ps;
+
+  memset(&ps, 0, sizeof(ps));
+# ifndef NO_CLOCK
+    {
+      CLOCK_TYPE tF;
+      unsigned long time_us;
+
+      GET_TIME(tF);
+      time_ms = MS_TIME_DIFF(tF, start_time);
+      time_us = time_ms * 1000 + NS_FRAC_TIME_DIFF(tF, start_time) / 1000;
+      if (time_us > 0)
+        ops_per_sec = (unsigned long)((double)ops * 1e6 / (double)time_us);
+      GC_get_pause_stats(&ps, 0);
+    }
+# endif
+  printf("BENCH name=%s threads=%d ops=%lu time_ms=%lu ops_per_sec=%lu"
+         " gc_count=%lu pauses=%lu", name, nthreads, ops, time_ms,
+         ops_per_sec, (unsigned long)(GC_get_gc_no() - start_gc_no),
+         (unsigned long)ps.n_pauses);
+# ifndef NO_CLOCK
+    printf(" pause_p50_us=%lu pause_p90_us=%lu pause_p99_us=%lu"
+           " pause_max_us=%lu", pause_percentile(&ps, 50),
+           pause_percentile(&ps, 90), pause_percentile(&ps, 99),
+           (unsigned long)(ps.max_pause_ns / 1000));
+# endif
+  printf(" heap_kib=%lu peak_rss_kib=%lu\n",
+         (unsigned long)(GC_get_heap_size() >> 10), peak_rss_kib());
+  fflush(stdout);
+}
+
+struct list_s {
+  struct list_s *next;
+  GC_word value;
+};
+
+/* The small objects allocation: each thread keeps a window of the      */
+/* recently allocated (short-lived) list nodes of various sizes.        */
+#define SMALL_ALLOC_CNT 2000000
+#define SMALL_WINDOW 1024
+
+static void *small_alloc_thread(void *arg)
+{
+  unsigned long n = (unsigned long)(GC_word)arg;
+  struct list_s *head = NULL;
+  struct list_s *tail = NULL;
+  unsigned long i;
+
+  for (i = 0; i < n; i++) {
+    size_t lb = sizeof(struct list_s) + (i % 7) * sizeof(GC_word);
+    struct list_s *p = (struct list_s *)GC_MALLOC(lb);
+
+    CHECK_OUT_OF_MEMORY(p);
+    p -> value = i;
+    if (NULL == tail) {
+      head = p;
+    } else {
+      tail -> next = p;
+    }
+    tail = p;
+    if (i >= SMALL_WINDOW)
+      head = head -> next; /* drop the oldest one */
+  }
+  return head;
+}
+
+static void bench_small_alloc(void)
+{
+  int nthreads;
+
+  for (nthreads = 1; nthreads <= MAX_NTHREADS; nthreads *= 2) {
+    unsigned long per_thread = SMALL_ALLOC_CNT * (unsigned long)scale
+                                / (unsigned long)nthreads;
+#   ifdef GC_PTHREADS
+      pthread_t th[MAX_NTHREADS];
+      int i;
+#   endif
+
+    bench_begin();
+#   ifdef GC_PTHREADS
+      for (i = 1; i < nthreads; i++) {
+        int err = pthread_create(&th[i], NULL, small_alloc_thread,
+                                 (void *)(GC_word)per_thread);
+
+        if (err != 0) {
+          fprintf(stderr, "Thread creation failed: %s\n", strerror(err));
+          exit(1);
+        }
+      }
+#   endif
+    (void)small_alloc_thread((void *)(GC_word)per_thread);
+#   ifdef GC_PTHREADS
+      for (i = 1; i < nthreads; i++) {
+        int err = pthread_join(th[i], NULL);
+
+        if (err != 0) {
+          fprintf(stderr, "Thread join failed: %s\n", strerror(err));
+          exit(69);
+        }
+      }
+#   endif
+    bench_end("small_alloc", nthreads, per_thread * (unsigned long)nthreads);
+  }
+}
+
+/* The binary trees benchmark (after GCBench by John Ellis and Pete     */
+/* Kovac): a long-lived tree and array, while many trees of various     */
+/* depths are built top-down and bottom-up, and then dropped.           */
+#define STRETCH_TREE_DEPTH 16
+#define LONG_LIVED_TREE_DEPTH 14
+#define MIN_TREE_DEPTH 4
+#define MAX_TREE_DEPTH 14
+#define LONG_LIVED_ARRAY_SIZE 500000
+
+struct node_s {
+  struct node_s *left;
+  struct node_s *right;
+  GC_word i, j;
+};
+
+static unsigned long tree_nodes_cnt;
+
+static struct node_s *new_node(struct node_s *left, struct node_s *right)
+{
+  struct node_s *p = GC_NEW(struct node_s);
+
+  CHECK_OUT_OF_MEMORY(p);
+  p -> left = left;
+  p -> right = right;
+  GC_END_STUBBORN_CHANGE(p);
+  GC_reachable_here(left);
+  GC_reachable_here(right);
+  tree_nodes_cnt++;
+  return p;
+}
+
+static int tree_size(int depth)
+{
+  return (1 << (depth + 1)) - 1;
+}
+
+static void populate(int depth, struct node_s *p)
+{
+  if (depth <= 0) return;
+  depth--;
+  p -> left = new_node(NULL, NULL);
+  p -> right = new_node(NULL, NULL);
+  GC_END_STUBBORN_CHANGE(p);
+  populate(depth, p -> left);
+  populate(depth, p -> right);
+}
+
+static struct node_s *make_tree(int depth)
+{
+  if (depth <= 0) return new_node(NULL, NULL);
+  return new_node(make_tree(depth - 1), make_tree(depth - 1));
+}
+
+static void bench_binary_trees(void)
+{
+  struct node_s *long_lived;
+  double *arr;
+  int d, i;
+
+  tree_nodes_cnt = 0;
+  bench_begin();
+  (void)make_tree(STRETCH_TREE_DEPTH);
+  long_lived = new_node(NULL, NULL);
+  populate(LONG_LIVED_TREE_DEPTH, long_lived);
+  arr = (double *)GC_MALLOC_ATOMIC(sizeof(double) * LONG_LIVED_ARRAY_SIZE);
+  CHECK_OUT_OF_MEMORY(arr);
+  for (i = 0; i < LONG_LIVED_ARRAY_SIZE; i++)
+    arr[i] = 1.0 / (double)(i + 1);
+
+  for (d = MIN_TREE_DEPTH; d <= MAX_TREE_DEPTH; d += 2) {
+    int iters = 2 * tree_size(STRETCH_TREE_DEPTH) / tree_size(d)
+                * (int)scale;
+
+    for (i = 0; i < iters; i++) {
+      struct node_s *p = new_node(NULL, NULL);
+
+      populate(d, p); /* top-down */
+      (void)make_tree(d); /* bottom-up */
+    }
+  }
+  if (NULL == long_lived -> left || arr[1000] != 1.0 / 1001) {
+    fprintf(stderr, "Long-lived data is damaged\n");
+    exit(1);
+  }
+  GC_reachable_here(long_lived);
+  GC_reachable_here(arr);
+  bench_end("binary_trees", 1, tree_nodes_cnt);
+}
+
+/* A simple LCG (the private GC_RAND_NEXT is not available in the      */
+/* single-threaded build).  Returns a value in [0, 2^30).               */
+static unsigned long bench_rand(unsigned long *pseed)
+{
+  unsigned long hi;
+
+  *pseed = (*pseed * 1103515245UL + 12345) & 0xffffffffUL;
+  hi = (*pseed >> 16) & 0x7fff;
+  *pseed = (*pseed * 1103515245UL + 12345) & 0xffffffffUL;
+  return (hi << 15) | ((*pseed >> 16) & 0x7fff);
+}
+
+/* The large objects churn: the objects of random sizes (64 KiB up to   */
+/* 1 MiB) replace each other in a small set of the live ones.           */
+#define LARGE_ALLOC_CNT 2000
+#define LARGE_KEEP_CNT 16
+
+static void bench_large_churn(void)
+{
+  unsigned long seed = 17;
+  void **keep_arr = (void **)GC_MALLOC(sizeof(void *) * LARGE_KEEP_CNT);
+  unsigned long i, n = LARGE_ALLOC_CNT * (unsigned long)scale;
+
+  CHECK_OUT_OF_MEMORY(keep_arr);
+  bench_begin();
+  for (i = 0; i < n; i++) {
+    size_t lg = 16 + (size_t)bench_rand(&seed) % 4;
+    size_t lb = ((size_t)1 << lg)
+                + (size_t)bench_rand(&seed) % ((size_t)1 << lg);
+    char *p = (char *)(i % 8 != 0 ? GC_MALLOC_ATOMIC(lb) : GC_MALLOC(lb));
+
+    CHECK_OUT_OF_MEMORY(p);
+    p[0] = p[lb - 1] = (char)i;
+    keep_arr[bench_rand(&seed) % LARGE_KEEP_CNT] = p;
+  }
+  bench_end("large_churn", 1, n);
+  GC_reachable_here(keep_arr);
+}
+
+/* The marking of a live heap (about 8 MiB) which consists either of    */
+/* the pointer-full objects referencing each other (pointer-dense) or   */
+/* of the pointer-free ones held by a few arrays (pointer-sparse).      */
+/* The operations are the full collections.                             */
+#define MARK_HEAP_OBJS (1 << 17)
+#define MARK_OBJ_WORDS 8
+#define MARK_GC_CNT 10
+
+static void bench_mark(int dense)
+{
+  GC_word **objs = (GC_word **)GC_MALLOC(sizeof(GC_word *)
+                                         * MARK_HEAP_OBJS);
+  unsigned long seed = 31;
+  unsigned long i, n = MARK_GC_CNT * (unsigned long)scale;
+
+  CHECK_OUT_OF_MEMORY(objs);
+  for (i = 0; i < MARK_HEAP_OBJS; i++) {
+    objs[i] = (GC_word *)(dense ? GC_MALLOC(sizeof(GC_word) * MARK_OBJ_WORDS)
+                          : GC_MALLOC_ATOMIC(sizeof(GC_word)
+                                             * MARK_OBJ_WORDS));
+    CHECK_OUT_OF_MEMORY(objs[i]);
+  }
+  if (dense) {
+    /* Link each object to a few random others.     */
+    for (i = 0; i < MARK_HEAP_OBJS; i++) {
+      int j;
+
+      for (j = 0; j < MARK_OBJ_WORDS; j++)
+        objs[i][j] = (GC_word)objs[bench_rand(&seed) % MARK_HEAP_OBJS];
+      GC_END_STUBBORN_CHANGE(objs[i]);
+    }
+  } else {
+    for (i = 0; i < MARK_HEAP_OBJS; i++)
+      memset(objs[i], 0xA5, sizeof(GC_word) * MARK_OBJ_WORDS);
+  }
+
+  bench_begin();
+  for (i = 0; i < n; i++)
+    GC_gcollect();
+  bench_end(dense ? "mark_dense" : "mark_sparse", 1, n);
+  GC_reachable_here(objs);
+}
+
+static void bench_mark_dense(void)
+{
+  bench_mark(1);
+}
+
+static void bench_mark_sparse(void)
+{
+  bench_mark(0);
+}
+
+/* The finalizer-heavy scenario: every allocated object has a (no-      */
+/* order) finalizer which is run once the object becomes unreachable.   */
+#define FNLZ_OBJ_CNT 200000
+
+static unsigned long finalized_cnt;
+
+static void GC_CALLBACK count_finalizer(void *obj, void *client_data)
+{
+  UNUSED_ARG(obj);
+  UNUSED_ARG(client_data);
+  finalized_cnt++;
+}
+
+static void bench_finalizers(void)
+{
+  unsigned long i, n = FNLZ_OBJ_CNT * (unsigned long)scale;
+
+  finalized_cnt = 0;
+  bench_begin();
+  for (i = 0; i < n; i++) {
+    void *p = GC_MALLOC(sizeof(struct list_s));
+
+    CHECK_OUT_OF_MEMORY(p);
+    GC_REGISTER_FINALIZER_NO_ORDER(p, count_finalizer, NULL, NULL, NULL);
+  }
+  for (i = 0; i < 4 && finalized_cnt < n / 2; i++) {
+    GC_gcollect();
+    (void)GC_invoke_finalizers();
+  }
+  bench_end("finalizers", 1, n);
+  if (0 == finalized_cnt && !GC_get_find_leak()) {
+    fprintf(stderr, "No finalizer has been run\n");
+    exit(1);
+  }
+}
+
+/* The weak-link-heavy scenario: every allocated object is referenced   */
+/* by a disappearing link, half of the objects are kept reachable.      */
+#define WEAK_OBJ_CNT 200000
+
+static void bench_weak_links(void)
+{
+  unsigned long i, cleared = 0;
+  unsigned long n = WEAK_OBJ_CNT * (unsigned long)scale;
+  void **links = (void **)GC_MALLOC_ATOMIC(sizeof(void *) * n);
+  void **strong = (void **)GC_MALLOC(sizeof(void *) * (n / 2 + 1));
+
+  CHECK_OUT_OF_MEMORY(links);
+  CHECK_OUT_OF_MEMORY(strong);
+  bench_begin();
+  for (i = 0; i < n; i++) {
+    void *p = GC_MALLOC(sizeof(struct list_s));
+
+    CHECK_OUT_OF_MEMORY(p);
+    links[i] = p; /* the links are not traced */
+    if (GC_GENERAL_REGISTER_DISAPPEARING_LINK(&links[i], p) != GC_SUCCESS) {
+      fprintf(stderr, "Cannot register disappearing link\n");
+      exit(69);
+    }
+    if (i % 2 == 0) strong[i / 2] = p;
+  }
+  GC_gcollect();
+  for (i = 0; i < n; i++) {
+    if (NULL == links[i]) {
+      cleared++;
+    } else {
+      (void)GC_unregister_disappearing_link(&links[i]);
+    }
+  }
+  bench_end("weak_links", 1, n);
+  if (cleared > n / 2) {
+    fprintf(stderr, "Link to a reachable object is cleared\n");
+    exit(1);
+  }
+  GC_reachable_here(strong);
+}
+
+static const struct {
+  const char *name;
+  void (*fn)(void);
+} scenarios[] = {
+  { "small_alloc", bench_small_alloc },
+  { "binary_trees", bench_binary_trees },
+  { "large_churn", bench_large_churn },
+  { "mark_dense", bench_mark_dense },
+  { "mark_sparse", bench_mark_sparse },
+  { "finalizers", bench_finalizers },
+  { "weak_links", bench_weak_links }
+};
+
+#define N_SCENARIOS (sizeof(scenarios) / sizeof(scenarios[0]))
+
+int main(int argc, char **argv)
+{
+  int argi = 1;
+  size_t k;
+
+  if (argc > 1 && argv[1][0] >= '0' && argv[1][0] <= '9') {
+    scale = (unsigned)atoi(argv[1]);
+    if (0 == scale) scale = 1;
+    argi++;
+  }
+  GC_INIT();
+  if (GC_get_find_leak())
+    printf("This test program is not designed for leak detection mode\n");
+# ifndef NO_CLOCK
+    GC_start_performance_measurement();
+# endif
+
+  for (k = 0; k < N_SCENARIOS; k++) {
+    if (argi < argc) {
+      int i;
+
+      for (i = argi; i < argc; i++) {
+        if (strcmp(argv[i], scenarios[k].name) == 0) break;
+      }
+      if (i == argc) continue;
+    }
+    scenarios[k].fn();
+  }
+  return 0;
+}
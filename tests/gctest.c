@@ -993,6 +993,9 @@ tn * mktree(int n)
 #   endif
     if (0 == n) return NULL;
     CHECK_OUT_OF_MEMORY(result);
+#   ifdef GC_PTHREADS
+      GC_SAFEPOINT(); /* effective if GC_COOPERATIVE_SUSPEND is set */
+#   endif
     result -> level = n;
     result -> lchild = left = mktree(n - 1);
     result -> rchild = right = mktree(n - 1);
@@ -1173,6 +1176,7 @@ void * alloc8bytes(void)
 #endif
 
 #include "gc/gc_inline.h"
+#include "gc/gc_cref.h"
 
 void test_tinyfl(void)
 {
@@ -1189,6 +1193,330 @@ void test_tinyfl(void)
   GC_CONS(results[2], results[0], results[1], tfls[2]);
 }
 
+/* Allocate a list of objects of a client-defined kind (using the      */
+/* thread-local free lists of the kind, if available), and check it    */
+/* after a collection.                                                  */
+#define KIND_TEST_LIST_LEN 2000
+
+static int test_kind = -1; /* protected by the allocation lock */
+
+static void * GC_CALLBACK init_test_kind(void *arg)
+{
+  UNUSED_ARG(arg);
+  if (test_kind < 0)
+    test_kind = (int)GC_new_kind_inner(GC_new_free_list_inner(),
+                                       GC_DS_LENGTH, 1 /* adjust */,
+                                       1 /* clear */);
+  return NULL;
+}
+
+void kind_test(void)
+{
+  GC_word *head = NULL;
+  GC_word *p;
+  int kind;
+  int i;
+
+  (void)GC_call_with_alloc_lock(init_test_kind, NULL);
+  kind = test_kind;
+  /* The list below is linked only by the pointers to object bases.     */
+  GC_set_kind_exact_base((unsigned)kind, 1);
+  if (!GC_get_kind_exact_base((unsigned)kind)) {
+    GC_printf("GC_get_kind_exact_base failed\n");
+    FAIL;
+  }
+  for (i = 0; i < KIND_TEST_LIST_LEN; i++) {
+    p = (GC_word *)GC_malloc_kind(2 * sizeof(GC_word), kind);
+    CHECK_OUT_OF_MEMORY(p);
+    if (p[0] != 0 || p[1] != 0) {
+      GC_printf("GC_malloc_kind returned a non-cleared object\n");
+      FAIL;
+    }
+    p[0] = (GC_word)head;
+    p[1] = (GC_word)i;
+    GC_END_STUBBORN_CHANGE(p);
+    head = p;
+  }
+  GC_gcollect();
+  for (p = head, i = KIND_TEST_LIST_LEN - 1; p != NULL;
+       p = (GC_word *)p[0], i--) {
+    if (p[1] != (GC_word)i || GC_get_kind_and_size(p, NULL) != kind) {
+      GC_printf("Lost an object of a client-defined kind\n");
+      FAIL;
+    }
+  }
+  if (i != -1) {
+    GC_printf("Wrong length of the client-defined kind list\n");
+    FAIL;
+  }
+}
+
+/* Build a list of objects allocated with the long-lived hint, and     */
+/* check it after a collection.                                         */
+void long_lived_test(void)
+{
+  GC_word *head = NULL;
+  GC_word *p;
+  int kind = -1;
+  int i;
+
+  for (i = 0; i < KIND_TEST_LIST_LEN; i++) {
+    p = (GC_word *)GC_malloc_kind_hint(2 * sizeof(GC_word), GC_I_NORMAL,
+                                       GC_HINT_LONG_LIVED);
+    CHECK_OUT_OF_MEMORY(p);
+    if (p[0] != 0 || p[1] != 0) {
+      GC_printf("GC_malloc_kind_hint returned a non-cleared object\n");
+      FAIL;
+    }
+    if (kind != -1 && GC_get_kind_and_size(p, NULL) != kind) {
+      GC_printf("Long-lived objects are of different kinds\n");
+      FAIL;
+    }
+    kind = GC_get_kind_and_size(p, NULL);
+    p[0] = (GC_word)head;
+    p[1] = (GC_word)i;
+    GC_END_STUBBORN_CHANGE(p);
+    head = p;
+  }
+  GC_gcollect();
+  for (p = head, i = KIND_TEST_LIST_LEN - 1; p != NULL;
+       p = (GC_word *)p[0], i--) {
+    if (p[1] != (GC_word)i) {
+      GC_printf("Lost a long-lived object\n");
+      FAIL;
+    }
+  }
+}
+
+#define FREE_REUSE_CNT 100
+#define FREE_REUSE_SZ 600 /* bytes, bigger than the thread-local ones */
+
+/* Deallocate some objects explicitly, then allocate as many objects of */
+/* the same size from the global free lists (thus likely reusing the    */
+/* deallocated ones), check they are cleared and survive a collection.  */
+void free_reuse_test(void)
+{
+  GC_word *head = NULL;
+  GC_word *p;
+  size_t j;
+  int i;
+
+  for (i = 0; i < FREE_REUSE_CNT; i++) {
+    p = (GC_word *)GC_malloc(FREE_REUSE_SZ);
+    CHECK_OUT_OF_MEMORY(p);
+    for (j = 0; j < FREE_REUSE_SZ / sizeof(GC_word); j++)
+      p[j] = ~(GC_word)j;
+    GC_free(p);
+  }
+  for (i = 0; i < FREE_REUSE_CNT; i++) {
+    p = (GC_word *)GC_malloc_kind_global(FREE_REUSE_SZ, GC_I_NORMAL);
+    CHECK_OUT_OF_MEMORY(p);
+    for (j = 0; j < FREE_REUSE_SZ / sizeof(GC_word); j++) {
+      if (p[j] != 0) {
+        GC_printf("GC_malloc_kind_global returned a non-cleared object\n");
+        FAIL;
+      }
+    }
+    p[0] = (GC_word)head;
+    p[1] = (GC_word)i;
+    GC_END_STUBBORN_CHANGE(p);
+    head = p;
+  }
+  GC_gcollect();
+  for (p = head, i = FREE_REUSE_CNT - 1; p != NULL;
+       p = (GC_word *)p[0], i--) {
+    if (p[1] != (GC_word)i) {
+      GC_printf("Lost an object allocated after GC_free\n");
+      FAIL;
+    }
+  }
+  if (i != -1) {
+    GC_printf("Wrong length of the list allocated after GC_free\n");
+    FAIL;
+  }
+}
+
+#define LIFETIME_TEST_CNT 8
+
+static GC_word lifetime_n_freed(void)
+{
+  size_t i, n = GC_get_lifetime_stats(NULL, 0);
+  struct GC_lifetime_stats_s *stats = (struct GC_lifetime_stats_s *)
+                malloc((n + 1) * sizeof(struct GC_lifetime_stats_s));
+  GC_word res = 0;
+
+  CHECK_OUT_OF_MEMORY(stats);
+  n = GC_get_lifetime_stats(stats, n); /* no new classes are expected */
+  for (i = 0; i < n; i++)
+    res += stats[i].n_freed;
+  free(stats);
+  return res;
+}
+
+/* Check the objects sampled by the lifetime sampler and deallocated    */
+/* by GC_free_n are counted as freed (i.e. their samples are dropped).  */
+/* Should be called when no other thread allocates or frees objects.    */
+void lifetime_free_n_test(void)
+{
+  void *ptrs[LIFETIME_TEST_CNT];
+  unsigned old_interval = GC_get_lifetime_sampling();
+  GC_word n_freed;
+  int i;
+
+  GC_set_lifetime_sampling(1);
+  if (GC_get_lifetime_sampling() != 1) return; /* not supported */
+  for (i = 0; i < LIFETIME_TEST_CNT; i++) {
+    /* A large object is allocated in the slow path, thus sampled.      */
+    ptrs[i] = GC_malloc(2 * GC_get_hblk_size());
+    CHECK_OUT_OF_MEMORY(ptrs[i]);
+  }
+  n_freed = lifetime_n_freed();
+  GC_free_n(ptrs, LIFETIME_TEST_CNT);
+  if (lifetime_n_freed() < n_freed + LIFETIME_TEST_CNT) {
+    GC_printf("Lifetime samples are not dropped by GC_free_n\n");
+    FAIL;
+  }
+  GC_set_lifetime_sampling(old_interval);
+}
+
+/* Allocate a list in a separate heap, and check the heap is used.     */
+void heap_test(void)
+{
+  static volatile AO_t heap_requested = 0;
+  static volatile AO_t shared_heap = 0; /* shared by all the test threads */
+  GC_heap_t heap;
+  GC_word *head = NULL;
+  GC_word *p;
+  char *s;
+  int i;
+
+  /* Only the first caller creates the heap (its kinds are created on   */
+  /* the first allocation, and the number of kinds is limited).         */
+  if (0 == AO_fetch_and_add1(&heap_requested))
+    AO_store_release(&shared_heap, (AO_t)GC_new_heap());
+  heap = (GC_heap_t)AO_load_acquire(&shared_heap);
+  if (NULL == heap) return; /* not created yet (by another thread) */
+  for (i = 0; i < KIND_TEST_LIST_LEN; i++) {
+    p = (GC_word *)GC_heap_malloc(heap, 2 * sizeof(GC_word));
+    CHECK_OUT_OF_MEMORY(p);
+    if (p[0] != 0 || p[1] != 0) {
+      GC_printf("GC_heap_malloc returned a non-cleared object\n");
+      FAIL;
+    }
+    p[0] = (GC_word)head;
+    p[1] = (GC_word)i;
+    GC_END_STUBBORN_CHANGE(p);
+    head = p;
+  }
+  s = (char *)GC_heap_malloc_atomic(heap, 100);
+  CHECK_OUT_OF_MEMORY(s);
+  if (GC_heap_get_size(heap) == 0) {
+    GC_printf("GC_heap_get_size returned zero\n");
+    FAIL;
+  }
+  GC_gcollect();
+  for (p = head, i = KIND_TEST_LIST_LEN - 1; p != NULL;
+       p = (GC_word *)p[0], i--) {
+    if (p[1] != (GC_word)i) {
+      GC_printf("Lost an object of a separate heap\n");
+      FAIL;
+    }
+  }
+  GC_reachable_here(s);
+}
+
+/* Build a list linked by compressed references (if available), and   */
+/* check it after a collection.                                         */
+void cref_test(void)
+{
+  GC_cref_t *head = NULL;
+  GC_cref_t *p;
+  int i;
+
+  if (!GC_cref_available()) return;
+  for (i = 0; i < KIND_TEST_LIST_LEN; i++) {
+    p = (GC_cref_t *)GC_cref_malloc(2 * sizeof(GC_cref_t));
+    CHECK_OUT_OF_MEMORY(p);
+    if (p[0] != 0 || GC_CREF_DECODE(GC_CREF_ENCODE(p)) != (void *)p) {
+      GC_printf("Bad compressed reference object\n");
+      FAIL;
+    }
+    p[0] = GC_CREF_ENCODE(head);
+    GC_END_STUBBORN_CHANGE(p);
+    head = p;
+  }
+  GC_gcollect();
+  /* A lost node, if any, is reused (cleared) by the allocation.       */
+  for (i = 0; i < KIND_TEST_LIST_LEN; i++)
+    CHECK_OUT_OF_MEMORY(GC_cref_malloc(2 * sizeof(GC_cref_t)));
+  for (i = 0; head != NULL; i++) {
+    head = (GC_cref_t *)GC_CREF_DECODE(head[0]);
+  }
+  if (i != KIND_TEST_LIST_LEN) {
+    GC_printf("Wrong length of the compressed references list\n");
+    FAIL;
+  }
+}
+
+#define PUSH_ROOTS_TEST_PARTS 4
+#define PUSH_ROOTS_TEST_PART_LEN 8
+
+struct GC_ms_entry * GC_CALLBACK push_hidden_roots(unsigned part,
+                                        struct GC_ms_entry *mark_stack_ptr,
+                                        struct GC_ms_entry *mark_stack_limit,
+                                        void *client_data)
+{
+  GC_hidden_pointer *h = (GC_hidden_pointer *)client_data
+                            + part * PUSH_ROOTS_TEST_PART_LEN;
+  int i;
+
+  for (i = 0; i < PUSH_ROOTS_TEST_PART_LEN; i++) {
+    mark_stack_ptr = GC_MARK_AND_PUSH(GC_REVEAL_POINTER(h[i]),
+                                      mark_stack_ptr, mark_stack_limit,
+                                      (void **)&h[i]);
+  }
+  return mark_stack_ptr;
+}
+
+/* Keep objects reachable only by a partitioned roots procedure, and    */
+/* check them after a collection.                                       */
+void push_roots_test(void)
+{
+  GC_hidden_pointer h[PUSH_ROOTS_TEST_PARTS * PUSH_ROOTS_TEST_PART_LEN];
+  int i;
+
+  /* The procedure is registered before the objects are allocated, as  */
+  /* a collection started by another thread could reclaim them if they  */
+  /* were referenced only by the hidden pointers before that.           */
+  for (i = 0; i < PUSH_ROOTS_TEST_PARTS * PUSH_ROOTS_TEST_PART_LEN; i++)
+    h[i] = GC_HIDE_POINTER(NULL);
+  if (GC_register_push_roots_proc(push_hidden_roots, PUSH_ROOTS_TEST_PARTS,
+                                  h) != GC_SUCCESS) {
+    GC_printf("GC_register_push_roots_proc failed\n");
+    FAIL;
+  }
+  for (i = 0; i < PUSH_ROOTS_TEST_PARTS * PUSH_ROOTS_TEST_PART_LEN; i++) {
+    int *p = (int *)GC_MALLOC(sizeof(int));
+
+    CHECK_OUT_OF_MEMORY(p);
+    *p = i + 1;
+    h[i] = GC_HIDE_POINTER(p);
+  }
+  GC_gcollect();
+  /* A lost object, if any, is reused (cleared) by the allocation.      */
+  for (i = 0; i < PUSH_ROOTS_TEST_PARTS * PUSH_ROOTS_TEST_PART_LEN; i++)
+    CHECK_OUT_OF_MEMORY(GC_MALLOC(sizeof(int)));
+  /* The objects are checked before unregistering the procedure, as    */
+  /* they could be collected by another thread right after that.       */
+  for (i = 0; i < PUSH_ROOTS_TEST_PARTS * PUSH_ROOTS_TEST_PART_LEN; i++) {
+    if (*(int *)GC_REVEAL_POINTER(h[i]) != i + 1) {
+      GC_printf("Object kept by push-roots procedure is lost\n");
+      FAIL;
+    }
+  }
+  (void)GC_register_push_roots_proc(push_hidden_roots, 0, h);
+}
+
 void alloc_small(int n)
 {
     int i;
@@ -1276,10 +1604,15 @@ void typed_test(void)
     GC_descr d4 = GC_make_descriptor(bm_huge, 320);
     GC_word * x = (GC_word *)GC_MALLOC_EXPLICITLY_TYPED(
                                 320 * sizeof(GC_word) + 123, d4);
+    void *many = NULL;
     int i;
 
     AO_fetch_and_add1(&collectable_count);
     (void)GC_make_descriptor(bm_large, 32);
+    if (GC_make_descriptor(bm_huge, 320) != d4) {
+      GC_printf("Extended descriptor is not shared\n");
+      FAIL;
+    }
     if (GC_get_bit(bm_huge, 32) == 0 || GC_get_bit(bm_huge, 311) == 0
         || GC_get_bit(bm_huge, 319) != 0) {
       GC_printf("Bad GC_get_bit() or bm_huge initialization\n");
@@ -1338,8 +1671,24 @@ void typed_test(void)
         newP[0] = 17;
         GC_PTR_STORE_AND_DIRTY(newP + 1, old);
         old = newP;
+        AO_fetch_and_add1(&collectable_count);
+        if (NULL == many) {
+          many = GC_malloc_explicitly_typed_many(4 * sizeof(GC_word), d2);
+          CHECK_OUT_OF_MEMORY(many);
+        }
+        newP = (GC_word *)many;
+        many = GC_NEXT(many);
+        GC_NEXT(newP) = NULL;
+        if (newP[1] != 0) {
+          GC_printf("Bad initialization by"
+                    " GC_malloc_explicitly_typed_many\n");
+          FAIL;
+        }
+        newP[0] = 17;
+        GC_PTR_STORE_AND_DIRTY(newP + 1, old);
+        old = newP;
     }
-    for (i = 0; i < 20000; i++) {
+    for (i = 0; i < 24000; i++) {
         if (newP[0] != 17) {
             GC_printf("Typed alloc failed at %d\n", i);
             FAIL;
@@ -1353,6 +1702,303 @@ void typed_test(void)
 }
 #endif /* !NO_TYPED_TEST */
 
+#if !defined(DBG_HDRS_ALL) && !defined(GC_NO_FINALIZATION) \
+    && !defined(GC_MOVABLE_NOT_NEEDED)
+# define MOVABLE_TEST
+# define MOVABLE_HANDLES 100
+
+  void * GC_CALLBACK check_movable_handles(void *handles)
+  {
+    int i;
+
+    for (i = 0; i < MOVABLE_HANDLES; i++) {
+      if (*(GC_word *)((void **)handles)[i] != (GC_word)i)
+        return handles; /* failure */
+    }
+    return NULL;
+  }
+
+  void movable_test(void)
+  {
+    void *handles[MOVABLE_HANDLES];
+    int i, j;
+
+    GC_set_evacuation_threshold(50);
+    for (i = 0; i < MOVABLE_HANDLES; i++) {
+      /* Leave the kept objects scattered among the garbage ones.       */
+      for (j = 0; j < 20; j++)
+        (void)GC_malloc_movable(sizeof(GC_word) * 3);
+      handles[i] = GC_malloc_movable(sizeof(GC_word) * 3);
+      CHECK_OUT_OF_MEMORY(handles[i]);
+      *(GC_word *)handles[i] = (GC_word)i;
+      if (GC_register_movable_handle(&handles[i]) != GC_SUCCESS) {
+        GC_printf("GC_register_movable_handle failed\n");
+        FAIL;
+      }
+    }
+    GC_gcollect();
+    if (GC_call_with_alloc_lock(check_movable_handles, handles) != NULL) {
+      GC_printf("Movable object contents changed\n");
+      FAIL;
+    }
+    for (i = 0; i < MOVABLE_HANDLES; i++) {
+      if (GC_unregister_movable_handle(&handles[i]) != 1) {
+        GC_printf("GC_unregister_movable_handle failed\n");
+        FAIL;
+      }
+    }
+  }
+#endif /* !DBG_HDRS_ALL && !GC_NO_FINALIZATION */
+
+#if !defined(DBG_HDRS_ALL) && !defined(GC_NO_FINALIZATION) \
+    && !defined(GC_EPHEMERONS_NOT_NEEDED)
+# define EPHEMERON_TEST
+# define EPHEMERON_CNT 100
+
+  void ephemeron_test(void)
+  {
+    void *ephs[EPHEMERON_CNT];
+    void *keys[EPHEMERON_CNT / 2];
+    int i;
+    int cleared = 0;
+
+    for (i = 0; i < EPHEMERON_CNT; i++) {
+      GC_word *key = (GC_word *)GC_MALLOC(sizeof(GC_word));
+      void **value;
+
+      CHECK_OUT_OF_MEMORY(key);
+      *key = (GC_word)i;
+      value = (void **)GC_MALLOC(sizeof(void *));
+      CHECK_OUT_OF_MEMORY(value);
+      GC_PTR_STORE_AND_DIRTY(value, key); /* the value refers to its key */
+      ephs[i] = GC_new_ephemeron(key, value);
+      CHECK_OUT_OF_MEMORY(ephs[i]);
+      if (i % 2 == 0)
+        keys[i / 2] = key;
+    }
+    GC_gcollect();
+    for (i = 0; i < EPHEMERON_CNT; i++) {
+      GC_word *key = (GC_word *)GC_ephemeron_get_key(ephs[i]);
+      void **value = (void **)GC_ephemeron_get_value(ephs[i]);
+
+      if (NULL == key) {
+        if (i % 2 == 0 || value != NULL) {
+          GC_printf("Ephemeron %d wrongly cleared\n", i);
+          FAIL;
+        }
+        cleared++;
+      } else if (NULL == value || *value != key || *key != (GC_word)i
+                 || (i % 2 == 0 && key != keys[i / 2])) {
+        GC_printf("Ephemeron %d contents changed\n", i);
+        FAIL;
+      }
+    }
+    if (0 == cleared) {
+      /* Each dropped key is reachable only from its own value. */
+      GC_printf("No ephemeron cleared\n");
+      FAIL;
+    }
+  }
+#endif
+
+#if !defined(DBG_HDRS_ALL) && !defined(GC_NO_FINALIZATION) \
+    && !defined(GC_TOGGLE_REFS_NOT_NEEDED)
+# define TOGGLEREF_TEST
+# define TOGGLEREF_CNT 100
+
+  static unsigned toggleref_visits;
+  static int toggleref_drop_all;
+
+  static void GC_CALLBACK toggleref_batch(void **objs,
+                                          GC_ToggleRefStatus *states, size_t n)
+  {
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+      if (toggleref_drop_all) {
+        states[i] = GC_TOGGLE_REF_DROP;
+      } else {
+        states[i] = *(GC_word *)objs[i] % 2 != 0 ? GC_TOGGLE_REF_STRONG
+                                                  : GC_TOGGLE_REF_WEAK;
+      }
+    }
+    toggleref_visits += (unsigned)n;
+  }
+
+  /* Check that only the new and the dirty entries are revisited. */
+  void toggleref_test(void)
+  {
+    GC_word **objs;
+    int i;
+
+    GC_set_toggleref_batch_func(toggleref_batch);
+    GC_set_toggleref_dirty_only(1);
+    objs = (GC_word **)GC_MALLOC(TOGGLEREF_CNT * sizeof(GC_word *));
+    CHECK_OUT_OF_MEMORY(objs);
+    for (i = 0; i < TOGGLEREF_CNT; i++) {
+      GC_word *obj = (GC_word *)GC_MALLOC(sizeof(GC_word));
+
+      CHECK_OUT_OF_MEMORY(obj);
+      *obj = (GC_word)i;
+      objs[i] = obj;
+      GC_END_STUBBORN_CHANGE(objs + i);
+      if (GC_toggleref_add(obj, 0) != GC_SUCCESS) {
+        GC_printf("GC_toggleref_add failed\n");
+        FAIL;
+      }
+    }
+    GC_gcollect();
+    if (toggleref_visits != TOGGLEREF_CNT) {
+      GC_printf("Wrong number of new togglerefs visited: %u\n",
+                toggleref_visits);
+      FAIL;
+    }
+    toggleref_visits = 0;
+    GC_gcollect();
+    for (i = 0; i < 3; i++) {
+      if (GC_toggleref_mark_dirty(objs[i]) != GC_SUCCESS) {
+        GC_printf("GC_toggleref_mark_dirty failed\n");
+        FAIL;
+      }
+    }
+    (void)GC_toggleref_mark_dirty(objs[0]); /* already dirty */
+    GC_gcollect();
+    if (toggleref_visits != 3) {
+      GC_printf("Wrong number of dirty togglerefs visited: %u\n",
+                toggleref_visits);
+      FAIL;
+    }
+    toggleref_drop_all = 1;
+    for (i = 0; i < TOGGLEREF_CNT; i++)
+      (void)GC_toggleref_mark_dirty(objs[i]);
+    GC_gcollect();
+    GC_set_toggleref_dirty_only(0);
+    GC_set_toggleref_batch_func(0);
+    GC_reachable_here(objs);
+  }
+#endif
+
+#if !defined(DBG_HDRS_ALL) && !defined(GC_NO_FINALIZATION)
+# define NOTIFY_LINKS_TEST
+# define NOTIFY_LINKS_CNT 100
+
+  static GC_hidden_pointer *notify_links_holder;
+  static unsigned notify_links_drained;
+
+  static void GC_CALLBACK notify_link_drained(void **link, void *cd)
+  {
+    UNUSED_ARG(cd);
+    if ((GC_word)link < (GC_word)notify_links_holder
+        || (GC_word)link >= (GC_word)(notify_links_holder
+                                      + NOTIFY_LINKS_CNT)
+        || *link != NULL) {
+      GC_printf("Wrong cleared link drained: %p\n", (void *)link);
+      FAIL;
+    }
+    notify_links_drained++;
+  }
+
+  static void notify_links_register(void)
+  {
+    int i;
+
+    for (i = 0; i < NOTIFY_LINKS_CNT; i++) {
+      void *obj = GC_MALLOC_ATOMIC(sizeof(GC_word));
+
+      CHECK_OUT_OF_MEMORY(obj);
+      notify_links_holder[i] = GC_HIDE_POINTER(obj);
+      GC_END_STUBBORN_CHANGE(notify_links_holder + i);
+      if (GC_register_disappearing_link_notify(
+                        (void **)&notify_links_holder[i], obj) != GC_SUCCESS) {
+        GC_printf("GC_register_disappearing_link_notify failed\n");
+        FAIL;
+      }
+    }
+  }
+
+  /* Check that every cleared link is drained exactly once.    */
+  void notify_links_test(void)
+  {
+    unsigned cleared = 0;
+    int i;
+
+    notify_links_holder = (GC_hidden_pointer *)GC_MALLOC(
+                                NOTIFY_LINKS_CNT * sizeof(GC_hidden_pointer));
+    CHECK_OUT_OF_MEMORY(notify_links_holder);
+    notify_links_register();
+    GC_gcollect();
+    GC_gcollect();
+    while (GC_drain_cleared_links(notify_link_drained, NULL) > 0) {
+      /* Empty. */
+    }
+    for (i = 0; i < NOTIFY_LINKS_CNT; i++) {
+      if (0 == notify_links_holder[i]) cleared++;
+    }
+    if (cleared != notify_links_drained) {
+      /* A collection might happen while draining.  */
+      (void)GC_drain_cleared_links(notify_link_drained, NULL);
+    }
+    if (cleared != notify_links_drained) {
+      GC_printf("Cleared %u links but drained %u\n",
+                cleared, notify_links_drained);
+      FAIL;
+    }
+    if (GC_drain_cleared_links(notify_link_drained, NULL) != 0) {
+      GC_printf("The cleared links queue is not empty\n");
+      FAIL;
+    }
+    for (i = 0; i < NOTIFY_LINKS_CNT; i++)
+      (void)GC_unregister_disappearing_link(
+                                (void **)&notify_links_holder[i]);
+    notify_links_holder = NULL;
+  }
+
+  /* Register the links in bulk, and check those to the reachable      */
+  /* objects are not cleared.                                          */
+  void bulk_links_test(void)
+  {
+    GC_hidden_pointer *holder = (GC_hidden_pointer *)GC_MALLOC_ATOMIC(
+                                NOTIFY_LINKS_CNT * sizeof(GC_hidden_pointer));
+    void ***links = (void ***)GC_MALLOC(NOTIFY_LINKS_CNT * sizeof(void **));
+    void **objs = (void **)GC_MALLOC(NOTIFY_LINKS_CNT * sizeof(void *));
+    int i;
+
+    CHECK_OUT_OF_MEMORY(holder);
+    CHECK_OUT_OF_MEMORY(links);
+    CHECK_OUT_OF_MEMORY(objs);
+    for (i = 0; i < NOTIFY_LINKS_CNT; i++) {
+      objs[i] = GC_MALLOC_ATOMIC(sizeof(GC_word));
+      CHECK_OUT_OF_MEMORY(objs[i]);
+      holder[i] = GC_HIDE_POINTER(objs[i]);
+      links[i] = (void **)&holder[i];
+    }
+    GC_END_STUBBORN_CHANGE(holder);
+    GC_END_STUBBORN_CHANGE(links);
+    GC_END_STUBBORN_CHANGE(objs);
+    if (GC_register_disappearing_links(links, objs, NOTIFY_LINKS_CNT)
+            != GC_SUCCESS
+        || GC_unregister_disappearing_links(links, NOTIFY_LINKS_CNT)
+            != NOTIFY_LINKS_CNT
+        || GC_register_disappearing_links(links, objs, NOTIFY_LINKS_CNT)
+            != GC_SUCCESS) {
+      GC_printf("Bulk registration of disappearing links failed\n");
+      FAIL;
+    }
+    for (i = 1; i < NOTIFY_LINKS_CNT; i += 2)
+      objs[i] = NULL;
+    GC_END_STUBBORN_CHANGE(objs);
+    GC_gcollect();
+    for (i = 0; i < NOTIFY_LINKS_CNT; i += 2) {
+      if (holder[i] != GC_HIDE_POINTER(objs[i])) {
+        GC_printf("Bulk-registered link to a reachable object cleared\n");
+        FAIL;
+      }
+    }
+    (void)GC_unregister_disappearing_links(links, NOTIFY_LINKS_CNT);
+    GC_reachable_here(holder);
+  }
+#endif
+
 #ifdef DBG_HDRS_ALL
 # define set_print_procs() (void)(A.dummy = 17)
 #else
@@ -1453,6 +2099,12 @@ void run_one_test(void)
       }
 #   endif
     test_tinyfl();
+    kind_test();
+    long_lived_test();
+    free_reuse_test();
+    heap_test();
+    cref_test();
+    push_roots_test();
 #   ifndef DBG_HDRS_ALL
       AO_fetch_and_add1(&collectable_count); /* 1 */
       AO_fetch_and_add1(&collectable_count); /* 2 */
@@ -1546,6 +2198,11 @@ void run_one_test(void)
           for (i = sizeof(GC_word); i < 512; i *= 2) {
             GC_word result = (GC_word) GC_memalign(i, 17);
             if (result % i != 0 || result == 0 || *(int *)result != 0) FAIL;
+            result = (GC_word)GC_memalign_atomic(i, 33);
+            if (result % i != 0 || result == 0) FAIL;
+            result = (GC_word)GC_memalign_uncollectable(i, 9);
+            if (result % i != 0 || result == 0 || *(int *)result != 0) FAIL;
+            GC_free(GC_base((void *)result));
           }
         }
 #     ifndef GC_NO_VALLOC
@@ -1624,6 +2281,96 @@ void run_one_test(void)
         GC_free(GC_malloc_atomic(0));
         GC_free(GC_malloc(0));
         GC_free(GC_malloc_atomic(0));
+    {
+      void *objs[16];
+      int i;
+
+      for (i = 0; i < 16; i++)
+        objs[i] = (i & 1) != 0 ? GC_malloc_atomic(i * 16)
+                    : GC_malloc((i % 6) * 1000 + 8);
+      objs[4] = NULL;
+      GC_free_n(objs, 16);
+    }
+    {
+      GC_region r = GC_region_create();
+      GC_word **cells;
+      int i;
+
+      CHECK_OUT_OF_MEMORY(r);
+      cells = (GC_word **)GC_region_malloc(r, 500 * sizeof(GC_word *));
+      CHECK_OUT_OF_MEMORY(cells);
+      for (i = 0; i < 500; i++) {
+        /* The collectible objects referenced only from the region.     */
+        GC_word *p = (GC_word *)GC_region_malloc(r, (i % 7) * 16 + 1);
+
+        CHECK_OUT_OF_MEMORY(p);
+        if (*p != 0) FAIL;
+        cells[i] = (GC_word *)GC_malloc(sizeof(GC_word));
+        CHECK_OUT_OF_MEMORY(cells[i]);
+        *cells[i] = (GC_word)i;
+      }
+      CHECK_OUT_OF_MEMORY(GC_region_malloc(r, 100000));
+      GC_gcollect();
+      for (i = 0; i < 500; i++) {
+        if (*cells[i] != (GC_word)i) FAIL;
+      }
+      GC_region_destroy(r);
+    }
+    {
+      GC_pool pool = GC_pool_create(3 * sizeof(GC_word));
+      GC_word *nodes[300];
+      int i;
+
+      CHECK_OUT_OF_MEMORY(pool);
+      if (GC_pool_create(1000000) != NULL) FAIL;
+      for (i = 0; i < 300; i++) {
+        nodes[i] = (GC_word *)GC_pool_malloc(pool);
+        CHECK_OUT_OF_MEMORY(nodes[i]);
+        if (nodes[i][0] != 0 || nodes[i][2] != 0) FAIL;
+        nodes[i][1] = (GC_word)i;
+      }
+      for (i = 0; i < 300; i += 2) {
+        GC_pool_free(pool, nodes[i]);
+      }
+      GC_gcollect();
+      for (i = 1; i < 300; i += 2) {
+        if (nodes[i][1] != (GC_word)i) FAIL;
+      }
+      for (i = 0; i < 300; i += 2) {
+        nodes[i] = (GC_word *)GC_pool_malloc(pool);
+        CHECK_OUT_OF_MEMORY(nodes[i]);
+        if (nodes[i][1] != 0) FAIL;
+      }
+      GC_pool_destroy(pool);
+    }
+    {
+      GC_word *p = (GC_word *)GC_malloc(10000 * sizeof(GC_word));
+      size_t n;
+
+      CHECK_OUT_OF_MEMORY(p);
+      p[0] = 1;
+      p[9999] = 2;
+      for (n = 20000; n <= 160000; n *= 2) {
+        p = (GC_word *)GC_realloc(p, n * sizeof(GC_word));
+        CHECK_OUT_OF_MEMORY(p);
+        if (p[0] != 1 || p[n / 2 - 1] != 2) FAIL;
+        p[n - 1] = 2;
+      }
+    }
+    {
+      GC_word *p = (GC_word *)GC_malloc(5 * sizeof(GC_word));
+
+      CHECK_OUT_OF_MEMORY(p);
+      p[4] = 17;
+      GC_free_sized(p, 5 * sizeof(GC_word));
+      p = (GC_word *)GC_malloc(5 * sizeof(GC_word));
+      CHECK_OUT_OF_MEMORY(p);
+      if (p[4] != 0) FAIL;
+      GC_free_sized(p, 5 * sizeof(GC_word));
+      GC_free_sized(GC_malloc_atomic(3000), 3000);
+    }
+    GC_flush_thread_local_free_lists();
+    GC_free(GC_malloc(12));
 #   ifndef NO_TEST_HANDLE_FORK
         GC_atfork_prepare();
         pid = fork();
@@ -1708,6 +2455,12 @@ void run_one_test(void)
         }
 #     endif
 #   endif /* DBG_HDRS_ALL */
+#   ifdef MOVABLE_TEST
+      movable_test();
+#   endif
+#   ifdef EPHEMERON_TEST
+      ephemeron_test();
+#   endif
     tree_test();
 #   ifdef TEST_WITH_SYSTEM_MALLOC
       free(calloc(1,1));
@@ -1742,12 +2495,62 @@ void run_one_test(void)
 #   endif
 }
 
+static int precise_roots_pushed = 0;
+
+void GC_CALLBACK push_precise_root(void *cell)
+{
+    GC_push_all(cell, (void **)cell + 1);
+    precise_roots_pushed++;
+}
+
+/* Check that the precise stack roots procedure of the current thread  */
+/* is invoked by the collector.                                         */
+void precise_stack_roots_test(void)
+{
+    void **cell = (void **)malloc(sizeof(void *));
+    GC_hidden_pointer base; /* not to keep the object alive */
+
+    CHECK_OUT_OF_MEMORY(cell);
+    *cell = GC_MALLOC(16);
+    CHECK_OUT_OF_MEMORY(*cell);
+    /* GC_MALLOC result is not the object base if GC_DEBUG.   */
+    base = GC_HIDE_POINTER(GC_base(*cell));
+    if (GC_set_my_stack_roots_proc(push_precise_root, cell)) {
+      void *cd;
+
+      if (GC_get_my_stack_roots_proc(&cd) != push_precise_root
+          || cd != cell) {
+        GC_printf("Wrong stack roots procedure\n");
+        FAIL;
+      }
+      GC_gcollect();
+      if (0 == precise_roots_pushed
+          || GC_base(*cell) != GC_REVEAL_POINTER(base)) {
+        GC_printf("Precise stack roots are not pushed\n");
+        FAIL;
+      }
+      (void)GC_set_my_stack_roots_proc(0, NULL);
+    }
+    free(cell);
+}
+
 /* Execute some tests after termination of other test threads (if any). */
 void run_single_threaded_test(void) {
     GC_disable();
     GC_FREE(GC_MALLOC(100));
     GC_expand_hp(0); /* add a block to heap */
     GC_enable();
+    precise_stack_roots_test();
+}
+
+#define MAX_ENUM_WORKERS 64
+
+void GC_CALLBACK reachable_objs_par_counter(void *obj, size_t size,
+                                            unsigned worker, void *counters)
+{
+  UNUSED_ARG(obj);
+  UNUSED_ARG(size);
+  ((unsigned *)counters)[worker]++; /* only this worker updates it */
 }
 
 void GC_CALLBACK reachable_objs_counter(void *obj, size_t size,
@@ -1770,6 +2573,18 @@ void GC_CALLBACK reachable_objs_counter(void *obj, size_t size,
   (*(unsigned *)pcounter)++;
 }
 
+static int GC_CALLBACK count_snapshot_bytes(const void *buf, size_t len,
+                                            void *pcounter)
+{
+    if (0 == *(size_t *)pcounter
+        && (len < 8 || memcmp(buf, "GCSNAP1", 8) != 0)) {
+      GC_printf("Bad heap snapshot header\n");
+      FAIL;
+    }
+    *(size_t *)pcounter += len;
+    return 0;
+}
+
 #define NUMBER_ROUND_UP(v, bound) ((((v) + (bound) - 1) / (bound)) * (bound))
 
 void check_heap_stats(void)
@@ -1787,6 +2602,13 @@ void check_heap_stats(void)
       GC_printf("GC should be initialized!\n");
       FAIL;
     }
+#   ifdef TOGGLEREF_TEST
+      toggleref_test();
+#   endif
+#   ifdef NOTIFY_LINKS_TEST
+      notify_links_test();
+      bulk_links_test();
+#   endif
 #   ifdef VERY_SMALL_CONFIG
     /* The upper bounds are a guess, which has been empirically */
     /* adjusted.  On low end uniprocessors with incremental GC  */
@@ -1827,6 +2649,7 @@ void check_heap_stats(void)
     /* Garbage collect repeatedly so that all inaccessible objects      */
     /* can be finalized.                                                */
       while (GC_collect_a_little()) { }
+      (void)GC_collect_idle(1000000UL /* 1 ms */);
       for (i = 0; i < 16; i++) {
         GC_gcollect();
 #       ifndef GC_NO_FINALIZATION
@@ -1836,6 +2659,22 @@ void check_heap_stats(void)
                 GC_invoke_finalizers();
 #       endif
       }
+      {
+        size_t snapshot_bytes = 0;
+
+        if (GC_write_heap_snapshot(count_snapshot_bytes, &snapshot_bytes) != 0
+            || snapshot_bytes <= 8) {
+          GC_printf("Heap snapshot failed\n");
+          FAIL;
+        }
+      }
+#     ifndef GC_NO_FINALIZATION
+        if (GC_get_finalizer_queue_length()
+                > GC_get_finalizer_queue_max_length()) {
+          GC_printf("Bad finalizer queue length\n");
+          FAIL;
+        }
+#     endif
       if (print_stats) {
         struct GC_stack_base sb;
         int res = GC_get_stack_base(&sb);
@@ -1851,6 +2690,21 @@ void check_heap_stats(void)
       }
     GC_alloc_lock();
     GC_enumerate_reachable_objects_inner(reachable_objs_counter, &obj_count);
+    if (GC_get_parallel() < MAX_ENUM_WORKERS) {
+      unsigned counters[MAX_ENUM_WORKERS] = { 0 };
+      unsigned par_count = 0;
+      int i;
+
+      GC_enumerate_reachable_objects_parallel_inner(
+                                reachable_objs_par_counter, counters);
+      for (i = 0; i <= GC_get_parallel(); i++)
+        par_count += counters[i];
+      if (par_count != obj_count) {
+        GC_printf("Parallel enumeration found %u objects instead of %u\n",
+                  par_count, obj_count);
+        FAIL;
+      }
+    }
     GC_alloc_unlock();
     GC_printf("Completed %u tests\n", n_tests);
     GC_printf("Allocated %d collectable objects\n", (int)collectable_count);
@@ -1946,16 +2800,65 @@ void check_heap_stats(void)
 #   endif
     GC_printf("Final number of reachable objects is %u\n", obj_count);
 
+    lifetime_free_n_test();
 #   ifndef GC_GET_HEAP_USAGE_NOT_NEEDED
       /* Get global counters (just to check the functions work).  */
       GC_get_heap_usage_safe(NULL, NULL, NULL, NULL, NULL);
       {
         struct GC_prof_stats_s stats;
         (void)GC_get_prof_stats(&stats, sizeof(stats));
+        if (0 == stats.hdr_cache_hits + stats.hdr_cache_misses) {
+          GC_printf("Header cache lookups are not counted\n");
+          FAIL;
+        }
+        GC_adjust_external_bytes((GC_signed_word)1 << 20);
+        (void)GC_get_prof_stats(&stats, sizeof(stats));
+        GC_adjust_external_bytes(-((GC_signed_word)1 << 20));
+        if (stats.external_bytes != ((GC_word)1 << 20)
+                                    + GC_get_external_bytes()) {
+          GC_printf("External bytes are not counted\n");
+          FAIL;
+        }
 #       ifdef THREADS
           (void)GC_get_prof_stats_unsafe(&stats, sizeof(stats));
 #       endif
       }
+      {
+        struct GC_size_class_stats_s sc_stats[4];
+        char json[64];
+        size_t n = GC_get_size_class_stats(sc_stats, 4);
+        size_t len = GC_get_size_class_stats_json(json, sizeof(json));
+
+        if ((n > 0 && (sc_stats[0].n_blocks == 0
+                       || sc_stats[0].live_objs > sc_stats[0].n_objs))
+            || (len > 0 && (json[0] != '{' || strlen(json) >= sizeof(json)
+                            || (len < sizeof(json) && strlen(json) != len)))) {
+          GC_printf("Bad size class stats\n");
+          FAIL;
+        }
+      }
+      {
+        struct GC_scan_yield_stats_s sy_stats[4];
+        size_t n = GC_get_scan_yield_stats(sy_stats, 4);
+        size_t i;
+
+        for (i = 0; i < n && i < 4; i++) {
+          if (sy_stats[i].n_objs_no_ptrs > sy_stats[i].n_objs
+              || sy_stats[i].n_ptr_words > sy_stats[i].n_words) {
+            GC_printf("Bad scan yield stats\n");
+            FAIL;
+          }
+        }
+      }
+      {
+        size_t sizes[8];
+        size_t n = GC_get_size_classes(sizes, 8);
+
+        if (n <= 8 && GC_set_size_classes(sizes, n) != 1) {
+          GC_printf("GC_set_size_classes failed\n");
+          FAIL;
+        }
+      }
       (void)GC_get_size_map_at(-1);
       (void)GC_get_size_map_at(1);
 #   endif
@@ -2565,6 +3468,9 @@ int main(void)
 #   endif
 #   if defined(CPPCHECK)
       UNTESTED(GC_register_altstack);
+      UNTESTED(GC_register_fiber);
+      UNTESTED(GC_unregister_fiber);
+      UNTESTED(GC_fiber_switch);
       UNTESTED(GC_stop_world_external);
       UNTESTED(GC_start_world_external);
 #     ifndef GC_NO_DLOPEN
@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2023 Ivan Maidanski
+ *
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose, provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/* Test the persistent heap images: write an image, restore it in a     */
+/* new process (the test program itself is executed again), check the  */
+/* restored objects, and check that an image of a different build and  */
+/* a truncated image are rejected.                                      */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gc.h"
+
+/* The same conditions as for USE_HEAP_ARENA in gcconfig.h.    */
+#if defined(__linux__) && defined(__LP64__) \
+    && (defined(USE_HEAP_ARENA) || defined(FLAT_HDR_TABLE) \
+        || defined(SIDE_MARK_BITMAP) || defined(COMPRESSED_REFS))
+# define HEAP_IMAGE_EXPECTED
+#endif
+
+#ifdef __linux__
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define IMAGE_FILE "heapimg_test.img"
+#define BAD_IMAGE_FILE "heapimg_test_bad.img"
+
+#define N_NODES 10000
+#define N_EXTRA 200000
+#define LARGE_SZ 100000
+
+struct node {
+  struct node *next;
+  char *text;           /* an atomic object     */
+  GC_word value;
+};
+
+static struct node *root; /* the restored list */
+
+#define CHECK(cond) \
+    if (!(cond)) { \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+              #cond); \
+      exit(1); \
+    }
+
+static void fill_text(char *p, GC_word value, size_t len)
+{
+  size_t i;
+
+  for (i = 0; i < len; i++)
+    p[i] = (char)('a' + (value + i) % 26);
+}
+
+static int text_ok(const char *p, GC_word value, size_t len)
+{
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    if (p[i] != (char)('a' + (value + i) % 26)) return 0;
+  }
+  return 1;
+}
+
+/* The text of the first node is a large object.        */
+#define TEXT_LEN(i) ((i) == N_NODES - 1 ? LARGE_SZ : (size_t)((i) % 50 + 1))
+
+static struct node *build_list(void)
+{
+  struct node *head = NULL;
+  GC_word i;
+
+  for (i = 0; i < N_NODES; i++) {
+    struct node *p = (struct node *)GC_MALLOC(sizeof(struct node));
+    size_t len = TEXT_LEN(i);
+
+    CHECK(p != NULL);
+    p -> text = (char *)GC_MALLOC_ATOMIC(len);
+    CHECK(p -> text != NULL);
+    fill_text(p -> text, i, len);
+    p -> value = i;
+    p -> next = head;
+    GC_END_STUBBORN_CHANGE(p);
+    head = p;
+    /* Some garbage which should not get to the image.  */
+    (void)GC_MALLOC(sizeof(struct node));
+  }
+  return head;
+}
+
+static void check_list(struct node *head)
+{
+  GC_word i = N_NODES;
+  struct node *p;
+
+  for (p = head; p != NULL; p = p -> next) {
+    CHECK(i > 0);
+    i--;
+    CHECK(GC_base(p) == p);
+    CHECK(GC_base(p -> text) == p -> text);
+    CHECK(p -> value == i);
+    CHECK(text_ok(p -> text, i, TEXT_LEN(i)));
+  }
+  CHECK(0 == i);
+}
+
+/* Allocate and collect a lot, the new objects should not overwrite     */
+/* the restored ones.                                                   */
+static void churn(void)
+{
+  int i;
+
+  for (i = 0; i < N_EXTRA; i++) {
+    void *p = GC_MALLOC(sizeof(struct node) * (size_t)(i % 8 + 1));
+
+    CHECK(p != NULL);
+    memset(p, 0xa5, sizeof(struct node) * (size_t)(i % 8 + 1));
+  }
+  GC_gcollect();
+}
+
+static void load_image(const char *path)
+{
+  struct node *p;
+  struct node *extra;
+
+  root = (struct node *)GC_load_heap_image(path);
+  CHECK(root != NULL);
+  GC_INIT();
+  check_list(root);
+  churn();
+  check_list(root);
+
+  /* A new object referenced only from a restored one is reachable.   */
+  for (p = root; p -> next != NULL; p = p -> next) {
+    /* Empty. */
+  }
+  extra = (struct node *)GC_MALLOC(sizeof(struct node));
+  CHECK(extra != NULL);
+  extra -> value = 12345;
+  p -> next = extra;
+  GC_END_STUBBORN_CHANGE(p);
+  extra = NULL;
+  churn();
+  CHECK(p -> next -> value == 12345);
+  p -> next = NULL;
+  check_list(root);
+}
+
+static void reject_image(const char *path)
+{
+  CHECK(GC_load_heap_image(path) == NULL);
+  /* The heap is initialized as usual.        */
+  GC_INIT();
+  root = build_list();
+  churn();
+  check_list(root);
+}
+
+static void run_self(const char *prog, const char *mode, const char *path)
+{
+  pid_t pid = fork();
+  int status;
+
+  CHECK(pid != -1);
+  if (0 == pid) {
+    execl(prog, prog, mode, path, (char *)NULL);
+    perror("execl");
+    _exit(1);
+  }
+  CHECK(waitpid(pid, &status, 0) == pid);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "%s of %s failed\n", mode, path);
+    exit(1);
+  }
+}
+
+/* Copy the image to BAD_IMAGE_FILE, truncated to len bytes, storing    */
+/* the given value to the word at the given offset (unless it is -1).   */
+static void write_bad_image(const char *data, size_t len,
+                            long patch_offset, GC_word patch_value)
+{
+  FILE *f = fopen(BAD_IMAGE_FILE, "wb");
+
+  CHECK(f != NULL);
+  CHECK(fwrite(data, 1, len, f) == len);
+  if (patch_offset != -1) {
+    CHECK(fseek(f, patch_offset, SEEK_SET) == 0);
+    CHECK(fwrite(&patch_value, sizeof(patch_value), 1, f) == 1);
+  }
+  CHECK(fclose(f) == 0);
+}
+
+static char *read_file(const char *path, size_t *plen)
+{
+  FILE *f = fopen(path, "rb");
+  char *data;
+  long len;
+
+  CHECK(f != NULL);
+  CHECK(fseek(f, 0, SEEK_END) == 0);
+  len = ftell(f);
+  CHECK(len > 0);
+  CHECK(fseek(f, 0, SEEK_SET) == 0);
+  data = (char *)malloc((size_t)len);
+  CHECK(data != NULL);
+  CHECK(fread(data, 1, (size_t)len, f) == (size_t)len);
+  CHECK(fclose(f) == 0);
+  *plen = (size_t)len;
+  return data;
+}
+
+int main(int argc, char **argv)
+{
+  struct node *head;
+  char *data;
+  size_t len;
+  GC_word hblk_sz;
+
+  if (3 == argc) {
+    if (0 == strcmp(argv[1], "load")) {
+      load_image(argv[2]);
+    } else {
+      reject_image(argv[2]);
+    }
+    return 0;
+  }
+
+  GC_INIT();
+  if (GC_get_find_leak())
+    printf("This test program is not designed for leak detection mode\n");
+  head = build_list();
+  if (GC_write_heap_image(IMAGE_FILE, head) != 0) {
+    (void)remove(IMAGE_FILE);
+#   ifdef HEAP_IMAGE_EXPECTED
+      fprintf(stderr, "GC_write_heap_image failed\n");
+      return 1;
+#   else
+      printf("Heap images are not supported, skipped\n");
+      return 0;
+#   endif
+  }
+  check_list(head);
+  run_self(argv[0], "load", IMAGE_FILE);
+
+  /* The header starts with the magic (8 bytes), the word size and the  */
+  /* block size (see heapimg.c).                                        */
+  data = read_file(IMAGE_FILE, &len);
+  CHECK(len > 8 + 2 * sizeof(GC_word));
+  memcpy(&hblk_sz, data + 8 + sizeof(GC_word), sizeof(hblk_sz));
+  write_bad_image(data, len, (long)(8 + sizeof(GC_word)), hblk_sz * 2);
+  run_self(argv[0], "reject", BAD_IMAGE_FILE);
+  write_bad_image(data, 8 + sizeof(GC_word), -1, 0);
+  run_self(argv[0], "reject", BAD_IMAGE_FILE);
+  write_bad_image(data, len / 2, -1, 0);
+  run_self(argv[0], "reject", BAD_IMAGE_FILE);
+  free(data);
+
+  (void)remove(BAD_IMAGE_FILE);
+  (void)remove(IMAGE_FILE);
+  printf("SUCCEEDED\n");
+  return 0;
+}
+
+#else
+
+int main(void)
+{
+  printf("Heap images are not supported, skipped\n");
+  return 0;
+}
+
+#endif /* !__linux__ */
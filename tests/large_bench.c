@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2022 Ivan Maidanski
+ *
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose, provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/* A microbenchmark of the large objects churn: the objects of random   */
+/* sizes (between 64 KiB and 4 MiB) replace each other in a small set   */
+/* of the live ones, thus the heap block allocator has to find a free   */
+/* block of a suitable size among many ones of various sizes.  Then the */
+/* same is repeated with the large-object space turned on.              */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "gc.h"
+
+#define NOT_GCBUILD
+#include "private/gc_priv.h"
+
+#ifdef LINT2
+# undef rand
+  static GC_RAND_STATE_T seed;
+# define rand() GC_RAND_NEXT(&seed)
+#endif
+
+#define ALLOC_CNT 4000
+#define KEEP_CNT 16
+
+static size_t keep_sz[KEEP_CNT];
+
+#define MIN_LOG_SZ 16 /* 64 KiB */
+#define MAX_LOG_SZ 22 /* 4 MiB */
+
+static size_t random_size(void)
+{
+  /* Distribute the sizes uniformly on the log scale.   */
+  size_t lg = MIN_LOG_SZ + (size_t)rand() % (MAX_LOG_SZ - MIN_LOG_SZ);
+
+  return ((size_t)1 << lg) + ((size_t)rand() % ((size_t)1 << lg));
+}
+
+static void churn(char **keep_arr, const char *what)
+{
+  int i;
+  double t = 0.0;
+# ifndef NO_CLOCK
+    CLOCK_TYPE tI, tF;
+# endif
+
+# ifndef NO_CLOCK
+    GET_TIME(tI);
+# endif
+  for (i = 0; i < ALLOC_CNT; ++i) {
+    int k = rand() % KEEP_CNT;
+    size_t lb = random_size();
+    char *p = (char *)(i % 8 != 0 ? GC_MALLOC_ATOMIC(lb) : GC_MALLOC(lb));
+
+    if (NULL == p) {
+      fprintf(stderr, "Out of memory!\n");
+      exit(3);
+    }
+    if (GC_base(p + lb - 1) != p) {
+      fprintf(stderr, "GC_base() failed for large object\n");
+      exit(1);
+    }
+    p[0] = p[lb - 1] = (char)i;
+    keep_arr[k] = p;
+    keep_sz[k] = lb;
+  }
+# ifndef NO_CLOCK
+    GET_TIME(tF);
+    t = MS_TIME_DIFF(tF, tI) * 1e-3;
+# endif
+
+  for (i = 0; i < KEEP_CNT; ++i) {
+    if (keep_arr[i] != NULL
+        && keep_arr[i][0] != keep_arr[i][keep_sz[i] - 1]) {
+      fprintf(stderr, "Large object content is damaged\n");
+      exit(1);
+    }
+  }
+  printf("Allocated %d large objects (%s) in %g s, collections: %lu,"
+         " heap size: %lu KiB\n", ALLOC_CNT, what, t,
+         (unsigned long)GC_get_gc_no(),
+         (unsigned long)(GC_get_heap_size() >> 10));
+}
+
+int main(void)
+{
+  char **keep_arr;
+
+  GC_INIT();
+  if (GC_get_find_leak())
+    printf("This test program is not designed for leak detection mode\n");
+
+  keep_arr = (char **)GC_MALLOC(sizeof(char *) * KEEP_CNT);
+  if (NULL == keep_arr) {
+    fprintf(stderr, "Out of memory!\n");
+    exit(3);
+  }
+  churn(keep_arr, "heap blocks");
+
+  /* Repeat with the objects placed in the large-object space (if   */
+  /* supported).                                                    */
+  GC_set_large_object_threshold((size_t)1 << MIN_LOG_SZ);
+  churn(keep_arr, "large-object space");
+  printf("Large-object space size: %lu KiB\n",
+         (unsigned long)(GC_get_large_object_space_bytes() >> 10));
+  return 0;
+}
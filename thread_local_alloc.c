@@ -31,6 +31,30 @@ GC_key_t GC_thread_key;
 
 static GC_bool keys_initialized;
 
+STATIC GC_bool GC_bump_alloc = FALSE;
+
+GC_API void GC_CALL GC_set_bump_alloc(int value)
+{
+    GC_bump_alloc = (GC_bool)(value != 0);
+}
+
+GC_API int GC_CALL GC_get_bump_alloc(void)
+{
+    return (int)GC_bump_alloc;
+}
+
+STATIC GC_bool GC_batched_free = FALSE;
+
+GC_API void GC_CALL GC_set_batched_free(int value)
+{
+    GC_batched_free = (GC_bool)(value != 0);
+}
+
+GC_API int GC_CALL GC_get_batched_free(void)
+{
+    return (int)GC_batched_free;
+}
+
 /* Return a single nonempty freelist fl to the global one pointed to    */
 /* by gfl.                                                              */
 
@@ -53,7 +77,9 @@ static void return_single_freelist(void *fl, void **gfl)
 }
 
 /* Recover the contents of the freelist array fl into the global one gfl. */
-static void return_freelists(void **fl, void **gfl)
+/* The entries of fl are set to empty_fl (except for the 0 granule one, */
+/* unless the thread keeps using fl, i.e. empty_fl is not HBLKSIZE).    */
+static void return_freelists(void **fl, void **gfl, void *empty_fl)
 {
     int i;
 
@@ -63,7 +89,7 @@ static void return_freelists(void **fl, void **gfl)
         }
         /* Clear fl[i], since the thread structure may hang around.     */
         /* Do it in a way that is likely to trap if we access it.       */
-        fl[i] = (ptr_t)HBLKSIZE;
+        fl[i] = empty_fl;
     }
     /* The 0 granule freelist really contains 1 granule objects.        */
     if ((word)fl[0] >= HBLKSIZE
@@ -72,7 +98,44 @@ static void return_freelists(void **fl, void **gfl)
 #       endif
        ) {
         return_single_freelist(fl[0], &gfl[1]);
+        if (empty_fl != (void *)HBLKSIZE)
+          fl[0] = empty_fl;
+    }
+}
+
+/* Recover all the free lists of p into the global ones, and drop the   */
+/* bump-pointer buffers (the rest of them is reclaimed by the next      */
+/* collection as it is not marked any longer).                          */
+static void return_all_freelists(GC_tlfs p, void *empty_fl)
+{
+    int k;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    GC_STATIC_ASSERT(THREAD_FREELISTS_KINDS <= MAXOBJKINDS);
+    for (k = 0; k < THREAD_FREELISTS_KINDS; ++k) {
+        if (k == (int)GC_n_kinds)
+            break; /* kind is not created */
+        return_freelists(p -> _freelists[k], GC_obj_kinds[k].ok_freelist,
+                         empty_fl);
     }
+    BZERO(p -> bump_ptr, sizeof(p -> bump_ptr));
+    BZERO(p -> bump_limit, sizeof(p -> bump_limit));
+#   ifdef GC_GCJ_SUPPORT
+        return_freelists(p -> gcj_freelists, (void **)GC_gcjobjfreelist,
+                         empty_fl);
+#   endif
+    if (GC_explicit_kind != 0)
+        return_freelists(p -> typed_freelists,
+                         GC_obj_kinds[GC_explicit_kind].ok_freelist,
+                         empty_fl);
+#   if MAXOBJKINDS > THREAD_FREELISTS_KINDS
+      for (k = THREAD_FREELISTS_KINDS; k < (int)GC_n_kinds; ++k) {
+        void **fl = p -> kind_freelists[k - THREAD_FREELISTS_KINDS];
+
+        if (fl != NULL)
+          return_freelists(fl, GC_obj_kinds[k].ok_freelist, empty_fl);
+      }
+#   endif
 }
 
 #ifdef USE_PTHREAD_SPECIFIC
@@ -117,7 +180,21 @@ GC_INNER void GC_init_thread_local(GC_tlfs p)
 #       ifdef GC_GCJ_SUPPORT
             p -> gcj_freelists[j] = (void *)(word)1;
 #       endif
+        p -> typed_freelists[j] = (void *)(word)1;
     }
+#   if MAXOBJKINDS > THREAD_FREELISTS_KINDS
+      BZERO(p -> kind_freelists, sizeof(p -> kind_freelists));
+#   endif
+    BZERO(p -> bump_ptr, sizeof(p -> bump_ptr));
+    BZERO(p -> bump_limit, sizeof(p -> bump_limit));
+    p -> free_batch_len = 0;
+    BZERO(&(p -> clear_stack), sizeof(p -> clear_stack));
+    p -> assist_debt = 0;
+#   ifdef THREAD_STATS
+      p -> refill_bytes = 0;
+      p -> refill_count = 0;
+      BZERO(p -> refill_objs, sizeof(p -> refill_objs));
+#   endif
     /* The size 0 free lists are handled like the regular free lists,   */
     /* to ensure that the explicit deallocation works.  However,        */
     /* allocation of a size 0 "gcj" object is always an error.          */
@@ -128,29 +205,221 @@ GC_INNER void GC_init_thread_local(GC_tlfs p)
 
 GC_INNER void GC_destroy_thread_local(GC_tlfs p)
 {
-    int k;
-
     GC_ASSERT(I_HOLD_LOCK());
     /* We currently only do this from the thread itself.        */
-    GC_STATIC_ASSERT(THREAD_FREELISTS_KINDS <= MAXOBJKINDS);
-    for (k = 0; k < THREAD_FREELISTS_KINDS; ++k) {
-        if (k == (int)GC_n_kinds)
-            break; /* kind is not created */
-        return_freelists(p -> _freelists[k], GC_obj_kinds[k].ok_freelist);
+    return_all_freelists(p, (void *)HBLKSIZE);
+    GC_free_n_inner(p -> free_batch, (size_t)(p -> free_batch_len));
+    p -> free_batch_len = 0;
+}
+
+GC_INNER void GC_flush_thread_local(GC_tlfs p)
+{
+    /* The lists are restarted like those of a new thread, i.e. the     */
+    /* objects are allocated globally until the thread allocates enough */
+    /* objects of a size again.                                         */
+    return_all_freelists(p, (void *)(word)1);
+}
+
+GC_INNER struct GC_clear_stack_s *GC_my_clear_stack_state(void)
+{
+    void *tsd;
+
+#   if !defined(USE_PTHREAD_SPECIFIC) && !defined(USE_WIN32_SPECIFIC)
+      if (EXPECT(0 == GC_thread_key, FALSE))
+        return NULL;
+#   else
+      if (!EXPECT(keys_initialized, TRUE))
+        return NULL;
+#   endif
+    tsd = GC_getspecific(GC_thread_key);
+    if (EXPECT(0 == tsd, FALSE)) /* e.g. the thread is not registered */
+      return NULL;
+    /* GC_is_thread_tsd_valid is not checked as the lock may be held.   */
+    return &(((GC_tlfs)tsd) -> clear_stack);
+}
+
+GC_API void GC_CALL GC_flush_thread_local_free_lists(void)
+{
+    void *tsd;
+    DCL_LOCK_STATE;
+
+#   if !defined(USE_PTHREAD_SPECIFIC) && !defined(USE_WIN32_SPECIFIC)
+      if (EXPECT(0 == GC_thread_key, FALSE))
+        return;
+#   else
+      if (!EXPECT(keys_initialized, TRUE))
+        return;
+#   endif
+    tsd = GC_getspecific(GC_thread_key);
+#   if !defined(USE_COMPILER_TLS) && !defined(USE_WIN32_COMPILER_TLS)
+      if (EXPECT(0 == tsd, FALSE))
+        return;
+#   endif
+    GC_ASSERT(GC_is_thread_tsd_valid(tsd));
+    if (((GC_tlfs)tsd) -> free_batch_len > 0) {
+      /* See the comment in GC_batch_free about resetting the length.   */
+      GC_free_n(((GC_tlfs)tsd) -> free_batch,
+                (size_t)(((GC_tlfs)tsd) -> free_batch_len));
+      AO_store((volatile AO_t *)&(((GC_tlfs)tsd) -> free_batch_len), 0);
     }
-#   ifdef GC_GCJ_SUPPORT
-        return_freelists(p -> gcj_freelists, (void **)GC_gcjobjfreelist);
+    LOCK();
+    GC_flush_thread_local((GC_tlfs)tsd);
+    UNLOCK();
+}
+
+#if MAXOBJKINDS > THREAD_FREELISTS_KINDS
+  /* Check whether the objects of the given kind (one of the kinds not  */
+  /* having the dedicated free lists in GC_tlfs) could be allocated     */
+  /* from the thread-local free lists.  Not for the uncollectable kinds */
+  /* (see GC_generic_malloc_uncollectable), and not for the kinds with  */
+  /* the objects not cleared (GC_FAST_MALLOC_GRANS clears only the link */
+  /* word, thus the rest of a free object should be zero).  In the      */
+  /* incremental mode, we punt with the kinds traced by a procedure or  */
+  /* a per-object descriptor, as the marker running concurrently might  */
+  /* interpret a free list link as a part of the object layout (unlike  */
+  /* GC_gcj_malloc, the stores initializing such objects are not known  */
+  /* to the collector).                                                 */
+# define KIND_HAS_TLFL(kind) \
+        (!IS_UNCOLLECTABLE(kind) && GC_obj_kinds[kind].ok_init \
+         && (!GC_incremental \
+             || ((GC_obj_kinds[kind].ok_descriptor & GC_DS_TAGS) \
+                    != GC_DS_PROC \
+                 && (GC_obj_kinds[kind].ok_descriptor & GC_DS_TAGS) \
+                    != GC_DS_PER_OBJECT)))
+
+  /* Allocate the free lists of the given kind for the current thread.  */
+  /* Returns NULL if out of memory.                                     */
+  static void **new_kind_freelists(GC_tlfs p, int kind)
+  {
+    void **fl;
+    int j;
+    DCL_LOCK_STATE;
+
+    GC_ASSERT(kind >= THREAD_FREELISTS_KINDS && kind < (int)GC_n_kinds);
+    LOCK();
+    /* The array is pointer-free, the objects of the free lists are     */
+    /* marked explicitly by GC_mark_thread_local_fls_for.  The array    */
+    /* itself is kept alive by the pointer in the thread structure.     */
+    fl = (void **)GC_INTERNAL_MALLOC(TINY_FREELISTS * sizeof(void *),
+                                     PTRFREE);
+    if (EXPECT(fl != NULL, TRUE)) {
+      for (j = 0; j < TINY_FREELISTS; ++j)
+        fl[j] = (void *)(word)1;
+      p -> kind_freelists[kind - THREAD_FREELISTS_KINDS] = fl;
+      GC_dirty(p -> kind_freelists + (kind - THREAD_FREELISTS_KINDS));
+    }
+    UNLOCK();
+    return fl;
+  }
+#endif /* MAXOBJKINDS > THREAD_FREELISTS_KINDS */
+
+/* Make the rest of a fresh block of objects of the given size the      */
+/* bump-pointer buffer of the thread, and return the first object.      */
+/* Like GC_allocobj, a fresh block is taken only if there are no free   */
+/* objects of the size to reuse (on the global free list or in the      */
+/* blocks waiting to be swept), otherwise NULL is returned, and the     */
+/* thread-local free list is refilled from them by the caller.  NULL    */
+/* is also returned if there is no free block (thus the caller would    */
+/* collect or expand the heap).                                         */
+static void *bump_alloc_refill(GC_tlfs p, size_t granules, int kind)
+{
+    size_t lb = GRANULES_TO_BYTES(granules);
+    struct obj_kind *ok = &GC_obj_kinds[kind];
+    struct hblk *h = NULL;
+    DCL_LOCK_STATE;
+
+    LOCK();
+    if (GC_incremental && !GC_dont_gc) {
+      /* Do our share of marking work.  */
+      ENTER_GC();
+      GC_collect_a_little_or_notify(1);
+      EXIT_GC();
+    }
+#   ifdef SHARDED_FREE_LISTS
+      GC_flush_fl_shard(kind, granules);
 #   endif
+    if (NULL == ok -> ok_freelist[granules]
+        && (NULL == ok -> ok_reclaim_list
+            || NULL == ok -> ok_reclaim_list[granules]))
+      h = GC_allochblk(lb, kind, 0 /* flags */);
+    if (h != NULL) {
+      size_t n_bytes = HBLKSIZE - HBLKSIZE % lb;
+
+      GC_bytes_allocd += n_bytes;
+      if (ok -> ok_init || GC_debugging_started)
+        BZERO(h, n_bytes);
+      p -> bump_ptr[kind][granules] = (ptr_t)h + lb;
+      p -> bump_limit[kind][granules] = (ptr_t)h + n_bytes - 1;
+    }
+    UNLOCK();
+    return h;
+}
+
+/* Allocate an object of the given size by bumping the pointer of the   */
+/* corresponding buffer of the thread.  Once the buffer is exhausted,   */
+/* the thread-local free list of the size is used while it is non-empty */
+/* (or while the thread has allocated too few objects of the size), the */
+/* buffer is refilled when the free list would be.  Returns NULL if the */
+/* object should be allocated from the free list (the buffers are not   */
+/* used in the manual VDB mode as the objects handed out are not passed */
+/* to GC_dirty).  The buffer limit is the last byte of the block        */
+/* objects (rather than the end) not to point to the next block; the    */
+/* fast path does a single store, thus a collection never observes the  */
+/* buffer partially updated.                                            */
+GC_INLINE void *bump_alloc(GC_tlfs p, size_t granules, int kind)
+{
+    size_t lb = GRANULES_TO_BYTES(granules);
+    ptr_t q = p -> bump_ptr[kind][granules];
+    word entry;
+
+    if (EXPECT((signed_word)(p -> bump_limit[kind][granules] - q)
+                >= (signed_word)lb - 1, TRUE)) {
+      p -> bump_ptr[kind][granules] = q + lb;
+      return q;
+    }
+    entry = (word)(p -> _freelists[kind][granules]);
+    if (entry > DIRECT_GRANULES + TINY_FREELISTS + 1
+        || (entry != 0 && entry <= DIRECT_GRANULES) || GC_manual_vdb)
+      return NULL;
+    q = (ptr_t)bump_alloc_refill(p, granules, kind);
+    GC_HEAP_PROF_SAMPLE(q, lb);
+    GC_LIFETIME_SAMPLE(q);
+    return q;
 }
 
+#ifdef THREAD_STATS
+  /* Account the objects of the just refilled free list (fl is the rest */
+  /* of it after the allocation of one object of the given size).       */
+  static void note_refill(GC_tlfs p, void *fl, size_t granules)
+  {
+    word n = 1;
+    size_t bytes = granules > 0 ? GRANULES_TO_BYTES(granules)
+                    : GRANULE_BYTES;
+    int i = 0;
+
+    for (; fl != NULL; fl = obj_link(fl))
+      n++;
+    while (i < GC_THREAD_STATS_SIZE_CLASSES - 1 && bytes > ((size_t)16 << i))
+      i++;
+    p -> refill_bytes += n * bytes;
+    p -> refill_count++;
+    p -> refill_objs[i] += n;
+  }
+#endif /* THREAD_STATS */
+
 GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc_kind(size_t bytes, int kind)
 {
     size_t granules;
     void *tsd;
     void *result;
+    void **tiny_fl;
+#   ifdef THREAD_STATS
+      void **refill_fl = NULL;
+#   endif
 
 #   if MAXOBJKINDS > THREAD_FREELISTS_KINDS
-      if (EXPECT(kind >= THREAD_FREELISTS_KINDS, FALSE)) {
+      if (EXPECT(kind >= THREAD_FREELISTS_KINDS, FALSE)
+          && kind != GC_explicit_kind && !KIND_HAS_TLFL(kind)) {
         return GC_malloc_kind_global(bytes, kind);
       }
 #   endif
@@ -178,16 +447,59 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc_kind(size_t bytes, int kind)
     GC_ASSERT(GC_is_initialized);
     GC_ASSERT(GC_is_thread_tsd_valid(tsd));
     granules = ROUNDED_UP_GRANULES(bytes);
+    if (EXPECT(kind < THREAD_FREELISTS_KINDS, TRUE)) {
+      tiny_fl = ((GC_tlfs)tsd) -> _freelists[kind];
+    } else if (kind == GC_explicit_kind) {
+#     ifdef CONCURRENT_MARK
+        /* The descriptor is stored after the object is taken from the  */
+        /* thread-local list, the concurrent marker could see it before */
+        /* that, thus the global free list is used instead.             */
+        if (GC_concurrent_mark)
+          return GC_malloc_kind_global(bytes, kind);
+#     endif
+      tiny_fl = ((GC_tlfs)tsd) -> typed_freelists;
+    } else {
+#     if MAXOBJKINDS > THREAD_FREELISTS_KINDS
+        tiny_fl = ((GC_tlfs)tsd) -> kind_freelists[kind
+                                                - THREAD_FREELISTS_KINDS];
+        if (EXPECT(NULL == tiny_fl, FALSE)) {
+          tiny_fl = new_kind_freelists((GC_tlfs)tsd, kind);
+          if (NULL == tiny_fl)
+            return GC_malloc_kind_global(bytes, kind);
+        }
+#     else
+        return GC_malloc_kind_global(bytes, kind); /* unreachable */
+#     endif
+    }
 #   if defined(CPPCHECK)
 #     define MALLOC_KIND_PTRFREE_INIT (void*)1
 #   else
 #     define MALLOC_KIND_PTRFREE_INIT NULL
 #   endif
-    GC_FAST_MALLOC_GRANS(result, granules,
-                         ((GC_tlfs)tsd) -> _freelists[kind], DIRECT_GRANULES,
+    if (EXPECT(GC_bump_alloc, FALSE) && kind < THREAD_FREELISTS_KINDS
+        && granules - 1 < TINY_FREELISTS - 1) {
+      result = bump_alloc((GC_tlfs)tsd, granules, kind);
+      if (EXPECT(result != NULL, TRUE))
+        return result;
+    }
+#   ifdef THREAD_STATS
+      if (EXPECT(granules < TINY_FREELISTS, TRUE)) {
+        word entry = (word)tiny_fl[granules];
+
+        /* Check whether GC_FAST_MALLOC_GRANS will refill the list.     */
+        if (EXPECT(entry <= DIRECT_GRANULES + TINY_FREELISTS + 1, FALSE)
+            && (entry > DIRECT_GRANULES || 0 == entry))
+          refill_fl = &tiny_fl[granules];
+      }
+#   endif
+    GC_FAST_MALLOC_GRANS(result, granules, tiny_fl, DIRECT_GRANULES,
                          kind, GC_malloc_kind_global(bytes, kind),
                          (void)(kind == PTRFREE ? MALLOC_KIND_PTRFREE_INIT
                                                : (obj_link(result) = 0)));
+#   ifdef THREAD_STATS
+      if (EXPECT(refill_fl != NULL, FALSE) && result != NULL)
+        note_refill((GC_tlfs)tsd, *refill_fl, granules);
+#   endif
 #   ifdef LOG_ALLOCS
       GC_log_printf("GC_malloc_kind(%lu, %d) returned %p, recent GC #%lu\n",
                     (unsigned long)bytes, kind, result,
@@ -196,6 +508,206 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc_kind(size_t bytes, int kind)
     return result;
 }
 
+GC_INNER GC_bool GC_batch_free(void *p)
+{
+    void *tsd;
+    GC_tlfs tlfs;
+    word n;
+
+    if (!EXPECT(GC_batched_free, FALSE))
+      return FALSE;
+#   if !defined(USE_PTHREAD_SPECIFIC) && !defined(USE_WIN32_SPECIFIC)
+    {
+      GC_key_t k = GC_thread_key;
+
+      if (EXPECT(0 == k, FALSE))
+        return FALSE;
+      tsd = GC_getspecific(k);
+    }
+#   else
+      if (!EXPECT(keys_initialized, TRUE))
+        return FALSE;
+      tsd = GC_getspecific(GC_thread_key);
+#   endif
+#   if !defined(USE_COMPILER_TLS) && !defined(USE_WIN32_COMPILER_TLS)
+      if (EXPECT(0 == tsd, FALSE))
+        return FALSE;
+#   endif
+    GC_ASSERT(GC_is_thread_tsd_valid(tsd));
+    tlfs = (GC_tlfs)tsd;
+    n = tlfs -> free_batch_len;
+    GC_ASSERT(n < FREE_BATCH_SZ);
+    tlfs -> free_batch[n] = p;
+    /* Store the entry before the length, as the batch might be marked  */
+    /* by GC_mark_thread_local_fls_for in between.                      */
+    AO_store_release((volatile AO_t *)&(tlfs -> free_batch_len),
+                     (AO_t)(n + 1));
+    if (EXPECT(n + 1 == FREE_BATCH_SZ, FALSE)) {
+      /* The length is reset only after the objects are on the free     */
+      /* lists, otherwise they could be reclaimed by a collection       */
+      /* occurring before GC_free_n acquires the lock.                  */
+      GC_free_n(tlfs -> free_batch, FREE_BATCH_SZ);
+      AO_store((volatile AO_t *)&(tlfs -> free_batch_len), 0);
+    }
+    return TRUE;
+}
+
+/* Return the thread-local free lists of the current thread, or NULL.  */
+/* The allocation lock may be held.                                     */
+static GC_tlfs current_tlfs(void)
+{
+    void *tsd;
+
+#   if !defined(USE_PTHREAD_SPECIFIC) && !defined(USE_WIN32_SPECIFIC)
+    {
+      GC_key_t k = GC_thread_key;
+
+      if (EXPECT(0 == k, FALSE))
+        return NULL;
+      tsd = GC_getspecific(k);
+    }
+#   else
+      if (!EXPECT(keys_initialized, TRUE))
+        return NULL;
+      tsd = GC_getspecific(GC_thread_key);
+#   endif
+    /* GC_is_thread_tsd_valid() is not checked as it acquires the lock. */
+    return (GC_tlfs)tsd;
+}
+
+GC_INNER void GC_add_mark_assist_debt(word bytes)
+{
+    GC_tlfs p = current_tlfs();
+
+    if (EXPECT(p != NULL, TRUE))
+      p -> assist_debt += bytes;
+}
+
+GC_INNER int GC_take_mark_assist_units(void)
+{
+    GC_tlfs p = current_tlfs();
+    word units;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    if (EXPECT(NULL == p, FALSE))
+      return 1; /* no per-thread accounting, one unit per refill */
+    if (!GC_collection_in_progress()) {
+      /* Only the allocation during a cycle is charged.     */
+      p -> assist_debt = 0;
+      return 0;
+    }
+    units = p -> assist_debt / HBLKSIZE;
+    p -> assist_debt -= units * HBLKSIZE;
+    return units < (word)MAX_ASSIST_UNITS ? (int)units : MAX_ASSIST_UNITS;
+}
+
+GC_INNER GC_bool GC_free_to_local_fl(void *p)
+{
+    void *tsd;
+    hdr *hhdr;
+    size_t granules;
+    int knd;
+    void **my_fl;
+    word entry;
+
+#   if !defined(USE_PTHREAD_SPECIFIC) && !defined(USE_WIN32_SPECIFIC)
+    {
+      GC_key_t k = GC_thread_key;
+
+      if (EXPECT(0 == k, FALSE))
+        return FALSE;
+      tsd = GC_getspecific(k);
+    }
+#   else
+      if (!EXPECT(keys_initialized, TRUE))
+        return FALSE;
+      tsd = GC_getspecific(GC_thread_key);
+#   endif
+#   if !defined(USE_COMPILER_TLS) && !defined(USE_WIN32_COMPILER_TLS)
+      if (EXPECT(0 == tsd, FALSE))
+        return FALSE;
+#   endif
+    GC_ASSERT(GC_is_thread_tsd_valid(tsd));
+    hhdr = HDR(p);
+    if (EXPECT(NULL == hhdr, FALSE) || GC_manual_vdb)
+      return FALSE;
+    knd = hhdr -> hb_obj_kind;
+    granules = BYTES_TO_GRANULES((size_t)(hhdr -> hb_sz));
+    if (knd > NORMAL || granules >= TINY_FREELISTS)
+      return FALSE;
+#   ifdef ENABLE_DISCLAIM
+      if (EXPECT((hhdr -> hb_flags & HAS_DISCLAIM) != 0, FALSE))
+        return FALSE;
+#   endif
+    GC_ASSERT(GC_base(p) == p);
+    my_fl = &(((GC_tlfs)tsd) -> _freelists[knd][granules]);
+    entry = (word)(*my_fl);
+    /* A counter (or the value set by GC_destroy_thread_local) cannot  */
+    /* be the link of an object.                                        */
+    if (entry != 0 && entry <= HBLKSIZE)
+      return FALSE;
+    if (NORMAL == knd)
+      BZERO((word *)p + 1, GRANULES_TO_BYTES(granules) - sizeof(word));
+    /* p is reachable from the stack (or marked as a part of the list)  */
+    /* if a collection occurs in between.                               */
+    obj_link(p) = (ptr_t)entry;
+    *my_fl = p;
+    return TRUE;
+}
+
+GC_INNER void *GC_take_typed_tlfl(size_t granules, word tail)
+{
+    void *tsd;
+    void **flh;
+    void *result, *p;
+    size_t lw = GRANULES_TO_WORDS(granules);
+
+    GC_ASSERT(granules > 0 && GC_explicit_kind != 0);
+    if (EXPECT(granules >= TINY_FREELISTS, FALSE))
+      return NULL;
+#   ifdef CONCURRENT_MARK
+      /* Same as in GC_malloc_kind, the descriptors are stored while    */
+      /* the concurrent marker could see the list.                      */
+      if (GC_concurrent_mark)
+        return NULL;
+#   endif
+#   if !defined(USE_PTHREAD_SPECIFIC) && !defined(USE_WIN32_SPECIFIC)
+    {
+      GC_key_t k = GC_thread_key;
+
+      if (EXPECT(0 == k, FALSE))
+        return NULL;
+      tsd = GC_getspecific(k);
+    }
+#   else
+      if (!EXPECT(keys_initialized, TRUE))
+        return NULL;
+      tsd = GC_getspecific(GC_thread_key);
+#   endif
+#   if !defined(USE_COMPILER_TLS) && !defined(USE_WIN32_COMPILER_TLS)
+      if (EXPECT(0 == tsd, FALSE))
+        return NULL;
+#   endif
+    GC_ASSERT(GC_is_thread_tsd_valid(tsd));
+    flh = &(((GC_tlfs)tsd) -> typed_freelists[granules]);
+    if ((word)(*flh) <= DIRECT_GRANULES + TINY_FREELISTS + 1) {
+      /* The list is empty or not used yet; the caller intends to       */
+      /* consume many objects, so refill it unconditionally.            */
+      GC_generic_malloc_many(GRANULES_TO_BYTES(granules), GC_explicit_kind,
+                             flh);
+      if (EXPECT(NULL == *flh, FALSE))
+        return NULL; /* out of memory; let the caller retry globally */
+    }
+    result = *flh;
+    /* The objects are still marked as a part of the thread-local free  */
+    /* list if a collection occurs before we finish.                    */
+    for (p = result; p != NULL; p = obj_link(p))
+      ((word *)p)[lw - 1] = tail;
+    AO_compiler_barrier();
+    *flh = NULL;
+    return result;
+}
+
 #ifdef GC_GCJ_SUPPORT
 
 # include "gc/gc_gcj.h"
@@ -216,16 +728,31 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc_kind(size_t bytes, int kind)
 /* links to the second word of each object.  The latter isn't a         */
 /* universal win, since on architecture like Itanium, nonzero offsets   */
 /* are not necessarily free.  And there may be cache fill order issues. */
-/* For now, we punt with incremental GC.  This probably means that      */
-/* incremental GC should be enabled before we fork a second thread.     */
-/* Unlike the other thread local allocation calls, we assume that the   */
-/* collector has been explicitly initialized.                           */
+/* We use such a handshake (if INCREMENTAL_GCJ_TLFL): in the            */
+/* incremental mode, the "vtable" pointer store is followed by a write  */
+/* barrier, so it is visible before any store to this or the next       */
+/* allocated object; the marker, in turn, re-reads the first word of    */
+/* the object after loading the descriptor (with the acquire barrier)   */
+/* and retries if the word has changed.  Otherwise, we punt with        */
+/* incremental GC.  This probably means that incremental GC should be   */
+/* enabled before we fork a second thread.  Unlike the other thread     */
+/* local allocation calls, we assume that the collector has been        */
+/* explicitly initialized.                                              */
+#ifdef INCREMENTAL_GCJ_TLFL
+# define GCJ_VTABLE_WRITE_BARRIER() \
+        do { if (EXPECT(GC_incremental, FALSE)) AO_nop_write(); } while (0)
+#else
+# define GCJ_VTABLE_WRITE_BARRIER() (void)0
+#endif
+
 GC_API GC_ATTR_MALLOC void * GC_CALL GC_gcj_malloc(size_t bytes,
                                     void * ptr_to_struct_containing_descr)
 {
-  if (EXPECT(GC_incremental, FALSE)) {
-    return GC_core_gcj_malloc(bytes, ptr_to_struct_containing_descr);
-  } else {
+# ifndef INCREMENTAL_GCJ_TLFL
+    if (EXPECT(GC_incremental, FALSE))
+      return GC_core_gcj_malloc(bytes, ptr_to_struct_containing_descr);
+# endif
+  {
     size_t granules = ROUNDED_UP_GRANULES(bytes);
     void *result;
     void **tiny_fl;
@@ -237,7 +764,8 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_gcj_malloc(size_t bytes,
                          GC_core_gcj_malloc(bytes,
                                             ptr_to_struct_containing_descr),
                          {AO_compiler_barrier();
-                          *(void **)result = ptr_to_struct_containing_descr;});
+                          *(void **)result = ptr_to_struct_containing_descr;
+                          GCJ_VTABLE_WRITE_BARRIER();});
         /* This forces the initialization of the "method ptr".          */
         /* This is necessary to ensure some very subtle properties      */
         /* required if a GC is run in the middle of such an allocation. */
@@ -262,6 +790,29 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_gcj_malloc(size_t bytes,
 
 #endif /* GC_GCJ_SUPPORT */
 
+/* Set the mark bits of the objects not yet handed out from  */
+/* a bump-pointer buffer, i.e. of those from q up to limit.   */
+static void set_bump_marks(ptr_t q, ptr_t limit)
+{
+    struct hblk *h;
+    hdr *hhdr;
+    word sz;
+
+    if (NULL == q || (word)q > (word)limit) return;
+    h = HBLKPTR(q);
+    hhdr = HDR(h);
+    sz = hhdr -> hb_sz;
+    VALIDATE_MARKS(hhdr);
+    for (; (word)q < (word)limit; q += sz) {
+      word bit_no = MARK_BIT_NO(q - (ptr_t)h, sz);
+
+      if (!mark_bit_from_hdr(hhdr, bit_no)) {
+        set_mark_bit_from_hdr(hhdr, bit_no);
+        ++hhdr -> hb_n_marks;
+      }
+    }
+}
+
 /* The thread support layer must arrange to mark thread-local   */
 /* free lists explicitly, since the link field is often         */
 /* invisible to the marker.  It knows how to find all threads;  */
@@ -270,6 +821,7 @@ GC_INNER void GC_mark_thread_local_fls_for(GC_tlfs p)
 {
     ptr_t q;
     int i, j;
+    word k, n;
 
     for (j = 0; j < TINY_FREELISTS; ++j) {
       for (i = 0; i < THREAD_FREELISTS_KINDS; ++i) {
@@ -278,6 +830,7 @@ GC_INNER void GC_mark_thread_local_fls_for(GC_tlfs p)
         q = (ptr_t)AO_load((volatile AO_t *)&p->_freelists[i][j]);
         if ((word)q > HBLKSIZE)
           GC_set_fl_marks(q);
+        set_bump_marks(p -> bump_ptr[i][j], p -> bump_limit[i][j]);
       }
 #     ifdef GC_GCJ_SUPPORT
         if (EXPECT(j > 0, TRUE)) {
@@ -285,8 +838,22 @@ GC_INNER void GC_mark_thread_local_fls_for(GC_tlfs p)
           if ((word)q > HBLKSIZE)
             GC_set_fl_marks(q);
         }
+#     endif
+      q = (ptr_t)AO_load((volatile AO_t *)&p->typed_freelists[j]);
+      if ((word)q > HBLKSIZE)
+        GC_set_fl_marks(q);
+#     if MAXOBJKINDS > THREAD_FREELISTS_KINDS
+        for (i = 0; i < MAXOBJKINDS - THREAD_FREELISTS_KINDS; ++i) {
+          if (NULL == p->kind_freelists[i]) continue;
+          q = (ptr_t)AO_load((volatile AO_t *)&p->kind_freelists[i][j]);
+          if ((word)q > HBLKSIZE)
+            GC_set_fl_marks(q);
+        }
 #     endif
     }
+    n = (word)AO_load((volatile AO_t *)&(p -> free_batch_len));
+    for (k = 0; k < n; ++k)
+      GC_set_mark_bit(p -> free_batch[k]);
 }
 
 #if defined(GC_ASSERTIONS)
@@ -301,6 +868,13 @@ GC_INNER void GC_mark_thread_local_fls_for(GC_tlfs p)
           }
 #         ifdef GC_GCJ_SUPPORT
             GC_check_fl_marks(&p->gcj_freelists[j]);
+#         endif
+          GC_check_fl_marks(&p->typed_freelists[j]);
+#         if MAXOBJKINDS > THREAD_FREELISTS_KINDS
+            for (i = 0; i < MAXOBJKINDS - THREAD_FREELISTS_KINDS; ++i) {
+              if (p->kind_freelists[i] != NULL)
+                GC_check_fl_marks(&p->kind_freelists[i][j]);
+            }
 #         endif
         }
     }
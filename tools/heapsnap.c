@@ -0,0 +1,395 @@
+/*
+ * Copyright (c) 2023 Ivan Maidanski
+ *
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose, provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/* A reader of the heap snapshots written by GC_write_heap_snapshot     */
+/* (see heapprof.c for the format).  Usage:                             */
+/*   heapsnap <file>            - print the summary (per kind, the      */
+/*                                biggest and the most referenced       */
+/*                                objects);                             */
+/*   heapsnap <file> -o <addr>  - print the object containing the given */
+/*                                address with its references and       */
+/*                                referrers;                            */
+/*   heapsnap <file> -p <addr>  - print a shortest chain of references  */
+/*                                retaining the object from a static    */
+/*                                root (or from an object referenced    */
+/*                                from nowhere in the heap, i.e. from   */
+/*                                a thread stack presumably).           */
+/* The snapshot should be read on a machine of the same word size.      */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef unsigned long long u64;
+
+struct object {
+    u64 addr;
+    u64 size;
+    unsigned kind;
+    int root_refd;      /* referenced from a static root        */
+    size_t first_edge;  /* index in the edges array             */
+    size_t n_edges;
+    size_t n_refs;      /* number of the referrers              */
+    size_t first_ref;   /* index in the referrers array         */
+};
+
+static struct object *objs;
+static size_t n_objs, objs_cap;
+static u64 *edges;      /* target addresses, then indices       */
+static size_t n_edges, edges_cap;
+static size_t *refs;    /* referrer indices grouped by target   */
+static size_t n_roots;
+
+static const unsigned char *data;
+static size_t data_len, pos;
+
+static void fail(const char *msg)
+{
+    fprintf(stderr, "heapsnap: %s\n", msg);
+    exit(1);
+}
+
+static u64 get_varint(void)
+{
+    u64 v = 0;
+    int shift = 0;
+
+    for (;;) {
+      unsigned char c;
+
+      if (pos >= data_len) fail("truncated snapshot");
+      c = data[pos++];
+      v |= (u64)(c & 0x7f) << shift;
+      if ((c & 0x80) == 0) return v;
+      shift += 7;
+      if (shift >= 64) fail("bad varint");
+    }
+}
+
+static long long unzigzag(u64 v)
+{
+    return (long long)(v >> 1) ^ -(long long)(v & 1);
+}
+
+static void add_edge(u64 target)
+{
+    if (n_edges == edges_cap) {
+      edges_cap = edges_cap ? edges_cap * 2 : 1024;
+      edges = (u64 *)realloc(edges, edges_cap * sizeof(u64));
+      if (NULL == edges) fail("out of memory");
+    }
+    edges[n_edges++] = target;
+}
+
+/* Read the edges list of an object or a root at the given address.     */
+static void read_edges(u64 origin)
+{
+    u64 v;
+
+    while ((v = get_varint()) != 0)
+      add_edge(origin + (u64)unzigzag(v - 1));
+}
+
+static void read_snapshot(const char *fname)
+{
+    FILE *f = fopen(fname, "rb");
+    size_t cap = 1 << 20;
+    unsigned char *buf;
+    u64 prev_addr = 0;
+
+    if (NULL == f) fail("cannot open the file");
+    buf = (unsigned char *)malloc(cap);
+    for (;;) {
+      size_t n;
+
+      if (NULL == buf) fail("out of memory");
+      n = fread(buf + data_len, 1, cap - data_len, f);
+      data_len += n;
+      if (data_len < cap) break;
+      cap *= 2;
+      buf = (unsigned char *)realloc(buf, cap);
+    }
+    fclose(f);
+    data = buf;
+    if (data_len < 8 || memcmp(data, "GCSNAP1", 8) != 0)
+      fail("not a heap snapshot");
+    pos = 8;
+    if (get_varint() != sizeof(void *))
+      fail("the snapshot word size differs");
+    printf("Snapshot after GC #%llu\n", get_varint());
+
+    for (;;) {
+      u64 tag = get_varint();
+
+      if (0 == tag) break;
+      if (1 == tag) {
+        struct object *o;
+
+        if (n_objs == objs_cap) {
+          objs_cap = objs_cap ? objs_cap * 2 : 1024;
+          objs = (struct object *)realloc(objs,
+                                          objs_cap * sizeof(struct object));
+          if (NULL == objs) fail("out of memory");
+        }
+        o = &objs[n_objs++];
+        memset(o, 0, sizeof(*o));
+        o -> addr = prev_addr + (u64)unzigzag(get_varint());
+        o -> size = get_varint();
+        o -> kind = (unsigned)get_varint();
+        o -> first_edge = n_edges;
+        read_edges(o -> addr);
+        o -> n_edges = n_edges - o -> first_edge;
+        prev_addr = o -> addr;
+      } else if (2 == tag) {
+        u64 start = get_varint();
+
+        (void)get_varint(); /* length */
+        /* The root references are resolved once all objects are read. */
+        read_edges(start);
+        n_roots++;
+      } else {
+        fail("bad record");
+      }
+    }
+}
+
+static int cmp_objs(const void *a, const void *b)
+{
+    u64 x = ((const struct object *)a) -> addr;
+    u64 y = ((const struct object *)b) -> addr;
+
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/* Return the index of the object containing addr, or n_objs.          */
+static size_t find_object(u64 addr)
+{
+    size_t lo = 0, hi = n_objs;
+
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+
+      if (objs[mid].addr + objs[mid].size <= addr) {
+        lo = mid + 1;
+      } else if (objs[mid].addr > addr) {
+        hi = mid;
+      } else {
+        return mid;
+      }
+    }
+    return n_objs;
+}
+
+/* Sort the objects, resolve the edges to the object indices, mark the  */
+/* objects referenced from the roots and build the referrers lists.     */
+static void build_graph(void)
+{
+    size_t i, j, n_obj_edges = 0;
+    size_t *fill;
+
+    /* The objects are written by blocks, and the edges of an object    */
+    /* are stored contiguously, thus the sort keeps them valid.         */
+    qsort(objs, n_objs, sizeof(struct object), cmp_objs);
+    for (i = 0; i < n_objs; i++)
+      n_obj_edges += objs[i].n_edges;
+    /* The edges not owned by any object are the root references.     */
+    {
+      char *owned = (char *)calloc(n_edges + 1, 1);
+
+      if (NULL == owned) fail("out of memory");
+      for (i = 0; i < n_objs; i++)
+        memset(owned + objs[i].first_edge, 1, objs[i].n_edges);
+      for (j = 0; j < n_edges; j++) {
+        size_t k = find_object(edges[j]);
+
+        if (!owned[j] && k < n_objs) objs[k].root_refd = 1;
+        edges[j] = k;
+      }
+      free(owned);
+    }
+    for (i = 0; i < n_objs; i++) {
+      for (j = 0; j < objs[i].n_edges; j++) {
+        size_t k = (size_t)edges[objs[i].first_edge + j];
+
+        if (k < n_objs) objs[k].n_refs++;
+      }
+    }
+    refs = (size_t *)malloc((n_obj_edges + 1) * sizeof(size_t));
+    fill = (size_t *)calloc(n_objs + 1, sizeof(size_t));
+    if (NULL == refs || NULL == fill) fail("out of memory");
+    for (i = 0, j = 0; i < n_objs; i++) {
+      objs[i].first_ref = j;
+      j += objs[i].n_refs;
+    }
+    for (i = 0; i < n_objs; i++) {
+      for (j = 0; j < objs[i].n_edges; j++) {
+        size_t k = (size_t)edges[objs[i].first_edge + j];
+
+        if (k < n_objs) refs[objs[k].first_ref + fill[k]++] = i;
+      }
+    }
+    free(fill);
+}
+
+static void print_object(size_t i)
+{
+    printf("0x%llx: %llu bytes, kind %u, %lu refs, %lu referrers%s\n",
+           objs[i].addr, objs[i].size, objs[i].kind,
+           (unsigned long)objs[i].n_edges, (unsigned long)objs[i].n_refs,
+           objs[i].root_refd ? ", static root" : "");
+}
+
+#define TOP_N 10
+
+static void print_top(const char *title, int by_refs)
+{
+    size_t top[TOP_N];
+    size_t n = 0, i, j;
+
+    for (i = 0; i < n_objs; i++) {
+      u64 v = by_refs ? objs[i].n_refs : objs[i].size;
+
+      for (j = n; j > 0; j--) {
+        u64 w = by_refs ? objs[top[j - 1]].n_refs : objs[top[j - 1]].size;
+
+        if (w >= v) break;
+        if (j < TOP_N) top[j] = top[j - 1];
+      }
+      if (j < TOP_N) {
+        top[j] = i;
+        if (n < TOP_N) n++;
+      }
+    }
+    printf("%s:\n", title);
+    for (i = 0; i < n; i++) {
+      printf("  ");
+      print_object(top[i]);
+    }
+}
+
+static void print_summary(void)
+{
+    u64 kind_cnt[256], kind_bytes[256];
+    u64 total = 0;
+    size_t i, n_unrefd = 0;
+
+    memset(kind_cnt, 0, sizeof(kind_cnt));
+    memset(kind_bytes, 0, sizeof(kind_bytes));
+    for (i = 0; i < n_objs; i++) {
+      unsigned k = objs[i].kind & 0xff;
+
+      kind_cnt[k]++;
+      kind_bytes[k] += objs[i].size;
+      total += objs[i].size;
+      if (0 == objs[i].n_refs && !objs[i].root_refd) n_unrefd++;
+    }
+    printf("%lu objects, %llu bytes, %lu static root sets\n",
+           (unsigned long)n_objs, total, (unsigned long)n_roots);
+    for (i = 0; i < 256; i++) {
+      if (kind_cnt[i] != 0)
+        printf("  kind %u: %llu objects, %llu bytes\n", (unsigned)i,
+               kind_cnt[i], kind_bytes[i]);
+    }
+    printf("%lu objects referenced only from stacks (or registers)\n",
+           (unsigned long)n_unrefd);
+    print_top("Biggest objects", 0);
+    print_top("Most referenced objects", 1);
+}
+
+static void print_refs(size_t i)
+{
+    size_t j;
+
+    print_object(i);
+    printf("References:\n");
+    for (j = 0; j < objs[i].n_edges; j++) {
+      size_t k = (size_t)edges[objs[i].first_edge + j];
+
+      if (k < n_objs) {
+        printf("  ");
+        print_object(k);
+      }
+    }
+    printf("Referrers:\n");
+    for (j = 0; j < objs[i].n_refs; j++) {
+      printf("  ");
+      print_object(refs[objs[i].first_ref + j]);
+    }
+}
+
+/* Breadth-first search over the referrers from the object to a root.  */
+static void print_path(size_t target)
+{
+    size_t *queue = (size_t *)malloc((n_objs + 1) * sizeof(size_t));
+    size_t *next = (size_t *)malloc((n_objs + 1) * sizeof(size_t));
+    size_t head = 0, tail = 0, i;
+
+    if (NULL == queue || NULL == next) fail("out of memory");
+    for (i = 0; i < n_objs; i++)
+      next[i] = (size_t)-1;
+    next[target] = target;
+    queue[tail++] = target;
+    while (head < tail) {
+      size_t cur = queue[head++];
+
+      if (objs[cur].root_refd || 0 == objs[cur].n_refs) {
+        printf("Retained by:\n");
+        for (;;) {
+          printf("  ");
+          print_object(cur);
+          if (cur == target) break;
+          cur = next[cur];
+        }
+        free(queue);
+        free(next);
+        return;
+      }
+      for (i = 0; i < objs[cur].n_refs; i++) {
+        size_t r = refs[objs[cur].first_ref + i];
+
+        if (next[r] == (size_t)-1) {
+          next[r] = cur;
+          queue[tail++] = r;
+        }
+      }
+    }
+    printf("No retaining chain found (a reference cycle from a stack?)\n");
+    free(queue);
+    free(next);
+}
+
+int main(int argc, char **argv)
+{
+    size_t i;
+
+    if (argc != 2 && argc != 4) {
+      fprintf(stderr, "Usage: %s <file> [-o|-p <address>]\n", argv[0]);
+      return 2;
+    }
+    read_snapshot(argv[1]);
+    build_graph();
+    if (2 == argc) {
+      print_summary();
+      return 0;
+    }
+    i = find_object(strtoull(argv[3], NULL, 16));
+    if (i == n_objs) fail("no object at the address");
+    if (0 == strcmp(argv[2], "-o")) {
+      print_refs(i);
+    } else if (0 == strcmp(argv[2], "-p")) {
+      print_path(i);
+    } else {
+      fail("unknown option");
+    }
+    return 0;
+}
@@ -42,7 +42,7 @@
 
 #define TYPD_EXTRA_BYTES (sizeof(word) - EXTRA_BYTES)
 
-STATIC int GC_explicit_kind = 0;
+GC_INNER int GC_explicit_kind = 0;
                         /* Object kind for objects with indirect        */
                         /* (possibly extended) descriptors.             */
 
@@ -55,21 +55,133 @@ STATIC int GC_array_kind = 0;
 STATIC int GC_typed_mark_proc_index = 0; /* Indices of my mark          */
 STATIC int GC_array_mark_proc_index = 0; /* procedures.                 */
 
+/* The descriptors are hash-consed, i.e. the identical extended        */
+/* descriptors (and complex array descriptors) are built only once and  */
+/* shared.  The caches are looked up without the lock (if the atomic    */
+/* acquire/release operations are available); the entries are immutable */
+/* once published.                                                      */
+#if defined(AO_HAVE_load_acquire) && defined(AO_HAVE_store_release)
+# define DESCR_CACHE_LOCK_FREE
+# define DESCR_CACHE_LOAD(p) ((void *)AO_load_acquire((volatile AO_t *)&(p)))
+# define DESCR_CACHE_STORE(p, v) \
+                AO_store_release((volatile AO_t *)&(p), (AO_t)(v))
+#else
+# define DESCR_CACHE_LOAD(p) ((void *)(p))
+# define DESCR_CACHE_STORE(p, v) (void)((p) = (v))
+#endif
+
+#ifndef EXT_DESCR_CACHE_SIZE
+# define EXT_DESCR_CACHE_SIZE 256 /* power of two */
+#endif
+
+#if !defined(THREADS) || defined(DESCR_CACHE_LOCK_FREE)
+# define USE_ARRAY_DESCR_CACHE
+#endif
+
+#ifndef ARRAY_DESCR_CACHE_SIZE
+# define ARRAY_DESCR_CACHE_SIZE 64 /* power of two */
+#endif
+
+struct ext_descr_cache_entry {
+  struct ext_descr_cache_entry *next;
+  word nbits;
+  signed_word index;    /* the index in GC_ext_descriptors              */
+  word bm[1];           /* the bitmap with the irrelevant (highest)     */
+                        /* bits of the last word cleared                */
+};
+
+/* The extended descriptors hashed by the bitmap.  Allocated by         */
+/* GC_scratch_alloc, thus never deallocated.                            */
+STATIC struct ext_descr_cache_entry *GC_ext_descr_cache[EXT_DESCR_CACHE_SIZE];
+
+#ifdef USE_ARRAY_DESCR_CACHE
+  struct array_descr_cache_entry {
+    word nelements;
+    word size;
+    GC_descr d;
+    union ComplexDescriptor *complex_d;
+  };
+
+  /* The most recently built complex array descriptors, hashed by the   */
+  /* array length, the element size and descriptor (the older entry is  */
+  /* replaced on a collision).  The entries are collectible, thus the   */
+  /* table is pushed by GC_push_typed_structures_proc.                  */
+  STATIC struct array_descr_cache_entry
+                        *GC_array_descr_cache[ARRAY_DESCR_CACHE_SIZE];
+#endif
+
 STATIC void GC_push_typed_structures_proc(void)
 {
   GC_PUSH_ALL_SYM(GC_ext_descriptors);
+# ifdef USE_ARRAY_DESCR_CACHE
+    GC_PUSH_ALL_SYM(GC_array_descr_cache);
+# endif
 }
 
-/* Add a multiword bitmap to GC_ext_descriptors arrays.         */
-/* Returns starting index on success, -1 otherwise.             */
+#define EXT_DESCR_LAST_MASK(nwords, nbits) \
+                (GC_WORD_MAX >> ((nwords) * WORDSZ - (nbits)))
+
+STATIC word GC_ext_descr_hash(const word *bm, word nbits)
+{
+  size_t nwords = divWORDSZ(nbits + WORDSZ-1);
+  word h = nbits;
+  size_t i;
+
+  for (i = 0; i < nwords-1; i++)
+    h = h * 31 + bm[i];
+  h = h * 31 + (bm[i] & EXT_DESCR_LAST_MASK(nwords, nbits));
+  return (h ^ (h >> 8) ^ (h >> 16)) & (EXT_DESCR_CACHE_SIZE - 1);
+}
+
+/* Find the extended descriptor built earlier for the given bitmap.     */
+/* Returns its starting index, or -1 if none.  Could be called without  */
+/* the lock if DESCR_CACHE_LOCK_FREE.                                   */
+STATIC signed_word GC_find_ext_descriptor(const word *bm, word nbits,
+                                          word h)
+{
+  size_t nwords = divWORDSZ(nbits + WORDSZ-1);
+  word last = bm[nwords-1] & EXT_DESCR_LAST_MASK(nwords, nbits);
+  struct ext_descr_cache_entry *e;
+
+  for (e = (struct ext_descr_cache_entry *)
+                DESCR_CACHE_LOAD(GC_ext_descr_cache[h]);
+       e != NULL; e = e -> next) {
+    if (e -> nbits == nbits && e -> bm[nwords-1] == last
+        && (nwords == 1
+            || memcmp(e -> bm, bm, (nwords-1) * sizeof(word)) == 0))
+      return e -> index;
+  }
+  return -1;
+}
+
+/* Add a multiword bitmap to GC_ext_descriptors arrays (unless it is    */
+/* already there).  Returns starting index on success, -1 otherwise.    */
 STATIC signed_word GC_add_ext_descriptor(const word * bm, word nbits)
 {
     size_t nwords = divWORDSZ(nbits + WORDSZ-1);
+    word h = GC_ext_descr_hash(bm, nbits);
+    struct ext_descr_cache_entry *e;
     signed_word result;
     size_t i;
     DCL_LOCK_STATE;
 
+#   ifdef DESCR_CACHE_LOCK_FREE
+      result = GC_find_ext_descriptor(bm, nbits, h);
+      if (result != -1) return result;
+#   endif
     LOCK();
+    result = GC_find_ext_descriptor(bm, nbits, h);
+    if (result != -1) {
+        UNLOCK();
+        return result;
+    }
+    e = (struct ext_descr_cache_entry *)GC_scratch_alloc(
+                        sizeof(struct ext_descr_cache_entry)
+                        + (nwords-1) * sizeof(word));
+    if (EXPECT(NULL == e, FALSE)) {
+        UNLOCK();
+        return -1;
+    }
     while (EXPECT(GC_avail_descr + nwords >= GC_ed_size, FALSE)) {
         typed_ext_descr_t *newExtD;
         size_t new_size;
@@ -77,7 +189,6 @@ STATIC signed_word GC_add_ext_descriptor(const word * bm, word nbits)
 
         if (ed_size == 0) {
             GC_ASSERT((word)(&GC_ext_descriptors) % sizeof(word) == 0);
-            GC_push_typed_structures = GC_push_typed_structures_proc;
             UNLOCK();
             new_size = ED_INITIAL_SIZE;
         } else {
@@ -106,9 +217,18 @@ STATIC signed_word GC_add_ext_descriptor(const word * bm, word nbits)
     }
     /* Clear irrelevant (highest) bits for the last element.    */
     GC_ext_descriptors[result + i].ed_bitmap =
-                bm[i] & (GC_WORD_MAX >> (nwords * WORDSZ - nbits));
+                bm[i] & EXT_DESCR_LAST_MASK(nwords, nbits);
     GC_ext_descriptors[result + i].ed_continued = FALSE;
     GC_avail_descr += nwords;
+
+    /* The entry (allocated before the array growth, as the lock    */
+    /* might be released there) is published only when filled in.  */
+    BCOPY(bm, e -> bm, (nwords-1) * sizeof(word));
+    e -> bm[nwords-1] = GC_ext_descriptors[result + i].ed_bitmap;
+    e -> nbits = nbits;
+    e -> index = result;
+    e -> next = GC_ext_descr_cache[h];
+    DESCR_CACHE_STORE(GC_ext_descr_cache[h], e);
     UNLOCK();
     return result;
 }
@@ -153,6 +273,7 @@ STATIC void GC_init_explicit_typing(void)
                             GC_MAKE_PROC(GC_array_mark_proc_index, 0),
                             FALSE, TRUE);
 
+    GC_push_typed_structures = GC_push_typed_structures_proc;
     GC_bm_table[0] = GC_DS_BITMAP;
     for (i = 1; i < WORDSZ/2; i++) {
       GC_bm_table[i] = (((word)-1) << (WORDSZ - i)) | GC_DS_BITMAP;
@@ -185,6 +306,7 @@ STATIC mse * GC_typed_mark_proc(word * addr, mse * mark_stack_ptr,
             }
         }
     }
+    FLUSH_PENDING_MARKS(hdr_cache);
     if (GC_ext_descriptors[env].ed_continued) {
         /* Push an entry with the rest of the descriptor back onto the  */
         /* stack.  Thus we never do too much work at once.  Note that   */
@@ -342,6 +464,70 @@ GC_API GC_ATTR_MALLOC void * GC_CALL
     return op;
 }
 
+/* Return d extended (if needed) to treat the first word of the object  */
+/* as a pointer, so that the links of the list returned by              */
+/* GC_malloc_explicitly_typed_many are traced.  nwords is the object    */
+/* length in words (including the descriptor one).                      */
+STATIC GC_descr GC_descr_with_link(GC_descr d, size_t nwords)
+{
+    switch (d & GC_DS_TAGS) {
+    case GC_DS_LENGTH:
+      if (d >= sizeof(word)) return d;
+      break;
+    case GC_DS_BITMAP:
+      return d | SIGNB;
+    case GC_DS_PROC:
+      if (((d >> GC_DS_TAG_BITS) & (GC_MAX_MARK_PROCS-1))
+            == (word)GC_typed_mark_proc_index) {
+        word bm;
+        DCL_LOCK_STATE;
+
+        LOCK();
+        bm = GC_ext_descriptors[ENV(d)].ed_bitmap;
+        UNLOCK();
+        if ((bm & 1) != 0) return d;
+      }
+      break;
+    }
+    /* Fall back to scanning all the object but the descriptor itself.  */
+    return WORDS_TO_BYTES(nwords - 1) | GC_DS_LENGTH;
+}
+
+GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc_explicitly_typed_many(
+                                                size_t lb, GC_descr d)
+{
+    void *result;
+    size_t lg;
+
+    GC_ASSERT(GC_explicit_typing_initialized);
+    if (EXPECT(0 == lb, FALSE)) lb = 1;
+    /* Add TYPD_EXTRA_BYTES and EXTRA_BYTES (i.e. a word), and round up */
+    /* to a multiple of a granule like GC_malloc_many does.             */
+    lb = SIZET_SAT_ADD(lb, sizeof(word) + GRANULE_BYTES - 1)
+            & ~(GRANULE_BYTES - 1);
+    lg = BYTES_TO_GRANULES(lb);
+    d = GC_descr_with_link(d, GRANULES_TO_WORDS(lg));
+#   ifdef THREAD_LOCAL_ALLOC
+      /* Hand out the whole thread-local free list of the size class.   */
+      result = GC_take_typed_tlfl(lg, (word)d);
+      if (NULL == result)
+#   endif
+    {
+      GC_generic_malloc_many_with_tail(lb, GC_explicit_kind, (word)d,
+                                       &result);
+      GC_HEAP_PROF_SAMPLE(result, lb);
+      GC_LIFETIME_SAMPLE(result);
+    }
+    if (GC_manual_vdb) {
+      void *p;
+
+      for (p = result; p != NULL; p = obj_link(p))
+        GC_dirty((word *)p + GRANULES_TO_WORDS(lg) - 1);
+    }
+    REACHABLE_AFTER_DIRTY(d);
+    return result;
+}
+
 /* Array descriptors.  GC_array_mark_proc understands these.    */
 /* We may eventually need to add provisions for headers and     */
 /* trailers.  Hence we provide for tree structured descriptors, */
@@ -492,6 +678,46 @@ STATIC int GC_make_array_descriptor(size_t nelements, size_t size,
   return LEAF;
 }
 
+#ifdef USE_ARRAY_DESCR_CACHE
+  /* Same as GC_make_array_descriptor but the COMPLEX results are       */
+  /* shared using GC_array_descr_cache.                                 */
+  STATIC int GC_get_array_descriptor(size_t nelements, size_t size,
+                                     GC_descr d, GC_descr *psimple_d,
+                                     complex_descriptor **pcomplex_d,
+                                     struct LeafDescriptor *pleaf)
+  {
+    word h = (nelements ^ (size * 7) ^ (d >> 2) ^ (d >> 11))
+             & (ARRAY_DESCR_CACHE_SIZE - 1);
+    struct array_descr_cache_entry *e = (struct array_descr_cache_entry *)
+                                DESCR_CACHE_LOAD(GC_array_descr_cache[h]);
+    int result;
+
+    if (e != NULL && e -> nelements == nelements && e -> size == size
+        && e -> d == d) {
+      *pcomplex_d = e -> complex_d;
+      return COMPLEX;
+    }
+    result = GC_make_array_descriptor(nelements, size, d, psimple_d,
+                                      pcomplex_d, pleaf);
+    if (COMPLEX == result) {
+      e = (struct array_descr_cache_entry *)GC_malloc(
+                                sizeof(struct array_descr_cache_entry));
+      if (EXPECT(e != NULL, TRUE)) {
+        e -> nelements = nelements;
+        e -> size = size;
+        e -> d = d;
+        e -> complex_d = *pcomplex_d;
+        GC_dirty(e);
+        REACHABLE_AFTER_DIRTY(*pcomplex_d);
+        DESCR_CACHE_STORE(GC_array_descr_cache[h], e);
+      }
+    }
+    return result;
+  }
+#else
+# define GC_get_array_descriptor GC_make_array_descriptor
+#endif /* !USE_ARRAY_DESCR_CACHE */
+
 GC_API GC_ATTR_MALLOC void * GC_CALL GC_calloc_explicitly_typed(size_t n,
                                                         size_t lb, GC_descr d)
 {
@@ -510,7 +736,7 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_calloc_explicitly_typed(size_t n,
         && n > GC_SIZE_MAX / lb)
       return (*GC_get_oom_fn())(GC_SIZE_MAX); /* n*lb overflow */
 
-    descr_type = GC_make_array_descriptor((word)n, (word)lb, d,
+    descr_type = GC_get_array_descriptor((word)n, (word)lb, d,
                                           &simple_d, &complex_d, &leaf);
     lb *= n;
     switch(descr_type) {
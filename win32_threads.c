@@ -780,6 +780,7 @@ GC_INNER void GC_do_blocking_inner(ptr_t data, void *context)
   me -> stack_ptr = (ptr_t)(&d); /* save approx. sp */
   /* Save context here if we want to support precise stack marking */
   me -> flags |= DO_BLOCKING;
+  SET_BLOCKING_GC_NO(me);
   UNLOCK();
   d -> client_data = (d -> fn)(d -> client_data);
   LOCK();   /* This will block if the world is stopped. */
@@ -849,6 +850,7 @@ GC_API void * GC_CALL GC_call_with_gc_active(GC_fn_type fn,
     me -> backing_store_ptr = stacksect.saved_backing_store_ptr;
 # endif
   me -> flags |= DO_BLOCKING;
+  SET_BLOCKING_GC_NO(me);
   me -> stack_ptr = stacksect.saved_stack_ptr;
   UNLOCK();
 
@@ -1021,6 +1023,9 @@ GC_API void * GC_CALL GC_get_my_stackbottom(struct GC_stack_base *sb)
 #     ifdef PARALLEL_MARK
         if (GC_parallel)
           GC_wait_for_reclaim();
+#     endif
+#     ifdef THREAD_LOCAL_SWEEP
+        GC_wait_for_sweep_claims();
 #     endif
       GC_wait_for_gc_completion(TRUE);
 #     ifdef PARALLEL_MARK
@@ -1215,6 +1220,98 @@ STATIC void GC_suspend(GC_thread t)
     GC_on_thread_event(GC_EVENT_THREAD_SUSPENDED, THREAD_HANDLE(t));
 }
 
+#if defined(PARALLEL_MARK) && !defined(GC_PTHREADS_PARAMARK) \
+    && !defined(MSWINCE) && !defined(DEBUG_THREADS) \
+    && !defined(NO_PARALLEL_SUSPEND)
+  /* Let the idle marker threads suspend the threads (and, if           */
+  /* RETRY_GET_THREAD_CONTEXT, save their contexts) together with the   */
+  /* thread stopping the world.  Not used with DEBUG_THREADS since      */
+  /* the helpers cannot log while GC_write_cs is held by the collector. */
+# define PARALLEL_SUSPEND
+#endif
+
+#ifdef PARALLEL_SUSPEND
+# ifndef MIN_PARALLEL_SUSPEND_THREADS
+#   define MIN_PARALLEL_SUSPEND_THREADS 32
+# endif
+
+  STATIC volatile AO_t GC_suspend_next_bucket = 0;
+                        /* The next GC_threads[] entry to be claimed.   */
+  STATIC volatile AO_t GC_suspend_helping = FALSE;
+                        /* Whether the woken up markers should help.    */
+  STATIC volatile AO_t GC_suspend_helpers = 0;
+                        /* The number of markers in GC_help_suspend.    */
+  STATIC thread_id_t GC_suspend_self_id;
+
+  /* Suspend the threads of the GC_threads[] entries claimed one by one */
+  /* until there are none left.                                         */
+  STATIC void GC_suspend_claimed_threads(thread_id_t self_id)
+  {
+    for (;;) {
+      AO_t i = AO_fetch_and_add1(&GC_suspend_next_bucket);
+      GC_thread p;
+
+      if (i >= THREAD_TABLE_SZ) break;
+      for (p = GC_threads[i]; p != NULL; p = p -> tm.next)
+        if (p -> stack_end != NULL && p -> id != self_id
+            && (p -> flags & (FINISHED | DO_BLOCKING)) == 0)
+          GC_suspend(p);
+    }
+  }
+
+  /* Called by a marker thread woken up by GC_notify_all_marker, not    */
+  /* holding the mark lock.                                             */
+  STATIC void GC_help_suspend(void)
+  {
+    (void)AO_fetch_and_add1(&GC_suspend_helpers);
+    AO_nop_full(); /* order the increment w.r.t. the flag load */
+    if (AO_load(&GC_suspend_helping))
+      GC_suspend_claimed_threads(GC_suspend_self_id);
+    (void)AO_fetch_and_sub1_release(&GC_suspend_helpers);
+  }
+
+  /* Check whether it is worth (and safe) to suspend the threads in     */
+  /* parallel.  GC_remove_protection (see UNPROTECT_THREAD) may not be  */
+  /* called concurrently, and the client thread event callback might    */
+  /* need GC_write_cs.                                                  */
+  STATIC GC_bool GC_should_suspend_in_parallel(thread_id_t self_id)
+  {
+    unsigned n = 0;
+    int i;
+
+    if (!GC_parallel || GC_auto_incremental || GC_on_thread_event != 0)
+      return FALSE;
+    for (i = 0; i < THREAD_TABLE_SZ; i++) {
+      GC_thread p;
+
+      for (p = GC_threads[i]; p != NULL; p = p -> tm.next)
+        if (p -> stack_end != NULL && p -> id != self_id
+            && (p -> flags & (FINISHED | DO_BLOCKING)) == 0
+            && ++n >= MIN_PARALLEL_SUSPEND_THREADS)
+          return TRUE;
+    }
+    return FALSE;
+  }
+
+  /* Suspend the threads sharing the work with the marker threads.  We  */
+  /* hold the mark lock, thus the markers are waiting for it (or for    */
+  /* their events in GC_wait_marker), i.e. none of them is marking.     */
+  STATIC void GC_suspend_in_parallel(thread_id_t self_id)
+  {
+    AO_store(&GC_suspend_next_bucket, 0);
+    GC_suspend_self_id = self_id;
+    AO_store_release(&GC_suspend_helping, TRUE);
+    GC_notify_all_marker();
+    GC_suspend_claimed_threads(self_id);
+
+    /* Wait for the helpers which might have seen the flag set. */
+    AO_store(&GC_suspend_helping, FALSE);
+    AO_nop_full(); /* order the flag store w.r.t. the helpers count load */
+    while (AO_load_acquire(&GC_suspend_helpers) != 0)
+      Sleep(0); /* yield */
+  }
+#endif /* PARALLEL_SUSPEND */
+
 #if defined(GC_ASSERTIONS) \
     && ((defined(MSWIN32) && !defined(CONSOLE_LOG)) || defined(MSWINCE))
   GC_INNER GC_bool GC_write_disabled = FALSE;
@@ -1269,6 +1366,11 @@ GC_INNER void GC_stop_world(void)
         }
       }
     } else
+# endif
+# ifdef PARALLEL_SUSPEND
+    if (GC_should_suspend_in_parallel(self_id)) {
+      GC_suspend_in_parallel(self_id);
+    } else
 # endif
   /* else */ {
     GC_thread p;
@@ -1679,6 +1781,9 @@ GC_INNER void GC_push_all_stacks(void)
 
   GC_ASSERT(I_HOLD_LOCK());
   GC_ASSERT(GC_thr_initialized);
+# ifdef PARALLEL_MARK
+    GC_defer_stacks_scan();
+# endif
 # ifndef GC_NO_THREADS_DISCOVERY
     if (GC_win32_dll_threads) {
       int i;
@@ -1710,6 +1815,11 @@ GC_INNER void GC_push_all_stacks(void)
         }
     }
   }
+# ifdef PARALLEL_MARK
+    /* Scan the stacks (which are not pushed lazily), sharing them      */
+    /* among the marker threads.                                        */
+    GC_scan_deferred_stacks();
+# endif
 # ifndef SMALL_CONFIG
     GC_VERBOSE_LOG_PRINTF("Pushed %d thread stacks%s\n", nthreads,
                           GC_win32_dll_threads ?
@@ -2330,6 +2440,12 @@ GC_INNER void GC_get_next_stack(char *start, char *limit,
       GC_release_mark_lock();
       if (WaitForSingleObject(event, INFINITE) == WAIT_FAILED)
         ABORT("WaitForSingleObject failed");
+#     ifdef PARALLEL_SUSPEND
+        /* The world might be being stopped, join it before waiting for */
+        /* the mark lock.                                               */
+        if (event != mark_cv)
+          GC_help_suspend();
+#     endif
       GC_acquire_mark_lock();
     }
 
@@ -3096,6 +3212,8 @@ GC_INNER void GC_init_parallel(void)
 #         ifdef DEBUG_THREADS
             GC_log_printf("Marking thread locals for 0x%x\n", (int)p->id);
 #         endif
+          if (SHOULD_FLUSH_IDLE_TLFS(p))
+            GC_flush_thread_local(&p->tlfs);
           GC_mark_thread_local_fls_for(&p->tlfs);
         }
     }